@@ -0,0 +1,983 @@
+/*
+ * apps/coap/coap.h
+ *
+ * Minimal CoAP server (RFC 7252) with Observe (RFC 7641) for the mmWave
+ * readings. Three read-only JSON resources, /presence, /distance and
+ * /gates, plus /.well-known/core for discovery. GET only, no blockwise
+ * transfer, no DTLS.
+ *
+ * Observers live in a fixed table inside struct coap_server_s and every
+ * message is built in the one preallocated tx buffer there, so serving
+ * and notifying never allocates. The socket is behind a send callback
+ * and time is passed in, so the whole server runs on the host.
+ */
+
+#ifndef __APPS_COAP_COAP_H
+#define __APPS_COAP_COAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/json_writer.h"
+#include "apps/common/mmwave_json.h"
+
+#define COAP_PORT               5683
+#define COAP_VERSION            1
+
+/* Message types */
+
+#define COAP_CON                0
+#define COAP_NON                1
+#define COAP_ACK                2
+#define COAP_RST                3
+
+/* Codes, class.detail packed as ccc.ddddd */
+
+#define COAP_CODE(c, d)         ((uint8_t)((c) << 5 | (d)))
+#define COAP_EMPTY              COAP_CODE(0, 0)
+#define COAP_GET                COAP_CODE(0, 1)
+#define COAP_CONTENT            COAP_CODE(2, 5)
+#define COAP_BAD_REQUEST        COAP_CODE(4, 0)
+#define COAP_BAD_OPTION         COAP_CODE(4, 2)
+#define COAP_NOT_FOUND          COAP_CODE(4, 4)
+#define COAP_NOT_ALLOWED        COAP_CODE(4, 5)
+#define COAP_NOT_ACCEPTABLE     COAP_CODE(4, 6)
+#define COAP_UNAVAILABLE        COAP_CODE(5, 3)
+
+/* Option numbers */
+
+#define COAP_OPT_URI_HOST       3
+#define COAP_OPT_OBSERVE        6
+#define COAP_OPT_URI_PORT       7
+#define COAP_OPT_URI_PATH       11
+#define COAP_OPT_CONTENT_FORMAT 12
+#define COAP_OPT_URI_QUERY      15
+#define COAP_OPT_ACCEPT         17
+#define COAP_OPT_BLOCK2         23
+
+/* Content formats */
+
+#define COAP_CF_TEXT            0
+#define COAP_CF_LINK            40
+#define COAP_CF_JSON            50
+
+#define COAP_TOKEN_MAX          8
+#define COAP_PATH_MAX           32
+#define COAP_MSG_MAX            256
+
+/* Observe registration values */
+
+#define COAP_OBSERVE_REGISTER   0
+#define COAP_OBSERVE_CANCEL     1
+#define COAP_OBSERVE_SEQ_MASK   0xffffff
+
+#ifndef CONFIG_COAP_MAX_OBSERVERS
+#  define CONFIG_COAP_MAX_OBSERVERS 8
+#endif
+
+/* Reliability (RFC 7252 section 4.8 defaults) */
+
+#define COAP_ACK_TIMEOUT_MS     2000
+#define COAP_MAX_RETRANSMIT     4
+
+/*
+ * Most notifications are NON. One in COAP_CON_EVERY, and at least one
+ * per COAP_CON_INTERVAL_MS, is CON so a vanished observer is noticed
+ * (RFC 7641 section 4.5) and its slot freed.
+ */
+#define COAP_CON_EVERY          16
+#define COAP_CON_INTERVAL_MS    60000
+
+/* Change filters: smaller moves than these are not notified */
+
+#define COAP_DISTANCE_STEP_CM   10
+#define COAP_GATE_STEP          5
+
+enum coap_res_e
+{
+  COAP_RES_PRESENCE = 0,
+  COAP_RES_DISTANCE,
+  COAP_RES_GATES,
+  COAP_RES_COUNT,
+  COAP_RES_CORE = COAP_RES_COUNT,    /* /.well-known/core, not observable */
+  COAP_RES_NONE
+};
+
+static const char *const g_coap_paths[] =
+{
+  "presence", "distance", "gates", ".well-known/core"
+};
+
+/* ---- Parsing ---- */
+
+struct coap_msg_s
+{
+  uint8_t        type;
+  uint8_t        code;
+  uint16_t       mid;
+  uint8_t        tkl;
+  uint8_t        token[COAP_TOKEN_MAX];
+  bool           bad_option;     /* Unrecognized critical option seen */
+  bool           path_long;      /* Uri-Path did not fit in path[] */
+  int32_t        observe;        /* -1 if absent */
+  int32_t        accept;         /* -1 if absent */
+  char           path[COAP_PATH_MAX];
+  const uint8_t *payload;
+  size_t         payload_len;
+};
+
+static inline uint32_t coap_uint(const uint8_t *p, size_t len)
+{
+  uint32_t v = 0;
+
+  while (len-- > 0)
+    {
+      v = v << 8 | *p++;
+    }
+
+  return v;
+}
+
+/* Option delta/length nibble with its extended bytes; -1 if malformed */
+
+static inline int32_t coap_opt_ext(uint8_t nibble, const uint8_t **p,
+                                   const uint8_t *end)
+{
+  if (nibble < 13)
+    {
+      return nibble;
+    }
+
+  if (nibble == 13 && *p + 1 <= end)
+    {
+      return 13 + *(*p)++;
+    }
+
+  if (nibble == 14 && *p + 2 <= end)
+    {
+      int32_t v = 269 + ((*p)[0] << 8 | (*p)[1]);
+      *p += 2;
+      return v;
+    }
+
+  return -1;
+}
+
+/*
+ * Parse a datagram. Returns 0, or -1 if it is not well-formed CoAP
+ * (such messages are silently dropped, RFC 7252 section 4.2/4.3).
+ */
+static inline int coap_parse(const uint8_t *buf, size_t len,
+                             struct coap_msg_s *m)
+{
+  const uint8_t *p   = buf + 4;
+  const uint8_t *end = buf + len;
+  uint32_t opt = 0;
+  size_t plen = 0;
+
+  memset(m, 0, sizeof(*m));
+  m->observe = -1;
+  m->accept  = -1;
+
+  if (len < 4 || (buf[0] >> 6) != COAP_VERSION)
+    {
+      return -1;
+    }
+
+  m->type = (buf[0] >> 4) & 3;
+  m->tkl  = buf[0] & 0x0f;
+  m->code = buf[1];
+  m->mid  = (uint16_t)(buf[2] << 8 | buf[3]);
+
+  if (m->tkl > COAP_TOKEN_MAX || (size_t)(end - p) < m->tkl)
+    {
+      return -1;
+    }
+
+  memcpy(m->token, p, m->tkl);
+  p += m->tkl;
+
+  while (p < end)
+    {
+      uint8_t b = *p++;
+      int32_t delta;
+      int32_t olen;
+
+      if (b == 0xff)
+        {
+          if (p == end)
+            {
+              return -1;           /* Marker with no payload */
+            }
+
+          m->payload     = p;
+          m->payload_len = (size_t)(end - p);
+          break;
+        }
+
+      delta = coap_opt_ext(b >> 4, &p, end);
+      olen  = coap_opt_ext(b & 0x0f, &p, end);
+      if (delta < 0 || olen < 0 || (size_t)(end - p) < (size_t)olen)
+        {
+          return -1;
+        }
+
+      opt += (uint32_t)delta;
+
+      switch (opt)
+        {
+          case COAP_OPT_OBSERVE:
+            m->observe = olen <= 3 ? (int32_t)coap_uint(p, olen) : -1;
+            break;
+
+          case COAP_OPT_ACCEPT:
+            m->accept = olen <= 2 ? (int32_t)coap_uint(p, olen) : -1;
+            break;
+
+          case COAP_OPT_URI_PATH:
+            if (plen + (plen > 0) + olen >= sizeof(m->path))
+              {
+                m->path_long = true;
+                break;
+              }
+
+            if (plen > 0)
+              {
+                m->path[plen++] = '/';
+              }
+
+            memcpy(&m->path[plen], p, olen);
+            plen += olen;
+            m->path[plen] = '\0';
+            break;
+
+          case COAP_OPT_URI_HOST:
+          case COAP_OPT_URI_PORT:
+          case COAP_OPT_URI_QUERY:
+          case COAP_OPT_BLOCK2:
+
+            /* Understood and ignored: one host, no queries, and every
+             * representation fits a single datagram.
+             */
+
+            break;
+
+          default:
+            if (opt & 1)
+              {
+                m->bad_option = true;
+              }
+
+            break;
+        }
+
+      p += olen;
+    }
+
+  /* Empty messages carry nothing but the header */
+
+  return m->code == COAP_EMPTY && (len > 4 || m->tkl > 0) ? -1 : 0;
+}
+
+static inline int coap_resource(const char *path)
+{
+  for (int i = 0; i <= COAP_RES_CORE; i++)
+    {
+      if (strcmp(path, g_coap_paths[i]) == 0)
+        {
+          return i;
+        }
+    }
+
+  return COAP_RES_NONE;
+}
+
+/* ---- Building ---- */
+
+struct coap_out_s
+{
+  uint8_t *buf;
+  size_t   size;
+  size_t   len;
+  uint16_t last_opt;   /* Options must be added in ascending order */
+  int      error;
+};
+
+static inline void coap_out_init(struct coap_out_s *o, uint8_t *buf,
+                                 size_t size, uint8_t type, uint8_t code,
+                                 uint16_t mid, const uint8_t *token,
+                                 uint8_t tkl)
+{
+  o->buf      = buf;
+  o->size     = size;
+  o->len      = 4 + tkl;
+  o->last_opt = 0;
+  o->error    = size < 4 + (size_t)tkl ? -E2BIG : 0;
+
+  if (o->error == 0)
+    {
+      buf[0] = (uint8_t)(COAP_VERSION << 6 | type << 4 | tkl);
+      buf[1] = code;
+      buf[2] = (uint8_t)(mid >> 8);
+      buf[3] = (uint8_t)mid;
+      memcpy(buf + 4, token, tkl);
+    }
+}
+
+static inline void coap_put_option(struct coap_out_s *o, uint16_t num,
+                                   const uint8_t *val, size_t len)
+{
+  uint32_t delta = num - o->last_opt;
+  uint8_t *p;
+
+  /* Only small option numbers and values are ever written here */
+
+  if (o->error < 0 || delta >= 269 || len >= 13 ||
+      o->size - o->len < 2 + len)
+    {
+      o->error = -E2BIG;
+      return;
+    }
+
+  p = o->buf + o->len;
+  if (delta >= 13)
+    {
+      *p++ = (uint8_t)(13 << 4 | len);
+      *p++ = (uint8_t)(delta - 13);
+    }
+  else
+    {
+      *p++ = (uint8_t)(delta << 4 | len);
+    }
+
+  memcpy(p, val, len);
+  o->len      = (size_t)(p - o->buf) + len;
+  o->last_opt = num;
+}
+
+/* uint option in the fewest bytes (zero is the empty string) */
+
+static inline void coap_put_uint_option(struct coap_out_s *o, uint16_t num,
+                                        uint32_t v)
+{
+  uint8_t b[4];
+  size_t n = 0;
+
+  for (int shift = 24; shift >= 0; shift -= 8)
+    {
+      if (n > 0 || (v >> shift) != 0)
+        {
+          b[n++] = (uint8_t)(v >> shift);
+        }
+    }
+
+  coap_put_option(o, num, b, n);
+}
+
+/* Start the payload; returns a JSON sink target for the rest of buf */
+
+static inline void coap_begin_payload(struct coap_out_s *o,
+                                      struct json_buf_s *jb)
+{
+  if (o->error == 0 && o->len < o->size)
+    {
+      o->buf[o->len++] = 0xff;
+    }
+  else
+    {
+      o->error = -E2BIG;
+    }
+
+  jb->buf  = (char *)o->buf + o->len;
+  jb->size = o->error == 0 ? o->size - o->len : 0;
+  jb->len  = 0;
+}
+
+/* ---- Representations ---- */
+
+/* The latest reading; gates are only valid in engineering mode */
+
+struct coap_reading_s
+{
+  struct mmwave_eng_data_s eng;
+  bool                     valid;
+  bool                     gates;
+};
+
+static inline void coap_json_presence(struct json_writer_s *w,
+                                      const struct mmwave_data_s *d)
+{
+  json_begin_object(w, NULL);
+  json_bool(w, "presence", mmwave_json_presence(d));
+  json_str(w, "target", mmwave_target_str(d->target_state));
+  json_uint(w, "ts", d->timestamp_ms);
+  json_end_object(w);
+}
+
+static inline void coap_json_distance(struct json_writer_s *w,
+                                      const struct mmwave_data_s *d)
+{
+  json_begin_object(w, NULL);
+  mmwave_json_fields(w, d);
+  json_uint(w, "ts", d->timestamp_ms);
+  json_end_object(w);
+}
+
+static inline void coap_json_gates(struct json_writer_s *w,
+                                   const struct mmwave_eng_data_s *e)
+{
+  json_begin_object(w, NULL);
+  json_begin_array(w, "motion");
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      json_uint(w, NULL, e->motion_gate_energy[i]);
+    }
+
+  json_end_array(w);
+  json_begin_array(w, "static");
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      json_uint(w, NULL, e->static_gate_energy[i]);
+    }
+
+  json_end_array(w);
+  json_uint(w, "ts", e->basic.timestamp_ms);
+  json_end_object(w);
+}
+
+/* RFC 6690 link format for /.well-known/core */
+
+#define COAP_CORE_LINKS \
+  "</presence>;rt=\"mmwave.presence\";obs;ct=50," \
+  "</distance>;rt=\"mmwave.distance\";obs;ct=50," \
+  "</gates>;rt=\"mmwave.gates\";obs;ct=50"
+
+static inline int coap_abs_diff(int a, int b)
+{
+  return a > b ? a - b : b - a;
+}
+
+/*
+ * Has `res` moved enough since `sent` to be worth a notification?
+ * Presence on any change of target state, distances past
+ * COAP_DISTANCE_STEP_CM, gate energies past COAP_GATE_STEP.
+ */
+static inline bool coap_changed(int res, const struct mmwave_eng_data_s *sent,
+                                const struct mmwave_eng_data_s *now)
+{
+  const struct mmwave_data_s *a = &sent->basic;
+  const struct mmwave_data_s *b = &now->basic;
+
+  switch (res)
+    {
+      case COAP_RES_PRESENCE:
+        return a->target_state != b->target_state;
+
+      case COAP_RES_DISTANCE:
+        return coap_abs_diff(a->motion_distance, b->motion_distance) >=
+                 COAP_DISTANCE_STEP_CM ||
+               coap_abs_diff(a->static_distance, b->static_distance) >=
+                 COAP_DISTANCE_STEP_CM ||
+               coap_abs_diff(a->detection_distance, b->detection_distance) >=
+                 COAP_DISTANCE_STEP_CM;
+
+      default:
+        for (int i = 0; i < LD2410_MAX_GATES; i++)
+          {
+            if (coap_abs_diff(sent->motion_gate_energy[i],
+                              now->motion_gate_energy[i]) >= COAP_GATE_STEP ||
+                coap_abs_diff(sent->static_gate_energy[i],
+                              now->static_gate_energy[i]) >= COAP_GATE_STEP)
+              {
+                return true;
+              }
+          }
+
+        return false;
+    }
+}
+
+/* ---- Server ---- */
+
+/* Send one datagram to addr:port (both network byte order); returns
+ * the bytes sent or a negative errno.
+ */
+
+typedef int (*coap_send_t)(void *arg, uint32_t addr, uint16_t port,
+                           const uint8_t *buf, size_t len);
+
+struct coap_observer_s
+{
+  bool     used;
+  uint8_t  res;              /* enum coap_res_e */
+  uint8_t  tkl;
+  uint8_t  token[COAP_TOKEN_MAX];
+  uint32_t addr;
+  uint16_t port;
+
+  uint16_t last_mid;         /* Latest notification, for RST matching */
+  bool     pending;          /* CON notification awaiting its ACK */
+  uint16_t pending_mid;
+  uint8_t  retries;
+  uint32_t timeout_ms;       /* Current retransmission timeout */
+  uint32_t con_sent_ms;      /* When the pending CON went out */
+  uint32_t con_ms;           /* Last CON notification */
+  uint16_t since_con;        /* NON notifications since then */
+
+  struct mmwave_eng_data_s sent;  /* What this observer last saw */
+};
+
+struct coap_stats_s
+{
+  uint32_t requests;
+  uint32_t notifications;
+  uint32_t retransmits;
+  uint32_t evicted;          /* Observers dropped: RST or no ACK */
+  uint32_t table_full;       /* Registrations refused for lack of a slot */
+};
+
+struct coap_server_s
+{
+  struct coap_observer_s obs[CONFIG_COAP_MAX_OBSERVERS];
+  struct coap_reading_s  cur;
+  struct coap_stats_s    stats;
+  coap_send_t            send;
+  void                  *arg;
+  uint16_t               mid;
+  uint32_t               seq;        /* Observe sequence, 24 bits */
+  uint8_t                tx[COAP_MSG_MAX];
+};
+
+static inline void coap_server_init(struct coap_server_s *s,
+                                    coap_send_t send, void *arg,
+                                    uint16_t mid_seed)
+{
+  memset(s, 0, sizeof(*s));
+  s->send = send;
+  s->arg  = arg;
+  s->mid  = mid_seed;
+}
+
+static inline int coap_observer_count(const struct coap_server_s *s)
+{
+  int n = 0;
+
+  for (int i = 0; i < CONFIG_COAP_MAX_OBSERVERS; i++)
+    {
+      n += s->obs[i].used;
+    }
+
+  return n;
+}
+
+/*
+ * Build a response or notification carrying the representation of
+ * `res` into s->tx and send it. observe < 0 leaves the option out.
+ */
+static inline int coap_send_rep(struct coap_server_s *s, uint32_t addr,
+                                uint16_t port, uint8_t type, uint16_t mid,
+                                const uint8_t *token, uint8_t tkl, int res,
+                                int32_t observe)
+{
+  const struct mmwave_eng_data_s *e = &s->cur.eng;
+  struct coap_out_s o;
+  struct json_buf_s jb;
+  struct json_writer_s w;
+  uint8_t code = COAP_CONTENT;
+  int n;
+
+  if (!s->cur.valid || (res == COAP_RES_GATES && !s->cur.gates))
+    {
+      code    = COAP_UNAVAILABLE;
+      observe = -1;
+    }
+
+  coap_out_init(&o, s->tx, sizeof(s->tx), type, code, mid, token, tkl);
+  if (observe >= 0)
+    {
+      coap_put_uint_option(&o, COAP_OPT_OBSERVE, (uint32_t)observe);
+    }
+
+  if (code != COAP_CONTENT)
+    {
+      /* Diagnostic payload (RFC 7252 section 5.5.2) */
+
+      static const char why_none[]  = "no sensor data yet";
+      static const char why_gates[] = "engineering mode off";
+      const char *why = s->cur.valid ? why_gates : why_none;
+
+      coap_begin_payload(&o, &jb);
+      n = (int)strlen(why);
+      if (o.error == 0 && (size_t)n <= jb.size)
+        {
+          memcpy(jb.buf, why, n);
+          o.len += n;
+        }
+    }
+  else if (res == COAP_RES_CORE)
+    {
+      coap_put_uint_option(&o, COAP_OPT_CONTENT_FORMAT, COAP_CF_LINK);
+      coap_begin_payload(&o, &jb);
+      n = (int)sizeof(COAP_CORE_LINKS) - 1;
+      if (o.error == 0 && (size_t)n <= jb.size)
+        {
+          memcpy(jb.buf, COAP_CORE_LINKS, n);
+          o.len += n;
+        }
+      else
+        {
+          o.error = -E2BIG;
+        }
+    }
+  else
+    {
+      coap_put_uint_option(&o, COAP_OPT_CONTENT_FORMAT, COAP_CF_JSON);
+      coap_begin_payload(&o, &jb);
+      json_init(&w, json_sink_buf, &jb);
+
+      if (res == COAP_RES_PRESENCE)
+        {
+          coap_json_presence(&w, &e->basic);
+        }
+      else if (res == COAP_RES_DISTANCE)
+        {
+          coap_json_distance(&w, &e->basic);
+        }
+      else
+        {
+          coap_json_gates(&w, e);
+        }
+
+      n = json_finish(&w);
+      if (n < 0)
+        {
+          o.error = n;
+        }
+      else
+        {
+          o.len += n;
+        }
+    }
+
+  if (o.error < 0)
+    {
+      return o.error;
+    }
+
+  n = s->send(s->arg, addr, port, s->tx, o.len);
+  return n < 0 ? n : OK;
+}
+
+/* Header-only reply: an error code, or an empty ACK/RST */
+
+static inline int coap_send_bare(struct coap_server_s *s, uint32_t addr,
+                                 uint16_t port, uint8_t type, uint8_t code,
+                                 uint16_t mid, const uint8_t *token,
+                                 uint8_t tkl)
+{
+  struct coap_out_s o;
+  int ret;
+
+  coap_out_init(&o, s->tx, sizeof(s->tx), type, code, mid, token, tkl);
+  ret = s->send(s->arg, addr, port, s->tx, o.len);
+  return ret < 0 ? ret : OK;
+}
+
+static inline struct coap_observer_s *
+coap_find_observer(struct coap_server_s *s, uint32_t addr, uint16_t port,
+                   int res)
+{
+  for (int i = 0; i < CONFIG_COAP_MAX_OBSERVERS; i++)
+    {
+      struct coap_observer_s *ob = &s->obs[i];
+
+      if (ob->used && ob->addr == addr && ob->port == port &&
+          ob->res == res)
+        {
+          return ob;
+        }
+    }
+
+  return NULL;
+}
+
+/* Register (or refresh) an observation. NULL if the table is full. */
+
+static inline struct coap_observer_s *
+coap_register(struct coap_server_s *s, uint32_t addr, uint16_t port,
+              int res, const struct coap_msg_s *m, uint32_t now)
+{
+  struct coap_observer_s *ob = coap_find_observer(s, addr, port, res);
+
+  for (int i = 0; ob == NULL && i < CONFIG_COAP_MAX_OBSERVERS; i++)
+    {
+      if (!s->obs[i].used)
+        {
+          ob = &s->obs[i];
+        }
+    }
+
+  if (ob == NULL)
+    {
+      s->stats.table_full++;
+      return NULL;
+    }
+
+  memset(ob, 0, sizeof(*ob));
+  ob->used   = true;
+  ob->res    = (uint8_t)res;
+  ob->addr   = addr;
+  ob->port   = port;
+  ob->tkl    = m->tkl;
+  ob->con_ms = now;
+  ob->sent   = s->cur.eng;
+  memcpy(ob->token, m->token, m->tkl);
+  return ob;
+}
+
+static inline void coap_evict(struct coap_server_s *s,
+                              struct coap_observer_s *ob)
+{
+  ob->used = false;
+  s->stats.evicted++;
+}
+
+/* Latest sensor reading; notifications go out from coap_server_tick() */
+
+static inline void coap_server_update(struct coap_server_s *s,
+                                      const struct mmwave_eng_data_s *eng,
+                                      bool gates)
+{
+  s->cur.eng   = *eng;
+  s->cur.valid = true;
+  s->cur.gates = gates;
+}
+
+/*
+ * Handle one received datagram from addr:port. Requests are answered
+ * right away (piggybacked ACK for CON, NON for NON); ACK and RST
+ * messages settle or cancel observations. Returns 0 or a negative
+ * errno from the send callback.
+ */
+static inline int coap_server_input(struct coap_server_s *s, uint32_t addr,
+                                    uint16_t port, const uint8_t *buf,
+                                    size_t len, uint32_t now)
+{
+  struct coap_msg_s m;
+  uint8_t type;
+  uint16_t mid;
+  int res;
+
+  if (coap_parse(buf, len, &m) < 0)
+    {
+      return 0;
+    }
+
+  /* ACK or RST for one of our notifications */
+
+  if (m.type == COAP_ACK || m.type == COAP_RST)
+    {
+      for (int i = 0; i < CONFIG_COAP_MAX_OBSERVERS; i++)
+        {
+          struct coap_observer_s *ob = &s->obs[i];
+
+          if (!ob->used || ob->addr != addr || ob->port != port)
+            {
+              continue;
+            }
+
+          if (m.type == COAP_RST &&
+              (m.mid == ob->last_mid ||
+               (ob->pending && m.mid == ob->pending_mid)))
+            {
+              coap_evict(s, ob);
+            }
+          else if (m.type == COAP_ACK && ob->pending &&
+                   m.mid == ob->pending_mid)
+            {
+              ob->pending = false;
+              ob->retries = 0;
+            }
+        }
+
+      return 0;
+    }
+
+  /* CoAP ping: an empty CON is answered with RST */
+
+  if (m.code == COAP_EMPTY)
+    {
+      return m.type == COAP_CON ?
+             coap_send_bare(s, addr, port, COAP_RST, COAP_EMPTY, m.mid,
+                            NULL, 0) : 0;
+    }
+
+  /* Responses sent to us are not expected; reject CON ones */
+
+  if ((m.code >> 5) != 0)
+    {
+      return m.type == COAP_CON ?
+             coap_send_bare(s, addr, port, COAP_RST, COAP_EMPTY, m.mid,
+                            NULL, 0) : 0;
+    }
+
+  s->stats.requests++;
+
+  if (m.type == COAP_CON)
+    {
+      type = COAP_ACK;
+      mid  = m.mid;
+    }
+  else
+    {
+      type = COAP_NON;
+      mid  = s->mid++;
+    }
+
+  res = m.path_long ? COAP_RES_NONE : coap_resource(m.path);
+
+  if (m.bad_option)
+    {
+      return coap_send_bare(s, addr, port, type, COAP_BAD_OPTION, mid,
+                            m.token, m.tkl);
+    }
+
+  if (res == COAP_RES_NONE)
+    {
+      return coap_send_bare(s, addr, port, type, COAP_NOT_FOUND, mid,
+                            m.token, m.tkl);
+    }
+
+  if (m.code != COAP_GET)
+    {
+      return coap_send_bare(s, addr, port, type, COAP_NOT_ALLOWED, mid,
+                            m.token, m.tkl);
+    }
+
+  if (m.accept >= 0 &&
+      m.accept != (res == COAP_RES_CORE ? COAP_CF_LINK : COAP_CF_JSON))
+    {
+      return coap_send_bare(s, addr, port, type, COAP_NOT_ACCEPTABLE, mid,
+                            m.token, m.tkl);
+    }
+
+  if (res != COAP_RES_CORE && m.observe >= 0)
+    {
+      struct coap_observer_s *ob = coap_find_observer(s, addr, port, res);
+      bool ok = s->cur.valid && (res != COAP_RES_GATES || s->cur.gates);
+
+      if (m.observe == COAP_OBSERVE_CANCEL)
+        {
+          if (ob != NULL)
+            {
+              ob->used = false;
+            }
+        }
+      else if (m.observe == COAP_OBSERVE_REGISTER && ok &&
+               coap_register(s, addr, port, res, &m, now) != NULL)
+        {
+          /* Registered: the response is the first notification */
+
+          return coap_send_rep(s, addr, port, type, mid, m.token, m.tkl,
+                               res, (int32_t)(s->seq & COAP_OBSERVE_SEQ_MASK));
+        }
+    }
+
+  return coap_send_rep(s, addr, port, type, mid, m.token, m.tkl, res, -1);
+}
+
+static inline int coap_notify(struct coap_server_s *s,
+                              struct coap_observer_s *ob, uint32_t now)
+{
+  bool con = ob->pending || ob->since_con + 1 >= COAP_CON_EVERY ||
+             now - ob->con_ms >= COAP_CON_INTERVAL_MS;
+  uint16_t mid = s->mid++;
+  int ret;
+
+  s->seq = (s->seq + 1) & COAP_OBSERVE_SEQ_MASK;
+  ret = coap_send_rep(s, ob->addr, ob->port, con ? COAP_CON : COAP_NON,
+                      mid, ob->token, ob->tkl, ob->res, (int32_t)s->seq);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  s->stats.notifications++;
+  ob->sent     = s->cur.eng;
+  ob->last_mid = mid;
+
+  if (con)
+    {
+      /* A newer CON replaces an outstanding one; the retransmission
+       * count and timeout carry over (RFC 7641 section 4.5.2).
+       */
+
+      if (!ob->pending)
+        {
+          ob->pending    = true;
+          ob->retries    = 0;
+          ob->timeout_ms = COAP_ACK_TIMEOUT_MS;
+        }
+
+      ob->pending_mid = mid;
+      ob->con_sent_ms = now;
+      ob->con_ms      = now;
+      ob->since_con   = 0;
+    }
+  else
+    {
+      ob->since_con++;
+    }
+
+  return OK;
+}
+
+/*
+ * Periodic work: notify observers whose resource moved past its
+ * filter, retransmit unacknowledged CON notifications with the current
+ * state, and evict observers that never acknowledge. Returns the
+ * number of notifications sent.
+ */
+static inline int coap_server_tick(struct coap_server_s *s, uint32_t now)
+{
+  int sent = 0;
+
+  for (int i = 0; i < CONFIG_COAP_MAX_OBSERVERS; i++)
+    {
+      struct coap_observer_s *ob = &s->obs[i];
+      bool due;
+
+      if (!ob->used)
+        {
+          continue;
+        }
+
+      due = coap_changed(ob->res, &ob->sent, &s->cur.eng);
+
+      if (ob->pending && now - ob->con_sent_ms >= ob->timeout_ms)
+        {
+          if (ob->retries >= COAP_MAX_RETRANSMIT)
+            {
+              coap_evict(s, ob);
+              continue;
+            }
+
+          ob->retries++;
+          ob->timeout_ms *= 2;
+          s->stats.retransmits++;
+          due = true;
+        }
+
+      if (due && coap_notify(s, ob, now) == OK)
+        {
+          sent++;
+        }
+    }
+
+  return sent;
+}
+
+#endif /* __APPS_COAP_COAP_H */
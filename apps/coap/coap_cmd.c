@@ -0,0 +1,326 @@
+/****************************************************************************
+ * apps/coap/coap_cmd.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * NSH command: coap — CoAP server with Observe
+ *
+ * Usage:
+ *   coap start                — Start the CoAP server (in mmwaved if
+ *                               it is running, else in its own task)
+ *   coap stop                 — Stop it and forget all observers
+ *   coap status               — Show server state and observers
+ *
+ * Resources (application/json, all observable):
+ *   /presence   presence flag and target state
+ *   /distance   distances and energies
+ *   /gates      per-gate energies (needs `mmwave -e on`)
+ *
+ * e.g. from a host with libcoap:
+ *   coap-client -m get -s 60 coap://<device>/presence
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_service.h"
+#include "coap.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_COAP_PORT
+#  define CONFIG_COAP_PORT      COAP_PORT
+#endif
+
+#define COAP_TICK_MS            100    /* Retransmission check period */
+#define COAP_TASK_STACK         2048
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int      coap_start(void);
+static void     coap_pollset(FAR struct pollfd *pfds);
+static int      coap_events(FAR const struct pollfd *pfds, uint32_t now);
+static void     coap_frame(FAR const struct mmwave_eng_data_s *eng,
+                           bool gates, uint32_t now);
+static uint32_t coap_tick(uint32_t now);
+static void     coap_stop(void);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Observer table and tx buffer live here, not on the task stack */
+
+static struct coap_server_s g_server;
+static volatile bool        g_running = false;
+static pid_t                g_server_pid = -1;
+static int                  g_sockfd = -1;
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* Run by the coap_server task, or hosted by mmwaved */
+
+const struct mmwave_service_s g_coap_service =
+{
+  "coap", &g_running, 1, COAP_TASK_STACK,
+  coap_start, coap_pollset, coap_events, coap_frame, coap_tick, coap_stop
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/* coap_send_t over the server's UDP socket */
+
+static int coap_udp_send(FAR void *arg, uint32_t addr, uint16_t port,
+                         FAR const uint8_t *buf, size_t len)
+{
+  struct sockaddr_in to;
+  ssize_t n;
+
+  memset(&to, 0, sizeof(to));
+  to.sin_family      = AF_INET;
+  to.sin_port        = port;
+  to.sin_addr.s_addr = addr;
+
+  n = sendto(g_sockfd, buf, len, 0, (FAR struct sockaddr *)&to,
+             sizeof(to));
+  return n < 0 ? -errno : (int)n;
+}
+
+static int coap_bind(void)
+{
+  struct sockaddr_in addr;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(CONFIG_COAP_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(fd, (FAR struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      int ret = -errno;
+      close(fd);
+      return ret;
+    }
+
+  return fd;
+}
+
+static int coap_start(void)
+{
+  g_sockfd = coap_bind();
+  if (g_sockfd < 0)
+    {
+      fprintf(stderr, "coap: cannot bind port %u: %d\n",
+              CONFIG_COAP_PORT, g_sockfd);
+      return g_sockfd;
+    }
+
+  coap_server_init(&g_server, coap_udp_send, NULL,
+                   (uint16_t)mmwave_service_now_ms());
+
+  printf("coap: listening on udp port %u\n", CONFIG_COAP_PORT);
+  return OK;
+}
+
+static void coap_pollset(FAR struct pollfd *pfds)
+{
+  pfds[0].fd     = g_sockfd;
+  pfds[0].events = POLLIN;
+}
+
+static int coap_events(FAR const struct pollfd *pfds, uint32_t now)
+{
+  uint8_t rx[COAP_MSG_MAX];
+
+  if (pfds[0].revents & (POLLERR | POLLNVAL))
+    {
+      return -EIO;
+    }
+
+  while (pfds[0].revents & POLLIN)
+    {
+      struct sockaddr_in from;
+      socklen_t fromlen = sizeof(from);
+      ssize_t n;
+
+      n = recvfrom(g_sockfd, rx, sizeof(rx), MSG_DONTWAIT,
+                   (FAR struct sockaddr *)&from, &fromlen);
+      if (n < 0)
+        {
+          break;
+        }
+
+      coap_server_input(&g_server, from.sin_addr.s_addr,
+                        from.sin_port, rx, n, now);
+    }
+
+  return OK;
+}
+
+/* A new frame: observers whose resource changed are notified at once */
+
+static void coap_frame(FAR const struct mmwave_eng_data_s *eng, bool gates,
+                       uint32_t now)
+{
+  coap_server_update(&g_server, eng, gates);
+  coap_server_tick(&g_server, now);
+}
+
+/* Retransmissions of unacknowledged notifications */
+
+static uint32_t coap_tick(uint32_t now)
+{
+  coap_server_tick(&g_server, now);
+  return COAP_TICK_MS;
+}
+
+static void coap_stop(void)
+{
+  close(g_sockfd);
+  g_sockfd = -1;
+  printf("coap: server stopped\n");
+}
+
+static int coap_server_task(int argc, FAR char *argv[])
+{
+  return mmwave_service_run(&g_coap_service);
+}
+
+static void print_status(void)
+{
+  FAR const struct coap_stats_s *st = &g_server.stats;
+
+  printf("CoAP Server\n");
+  printf("───────────\n");
+  printf("  Server    : %s\n", g_running ? "RUNNING" : "stopped");
+  printf("  Port      : %u/udp\n", CONFIG_COAP_PORT);
+  printf("  Gates     : %s\n", g_server.cur.gates ?
+         "available" : "engineering mode off");
+
+  for (int i = 0; g_running && i < CONFIG_COAP_MAX_OBSERVERS; i++)
+    {
+      FAR const struct coap_observer_s *ob = &g_server.obs[i];
+      char addr[INET_ADDRSTRLEN];
+      struct in_addr in;
+
+      if (!ob->used)
+        {
+          continue;
+        }
+
+      in.s_addr = ob->addr;
+      inet_ntop(AF_INET, &in, addr, sizeof(addr));
+      printf("  Observer  : %s:%u /%s%s\n", addr, ntohs(ob->port),
+             g_coap_paths[ob->res], ob->pending ? " [awaiting ACK]" : "");
+    }
+
+  printf("  Observers : %d of %d\n", coap_observer_count(&g_server),
+         CONFIG_COAP_MAX_OBSERVERS);
+  printf("  Traffic   : %lu requests, %lu notifications, %lu resent\n",
+         (unsigned long)st->requests, (unsigned long)st->notifications,
+         (unsigned long)st->retransmits);
+  printf("  Dropped   : %lu evicted, %lu refused (table full)\n",
+         (unsigned long)st->evicted, (unsigned long)st->table_full);
+}
+
+static void print_usage(void)
+{
+  printf("Usage: coap <command>\n\n");
+  printf("Commands:\n");
+  printf("  start    Start the CoAP server\n");
+  printf("  stop     Stop the server\n");
+  printf("  status   Show server state and observers\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  if (argc < 2)
+    {
+      print_usage();
+      return EXIT_FAILURE;
+    }
+
+  FAR const char *cmd = argv[1];
+
+  if (strcmp(cmd, "status") == 0)
+    {
+      print_status();
+    }
+  else if (strcmp(cmd, "start") == 0)
+    {
+      if (g_running)
+        {
+          printf("coap: server already running\n");
+          return OK;
+        }
+
+      int ret = mmwave_service_delegate(&g_coap_service);
+      if (ret != -ESRCH)
+        {
+          return ret == OK ? OK : EXIT_FAILURE;
+        }
+
+      g_running = true;
+
+      g_server_pid = task_create("coap_server",
+                                 100,    /* priority */
+                                 COAP_TASK_STACK,
+                                 coap_server_task,
+                                 NULL);
+      if (g_server_pid < 0)
+        {
+          g_running = false;
+          fprintf(stderr, "coap: failed to start task\n");
+          return EXIT_FAILURE;
+        }
+    }
+  else if (strcmp(cmd, "stop") == 0)
+    {
+      printf("coap: stopping...\n");
+      mmwave_service_stop(&g_coap_service);
+    }
+  else
+    {
+      print_usage();
+    }
+
+  return OK;
+}
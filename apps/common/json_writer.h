@@ -0,0 +1,366 @@
+/*
+ * apps/common/json_writer.h
+ *
+ * Allocation-free streaming JSON writer shared by the mmWave OS apps.
+ *
+ * Output is staged in a small fixed chunk inside the writer and handed
+ * to a caller-supplied sink (stdout, a socket, or a memory buffer)
+ * whenever the chunk fills. No printf-family calls, no heap, and the
+ * whole writer state is JSON_CHUNK_SIZE + a few words of stack, however
+ * large the document.
+ *
+ *   struct json_writer_s w;
+ *   json_init(&w, json_sink_stdout, NULL);
+ *   json_begin_object(&w, NULL);
+ *   json_uint(&w, "uptime_s", secs);
+ *   json_bool(&w, "presence", true);
+ *   json_end_object(&w);
+ *   json_finish(&w);
+ */
+
+#ifndef __APPS_COMMON_JSON_WRITER_H
+#define __APPS_COMMON_JSON_WRITER_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+/* Bytes staged before the sink is called */
+
+#ifndef JSON_CHUNK_SIZE
+#  define JSON_CHUNK_SIZE      48
+#endif
+
+/* Nesting depth tracked for comma placement (one bit per level) */
+
+#define JSON_MAX_DEPTH         16
+
+/*
+ * Sink callback: consume `len` bytes. Returns 0, or a negative errno
+ * that latches in the writer and suppresses further output.
+ */
+typedef int (*json_sink_t)(void *arg, const char *buf, size_t len);
+
+struct json_writer_s
+{
+  json_sink_t sink;
+  void       *arg;
+  size_t      total;      /* Bytes handed to the sink so far */
+  int         error;      /* First sink error, latched */
+  uint16_t    has_items;  /* Bit n: level n already holds a member */
+  uint8_t     depth;
+  uint8_t     len;        /* Bytes staged in chunk[] */
+  char        chunk[JSON_CHUNK_SIZE];
+};
+
+/* ---- Sinks ---- */
+
+static inline int json_sink_stdout(void *arg, const char *buf, size_t len)
+{
+  (void)arg;
+  return fwrite(buf, 1, len, stdout) == len ? 0 : -EIO;
+}
+
+/* arg is a file descriptor (socket, pipe, file) cast via intptr_t */
+
+static inline int json_sink_fd(void *arg, const char *buf, size_t len)
+{
+  int fd = (int)(intptr_t)arg;
+
+  while (len > 0)
+    {
+      ssize_t n = write(fd, buf, len);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+
+          return -errno;
+        }
+
+      buf += n;
+      len -= n;
+    }
+
+  return 0;
+}
+
+/* Fixed memory buffer; NUL-terminated on json_finish() when it fits */
+
+struct json_buf_s
+{
+  char  *buf;
+  size_t size;
+  size_t len;
+};
+
+static inline int json_sink_buf(void *arg, const char *buf, size_t len)
+{
+  struct json_buf_s *b = (struct json_buf_s *)arg;
+
+  if (b->size - b->len < len)
+    {
+      return -E2BIG;
+    }
+
+  memcpy(b->buf + b->len, buf, len);
+  b->len += len;
+  return 0;
+}
+
+/* Discards output; json_finish() then returns the document length */
+
+static inline int json_sink_count(void *arg, const char *buf, size_t len)
+{
+  (void)arg;
+  (void)buf;
+  (void)len;
+  return 0;
+}
+
+/* ---- Core ---- */
+
+static inline void json_init(struct json_writer_s *w, json_sink_t sink,
+                             void *arg)
+{
+  w->sink      = sink;
+  w->arg       = arg;
+  w->total     = 0;
+  w->error     = 0;
+  w->has_items = 0;
+  w->depth     = 0;
+  w->len       = 0;
+}
+
+static inline void json_flush(struct json_writer_s *w)
+{
+  if (w->len > 0 && w->error == 0)
+    {
+      w->error = w->sink(w->arg, w->chunk, w->len);
+      w->total += w->len;
+    }
+
+  w->len = 0;
+}
+
+static inline void json_raw(struct json_writer_s *w, const char *s,
+                            size_t n)
+{
+  while (n > 0)
+    {
+      size_t room = JSON_CHUNK_SIZE - w->len;
+      size_t take = n < room ? n : room;
+
+      memcpy(&w->chunk[w->len], s, take);
+      w->len += take;
+      s += take;
+      n -= take;
+
+      if (w->len == JSON_CHUNK_SIZE)
+        {
+          json_flush(w);
+        }
+    }
+}
+
+static inline void json_char(struct json_writer_s *w, char c)
+{
+  w->chunk[w->len++] = c;
+  if (w->len == JSON_CHUNK_SIZE)
+    {
+      json_flush(w);
+    }
+}
+
+#define JSON_LIT(w, lit)  json_raw((w), (lit), sizeof(lit) - 1)
+
+/* Quoted string with the escapes RFC 8259 requires */
+
+static inline void json_quoted(struct json_writer_s *w, const char *s)
+{
+  static const char hex[] = "0123456789abcdef";
+
+  json_char(w, '"');
+  for (; *s != '\0'; s++)
+    {
+      unsigned char c = (unsigned char)*s;
+
+      if (c == '"' || c == '\\')
+        {
+          json_char(w, '\\');
+          json_char(w, (char)c);
+        }
+      else if (c < 0x20)
+        {
+          JSON_LIT(w, "\\u00");
+          json_char(w, hex[c >> 4]);
+          json_char(w, hex[c & 0xF]);
+        }
+      else
+        {
+          json_char(w, (char)c);
+        }
+    }
+
+  json_char(w, '"');
+}
+
+/*
+ * Comma (if needed) and "key": prefix for the next member. Keys are
+ * program constants and are emitted verbatim, without escaping.
+ */
+
+static inline void json_member(struct json_writer_s *w, const char *key)
+{
+  uint16_t bit = (uint16_t)(1u << (w->depth & (JSON_MAX_DEPTH - 1)));
+
+  if (w->has_items & bit)
+    {
+      json_char(w, ',');
+    }
+
+  w->has_items |= bit;
+
+  if (key != NULL)
+    {
+      json_char(w, '"');
+      json_raw(w, key, strlen(key));
+      JSON_LIT(w, "\":");
+    }
+}
+
+static inline void json_open(struct json_writer_s *w, const char *key,
+                             char c)
+{
+  json_member(w, key);
+  json_char(w, c);
+  w->depth++;
+  w->has_items &= (uint16_t)~(1u << (w->depth & (JSON_MAX_DEPTH - 1)));
+}
+
+static inline void json_close(struct json_writer_s *w, char c)
+{
+  if (w->depth > 0)
+    {
+      w->depth--;
+    }
+
+  json_char(w, c);
+}
+
+/* ---- Public API: key is NULL for array elements and the root ---- */
+
+static inline void json_begin_object(struct json_writer_s *w,
+                                     const char *key)
+{
+  json_open(w, key, '{');
+}
+
+static inline void json_end_object(struct json_writer_s *w)
+{
+  json_close(w, '}');
+}
+
+static inline void json_begin_array(struct json_writer_s *w,
+                                    const char *key)
+{
+  json_open(w, key, '[');
+}
+
+static inline void json_end_array(struct json_writer_s *w)
+{
+  json_close(w, ']');
+}
+
+static inline void json_str(struct json_writer_s *w, const char *key,
+                            const char *val)
+{
+  json_member(w, key);
+  json_quoted(w, val);
+}
+
+static inline void json_digits(struct json_writer_s *w, uint32_t val)
+{
+  char tmp[10];
+  int i = sizeof(tmp);
+
+  do
+    {
+      tmp[--i] = (char)('0' + val % 10);
+      val /= 10;
+    }
+  while (val != 0);
+
+  json_raw(w, &tmp[i], sizeof(tmp) - i);
+}
+
+static inline void json_uint(struct json_writer_s *w, const char *key,
+                             uint32_t val)
+{
+  json_member(w, key);
+  json_digits(w, val);
+}
+
+static inline void json_int(struct json_writer_s *w, const char *key,
+                            int32_t val)
+{
+  json_member(w, key);
+  if (val < 0)
+    {
+      json_char(w, '-');
+      json_digits(w, (uint32_t)0 - (uint32_t)val);
+    }
+  else
+    {
+      json_digits(w, (uint32_t)val);
+    }
+}
+
+static inline void json_bool(struct json_writer_s *w, const char *key,
+                             bool val)
+{
+  json_member(w, key);
+  if (val)
+    {
+      JSON_LIT(w, "true");
+    }
+  else
+    {
+      JSON_LIT(w, "false");
+    }
+}
+
+/*
+ * Flush the staged chunk. Returns the document length, or the first
+ * sink error (negative errno).
+ */
+static inline int json_finish(struct json_writer_s *w)
+{
+  json_flush(w);
+  return w->error != 0 ? w->error : (int)w->total;
+}
+
+/*
+ * Convenience for memory targets: finish into `b` and NUL-terminate.
+ * Returns the length, or -1 if the document did not fit.
+ */
+static inline int json_finish_buf(struct json_writer_s *w,
+                                  struct json_buf_s *b)
+{
+  int n = json_finish(w);
+
+  if (n < 0 || b->len >= b->size)
+    {
+      return -1;
+    }
+
+  b->buf[b->len] = '\0';
+  return n;
+}
+
+#endif /* __APPS_COMMON_JSON_WRITER_H */
@@ -0,0 +1,218 @@
+/*
+ * apps/common/mmwave_boot.h
+ *
+ * The boot steps the board bring-up runs natively instead of through
+ * rcS, and the dependency bookkeeping between them.
+ *
+ * Each step names the steps it needs (they must succeed, or it is
+ * skipped) and the steps it runs after (they must have finished, either
+ * way). Steps that are not waiting on anything run together: Wi-Fi
+ * association and DHCP in a task of their own while the sensor comes up
+ * and the services start, and each service as soon as what it uses is
+ * there. HA reporting waits for an address, since a first post into a
+ * network that is not up only backs off; the listeners do not, because
+ * they bind the wildcard address.
+ *
+ * Everything here is host-testable: the bring-up owns the tasks and the
+ * step bodies, this only says what may run next.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_BOOT_H
+#define __APPS_COMMON_MMWAVE_BOOT_H
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MMWAVE_BOOT_NATIVE   "boot.native"   /* "0": rcS does it all */
+
+enum mmwave_boot_id_e
+{
+  MMWAVE_BOOT_SENSOR = 0,        /* Driver, tuning watcher */
+  MMWAVE_BOOT_WIFI,              /* Association */
+  MMWAVE_BOOT_DHCP,
+  MMWAVE_BOOT_MMWAVED,
+  MMWAVE_BOOT_HA,
+  MMWAVE_BOOT_ESPHOME,
+  MMWAVE_BOOT_COAP,
+  MMWAVE_BOOT_MCAST,
+  MMWAVE_BOOT_HTTPD,
+  MMWAVE_BOOT_STREAM,
+  MMWAVE_BOOT_PROFILE,
+  MMWAVE_BOOT_NSTEPS
+};
+
+enum mmwave_boot_state_e
+{
+  MMWAVE_BOOT_PENDING = 0,
+  MMWAVE_BOOT_RUNNING,
+  MMWAVE_BOOT_DONE,
+  MMWAVE_BOOT_FAILED,
+  MMWAVE_BOOT_SKIPPED            /* Not wanted, or something it needs */
+};
+
+#define MMWAVE_BOOT_BIT(id)  (1u << (id))
+
+struct mmwave_boot_step_s
+{
+  const char *name;
+  uint16_t needs;                /* Must be DONE */
+  uint16_t after;                /* Must be over, whatever the outcome */
+  bool     async;                /* Blocks: runs in a task of its own */
+};
+
+struct mmwave_boot_s
+{
+  const struct mmwave_boot_step_s *steps;
+  int      nsteps;
+  uint8_t  state[MMWAVE_BOOT_NSTEPS];
+  int      result[MMWAVE_BOOT_NSTEPS];
+};
+
+/* The boot graph. Services open the sensor, and are hosted when the
+ * daemon is up.
+ */
+
+#define MMWAVE_BOOT_SERVICES_AFTER \
+  (MMWAVE_BOOT_BIT(MMWAVE_BOOT_SENSOR) | \
+   MMWAVE_BOOT_BIT(MMWAVE_BOOT_MMWAVED))
+#define MMWAVE_BOOT_NET_AFTER \
+  (MMWAVE_BOOT_SERVICES_AFTER | MMWAVE_BOOT_BIT(MMWAVE_BOOT_DHCP))
+
+static const struct mmwave_boot_step_s g_mmwave_boot_steps[] =
+{
+  { "sensor",  0, 0, false },
+  { "wifi",    0, 0, true },
+  { "dhcp",    MMWAVE_BOOT_BIT(MMWAVE_BOOT_WIFI), 0, true },
+  { "mmwaved", 0, MMWAVE_BOOT_BIT(MMWAVE_BOOT_SENSOR), false },
+  { "hactl",   0, MMWAVE_BOOT_NET_AFTER, false },
+  { "esphome", 0, MMWAVE_BOOT_SERVICES_AFTER, false },
+  { "coap",    0, MMWAVE_BOOT_SERVICES_AFTER, false },
+  { "mcast",   0, MMWAVE_BOOT_NET_AFTER, false },
+  { "httpd",   0, MMWAVE_BOOT_SERVICES_AFTER, false },
+  { "stream",  0, MMWAVE_BOOT_SERVICES_AFTER, false },
+  { "profile", 0, MMWAVE_BOOT_SERVICES_AFTER, false }
+};
+
+static inline bool mmwave_boot_over(uint8_t state)
+{
+  return state >= MMWAVE_BOOT_DONE;
+}
+
+/* wanted: a bit per step to run; the others count as skipped */
+
+static inline void mmwave_boot_init(struct mmwave_boot_s *b,
+                                    const struct mmwave_boot_step_s *steps,
+                                    int nsteps, uint32_t wanted)
+{
+  memset(b, 0, sizeof(*b));
+  b->steps  = steps;
+  b->nsteps = nsteps;
+
+  for (int i = 0; i < nsteps; i++)
+    {
+      b->state[i] = (wanted & MMWAVE_BOOT_BIT(i)) ? MMWAVE_BOOT_PENDING :
+                                                    MMWAVE_BOOT_SKIPPED;
+    }
+}
+
+/**
+ * The next step that may run, now marked running, or -1. Blocking steps
+ * come first, so they are under way before the caller runs the others
+ * inline. Steps whose needs failed or were skipped are skipped on the
+ * way. When nothing is running and nothing can start, whatever is left
+ * waits on itself (a cycle in the graph) and is skipped too, so the boot
+ * always ends.
+ */
+
+static inline int mmwave_boot_next(struct mmwave_boot_s *b)
+{
+  bool running = false;
+  bool pending = false;
+  int i;
+
+  for (int pass = 0; pass < 2; pass++)
+    {
+      for (i = 0; i < b->nsteps; i++)
+        {
+          const struct mmwave_boot_step_s *st = &b->steps[i];
+          bool ready = true;
+
+          if (b->state[i] == MMWAVE_BOOT_RUNNING)
+            {
+              running = true;
+            }
+
+          if (b->state[i] != MMWAVE_BOOT_PENDING ||
+              st->async != (pass == 0))
+            {
+              continue;
+            }
+
+          for (int d = 0; d < b->nsteps; d++)
+            {
+              if ((st->needs & MMWAVE_BOOT_BIT(d)) &&
+                  mmwave_boot_over(b->state[d]) &&
+                  b->state[d] != MMWAVE_BOOT_DONE)
+                {
+                  b->state[i] = MMWAVE_BOOT_SKIPPED;
+                  return mmwave_boot_next(b);   /* May release others */
+                }
+
+              if (((st->needs | st->after) & MMWAVE_BOOT_BIT(d)) &&
+                  !mmwave_boot_over(b->state[d]))
+                {
+                  ready = false;
+                }
+            }
+
+          if (ready)
+            {
+              b->state[i] = MMWAVE_BOOT_RUNNING;
+              return i;
+            }
+
+          pending = true;
+        }
+    }
+
+  if (pending && !running)
+    {
+      for (i = 0; i < b->nsteps; i++)
+        {
+          if (b->state[i] == MMWAVE_BOOT_PENDING)
+            {
+              b->state[i] = MMWAVE_BOOT_SKIPPED;
+            }
+        }
+    }
+
+  return -1;
+}
+
+/* A step is over: a negative errno is a failure */
+
+static inline void mmwave_boot_finish(struct mmwave_boot_s *b, int id,
+                                      int ret)
+{
+  b->state[id]  = ret < 0 ? MMWAVE_BOOT_FAILED : MMWAVE_BOOT_DONE;
+  b->result[id] = ret;
+}
+
+/* Steps running or still to run; the boot is over at 0 */
+
+static inline int mmwave_boot_left(const struct mmwave_boot_s *b)
+{
+  int n = 0;
+
+  for (int i = 0; i < b->nsteps; i++)
+    {
+      n += !mmwave_boot_over(b->state[i]);
+    }
+
+  return n;
+}
+
+#endif /* __APPS_COMMON_MMWAVE_BOOT_H */
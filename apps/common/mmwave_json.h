@@ -0,0 +1,113 @@
+/*
+ * apps/common/mmwave_json.h
+ *
+ * Canonical JSON field names for an LD2410 reading. mmwave -j,
+ * sysinfo -j and the hactl HA attributes all emit sensor values through
+ * this so the names agree everywhere; sysinfo -j adds the boot
+ * milestones and the PM residency.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_JSON_H
+#define __APPS_COMMON_MMWAVE_JSON_H
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/json_writer.h"
+
+static inline bool mmwave_json_presence(const struct mmwave_data_s *d)
+{
+  return d->target_state != LD2410_TARGET_NONE;
+}
+
+static inline const char *mmwave_target_str(uint8_t state)
+{
+  switch (state)
+    {
+      case LD2410_TARGET_NONE:   return "none";
+      case LD2410_TARGET_MOTION: return "motion";
+      case LD2410_TARGET_STATIC: return "static";
+      case LD2410_TARGET_BOTH:   return "motion+static";
+      default:                   return "unknown";
+    }
+}
+
+/* Energy and distance members of the current object */
+
+static inline void mmwave_json_fields(struct json_writer_s *w,
+                                      const struct mmwave_data_s *d)
+{
+  json_uint(w, "motion_energy", d->motion_energy);
+  json_uint(w, "static_energy", d->static_energy);
+  json_uint(w, "motion_distance", d->motion_distance);
+  json_uint(w, "static_distance", d->static_distance);
+  json_uint(w, "detection_distance", d->detection_distance);
+}
+
+static inline const char *mmwave_milestone_str(int id)
+{
+  switch (id)
+    {
+      case MMWAVE_MILESTONE_MOUNT:  return "mount";
+      case MMWAVE_MILESTONE_DRIVER: return "driver";
+      case MMWAVE_MILESTONE_FRAME:  return "first_frame";
+      case MMWAVE_MILESTONE_WIFI:   return "wifi";
+      case MMWAVE_MILESTONE_DHCP:   return "dhcp";
+      case MMWAVE_MILESTONE_REPORT: return "first_report";
+      default:                      return "unknown";
+    }
+}
+
+/* "boot_ms": the milestones reached so far, in ms since boot */
+
+static inline void mmwave_json_boottime(struct json_writer_s *w,
+                                        const struct mmwave_boottime_s *bt)
+{
+  json_begin_object(w, "boot_ms");
+  for (int i = 0; i < MMWAVE_MILESTONES; i++)
+    {
+      if (bt->ms[i] != 0)
+        {
+          json_uint(w, mmwave_milestone_str(i), bt->ms[i]);
+        }
+    }
+
+  json_end_object(w);
+}
+
+static inline const char *mmwave_pm_state_str(int state)
+{
+  switch (state)
+    {
+      case MMWAVE_PM_NORMAL:  return "normal";
+      case MMWAVE_PM_IDLE:    return "idle";
+      case MMWAVE_PM_STANDBY: return "standby";
+      default:                return "unknown";
+    }
+}
+
+/* "pm": the state now, and ms in and entries into each state */
+
+static inline void mmwave_json_pm(struct json_writer_s *w,
+                                  const struct mmwave_pm_stats_s *pm)
+{
+  json_begin_object(w, "pm");
+  json_str(w, "state", mmwave_pm_state_str(pm->state));
+
+  json_begin_object(w, "ms");
+  for (int i = 0; i < MMWAVE_PM_NSTATES; i++)
+    {
+      json_uint(w, mmwave_pm_state_str(i), pm->ms[i]);
+    }
+
+  json_end_object(w);
+
+  json_begin_object(w, "entries");
+  for (int i = 0; i < MMWAVE_PM_NSTATES; i++)
+    {
+      json_uint(w, mmwave_pm_state_str(i), pm->entries[i]);
+    }
+
+  json_end_object(w);
+  json_end_object(w);
+}
+
+#endif /* __APPS_COMMON_MMWAVE_JSON_H */
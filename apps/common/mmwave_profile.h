@@ -0,0 +1,382 @@
+/*
+ * apps/common/mmwave_profile.h
+ *
+ * Named sensor profiles and the rules that switch between them.
+ *
+ * A profile is a whole struct mmwave_config_s in one config key,
+ * profile.<name>, as 44 hex digits: max motion gate, max static gate,
+ * timeout (little-endian), then the nine motion and nine static
+ * thresholds. Loading one is a single MMWAVE_IOC_APPLY_CONFIG, so one
+ * config session with only the commands that differ.
+ *
+ * profile.schedule holds the rules of the scheduler, comma separated:
+ *
+ *   HH:MM=<name>         at that time of day (once the clock is set)
+ *   idle:<secs>=<name>   after that long with nobody present
+ *   presence=<name>      when somebody is detected again
+ *
+ * Everything here is host-testable.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_PROFILE_H
+#define __APPS_COMMON_MMWAVE_PROFILE_H
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+#define MMWAVE_PROFILE_PREFIX    "profile."
+#define MMWAVE_PROFILE_SCHEDULE  "profile.schedule"
+#define MMWAVE_PROFILE_ACTIVE    "mmwave.profile"
+#define MMWAVE_PROFILE_NAME_MAX  15
+#define MMWAVE_PROFILE_BYTES     (4 + 2 * LD2410_MAX_GATES)
+#define MMWAVE_PROFILE_HEX       (2 * MMWAVE_PROFILE_BYTES)
+
+#define MMWAVE_SCHED_RULES       8
+#define MMWAVE_SCHED_MINUTES     (24 * 60)
+
+enum mmwave_sched_kind_e
+{
+  MMWAVE_SCHED_AT = 0,           /* arg: minute of the day */
+  MMWAVE_SCHED_IDLE,             /* arg: seconds without presence */
+  MMWAVE_SCHED_PRESENCE
+};
+
+struct mmwave_sched_rule_s
+{
+  uint8_t  kind;                 /* enum mmwave_sched_kind_e */
+  uint32_t arg;
+  char     name[MMWAVE_PROFILE_NAME_MAX + 1];
+};
+
+struct mmwave_sched_s
+{
+  struct mmwave_sched_rule_s rules[MMWAVE_SCHED_RULES];
+  int      nrules;
+  bool     present;
+  bool     idle_fired;           /* This absence has had its rule */
+  uint32_t absent_ms;            /* When the room last became empty */
+  int      minute;               /* Of the last step, -1 before any */
+};
+
+/* 1-15 of [a-z0-9_-]; "schedule" is the rules' key */
+
+static inline bool mmwave_profile_name_valid(const char *name)
+{
+  size_t len = strlen(name);
+
+  if (len == 0 || len > MMWAVE_PROFILE_NAME_MAX ||
+      strcmp(name, "schedule") == 0)
+    {
+      return false;
+    }
+
+  for (size_t i = 0; i < len; i++)
+    {
+      char c = name[i];
+
+      if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') ||
+            c == '_' || c == '-'))
+        {
+          return false;
+        }
+    }
+
+  return true;
+}
+
+static inline void mmwave_profile_encode(const struct mmwave_config_s *cfg,
+                                         char out[MMWAVE_PROFILE_HEX + 1])
+{
+  static const char hex[] = "0123456789abcdef";
+  uint8_t b[MMWAVE_PROFILE_BYTES];
+
+  b[0] = cfg->max_motion_gate;
+  b[1] = cfg->max_static_gate;
+  b[2] = (uint8_t)(cfg->timeout_s & 0xff);
+  b[3] = (uint8_t)(cfg->timeout_s >> 8);
+  memcpy(&b[4], cfg->motion_sensitivity, LD2410_MAX_GATES);
+  memcpy(&b[4 + LD2410_MAX_GATES], cfg->static_sensitivity,
+         LD2410_MAX_GATES);
+
+  for (int i = 0; i < MMWAVE_PROFILE_BYTES; i++)
+    {
+      out[2 * i]     = hex[b[i] >> 4];
+      out[2 * i + 1] = hex[b[i] & 0x0f];
+    }
+
+  out[MMWAVE_PROFILE_HEX] = '\0';
+}
+
+static inline int mmwave_profile_nibble(char c)
+{
+  if (c >= '0' && c <= '9')
+    {
+      return c - '0';
+    }
+
+  if (c >= 'a' && c <= 'f')
+    {
+      return c - 'a' + 10;
+    }
+
+  return c >= 'A' && c <= 'F' ? c - 'A' + 10 : -1;
+}
+
+/* Returns -EINVAL unless it is a profile the sensor can take */
+
+static inline int mmwave_profile_decode(const char *s,
+                                        struct mmwave_config_s *cfg)
+{
+  uint8_t b[MMWAVE_PROFILE_BYTES];
+
+  if (strlen(s) != MMWAVE_PROFILE_HEX)
+    {
+      return -EINVAL;
+    }
+
+  for (int i = 0; i < MMWAVE_PROFILE_BYTES; i++)
+    {
+      int hi = mmwave_profile_nibble(s[2 * i]);
+      int lo = mmwave_profile_nibble(s[2 * i + 1]);
+
+      if (hi < 0 || lo < 0)
+        {
+          return -EINVAL;
+        }
+
+      b[i] = (uint8_t)(hi << 4 | lo);
+    }
+
+  if (b[0] < 2 || b[0] >= LD2410_MAX_GATES ||
+      b[1] < 2 || b[1] >= LD2410_MAX_GATES)
+    {
+      return -EINVAL;
+    }
+
+  for (int i = 4; i < MMWAVE_PROFILE_BYTES; i++)
+    {
+      if (b[i] > 100)
+        {
+          return -EINVAL;
+        }
+    }
+
+  cfg->max_motion_gate = b[0];
+  cfg->max_static_gate = b[1];
+  cfg->timeout_s       = (uint16_t)(b[2] | b[3] << 8);
+  memcpy(cfg->motion_sensitivity, &b[4], LD2410_MAX_GATES);
+  memcpy(cfg->static_sensitivity, &b[4 + LD2410_MAX_GATES],
+         LD2410_MAX_GATES);
+  return OK;
+}
+
+/* One rule, "<when>=<name>" of len characters */
+
+static inline int mmwave_sched_rule(const char *s, size_t len,
+                                    struct mmwave_sched_rule_s *r)
+{
+  const char *eq = memchr(s, '=', len);
+  size_t wlen;
+  size_t nlen;
+  char when[16];
+  char *end;
+
+  if (eq == NULL)
+    {
+      return -EINVAL;
+    }
+
+  wlen = (size_t)(eq - s);
+  nlen = len - wlen - 1;
+  if (wlen == 0 || wlen >= sizeof(when) || nlen > MMWAVE_PROFILE_NAME_MAX)
+    {
+      return -EINVAL;
+    }
+
+  memcpy(when, s, wlen);
+  when[wlen] = '\0';
+  memcpy(r->name, eq + 1, nlen);
+  r->name[nlen] = '\0';
+  if (!mmwave_profile_name_valid(r->name))
+    {
+      return -EINVAL;
+    }
+
+  if (strcmp(when, "presence") == 0)
+    {
+      r->kind = MMWAVE_SCHED_PRESENCE;
+      r->arg  = 0;
+      return OK;
+    }
+
+  if (strncmp(when, "idle:", 5) == 0)
+    {
+      long secs = when[5] >= '0' && when[5] <= '9' ?
+                  strtol(when + 5, &end, 10) : -1;
+
+      if (secs <= 0 || secs > 86400 || *end != '\0')
+        {
+          return -EINVAL;
+        }
+
+      r->kind = MMWAVE_SCHED_IDLE;
+      r->arg  = (uint32_t)secs;
+      return OK;
+    }
+
+  if (wlen == 5 && when[2] == ':' &&
+      when[0] >= '0' && when[0] <= '2' && when[1] >= '0' &&
+      when[1] <= '9' && when[3] >= '0' && when[3] <= '5' &&
+      when[4] >= '0' && when[4] <= '9')
+    {
+      int minute = ((when[0] - '0') * 10 + when[1] - '0') * 60 +
+                   (when[3] - '0') * 10 + when[4] - '0';
+
+      if (minute >= MMWAVE_SCHED_MINUTES)
+        {
+          return -EINVAL;
+        }
+
+      r->kind = MMWAVE_SCHED_AT;
+      r->arg  = (uint32_t)minute;
+      return OK;
+    }
+
+  return -EINVAL;
+}
+
+/* The whole value of profile.schedule; returns the number of rules */
+
+static inline int mmwave_sched_parse(struct mmwave_sched_s *s,
+                                     const char *str, uint32_t now)
+{
+  memset(s, 0, sizeof(*s));
+  s->absent_ms = now;
+  s->minute    = -1;
+
+  while (*str != '\0')
+    {
+      size_t len = strcspn(str, ",");
+
+      if (s->nrules == MMWAVE_SCHED_RULES ||
+          mmwave_sched_rule(str, len, &s->rules[s->nrules]) < 0)
+        {
+          s->nrules = 0;
+          return -EINVAL;
+        }
+
+      s->nrules++;
+      str += len + (str[len] == ',');
+    }
+
+  return s->nrules;
+}
+
+/* The time rule in force at minute: the latest at or before it */
+
+static inline int mmwave_sched_current(const struct mmwave_sched_s *s,
+                                       int minute)
+{
+  int best = -1;
+  int best_age = MMWAVE_SCHED_MINUTES;
+
+  for (int i = 0; i < s->nrules; i++)
+    {
+      if (s->rules[i].kind == MMWAVE_SCHED_AT)
+        {
+          int age = (minute - (int)s->rules[i].arg +
+                     MMWAVE_SCHED_MINUTES) % MMWAVE_SCHED_MINUTES;
+
+          if (age < best_age)
+            {
+              best     = i;
+              best_age = age;
+            }
+        }
+    }
+
+  return best;
+}
+
+static inline int mmwave_sched_find(const struct mmwave_sched_s *s,
+                                    uint8_t kind)
+{
+  for (int i = 0; i < s->nrules; i++)
+    {
+      if (s->rules[i].kind == kind)
+        {
+          return i;
+        }
+    }
+
+  return -1;
+}
+
+/**
+ * One step of the scheduler: now in ms, minute of the day (-1 while the
+ * clock is not set) and whether anyone is present. Returns the rule to
+ * act on, or -1. The first step with a clock picks the time rule in
+ * force, so a restart at night still lands on the night profile; after
+ * that a time rule fires when its minute comes.
+ */
+
+static inline int mmwave_sched_step(struct mmwave_sched_s *s, uint32_t now,
+                                    int minute, bool present)
+{
+  int fire = -1;
+  int i;
+
+  if (minute >= 0 && minute != s->minute)
+    {
+      if (s->minute < 0)
+        {
+          fire = mmwave_sched_current(s, minute);
+        }
+      else
+        {
+          for (i = 0; i < s->nrules; i++)
+            {
+              if (s->rules[i].kind == MMWAVE_SCHED_AT &&
+                  (int)s->rules[i].arg == minute)
+                {
+                  fire = i;
+                }
+            }
+        }
+
+      s->minute = minute;
+    }
+
+  if (present && !s->present)
+    {
+      i = mmwave_sched_find(s, MMWAVE_SCHED_PRESENCE);
+      fire = i >= 0 ? i : fire;
+    }
+  else if (!present && s->present)
+    {
+      s->absent_ms  = now;
+      s->idle_fired = false;
+    }
+
+  s->present = present;
+  if (!present && !s->idle_fired)
+    {
+      i = mmwave_sched_find(s, MMWAVE_SCHED_IDLE);
+      if (i >= 0 && now - s->absent_ms >= s->rules[i].arg * 1000)
+        {
+          s->idle_fired = true;
+          fire = i;
+        }
+    }
+
+  return fire;
+}
+
+#endif /* __APPS_COMMON_MMWAVE_PROFILE_H */
@@ -0,0 +1,200 @@
+/*
+ * apps/common/mmwave_resume.h
+ *
+ * Deep sleep between events: what the board keeps in RTC memory over a
+ * sleep, so that a wake does not start from nothing, and when it may go
+ * back to sleep.
+ *
+ * Before it sleeps the bring-up seals a struct mmwave_resume_s in
+ * memory that survives deep sleep: the driver's last reading, its copy
+ * of the sensor's configuration and its statistics, the UART it is on,
+ * and the access point and lease Wi-Fi used. On a wake from the LD2410
+ * OUT pin or the timer a valid block is taken instead of asking: the
+ * driver is registered on the retained UART, its configuration copy is
+ * restored (so neither the tuning nor mmwave.uart/baud are looked up
+ * and the sensor is not read back), and Wi-Fi goes straight to the
+ * retained access point and lease. A cold boot, or a block a different
+ * image sealed, is ignored and the boot runs as usual.
+ *
+ *   sleep.idle    seconds with no target, once a report has been made
+ *                 and every transition is delivered or journaled,
+ *                 before the board sleeps; 0 (the default) never
+ *   sleep.wake    seconds until the timer wakes it if OUT does not, so
+ *                 HA still hears from it; 0: OUT only
+ *
+ * Each resume times its first report, kept over the sleeps as the last,
+ * worst and mean resume-to-report latency.
+ *
+ * Everything here is host-testable: the bring-up owns the RTC memory,
+ * the wake sources and the sleep itself.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_RESUME_H
+#define __APPS_COMMON_MMWAVE_RESUME_H
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <errno.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_wifi.h"
+
+#define MMWAVE_SLEEP_KEY_IDLE   "sleep.idle"
+#define MMWAVE_SLEEP_KEY_WAKE   "sleep.wake"
+#define MMWAVE_SLEEP_WAKE_S     900       /* sleep.wake default */
+
+#define MMWAVE_RESUME_MAGIC     0x6d6d7273u     /* "mmrs" */
+#define MMWAVE_RESUME_VERSION   1
+
+/* Retained network state, by bit */
+
+#define MMWAVE_RESUME_AP        0x01
+#define MMWAVE_RESUME_LEASE     0x02
+
+/* Why the board is running */
+
+enum mmwave_wake_e
+{
+  MMWAVE_WAKE_COLD = 0,                 /* Power-on or reset */
+  MMWAVE_WAKE_PIN,                      /* LD2410 OUT went high */
+  MMWAVE_WAKE_TIMER                     /* sleep.wake ran out */
+};
+
+struct mmwave_resume_s
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t size;                        /* Another layout: ignored */
+  uint32_t sleeps;                      /* Since the last cold boot */
+
+  struct mmwave_snapshot_s sensor;
+  char     uart[32];
+  uint32_t baud;
+
+  uint32_t tag;                         /* mmwave_wifi_tag() of the net */
+  uint8_t  net;                         /* MMWAVE_RESUME_xxx */
+  struct mmwave_wifi_ap_s   ap;
+  struct mmwave_wifi_addr_s lease;
+
+  /* Resume to first report, ms */
+
+  uint32_t lat_last;
+  uint32_t lat_max;
+  uint32_t lat_sum;
+  uint32_t lat_n;
+
+  uint32_t crc;                         /* Over everything before it */
+};
+
+static inline FAR const char *mmwave_wake_str(int wake)
+{
+  static const char *const names[] =
+  {
+    "cold boot", "OUT pin", "timer"
+  };
+
+  return wake >= 0 && wake <= MMWAVE_WAKE_TIMER ? names[wake] : "?";
+}
+
+/* FNV-1a over the block up to the crc field */
+
+static inline uint32_t mmwave_resume_crc(FAR const struct mmwave_resume_s *r)
+{
+  FAR const uint8_t *p = (FAR const uint8_t *)r;
+  uint32_t h = 2166136261u;
+
+  for (size_t i = 0; i < offsetof(struct mmwave_resume_s, crc); i++)
+    {
+      h = (h ^ p[i]) * 16777619u;
+    }
+
+  return h;
+}
+
+/* Valid from now on, as it stands; call last, just before sleeping */
+
+static inline void mmwave_resume_seal(FAR struct mmwave_resume_s *r)
+{
+  r->magic   = MMWAVE_RESUME_MAGIC;
+  r->version = MMWAVE_RESUME_VERSION;
+  r->size    = sizeof(*r);
+  r->crc     = mmwave_resume_crc(r);
+}
+
+/**
+ * Whether this boot may resume from r: -ENOENT on a cold boot or when
+ * nothing was sealed, -ESTALE for another image's layout, -EBADMSG if
+ * the block is damaged.
+ */
+
+static inline int mmwave_resume_check(FAR const struct mmwave_resume_s *r,
+                                      int wake)
+{
+  if (wake == MMWAVE_WAKE_COLD || r->magic != MMWAVE_RESUME_MAGIC)
+    {
+      return -ENOENT;
+    }
+
+  if (r->version != MMWAVE_RESUME_VERSION || r->size != sizeof(*r))
+    {
+      return -ESTALE;
+    }
+
+  return r->crc == mmwave_resume_crc(r) ? OK : -EBADMSG;
+}
+
+/* Forget the block: the next boot is cold whatever woke it */
+
+static inline void mmwave_resume_clear(FAR struct mmwave_resume_s *r)
+{
+  memset(r, 0, sizeof(*r));
+}
+
+/* One resume-to-report time */
+
+static inline void mmwave_resume_latency(FAR struct mmwave_resume_s *r,
+                                         uint32_t ms)
+{
+  r->lat_last = ms;
+  if (ms > r->lat_max)
+    {
+      r->lat_max = ms;
+    }
+
+  if (r->lat_sum + ms < r->lat_sum)
+    {
+      r->lat_sum /= 2;                  /* Keep the mean, lose weight */
+      r->lat_n   /= 2;
+    }
+
+  r->lat_sum += ms;
+  r->lat_n++;
+}
+
+static inline uint32_t
+mmwave_resume_latency_avg(FAR const struct mmwave_resume_s *r)
+{
+  return r->lat_n > 0 ? r->lat_sum / r->lat_n : 0;
+}
+
+/**
+ * Whether the board may sleep now: sleep.idle is set, a report went out
+ * this boot, no transition is held only in RAM (unsent: neither
+ * delivered to HA nor journaled to flash, so the sleep would lose it)
+ * and nothing has been seen for idle_ms. A target holds the OUT pin
+ * high, which would wake the board straight away.
+ */
+
+static inline bool mmwave_sleep_due(uint32_t idle_ms, bool reported,
+                                    uint32_t unsent, uint8_t target,
+                                    uint32_t quiet_ms)
+{
+  return idle_ms > 0 && reported && unsent == 0 &&
+         target == LD2410_TARGET_NONE && quiet_ms >= idle_ms;
+}
+
+#endif /* __APPS_COMMON_MMWAVE_RESUME_H */
@@ -0,0 +1,343 @@
+/*
+ * apps/common/mmwave_service.h
+ *
+ * A background service (HA reporting, a network server) written as
+ * callbacks, so the same code runs either in a task of its own
+ * (mmwave_service_run) or hosted by mmwaved in one poll() loop with the
+ * others. Only a service whose callbacks never wait may be hosted: work
+ * that does (a DNS lookup, a sensor command) goes to a short-lived task
+ * whose result a later callback picks up.
+ *
+ *   start    open sockets and reset state; a negative errno is retried
+ *            with backoff when mmwaved hosts the service
+ *   pollset  fill exactly nfds pollfds (fd -1 for an unused entry); the
+ *            same entries come back to events() after poll()
+ *   events   handle revents; a negative errno means the service is
+ *            broken and is stopped (and restarted by mmwaved)
+ *   frame    a new sensor frame; gates is true when eng carries per-gate
+ *            energies (engineering mode)
+ *   tick     periodic work; returns ms until it wants the next tick
+ *   stop     close everything
+ *
+ * pollset/events may be NULL when nfds is 0, tick when there is no
+ * periodic work. `running` is the app's own flag: set while the service
+ * runs wherever it runs, cleared by `<app> stop`, which is all either
+ * host needs to wind it down.
+ *
+ * mmwaved_request() is the client end of mmwaved's control socket. It
+ * returns -ESRCH when no daemon answers, and callers then do the work
+ * themselves as they did before the daemon existed.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_SERVICE_H
+#define __APPS_COMMON_MMWAVE_SERVICE_H
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+
+#ifdef CONFIG_MMWAVED_CMD
+#  include <sys/socket.h>
+#  include <sys/un.h>
+#endif
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+#ifndef CONFIG_MMWAVED_CTL_PATH
+#  define CONFIG_MMWAVED_CTL_PATH  "/var/mmwaved"
+#endif
+
+#define MMWAVE_SERVICE_DEV         "/dev/mmwave0"
+#define MMWAVE_SERVICE_NFDS_MAX    9     /* httpd: 8 slots + listener */
+#define MMWAVE_SERVICE_IDLE_MS     500   /* Longest sleep without a tick */
+
+/* Control protocol: one request line, one reply line, then close */
+
+#define MMWAVED_LINE_MAX           80
+#define MMWAVED_TIMEOUT_MS         3000
+
+struct mmwave_service_s
+{
+  const char *name;
+  volatile bool *running;
+  uint8_t  nfds;
+  uint16_t stack;        /* Stack of its own task when not hosted */
+  int      (*start)(void);
+  void     (*pollset)(struct pollfd *pfds);
+  int      (*events)(const struct pollfd *pfds, uint32_t now);
+  void     (*frame)(const struct mmwave_eng_data_s *eng, bool gates,
+                    uint32_t now);
+  uint32_t (*tick)(uint32_t now);
+  void     (*stop)(void);
+};
+
+/* The one clock every service reads: CLOCK_MONOTONIC, in us and in ms
+ * (the ms wrap every 49 days; compare them by difference)
+ */
+
+static inline uint64_t mmwave_service_now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static inline uint32_t mmwave_service_now_ms(void)
+{
+  return (uint32_t)(mmwave_service_now_us() / 1000);
+}
+
+/* Read the frame poll() reported; returns true if it was usable */
+
+static inline bool mmwave_service_read(int fd,
+                                       struct mmwave_eng_data_s *eng,
+                                       bool *gates)
+{
+  ssize_t n = read(fd, eng, sizeof(*eng));
+
+  /* The driver hands back gate energies only when asked for the larger
+   * struct and engineering mode is on.
+   */
+
+  *gates = n == sizeof(*eng);
+  return n == sizeof(*eng) || n == sizeof(struct mmwave_data_s);
+}
+
+/*
+ * Run one service in the calling task until its running flag is cleared
+ * or it fails. The task sleeps in poll() on the sensor (woken per frame)
+ * and the service's own sockets, bounded by the next tick.
+ */
+
+static inline int mmwave_service_run(const struct mmwave_service_s *svc)
+{
+  struct pollfd pfds[MMWAVE_SERVICE_NFDS_MAX + 1];
+  struct mmwave_eng_data_s eng;
+  uint32_t next_tick;
+  bool gates;
+  int sensorfd;
+  int ret;
+
+  sensorfd = open(MMWAVE_SERVICE_DEV, O_RDONLY);
+  if (sensorfd < 0)
+    {
+      fprintf(stderr, "%s: cannot open sensor\n", svc->name);
+      *svc->running = false;
+      return EXIT_FAILURE;
+    }
+
+  ret = svc->nfds <= MMWAVE_SERVICE_NFDS_MAX ? svc->start() : -E2BIG;
+  if (ret < 0)
+    {
+      fprintf(stderr, "%s: cannot start: %d\n", svc->name, ret);
+      close(sensorfd);
+      *svc->running = false;
+      return EXIT_FAILURE;
+    }
+
+  next_tick = mmwave_service_now_ms();
+
+  while (*svc->running)
+    {
+      uint32_t now = mmwave_service_now_ms();
+      int32_t timeout = MMWAVE_SERVICE_IDLE_MS;
+
+      if (svc->tick != NULL)
+        {
+          if ((int32_t)(now - next_tick) >= 0)
+            {
+              next_tick = now + svc->tick(now);
+            }
+
+          if ((int32_t)(next_tick - now) < timeout)
+            {
+              timeout = (int32_t)(next_tick - now);
+            }
+        }
+
+      pfds[0].fd     = sensorfd;
+      pfds[0].events = POLLIN;
+      if (svc->nfds > 0)
+        {
+          svc->pollset(&pfds[1]);
+        }
+
+      for (int i = 0; i <= svc->nfds; i++)
+        {
+          pfds[i].revents = 0;
+        }
+
+      if (poll(pfds, svc->nfds + 1, timeout) < 0 && errno != EINTR)
+        {
+          fprintf(stderr, "%s: poll failed: %d\n", svc->name, errno);
+          break;
+        }
+
+      now = mmwave_service_now_ms();
+      if ((pfds[0].revents & POLLIN) &&
+          mmwave_service_read(sensorfd, &eng, &gates) &&
+          svc->frame != NULL)
+        {
+          svc->frame(&eng, gates, now);
+        }
+
+      if (svc->nfds > 0 && (ret = svc->events(&pfds[1], now)) < 0)
+        {
+          fprintf(stderr, "%s: failed: %d\n", svc->name, ret);
+          break;
+        }
+    }
+
+  svc->stop();
+  close(sensorfd);
+  *svc->running = false;
+  return OK;
+}
+
+/*
+ * Reply line: "OK [text]" or "ERR <errno>". Copies text (may be empty)
+ * to out and returns OK, or returns the daemon's negative errno, or
+ * -EPROTO for anything else.
+ */
+
+static inline int mmwaved_parse_reply(const char *line, char *out,
+                                      size_t size)
+{
+  if (strncmp(line, "OK", 2) == 0 && (line[2] == '\0' || line[2] == ' '))
+    {
+      if (out != NULL && size > 0)
+        {
+          snprintf(out, size, "%s", line[2] == ' ' ? line + 3 : "");
+        }
+
+      return OK;
+    }
+
+  if (strncmp(line, "ERR ", 4) == 0)
+    {
+      int err = atoi(line + 4);
+      return err > 0 ? -err : -EPROTO;
+    }
+
+  return -EPROTO;
+}
+
+#ifdef CONFIG_MMWAVED_CMD
+/* Send one request to mmwaved and wait for its reply */
+
+static inline int mmwaved_request(const char *req, char *out, size_t size)
+{
+  struct sockaddr_un addr;
+  struct pollfd pfd;
+  char line[MMWAVED_LINE_MAX];
+  size_t len = 0;
+  int fd;
+
+  fd = socket(AF_LOCAL, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      return -ESRCH;
+    }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_LOCAL;
+  strlcpy(addr.sun_path, CONFIG_MMWAVED_CTL_PATH, sizeof(addr.sun_path));
+
+  if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      close(fd);
+      return -ESRCH;
+    }
+
+  snprintf(line, sizeof(line), "%s\n", req);
+  if (send(fd, line, strlen(line), 0) < 0)
+    {
+      close(fd);
+      return -ESRCH;
+    }
+
+  pfd.fd     = fd;
+  pfd.events = POLLIN;
+
+  while (len < sizeof(line) - 1)
+    {
+      ssize_t n;
+
+      if (poll(&pfd, 1, MMWAVED_TIMEOUT_MS) <= 0)
+        {
+          close(fd);
+          return -ETIMEDOUT;
+        }
+
+      n = recv(fd, line + len, sizeof(line) - 1 - len, 0);
+      if (n <= 0)
+        {
+          break;
+        }
+
+      len += n;
+      if (memchr(line, '\n', len) != NULL)
+        {
+          break;
+        }
+    }
+
+  close(fd);
+  line[len] = '\0';
+  line[strcspn(line, "\r\n")] = '\0';
+  return mmwaved_parse_reply(line, out, size);
+}
+#else
+static inline int mmwaved_request(const char *req, char *out, size_t size)
+{
+  return -ESRCH;
+}
+#endif
+
+/*
+ * `<app> start`: have mmwaved host the service when the daemon is up.
+ * Returns OK if it does, -ESRCH if there is no daemon (the caller then
+ * starts a task of its own), or the daemon's error.
+ */
+
+static inline int mmwave_service_delegate(const struct mmwave_service_s *svc)
+{
+  char req[MMWAVED_LINE_MAX];
+  char reply[MMWAVED_LINE_MAX];
+  int ret;
+
+  snprintf(req, sizeof(req), "start %s", svc->name);
+  ret = mmwaved_request(req, reply, sizeof(reply));
+  if (ret == OK)
+    {
+      printf("%s: hosted by mmwaved (%s)\n", svc->name, reply);
+    }
+  else if (ret != -ESRCH)
+    {
+      fprintf(stderr, "%s: mmwaved refused: %d\n", svc->name, ret);
+    }
+
+  return ret;
+}
+
+/* `<app> stop`: wait for mmwaved if it hosts the service, else the flag */
+
+static inline void mmwave_service_stop(const struct mmwave_service_s *svc)
+{
+  char req[MMWAVED_LINE_MAX];
+
+  snprintf(req, sizeof(req), "stop %s", svc->name);
+  if (mmwaved_request(req, NULL, 0) != OK)
+    {
+      *svc->running = false;
+    }
+}
+
+#endif /* __APPS_COMMON_MMWAVE_SERVICE_H */
@@ -0,0 +1,165 @@
+/*
+ * apps/common/mmwave_sha1.h
+ *
+ * SHA-1 (FIPS 180-4), the one copy in the image: the WebSocket
+ * handshake's Sec-WebSocket-Accept (apps/hactl/ha_ws.h) and the WPA2
+ * PMK's PBKDF2 (apps/common/wpa_pmk.h) both hash with it. Neither needs
+ * it to be secret-grade fast, and neither may depend on mbedTLS being
+ * built in.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_SHA1_H
+#define __APPS_COMMON_MMWAVE_SHA1_H
+
+#include <nuttx/config.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define MMWAVE_SHA1_LEN     20
+#define MMWAVE_SHA1_BLOCK   64
+
+struct mmwave_sha1_s
+{
+  uint32_t h[5];
+  uint64_t total;                       /* Bytes hashed */
+  uint8_t  n;                           /* Bytes in blk[] */
+  uint8_t  blk[MMWAVE_SHA1_BLOCK];
+};
+
+static inline uint32_t mmwave_sha1_rol(uint32_t x, int s)
+{
+  return (x << s) | (x >> (32 - s));
+}
+
+static inline void mmwave_sha1_block(FAR struct mmwave_sha1_s *c)
+{
+  uint32_t w[16];
+  uint32_t a = c->h[0];
+  uint32_t b = c->h[1];
+  uint32_t d = c->h[3];
+  uint32_t e = c->h[4];
+  uint32_t cc = c->h[2];
+
+  for (int i = 0; i < 16; i++)
+    {
+      w[i] = (uint32_t)c->blk[4 * i] << 24 |
+             (uint32_t)c->blk[4 * i + 1] << 16 |
+             (uint32_t)c->blk[4 * i + 2] << 8 |
+             (uint32_t)c->blk[4 * i + 3];
+    }
+
+  for (int i = 0; i < 80; i++)
+    {
+      uint32_t f;
+      uint32_t k;
+      uint32_t t;
+
+      if (i >= 16)
+        {
+          w[i & 15] = mmwave_sha1_rol(w[(i + 13) & 15] ^ w[(i + 8) & 15] ^
+                                      w[(i + 2) & 15] ^ w[i & 15], 1);
+        }
+
+      if (i < 20)
+        {
+          f = (b & cc) | (~b & d);
+          k = 0x5a827999;
+        }
+      else if (i < 40)
+        {
+          f = b ^ cc ^ d;
+          k = 0x6ed9eba1;
+        }
+      else if (i < 60)
+        {
+          f = (b & cc) | (b & d) | (cc & d);
+          k = 0x8f1bbcdc;
+        }
+      else
+        {
+          f = b ^ cc ^ d;
+          k = 0xca62c1d6;
+        }
+
+      t  = mmwave_sha1_rol(a, 5) + f + e + k + w[i & 15];
+      e  = d;
+      d  = cc;
+      cc = mmwave_sha1_rol(b, 30);
+      b  = a;
+      a  = t;
+    }
+
+  c->h[0] += a;
+  c->h[1] += b;
+  c->h[2] += cc;
+  c->h[3] += d;
+  c->h[4] += e;
+  c->n = 0;
+}
+
+static inline void mmwave_sha1_init(FAR struct mmwave_sha1_s *c)
+{
+  c->h[0]  = 0x67452301;
+  c->h[1]  = 0xefcdab89;
+  c->h[2]  = 0x98badcfe;
+  c->h[3]  = 0x10325476;
+  c->h[4]  = 0xc3d2e1f0;
+  c->total = 0;
+  c->n     = 0;
+}
+
+static inline void mmwave_sha1_update(FAR struct mmwave_sha1_s *c,
+                                      FAR const void *data, size_t len)
+{
+  FAR const uint8_t *p = (FAR const uint8_t *)data;
+
+  c->total += len;
+  while (len > 0)
+    {
+      size_t take = MMWAVE_SHA1_BLOCK - c->n;
+
+      if (take > len)
+        {
+          take = len;
+        }
+
+      memcpy(&c->blk[c->n], p, take);
+      c->n += take;
+      p    += take;
+      len  -= take;
+      if (c->n == MMWAVE_SHA1_BLOCK)
+        {
+          mmwave_sha1_block(c);
+        }
+    }
+}
+
+static inline void mmwave_sha1_final(FAR struct mmwave_sha1_s *c,
+                                     FAR uint8_t *out)
+{
+  uint64_t bits = c->total * 8;
+
+  c->blk[c->n++] = 0x80;
+  if (c->n > 56)
+    {
+      memset(&c->blk[c->n], 0, MMWAVE_SHA1_BLOCK - c->n);
+      mmwave_sha1_block(c);
+    }
+
+  memset(&c->blk[c->n], 0, 56 - c->n);
+  for (int i = 0; i < 8; i++)
+    {
+      c->blk[63 - i] = (uint8_t)(bits >> (8 * i));
+    }
+
+  mmwave_sha1_block(c);
+
+  for (int i = 0; i < MMWAVE_SHA1_LEN; i++)
+    {
+      out[i] = (uint8_t)(c->h[i / 4] >> (24 - 8 * (i % 4)));
+    }
+}
+
+#endif /* __APPS_COMMON_MMWAVE_SHA1_H */
@@ -0,0 +1,255 @@
+/*
+ * apps/common/mmwave_tune.h
+ *
+ * The sensor's tuning as config keys, so it survives a power cycle and
+ * is applied at boot and on every change (see mmwave_bringup.c):
+ *
+ *   mmwave.max_motion    farthest motion gate, 2-8
+ *   mmwave.max_static    farthest static gate, 2-8
+ *   mmwave.timeout       seconds without presence before "none"
+ *   mmwave.motion_sens   nine motion thresholds 0-100, gate 0 first
+ *   mmwave.static_sens   nine static thresholds, likewise
+ *
+ * A key that is not set leaves that part of the sensor as it is. Key i
+ * of the table is bit 1 << i of MMWAVE_APPLY_xxx. Everything but
+ * mmwave_tune_load() and mmwave_tune_save() is host-testable.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_TUNE_H
+#define __APPS_COMMON_MMWAVE_TUNE_H
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+#ifdef CONFIG_CONFIG_CMD
+#  include <syslog.h>
+#  include "apps/config/config_svc.h"
+#endif
+
+#define MMWAVE_TUNE_PREFIX    "mmwave."
+#define MMWAVE_TUNE_KEYS      5
+#define MMWAVE_TUNE_LIST_MAX  (LD2410_MAX_GATES * 4)
+
+/* Values of the keys as strings, and key/value pairs pointing at them */
+
+struct mmwave_tune_kv_s
+{
+  char max_motion[4];
+  char max_static[4];
+  char timeout[6];
+  char motion[MMWAVE_TUNE_LIST_MAX];
+  char stat[MMWAVE_TUNE_LIST_MAX];
+  FAR const char *kv[2 * MMWAVE_TUNE_KEYS];
+};
+
+static inline FAR const char *mmwave_tune_key(int i)
+{
+  static const char *const keys[MMWAVE_TUNE_KEYS] =
+  {
+    "mmwave.max_motion", "mmwave.max_static", "mmwave.timeout",
+    "mmwave.motion_sens", "mmwave.static_sens"
+  };
+
+  return i >= 0 && i < MMWAVE_TUNE_KEYS ? keys[i] : NULL;
+}
+
+/* A whole decimal number in [min, max], or -1 */
+
+static inline long mmwave_tune_num(FAR const char *s, long min, long max)
+{
+  FAR char *end;
+  long n;
+
+  if (*s < '0' || *s > '9')
+    {
+      return -1;
+    }
+
+  n = strtol(s, &end, 10);
+  return *end == '\0' && n >= min && n <= max ? n : -1;
+}
+
+/* Exactly one threshold per gate, comma separated: "50,50,40,..." */
+
+static inline int mmwave_tune_parse_list(FAR const char *s,
+                                         FAR uint8_t *out)
+{
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      char num[4];
+      size_t len = strcspn(s, ",");
+
+      if (len == 0 || len >= sizeof(num) ||
+          (s[len] == '\0') != (g == LD2410_MAX_GATES - 1))
+        {
+          return -EINVAL;
+        }
+
+      memcpy(num, s, len);
+      num[len] = '\0';
+
+      long v = mmwave_tune_num(num, 0, 100);
+      if (v < 0)
+        {
+          return -EINVAL;
+        }
+
+      out[g] = (uint8_t)v;
+      s += len + (s[len] == ',');
+    }
+
+  return OK;
+}
+
+/**
+ * Take one config key into req: 1 when it is a tuning key (its mask bit
+ * set), 0 when it is not, -EINVAL for a value the sensor cannot take.
+ */
+
+static inline int mmwave_tune_parse(FAR const char *key, FAR const char *val,
+                                    FAR struct mmwave_apply_s *req)
+{
+  FAR struct mmwave_config_s *cfg = &req->cfg;
+  long n = 0;
+  int i;
+
+  for (i = 0; i < MMWAVE_TUNE_KEYS; i++)
+    {
+      if (strcmp(key, mmwave_tune_key(i)) == 0)
+        {
+          break;
+        }
+    }
+
+  switch (1 << i)
+    {
+      case MMWAVE_APPLY_MAX_MOTION:
+      case MMWAVE_APPLY_MAX_STATIC:
+        n = mmwave_tune_num(val, 2, LD2410_MAX_GATES - 1);
+        break;
+
+      case MMWAVE_APPLY_TIMEOUT:
+        n = mmwave_tune_num(val, 0, 65535);
+        break;
+
+      case MMWAVE_APPLY_MOTION_SENS:
+        n = mmwave_tune_parse_list(val, cfg->motion_sensitivity);
+        break;
+
+      case MMWAVE_APPLY_STATIC_SENS:
+        n = mmwave_tune_parse_list(val, cfg->static_sensitivity);
+        break;
+
+      default:
+        return 0;
+    }
+
+  if (n < 0)
+    {
+      return -EINVAL;
+    }
+
+  if (i == 0)
+    {
+      cfg->max_motion_gate = (uint8_t)n;
+    }
+  else if (i == 1)
+    {
+      cfg->max_static_gate = (uint8_t)n;
+    }
+  else if (i == 2)
+    {
+      cfg->timeout_s = (uint16_t)n;
+    }
+
+  req->mask |= 1 << i;
+  return 1;
+}
+
+static inline void mmwave_tune_format_list(FAR const uint8_t *v,
+                                           FAR char *buf)
+{
+  int pos = 0;
+
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      pos += sprintf(buf + pos, g > 0 ? ",%u" : "%u", v[g]);
+    }
+}
+
+/* The keys of mask for cfg, as pairs in t->kv; returns how many */
+
+static inline int mmwave_tune_format(FAR const struct mmwave_config_s *cfg,
+                                     uint8_t mask,
+                                     FAR struct mmwave_tune_kv_s *t)
+{
+  FAR const char *vals[MMWAVE_TUNE_KEYS];
+  int npairs = 0;
+
+  snprintf(t->max_motion, sizeof(t->max_motion), "%u",
+           cfg->max_motion_gate);
+  snprintf(t->max_static, sizeof(t->max_static), "%u",
+           cfg->max_static_gate);
+  snprintf(t->timeout, sizeof(t->timeout), "%u", cfg->timeout_s);
+  mmwave_tune_format_list(cfg->motion_sensitivity, t->motion);
+  mmwave_tune_format_list(cfg->static_sensitivity, t->stat);
+
+  vals[0] = t->max_motion;
+  vals[1] = t->max_static;
+  vals[2] = t->timeout;
+  vals[3] = t->motion;
+  vals[4] = t->stat;
+
+  for (int i = 0; i < MMWAVE_TUNE_KEYS; i++)
+    {
+      if (mask & (1 << i))
+        {
+          t->kv[2 * npairs]     = mmwave_tune_key(i);
+          t->kv[2 * npairs + 1] = vals[i];
+          npairs++;
+        }
+    }
+
+  return npairs;
+}
+
+#ifdef CONFIG_CONFIG_CMD
+/* The tuning keys that are set, from the config service (RAM only) */
+
+static inline int mmwave_tune_load(FAR struct mmwave_apply_s *req)
+{
+  char val[MMWAVE_TUNE_LIST_MAX];
+
+  memset(req, 0, sizeof(*req));
+  for (int i = 0; i < MMWAVE_TUNE_KEYS; i++)
+    {
+      if (config_svc_get(mmwave_tune_key(i), val, sizeof(val)) > 0 &&
+          mmwave_tune_parse(mmwave_tune_key(i), val, req) < 0)
+        {
+          syslog(LOG_WARNING, "mmwave: ignoring %s=%s\n",
+                 mmwave_tune_key(i), val);
+        }
+    }
+
+  return req->mask;
+}
+
+/* Persist the fields of mask in one transaction */
+
+static inline int mmwave_tune_save(FAR const struct mmwave_config_s *cfg,
+                                   uint8_t mask)
+{
+  struct mmwave_tune_kv_s t;
+  int npairs = mmwave_tune_format(cfg, mask, &t);
+
+  return npairs > 0 ? config_svc_set_many(t.kv, npairs) : OK;
+}
+#endif
+
+#endif /* __APPS_COMMON_MMWAVE_TUNE_H */
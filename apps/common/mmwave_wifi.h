@@ -0,0 +1,391 @@
+/*
+ * apps/common/mmwave_wifi.h
+ *
+ * Fast Wi-Fi reconnect: what the last good connection learnt, kept as
+ * config keys, and the order the boot sequencer tries things in.
+ *
+ *   wifi.cache    the access point joined: "bssid,channel,pmk,tag",
+ *                 e.g. "a4:2b:b0:11:22:33,6,<64 hex digits>,1c0ffee5"
+ *   wifi.lease    the last DHCP lease: "ip,netmask,router,dns,tag"
+ *   wifi.static   set by hand for a fixed address: "ip,netmask,router,
+ *                 dns"; DHCP is not run at all
+ *
+ * The tag is a hash of wifi.ssid and wifi.psk: a cache written for other
+ * credentials is ignored, so changing either starts from a full scan.
+ *
+ * Joining tries the cached access point first: BSSID and channel fixed,
+ * so the driver probes one channel instead of scanning all of them, and
+ * the PMK instead of the passphrase, so it skips the 4096 rounds of
+ * PBKDF2. If that fails (the AP moved channel, another AP answers now)
+ * it falls back to a full scan with the passphrase, and the caller
+ * caches what it joined. Addressing takes wifi.static if it is set;
+ * otherwise the cached lease is put on the interface straight away and
+ * DHCP runs behind it to confirm or replace it, and only without a lease
+ * does the boot wait for DHCP.
+ *
+ * Everything here is host-testable: the bring-up supplies the driver
+ * and DHCP calls through struct mmwave_wifi_ops_s.
+ */
+
+#ifndef __APPS_COMMON_MMWAVE_WIFI_H
+#define __APPS_COMMON_MMWAVE_WIFI_H
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <arpa/inet.h>
+
+#include "apps/common/wpa_pmk.h"
+
+#define MMWAVE_WIFI_KEY_CACHE  "wifi.cache"
+#define MMWAVE_WIFI_KEY_LEASE  "wifi.lease"
+#define MMWAVE_WIFI_KEY_STATIC "wifi.static"
+
+#define MMWAVE_WIFI_CACHE_MAX  96       /* 17 + 2 + 64 + 8 and commas */
+#define MMWAVE_WIFI_ADDR_MAX   72       /* Four addresses and a tag */
+
+struct mmwave_wifi_ap_s
+{
+  uint8_t bssid[6];
+  uint8_t channel;                      /* 1-14 */
+  char    pmk[WPA_PMK_HEX + 1];         /* "": use the passphrase */
+};
+
+/* IPv4 addresses in network order, as struct in_addr holds them */
+
+struct mmwave_wifi_addr_s
+{
+  uint32_t ip;
+  uint32_t netmask;
+  uint32_t router;
+  uint32_t dns;
+};
+
+/* How the connection was made, for the log */
+
+enum mmwave_wifi_how_e
+{
+  MMWAVE_WIFI_DIRECTED = 0,             /* The cached AP */
+  MMWAVE_WIFI_SCANNED,                  /* Full scan */
+  MMWAVE_WIFI_STATIC,                   /* wifi.static */
+  MMWAVE_WIFI_REUSED,                   /* Cached lease, DHCP behind it */
+  MMWAVE_WIFI_LEASED                    /* Waited for DHCP */
+};
+
+struct mmwave_wifi_ops_s
+{
+  /* Associate; ap NULL: scan and use the passphrase. Blocks. */
+
+  int (*join)(FAR void *arg, FAR const struct mmwave_wifi_ap_s *ap);
+
+  /* BSSID and channel of the AP now joined */
+
+  int (*joined)(FAR void *arg, FAR struct mmwave_wifi_ap_s *ap);
+
+  int (*set_addr)(FAR void *arg,
+                  FAR const struct mmwave_wifi_addr_s *addr);
+
+  /* Start the DHCP client; wait: until the first lease is on */
+
+  int (*dhcp)(FAR void *arg, bool wait);
+  FAR void *arg;
+};
+
+static inline FAR const char *mmwave_wifi_how_str(int how)
+{
+  static const char *const names[] =
+  {
+    "cached AP", "full scan", "static address", "cached lease", "DHCP"
+  };
+
+  return how >= 0 && how <= MMWAVE_WIFI_LEASED ? names[how] : "?";
+}
+
+/* FNV-1a over ssid, a separator and psk */
+
+static inline uint32_t mmwave_wifi_tag(FAR const char *ssid,
+                                       FAR const char *psk)
+{
+  uint32_t h = 2166136261u;
+
+  for (FAR const char *p = ssid; *p != '\0'; p++)
+    {
+      h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+
+  h = (h ^ 0xff) * 16777619u;
+  for (FAR const char *p = psk; *p != '\0'; p++)
+    {
+      h = (h ^ (uint8_t)*p) * 16777619u;
+    }
+
+  return h;
+}
+
+/* Wi-Fi channel from the frequency in MHz (2.4 GHz band), 0 if none */
+
+static inline int mmwave_wifi_channel(uint32_t mhz)
+{
+  if (mhz == 2484)
+    {
+      return 14;
+    }
+
+  if (mhz >= 2412 && mhz <= 2472 && (mhz - 2412) % 5 == 0)
+    {
+      return (int)(mhz - 2412) / 5 + 1;
+    }
+
+  return 0;
+}
+
+static inline uint32_t mmwave_wifi_mhz(int channel)
+{
+  return channel == 14 ? 2484 : 2407 + 5 * (uint32_t)channel;
+}
+
+/* The next comma-separated field of *s into buf; -EINVAL if too long */
+
+static inline int mmwave_wifi_field(FAR const char **s, FAR char *buf,
+                                    size_t size)
+{
+  size_t n = strcspn(*s, ",");
+
+  if (n >= size)
+    {
+      return -EINVAL;
+    }
+
+  memcpy(buf, *s, n);
+  buf[n] = '\0';
+  *s += n + ((*s)[n] == ',');
+  return (int)n;
+}
+
+/* The tag field, last: -ESTALE if it is not tag */
+
+static inline int mmwave_wifi_check_tag(FAR const char *s, uint32_t tag)
+{
+  FAR char *end;
+  unsigned long t;
+
+  if (*s == '\0')
+    {
+      return -EINVAL;
+    }
+
+  t = strtoul(s, &end, 16);
+  if (*end != '\0' || end - s != 8)
+    {
+      return -EINVAL;
+    }
+
+  return (uint32_t)t == tag ? OK : -ESTALE;
+}
+
+/* ---- wifi.cache ---- */
+
+static inline int mmwave_wifi_format_ap(
+    FAR const struct mmwave_wifi_ap_s *ap, uint32_t tag, FAR char *buf,
+    size_t size)
+{
+  FAR const uint8_t *b = ap->bssid;
+
+  return snprintf(buf, size,
+                  "%02x:%02x:%02x:%02x:%02x:%02x,%u,%s,%08lx",
+                  b[0], b[1], b[2], b[3], b[4], b[5], ap->channel,
+                  ap->pmk, (unsigned long)tag);
+}
+
+/* -EINVAL for a malformed value, -ESTALE for other credentials */
+
+static inline int mmwave_wifi_parse_ap(FAR const char *s, uint32_t tag,
+                                       FAR struct mmwave_wifi_ap_s *ap)
+{
+  char field[WPA_PMK_HEX + 1];
+  unsigned int b[6];
+  char extra;
+  long ch;
+  int n;
+
+  memset(ap, 0, sizeof(*ap));
+
+  if (mmwave_wifi_field(&s, field, sizeof(field)) != 17 ||
+      sscanf(field, "%2x:%2x:%2x:%2x:%2x:%2x%c", &b[0], &b[1], &b[2],
+             &b[3], &b[4], &b[5], &extra) != 6)
+    {
+      return -EINVAL;
+    }
+
+  for (int i = 0; i < 6; i++)
+    {
+      ap->bssid[i] = (uint8_t)b[i];
+    }
+
+  if (mmwave_wifi_field(&s, field, sizeof(field)) <= 0)
+    {
+      return -EINVAL;
+    }
+
+  ch = strtol(field, NULL, 10);
+  if (ch < 1 || ch > 14 || strspn(field, "0123456789") != strlen(field))
+    {
+      return -EINVAL;
+    }
+
+  ap->channel = (uint8_t)ch;
+
+  n = mmwave_wifi_field(&s, field, sizeof(field));
+  if ((n != 0 && n != WPA_PMK_HEX) ||
+      strspn(field, "0123456789abcdef") != (size_t)n)
+    {
+      return -EINVAL;
+    }
+
+  memcpy(ap->pmk, field, n + 1);
+  return mmwave_wifi_check_tag(s, tag);
+}
+
+/* ---- wifi.lease and wifi.static ---- */
+
+/* tag 0 leaves the tag out, for wifi.static */
+
+static inline int mmwave_wifi_format_addr(
+    FAR const struct mmwave_wifi_addr_s *a, uint32_t tag, FAR char *buf,
+    size_t size)
+{
+  FAR const uint32_t *v[4] =
+  {
+    &a->ip, &a->netmask, &a->router, &a->dns
+  };
+
+  char ip[4][INET_ADDRSTRLEN];
+
+  for (int i = 0; i < 4; i++)
+    {
+      inet_ntop(AF_INET, v[i], ip[i], INET_ADDRSTRLEN);
+    }
+
+  if (tag == 0)
+    {
+      return snprintf(buf, size, "%s,%s,%s,%s", ip[0], ip[1], ip[2],
+                      ip[3]);
+    }
+
+  return snprintf(buf, size, "%s,%s,%s,%s,%08lx", ip[0], ip[1], ip[2],
+                  ip[3], (unsigned long)tag);
+}
+
+/* tag 0: no tag expected. The address must be set; the rest may be
+ * 0.0.0.0.
+ */
+
+static inline int mmwave_wifi_parse_addr(FAR const char *s, uint32_t tag,
+                                         FAR struct mmwave_wifi_addr_s *a)
+{
+  FAR uint32_t *v[4] =
+  {
+    &a->ip, &a->netmask, &a->router, &a->dns
+  };
+
+  char field[INET_ADDRSTRLEN];
+
+  memset(a, 0, sizeof(*a));
+  for (int i = 0; i < 4; i++)
+    {
+      if (mmwave_wifi_field(&s, field, sizeof(field)) <= 0 ||
+          inet_pton(AF_INET, field, v[i]) != 1)
+        {
+          return -EINVAL;
+        }
+    }
+
+  if (a->ip == 0)
+    {
+      return -EINVAL;
+    }
+
+  if (tag == 0)
+    {
+      return *s == '\0' ? OK : -EINVAL;
+    }
+
+  return mmwave_wifi_check_tag(s, tag);
+}
+
+/* ---- Sequencing ---- */
+
+/**
+ * Associate: the cached AP if there is one, then a full scan. ap is the
+ * cache, valid if cached, and receives what was joined; *how says
+ * which. After a scan the caller writes wifi.cache again, with the PMK
+ * from wpa_pmk_hex() if the network has a passphrase; channel 0 means
+ * the AP could not be read back and there is nothing to cache.
+ */
+
+static inline int mmwave_wifi_connect(
+    FAR const struct mmwave_wifi_ops_s *ops,
+    FAR struct mmwave_wifi_ap_s *ap, bool cached, FAR int *how)
+{
+  int ret;
+
+  if (cached && ops->join(ops->arg, ap) == OK)
+    {
+      *how = MMWAVE_WIFI_DIRECTED;
+      return OK;
+    }
+
+  ret = ops->join(ops->arg, NULL);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  *how = MMWAVE_WIFI_SCANNED;
+  memset(ap, 0, sizeof(*ap));
+  if (ops->joined(ops->arg, ap) < 0)
+    {
+      ap->channel = 0;
+    }
+
+  return OK;
+}
+
+/**
+ * An address: wifi.static (fixed, NULL if not set), or the cached lease
+ * (NULL if none) with DHCP confirming it in the background, or waiting
+ * for DHCP. A cached lease DHCP could not start behind is still used;
+ * the interface keeps it until the next boot.
+ */
+
+static inline int mmwave_wifi_address(
+    FAR const struct mmwave_wifi_ops_s *ops,
+    FAR const struct mmwave_wifi_addr_s *fixed,
+    FAR const struct mmwave_wifi_addr_s *lease, FAR int *how)
+{
+  int ret;
+
+  if (fixed != NULL)
+    {
+      *how = MMWAVE_WIFI_STATIC;
+      return ops->set_addr(ops->arg, fixed);
+    }
+
+  if (lease != NULL && ops->set_addr(ops->arg, lease) == OK)
+    {
+      *how = MMWAVE_WIFI_REUSED;
+      ops->dhcp(ops->arg, false);
+      return OK;
+    }
+
+  *how = MMWAVE_WIFI_LEASED;
+  ret = ops->dhcp(ops->arg, true);
+  return ret < 0 ? ret : OK;
+}
+
+#endif /* __APPS_COMMON_MMWAVE_WIFI_H */
@@ -0,0 +1,150 @@
+/*
+ * apps/common/wpa_pmk.h
+ *
+ * The WPA2-Personal pairwise master key for an SSID and passphrase:
+ * PBKDF2-HMAC-SHA1 with 4096 iterations (IEEE 802.11i, H.4). Deriving
+ * it is the slow part of joining a network, so the Wi-Fi cache keeps it
+ * (apps/common/mmwave_wifi.h) and the driver is handed the 64 hex digits
+ * instead of the passphrase.
+ *
+ * SHA-1 is the shared one in apps/common/mmwave_sha1.h.
+ */
+
+#ifndef __APPS_COMMON_WPA_PMK_H
+#define __APPS_COMMON_WPA_PMK_H
+
+#include <nuttx/config.h>
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "apps/common/mmwave_sha1.h"
+
+#define WPA_PMK_LEN         32
+#define WPA_PMK_HEX         (2 * WPA_PMK_LEN)
+#define WPA_PMK_ITERATIONS  4096
+
+/* HMAC-SHA1 state after the padded key: inner and outer */
+
+struct wpa_hmac_s
+{
+  struct mmwave_sha1_s in;
+  struct mmwave_sha1_s out;
+};
+
+static inline void wpa_hmac_init(FAR struct wpa_hmac_s *m,
+                                 FAR const uint8_t *key, size_t klen)
+{
+  uint8_t k[MMWAVE_SHA1_BLOCK];
+  uint8_t pad[MMWAVE_SHA1_BLOCK];
+
+  memset(k, 0, sizeof(k));
+  if (klen > MMWAVE_SHA1_BLOCK)
+    {
+      mmwave_sha1_init(&m->in);
+      mmwave_sha1_update(&m->in, key, klen);
+      mmwave_sha1_final(&m->in, k);
+    }
+  else
+    {
+      memcpy(k, key, klen);
+    }
+
+  for (int i = 0; i < MMWAVE_SHA1_BLOCK; i++)
+    {
+      pad[i] = k[i] ^ 0x36;
+    }
+
+  mmwave_sha1_init(&m->in);
+  mmwave_sha1_update(&m->in, pad, MMWAVE_SHA1_BLOCK);
+
+  for (int i = 0; i < MMWAVE_SHA1_BLOCK; i++)
+    {
+      pad[i] = k[i] ^ 0x5c;
+    }
+
+  mmwave_sha1_init(&m->out);
+  mmwave_sha1_update(&m->out, pad, MMWAVE_SHA1_BLOCK);
+}
+
+/* One MAC from the keyed state, which is left as it was */
+
+static inline void wpa_hmac(FAR const struct wpa_hmac_s *m,
+                            FAR const uint8_t *p, size_t n,
+                            FAR const uint8_t *p2, size_t n2,
+                            FAR uint8_t *mac)
+{
+  struct mmwave_sha1_s c = m->in;
+  uint8_t inner[MMWAVE_SHA1_LEN];
+
+  mmwave_sha1_update(&c, p, n);
+  mmwave_sha1_update(&c, p2, n2);
+  mmwave_sha1_final(&c, inner);
+
+  c = m->out;
+  mmwave_sha1_update(&c, inner, MMWAVE_SHA1_LEN);
+  mmwave_sha1_final(&c, mac);
+}
+
+/* PBKDF2-HMAC-SHA1 into out[len] */
+
+static inline void wpa_pbkdf2_sha1(FAR const char *pass,
+                                   FAR const uint8_t *salt, size_t slen,
+                                   int iterations, FAR uint8_t *out,
+                                   size_t len)
+{
+  struct wpa_hmac_s m;
+  uint8_t u[MMWAVE_SHA1_LEN];
+  uint8_t t[MMWAVE_SHA1_LEN];
+  uint8_t cnt[4];
+
+  wpa_hmac_init(&m, (FAR const uint8_t *)pass, strlen(pass));
+
+  for (uint32_t blk = 1; len > 0; blk++)
+    {
+      size_t take = len < MMWAVE_SHA1_LEN ? len : MMWAVE_SHA1_LEN;
+
+      cnt[0] = (uint8_t)(blk >> 24);
+      cnt[1] = (uint8_t)(blk >> 16);
+      cnt[2] = (uint8_t)(blk >> 8);
+      cnt[3] = (uint8_t)blk;
+
+      wpa_hmac(&m, salt, slen, cnt, 4, u);
+      memcpy(t, u, MMWAVE_SHA1_LEN);
+      for (int i = 1; i < iterations; i++)
+        {
+          wpa_hmac(&m, u, MMWAVE_SHA1_LEN, NULL, 0, u);
+          for (int j = 0; j < MMWAVE_SHA1_LEN; j++)
+            {
+              t[j] ^= u[j];
+            }
+        }
+
+      memcpy(out, t, take);
+      out += take;
+      len -= take;
+    }
+}
+
+/* The PMK as the 64 lower-case hex digits drivers take for a PSK */
+
+static inline void wpa_pmk_hex(FAR const char *ssid, FAR const char *pass,
+                               FAR char *hex)
+{
+  static const char digits[] = "0123456789abcdef";
+  uint8_t pmk[WPA_PMK_LEN];
+
+  wpa_pbkdf2_sha1(pass, (FAR const uint8_t *)ssid, strlen(ssid),
+                  WPA_PMK_ITERATIONS, pmk, WPA_PMK_LEN);
+
+  for (int i = 0; i < WPA_PMK_LEN; i++)
+    {
+      hex[2 * i]     = digits[pmk[i] >> 4];
+      hex[2 * i + 1] = digits[pmk[i] & 0xf];
+    }
+
+  hex[WPA_PMK_HEX] = '\0';
+}
+
+#endif /* __APPS_COMMON_WPA_PMK_H */
@@ -8,11 +8,17 @@
  * Usage:
  *   config list                — List all config keys
  *   config get <key>           — Get a config value
- *   config set <key> <value>   — Set a config value
+ *   config set <key> <value> [<key> <value> ...]
+ *                              — Set one or more values, all or none
  *   config delete <key>        — Delete a config key
  *   config reset               — Reset all configuration to defaults
+ *   config compact             — Rewrite the store without stale entries
+ *   config export [file]       — Every key as NSH `set` lines
  *
- * Config is stored in LittleFS at /config/ as individual files per key.
+ * Config is stored in one log-structured file, /config/config.log (see
+ * config_store.h), and held in RAM by the config service (config_svc.c)
+ * from its first use on: this command reads and writes through it like
+ * every other app, so a get reads no flash. A write is a single append.
  *
  ****************************************************************************/
 
@@ -21,151 +27,109 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
-#include <fcntl.h>
-#include <unistd.h>
-#include <dirent.h>
 #include <errno.h>
-#include <sys/stat.h>
 
-/****************************************************************************
- * Pre-processor Definitions
- ****************************************************************************/
-
-#define CONFIG_BASE_PATH    "/config"
-#define CONFIG_MAX_KEY_LEN  64
-#define CONFIG_MAX_VAL_LEN  256
+#include "config_svc.h"
 
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 
-static void make_path(char *buf, size_t buflen, const char *key)
-{
-  snprintf(buf, buflen, "%s/%s", CONFIG_BASE_PATH, key);
-}
-
 static int config_list(void)
 {
-  DIR *dirp = opendir(CONFIG_BASE_PATH);
-  if (dirp == NULL)
-    {
-      fprintf(stderr, "config: cannot open %s: %s\n",
-              CONFIG_BASE_PATH, strerror(errno));
-      return EXIT_FAILURE;
-    }
-
-  struct dirent *entry;
+  struct cfg_store_stats_s stats;
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  uint32_t file_len;
+  uint32_t live;
+  int pos = 0;
   int count = 0;
+  int ret;
 
-  printf("Configuration keys (%s):\n", CONFIG_BASE_PATH);
+  printf("Configuration keys (%s):\n", CFG_STORE_PATH);
   printf("────────────────────────────\n");
 
-  while ((entry = readdir(dirp)) != NULL)
+  while ((ret = config_svc_next(&pos, key, val)) > 0)
     {
-      /* Skip . and .. */
-
-      if (entry->d_name[0] == '.') continue;
-
-      /* Read value for display */
-
-      char path[128];
-      make_path(path, sizeof(path), entry->d_name);
-
-      char val[CONFIG_MAX_VAL_LEN];
-      int fd = open(path, O_RDONLY);
-      if (fd >= 0)
-        {
-          ssize_t n = read(fd, val, sizeof(val) - 1);
-          close(fd);
-          if (n > 0)
-            {
-              val[n] = '\0';
-              printf("  %-24s = %s\n", entry->d_name, val);
-            }
-          else
-            {
-              printf("  %-24s = (empty)\n", entry->d_name);
-            }
-        }
-      else
-        {
-          printf("  %-24s = (unreadable)\n", entry->d_name);
-        }
-
+      printf("  %-24s = %s\n", key, val[0] != '\0' ? val : "(empty)");
       count++;
     }
 
-  closedir(dirp);
+  if (ret < 0)
+    {
+      fprintf(stderr, "config: cannot read %s\n", CFG_STORE_PATH);
+      return EXIT_FAILURE;
+    }
 
   if (count == 0)
     {
       printf("  (no configuration set)\n");
     }
 
+  config_svc_stats(&file_len, &live, &stats);
+  printf("\n  %d key(s), %lu bytes on flash (%lu live), %lu read(s) "
+         "since boot\n", count, (unsigned long)file_len,
+         (unsigned long)live, (unsigned long)stats.reads);
   return OK;
 }
 
-static int config_get(const char *key)
+static int config_get(FAR const char *key)
 {
-  char path[128];
-  make_path(path, sizeof(path), key);
+  char val[CFG_VAL_MAX + 1];
 
-  int fd = open(path, O_RDONLY);
-  if (fd < 0)
+  if (config_svc_get(key, val, sizeof(val)) < 0)
     {
       fprintf(stderr, "config: key '%s' not found\n", key);
       return EXIT_FAILURE;
     }
 
-  char val[CONFIG_MAX_VAL_LEN];
-  ssize_t n = read(fd, val, sizeof(val) - 1);
-  close(fd);
-
-  if (n >= 0)
-    {
-      val[n] = '\0';
-      printf("%s\n", val);
-    }
-
+  printf("%s\n", val);
   return OK;
 }
 
-static int config_set(const char *key, const char *value)
+/* Pairs of key and value, committed as one transaction */
+
+static int config_set(int npairs, FAR char *argv[])
 {
-  char path[128];
-  make_path(path, sizeof(path), key);
+  int ret;
 
-  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
-  if (fd < 0)
+  for (int i = 0; i < npairs; i++)
     {
-      fprintf(stderr, "config: cannot write '%s': %s\n",
-              key, strerror(errno));
-      return EXIT_FAILURE;
-    }
+      size_t klen = strlen(argv[2 * i]);
 
-  size_t vlen = strlen(value);
-  ssize_t written = write(fd, value, vlen);
-  close(fd);
+      if (klen == 0 || klen > CFG_KEY_MAX ||
+          strlen(argv[2 * i + 1]) > CFG_VAL_MAX)
+        {
+          fprintf(stderr, "config: '%s': keys are 1-%d characters, "
+                  "values up to %d\n", argv[2 * i], CFG_KEY_MAX,
+                  CFG_VAL_MAX);
+          return EXIT_FAILURE;
+        }
+    }
 
-  if (written != (ssize_t)vlen)
+  ret = config_svc_set_many((FAR const char *const *)argv, npairs);
+  if (ret < 0)
     {
-      fprintf(stderr, "config: write error\n");
+      fprintf(stderr, "config: write error: %s\n", strerror(-ret));
       return EXIT_FAILURE;
     }
 
-  printf("config: %s = %s\n", key, value);
+  for (int i = 0; i < npairs; i++)
+    {
+      printf("config: %s = %s\n", argv[2 * i], argv[2 * i + 1]);
+    }
+
   return OK;
 }
 
-static int config_delete(const char *key)
+static int config_delete(FAR const char *key)
 {
-  char path[128];
-  make_path(path, sizeof(path), key);
+  int ret = config_svc_unset(key);
 
-  if (unlink(path) < 0)
+  if (ret < 0)
     {
       fprintf(stderr, "config: cannot delete '%s': %s\n",
-              key, strerror(errno));
+              key, strerror(-ret));
       return EXIT_FAILURE;
     }
 
@@ -175,59 +139,94 @@ static int config_delete(const char *key)
 
 static int config_reset(void)
 {
-  DIR *dirp = opendir(CONFIG_BASE_PATH);
-  if (dirp == NULL)
+  int ret = config_svc_reset();
+
+  if (ret < 0)
     {
-      return OK;  /* Nothing to reset */
+      fprintf(stderr, "config: reset failed: %s\n", strerror(-ret));
+      return EXIT_FAILURE;
     }
 
-  struct dirent *entry;
-  char path[128];
+  printf("config: reset to defaults\n");
+  return OK;
+}
 
-  while ((entry = readdir(dirp)) != NULL)
+static int config_compact(void)
+{
+  struct cfg_store_stats_s stats;
+  uint32_t before;
+  uint32_t after;
+  uint32_t live;
+  int ret;
+
+  config_svc_stats(&before, &live, &stats);
+  ret = config_svc_compact();
+  if (ret < 0)
     {
-      if (entry->d_name[0] == '.') continue;
-      make_path(path, sizeof(path), entry->d_name);
-      unlink(path);
+      fprintf(stderr, "config: compaction failed: %s\n", strerror(-ret));
+      return EXIT_FAILURE;
     }
 
-  closedir(dirp);
+  config_svc_stats(&after, &live, &stats);
+  printf("config: %lu -> %lu bytes\n", (unsigned long)before,
+         (unsigned long)after);
+  return OK;
+}
 
-  /* Write default config values */
+/**
+ * Every key as an NSH `set` line, to stdout or a file a script then
+ * sources: one command at boot instead of a `config get` per key.
+ */
 
-  config_set("wifi.ssid", "");
-  config_set("wifi.psk", "");
-  config_set("ha.url", "");
-  config_set("ha.port", "8123");
-  config_set("ha.token", "");
-  config_set("mmwave.uart", "/dev/ttyS1");
-  config_set("mmwave.baud", "256000");
-  config_set("boot.autostart_ha", "0");
-  config_set("boot.autostart_wifi", "1");
+static int config_export(FAR const char *path)
+{
+  char line[CFG_SVC_EXPORT_MAX];
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  FAR FILE *out = stdout;
+  int pos = 0;
+  int ret;
+
+  if (path != NULL && (out = fopen(path, "w")) == NULL)
+    {
+      fprintf(stderr, "config: cannot write %s: %s\n", path,
+              strerror(errno));
+      return EXIT_FAILURE;
+    }
 
-  printf("config: reset to defaults\n");
-  return OK;
+  while ((ret = config_svc_next(&pos, key, val)) > 0)
+    {
+      cfg_svc_export_line(key, val, line, sizeof(line));
+      fputs(line, out);
+    }
+
+  if (out != stdout)
+    {
+      fclose(out);
+    }
+
+  return ret < 0 ? EXIT_FAILURE : OK;
 }
 
 static void print_usage(void)
 {
+  FAR const struct config_svc_default_s *d;
+
   printf("Usage: config <command> [args]\n\n");
   printf("Commands:\n");
   printf("  list               List all config keys\n");
   printf("  get <key>          Get a value\n");
-  printf("  set <key> <value>  Set a value\n");
+  printf("  set <key> <value> [<key> <value> ...]\n");
+  printf("                     Set values, all or none\n");
   printf("  delete <key>       Delete a key\n");
   printf("  reset              Reset all to defaults\n");
+  printf("  compact            Drop stale entries from the store now\n");
+  printf("  export [file]      Every key as NSH 'set' lines\n");
   printf("\nStandard keys:\n");
-  printf("  wifi.ssid          Wi-Fi network name\n");
-  printf("  wifi.psk           Wi-Fi password\n");
-  printf("  ha.url             Home Assistant URL/IP\n");
-  printf("  ha.port            Home Assistant port (8123)\n");
-  printf("  ha.token           HA long-lived access token\n");
-  printf("  mmwave.uart        Sensor UART path (/dev/ttyS1)\n");
-  printf("  mmwave.baud        Sensor baud rate (256000)\n");
-  printf("  boot.autostart_ha  Auto-start HA reporting (0/1)\n");
-  printf("  boot.autostart_wifi Auto-start Wi-Fi (0/1)\n");
+  for (int i = 0; (d = config_svc_default(i)) != NULL; i++)
+    {
+      printf("  %-18s %s\n", d->key, d->help);
+    }
 }
 
 /****************************************************************************
@@ -236,12 +235,7 @@ static void print_usage(void)
 
 int main(int argc, FAR char *argv[])
 {
-  if (argc < 2)
-    {
-      return config_list();
-    }
-
-  const char *cmd = argv[1];
+  FAR const char *cmd = argc < 2 ? "list" : argv[1];
 
   if (strcmp(cmd, "list") == 0)
     {
@@ -259,13 +253,14 @@ int main(int argc, FAR char *argv[])
     }
   else if (strcmp(cmd, "set") == 0)
     {
-      if (argc < 4)
+      if (argc < 4 || argc % 2 != 0)
         {
-          fprintf(stderr, "config: usage: config set <key> <value>\n");
+          fprintf(stderr, "config: usage: config set <key> <value> "
+                  "[<key> <value> ...]\n");
           return EXIT_FAILURE;
         }
 
-      return config_set(argv[2], argv[3]);
+      return config_set((argc - 2) / 2, &argv[2]);
     }
   else if (strcmp(cmd, "delete") == 0)
     {
@@ -281,10 +276,15 @@ int main(int argc, FAR char *argv[])
     {
       return config_reset();
     }
-  else
+  else if (strcmp(cmd, "compact") == 0)
+    {
+      return config_compact();
+    }
+  else if (strcmp(cmd, "export") == 0)
     {
-      print_usage();
+      return config_export(argc > 2 ? argv[2] : NULL);
     }
 
+  print_usage();
   return OK;
 }
@@ -0,0 +1,992 @@
+/*
+ * apps/config/config_store.h
+ *
+ * Log-structured key/value store behind `config`: every key in one
+ * append-only file instead of a LittleFS file per key.
+ *
+ *   - The file is a sequence of blocks: a 6-byte header (magic, entry
+ *     count, payload length, CRC-16) and entries of klen (1 byte), vlen
+ *     (2 bytes, 0xffff for a delete), key and value. An entry with
+ *     klen 0 clears every key before it.
+ *   - Keys are numbered in the order they first appear in full, from
+ *     the start of the file or its last clear. A transaction setting
+ *     one key the file already holds names it by that number (a klen
+ *     with the top bit set) instead of spelling it out, so it costs the
+ *     value and nine bytes: no more flash than the file a key used to
+ *     have to itself.
+ *   - A transaction is one block written with one append, so several
+ *     keys change together or not at all: a torn block fails its CRC
+ *     and is cut off at load, as if the transaction never happened.
+ *   - Loading reads the file once, in chunks, and builds a hash index
+ *     in RAM with a copy of every key and value. Gets never touch the
+ *     file; a set or delete reads nothing either.
+ *   - Superseded entries stay in the file until it is compacted: the
+ *     live entries are rewritten packed into a new file which then
+ *     replaces the old one in one rename.
+ *
+ * Storage is behind a small ops table so all of this runs on the host
+ * against a RAM file.
+ */
+
+#ifndef __APPS_CONFIG_CONFIG_STORE_H
+#define __APPS_CONFIG_CONFIG_STORE_H
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+
+#define CFG_STORE_PATH          "/config/config.log"
+
+#ifndef CONFIG_CONFIG_RAM_BYTES
+#  define CONFIG_CONFIG_RAM_BYTES 2048
+#endif
+
+#define CFG_KEY_MAX             63
+#define CFG_VAL_MAX             255
+#define CFG_STORE_SLOTS         64    /* Index size, a power of two */
+#define CFG_STORE_KEYS_MAX      48    /* Keeps the index 3/4 full at most */
+#define CFG_STORE_REC_SIZE      4     /* slot, klen, vlen ahead of a key */
+#define CFG_STORE_HDR_SIZE      6
+#define CFG_STORE_ENT_SIZE      3     /* klen + vlen ahead of the key */
+#define CFG_STORE_BLOCK_MAX     768   /* Largest transaction, header too */
+#define CFG_STORE_MAGIC         0xc6
+#define CFG_STORE_DELETE        0xffff
+#define CFG_STORE_REF           0x80  /* klen: a key by its number */
+#define CFG_STORE_IDS           128   /* Key numbers a file hands out */
+#define CFG_STORE_NO_ID         0xff
+#define CFG_STORE_ARENA         CONFIG_CONFIG_RAM_BYTES
+
+enum cfg_slot_state_e
+{
+  CFG_SLOT_EMPTY = 0,
+  CFG_SLOT_LIVE,
+  CFG_SLOT_DEAD                  /* Deleted; probing continues past it */
+};
+
+struct cfg_slot_s
+{
+  uint32_t hash;
+  uint16_t key;          /* Key bytes in the arena, the value after them */
+  uint16_t vlen;
+  uint8_t  klen;
+  uint8_t  state;
+  uint8_t  id;           /* Key number, or CFG_STORE_NO_ID */
+};
+
+struct cfg_store_io_s
+{
+  ssize_t (*read)(void *priv, uint32_t off, uint8_t *buf, size_t len);
+
+  /* Append len bytes at the end of the file and make them durable */
+
+  int     (*append)(void *priv, const uint8_t *buf, size_t len);
+  int     (*truncate)(void *priv, uint32_t len);
+
+  /* Compaction: write a new file, then swap it in (commit) or drop it */
+
+  int     (*rewrite_begin)(void *priv);
+  int     (*rewrite_write)(void *priv, const uint8_t *buf, size_t len);
+  int     (*rewrite_end)(void *priv, bool commit);
+  void     *priv;
+};
+
+struct cfg_store_stats_s
+{
+  uint32_t reads;        /* read() calls, all of them at load */
+  uint32_t read_bytes;
+  uint32_t appends;      /* append() calls, each a program and sync */
+  uint32_t append_bytes;
+  uint32_t compactions;
+  uint32_t torn;         /* Bad blocks cut off at load */
+};
+
+struct cfg_store_s
+{
+  const struct cfg_store_io_s *io;
+  uint32_t compact_min;  /* Smallest file worth compacting, bytes */
+
+  struct cfg_slot_s slots[CFG_STORE_SLOTS];
+  uint16_t keys;         /* Live keys */
+  uint8_t  ids[CFG_STORE_IDS];  /* Slot of each key number */
+  uint8_t  next_id;
+
+  /* Keys and values as records of slot, klen, vlen, key and value;
+   * stale ones are dropped when the arena fills up.
+   */
+
+  uint8_t  arena[CFG_STORE_ARENA];
+  uint16_t arena_len;
+  uint16_t arena_live;   /* Arena bytes of live records */
+  uint32_t file_len;
+  uint32_t live_bytes;   /* Entry bytes still current */
+
+  uint8_t  buf[CFG_STORE_BLOCK_MAX];  /* Transaction, or a block read */
+  uint16_t txn_len;      /* Payload staged in buf after the header */
+  uint8_t  txn_count;
+  uint8_t  txn_new;      /* Keys the transaction may add */
+  uint16_t txn_arena;    /* Arena bytes its values need at most */
+  bool     txn_clear;    /* It starts over from no keys */
+
+  struct cfg_store_stats_s stats;
+};
+
+/* ---- Encoding ---- */
+
+/* CRC-16/CCITT-FALSE, a byte at a time: a load checks the whole file */
+
+static const uint16_t g_cfg_store_crc16[256] =
+{
+  0x0000, 0x1021, 0x2042, 0x3063, 0x4084, 0x50a5, 0x60c6, 0x70e7,
+  0x8108, 0x9129, 0xa14a, 0xb16b, 0xc18c, 0xd1ad, 0xe1ce, 0xf1ef,
+  0x1231, 0x0210, 0x3273, 0x2252, 0x52b5, 0x4294, 0x72f7, 0x62d6,
+  0x9339, 0x8318, 0xb37b, 0xa35a, 0xd3bd, 0xc39c, 0xf3ff, 0xe3de,
+  0x2462, 0x3443, 0x0420, 0x1401, 0x64e6, 0x74c7, 0x44a4, 0x5485,
+  0xa56a, 0xb54b, 0x8528, 0x9509, 0xe5ee, 0xf5cf, 0xc5ac, 0xd58d,
+  0x3653, 0x2672, 0x1611, 0x0630, 0x76d7, 0x66f6, 0x5695, 0x46b4,
+  0xb75b, 0xa77a, 0x9719, 0x8738, 0xf7df, 0xe7fe, 0xd79d, 0xc7bc,
+  0x48c4, 0x58e5, 0x6886, 0x78a7, 0x0840, 0x1861, 0x2802, 0x3823,
+  0xc9cc, 0xd9ed, 0xe98e, 0xf9af, 0x8948, 0x9969, 0xa90a, 0xb92b,
+  0x5af5, 0x4ad4, 0x7ab7, 0x6a96, 0x1a71, 0x0a50, 0x3a33, 0x2a12,
+  0xdbfd, 0xcbdc, 0xfbbf, 0xeb9e, 0x9b79, 0x8b58, 0xbb3b, 0xab1a,
+  0x6ca6, 0x7c87, 0x4ce4, 0x5cc5, 0x2c22, 0x3c03, 0x0c60, 0x1c41,
+  0xedae, 0xfd8f, 0xcdec, 0xddcd, 0xad2a, 0xbd0b, 0x8d68, 0x9d49,
+  0x7e97, 0x6eb6, 0x5ed5, 0x4ef4, 0x3e13, 0x2e32, 0x1e51, 0x0e70,
+  0xff9f, 0xefbe, 0xdfdd, 0xcffc, 0xbf1b, 0xaf3a, 0x9f59, 0x8f78,
+  0x9188, 0x81a9, 0xb1ca, 0xa1eb, 0xd10c, 0xc12d, 0xf14e, 0xe16f,
+  0x1080, 0x00a1, 0x30c2, 0x20e3, 0x5004, 0x4025, 0x7046, 0x6067,
+  0x83b9, 0x9398, 0xa3fb, 0xb3da, 0xc33d, 0xd31c, 0xe37f, 0xf35e,
+  0x02b1, 0x1290, 0x22f3, 0x32d2, 0x4235, 0x5214, 0x6277, 0x7256,
+  0xb5ea, 0xa5cb, 0x95a8, 0x8589, 0xf56e, 0xe54f, 0xd52c, 0xc50d,
+  0x34e2, 0x24c3, 0x14a0, 0x0481, 0x7466, 0x6447, 0x5424, 0x4405,
+  0xa7db, 0xb7fa, 0x8799, 0x97b8, 0xe75f, 0xf77e, 0xc71d, 0xd73c,
+  0x26d3, 0x36f2, 0x0691, 0x16b0, 0x6657, 0x7676, 0x4615, 0x5634,
+  0xd94c, 0xc96d, 0xf90e, 0xe92f, 0x99c8, 0x89e9, 0xb98a, 0xa9ab,
+  0x5844, 0x4865, 0x7806, 0x6827, 0x18c0, 0x08e1, 0x3882, 0x28a3,
+  0xcb7d, 0xdb5c, 0xeb3f, 0xfb1e, 0x8bf9, 0x9bd8, 0xabbb, 0xbb9a,
+  0x4a75, 0x5a54, 0x6a37, 0x7a16, 0x0af1, 0x1ad0, 0x2ab3, 0x3a92,
+  0xfd2e, 0xed0f, 0xdd6c, 0xcd4d, 0xbdaa, 0xad8b, 0x9de8, 0x8dc9,
+  0x7c26, 0x6c07, 0x5c64, 0x4c45, 0x3ca2, 0x2c83, 0x1ce0, 0x0cc1,
+  0xef1f, 0xff3e, 0xcf5d, 0xdf7c, 0xaf9b, 0xbfba, 0x8fd9, 0x9ff8,
+  0x6e17, 0x7e36, 0x4e55, 0x5e74, 0x2e93, 0x3eb2, 0x0ed1, 0x1ef0
+};
+
+static inline uint16_t cfg_store_crc16(uint16_t crc, const uint8_t *p,
+                                       size_t len)
+{
+  while (len-- > 0)
+    {
+      crc = (uint16_t)(crc << 8) ^ g_cfg_store_crc16[(crc >> 8) ^ *p++];
+    }
+
+  return crc;
+}
+
+/* FNV-1a */
+
+static inline uint32_t cfg_store_hash(const char *key, size_t len)
+{
+  uint32_t h = 2166136261u;
+
+  while (len-- > 0)
+    {
+      h = (h ^ (uint8_t)*key++) * 16777619u;
+    }
+
+  return h;
+}
+
+static inline uint16_t cfg_store_get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] | p[1] << 8);
+}
+
+/* Header for `count` entries of `len` bytes already at p+6 */
+
+static inline void cfg_store_seal(uint8_t *p, uint8_t count, uint16_t len)
+{
+  uint16_t crc;
+
+  p[0] = CFG_STORE_MAGIC;
+  p[1] = count;
+  p[2] = (uint8_t)len;
+  p[3] = (uint8_t)(len >> 8);
+  crc  = cfg_store_crc16(0xffff, p, 4);
+  crc  = cfg_store_crc16(crc, p + CFG_STORE_HDR_SIZE, len);
+  p[4] = (uint8_t)crc;
+  p[5] = (uint8_t)(crc >> 8);
+}
+
+/* klen is the entry's first byte: a key length, or CFG_STORE_REF and
+ * the key's number
+ */
+
+static inline size_t cfg_store_ent_size(uint8_t klen, uint16_t vlen)
+{
+  return CFG_STORE_ENT_SIZE + (klen & CFG_STORE_REF ? 0 : klen) +
+         (vlen == CFG_STORE_DELETE ? 0 : vlen);
+}
+
+static inline uint8_t *cfg_store_ent_put(uint8_t *p, const char *key,
+                                         uint8_t klen, const char *val,
+                                         uint16_t vlen)
+{
+  size_t kl = klen & CFG_STORE_REF ? 0 : klen;
+
+  p[0] = klen;
+  p[1] = (uint8_t)vlen;
+  p[2] = (uint8_t)(vlen >> 8);
+  memcpy(p + CFG_STORE_ENT_SIZE, key, kl);
+  if (vlen != CFG_STORE_DELETE)
+    {
+      memcpy(p + CFG_STORE_ENT_SIZE + kl, val, vlen);
+    }
+
+  return p + cfg_store_ent_size(klen, vlen);
+}
+
+/* ---- Index ---- */
+
+/* Slot holding key, or -ENOENT with *ins set to where it would go (-1
+ * when the index is full).
+ */
+
+static inline int cfg_store_find(struct cfg_store_s *s, const char *key,
+                                 uint8_t klen, uint32_t hash, int *ins)
+{
+  unsigned int i = hash & (CFG_STORE_SLOTS - 1);
+  int dead = -1;
+
+  for (int n = 0; n < CFG_STORE_SLOTS; n++)
+    {
+      struct cfg_slot_s *sl = &s->slots[i];
+
+      if (sl->state == CFG_SLOT_EMPTY)
+        {
+          *ins = dead >= 0 ? dead : (int)i;
+          return -ENOENT;
+        }
+
+      if (sl->state == CFG_SLOT_DEAD)
+        {
+          if (dead < 0)
+            {
+              dead = (int)i;
+            }
+        }
+      else if (sl->hash == hash && sl->klen == klen &&
+               memcmp(s->arena + sl->key, key, klen) == 0)
+        {
+          return (int)i;
+        }
+
+      i = (i + 1) & (CFG_STORE_SLOTS - 1);
+    }
+
+  *ins = dead;
+  return -ENOENT;
+}
+
+static inline void cfg_store_clear_index(struct cfg_store_s *s)
+{
+  memset(s->slots, 0, sizeof(s->slots));
+  s->keys       = 0;
+  s->next_id    = 0;
+  s->live_bytes = 0;
+  s->arena_len  = 0;
+  s->arena_live = 0;
+}
+
+static inline size_t cfg_store_rec_size(uint8_t klen, uint16_t vlen)
+{
+  return CFG_STORE_REC_SIZE + klen + vlen;
+}
+
+/* Slide the live records down over the stale ones */
+
+static inline void cfg_store_repack(struct cfg_store_s *s)
+{
+  uint16_t wr = 0;
+
+  for (uint16_t rd = 0; rd < s->arena_len; )
+    {
+      const uint8_t *r = s->arena + rd;
+      struct cfg_slot_s *sl = &s->slots[r[0]];
+      uint16_t size = (uint16_t)cfg_store_rec_size(r[1],
+                                                   cfg_store_get16(r + 2));
+
+      if (sl->state == CFG_SLOT_LIVE && sl->key == rd + CFG_STORE_REC_SIZE)
+        {
+          memmove(s->arena + wr, r, size);
+          sl->key = (uint16_t)(wr + CFG_STORE_REC_SIZE);
+          wr += size;
+        }
+
+      rd += size;
+    }
+
+  s->arena_len = wr;
+}
+
+/* Give slot i a new record holding key and value */
+
+static inline int cfg_store_rec_add(struct cfg_store_s *s, int i,
+                                    const char *key, uint8_t klen,
+                                    const uint8_t *val, uint16_t vlen)
+{
+  size_t size = cfg_store_rec_size(klen, vlen);
+  uint8_t *r;
+
+  if (s->arena_len + size > CFG_STORE_ARENA)
+    {
+      cfg_store_repack(s);
+      if (s->arena_len + size > CFG_STORE_ARENA)
+        {
+          return -ENOSPC;
+        }
+    }
+
+  r    = s->arena + s->arena_len;
+  r[0] = (uint8_t)i;
+  r[1] = klen;
+  r[2] = (uint8_t)(vlen & 0xff);
+  r[3] = (uint8_t)(vlen >> 8);
+  memcpy(r + CFG_STORE_REC_SIZE, key, klen);
+  memcpy(r + CFG_STORE_REC_SIZE + klen, val, vlen);
+  s->slots[i].key = (uint16_t)(s->arena_len + CFG_STORE_REC_SIZE);
+  s->arena_len   += (uint16_t)size;
+  s->arena_live  += (uint16_t)size;
+  return OK;
+}
+
+/* Apply one entry to the index */
+
+static inline int cfg_store_apply(struct cfg_store_s *s, const uint8_t *ent)
+{
+  uint8_t  klen = ent[0];
+  uint16_t vlen = cfg_store_get16(ent + 1);
+  const char *key = (const char *)ent + CFG_STORE_ENT_SIZE;
+  const uint8_t *val = ent + CFG_STORE_ENT_SIZE + klen;
+  char kbuf[CFG_KEY_MAX];
+  uint32_t hash = 0;
+  int ins = -1;
+  int i;
+
+  if (klen == 0)
+    {
+      cfg_store_clear_index(s);
+      return OK;
+    }
+
+  if (klen & CFG_STORE_REF)
+    {
+      uint8_t id = klen & ~CFG_STORE_REF;
+
+      /* Only a live key is named by its number. Its key moves if the
+       * arena is repacked, so work from a copy.
+       */
+
+      i = id < s->next_id ? s->ids[id] : -1;
+      if (i < 0 || s->slots[i].state != CFG_SLOT_LIVE ||
+          s->slots[i].id != id)
+        {
+          return -EIO;
+        }
+
+      klen = s->slots[i].klen;
+      memcpy(kbuf, s->arena + s->slots[i].key, klen);
+      key  = kbuf;
+      val  = ent + CFG_STORE_ENT_SIZE;
+    }
+  else
+    {
+      hash = cfg_store_hash(key, klen);
+      i = cfg_store_find(s, key, klen, hash, &ins);
+    }
+
+  if (i >= 0)
+    {
+      struct cfg_slot_s *sl = &s->slots[i];
+
+      s->live_bytes -= cfg_store_ent_size(sl->klen, sl->vlen);
+      if (vlen == CFG_STORE_DELETE)
+        {
+          sl->state      = CFG_SLOT_DEAD;
+          s->keys--;
+          s->arena_live -= (uint16_t)cfg_store_rec_size(klen, sl->vlen);
+          return OK;
+        }
+
+      /* Same length: overwrite the value where it is */
+
+      if (vlen == sl->vlen)
+        {
+          memcpy(s->arena + sl->key + klen, val, vlen);
+        }
+      else
+        {
+          uint16_t old = (uint16_t)cfg_store_rec_size(klen, sl->vlen);
+
+          if (cfg_store_rec_add(s, i, key, klen, val, vlen) < 0)
+            {
+              return -ENOSPC;
+            }
+
+          s->arena_live -= old;
+          sl->vlen = vlen;
+        }
+    }
+  else if (vlen == CFG_STORE_DELETE)
+    {
+      return OK;
+    }
+  else if (ins < 0 || cfg_store_rec_add(s, ins, key, klen, val, vlen) < 0)
+    {
+      return -ENOSPC;
+    }
+  else
+    {
+      struct cfg_slot_s *sl = &s->slots[ins];
+
+      sl->hash  = hash;
+      sl->vlen  = vlen;
+      sl->klen  = klen;
+      sl->state = CFG_SLOT_LIVE;
+      sl->id    = CFG_STORE_NO_ID;
+      s->keys++;
+      i = ins;
+    }
+
+  /* Loading numbers the keys exactly as writing them did */
+
+  if (s->slots[i].id == CFG_STORE_NO_ID && s->next_id < CFG_STORE_IDS)
+    {
+      s->slots[i].id     = s->next_id;
+      s->ids[s->next_id] = (uint8_t)i;
+      s->next_id++;
+    }
+
+  s->live_bytes += cfg_store_ent_size(klen, vlen);
+  return OK;
+}
+
+/* Apply every entry of a checked block whose payload is at p */
+
+static inline int cfg_store_apply_block(struct cfg_store_s *s,
+                                        const uint8_t *p, uint8_t count,
+                                        uint16_t len)
+{
+  uint16_t pos = 0;
+
+  for (int n = 0; n < count; n++)
+    {
+      size_t size;
+
+      if (len - pos < CFG_STORE_ENT_SIZE)
+        {
+          return -EIO;
+        }
+
+      size = cfg_store_ent_size(p[pos], cfg_store_get16(p + pos + 1));
+      if (size > (size_t)(len - pos) ||
+          (p[pos] == 0 && size != CFG_STORE_ENT_SIZE) ||
+          (p[pos] > CFG_KEY_MAX && !(p[pos] & CFG_STORE_REF)))
+        {
+          return -EIO;
+        }
+
+      int ret = cfg_store_apply(s, p + pos);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      pos += (uint16_t)size;
+    }
+
+  return pos == len ? OK : -EIO;
+}
+
+/* ---- Setup ---- */
+
+static inline void cfg_store_init(struct cfg_store_s *s,
+                                  const struct cfg_store_io_s *io,
+                                  uint32_t compact_min)
+{
+  memset(s, 0, sizeof(*s));
+  s->io          = io;
+  s->compact_min = compact_min;
+}
+
+/*
+ * Scan the file and build the index. Blocks are applied in order and
+ * the first bad one ends the file: it is cut off so later appends
+ * follow the last good block. Returns the number of keys.
+ */
+
+static inline int cfg_store_load(struct cfg_store_s *s)
+{
+  uint32_t off = 0;      /* Next block */
+  uint32_t base = 0;     /* File offset of buf[0] */
+  uint32_t have = 0;     /* Bytes read into buf */
+  bool eof = false;      /* A short read: the rest of the file is in buf */
+
+  cfg_store_clear_index(s);
+
+  for (; ; )
+    {
+      uint8_t *p = s->buf + (off - base);
+      uint32_t left = base + have - off;
+      uint16_t len;
+      int ret;
+
+      /* Read from this block on unless all of it is in buf already */
+
+      if (!eof && (left < CFG_STORE_HDR_SIZE ||
+                   left < CFG_STORE_HDR_SIZE +
+                          (uint32_t)cfg_store_get16(p + 2)))
+        {
+          ssize_t n = s->io->read(s->io->priv, off, s->buf,
+                                  CFG_STORE_BLOCK_MAX);
+
+          /* A read error is not a torn block: leave the file alone */
+
+          s->stats.reads++;
+          if (n < 0)
+            {
+              return (int)n;
+            }
+
+          s->stats.read_bytes += (uint32_t)n;
+          if (n == 0)
+            {
+              break;
+            }
+
+          base = off;
+          have = (uint32_t)n;
+          p    = s->buf;
+          left = have;
+          eof  = n < CFG_STORE_BLOCK_MAX;
+        }
+
+      if (left == 0)
+        {
+          break;
+        }
+
+      len = cfg_store_get16(p + 2);
+      if (left < CFG_STORE_HDR_SIZE || p[0] != CFG_STORE_MAGIC ||
+          len > CFG_STORE_BLOCK_MAX - CFG_STORE_HDR_SIZE ||
+          left < CFG_STORE_HDR_SIZE + (uint32_t)len ||
+          cfg_store_crc16(cfg_store_crc16(0xffff, p, 4),
+                          p + CFG_STORE_HDR_SIZE, len) !=
+          cfg_store_get16(p + 4))
+        {
+          goto torn;
+        }
+
+      /* Entries go to the index only once the whole block checks out */
+
+      ret = cfg_store_apply_block(s, p + CFG_STORE_HDR_SIZE, p[1], len);
+      if (ret == -ENOSPC)
+        {
+          return ret;
+        }
+      else if (ret < 0)
+        {
+          goto torn;
+        }
+
+      off += CFG_STORE_HDR_SIZE + len;
+    }
+
+  s->file_len = off;
+  return s->keys;
+
+torn:
+  s->stats.torn++;
+  s->io->truncate(s->io->priv, off);
+  s->file_len = off;
+  return s->keys;
+}
+
+/* ---- Reads ---- */
+
+/* Copy key's value into val as a string; returns its length */
+
+static inline int cfg_store_get(struct cfg_store_s *s, const char *key,
+                                char *val, size_t size)
+{
+  size_t klen = strlen(key);
+  struct cfg_slot_s *sl;
+  int ins;
+  int i;
+
+  if (klen == 0 || klen > CFG_KEY_MAX)
+    {
+      return -EINVAL;
+    }
+
+  i = cfg_store_find(s, key, (uint8_t)klen, cfg_store_hash(key, klen),
+                     &ins);
+  if (i < 0)
+    {
+      return i;
+    }
+
+  sl = &s->slots[i];
+  if ((size_t)sl->vlen + 1 > size)
+    {
+      return -E2BIG;
+    }
+
+  memcpy(val, s->arena + sl->key + sl->klen, sl->vlen);
+  val[sl->vlen] = '\0';
+  return sl->vlen;
+}
+
+/*
+ * Walk the keys: *pos starts at 0. Fills key (CFG_KEY_MAX + 1 bytes) and
+ * val (CFG_VAL_MAX + 1) and returns 1, or 0 past the last key. Order is
+ * the index's, not insertion order.
+ */
+
+static inline int cfg_store_next(struct cfg_store_s *s, int *pos,
+                                 char *key, char *val)
+{
+  while (*pos < CFG_STORE_SLOTS)
+    {
+      struct cfg_slot_s *sl = &s->slots[(*pos)++];
+
+      if (sl->state != CFG_SLOT_LIVE)
+        {
+          continue;
+        }
+
+      memcpy(key, s->arena + sl->key, sl->klen);
+      memcpy(val, s->arena + sl->key + sl->klen, sl->vlen);
+      key[sl->klen] = '\0';
+      val[sl->vlen] = '\0';
+      return 1;
+    }
+
+  return 0;
+}
+
+/* ---- Transactions ---- */
+
+static inline void cfg_store_begin(struct cfg_store_s *s)
+{
+  s->txn_len   = 0;
+  s->txn_count = 0;
+  s->txn_new   = 0;
+  s->txn_clear = false;
+  s->txn_arena = 0;
+}
+
+static inline int cfg_store_stage(struct cfg_store_s *s, const char *key,
+                                  const char *val, bool del)
+{
+  size_t klen = key != NULL ? strlen(key) : 0;
+  size_t vlen = del ? CFG_STORE_DELETE : strlen(val);
+  size_t size;
+
+  if ((key != NULL && (klen == 0 || klen > CFG_KEY_MAX)) ||
+      (!del && vlen > CFG_VAL_MAX))
+    {
+      return -EINVAL;
+    }
+
+  size = cfg_store_ent_size((uint8_t)klen, (uint16_t)vlen);
+  if (CFG_STORE_HDR_SIZE + s->txn_len + size > CFG_STORE_BLOCK_MAX ||
+      s->txn_count == UINT8_MAX)
+    {
+      return -E2BIG;
+    }
+
+  if (key == NULL)
+    {
+      s->txn_clear = true;
+      s->txn_new   = 0;
+      s->txn_arena = 0;
+    }
+  else if (!del)
+    {
+      size_t need = cfg_store_rec_size((uint8_t)klen, (uint16_t)vlen);
+      int ins;
+      int i = s->txn_clear ? -ENOENT :
+              cfg_store_find(s, key, (uint8_t)klen,
+                             cfg_store_hash(key, klen), &ins);
+
+      /* Only a value of a new length needs a new record */
+
+      if (i >= 0 && s->slots[i].vlen == vlen)
+        {
+          need = 0;
+        }
+
+      if ((i < 0 && (s->txn_clear ? 0 : s->keys) + s->txn_new >=
+           CFG_STORE_KEYS_MAX) ||
+          (s->txn_clear ? 0 : s->arena_live) + s->txn_arena + need >
+          CFG_STORE_ARENA)
+        {
+          return -ENOSPC;
+        }
+
+      s->txn_new   += i < 0;
+      s->txn_arena += (uint16_t)need;
+    }
+
+  cfg_store_ent_put(s->buf + CFG_STORE_HDR_SIZE + s->txn_len, key,
+                    (uint8_t)klen, val, (uint16_t)vlen);
+  s->txn_len += (uint16_t)size;
+  s->txn_count++;
+  return OK;
+}
+
+static inline int cfg_store_put(struct cfg_store_s *s, const char *key,
+                                const char *val)
+{
+  return cfg_store_stage(s, key, val, false);
+}
+
+static inline int cfg_store_del(struct cfg_store_s *s, const char *key)
+{
+  return cfg_store_stage(s, key, NULL, true);
+}
+
+/* Drop every key; entries staged after this one survive */
+
+static inline int cfg_store_clear(struct cfg_store_s *s)
+{
+  return cfg_store_stage(s, NULL, NULL, true);
+}
+
+/* A lone set of a key the file has numbered: name it by its number */
+
+static inline void cfg_store_shorten(struct cfg_store_s *s)
+{
+  uint8_t *p = s->buf + CFG_STORE_HDR_SIZE;
+  uint8_t klen = p[0];
+  uint16_t vlen = cfg_store_get16(p + 1);
+  int ins;
+  int i;
+
+  if (s->txn_count != 1 || klen == 0 || vlen == CFG_STORE_DELETE)
+    {
+      return;
+    }
+
+  i = cfg_store_find(s, (const char *)p + CFG_STORE_ENT_SIZE, klen,
+                     cfg_store_hash((const char *)p + CFG_STORE_ENT_SIZE,
+                                    klen), &ins);
+  if (i < 0 || s->slots[i].id == CFG_STORE_NO_ID)
+    {
+      return;
+    }
+
+  p[0] = CFG_STORE_REF | s->slots[i].id;
+  memmove(p + CFG_STORE_ENT_SIZE, p + CFG_STORE_ENT_SIZE + klen, vlen);
+  s->txn_len -= klen;
+}
+
+/* The key of an entry of the transaction just committed; returns its
+ * length. key holds CFG_KEY_MAX + 1 bytes.
+ */
+
+static inline uint8_t cfg_store_ent_key(const struct cfg_store_s *s,
+                                        const uint8_t *ent, char *key)
+{
+  uint8_t klen = ent[0];
+  const uint8_t *k = ent + CFG_STORE_ENT_SIZE;
+
+  if (klen & CFG_STORE_REF)
+    {
+      const struct cfg_slot_s *sl =
+        &s->slots[s->ids[klen & ~CFG_STORE_REF]];
+
+      klen = sl->klen;
+      k    = s->arena + sl->key;
+    }
+
+  memcpy(key, k, klen);
+  key[klen] = '\0';
+  return klen;
+}
+
+/*
+ * Write the staged entries as one block, then apply them. Either the
+ * whole transaction is in the file and the index or none of it is.
+ */
+
+static inline int cfg_store_commit(struct cfg_store_s *s)
+{
+  size_t len = CFG_STORE_HDR_SIZE + s->txn_len;
+  int ret;
+
+  if (s->txn_count == 0)
+    {
+      return OK;
+    }
+
+  cfg_store_shorten(s);
+  len = CFG_STORE_HDR_SIZE + s->txn_len;
+  cfg_store_seal(s->buf, s->txn_count, s->txn_len);
+
+  ret = s->io->append(s->io->priv, s->buf, len);
+  s->stats.appends++;
+  if (ret < 0)
+    {
+      /* A partial block fails its CRC at load; cut it off now */
+
+      s->io->truncate(s->io->priv, s->file_len);
+      cfg_store_begin(s);
+      return ret;
+    }
+
+  s->stats.append_bytes += len;
+
+  ret = cfg_store_apply_block(s, s->buf + CFG_STORE_HDR_SIZE,
+                              s->txn_count, s->txn_len);
+  s->file_len += len;
+  cfg_store_begin(s);
+  return ret;
+}
+
+static inline int cfg_store_set(struct cfg_store_s *s, const char *key,
+                                const char *val)
+{
+  int ret;
+
+  cfg_store_begin(s);
+  ret = cfg_store_put(s, key, val);
+  return ret < 0 ? ret : cfg_store_commit(s);
+}
+
+/* Delete one key; -ENOENT if it is not set */
+
+static inline int cfg_store_unset(struct cfg_store_s *s, const char *key)
+{
+  size_t klen = strlen(key);
+  int ins;
+  int ret;
+
+  if (klen == 0 || klen > CFG_KEY_MAX ||
+      cfg_store_find(s, key, (uint8_t)klen, cfg_store_hash(key, klen),
+                     &ins) < 0)
+    {
+      return -ENOENT;
+    }
+
+  cfg_store_begin(s);
+  ret = cfg_store_del(s, key);
+  return ret < 0 ? ret : cfg_store_commit(s);
+}
+
+/* ---- Compaction ---- */
+
+/* Superseded entries make up more than half of a file worth rewriting */
+
+static inline bool cfg_store_compact_due(const struct cfg_store_s *s)
+{
+  return s->file_len >= s->compact_min && s->live_bytes * 2 < s->file_len;
+}
+
+/*
+ * Rewrite the live entries, packed into as few blocks as fit, and swap
+ * the new file in. The keys are numbered again in the order written.
+ * On failure the old file stays and is reloaded.
+ */
+
+static inline int cfg_store_compact(struct cfg_store_s *s)
+{
+  uint32_t new_len = 0;
+  uint16_t len = 0;
+  uint8_t count = 0;
+  int ret = s->io->rewrite_begin(s->io->priv);
+
+  for (int i = 0; ret == OK && i <= CFG_STORE_SLOTS; i++)
+    {
+      struct cfg_slot_s *sl = i < CFG_STORE_SLOTS ? &s->slots[i] : NULL;
+      size_t size = 0;
+
+      if (sl != NULL)
+        {
+          if (sl->state != CFG_SLOT_LIVE)
+            {
+              continue;
+            }
+
+          size = cfg_store_ent_size(sl->klen, sl->vlen);
+        }
+
+      /* Flush the block when this entry does not fit, and at the end */
+
+      if (count > 0 && (sl == NULL ||
+                        CFG_STORE_HDR_SIZE + len + size >
+                        CFG_STORE_BLOCK_MAX || count == UINT8_MAX))
+        {
+          cfg_store_seal(s->buf, count, len);
+          ret = s->io->rewrite_write(s->io->priv, s->buf,
+                                     CFG_STORE_HDR_SIZE + len);
+          new_len += CFG_STORE_HDR_SIZE + len;
+          len   = 0;
+          count = 0;
+        }
+
+      if (sl == NULL || ret < 0)
+        {
+          break;
+        }
+
+      /* The entry is rebuilt from its record in RAM */
+
+      cfg_store_ent_put(s->buf + CFG_STORE_HDR_SIZE + len,
+                        (const char *)s->arena + sl->key, sl->klen,
+                        (const char *)s->arena + sl->key + sl->klen,
+                        sl->vlen);
+      len += (uint16_t)size;
+      count++;
+    }
+
+  if (ret < 0)
+    {
+      s->io->rewrite_end(s->io->priv, false);
+      cfg_store_load(s);
+      return ret;
+    }
+
+  ret = s->io->rewrite_end(s->io->priv, true);
+  if (ret < 0)
+    {
+      cfg_store_load(s);
+      return ret;
+    }
+
+  s->next_id = 0;
+  for (int i = 0; i < CFG_STORE_SLOTS; i++)
+    {
+      struct cfg_slot_s *sl = &s->slots[i];
+
+      if (sl->state == CFG_SLOT_LIVE)
+        {
+          sl->id = s->next_id < CFG_STORE_IDS ? s->next_id :
+                                                CFG_STORE_NO_ID;
+          if (sl->id != CFG_STORE_NO_ID)
+            {
+              s->ids[s->next_id++] = (uint8_t)i;
+            }
+        }
+    }
+
+  s->file_len = new_len;
+  s->stats.compactions++;
+  return OK;
+}
+
+#endif /* __APPS_CONFIG_CONFIG_STORE_H */
@@ -0,0 +1,682 @@
+/****************************************************************************
+ * apps/config/config_svc.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * The system's config service: one RAM copy of /config/config.log
+ * shared by `config`, hactl, mcast and the board bring-up (see
+ * config_svc.h). It is loaded on first use, normally from the board's
+ * mount work right after the mount. While the board has the mount
+ * pending (config_svc_defer()), every call that needs the store waits
+ * for config_svc_ready() instead of finding /config empty. File
+ * descriptors belong to the task that opened them, so the file is open
+ * only while one task loads or writes it; reads never need it.
+ *
+ * Two locks: g_lock guards the store and is held only for a lookup or a
+ * commit; g_write_lock orders writers, including the compaction task,
+ * and is kept while the watchers run so the committed block they read
+ * from the store's buffer stays put.
+ *
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <errno.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <time.h>
+#include <syslog.h>
+
+#include "config_svc.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#define CONFIG_BASE_PATH    "/config"
+#define CONFIG_STORE_FILE   CFG_STORE_PATH
+#define CONFIG_STORE_NEW    CONFIG_BASE_PATH "/config.new"
+
+#ifndef CONFIG_CONFIG_COMPACT_KB
+#  define CONFIG_CONFIG_COMPACT_KB 4
+#endif
+
+#define CONFIG_COMPACT_STACK 2048
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static const struct config_svc_default_s g_defaults[] =
+{
+  { "wifi.ssid",           "",           "Wi-Fi network name" },
+  { "wifi.psk",            "",           "Wi-Fi password" },
+  { "wifi.static",         "",           "Fixed IPv4: ip,mask,gw,dns" },
+  { "ha.url",              "",           "Home Assistant URL/IP" },
+  { "ha.port",             "8123",       "Home Assistant port (8123)" },
+  { "ha.token",            "",           "HA long-lived access token" },
+  { "mmwave.uart",         "/dev/ttyS1", "Sensor UART path (/dev/ttyS1)" },
+  { "mmwave.baud",         "256000",     "Sensor baud rate (256000)" },
+  { "boot.autostart_ha",   "0",          "Auto-start HA reporting (0/1)" },
+  { "boot.autostart_wifi", "1",          "Auto-start Wi-Fi (0/1)" },
+};
+
+#define CONFIG_NDEFAULTS ((int)(sizeof(g_defaults) / sizeof(g_defaults[0])))
+
+static sem_t g_lock = SEM_INITIALIZER(1);
+static sem_t g_write_lock = SEM_INITIALIZER(1);
+static struct cfg_svc_s g_svc;
+static int g_fd = -1;                  /* config.log while in use */
+static int g_new_fd = -1;              /* config.new while compacting */
+static volatile pid_t g_compact_pid = -1;
+
+/* Ready unless the board defers the mount; the semaphore is a gate,
+ * each waiter let through passes it on.
+ */
+
+static sem_t g_ready_sem = SEM_INITIALIZER(0);
+static volatile bool g_ready = true;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static void config_svc_wait(FAR sem_t *sem)
+{
+  while (sem_wait(sem) < 0 && errno == EINTR);
+}
+
+/* ---- File operations for the store ---- */
+
+static ssize_t config_io_read(FAR void *priv, uint32_t off,
+                              FAR uint8_t *buf, size_t len)
+{
+  ssize_t n = pread(g_fd, buf, len, off);
+
+  return n < 0 ? -errno : n;
+}
+
+static int config_io_append(FAR void *priv, FAR const uint8_t *buf,
+                            size_t len)
+{
+  if (write(g_fd, buf, len) != (ssize_t)len || fsync(g_fd) < 0)
+    {
+      return -EIO;
+    }
+
+  return OK;
+}
+
+static int config_io_truncate(FAR void *priv, uint32_t len)
+{
+  return ftruncate(g_fd, len) < 0 ? -errno : OK;
+}
+
+static int config_io_rewrite_begin(FAR void *priv)
+{
+  g_new_fd = open(CONFIG_STORE_NEW, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  return g_new_fd < 0 ? -errno : OK;
+}
+
+static int config_io_rewrite_write(FAR void *priv, FAR const uint8_t *buf,
+                                   size_t len)
+{
+  return write(g_new_fd, buf, len) == (ssize_t)len ? OK : -EIO;
+}
+
+/* The rename is the commit point: either file is complete on its own */
+
+static int config_io_rewrite_end(FAR void *priv, bool commit)
+{
+  int ret = OK;
+
+  if (commit && fsync(g_new_fd) < 0)
+    {
+      ret = -EIO;
+    }
+
+  close(g_new_fd);
+  g_new_fd = -1;
+
+  if (commit && ret == OK && rename(CONFIG_STORE_NEW, CONFIG_STORE_FILE) < 0)
+    {
+      ret = -errno;
+    }
+
+  if (!commit || ret < 0)
+    {
+      unlink(CONFIG_STORE_NEW);
+      return ret;
+    }
+
+  close(g_fd);
+  g_fd = open(CONFIG_STORE_FILE, O_RDWR | O_APPEND);
+  return g_fd < 0 ? -errno : OK;
+}
+
+static const struct cfg_store_io_s g_config_io =
+{
+  config_io_read, config_io_append, config_io_truncate,
+  config_io_rewrite_begin, config_io_rewrite_write, config_io_rewrite_end,
+  NULL
+};
+
+/* ---- Loading ---- */
+
+static bool config_legacy_key(FAR const char *name)
+{
+  if (strncmp(name, "boot.", 5) == 0)
+    {
+      return true;
+    }
+
+  for (int i = 0; i < CONFIG_NDEFAULTS; i++)
+    {
+      if (strcmp(name, g_defaults[i].key) == 0)
+        {
+          return true;
+        }
+    }
+
+  return false;
+}
+
+/**
+ * Move keys stored one file each by earlier versions into the store, as
+ * one transaction; the old files go only once it is written.
+ */
+
+static void config_migrate(void)
+{
+  FAR struct cfg_store_s *s = &g_svc.store;
+  FAR struct dirent *entry;
+  char path[CFG_KEY_MAX + sizeof(CONFIG_BASE_PATH) + 1];
+  char val[CFG_VAL_MAX + 1];
+  int moved = 0;
+  FAR DIR *dirp;
+
+  dirp = opendir(CONFIG_BASE_PATH);
+  if (dirp == NULL)
+    {
+      return;
+    }
+
+  cfg_store_begin(s);
+  while ((entry = readdir(dirp)) != NULL)
+    {
+      if (!config_legacy_key(entry->d_name) ||
+          strlen(entry->d_name) > CFG_KEY_MAX)
+        {
+          continue;
+        }
+
+      snprintf(path, sizeof(path), "%s/%s", CONFIG_BASE_PATH,
+               entry->d_name);
+
+      int fd = open(path, O_RDONLY);
+      if (fd < 0)
+        {
+          continue;
+        }
+
+      ssize_t n = read(fd, val, sizeof(val) - 1);
+      close(fd);
+
+      val[n > 0 ? n : 0] = '\0';
+      if (cfg_store_put(s, entry->d_name, val) == OK)
+        {
+          moved++;
+        }
+    }
+
+  if (moved > 0 && cfg_store_commit(s) == OK)
+    {
+      rewinddir(dirp);
+      while ((entry = readdir(dirp)) != NULL)
+        {
+          if (config_legacy_key(entry->d_name))
+            {
+              snprintf(path, sizeof(path), "%s/%s", CONFIG_BASE_PATH,
+                       entry->d_name);
+              unlink(path);
+            }
+        }
+
+      syslog(LOG_INFO, "config: moved %d key(s) into %s\n", moved,
+             CONFIG_STORE_FILE);
+    }
+
+  closedir(dirp);
+}
+
+static int config_svc_open(void)
+{
+  g_fd = open(CONFIG_STORE_FILE, O_RDWR | O_CREAT | O_APPEND, 0666);
+  if (g_fd < 0)
+    {
+      int ret = -errno;
+
+      syslog(LOG_ERR, "config: cannot open %s: %d\n", CONFIG_STORE_FILE,
+             ret);
+      return ret;
+    }
+
+  return OK;
+}
+
+static void config_svc_close(void)
+{
+  if (g_fd >= 0)
+    {
+      close(g_fd);
+      g_fd = -1;
+    }
+}
+
+/* With g_lock held: build the RAM copy, once */
+
+static int config_svc_load_locked(void)
+{
+  int ret;
+
+  if (g_svc.loaded)
+    {
+      return OK;
+    }
+
+  /* A compaction that never reached its rename leaves this behind */
+
+  unlink(CONFIG_STORE_NEW);
+
+  ret = config_svc_open();
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  cfg_store_init(&g_svc.store, &g_config_io,
+                 CONFIG_CONFIG_COMPACT_KB * 1024);
+  ret = cfg_store_load(&g_svc.store);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR, "config: cannot read %s: %d\n", CONFIG_STORE_FILE,
+             ret);
+      config_svc_close();
+      return ret;
+    }
+
+  if (g_svc.store.stats.torn > 0)
+    {
+      syslog(LOG_WARNING, "config: dropped an incomplete write at the "
+             "end of %s\n", CONFIG_STORE_FILE);
+    }
+
+  if (g_svc.store.file_len == 0)
+    {
+      config_migrate();
+    }
+
+  config_svc_close();
+  g_svc.loaded = true;
+  return OK;
+}
+
+/* Take g_lock with the store loaded; false (lock released) if it is not */
+
+static bool config_svc_enter(void)
+{
+  config_svc_wait_ready(CONFIG_CONFIG_READY_MS);
+  config_svc_wait(&g_lock);
+  if (config_svc_load_locked() < 0)
+    {
+      sem_post(&g_lock);
+      return false;
+    }
+
+  return true;
+}
+
+/* ---- Writes ---- */
+
+static int config_compact_task(int argc, FAR char *argv[]);
+
+/*
+ * Writers: take both locks with the store loaded and the file open in
+ * this task, and start a transaction. False (nothing held) on failure.
+ */
+
+static bool config_svc_write(void)
+{
+  config_svc_wait_ready(CONFIG_CONFIG_READY_MS);
+  config_svc_wait(&g_write_lock);
+  if (!config_svc_enter())
+    {
+      sem_post(&g_write_lock);
+      return false;
+    }
+
+  if (config_svc_open() < 0)
+    {
+      sem_post(&g_lock);
+      sem_post(&g_write_lock);
+      return false;
+    }
+
+  cfg_store_begin(&g_svc.store);
+  return true;
+}
+
+/**
+ * End a write started with config_svc_write(): close the file, release
+ * the store, run the watchers, and hand a file that is mostly stale
+ * entries to a low-priority task.
+ */
+
+static int config_svc_write_end(int ret)
+{
+  bool due = ret == OK && cfg_store_compact_due(&g_svc.store);
+
+  config_svc_close();
+  sem_post(&g_lock);
+  if (ret == OK)
+    {
+      cfg_svc_notify(&g_svc);
+    }
+
+  if (due && g_compact_pid < 0)
+    {
+      g_compact_pid = task_create("config_compact", SCHED_PRIORITY_MIN + 1,
+                                  CONFIG_COMPACT_STACK, config_compact_task,
+                                  NULL);
+    }
+
+  sem_post(&g_write_lock);
+  return ret;
+}
+
+static int config_compact_task(int argc, FAR char *argv[])
+{
+  if (config_svc_write())
+    {
+      if (cfg_store_compact_due(&g_svc.store))
+        {
+          cfg_store_compact(&g_svc.store);
+        }
+
+      g_compact_pid = -1;
+      config_svc_write_end(OK);
+    }
+  else
+    {
+      g_compact_pid = -1;
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+void config_svc_defer(void)
+{
+  g_ready = false;
+}
+
+void config_svc_ready(void)
+{
+  if (!g_ready)
+    {
+      g_ready = true;
+      sem_post(&g_ready_sem);
+    }
+}
+
+/* A caller that times out stops the waiting for everyone: the store is
+ * then loaded on first use as it was before the mount was deferred.
+ */
+
+int config_svc_wait_ready(unsigned int timeout_ms)
+{
+  struct timespec abstime;
+
+  if (g_ready)
+    {
+      return OK;
+    }
+
+  clock_gettime(CLOCK_REALTIME, &abstime);
+  abstime.tv_sec  += timeout_ms / 1000;
+  abstime.tv_nsec += (long)(timeout_ms % 1000) * 1000000;
+  if (abstime.tv_nsec >= 1000000000)
+    {
+      abstime.tv_sec++;
+      abstime.tv_nsec -= 1000000000;
+    }
+
+  while (!g_ready)
+    {
+      if (sem_timedwait(&g_ready_sem, &abstime) == OK)
+        {
+          sem_post(&g_ready_sem);
+        }
+      else if (errno == ETIMEDOUT)
+        {
+          syslog(LOG_WARNING, "config: /config not ready after %u ms\n",
+                 timeout_ms);
+          g_ready = true;
+          return -ETIMEDOUT;
+        }
+    }
+
+  return OK;
+}
+
+int config_svc_load(void)
+{
+  int ret;
+
+  config_svc_wait(&g_lock);
+  ret = config_svc_load_locked();
+  sem_post(&g_lock);
+  return ret;
+}
+
+int config_svc_get(FAR const char *key, FAR char *buf, size_t size)
+{
+  int ret;
+
+  if (!config_svc_enter())
+    {
+      return -EIO;
+    }
+
+  ret = cfg_store_get(&g_svc.store, key, buf, size);
+  sem_post(&g_lock);
+  return ret;
+}
+
+FAR char *config_svc_get_str(FAR const char *key, FAR char *buf,
+                             size_t size, FAR const char *def)
+{
+  if (!config_svc_enter())
+    {
+      strncpy(buf, def != NULL ? def : "", size - 1);
+      buf[size - 1] = '\0';
+      return buf;
+    }
+
+  cfg_svc_get_str(&g_svc, key, buf, size, def);
+  sem_post(&g_lock);
+  return buf;
+}
+
+long config_svc_get_int(FAR const char *key, long def)
+{
+  long n;
+
+  if (!config_svc_enter())
+    {
+      return def;
+    }
+
+  n = cfg_svc_get_int(&g_svc, key, def);
+  sem_post(&g_lock);
+  return n;
+}
+
+bool config_svc_get_bool(FAR const char *key, bool def)
+{
+  bool b;
+
+  if (!config_svc_enter())
+    {
+      return def;
+    }
+
+  b = cfg_svc_get_bool(&g_svc, key, def);
+  sem_post(&g_lock);
+  return b;
+}
+
+int config_svc_set_many(FAR const char *const *kv, int npairs)
+{
+  int ret = OK;
+
+  if (!config_svc_write())
+    {
+      return -EIO;
+    }
+
+  for (int i = 0; i < npairs && ret == OK; i++)
+    {
+      ret = kv[2 * i + 1] != NULL ?
+            cfg_store_put(&g_svc.store, kv[2 * i], kv[2 * i + 1]) :
+            cfg_store_del(&g_svc.store, kv[2 * i]);
+    }
+
+  if (ret == OK)
+    {
+      ret = cfg_svc_commit(&g_svc);
+    }
+
+  return config_svc_write_end(ret);
+}
+
+int config_svc_set(FAR const char *key, FAR const char *val)
+{
+  FAR const char *kv[2];
+
+  kv[0] = key;
+  kv[1] = val;
+  return config_svc_set_many(kv, 1);
+}
+
+int config_svc_unset(FAR const char *key)
+{
+  char val[CFG_VAL_MAX + 1];
+  int ret;
+
+  if (!config_svc_write())
+    {
+      return -EIO;
+    }
+
+  ret = cfg_store_get(&g_svc.store, key, val, sizeof(val));
+  if (ret >= 0)
+    {
+      ret = cfg_store_del(&g_svc.store, key);
+    }
+
+  if (ret == OK)
+    {
+      ret = cfg_svc_commit(&g_svc);
+    }
+
+  return config_svc_write_end(ret < 0 ? ret : OK);
+}
+
+/* Clearing and the defaults go in one transaction: one append */
+
+int config_svc_reset(void)
+{
+  int ret;
+
+  if (!config_svc_write())
+    {
+      return -EIO;
+    }
+
+  ret = cfg_store_clear(&g_svc.store);
+  for (int i = 0; i < CONFIG_NDEFAULTS && ret == OK; i++)
+    {
+      ret = cfg_store_put(&g_svc.store, g_defaults[i].key,
+                          g_defaults[i].value);
+    }
+
+  if (ret == OK)
+    {
+      ret = cfg_svc_commit(&g_svc);
+    }
+
+  return config_svc_write_end(ret);
+}
+
+int config_svc_compact(void)
+{
+  int ret;
+
+  if (!config_svc_write())
+    {
+      return -EIO;
+    }
+
+  ret = cfg_store_compact(&g_svc.store);
+  return config_svc_write_end(ret);
+}
+
+int config_svc_next(FAR int *pos, FAR char *key, FAR char *val)
+{
+  int ret;
+
+  if (!config_svc_enter())
+    {
+      return -EIO;
+    }
+
+  ret = cfg_store_next(&g_svc.store, pos, key, val);
+  sem_post(&g_lock);
+  return ret;
+}
+
+void config_svc_stats(FAR uint32_t *file_len, FAR uint32_t *live_bytes,
+                      FAR struct cfg_store_stats_s *stats)
+{
+  config_svc_wait(&g_lock);
+  *file_len   = g_svc.store.file_len;
+  *live_bytes = g_svc.store.live_bytes;
+  *stats      = g_svc.store.stats;
+  sem_post(&g_lock);
+}
+
+int config_svc_watch(FAR const char *prefix, cfg_svc_notify_t cb,
+                     FAR void *arg)
+{
+  int ret;
+
+  config_svc_wait(&g_write_lock);
+  ret = cfg_svc_watch(&g_svc, prefix, cb, arg);
+  sem_post(&g_write_lock);
+  return ret;
+}
+
+FAR const struct config_svc_default_s *config_svc_default(int i)
+{
+  return i >= 0 && i < CONFIG_NDEFAULTS ? &g_defaults[i] : NULL;
+}
@@ -0,0 +1,312 @@
+/*
+ * apps/config/config_svc.h
+ *
+ * The config store held in RAM for the whole system. It is loaded once,
+ * normally by the board bring-up right after /config is mounted, and
+ * every app then reads settings from memory through the same instance
+ * (one image in the flat build): no file is opened and no flash is read
+ * for a get.
+ *
+ *   - Typed getters return the caller's default when a key is unset or
+ *     does not parse, so an app needs no defaults file of its own.
+ *   - Writes are transactions of the underlying store (config_store.h):
+ *     several keys are changed with one append or not at all.
+ *   - Watchers registered on a key prefix are called after each write
+ *     that touches a matching key, on the writer's task and without the
+ *     store locked: a callback may read settings but must not write
+ *     them. Keep callbacks short; setting a flag is typical.
+ *   - `config export` writes every key as an NSH `set` line, so a boot
+ *     script can source one file instead of running `config get` per
+ *     key.
+ *
+ * The part below that works on a struct cfg_svc_s is host-testable;
+ * config_svc.c holds the system's instance, its locking and file I/O.
+ */
+
+#ifndef __APPS_CONFIG_CONFIG_SVC_H
+#define __APPS_CONFIG_CONFIG_SVC_H
+
+#include <nuttx/config.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "apps/config/config_store.h"
+
+#define CFG_SVC_WATCH_MAX       8
+#define CFG_SVC_EXPORT_MAX      (CFG_KEY_MAX + CFG_VAL_MAX + 10)
+
+/* key is NULL after a reset (every key may have changed), val is NULL
+ * when key was deleted.
+ */
+
+typedef void (*cfg_svc_notify_t)(FAR const char *key, FAR const char *val,
+                                 FAR void *arg);
+
+struct cfg_svc_watch_s
+{
+  FAR const char  *prefix;
+  cfg_svc_notify_t cb;
+  FAR void        *arg;
+};
+
+struct cfg_svc_s
+{
+  struct cfg_store_s store;
+  struct cfg_svc_watch_s watch[CFG_SVC_WATCH_MAX];
+  uint8_t  nwatch;
+  bool     loaded;
+
+  /* The last committed block is still in store.buf: what to notify */
+
+  uint8_t  notify_count;
+  uint16_t notify_len;
+};
+
+struct config_svc_default_s
+{
+  FAR const char *key;
+  FAR const char *value;
+  FAR const char *help;
+};
+
+/* ---- Typed reads ---- */
+
+/* Copy key's value into buf, or def when it is unset or too long */
+
+static inline FAR char *cfg_svc_get_str(FAR struct cfg_svc_s *svc,
+                                        FAR const char *key, FAR char *buf,
+                                        size_t size, FAR const char *def)
+{
+  if (cfg_store_get(&svc->store, key, buf, size) < 0)
+    {
+      strncpy(buf, def != NULL ? def : "", size - 1);
+      buf[size - 1] = '\0';
+    }
+
+  return buf;
+}
+
+/* Decimal or 0x hex, the whole value; def otherwise */
+
+static inline long cfg_svc_get_int(FAR struct cfg_svc_s *svc,
+                                   FAR const char *key, long def)
+{
+  char val[24];
+  FAR char *end;
+  long n;
+
+  if (cfg_store_get(&svc->store, key, val, sizeof(val)) <= 0)
+    {
+      return def;
+    }
+
+  errno = 0;
+  n = strtol(val, &end, 0);
+  return *end == '\0' && errno == 0 ? n : def;
+}
+
+static inline bool cfg_svc_get_bool(FAR struct cfg_svc_s *svc,
+                                    FAR const char *key, bool def)
+{
+  static const char *const on[]  = { "1", "on", "yes", "true" };
+  static const char *const off[] = { "0", "off", "no", "false" };
+  char val[8];
+
+  if (cfg_store_get(&svc->store, key, val, sizeof(val)) <= 0)
+    {
+      return def;
+    }
+
+  for (int i = 0; i < 4; i++)
+    {
+      if (strcmp(val, on[i]) == 0)
+        {
+          return true;
+        }
+
+      if (strcmp(val, off[i]) == 0)
+        {
+          return false;
+        }
+    }
+
+  return def;
+}
+
+/* ---- Change notification ---- */
+
+static inline int cfg_svc_watch(FAR struct cfg_svc_s *svc,
+                                FAR const char *prefix, cfg_svc_notify_t cb,
+                                FAR void *arg)
+{
+  for (int i = 0; i < svc->nwatch; i++)
+    {
+      if (svc->watch[i].cb == cb && svc->watch[i].arg == arg &&
+          strcmp(svc->watch[i].prefix, prefix) == 0)
+        {
+          return OK;
+        }
+    }
+
+  if (svc->nwatch >= CFG_SVC_WATCH_MAX)
+    {
+      return -ENOSPC;
+    }
+
+  svc->watch[svc->nwatch].prefix = prefix;
+  svc->watch[svc->nwatch].cb     = cb;
+  svc->watch[svc->nwatch].arg    = arg;
+  svc->nwatch++;
+  return OK;
+}
+
+/* Commit the staged transaction and remember it for cfg_svc_notify() */
+
+static inline int cfg_svc_commit(FAR struct cfg_svc_s *svc)
+{
+  uint8_t count = svc->store.txn_count;
+  int ret = cfg_store_commit(&svc->store);
+
+  /* The payload as written: a lone set may have been shortened */
+
+  svc->notify_count = ret == OK ? count : 0;
+  svc->notify_len   = ret == OK ? cfg_store_get16(svc->store.buf + 2) : 0;
+  return ret;
+}
+
+/* Tell the watchers about every entry of the last commit, in order */
+
+static inline void cfg_svc_notify(FAR struct cfg_svc_s *svc)
+{
+  FAR const uint8_t *p = svc->store.buf + CFG_STORE_HDR_SIZE;
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  uint16_t pos = 0;
+
+  for (int n = 0; n < svc->notify_count && pos < svc->notify_len; n++)
+    {
+      uint16_t vlen = cfg_store_get16(p + pos + 1);
+      uint8_t  klen = cfg_store_ent_key(&svc->store, p + pos, key);
+      bool del = vlen == CFG_STORE_DELETE;
+
+      if (!del)
+        {
+          memcpy(val, p + pos + cfg_store_ent_size(p[pos], 0), vlen);
+          val[vlen] = '\0';
+        }
+
+      for (int i = 0; i < svc->nwatch; i++)
+        {
+          FAR const struct cfg_svc_watch_s *w = &svc->watch[i];
+
+          if (klen == 0)
+            {
+              w->cb(NULL, NULL, w->arg);
+            }
+          else if (strncmp(key, w->prefix, strlen(w->prefix)) == 0)
+            {
+              w->cb(key, del ? NULL : val, w->arg);
+            }
+        }
+
+      pos += (uint16_t)cfg_store_ent_size(p[pos], vlen);
+    }
+
+  svc->notify_count = 0;
+}
+
+/* ---- Export for scripts ---- */
+
+/*
+ * One NSH line setting a variable named after key: upper case, with
+ * '.' and '-' as '_' (wifi.ssid -> WIFI_SSID). NSH has no escapes in
+ * double quotes, so a value holding '"', '$' or '\' or a control
+ * character gives a comment instead and -EINVAL; scripts fall back to
+ * `config get` for it. Returns the line's length.
+ */
+
+static inline int cfg_svc_export_line(FAR const char *key,
+                                      FAR const char *val, FAR char *line,
+                                      size_t size)
+{
+  char name[CFG_KEY_MAX + 1];
+  bool ok = true;
+  size_t i;
+
+  for (i = 0; key[i] != '\0' && i < CFG_KEY_MAX; i++)
+    {
+      char c = key[i];
+
+      name[i] = c == '.' || c == '-' ? '_' :
+                c >= 'a' && c <= 'z' ? (char)(c - 'a' + 'A') : c;
+    }
+
+  name[i] = '\0';
+  for (i = 0; val[i] != '\0'; i++)
+    {
+      if (val[i] == '"' || val[i] == '$' || val[i] == '\\' ||
+          (unsigned char)val[i] < 0x20)
+        {
+          ok = false;
+        }
+    }
+
+  if (!ok)
+    {
+      snprintf(line, size, "# %s not exported: config get %s\n", name,
+               key);
+      return -EINVAL;
+    }
+
+  return snprintf(line, size, "set %s \"%s\"\n", name, val);
+}
+
+/* ---- The system's instance (config_svc.c) ---- */
+
+int  config_svc_load(void);
+
+/* The board mounts /config after the sensor is up: config_svc_defer()
+ * before it queues the mount, config_svc_ready() once the store is
+ * loaded (or cannot be). Calls below wait for it; code that opens files
+ * under /config itself calls config_svc_wait_ready() first.
+ */
+
+#ifndef CONFIG_CONFIG_READY_MS
+#  define CONFIG_CONFIG_READY_MS 15000
+#endif
+
+void config_svc_defer(void);
+void config_svc_ready(void);
+int  config_svc_wait_ready(unsigned int timeout_ms);
+
+/* Value of key as a string: its length, or -ENOENT / -E2BIG */
+
+int  config_svc_get(FAR const char *key, FAR char *buf, size_t size);
+FAR char *config_svc_get_str(FAR const char *key, FAR char *buf,
+                             size_t size, FAR const char *def);
+long config_svc_get_int(FAR const char *key, long def);
+bool config_svc_get_bool(FAR const char *key, bool def);
+
+/* kv holds npairs of key and value; a NULL value deletes the key */
+
+int  config_svc_set_many(FAR const char *const *kv, int npairs);
+int  config_svc_set(FAR const char *key, FAR const char *val);
+int  config_svc_unset(FAR const char *key);
+int  config_svc_reset(void);
+int  config_svc_compact(void);
+
+/* Walk every key as cfg_store_next() does */
+
+int  config_svc_next(FAR int *pos, FAR char *key, FAR char *val);
+void config_svc_stats(FAR uint32_t *file_len, FAR uint32_t *live_bytes,
+                      FAR struct cfg_store_stats_s *stats);
+int  config_svc_watch(FAR const char *prefix, cfg_svc_notify_t cb,
+                      FAR void *arg);
+FAR const struct config_svc_default_s *config_svc_default(int i);
+
+#endif /* __APPS_CONFIG_CONFIG_SVC_H */
@@ -0,0 +1,930 @@
+/*
+ * apps/esphome/esphome_api.h
+ *
+ * Server side of the ESPHome native API, plaintext transport, reduced
+ * to what a presence sensor needs: Hello, Connect, DeviceInfo,
+ * ListEntities, SubscribeStates, Ping and Disconnect in; entity
+ * descriptions and BinarySensor/Sensor state pushes out.
+ *
+ * Every message is framed as
+ *
+ *   0x00 | varint payload length | varint message type | protobuf payload
+ *
+ * Payloads are hand-encoded protobuf; only the fields listed next to
+ * each builder are written. Pure functions over caller buffers plus one
+ * per-connection state machine that talks through a send callback, so
+ * the whole exchange runs on the host against a loopback client.
+ */
+
+#ifndef __APPS_ESPHOME_ESPHOME_API_H
+#define __APPS_ESPHOME_ESPHOME_API_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+#define ESPH_API_PORT           6053
+#define ESPH_API_MAJOR          1
+#define ESPH_API_MINOR          10
+
+/* Message types (api.proto "id" option) */
+
+#define ESPH_MSG_HELLO_REQ              1
+#define ESPH_MSG_HELLO_RESP             2
+#define ESPH_MSG_CONNECT_REQ            3
+#define ESPH_MSG_CONNECT_RESP           4
+#define ESPH_MSG_DISCONNECT_REQ         5
+#define ESPH_MSG_DISCONNECT_RESP        6
+#define ESPH_MSG_PING_REQ               7
+#define ESPH_MSG_PING_RESP              8
+#define ESPH_MSG_DEVICE_INFO_REQ        9
+#define ESPH_MSG_DEVICE_INFO_RESP       10
+#define ESPH_MSG_LIST_ENTITIES_REQ      11
+#define ESPH_MSG_LIST_BINARY_SENSOR     12
+#define ESPH_MSG_LIST_SENSOR            16
+#define ESPH_MSG_LIST_ENTITIES_DONE     19
+#define ESPH_MSG_SUBSCRIBE_STATES_REQ   20
+#define ESPH_MSG_BINARY_SENSOR_STATE    21
+#define ESPH_MSG_SENSOR_STATE           25
+
+/* Protobuf wire types */
+
+#define ESPH_WT_VARINT          0
+#define ESPH_WT_LEN             2
+#define ESPH_WT_FIXED32         5
+
+/* SensorStateClass */
+
+#define ESPH_STATE_CLASS_MEASUREMENT 1
+
+/* Largest frame header: preamble + two 3-byte varints (< 2^21) */
+
+#define ESPH_HDR_MAX            7
+
+/* Outgoing frame buffer, header included; fits the largest entity */
+
+#define ESPH_TX_MAX             192
+
+/*
+ * Incoming payload bytes kept. Requests from HA are a few bytes;
+ * anything longer is consumed and truncated, which only loses
+ * fields this server never reads.
+ */
+#define ESPH_RX_KEEP            64
+
+/* Largest payload accepted before the stream is treated as garbage */
+
+#define ESPH_RX_MAX_PAYLOAD     4096
+
+#define ESPH_NAME_MAX           32
+
+/* esph_rx_feed() results */
+
+#define ESPH_RX_MORE            0
+#define ESPH_RX_MSG             1
+#define ESPH_RX_INVALID         (-1)
+
+/* esph_conn_input() result when the peer asked to disconnect */
+
+#define ESPH_CLOSE              1
+
+/* ---- Varints ---- */
+
+static inline size_t esph_varint_size(uint32_t v)
+{
+  size_t n = 1;
+
+  while (v >= 0x80)
+    {
+      v >>= 7;
+      n++;
+    }
+
+  return n;
+}
+
+static inline size_t esph_put_varint(uint8_t *buf, uint32_t v)
+{
+  size_t n = 0;
+
+  while (v >= 0x80)
+    {
+      buf[n++] = (uint8_t)(v | 0x80);
+      v >>= 7;
+    }
+
+  buf[n++] = (uint8_t)v;
+  return n;
+}
+
+/* ---- Protobuf writer ---- */
+
+/*
+ * A frame being built. The payload is written ESPH_HDR_MAX bytes into
+ * buf; esph_frame_finish() puts the header right in front of it, so
+ * nothing is copied. An overflow latches in error.
+ */
+struct esph_pb_s
+{
+  uint8_t *buf;
+  size_t   size;
+  size_t   len;        /* Payload bytes so far */
+  int      error;
+};
+
+static inline void esph_pb_init(struct esph_pb_s *pb, uint8_t *buf,
+                                size_t size)
+{
+  pb->buf   = buf;
+  pb->size  = size;
+  pb->len   = 0;
+  pb->error = size < ESPH_HDR_MAX ? -E2BIG : 0;
+}
+
+static inline uint8_t *esph_pb_room(struct esph_pb_s *pb, size_t n)
+{
+  if (pb->error < 0 || pb->size - ESPH_HDR_MAX - pb->len < n)
+    {
+      pb->error = -E2BIG;
+      return NULL;
+    }
+
+  return pb->buf + ESPH_HDR_MAX + pb->len;
+}
+
+static inline void esph_pb_tag(struct esph_pb_s *pb, uint32_t field,
+                               uint8_t wt)
+{
+  uint8_t *p = esph_pb_room(pb, 5);
+
+  if (p != NULL)
+    {
+      pb->len += esph_put_varint(p, field << 3 | wt);
+    }
+}
+
+/* proto3 scalars at their default value are left out, as protoc does */
+
+static inline void esph_pb_uint(struct esph_pb_s *pb, uint32_t field,
+                                uint32_t v)
+{
+  uint8_t *p;
+
+  if (v == 0)
+    {
+      return;
+    }
+
+  esph_pb_tag(pb, field, ESPH_WT_VARINT);
+  p = esph_pb_room(pb, 5);
+  if (p != NULL)
+    {
+      pb->len += esph_put_varint(p, v);
+    }
+}
+
+static inline void esph_pb_bool(struct esph_pb_s *pb, uint32_t field,
+                                bool v)
+{
+  esph_pb_uint(pb, field, v ? 1 : 0);
+}
+
+/* Entity keys are fixed32 and always written, so key 0 survives */
+
+static inline void esph_pb_fixed32(struct esph_pb_s *pb, uint32_t field,
+                                   uint32_t v)
+{
+  uint8_t *p;
+
+  esph_pb_tag(pb, field, ESPH_WT_FIXED32);
+  p = esph_pb_room(pb, 4);
+  if (p != NULL)
+    {
+      p[0] = (uint8_t)v;
+      p[1] = (uint8_t)(v >> 8);
+      p[2] = (uint8_t)(v >> 16);
+      p[3] = (uint8_t)(v >> 24);
+      pb->len += 4;
+    }
+}
+
+static inline void esph_pb_float(struct esph_pb_s *pb, uint32_t field,
+                                 float v)
+{
+  uint32_t bits;
+
+  memcpy(&bits, &v, sizeof(bits));
+  if (bits != 0)
+    {
+      esph_pb_fixed32(pb, field, bits);
+    }
+}
+
+static inline void esph_pb_string(struct esph_pb_s *pb, uint32_t field,
+                                  const char *s)
+{
+  size_t n = s != NULL ? strlen(s) : 0;
+  uint8_t *p;
+
+  if (n == 0)
+    {
+      return;
+    }
+
+  esph_pb_tag(pb, field, ESPH_WT_LEN);
+  p = esph_pb_room(pb, 5 + n);
+  if (p != NULL)
+    {
+      size_t k = esph_put_varint(p, (uint32_t)n);
+
+      memcpy(p + k, s, n);
+      pb->len += k + n;
+    }
+}
+
+/* "<a>_<b>" as one string field, without a scratch buffer */
+
+static inline void esph_pb_join(struct esph_pb_s *pb, uint32_t field,
+                                const char *a, const char *b)
+{
+  size_t na = strlen(a);
+  size_t nb = strlen(b);
+  uint8_t *p;
+
+  esph_pb_tag(pb, field, ESPH_WT_LEN);
+  p = esph_pb_room(pb, 5 + na + 1 + nb);
+  if (p != NULL)
+    {
+      size_t k = esph_put_varint(p, (uint32_t)(na + 1 + nb));
+
+      memcpy(p + k, a, na);
+      p[k + na] = '_';
+      memcpy(p + k + na + 1, b, nb);
+      pb->len += k + na + 1 + nb;
+    }
+}
+
+/*
+ * Wrap the payload as one frame of `type`. Returns the frame length
+ * with *start set, or -E2BIG if anything overflowed.
+ */
+static inline int esph_frame_finish(struct esph_pb_s *pb, uint16_t type,
+                                    uint8_t **start)
+{
+  size_t ll;
+  size_t hl;
+  uint8_t *p;
+
+  if (pb->error < 0)
+    {
+      return pb->error;
+    }
+
+  ll = esph_varint_size((uint32_t)pb->len);
+  hl = 1 + ll + esph_varint_size(type);
+  p  = pb->buf + ESPH_HDR_MAX - hl;
+
+  p[0] = 0x00;
+  esph_put_varint(p + 1, (uint32_t)pb->len);
+  esph_put_varint(p + 1 + ll, type);
+
+  *start = p;
+  return (int)(hl + pb->len);
+}
+
+/* ---- Protobuf reader ---- */
+
+/*
+ * Find string (or bytes) field `field` in a payload and copy it,
+ * NUL-terminated and truncated to outsize. Returns its length, or -1
+ * if absent or the payload is malformed.
+ */
+static inline int esph_pb_get_string(const uint8_t *buf, size_t len,
+                                     uint32_t field, char *out,
+                                     size_t outsize)
+{
+  size_t i = 0;
+
+  while (i < len)
+    {
+      uint32_t tag = 0;
+      uint32_t v   = 0;
+      unsigned shift;
+
+      for (shift = 0; i < len && shift < 35; shift += 7)
+        {
+          tag |= (uint32_t)(buf[i] & 0x7f) << shift;
+          if ((buf[i++] & 0x80) == 0)
+            {
+              break;
+            }
+        }
+
+      switch (tag & 7)
+        {
+          case ESPH_WT_VARINT:
+          case ESPH_WT_LEN:
+            for (shift = 0; i < len && shift < 35; shift += 7)
+              {
+                v |= (uint32_t)(buf[i] & 0x7f) << shift;
+                if ((buf[i++] & 0x80) == 0)
+                  {
+                    break;
+                  }
+              }
+
+            if ((tag & 7) == ESPH_WT_VARINT)
+              {
+                break;
+              }
+
+            if (v > len - i)
+              {
+                return -1;
+              }
+
+            if (tag >> 3 == field)
+              {
+                size_t n = v < outsize - 1 ? v : outsize - 1;
+
+                memcpy(out, buf + i, n);
+                out[n] = '\0';
+                return (int)n;
+              }
+
+            i += v;
+            break;
+
+          case ESPH_WT_FIXED32:
+            i += 4;
+            break;
+
+          case 1:            /* fixed64 */
+            i += 8;
+            break;
+
+          default:
+            return -1;
+        }
+    }
+
+  return -1;
+}
+
+/* ---- Frame reader ---- */
+
+enum esph_rx_state_e
+{
+  ESPH_RX_PREAMBLE = 0,
+  ESPH_RX_LENGTH,
+  ESPH_RX_TYPE,
+  ESPH_RX_PAYLOAD
+};
+
+/*
+ * Incremental frame reader. After ESPH_RX_MSG, type, len and the first
+ * ESPH_RX_KEEP payload bytes in data[] describe the message until the
+ * next call.
+ */
+struct esph_rx_s
+{
+  uint8_t  state;
+  uint8_t  shift;
+  uint16_t type;
+  uint32_t len;        /* Payload length */
+  uint32_t remaining;
+  uint8_t  pos;        /* Bytes kept in data[] */
+  uint8_t  data[ESPH_RX_KEEP];
+};
+
+static inline void esph_rx_init(struct esph_rx_s *rx)
+{
+  memset(rx, 0, sizeof(*rx));
+}
+
+/*
+ * Consume bytes until one message is complete. *used is set to the
+ * bytes consumed, so a caller holding several messages in one buffer
+ * feeds the rest again. A non-zero preamble (the Noise transport) or
+ * an oversized length is ESPH_RX_INVALID; the connection is then
+ * beyond recovery.
+ */
+static inline int esph_rx_feed(struct esph_rx_s *rx, const uint8_t *buf,
+                               size_t len, size_t *used)
+{
+  size_t i = 0;
+
+  while (i < len)
+    {
+      uint8_t c = buf[i];
+
+      switch (rx->state)
+        {
+          case ESPH_RX_PREAMBLE:
+            if (c != 0x00)
+              {
+                *used = i;
+                return ESPH_RX_INVALID;
+              }
+
+            rx->len   = 0;
+            rx->type  = 0;
+            rx->shift = 0;
+            rx->pos   = 0;
+            rx->state = ESPH_RX_LENGTH;
+            i++;
+            break;
+
+          case ESPH_RX_LENGTH:
+          case ESPH_RX_TYPE:
+            {
+              uint32_t v = (uint32_t)(c & 0x7f) << rx->shift;
+
+              if (rx->state == ESPH_RX_LENGTH)
+                {
+                  rx->len |= v;
+                }
+              else
+                {
+                  rx->type |= (uint16_t)v;
+                }
+
+              rx->shift += 7;
+              i++;
+
+              if (c & 0x80)
+                {
+                  if (rx->shift > 14)
+                    {
+                      *used = i;
+                      return ESPH_RX_INVALID;
+                    }
+
+                  break;
+                }
+
+              rx->shift = 0;
+              if (rx->state == ESPH_RX_LENGTH)
+                {
+                  if (rx->len > ESPH_RX_MAX_PAYLOAD)
+                    {
+                      *used = i;
+                      return ESPH_RX_INVALID;
+                    }
+
+                  rx->state = ESPH_RX_TYPE;
+                  break;
+                }
+
+              rx->remaining = rx->len;
+              rx->state     = ESPH_RX_PAYLOAD;
+              if (rx->remaining == 0)
+                {
+                  rx->state = ESPH_RX_PREAMBLE;
+                  *used = i;
+                  return ESPH_RX_MSG;
+                }
+            }
+            break;
+
+          case ESPH_RX_PAYLOAD:
+            {
+              size_t take = len - i;
+
+              if (take > rx->remaining)
+                {
+                  take = rx->remaining;
+                }
+
+              for (size_t k = 0; k < take && rx->pos < sizeof(rx->data);
+                   k++)
+                {
+                  rx->data[rx->pos++] = buf[i + k];
+                }
+
+              i             += take;
+              rx->remaining -= take;
+              if (rx->remaining == 0)
+                {
+                  rx->state = ESPH_RX_PREAMBLE;
+                  *used = i;
+                  return ESPH_RX_MSG;
+                }
+            }
+            break;
+        }
+    }
+
+  *used = i;
+  return ESPH_RX_MORE;
+}
+
+/* ---- Entities ---- */
+
+struct esph_entity_s
+{
+  const char *object;
+  const char *name;
+  const char *device_class;  /* NULL if none */
+  const char *unit;          /* NULL for the binary sensor */
+  const char *icon;          /* NULL if none */
+};
+
+/* Same entity set as MQTT discovery, so either path looks alike in HA */
+
+static const struct esph_entity_s g_esph_entities[] =
+{
+  { "presence",           "Presence",           "occupancy", NULL,
+    NULL },
+  { "motion_energy",      "Motion energy",      NULL,        "%",
+    "mdi:motion-sensor" },
+  { "static_energy",      "Static energy",      NULL,        "%",
+    "mdi:human-handsdown" },
+  { "motion_distance",    "Motion distance",    "distance",  "cm",
+    NULL },
+  { "static_distance",    "Static distance",    "distance",  "cm",
+    NULL },
+  { "detection_distance", "Detection distance", "distance",  "cm",
+    NULL },
+};
+
+#define ESPH_ENTITY_COUNT \
+  (sizeof(g_esph_entities) / sizeof(g_esph_entities[0]))
+
+/* Index of the one binary sensor; the rest are numeric sensors */
+
+#define ESPH_ENTITY_PRESENCE    0
+
+/* Entity key: 32-bit FNV-1 of the object id, as ESPHome derives it */
+
+static inline uint32_t esph_key(const char *object)
+{
+  uint32_t h = 2166136261u;
+
+  while (*object != '\0')
+    {
+      h *= 16777619u;
+      h ^= (uint8_t)*object++;
+    }
+
+  return h;
+}
+
+static inline float esph_entity_value(size_t idx,
+                                      const struct mmwave_data_s *d)
+{
+  switch (idx)
+    {
+      case ESPH_ENTITY_PRESENCE:
+        return d->target_state != LD2410_TARGET_NONE ? 1.0f : 0.0f;
+      case 1:
+        return d->motion_energy;
+      case 2:
+        return d->static_energy;
+      case 3:
+        return d->motion_distance;
+      case 4:
+        return d->static_distance;
+      default:
+        return d->detection_distance;
+    }
+}
+
+/* ---- Message payloads ---- */
+
+struct esph_device_s
+{
+  const char *name;          /* Node name, also the unique_id prefix */
+  const char *mac;           /* "AA:BB:CC:DD:EE:FF" */
+  const char *version;       /* Reported as esphome_version */
+  const char *build;         /* Reported as compilation_time */
+  const char *model;
+};
+
+/* HelloResponse: api_version_major=1, api_version_minor=2,
+ * server_info=3, name=4
+ */
+
+static inline void esph_hello_resp(struct esph_pb_s *pb,
+                                   const struct esph_device_s *dev)
+{
+  esph_pb_uint(pb, 1, ESPH_API_MAJOR);
+  esph_pb_uint(pb, 2, ESPH_API_MINOR);
+  esph_pb_string(pb, 3, "mmWave OS");
+  esph_pb_string(pb, 4, dev->name);
+}
+
+/* DeviceInfoResponse: uses_password=1, name=2, mac_address=3,
+ * esphome_version=4, compilation_time=5, model=6
+ */
+
+static inline void esph_device_info_resp(struct esph_pb_s *pb,
+                                         const struct esph_device_s *dev)
+{
+  esph_pb_bool(pb, 1, false);
+  esph_pb_string(pb, 2, dev->name);
+  esph_pb_string(pb, 3, dev->mac);
+  esph_pb_string(pb, 4, dev->version);
+  esph_pb_string(pb, 5, dev->build);
+  esph_pb_string(pb, 6, dev->model);
+}
+
+/*
+ * ListEntitiesBinarySensorResponse: object_id=1, key=2, name=3,
+ * unique_id=4, device_class=5.
+ * ListEntitiesSensorResponse: object_id=1, key=2, name=3, unique_id=4,
+ * icon=5, unit_of_measurement=6, accuracy_decimals=7, device_class=9,
+ * state_class=10.
+ * Returns the message type.
+ */
+static inline uint16_t esph_list_entity(struct esph_pb_s *pb, size_t idx,
+                                        const struct esph_device_s *dev)
+{
+  const struct esph_entity_s *e = &g_esph_entities[idx];
+
+  esph_pb_string(pb, 1, e->object);
+  esph_pb_fixed32(pb, 2, esph_key(e->object));
+  esph_pb_string(pb, 3, e->name);
+  esph_pb_join(pb, 4, dev->name, e->object);
+
+  if (idx == ESPH_ENTITY_PRESENCE)
+    {
+      esph_pb_string(pb, 5, e->device_class);
+      return ESPH_MSG_LIST_BINARY_SENSOR;
+    }
+
+  esph_pb_string(pb, 5, e->icon);
+  esph_pb_string(pb, 6, e->unit);                /* accuracy_decimals 0 */
+  esph_pb_string(pb, 9, e->device_class);
+  esph_pb_uint(pb, 10, ESPH_STATE_CLASS_MEASUREMENT);
+  return ESPH_MSG_LIST_SENSOR;
+}
+
+/* BinarySensorStateResponse / SensorStateResponse: key=1, state=2 */
+
+static inline uint16_t esph_state(struct esph_pb_s *pb, size_t idx,
+                                  float value)
+{
+  esph_pb_fixed32(pb, 1, esph_key(g_esph_entities[idx].object));
+
+  if (idx == ESPH_ENTITY_PRESENCE)
+    {
+      esph_pb_bool(pb, 2, value != 0.0f);
+      return ESPH_MSG_BINARY_SENSOR_STATE;
+    }
+
+  esph_pb_float(pb, 2, value);
+  return ESPH_MSG_SENSOR_STATE;
+}
+
+/* ---- Connection ---- */
+
+/* Send one complete frame. Returns 0 or a negative errno. */
+
+typedef int (*esph_send_t)(void *arg, const uint8_t *buf, size_t len);
+
+enum esph_conn_state_e
+{
+  ESPH_CONN_NEW = 0,         /* Waiting for HelloRequest */
+  ESPH_CONN_READY,           /* Hello done; no password, so usable */
+  ESPH_CONN_SUBSCRIBED       /* States are pushed on change */
+};
+
+struct esph_conn_s
+{
+  struct esph_rx_s rx;
+  esph_send_t send;
+  void       *arg;
+  uint8_t     state;         /* enum esph_conn_state_e */
+  uint8_t     sent;          /* Bit n: entity n has been sent a state */
+  uint32_t    tx_msgs;
+  uint32_t    tx_bytes;
+  uint32_t    rx_msgs;
+  float       last[ESPH_ENTITY_COUNT];
+  char        client[ESPH_NAME_MAX];  /* HelloRequest client_info */
+  uint8_t     tx[ESPH_TX_MAX];
+};
+
+static inline void esph_conn_init(struct esph_conn_s *c, esph_send_t send,
+                                  void *arg)
+{
+  memset(c, 0, sizeof(*c));
+  c->send = send;
+  c->arg  = arg;
+}
+
+static inline void esph_conn_begin(struct esph_conn_s *c,
+                                   struct esph_pb_s *pb)
+{
+  esph_pb_init(pb, c->tx, sizeof(c->tx));
+}
+
+static inline int esph_conn_send(struct esph_conn_s *c,
+                                 struct esph_pb_s *pb, uint16_t type)
+{
+  uint8_t *start;
+  int n = esph_frame_finish(pb, type, &start);
+  int ret;
+
+  if (n < 0)
+    {
+      return n;
+    }
+
+  ret = c->send(c->arg, start, (size_t)n);
+  if (ret == 0)
+    {
+      c->tx_msgs++;
+      c->tx_bytes += (uint32_t)n;
+    }
+
+  return ret;
+}
+
+static inline int esph_conn_empty(struct esph_conn_s *c, uint16_t type)
+{
+  struct esph_pb_s pb;
+
+  esph_conn_begin(c, &pb);
+  return esph_conn_send(c, &pb, type);
+}
+
+/*
+ * Send the state of every entity whose value differs from what this
+ * client last saw. The binary sensor is always considered; numeric
+ * sensors only when `sensors` is set, so the caller can pace them
+ * apart from presence. Returns the number of states sent, or a
+ * negative errno from the send callback.
+ */
+static inline int esph_conn_push(struct esph_conn_s *c,
+                                 const struct mmwave_data_s *d,
+                                 bool sensors)
+{
+  int count = 0;
+
+  if (c->state != ESPH_CONN_SUBSCRIBED || d == NULL)
+    {
+      return 0;
+    }
+
+  for (size_t i = 0; i < ESPH_ENTITY_COUNT; i++)
+    {
+      float v = esph_entity_value(i, d);
+      struct esph_pb_s pb;
+      uint16_t type;
+      int ret;
+
+      if (i != ESPH_ENTITY_PRESENCE && !sensors)
+        {
+          continue;
+        }
+
+      if ((c->sent & (1u << i)) != 0 && c->last[i] == v)
+        {
+          continue;
+        }
+
+      esph_conn_begin(c, &pb);
+      type = esph_state(&pb, i, v);
+      ret  = esph_conn_send(c, &pb, type);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      c->last[i] = v;
+      c->sent   |= (uint8_t)(1u << i);
+      count++;
+    }
+
+  return count;
+}
+
+/* Answer one complete request held in c->rx */
+
+static inline int esph_conn_handle(struct esph_conn_s *c,
+                                   const struct esph_device_s *dev,
+                                   const struct mmwave_data_s *d)
+{
+  struct esph_pb_s pb;
+  int ret;
+
+  c->rx_msgs++;
+
+  /* Nothing but Hello is answered before Hello */
+
+  if (c->state == ESPH_CONN_NEW && c->rx.type != ESPH_MSG_HELLO_REQ)
+    {
+      return c->rx.type == ESPH_MSG_DISCONNECT_REQ ? ESPH_CLOSE : -EPROTO;
+    }
+
+  switch (c->rx.type)
+    {
+      case ESPH_MSG_HELLO_REQ:
+        esph_pb_get_string(c->rx.data, c->rx.pos, 1, c->client,
+                           sizeof(c->client));
+        esph_conn_begin(c, &pb);
+        esph_hello_resp(&pb, dev);
+        ret = esph_conn_send(c, &pb, ESPH_MSG_HELLO_RESP);
+        if (ret == 0 && c->state == ESPH_CONN_NEW)
+          {
+            c->state = ESPH_CONN_READY;
+          }
+
+        return ret;
+
+      case ESPH_MSG_CONNECT_REQ:
+
+        /* No password: any ConnectRequest succeeds (invalid_password
+         * stays false, so the payload is empty).
+         */
+
+        return esph_conn_empty(c, ESPH_MSG_CONNECT_RESP);
+
+      case ESPH_MSG_DISCONNECT_REQ:
+        ret = esph_conn_empty(c, ESPH_MSG_DISCONNECT_RESP);
+        return ret < 0 ? ret : ESPH_CLOSE;
+
+      case ESPH_MSG_PING_REQ:
+        return esph_conn_empty(c, ESPH_MSG_PING_RESP);
+
+      case ESPH_MSG_DEVICE_INFO_REQ:
+        esph_conn_begin(c, &pb);
+        esph_device_info_resp(&pb, dev);
+        return esph_conn_send(c, &pb, ESPH_MSG_DEVICE_INFO_RESP);
+
+      case ESPH_MSG_LIST_ENTITIES_REQ:
+        for (size_t i = 0; i < ESPH_ENTITY_COUNT; i++)
+          {
+            uint16_t type;
+
+            esph_conn_begin(c, &pb);
+            type = esph_list_entity(&pb, i, dev);
+            ret  = esph_conn_send(c, &pb, type);
+            if (ret < 0)
+              {
+                return ret;
+              }
+          }
+
+        return esph_conn_empty(c, ESPH_MSG_LIST_ENTITIES_DONE);
+
+      case ESPH_MSG_SUBSCRIBE_STATES_REQ:
+
+        /* Full snapshot now, changes from here on */
+
+        c->state = ESPH_CONN_SUBSCRIBED;
+        c->sent  = 0;
+        ret = esph_conn_push(c, d, true);
+        return ret < 0 ? ret : 0;
+
+      default:
+
+        /* Log, service and time subscriptions etc. are not offered;
+         * ignoring them is what ESPHome does for unknown requests.
+         */
+
+        return 0;
+    }
+}
+
+/*
+ * Feed received bytes and answer every complete request in them.
+ * Returns 0, ESPH_CLOSE after a DisconnectRequest, or a negative errno
+ * (-EPROTO for a framing error or an out-of-order request).
+ */
+static inline int esph_conn_input(struct esph_conn_s *c,
+                                  const struct esph_device_s *dev,
+                                  const struct mmwave_data_s *d,
+                                  const uint8_t *buf, size_t len)
+{
+  while (len > 0)
+    {
+      size_t used;
+      int ret = esph_rx_feed(&c->rx, buf, len, &used);
+
+      buf += used;
+      len -= used;
+
+      if (ret == ESPH_RX_INVALID)
+        {
+          return -EPROTO;
+        }
+
+      if (ret == ESPH_RX_MSG)
+        {
+          ret = esph_conn_handle(c, dev, d);
+          if (ret != 0)
+            {
+              return ret;
+            }
+        }
+    }
+
+  return 0;
+}
+
+#endif /* __APPS_ESPHOME_ESPHOME_API_H */
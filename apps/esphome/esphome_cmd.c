@@ -0,0 +1,662 @@
+/****************************************************************************
+ * apps/esphome/esphome_cmd.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * NSH command: esphome — ESPHome native API server
+ *
+ * Usage:
+ *   esphome start             — Start the API server (in mmwaved if
+ *                               it is running, else in its own task)
+ *   esphome stop              — Stop it and drop all clients
+ *   esphome status            — Show server state and connected clients
+ *   esphome name <name>       — Set the node name reported to HA
+ *
+ * Home Assistant's ESPHome integration connects to the device once and
+ * keeps the connection; presence and the distance/energy sensors are
+ * pushed on that connection as they change. No HA URL or token lives
+ * on the device.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+
+#ifdef CONFIG_NETUTILS_NETLIB
+#  include "netutils/netlib.h"
+#endif
+
+#ifdef CONFIG_CONFIG_CMD
+#  include "apps/config/config_svc.h"
+#endif
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_service.h"
+#include "esphome_api.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_ESPHOME_API_PORT
+#  define CONFIG_ESPHOME_API_PORT       ESPH_API_PORT
+#endif
+
+#ifndef CONFIG_ESPHOME_API_CLIENTS
+#  define CONFIG_ESPHOME_API_CLIENTS    2
+#endif
+
+#ifndef CONFIG_ESPHOME_API_SENSOR_MS
+#  define CONFIG_ESPHOME_API_SENSOR_MS  1000
+#endif
+
+#define ESPH_NAME_FILE          "/config/esphome.name"
+#define ESPH_DEFAULT_NAME       "mmwave"
+#define ESPH_IFNAME             "wlan0"
+#define ESPH_TICK_MS            1000   /* Ping and timeout check period */
+#define ESPH_PING_MS            60000  /* Silence before we ping */
+#define ESPH_TIMEOUT_MS         150000 /* Silence before we give up */
+#define ESPH_RX_CHUNK           128
+#define ESPH_TASK_STACK         2048
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct esph_client_s
+{
+  int                fd;       /* -1 when the slot is free */
+  uint32_t           last_rx_ms;
+  bool               pinged;
+  char               addr[INET_ADDRSTRLEN];
+  struct esph_conn_s conn;
+};
+
+struct esph_stats_s
+{
+  uint32_t accepted;   /* Connections accepted */
+  uint32_t refused;    /* Turned away, all slots busy */
+  uint32_t dropped;    /* Closed on error or timeout */
+  uint32_t pushes;     /* State messages sent */
+  uint32_t tx_bytes;   /* Frame bytes sent, all clients */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int      esph_start(void);
+static void     esph_pollset(FAR struct pollfd *pfds);
+static int      esph_events(FAR const struct pollfd *pfds, uint32_t now);
+static void     esph_frame(FAR const struct mmwave_eng_data_s *eng,
+                           bool gates, uint32_t now);
+static uint32_t esph_tick(uint32_t now);
+static void     esph_stop(void);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct esph_client_s g_clients[CONFIG_ESPHOME_API_CLIENTS];
+static struct esph_stats_s  g_stats;
+static struct mmwave_data_s g_data;        /* Latest frame */
+static bool                 g_valid;
+static uint32_t             g_sensor_ms;   /* Last numeric sensor push */
+static int                  g_listenfd = -1;
+static volatile bool        g_running = false;
+static pid_t                g_server_pid = -1;
+
+static char g_name[ESPH_NAME_MAX] = ESPH_DEFAULT_NAME;
+static char g_mac[18];
+
+static const struct esph_device_s g_device =
+{
+  g_name,
+  g_mac,
+  "NuttX " CONFIG_VERSION_STRING,
+  __DATE__ ", " __TIME__,
+  "ESP32-C6 + LD2410"
+};
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* Run by the esphome_api task, or hosted by mmwaved */
+
+const struct mmwave_service_s g_esphome_service =
+{
+  "esphome", &g_running, CONFIG_ESPHOME_API_CLIENTS + 1, ESPH_TASK_STACK,
+  esph_start, esph_pollset, esph_events, esph_frame, esph_tick, esph_stop
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/* Same rules as an ESPHome node name: lowercase, digits and '-' */
+
+static bool esph_name_valid(FAR const char *name)
+{
+  size_t n = 0;
+
+  for (; name[n] != '\0'; n++)
+    {
+      char c = name[n];
+
+      if (!((c >= 'a' && c <= 'z') || (c >= '0' && c <= '9') || c == '-'))
+        {
+          return false;
+        }
+    }
+
+  return n > 0 && n < ESPH_NAME_MAX;
+}
+
+static void esph_load_name(void)
+{
+  char buf[ESPH_NAME_MAX];
+  int fd;
+
+#ifdef CONFIG_CONFIG_CMD
+  config_svc_wait_ready(CONFIG_CONFIG_READY_MS);
+#endif
+
+  fd = open(ESPH_NAME_FILE, O_RDONLY);
+  if (fd < 0)
+    {
+      return;
+    }
+
+  ssize_t n = read(fd, buf, sizeof(buf) - 1);
+  close(fd);
+
+  while (n > 0 && (buf[n - 1] == '\n' || buf[n - 1] == '\r'))
+    {
+      n--;
+    }
+
+  if (n > 0)
+    {
+      buf[n] = '\0';
+      if (esph_name_valid(buf))
+        {
+          strlcpy(g_name, buf, sizeof(g_name));
+        }
+    }
+}
+
+static int esph_save_name(FAR const char *name)
+{
+  int fd = open(ESPH_NAME_FILE, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  ssize_t n = write(fd, name, strlen(name));
+  close(fd);
+  return n == (ssize_t)strlen(name) ? OK : -EIO;
+}
+
+static void esph_load_mac(void)
+{
+#ifdef CONFIG_NETUTILS_NETLIB
+  uint8_t mac[6];
+
+  if (netlib_getmacaddr(ESPH_IFNAME, mac) == OK)
+    {
+      snprintf(g_mac, sizeof(g_mac), "%02X:%02X:%02X:%02X:%02X:%02X",
+               mac[0], mac[1], mac[2], mac[3], mac[4], mac[5]);
+    }
+#endif
+}
+
+/* esph_send_t over a client socket */
+
+static int esph_sock_send(FAR void *arg, FAR const uint8_t *buf,
+                          size_t len)
+{
+  FAR struct esph_client_s *cl = (FAR struct esph_client_s *)arg;
+
+  while (len > 0)
+    {
+      ssize_t n = send(cl->fd, buf, len, 0);
+      if (n < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+
+          return -errno;
+        }
+
+      buf += n;
+      len -= n;
+    }
+
+  return OK;
+}
+
+static void esph_drop(FAR struct esph_client_s *cl, FAR const char *why)
+{
+  printf("esphome: %s (%s) %s\n", cl->addr,
+         cl->conn.client[0] ? cl->conn.client : "?", why);
+
+  g_stats.tx_bytes += cl->conn.tx_bytes;
+  close(cl->fd);
+  cl->fd = -1;
+}
+
+static void esph_accept(int listenfd)
+{
+  struct sockaddr_in addr;
+  socklen_t addrlen = sizeof(addr);
+  int one = 1;
+  int fd;
+
+  fd = accept(listenfd, (FAR struct sockaddr *)&addr, &addrlen);
+  if (fd < 0)
+    {
+      return;
+    }
+
+  for (int i = 0; i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      FAR struct esph_client_s *cl = &g_clients[i];
+
+      if (cl->fd < 0)
+        {
+          /* State pushes are tiny; send them now, not after an ACK */
+
+          setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+          cl->fd         = fd;
+          cl->last_rx_ms = mmwave_service_now_ms();
+          cl->pinged     = false;
+          inet_ntop(AF_INET, &addr.sin_addr, cl->addr, sizeof(cl->addr));
+          esph_conn_init(&cl->conn, esph_sock_send, cl);
+          g_stats.accepted++;
+          return;
+        }
+    }
+
+  g_stats.refused++;
+  close(fd);
+}
+
+/* Read what is pending and answer it. Returns false if cl was dropped. */
+
+static bool esph_service(FAR struct esph_client_s *cl,
+                         FAR const struct mmwave_data_s *data)
+{
+  uint8_t buf[ESPH_RX_CHUNK];
+  ssize_t n = recv(cl->fd, buf, sizeof(buf), 0);
+
+  if (n <= 0)
+    {
+      esph_drop(cl, "disconnected");
+      return false;
+    }
+
+  cl->last_rx_ms = mmwave_service_now_ms();
+  cl->pinged     = false;
+
+  int ret = esph_conn_input(&cl->conn, &g_device, data, buf, n);
+  if (ret == ESPH_CLOSE)
+    {
+      esph_drop(cl, "disconnected");
+      return false;
+    }
+  else if (ret < 0)
+    {
+      esph_drop(cl, ret == -EPROTO ? "protocol error" : "send failed");
+      g_stats.dropped++;
+      return false;
+    }
+
+  return true;
+}
+
+static int esph_listen(void)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(CONFIG_ESPHOME_API_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(fd, (FAR struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, CONFIG_ESPHOME_API_CLIENTS) < 0)
+    {
+      int ret = -errno;
+      close(fd);
+      return ret;
+    }
+
+  return fd;
+}
+
+static int esph_start(void)
+{
+  g_listenfd = esph_listen();
+  if (g_listenfd < 0)
+    {
+      fprintf(stderr, "esphome: cannot listen on %u: %d\n",
+              CONFIG_ESPHOME_API_PORT, g_listenfd);
+      return g_listenfd;
+    }
+
+  for (int i = 0; i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      g_clients[i].fd = -1;
+    }
+
+  g_valid     = false;
+  g_sensor_ms = mmwave_service_now_ms();
+
+  printf("esphome: API server \"%s\" listening on port %u\n",
+         g_name, CONFIG_ESPHOME_API_PORT);
+  return OK;
+}
+
+static void esph_pollset(FAR struct pollfd *pfds)
+{
+  pfds[0].fd     = g_listenfd;
+  pfds[0].events = POLLIN;
+
+  for (int i = 0; i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      pfds[i + 1].fd     = g_clients[i].fd;
+      pfds[i + 1].events = POLLIN;
+    }
+}
+
+static int esph_events(FAR const struct pollfd *pfds, uint32_t now)
+{
+  if (pfds[0].revents & (POLLERR | POLLNVAL))
+    {
+      return -EIO;
+    }
+
+  for (int i = 0; i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      FAR struct esph_client_s *cl = &g_clients[i];
+
+      if (cl->fd >= 0 && pfds[i + 1].fd == cl->fd &&
+          (pfds[i + 1].revents & (POLLIN | POLLHUP | POLLERR)))
+        {
+          esph_service(cl, g_valid ? &g_data : NULL);
+        }
+    }
+
+  if (pfds[0].revents & POLLIN)
+    {
+      esph_accept(g_listenfd);
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: esph_frame
+ *
+ * Description:
+ *   Push a new sensor frame to every client: presence changes go out at
+ *   once, the numeric sensors at most once per
+ *   CONFIG_ESPHOME_API_SENSOR_MS so a moving target does not flood the
+ *   link.
+ *
+ ****************************************************************************/
+
+static void esph_frame(FAR const struct mmwave_eng_data_s *eng, bool gates,
+                       uint32_t now)
+{
+  bool sensors = now - g_sensor_ms >= CONFIG_ESPHOME_API_SENSOR_MS;
+
+  g_data  = eng->basic;
+  g_valid = true;
+
+  if (sensors)
+    {
+      g_sensor_ms = now;
+    }
+
+  for (int i = 0; i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      FAR struct esph_client_s *cl = &g_clients[i];
+      int sent;
+
+      if (cl->fd < 0)
+        {
+          continue;
+        }
+
+      sent = esph_conn_push(&cl->conn, &g_data, sensors);
+      if (sent < 0)
+        {
+          esph_drop(cl, "send failed");
+          g_stats.dropped++;
+          continue;
+        }
+
+      g_stats.pushes += sent;
+    }
+}
+
+/* Keep quiet connections honest */
+
+static uint32_t esph_tick(uint32_t now)
+{
+  for (int i = 0; i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      FAR struct esph_client_s *cl = &g_clients[i];
+      uint32_t idle;
+
+      if (cl->fd < 0)
+        {
+          continue;
+        }
+
+      idle = now - cl->last_rx_ms;
+      if (idle >= ESPH_TIMEOUT_MS)
+        {
+          esph_drop(cl, "timed out");
+          g_stats.dropped++;
+        }
+      else if (idle >= ESPH_PING_MS && !cl->pinged)
+        {
+          cl->pinged = true;
+          esph_conn_empty(&cl->conn, ESPH_MSG_PING_REQ);
+        }
+    }
+
+  return ESPH_TICK_MS;
+}
+
+static void esph_stop(void)
+{
+  for (int i = 0; i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      if (g_clients[i].fd >= 0)
+        {
+          esph_drop(&g_clients[i], "server stopped");
+        }
+    }
+
+  close(g_listenfd);
+  g_listenfd = -1;
+  printf("esphome: API server stopped\n");
+}
+
+static int esph_server_task(int argc, FAR char *argv[])
+{
+  return mmwave_service_run(&g_esphome_service);
+}
+
+static void print_status(void)
+{
+  uint32_t tx = g_stats.tx_bytes;
+
+  printf("ESPHome Native API\n");
+  printf("──────────────────\n");
+  printf("  Server   : %s\n", g_running ? "RUNNING" : "stopped");
+  printf("  Name     : %s\n", g_name);
+  printf("  Port     : %u (plaintext)\n", CONFIG_ESPHOME_API_PORT);
+  printf("  MAC      : %s\n", g_mac[0] ? g_mac : "(unknown)");
+
+  for (int i = 0; g_running && i < CONFIG_ESPHOME_API_CLIENTS; i++)
+    {
+      FAR struct esph_client_s *cl = &g_clients[i];
+
+      if (cl->fd >= 0)
+        {
+          printf("  Client   : %s %s%s, %lu msgs in, %lu out\n", cl->addr,
+                 cl->conn.client[0] ? cl->conn.client : "(no hello)",
+                 cl->conn.state == ESPH_CONN_SUBSCRIBED ?
+                 " [subscribed]" : "",
+                 (unsigned long)cl->conn.rx_msgs,
+                 (unsigned long)cl->conn.tx_msgs);
+          tx += cl->conn.tx_bytes;
+        }
+    }
+
+  printf("  Clients  : %lu accepted, %lu refused, %lu dropped\n",
+         (unsigned long)g_stats.accepted, (unsigned long)g_stats.refused,
+         (unsigned long)g_stats.dropped);
+  printf("  Traffic  : %lu state pushes, %lu bytes out\n",
+         (unsigned long)g_stats.pushes, (unsigned long)tx);
+}
+
+static void print_usage(void)
+{
+  printf("Usage: esphome <command> [args]\n\n");
+  printf("Commands:\n");
+  printf("  start         Start the native API server\n");
+  printf("  stop          Stop the server\n");
+  printf("  status        Show server and client state\n");
+  printf("  name <name>   Set the node name (a-z, 0-9, '-')\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  if (argc < 2)
+    {
+      print_usage();
+      return EXIT_FAILURE;
+    }
+
+  FAR const char *cmd = argv[1];
+
+  if (!g_running)
+    {
+      esph_load_name();
+    }
+
+  if (strcmp(cmd, "status") == 0)
+    {
+      print_status();
+    }
+  else if (strcmp(cmd, "name") == 0)
+    {
+      if (argc < 3 || !esph_name_valid(argv[2]))
+        {
+          fprintf(stderr, "Usage: esphome name <name>  (a-z, 0-9, '-', "
+                  "max %d chars)\n", ESPH_NAME_MAX - 1);
+          return EXIT_FAILURE;
+        }
+
+      if (g_running)
+        {
+          fprintf(stderr, "esphome: stop the server first\n");
+          return EXIT_FAILURE;
+        }
+
+      int ret = esph_save_name(argv[2]);
+      if (ret < 0)
+        {
+          fprintf(stderr, "esphome: cannot save name: %d\n", ret);
+          return EXIT_FAILURE;
+        }
+
+      strlcpy(g_name, argv[2], sizeof(g_name));
+      printf("esphome: node name set to \"%s\"\n", g_name);
+    }
+  else if (strcmp(cmd, "start") == 0)
+    {
+      if (g_running)
+        {
+          printf("esphome: server already running\n");
+          return OK;
+        }
+
+      esph_load_mac();
+      memset(&g_stats, 0, sizeof(g_stats));
+
+      int ret = mmwave_service_delegate(&g_esphome_service);
+      if (ret != -ESRCH)
+        {
+          return ret == OK ? OK : EXIT_FAILURE;
+        }
+
+      g_running = true;
+
+      g_server_pid = task_create("esphome_api",
+                                 100,    /* priority */
+                                 ESPH_TASK_STACK,
+                                 esph_server_task,
+                                 NULL);
+      if (g_server_pid < 0)
+        {
+          g_running = false;
+          fprintf(stderr, "esphome: failed to start task\n");
+          return EXIT_FAILURE;
+        }
+    }
+  else if (strcmp(cmd, "stop") == 0)
+    {
+      printf("esphome: stopping...\n");
+      mmwave_service_stop(&g_esphome_service);
+    }
+  else
+    {
+      print_usage();
+    }
+
+  return OK;
+}
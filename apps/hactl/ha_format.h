@@ -1,8 +1,9 @@
 /*
  * apps/hactl/ha_format.h
  *
- * Pure-function JSON body builder for Home Assistant state updates.
- * Extracted from hactl_cmd.c so it can be unit-tested without sockets.
+ * Pure-function JSON body and HTTP request builders for Home Assistant
+ * state updates. Extracted from hactl_cmd.c so they can be unit-tested
+ * without sockets.
  */
 
 #ifndef __APPS_HACTL_HA_FORMAT_H
@@ -10,12 +11,24 @@
 
 #include <stdio.h>
 #include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
 
 /* Use the driver header only for the data struct and target constants.
  * The driver header references sem_t in its internal struct, so pull
  * in the semaphore header first (stubs provide a no-op version). */
 #include <nuttx/semaphore.h>
 #include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/json_writer.h"
+#include "apps/common/mmwave_json.h"
+
+/* Widest Content-Length the request template reserves room for */
+
+#define HA_CONTENT_LENGTH_DIGITS  4
+
+/* Header block: request line, Host, Bearer token (up to 256 bytes) */
+
+#define HA_REQUEST_HDR_MAX        640
 
 /*
  * Build the JSON body for a Home Assistant POST /api/states/<entity>
@@ -29,37 +42,133 @@
 static inline int ha_format_state_json(char *buf, size_t bufsize,
                                        const struct mmwave_data_s *data)
 {
-  const char *state = (data->target_state != LD2410_TARGET_NONE)
-                      ? "on" : "off";
+  struct json_buf_s out =
+  {
+    buf, bufsize, 0
+  };
 
-  int n = snprintf(buf, bufsize,
-    "{\"state\":\"%s\","
-    "\"attributes\":{"
-    "\"friendly_name\":\"mmWave Presence\","
-    "\"device_class\":\"occupancy\","
-    "\"motion_energy\":%u,"
-    "\"static_energy\":%u,"
-    "\"motion_distance\":%u,"
-    "\"static_distance\":%u,"
-    "\"detection_distance\":%u"
-    "}}",
-    state,
-    data->motion_energy,
-    data->static_energy,
-    data->motion_distance,
-    data->static_distance,
-    data->detection_distance);
+  struct json_writer_s w;
 
-  if (n < 0 || (size_t)n >= bufsize)
+  json_init(&w, json_sink_buf, &out);
+  json_begin_object(&w, NULL);
+  json_str(&w, "state", mmwave_json_presence(data) ? "on" : "off");
+  json_begin_object(&w, "attributes");
+  json_str(&w, "friendly_name", "mmWave Presence");
+  json_str(&w, "device_class", "occupancy");
+  mmwave_json_fields(&w, data);
+  json_end_object(&w);
+  json_end_object(&w);
+
+  return json_finish_buf(&w, &out);
+}
+
+/*
+ * Pre-rendered request header block for HA POSTs. Everything except
+ * Content-Length is constant for a given config, so it is rendered once
+ * when the config loads and only the length digits are patched per post.
+ * The body is sent after it with writev(), never copied into it.
+ */
+struct ha_request_s
+{
+  char     buf[HA_REQUEST_HDR_MAX];
+  uint16_t len;         /* Header block length, ends with CRLF CRLF */
+  uint16_t length_off;  /* Offset of the Content-Length digits */
+};
+
+/*
+ * Render the header block for a POST to `path`. Content-Length is the
+ * last header, reserved as HA_CONTENT_LENGTH_DIGITS spaces; unused digit
+ * slots stay as trailing whitespace, which HTTP ignores.
+ *
+ * Returns 0, or -1 if the headers do not fit.
+ */
+static inline int ha_request_init_path(struct ha_request_s *req,
+                                       const char *path,
+                                       const char *host,
+                                       uint16_t port,
+                                       const char *token)
+{
+  int n = snprintf(req->buf, sizeof(req->buf),
+    "POST %s HTTP/1.1\r\n"
+    "Host: %s:%u\r\n"
+    "Authorization: Bearer %s\r\n"
+    "Content-Type: application/json\r\n"
+    "Connection: keep-alive\r\n"
+    "Content-Length: %*s\r\n"
+    "\r\n",
+    path,
+    host, port,
+    token,
+    HA_CONTENT_LENGTH_DIGITS, "");
+
+  if (n < 0 || (size_t)n >= sizeof(req->buf))
     {
+      req->len = 0;
       return -1;
     }
 
-  return n;
+  req->len        = (uint16_t)n;
+  req->length_off = (uint16_t)(n - 4 - HA_CONTENT_LENGTH_DIGITS);
+  return 0;
+}
+
+/* Header block for POST /api/states/<entity_id> */
+
+static inline int ha_request_init(struct ha_request_s *req,
+                                  const char *entity_id,
+                                  const char *host,
+                                  uint16_t port,
+                                  const char *token)
+{
+  char path[96];
+  int n = snprintf(path, sizeof(path), "/api/states/%s", entity_id);
+
+  if (n < 0 || (size_t)n >= sizeof(path))
+    {
+      req->len = 0;
+      return -1;
+    }
+
+  return ha_request_init_path(req, path, host, port, token);
+}
+
+/*
+ * Patch Content-Length in place. Returns 0, or -1 if the length does
+ * not fit in the reserved digits.
+ */
+static inline int ha_request_set_length(struct ha_request_s *req,
+                                        uint32_t body_len)
+{
+  char *digits = &req->buf[req->length_off];
+  char tmp[HA_CONTENT_LENGTH_DIGITS];
+  int i = sizeof(tmp);
+
+  if (req->len == 0)
+    {
+      return -1;
+    }
+
+  do
+    {
+      if (i == 0)
+        {
+          return -1;
+        }
+
+      tmp[--i] = (char)('0' + body_len % 10);
+      body_len /= 10;
+    }
+  while (body_len != 0);
+
+  memcpy(digits, &tmp[i], sizeof(tmp) - i);
+  memset(digits + sizeof(tmp) - i, ' ', i);
+  return 0;
 }
 
 /*
- * Build the HTTP request line + headers for HA POST.
+ * Build the HTTP request line + headers for HA POST, with the body
+ * copied in. Superseded in hactl by ha_request_s; kept as the
+ * single-buffer reference format.
  * Writes to buf, returns bytes written or -1 on truncation.
  */
 static inline int ha_format_http_request(char *buf, size_t bufsize,
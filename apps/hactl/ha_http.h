@@ -0,0 +1,494 @@
+/*
+ * apps/hactl/ha_http.h
+ *
+ * Incremental HTTP/1.x response parser for hactl.
+ *
+ * Bytes are fed in whatever pieces recv() returns. Only the status code
+ * and the headers that decide message framing (Content-Length,
+ * Transfer-Encoding: chunked, Connection) are looked at; everything else,
+ * body included, is skipped without being buffered. The parser state is
+ * a dozen bytes, so a response of any size is consumed with a fixed
+ * small receive buffer and no heap.
+ */
+
+#ifndef __APPS_HACTL_HA_HTTP_H
+#define __APPS_HACTL_HA_HTTP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <string.h>
+
+/* ha_http_feed() results */
+
+#define HA_HTTP_MORE       0    /* Need more bytes */
+#define HA_HTTP_COMPLETE   1    /* Whole response consumed */
+#define HA_HTTP_INVALID   (-1)  /* Not a well-formed HTTP response */
+
+enum ha_http_state_e
+{
+  HA_HTTP_ST_VERSION = 0,   /* "HTTP/1.x" */
+  HA_HTTP_ST_CODE,          /* " 200" */
+  HA_HTTP_ST_REASON,        /* reason phrase, up to LF */
+  HA_HTTP_ST_NAME,          /* header name, or CRLF ending the headers */
+  HA_HTTP_ST_VALUE,         /* header value, up to LF */
+  HA_HTTP_ST_SKIPLINE,      /* uninteresting header line */
+  HA_HTTP_ST_BODY,          /* Content-Length body */
+  HA_HTTP_ST_BODY_EOF,      /* body delimited by connection close */
+  HA_HTTP_ST_CHUNK_SIZE,    /* hex size line */
+  HA_HTTP_ST_CHUNK_EXT,     /* ;extensions, up to LF */
+  HA_HTTP_ST_CHUNK_DATA,
+  HA_HTTP_ST_CHUNK_END,     /* CRLF after chunk data */
+  HA_HTTP_ST_TRAILER,       /* trailer lines after the last chunk */
+  HA_HTTP_ST_DONE,
+  HA_HTTP_ST_ERROR
+};
+
+/* Headers we care about, as bits of a candidate mask */
+
+#define HA_HTTP_H_LENGTH   0x01   /* content-length */
+#define HA_HTTP_H_TE       0x02   /* transfer-encoding */
+#define HA_HTTP_H_CONN     0x04   /* connection */
+#define HA_HTTP_H_ALL      0x07
+
+struct ha_http_resp_s
+{
+  uint8_t  state;
+  uint8_t  pos;          /* Bytes matched in the current token */
+  uint8_t  cand;         /* Header name candidates still matching */
+  uint8_t  header;       /* Header whose value is being parsed */
+  uint8_t  pos2;         /* Second token match ("keep-alive") */
+  uint16_t status;       /* Status code, valid once headers_done */
+  bool     headers_done;
+  bool     chunked;
+  bool     has_length;
+  bool     keep_alive;   /* Connection may carry another request */
+  bool     token_hit;    /* "chunked" or "close" seen in the value */
+  bool     token2_hit;   /* "keep-alive" seen in the value */
+  uint32_t remaining;    /* Body or chunk bytes still to skip */
+};
+
+static inline void ha_http_init(struct ha_http_resp_s *r)
+{
+  memset(r, 0, sizeof(*r));
+  r->state = HA_HTTP_ST_VERSION;
+}
+
+static inline bool ha_http_ok(const struct ha_http_resp_s *r)
+{
+  return r->status >= 200 && r->status < 300;
+}
+
+static inline char ha_http_lower(char c)
+{
+  return (c >= 'A' && c <= 'Z') ? (char)(c + ('a' - 'A')) : c;
+}
+
+static inline const char *ha_http_hname(uint8_t bit)
+{
+  switch (bit)
+    {
+      case HA_HTTP_H_LENGTH: return "content-length";
+      case HA_HTTP_H_TE:     return "transfer-encoding";
+      default:               return "connection";
+    }
+}
+
+/*
+ * Track a case-insensitive token anywhere in a header value using a
+ * restart-on-mismatch match; good enough for "chunked", "close" and
+ * "keep-alive", none of which has a repeating prefix.
+ * Returns true when the token has just been completed.
+ */
+static inline bool ha_http_token(uint8_t *pos, char c, const char *token)
+{
+  c = ha_http_lower(c);
+
+  if (token[*pos] == c)
+    {
+      (*pos)++;
+    }
+  else
+    {
+      *pos = (token[0] == c) ? 1 : 0;
+    }
+
+  if (token[*pos] == '\0')
+    {
+      *pos = 0;
+      return true;
+    }
+
+  return false;
+}
+
+/* Headers finished: pick the body framing */
+
+static inline void ha_http_begin_body(struct ha_http_resp_s *r)
+{
+  r->headers_done = true;
+
+  if ((r->status >= 100 && r->status < 200) || r->status == 204 ||
+      r->status == 304)
+    {
+      r->state = HA_HTTP_ST_DONE;
+    }
+  else if (r->chunked)
+    {
+      r->remaining = 0;
+      r->state = HA_HTTP_ST_CHUNK_SIZE;
+    }
+  else if (r->has_length)
+    {
+      r->state = r->remaining > 0 ? HA_HTTP_ST_BODY : HA_HTTP_ST_DONE;
+    }
+  else
+    {
+      /* No framing: the body runs until the server closes */
+
+      r->keep_alive = false;
+      r->state = HA_HTTP_ST_BODY_EOF;
+    }
+}
+
+static inline void ha_http_end_value(struct ha_http_resp_s *r)
+{
+  if (r->header == HA_HTTP_H_TE && r->token_hit)
+    {
+      r->chunked = true;
+    }
+  else if (r->header == HA_HTTP_H_CONN && r->token_hit)
+    {
+      r->keep_alive = false;
+    }
+  else if (r->header == HA_HTTP_H_CONN && r->token2_hit)
+    {
+      r->keep_alive = true;  /* Explicit opt-in, e.g. from HTTP/1.0 */
+    }
+
+  r->state = HA_HTTP_ST_NAME;
+  r->pos = 0;
+  r->pos2 = 0;
+  r->cand = HA_HTTP_H_ALL;
+  r->token_hit = false;
+  r->token2_hit = false;
+}
+
+/* Parse one byte of everything except bulk body data */
+
+static inline void ha_http_byte(struct ha_http_resp_s *r, char c)
+{
+  switch (r->state)
+    {
+      case HA_HTTP_ST_VERSION:
+        if (r->pos < 7)
+          {
+            if (c != "HTTP/1."[r->pos])
+              {
+                r->state = HA_HTTP_ST_ERROR;
+              }
+
+            r->pos++;
+          }
+        else if (c >= '0' && c <= '9')
+          {
+            /* HTTP/1.1 is persistent by default, HTTP/1.0 is not */
+
+            r->keep_alive = (c != '0');
+            r->state = HA_HTTP_ST_CODE;
+            r->pos = 0;
+          }
+        else
+          {
+            r->state = HA_HTTP_ST_ERROR;
+          }
+        break;
+
+      case HA_HTTP_ST_CODE:
+        if (r->pos == 0)
+          {
+            r->state = (c == ' ') ? HA_HTTP_ST_CODE : HA_HTTP_ST_ERROR;
+            r->pos++;
+          }
+        else if (r->pos <= 3 && c >= '0' && c <= '9')
+          {
+            r->status = (uint16_t)(r->status * 10 + (c - '0'));
+            r->pos++;
+          }
+        else if (r->pos == 4 && (c == ' ' || c == '\r' || c == '\n'))
+          {
+            r->state = (c == '\n') ? HA_HTTP_ST_NAME : HA_HTTP_ST_REASON;
+            r->pos = 0;
+            r->cand = HA_HTTP_H_ALL;
+          }
+        else
+          {
+            r->state = HA_HTTP_ST_ERROR;
+          }
+        break;
+
+      case HA_HTTP_ST_REASON:
+        if (c == '\n')
+          {
+            r->state = HA_HTTP_ST_NAME;
+            r->pos = 0;
+            r->cand = HA_HTTP_H_ALL;
+          }
+        break;
+
+      case HA_HTTP_ST_NAME:
+        if (c == '\r')
+          {
+            break;
+          }
+
+        if (c == '\n')
+          {
+            if (r->pos == 0)
+              {
+                ha_http_begin_body(r);
+              }
+            else
+              {
+                r->state = HA_HTTP_ST_ERROR;  /* Name without colon */
+              }
+            break;
+          }
+
+        if (c == ':')
+          {
+            r->header = 0;
+            for (uint8_t bit = 1; bit <= HA_HTTP_H_CONN; bit <<= 1)
+              {
+                if ((r->cand & bit) && ha_http_hname(bit)[r->pos] == '\0')
+                  {
+                    r->header = bit;
+                  }
+              }
+
+            if (r->header == HA_HTTP_H_LENGTH)
+              {
+                r->has_length = true;
+                r->remaining = 0;
+              }
+
+            r->state = r->header ? HA_HTTP_ST_VALUE : HA_HTTP_ST_SKIPLINE;
+            r->pos = 0;
+            r->pos2 = 0;
+            r->token_hit = false;
+            r->token2_hit = false;
+            break;
+          }
+
+        c = ha_http_lower(c);
+        for (uint8_t bit = 1; bit <= HA_HTTP_H_CONN; bit <<= 1)
+          {
+            if ((r->cand & bit) && ha_http_hname(bit)[r->pos] != c)
+              {
+                r->cand &= (uint8_t)~bit;
+              }
+          }
+
+        if (r->pos < 255)
+          {
+            r->pos++;
+          }
+        break;
+
+      case HA_HTTP_ST_VALUE:
+        if (c == '\n')
+          {
+            ha_http_end_value(r);
+            break;
+          }
+
+        if (r->header == HA_HTTP_H_LENGTH)
+          {
+            if (c >= '0' && c <= '9')
+              {
+                if (r->remaining > (UINT32_MAX - 9) / 10)
+                  {
+                    r->state = HA_HTTP_ST_ERROR;
+                    break;
+                  }
+
+                r->remaining = r->remaining * 10 + (uint32_t)(c - '0');
+              }
+            else if (c != ' ' && c != '\t' && c != '\r')
+              {
+                r->state = HA_HTTP_ST_ERROR;
+              }
+          }
+        else if (r->header == HA_HTTP_H_TE)
+          {
+            r->token_hit |= ha_http_token(&r->pos, c, "chunked");
+          }
+        else
+          {
+            r->token_hit  |= ha_http_token(&r->pos, c, "close");
+            r->token2_hit |= ha_http_token(&r->pos2, c, "keep-alive");
+          }
+        break;
+
+      case HA_HTTP_ST_SKIPLINE:
+        if (c == '\n')
+          {
+            r->state = HA_HTTP_ST_NAME;
+            r->pos = 0;
+            r->cand = HA_HTTP_H_ALL;
+          }
+        break;
+
+      case HA_HTTP_ST_CHUNK_SIZE:
+        {
+          int v = -1;
+
+          if (c >= '0' && c <= '9')
+            {
+              v = c - '0';
+            }
+          else if (ha_http_lower(c) >= 'a' && ha_http_lower(c) <= 'f')
+            {
+              v = ha_http_lower(c) - 'a' + 10;
+            }
+
+          if (v >= 0)
+            {
+              if (r->remaining > (UINT32_MAX >> 4))
+                {
+                  r->state = HA_HTTP_ST_ERROR;
+                  break;
+                }
+
+              r->remaining = (r->remaining << 4) | (uint32_t)v;
+              r->pos = 1;
+            }
+          else if (c == ';' || c == ' ' || c == '\t' || c == '\r')
+            {
+              r->state = HA_HTTP_ST_CHUNK_EXT;
+            }
+          else if (c == '\n' && r->pos)
+            {
+              r->pos = 0;
+              r->state = r->remaining > 0 ? HA_HTTP_ST_CHUNK_DATA
+                                          : HA_HTTP_ST_TRAILER;
+            }
+          else
+            {
+              r->state = HA_HTTP_ST_ERROR;
+            }
+        }
+        break;
+
+      case HA_HTTP_ST_CHUNK_EXT:
+        if (c == '\n')
+          {
+            r->pos = 0;
+            r->state = r->remaining > 0 ? HA_HTTP_ST_CHUNK_DATA
+                                        : HA_HTTP_ST_TRAILER;
+          }
+        break;
+
+      case HA_HTTP_ST_CHUNK_END:
+        if (c == '\n')
+          {
+            r->remaining = 0;
+            r->pos = 0;
+            r->state = HA_HTTP_ST_CHUNK_SIZE;
+          }
+        else if (c != '\r')
+          {
+            r->state = HA_HTTP_ST_ERROR;
+          }
+        break;
+
+      case HA_HTTP_ST_TRAILER:
+        if (c == '\n')
+          {
+            if (r->pos == 0)
+              {
+                r->state = HA_HTTP_ST_DONE;
+              }
+
+            r->pos = 0;
+          }
+        else if (c != '\r')
+          {
+            r->pos = 1;
+          }
+        break;
+
+      case HA_HTTP_ST_DONE:
+
+        /* Bytes after a complete response: never reuse this socket */
+
+        r->keep_alive = false;
+        break;
+
+      default:
+        r->state = HA_HTTP_ST_ERROR;
+        break;
+    }
+}
+
+/*
+ * Feed received bytes. Body and chunk data are skipped in bulk.
+ * Returns HA_HTTP_MORE, HA_HTTP_COMPLETE or HA_HTTP_INVALID.
+ */
+static inline int ha_http_feed(struct ha_http_resp_s *r, const char *buf,
+                               size_t len)
+{
+  while (len > 0 && r->state != HA_HTTP_ST_ERROR)
+    {
+      if (r->state == HA_HTTP_ST_BODY || r->state == HA_HTTP_ST_CHUNK_DATA)
+        {
+          size_t skip = len < r->remaining ? len : r->remaining;
+
+          buf += skip;
+          len -= skip;
+          r->remaining -= skip;
+
+          if (r->remaining == 0)
+            {
+              r->state = (r->state == HA_HTTP_ST_BODY) ?
+                         HA_HTTP_ST_DONE : HA_HTTP_ST_CHUNK_END;
+            }
+        }
+      else if (r->state == HA_HTTP_ST_BODY_EOF)
+        {
+          len = 0;
+        }
+      else
+        {
+          ha_http_byte(r, *buf++);
+          len--;
+        }
+    }
+
+  if (r->state == HA_HTTP_ST_ERROR)
+    {
+      r->keep_alive = false;
+      return HA_HTTP_INVALID;
+    }
+
+  return r->state == HA_HTTP_ST_DONE ? HA_HTTP_COMPLETE : HA_HTTP_MORE;
+}
+
+/*
+ * The peer closed the connection. Completes a close-delimited body;
+ * anything else still in progress was truncated.
+ */
+static inline int ha_http_eof(struct ha_http_resp_s *r)
+{
+  r->keep_alive = false;
+
+  if (r->state == HA_HTTP_ST_BODY_EOF || r->state == HA_HTTP_ST_DONE)
+    {
+      r->state = HA_HTTP_ST_DONE;
+      return HA_HTTP_COMPLETE;
+    }
+
+  return HA_HTTP_INVALID;
+}
+
+#endif /* __APPS_HACTL_HA_HTTP_H */
@@ -0,0 +1,603 @@
+/*
+ * apps/hactl/ha_journal.h
+ *
+ * Offline presence journal for hactl. While HA is unreachable every
+ * transition is recorded (time, target state, distance: 8 bytes) so
+ * the history can be replayed once it is back, instead of HA only ever
+ * seeing the state at reconnect.
+ *
+ *   - Records collect in a small RAM ring and go to flash in batches of
+ *     HA_JOURNAL_BATCH, or all at once when the oldest has waited
+ *     spill_ms, so a long outage costs one program-and-sync per batch
+ *     rather than one per transition.
+ *   - The file is append-only: blocks of an 8-byte header (magic,
+ *     count, CRC-16, first sequence number) and their records. A block
+ *     with count 0 is an ack marker carrying the first unacknowledged
+ *     sequence number; once everything in the file is acknowledged the
+ *     file is erased. A torn block at the end is cut off at load.
+ *   - Replay hands out the oldest records, flash before RAM, and
+ *     ha_journal_ack() retires them once HA has accepted the batch.
+ *     Delivery is at least once: a reboot between a batch and its ack
+ *     marker sends it again, with the same sequence numbers.
+ *
+ * Storage is behind a small ops table so all of this runs on the host
+ * against a RAM file.
+ */
+
+#ifndef __APPS_HACTL_HA_JOURNAL_H
+#define __APPS_HACTL_HA_JOURNAL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/json_writer.h"
+
+#define HA_JOURNAL_BATCH        16    /* Records per flash write */
+#define HA_JOURNAL_RAM          (2 * HA_JOURNAL_BATCH)
+#define HA_JOURNAL_REC_SIZE     8
+#define HA_JOURNAL_HDR_SIZE     8
+#define HA_JOURNAL_MAGIC        0xa5
+#define HA_JOURNAL_BLOCK_MAX    (HA_JOURNAL_HDR_SIZE + \
+                                 HA_JOURNAL_RAM * HA_JOURNAL_REC_SIZE)
+
+/* The HA event the replayed history is fired as */
+
+#define HA_JOURNAL_EVENT_TYPE   "mmwave_journal"
+
+struct ha_journal_rec_s
+{
+  uint32_t ts;           /* Seconds, from time() */
+  uint16_t distance;     /* Detection distance, cm */
+  uint8_t  target;       /* LD2410_TARGET_* */
+};
+
+struct ha_journal_io_s
+{
+  /* Append len bytes at the end of the file and make them durable */
+
+  int     (*append)(void *priv, const uint8_t *buf, size_t len);
+  ssize_t (*read)(void *priv, uint32_t off, uint8_t *buf, size_t len);
+  int     (*truncate)(void *priv, uint32_t len);
+  int     (*erase)(void *priv);
+  void     *priv;
+};
+
+struct ha_journal_stats_s
+{
+  uint32_t logged;       /* Transitions recorded */
+  uint32_t spilled;      /* Records written to flash */
+  uint32_t writes;       /* append() calls, each a program and sync */
+  uint32_t flash_bytes;  /* Bytes appended: headers, records, markers */
+  uint32_t dropped;      /* Lost to a full file or a failed write */
+  uint32_t replayed;     /* Records HA acknowledged */
+  uint32_t batches;      /* Replay requests acknowledged */
+  uint32_t replay_ms;    /* Time those requests took */
+};
+
+struct ha_journal_s
+{
+  const struct ha_journal_io_s *io;
+  uint32_t cap;          /* File size limit, bytes */
+  uint32_t spill_ms;     /* Longest a record waits in RAM while offline */
+
+  struct ha_journal_rec_s ram[HA_JOURNAL_RAM];
+  uint8_t  ram_head;
+  uint8_t  ram_count;
+  uint32_t ram_since;    /* When the oldest RAM record arrived */
+
+  uint32_t next_seq;     /* Sequence number of the next record logged */
+  uint32_t flash_seq;    /* First unacknowledged record in the file */
+  uint32_t flash_count;  /* Unacknowledged records in the file */
+  uint32_t file_len;
+  uint32_t scan_off;     /* Block holding flash_seq (or file_len) */
+
+  struct ha_journal_stats_s stats;
+};
+
+/* ---- Encoding ---- */
+
+static inline void ha_journal_put32(uint8_t *p, uint32_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+  p[2] = (uint8_t)(v >> 16);
+  p[3] = (uint8_t)(v >> 24);
+}
+
+static inline uint32_t ha_journal_get32(const uint8_t *p)
+{
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 |
+         (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+/* CRC-16/CCITT-FALSE */
+
+static inline uint16_t ha_journal_crc16(uint16_t crc, const uint8_t *p,
+                                        size_t len)
+{
+  while (len-- > 0)
+    {
+      crc ^= (uint16_t)(*p++ << 8);
+      for (int i = 0; i < 8; i++)
+        {
+          crc = crc & 0x8000 ? (uint16_t)(crc << 1 ^ 0x1021) :
+                               (uint16_t)(crc << 1);
+        }
+    }
+
+  return crc;
+}
+
+/* Header for `count` records starting at `seq`, records already at p+8 */
+
+static inline void ha_journal_seal(uint8_t *p, uint8_t count, uint32_t seq)
+{
+  uint16_t crc;
+
+  p[0] = HA_JOURNAL_MAGIC;
+  p[1] = count;
+  ha_journal_put32(p + 4, seq);
+  crc  = ha_journal_crc16(0xffff, p + 4,
+                          4 + (size_t)count * HA_JOURNAL_REC_SIZE);
+  p[2] = (uint8_t)crc;
+  p[3] = (uint8_t)(crc >> 8);
+}
+
+static inline void ha_journal_encode(uint8_t *p,
+                                     const struct ha_journal_rec_s *r)
+{
+  ha_journal_put32(p, r->ts);
+  p[4] = (uint8_t)r->distance;
+  p[5] = (uint8_t)(r->distance >> 8);
+  p[6] = r->target;
+  p[7] = 0;
+}
+
+static inline void ha_journal_decode(struct ha_journal_rec_s *r,
+                                     const uint8_t *p)
+{
+  r->ts       = ha_journal_get32(p);
+  r->distance = (uint16_t)(p[4] | p[5] << 8);
+  r->target   = p[6];
+}
+
+/* ---- Setup ---- */
+
+static inline void ha_journal_init(struct ha_journal_s *j,
+                                   const struct ha_journal_io_s *io,
+                                   uint32_t cap, uint32_t spill_ms)
+{
+  memset(j, 0, sizeof(*j));
+  j->io       = io;
+  j->cap      = cap;
+  j->spill_ms = spill_ms;
+}
+
+/* Move scan_off past blocks that hold nothing unacknowledged */
+
+static inline void ha_journal_rescan(struct ha_journal_s *j)
+{
+  uint8_t hdr[HA_JOURNAL_HDR_SIZE];
+
+  while (j->scan_off < j->file_len &&
+         j->io->read(j->io->priv, j->scan_off, hdr, sizeof(hdr)) ==
+         (ssize_t)sizeof(hdr))
+    {
+      uint32_t bseq = ha_journal_get32(hdr + 4);
+
+      if (hdr[1] > 0 && (int32_t)(bseq + hdr[1] - j->flash_seq) > 0)
+        {
+          break;
+        }
+
+      j->scan_off += HA_JOURNAL_HDR_SIZE + hdr[1] * HA_JOURNAL_REC_SIZE;
+    }
+}
+
+/* Read and check the block at off; returns its length, or 0 at the end */
+
+static inline size_t ha_journal_block(struct ha_journal_s *j, uint32_t off,
+                                      uint8_t *blk)
+{
+  size_t len;
+
+  if (j->io->read(j->io->priv, off, blk, HA_JOURNAL_HDR_SIZE) !=
+      HA_JOURNAL_HDR_SIZE || blk[0] != HA_JOURNAL_MAGIC ||
+      blk[1] > HA_JOURNAL_RAM)
+    {
+      return 0;
+    }
+
+  len = HA_JOURNAL_HDR_SIZE + blk[1] * HA_JOURNAL_REC_SIZE;
+  if (j->io->read(j->io->priv, off, blk, len) != (ssize_t)len ||
+      ha_journal_crc16(0xffff, blk + 4, len - 4) !=
+      (uint16_t)(blk[2] | blk[3] << 8))
+    {
+      return 0;
+    }
+
+  return len;
+}
+
+/*
+ * Pick up what a previous run left in the file. Blocks are checked in
+ * order and the first bad one ends the file; records before the last
+ * ack marker are already delivered. Returns the records still pending.
+ */
+
+static inline uint32_t ha_journal_load(struct ha_journal_s *j)
+{
+  uint8_t blk[HA_JOURNAL_BLOCK_MAX];
+  uint32_t off = 0;
+  uint32_t start = 0;
+  uint32_t end = 0;
+  uint32_t count = 0;
+  bool any = false;
+  size_t len;
+
+  while ((len = ha_journal_block(j, off, blk)) > 0)
+    {
+      uint32_t seq = ha_journal_get32(blk + 4);
+
+      if (blk[1] == 0)
+        {
+          start = seq;
+        }
+      else
+        {
+          if (!any)
+            {
+              start = seq;
+            }
+
+          any = true;
+          end = seq + blk[1];
+        }
+
+      off += len;
+    }
+
+  /* Second pass: what is at or after the last ack marker */
+
+  for (uint32_t o = 0; any && o < off; o += len)
+    {
+      len = ha_journal_block(j, o, blk);
+
+      uint32_t seq = ha_journal_get32(blk + 4);
+      uint32_t last = seq + blk[1];
+
+      if ((int32_t)(last - start) > 0)
+        {
+          count += (int32_t)(seq - start) >= 0 ? blk[1] : last - start;
+        }
+    }
+
+  j->next_seq = any ? end : start;
+
+  if (count == 0)
+    {
+      if (j->io->read(j->io->priv, 0, blk, 1) > 0)
+        {
+          j->io->erase(j->io->priv);
+        }
+
+      return 0;
+    }
+
+  if (j->io->read(j->io->priv, off, blk, 1) > 0)
+    {
+      j->io->truncate(j->io->priv, off);       /* Torn tail */
+    }
+
+  j->file_len    = off;
+  j->flash_seq   = start;
+  j->flash_count = count;
+  j->scan_off    = 0;
+  ha_journal_rescan(j);
+  return count;
+}
+
+/* ---- Recording ---- */
+
+static inline uint32_t ha_journal_pending(const struct ha_journal_s *j)
+{
+  return j->flash_count + j->ram_count;
+}
+
+/*
+ * Write the oldest n RAM records as one block. On failure they stay in
+ * RAM; the caller decides whether to drop them.
+ */
+
+static inline int ha_journal_spill(struct ha_journal_s *j, uint8_t n)
+{
+  uint8_t blk[HA_JOURNAL_BLOCK_MAX];
+  size_t len = HA_JOURNAL_HDR_SIZE + (size_t)n * HA_JOURNAL_REC_SIZE;
+  uint32_t seq = j->next_seq - j->ram_count;
+  int ret;
+
+  if (n == 0)
+    {
+      return OK;
+    }
+
+  if (j->file_len + len > j->cap)
+    {
+      return -ENOSPC;
+    }
+
+  for (int i = 0; i < n; i++)
+    {
+      ha_journal_encode(blk + HA_JOURNAL_HDR_SIZE + i * HA_JOURNAL_REC_SIZE,
+                        &j->ram[(j->ram_head + i) % HA_JOURNAL_RAM]);
+    }
+
+  ha_journal_seal(blk, n, seq);
+
+  ret = j->io->append(j->io->priv, blk, len);
+  if (ret < 0)
+    {
+      /* A partial block fails its CRC at load; cut it off now */
+
+      j->io->truncate(j->io->priv, j->file_len);
+      return ret;
+    }
+
+  if (j->flash_count == 0)
+    {
+      j->flash_seq = seq;
+      j->scan_off  = j->file_len;
+    }
+
+  j->file_len          += len;
+  j->flash_count       += n;
+  j->ram_head           = (uint8_t)((j->ram_head + n) % HA_JOURNAL_RAM);
+  j->ram_count         -= n;
+  j->stats.spilled     += n;
+  j->stats.writes++;
+  j->stats.flash_bytes += len;
+  return OK;
+}
+
+/* Record one transition: ts from time(), now from the ms clock */
+
+static inline void ha_journal_log(struct ha_journal_s *j,
+                                  const struct mmwave_data_s *data,
+                                  uint32_t ts, uint32_t now)
+{
+  struct ha_journal_rec_s *r;
+
+  if (j->ram_count == HA_JOURNAL_RAM)
+    {
+      /* Flash has been refusing batches: lose the oldest */
+
+      j->ram_head = (uint8_t)((j->ram_head + 1) % HA_JOURNAL_RAM);
+      j->ram_count--;
+      j->stats.dropped++;
+    }
+
+  if (j->ram_count == 0)
+    {
+      j->ram_since = now;
+    }
+
+  r = &j->ram[(j->ram_head + j->ram_count) % HA_JOURNAL_RAM];
+  r->ts       = ts;
+  r->distance = data->detection_distance;
+  r->target   = data->target_state;
+  j->ram_count++;
+  j->next_seq++;
+  j->stats.logged++;
+
+  if (j->ram_count >= HA_JOURNAL_BATCH)
+    {
+      ha_journal_spill(j, HA_JOURNAL_BATCH);
+    }
+}
+
+/*
+ * While still offline: spill RAM once its oldest record has waited
+ * spill_ms, so a quiet outage is not lost to a reset either.
+ */
+
+static inline void ha_journal_tick(struct ha_journal_s *j, uint32_t now)
+{
+  if (j->ram_count > 0 && now - j->ram_since >= j->spill_ms &&
+      ha_journal_spill(j, j->ram_count) == OK)
+    {
+      j->ram_since = now;
+    }
+}
+
+/* Reporting is stopping: keep what is still only in RAM */
+
+static inline int ha_journal_sync(struct ha_journal_s *j)
+{
+  return ha_journal_spill(j, j->ram_count);
+}
+
+/* ---- Replay ---- */
+
+/*
+ * Copy up to max of the oldest pending records into out, flash first.
+ * A batch never spans a gap left by dropped records, so record i has
+ * sequence number *seq + i. Returns the count, or -EIO.
+ */
+
+static inline int ha_journal_peek(struct ha_journal_s *j,
+                                  struct ha_journal_rec_s *out, int max,
+                                  uint32_t *seq)
+{
+  uint8_t blk[HA_JOURNAL_BLOCK_MAX];
+  uint32_t ram_seq = j->next_seq - j->ram_count;
+  uint32_t off = j->scan_off;
+  uint32_t left = j->flash_count;
+  int n = 0;
+
+  *seq = ram_seq;
+  while (n < max && left > 0 && off < j->file_len)
+    {
+      size_t len = ha_journal_block(j, off, blk);
+
+      if (len == 0)
+        {
+          return -EIO;
+        }
+
+      uint32_t bseq = ha_journal_get32(blk + 4);
+
+      for (uint32_t i = 0; i < blk[1] && n < max && left > 0; i++)
+        {
+          if ((int32_t)(bseq + i - j->flash_seq) < 0)
+            {
+              continue;                        /* Already acknowledged */
+            }
+
+          if (n == 0)
+            {
+              *seq = bseq + i;
+            }
+          else if (bseq + i != *seq + n)
+            {
+              return n;
+            }
+
+          ha_journal_decode(&out[n++], blk + HA_JOURNAL_HDR_SIZE +
+                            i * HA_JOURNAL_REC_SIZE);
+          left--;
+        }
+
+      off += len;
+    }
+
+  if (left > 0 || (n > 0 && ram_seq != *seq + n))
+    {
+      return n;
+    }
+
+  for (int i = 0; n < max && i < j->ram_count; i++)
+    {
+      out[n++] = j->ram[(j->ram_head + i) % HA_JOURNAL_RAM];
+    }
+
+  return n;
+}
+
+/*
+ * HA accepted the batch of n records from ha_journal_peek() starting at
+ * seq, in `ms`. Flash is retired with an 8-byte ack marker, or by
+ * erasing the file once nothing in it is left.
+ */
+
+static inline void ha_journal_ack(struct ha_journal_s *j, uint32_t seq,
+                                  uint32_t n, uint32_t ms)
+{
+  uint32_t from_flash = n < j->flash_count ? n : j->flash_count;
+  uint32_t from_ram = n - from_flash;
+
+  j->stats.replayed  += n;
+  j->stats.batches++;
+  j->stats.replay_ms += ms;
+
+  if (from_flash > 0)
+    {
+      j->flash_seq    = seq + from_flash;
+      j->flash_count -= from_flash;
+
+      if (j->flash_count == 0)
+        {
+          j->io->erase(j->io->priv);
+          j->file_len = 0;
+          j->scan_off = 0;
+        }
+      else
+        {
+          uint8_t hdr[HA_JOURNAL_HDR_SIZE];
+
+          ha_journal_seal(hdr, 0, j->flash_seq);
+          if (j->file_len + sizeof(hdr) <= j->cap &&
+              j->io->append(j->io->priv, hdr, sizeof(hdr)) == OK)
+            {
+              j->file_len          += sizeof(hdr);
+              j->stats.writes++;
+              j->stats.flash_bytes += sizeof(hdr);
+            }
+
+          ha_journal_rescan(j);
+        }
+    }
+
+  if (from_ram > j->ram_count)
+    {
+      from_ram = j->ram_count;
+    }
+
+  j->ram_head   = (uint8_t)((j->ram_head + from_ram) % HA_JOURNAL_RAM);
+  j->ram_count -= (uint8_t)from_ram;
+}
+
+/* The file cannot be read back: give up on what is in it */
+
+static inline void ha_journal_drop_flash(struct ha_journal_s *j)
+{
+  j->stats.dropped += j->flash_count;
+  j->flash_count    = 0;
+  j->file_len       = 0;
+  j->scan_off       = 0;
+  j->io->erase(j->io->priv);
+}
+
+/* Flash bytes written per byte of record spilled, x100 */
+
+static inline uint32_t ha_journal_wa_x100(const struct ha_journal_stats_s *s)
+{
+  uint32_t payload = s->spilled * HA_JOURNAL_REC_SIZE;
+
+  return payload > 0 ? (uint32_t)((uint64_t)s->flash_bytes * 100 /
+                                  payload) : 0;
+}
+
+/* Records replayed per second of request time */
+
+static inline uint32_t ha_journal_rate(const struct ha_journal_stats_s *s)
+{
+  return s->replay_ms > 0 ? (uint32_t)((uint64_t)s->replayed * 1000 /
+                                       s->replay_ms) : s->replayed;
+}
+
+/*
+ * Members of one replay batch, written into an object the caller has
+ * opened: {"node":..., "seq":<first>, "now":<time()>, "transitions":
+ * [[ts, target, distance_cm], ...]}. Sequence numbers are seq + index;
+ * "now" lets HA place the timestamps even when the device clock was
+ * never set.
+ */
+
+static inline void ha_journal_json(struct json_writer_s *w,
+                                   const char *node, uint32_t seq,
+                                   uint32_t now,
+                                   const struct ha_journal_rec_s *recs,
+                                   int n)
+{
+  json_str(w, "node", node);
+  json_uint(w, "seq", seq);
+  json_uint(w, "now", now);
+  json_begin_array(w, "transitions");
+  for (int i = 0; i < n; i++)
+    {
+      json_begin_array(w, NULL);
+      json_uint(w, NULL, recs[i].ts);
+      json_uint(w, NULL, recs[i].target);
+      json_uint(w, NULL, recs[i].distance);
+      json_end_array(w);
+    }
+
+  json_end_array(w);
+}
+
+#endif /* __APPS_HACTL_HA_JOURNAL_H */
@@ -0,0 +1,558 @@
+/*
+ * apps/hactl/ha_mqtt.h
+ *
+ * Minimal MQTT 3.1.1 packet codec and Home Assistant MQTT discovery
+ * payloads for the hactl MQTT backend. Only what a publish-only client
+ * needs: CONNECT (with last will), PUBLISH, PINGREQ and DISCONNECT out;
+ * CONNACK, PUBACK and PINGRESP in. Pure functions over caller buffers,
+ * so the wire format can be unit-tested without a broker.
+ */
+
+#ifndef __APPS_HACTL_HA_MQTT_H
+#define __APPS_HACTL_HA_MQTT_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/json_writer.h"
+#include "apps/common/mmwave_json.h"
+
+/* Control packet types (first byte, flags clear) */
+
+#define MQTT_PKT_CONNECT        0x10
+#define MQTT_PKT_CONNACK        0x20
+#define MQTT_PKT_PUBLISH        0x30
+#define MQTT_PKT_PUBACK         0x40
+#define MQTT_PKT_PINGREQ        0xC0
+#define MQTT_PKT_PINGRESP       0xD0
+#define MQTT_PKT_DISCONNECT     0xE0
+
+/* CONNECT flags */
+
+#define MQTT_CONNECT_CLEAN      0x02
+#define MQTT_CONNECT_WILL       0x04
+#define MQTT_CONNECT_WILL_QOS1  0x08
+#define MQTT_CONNECT_WILL_RETAIN 0x20
+#define MQTT_CONNECT_PASSWORD   0x40
+#define MQTT_CONNECT_USERNAME   0x80
+
+/* PUBLISH fixed header flags */
+
+#define MQTT_PUBLISH_RETAIN     0x01
+#define MQTT_PUBLISH_QOS1       0x02
+
+/* Remaining Length is a 1-4 byte varint */
+
+#define MQTT_MAX_REMAINING      268435455u
+
+/* Fixed header + packet id, on top of the topic, for a PUBLISH header */
+
+#define HA_MQTT_PUBLISH_OVERHEAD 9
+
+/* Node id: one topic level and part of every unique_id */
+
+#define HA_MQTT_NODE_MAX        32
+
+/* "mmwave/<node>/status", "homeassistant/binary_sensor/<node>/.../config" */
+
+#define HA_MQTT_TOPIC_MAX       96
+
+#define HA_MQTT_DISCOVERY_PREFIX "homeassistant"
+#define HA_MQTT_ONLINE          "online"
+#define HA_MQTT_OFFLINE         "offline"
+
+/* ---- Encoding ---- */
+
+/*
+ * Write a Remaining Length varint. Returns bytes written (1-4), or -1
+ * if the value exceeds the MQTT limit.
+ */
+static inline int ha_mqtt_put_length(uint8_t *p, uint32_t len)
+{
+  int n = 0;
+
+  if (len > MQTT_MAX_REMAINING)
+    {
+      return -1;
+    }
+
+  do
+    {
+      uint8_t b = len & 0x7f;
+
+      len >>= 7;
+      p[n++] = len != 0 ? (uint8_t)(b | 0x80) : b;
+    }
+  while (len != 0);
+
+  return n;
+}
+
+static inline int ha_mqtt_length_size(uint32_t len)
+{
+  return len < 128 ? 1 : len < 16384 ? 2 : len < 2097152 ? 3 : 4;
+}
+
+/* Two-byte length prefixed UTF-8 string */
+
+static inline uint8_t *ha_mqtt_put_str(uint8_t *p, const char *s)
+{
+  size_t n = strlen(s);
+
+  *p++ = (uint8_t)(n >> 8);
+  *p++ = (uint8_t)n;
+  memcpy(p, s, n);
+  return p + n;
+}
+
+struct ha_mqtt_connect_s
+{
+  const char *client_id;
+  const char *username;     /* NULL or "" for none */
+  const char *password;     /* Only sent with a username */
+  const char *will_topic;   /* NULL for no last will */
+  const char *will_msg;
+  uint16_t    keepalive_s;
+  bool        will_qos1;
+  bool        will_retain;
+};
+
+/*
+ * Encode a CONNECT packet with a clean session. Returns the packet
+ * length, or -1 if it does not fit in bufsize.
+ */
+static inline int ha_mqtt_connect(uint8_t *buf, size_t bufsize,
+                                  const struct ha_mqtt_connect_s *c)
+{
+  bool has_will = c->will_topic != NULL && c->will_topic[0] != '\0';
+  bool has_user = c->username != NULL && c->username[0] != '\0';
+  bool has_pass = has_user && c->password != NULL;
+  uint8_t flags = MQTT_CONNECT_CLEAN;
+  uint32_t rem;
+  uint8_t *p;
+
+  rem = 10 + 2 + strlen(c->client_id);
+  if (has_will)
+    {
+      flags |= MQTT_CONNECT_WILL;
+      flags |= c->will_qos1 ? MQTT_CONNECT_WILL_QOS1 : 0;
+      flags |= c->will_retain ? MQTT_CONNECT_WILL_RETAIN : 0;
+      rem   += 2 + strlen(c->will_topic) + 2 + strlen(c->will_msg);
+    }
+
+  if (has_user)
+    {
+      flags |= MQTT_CONNECT_USERNAME;
+      rem   += 2 + strlen(c->username);
+    }
+
+  if (has_pass)
+    {
+      flags |= MQTT_CONNECT_PASSWORD;
+      rem   += 2 + strlen(c->password);
+    }
+
+  if (1 + ha_mqtt_length_size(rem) + rem > bufsize)
+    {
+      return -1;
+    }
+
+  p    = buf;
+  *p++ = MQTT_PKT_CONNECT;
+  p   += ha_mqtt_put_length(p, rem);
+  p    = ha_mqtt_put_str(p, "MQTT");
+  *p++ = 4;                             /* Protocol level 3.1.1 */
+  *p++ = flags;
+  *p++ = (uint8_t)(c->keepalive_s >> 8);
+  *p++ = (uint8_t)c->keepalive_s;
+  p    = ha_mqtt_put_str(p, c->client_id);
+
+  if (has_will)
+    {
+      p = ha_mqtt_put_str(p, c->will_topic);
+      p = ha_mqtt_put_str(p, c->will_msg);
+    }
+
+  if (has_user)
+    {
+      p = ha_mqtt_put_str(p, c->username);
+    }
+
+  if (has_pass)
+    {
+      p = ha_mqtt_put_str(p, c->password);
+    }
+
+  return (int)(p - buf);
+}
+
+/*
+ * Encode everything of a PUBLISH up to the payload, which the caller
+ * sends right after it (writev) without copying. pid is only used for
+ * QoS 1. Returns the header length, or -1 if it does not fit.
+ */
+static inline int ha_mqtt_publish_header(uint8_t *buf, size_t bufsize,
+                                         const char *topic,
+                                         size_t payload_len,
+                                         bool qos1, bool retain,
+                                         uint16_t pid)
+{
+  size_t tlen = strlen(topic);
+  uint32_t rem = 2 + tlen + (qos1 ? 2 : 0) + payload_len;
+  uint8_t *p = buf;
+  int n;
+
+  if (rem > MQTT_MAX_REMAINING ||
+      1 + ha_mqtt_length_size(rem) + rem - payload_len > bufsize)
+    {
+      return -1;
+    }
+
+  *p++ = MQTT_PKT_PUBLISH | (qos1 ? MQTT_PUBLISH_QOS1 : 0) |
+         (retain ? MQTT_PUBLISH_RETAIN : 0);
+  n    = ha_mqtt_put_length(p, rem);
+  p   += n;
+  p    = ha_mqtt_put_str(p, topic);
+
+  if (qos1)
+    {
+      *p++ = (uint8_t)(pid >> 8);
+      *p++ = (uint8_t)pid;
+    }
+
+  return (int)(p - buf);
+}
+
+/* PINGREQ and DISCONNECT are two fixed bytes */
+
+static inline int ha_mqtt_simple(uint8_t *buf, uint8_t type)
+{
+  buf[0] = type;
+  buf[1] = 0;
+  return 2;
+}
+
+/* Packet identifiers are 1..65535; zero is reserved */
+
+static inline uint16_t ha_mqtt_next_pid(uint16_t *pid)
+{
+  if (++*pid == 0)
+    {
+      *pid = 1;
+    }
+
+  return *pid;
+}
+
+/* ---- Decoding ---- */
+
+#define HA_MQTT_RX_MORE         0
+#define HA_MQTT_RX_PACKET       1
+#define HA_MQTT_RX_INVALID      (-1)
+
+enum ha_mqtt_rx_state_e
+{
+  HA_MQTT_RX_TYPE = 0,
+  HA_MQTT_RX_LENGTH,
+  HA_MQTT_RX_BODY
+};
+
+/*
+ * Incremental packet reader. Only the first few body bytes are kept,
+ * which is all CONNACK/PUBACK carry; longer packets (e.g. a PUBLISH
+ * from a broker-side subscription) are consumed and skipped.
+ */
+struct ha_mqtt_rx_s
+{
+  uint8_t  state;
+  uint8_t  type;       /* First byte of the packet in progress */
+  uint8_t  shift;      /* Remaining Length varint position */
+  uint8_t  pos;        /* Body bytes kept in body[] */
+  uint32_t remaining;  /* Body bytes still to come */
+  uint8_t  body[4];
+};
+
+static inline void ha_mqtt_rx_init(struct ha_mqtt_rx_s *rx)
+{
+  memset(rx, 0, sizeof(*rx));
+}
+
+/*
+ * Consume bytes until one packet is complete. *used is set to the
+ * bytes consumed, so a caller holding several packets in one buffer
+ * feeds the rest again. After HA_MQTT_RX_PACKET, rx->type and rx->body
+ * describe the packet until the next call.
+ */
+static inline int ha_mqtt_rx_feed(struct ha_mqtt_rx_s *rx,
+                                  const uint8_t *buf, size_t len,
+                                  size_t *used)
+{
+  size_t i = 0;
+
+  while (i < len)
+    {
+      uint8_t c = buf[i];
+
+      switch (rx->state)
+        {
+          case HA_MQTT_RX_TYPE:
+            rx->type      = c;
+            rx->shift     = 0;
+            rx->pos       = 0;
+            rx->remaining = 0;
+            rx->state     = HA_MQTT_RX_LENGTH;
+            i++;
+            break;
+
+          case HA_MQTT_RX_LENGTH:
+            if (rx->shift > 21)
+              {
+                *used = i;
+                return HA_MQTT_RX_INVALID;
+              }
+
+            rx->remaining |= (uint32_t)(c & 0x7f) << rx->shift;
+            rx->shift += 7;
+            i++;
+
+            if ((c & 0x80) == 0)
+              {
+                rx->state = HA_MQTT_RX_BODY;
+                if (rx->remaining == 0)
+                  {
+                    rx->state = HA_MQTT_RX_TYPE;
+                    *used = i;
+                    return HA_MQTT_RX_PACKET;
+                  }
+              }
+            break;
+
+          case HA_MQTT_RX_BODY:
+            {
+              size_t take = len - i;
+
+              if (take > rx->remaining)
+                {
+                  take = rx->remaining;
+                }
+
+              for (size_t k = 0; k < take && rx->pos < sizeof(rx->body);
+                   k++)
+                {
+                  rx->body[rx->pos++] = buf[i + k];
+                }
+
+              i             += take;
+              rx->remaining -= take;
+
+              if (rx->remaining == 0)
+                {
+                  rx->state = HA_MQTT_RX_TYPE;
+                  *used = i;
+                  return HA_MQTT_RX_PACKET;
+                }
+            }
+            break;
+        }
+    }
+
+  *used = i;
+  return HA_MQTT_RX_MORE;
+}
+
+static inline uint8_t ha_mqtt_rx_type(const struct ha_mqtt_rx_s *rx)
+{
+  return rx->type & 0xf0;
+}
+
+/* CONNACK return code (0 = accepted), or -1 if malformed */
+
+static inline int ha_mqtt_connack_rc(const struct ha_mqtt_rx_s *rx)
+{
+  if (ha_mqtt_rx_type(rx) != MQTT_PKT_CONNACK || rx->pos != 2)
+    {
+      return -1;
+    }
+
+  return rx->body[1];
+}
+
+/* PUBACK packet identifier, or -1 if malformed */
+
+static inline int ha_mqtt_puback_pid(const struct ha_mqtt_rx_s *rx)
+{
+  if (ha_mqtt_rx_type(rx) != MQTT_PKT_PUBACK || rx->pos != 2)
+    {
+      return -1;
+    }
+
+  return (rx->body[0] << 8) | rx->body[1];
+}
+
+/* ---- Home Assistant topics and payloads ---- */
+
+/*
+ * Entities announced through MQTT discovery. The object id is also the
+ * key of the value in the state payload.
+ */
+struct ha_mqtt_entity_s
+{
+  const char *component;     /* "binary_sensor" or "sensor" */
+  const char *object;
+  const char *name;
+  const char *device_class;  /* NULL if none */
+  const char *unit;          /* NULL for the binary sensor */
+};
+
+static const struct ha_mqtt_entity_s g_ha_mqtt_entities[] =
+{
+  { "binary_sensor", "presence",           "Presence",
+    "occupancy", NULL },
+  { "sensor",        "motion_energy",      "Motion energy",
+    NULL,        "%" },
+  { "sensor",        "static_energy",      "Static energy",
+    NULL,        "%" },
+  { "sensor",        "motion_distance",    "Motion distance",
+    "distance",  "cm" },
+  { "sensor",        "static_distance",    "Static distance",
+    "distance",  "cm" },
+  { "sensor",        "detection_distance", "Detection distance",
+    "distance",  "cm" },
+};
+
+#define HA_MQTT_ENTITY_COUNT \
+  (sizeof(g_ha_mqtt_entities) / sizeof(g_ha_mqtt_entities[0]))
+
+/*
+ * Node ids end up in topics and unique_ids verbatim, so only
+ * [A-Za-z0-9_-] is allowed (no MQTT wildcards, no JSON escaping).
+ */
+static inline bool ha_mqtt_node_valid(const char *node)
+{
+  size_t n = 0;
+
+  for (; node[n] != '\0'; n++)
+    {
+      char c = node[n];
+
+      if (!((c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') ||
+            (c >= '0' && c <= '9') || c == '_' || c == '-'))
+        {
+          return false;
+        }
+    }
+
+  return n > 0 && n < HA_MQTT_NODE_MAX;
+}
+
+/* "mmwave/<node>/<leaf>" — leaf is "state" or "status" */
+
+static inline int ha_mqtt_node_topic(char *buf, size_t bufsize,
+                                     const char *node, const char *leaf)
+{
+  int n = snprintf(buf, bufsize, "mmwave/%s/%s", node, leaf);
+
+  return n < 0 || (size_t)n >= bufsize ? -1 : n;
+}
+
+/* "homeassistant/<component>/<node>/<object>/config" */
+
+static inline int ha_mqtt_config_topic(char *buf, size_t bufsize,
+                                       const char *node,
+                                       const struct ha_mqtt_entity_s *e)
+{
+  int n = snprintf(buf, bufsize, HA_MQTT_DISCOVERY_PREFIX "/%s/%s/%s/config",
+                   e->component, node, e->object);
+
+  return n < 0 || (size_t)n >= bufsize ? -1 : n;
+}
+
+/* Member whose string value is "<a><sep><b>", all pre-validated */
+
+static inline void ha_mqtt_json_join(struct json_writer_s *w,
+                                     const char *key, const char *a,
+                                     const char *sep, const char *b)
+{
+  json_member(w, key);
+  json_char(w, '"');
+  json_raw(w, a, strlen(a));
+  json_raw(w, sep, strlen(sep));
+  json_raw(w, b, strlen(b));
+  json_char(w, '"');
+}
+
+/*
+ * Retained discovery config for one entity. State and availability
+ * topics are spelled out in full so any HA version accepts them.
+ */
+static inline void ha_mqtt_discovery_json(struct json_writer_s *w,
+                                          const char *node,
+                                          const struct ha_mqtt_entity_s *e)
+{
+  json_begin_object(w, NULL);
+  json_str(w, "name", e->name);
+  ha_mqtt_json_join(w, "unique_id", node, "_", e->object);
+  ha_mqtt_json_join(w, "object_id", node, "_", e->object);
+  ha_mqtt_json_join(w, "state_topic", "mmwave/", node, "/state");
+  ha_mqtt_json_join(w, "value_template", "{{ value_json.", e->object,
+                    " }}");
+
+  if (e->unit == NULL)
+    {
+      json_str(w, "payload_on", "on");
+      json_str(w, "payload_off", "off");
+    }
+  else
+    {
+      json_str(w, "unit_of_measurement", e->unit);
+      json_str(w, "state_class", "measurement");
+    }
+
+  if (e->device_class != NULL)
+    {
+      json_str(w, "device_class", e->device_class);
+    }
+
+  ha_mqtt_json_join(w, "availability_topic", "mmwave/", node, "/status");
+
+  json_begin_object(w, "device");
+  json_begin_array(w, "identifiers");
+  json_str(w, NULL, node);
+  json_end_array(w);
+  json_str(w, "name", "mmWave Presence");
+  json_str(w, "model", "LD2410");
+  json_str(w, "manufacturer", "mmWave OS");
+  json_end_object(w);
+  json_end_object(w);
+}
+
+/*
+ * State payload published to mmwave/<node>/state. Flat, one key per
+ * discovered entity, so each value_template is a single lookup.
+ *
+ * Returns the length, or -1 if it does not fit.
+ */
+static inline int ha_mqtt_state_json(char *buf, size_t bufsize,
+                                     const struct mmwave_data_s *data)
+{
+  struct json_buf_s out =
+  {
+    buf, bufsize, 0
+  };
+
+  struct json_writer_s w;
+
+  json_init(&w, json_sink_buf, &out);
+  json_begin_object(&w, NULL);
+  json_str(&w, "presence", mmwave_json_presence(data) ? "on" : "off");
+  json_str(&w, "target", mmwave_target_str(data->target_state));
+  mmwave_json_fields(&w, data);
+  json_end_object(&w);
+
+  return json_finish_buf(&w, &out);
+}
+
+#endif /* __APPS_HACTL_HA_MQTT_H */
@@ -0,0 +1,198 @@
+/*
+ * apps/hactl/ha_queue.h
+ *
+ * Bounded transition queue with exponential retry backoff for hactl.
+ * Pure functions over caller-owned state, so the replay and backoff
+ * policy can be unit-tested without sockets or timers.
+ */
+
+#ifndef __APPS_HACTL_HA_QUEUE_H
+#define __APPS_HACTL_HA_QUEUE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+/* Pending transitions kept while HA is unreachable (~16 bytes each) */
+
+#define HA_QUEUE_DEPTH          16
+
+/* Retry delay never grows beyond this, however long HA stays down */
+
+#define HA_BACKOFF_MAX_MS       60000
+
+/* HA presence state has not been confirmed by a successful post yet */
+
+#define HA_STATE_UNKNOWN        0xFF
+
+struct ha_queue_s
+{
+  struct mmwave_data_s entries[HA_QUEUE_DEPTH]; /* Oldest at head */
+  uint8_t  head;
+  uint8_t  count;
+  uint8_t  acked;          /* Presence (0/1) HA last accepted */
+  uint32_t dropped;        /* Transitions lost to a full queue */
+  uint32_t collapsed;      /* Samples merged away as redundant */
+  uint32_t failures;       /* Consecutive failed posts */
+  uint32_t next_try_ms;    /* Earliest time the head may be retried */
+  uint32_t rng;            /* xorshift32 state for backoff jitter */
+};
+
+/* HA's binary_sensor only distinguishes on/off */
+
+static inline uint8_t ha_presence(const struct mmwave_data_s *data)
+{
+  return data->target_state != LD2410_TARGET_NONE ? 1 : 0;
+}
+
+static inline void ha_queue_init(struct ha_queue_s *q, uint32_t seed)
+{
+  memset(q, 0, sizeof(*q));
+  q->acked = HA_STATE_UNKNOWN;
+  q->rng   = seed != 0 ? seed : 0x2545f491;
+}
+
+static inline struct mmwave_data_s *ha_queue_at(struct ha_queue_s *q,
+                                                unsigned int i)
+{
+  return &q->entries[(q->head + i) % HA_QUEUE_DEPTH];
+}
+
+static inline struct mmwave_data_s *ha_queue_peek(struct ha_queue_s *q)
+{
+  return q->count > 0 ? ha_queue_at(q, 0) : NULL;
+}
+
+static inline void ha_queue_pop(struct ha_queue_s *q)
+{
+  if (q->count > 0)
+    {
+      q->head = (q->head + 1) % HA_QUEUE_DEPTH;
+      q->count--;
+    }
+}
+
+/*
+ * Record a sensor sample whose target state changed.
+ *
+ * Samples with the same presence as the queue tail replace it in place,
+ * so consecutive entries always alternate on/off and the tail carries
+ * the freshest attributes. When the queue is full the oldest on/off pair
+ * is discarded, which keeps the remaining history consistent with what
+ * HA last accepted.
+ */
+static inline void ha_queue_push(struct ha_queue_s *q,
+                                 const struct mmwave_data_s *data)
+{
+  if (q->count > 0)
+    {
+      struct mmwave_data_s *tail = ha_queue_at(q, q->count - 1);
+      if (ha_presence(tail) == ha_presence(data))
+        {
+          *tail = *data;
+          q->collapsed++;
+          return;
+        }
+    }
+
+  if (q->count == HA_QUEUE_DEPTH)
+    {
+      if (ha_presence(ha_queue_at(q, 0)) == q->acked)
+        {
+          /* Head only refreshes attributes HA already has the state for */
+
+          ha_queue_pop(q);
+          q->dropped++;
+        }
+      else
+        {
+          ha_queue_pop(q);
+          ha_queue_pop(q);
+          q->dropped += 2;
+        }
+    }
+
+  *ha_queue_at(q, q->count) = *data;
+  q->count++;
+}
+
+/*
+ * Reduce the queue to the minimal set of posts before a replay.
+ *
+ * Push already keeps entries alternating, so the only redundancy left
+ * is a head entry repeating the state HA accepted last: its attributes
+ * are superseded by the entries behind it.
+ */
+static inline void ha_queue_collapse(struct ha_queue_s *q)
+{
+  while (q->count > 1 && ha_presence(ha_queue_at(q, 0)) == q->acked)
+    {
+      ha_queue_pop(q);
+      q->collapsed++;
+    }
+}
+
+/* True when an entry is pending and its retry delay has elapsed */
+
+static inline bool ha_queue_due(const struct ha_queue_s *q, uint32_t now_ms)
+{
+  return q->count > 0 && (int32_t)(now_ms - q->next_try_ms) >= 0;
+}
+
+/*
+ * Backoff delay for the current failure count: base * 2^(failures-1),
+ * capped at HA_BACKOFF_MAX_MS, with "equal jitter" so a fleet of
+ * sensors recovering from the same outage does not retry in lockstep.
+ * The result lies in [delay/2, delay].
+ */
+static inline uint32_t ha_backoff_ms(struct ha_queue_s *q, uint32_t base_ms)
+{
+  uint32_t delay = base_ms > 0 ? base_ms : 1;
+  uint32_t n = q->failures > 0 ? q->failures - 1 : 0;
+
+  while (n-- > 0 && delay < HA_BACKOFF_MAX_MS)
+    {
+      delay <<= 1;
+    }
+
+  if (delay > HA_BACKOFF_MAX_MS)
+    {
+      delay = HA_BACKOFF_MAX_MS;
+    }
+
+  q->rng ^= q->rng << 13;
+  q->rng ^= q->rng >> 17;
+  q->rng ^= q->rng << 5;
+
+  return delay / 2 + q->rng % (delay / 2 + 1);
+}
+
+/* The head entry was accepted by HA */
+
+static inline void ha_queue_ack(struct ha_queue_s *q, uint32_t now_ms)
+{
+  struct mmwave_data_s *head = ha_queue_peek(q);
+  if (head != NULL)
+    {
+      q->acked = ha_presence(head);
+      ha_queue_pop(q);
+    }
+
+  q->failures    = 0;
+  q->next_try_ms = now_ms;
+}
+
+/* Posting the head failed; returns the delay until the next attempt */
+
+static inline uint32_t ha_queue_fail(struct ha_queue_s *q, uint32_t now_ms,
+                                     uint32_t base_ms)
+{
+  q->failures++;
+  uint32_t delay = ha_backoff_ms(q, base_ms);
+  q->next_try_ms = now_ms + delay;
+  return delay;
+}
+
+#endif /* __APPS_HACTL_HA_QUEUE_H */
@@ -0,0 +1,364 @@
+/*
+ * apps/hactl/ha_sink.h
+ *
+ * Reporting core for hactl: the report task reads the sensor once and
+ * fans each presence change out to every registered sink (the Home
+ * Assistant backend first, then the others, in registration order).
+ *
+ * A sink is a small vtable:
+ *
+ *   init          once at start; a sink that fails is switched off and
+ *                 the others run without it
+ *   on_change     a new target state; must only queue, never block
+ *   on_heartbeat  every heartbeat_ms with the latest sample (keep-alive,
+ *                 periodic refresh); optional
+ *   flush         deliver what is queued; the only call that may talk
+ *                 to the network
+ *   close         once at stop, after a last flush; optional
+ *
+ * flush() returns OK when nothing is left, -EAGAIN when something is
+ * left but the sink is pacing itself, or another negative errno when
+ * delivery failed. Each sink has its own schedule: flushes are at least
+ * min_interval_ms apart, failures back off exponentially from
+ * backoff_ms (0: the sink paces its own retries and just returns
+ * -EAGAIN until it is ready), and a flush that overruns budget_ms
+ * pushes that sink's next flush back by as long as it took. So a sink
+ * stuck on a dead server spends at most about half the loop on itself
+ * and never stops changes reaching the others.
+ *
+ * Time comes from a clock callback so the scheduling is host-testable.
+ */
+
+#ifndef __APPS_HACTL_HA_SINK_H
+#define __APPS_HACTL_HA_SINK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+#define HA_SINK_MAX             4
+
+/* Failure backoff never grows beyond this */
+
+#define HA_SINK_BACKOFF_MAX_MS  60000
+
+enum ha_sink_state_e
+{
+  HA_SINK_IDLE = 0,      /* Registered, not started */
+  HA_SINK_ON,
+  HA_SINK_FAILED         /* init() failed; skipped until restart */
+};
+
+struct ha_sink_ops_s
+{
+  const char *name;
+  int  (*init)(void *priv);
+  int  (*on_change)(void *priv, const struct mmwave_data_s *data,
+                    uint32_t now);
+  int  (*on_heartbeat)(void *priv, const struct mmwave_data_s *data,
+                       uint32_t now);
+  int  (*flush)(void *priv, uint32_t now);
+  void (*close)(void *priv);
+};
+
+struct ha_sink_stats_s
+{
+  uint32_t changes;      /* on_change calls */
+  uint32_t heartbeats;
+  uint32_t flushes;      /* flush calls */
+  uint32_t limited;      /* Flushes held back by rate limit or backoff */
+  uint32_t errors;       /* Failed init/on_change/flush */
+  uint32_t overruns;     /* Flushes longer than budget_ms */
+  uint32_t flush_max_ms;
+};
+
+struct ha_sink_s
+{
+  const struct ha_sink_ops_s *ops;
+  void    *priv;
+
+  /* Schedule, set by the caller before ha_fanout_add() */
+
+  uint32_t min_interval_ms;
+  uint32_t heartbeat_ms;   /* 0: no heartbeats */
+  uint32_t backoff_ms;     /* 0: sink paces its own retries */
+  uint32_t budget_ms;      /* 0: no budget */
+
+  /* Run-time state */
+
+  uint8_t  state;          /* enum ha_sink_state_e */
+  bool     pending;        /* Something may be waiting for flush() */
+  uint32_t failures;       /* Consecutive failed flushes */
+  uint32_t next_flush_ms;
+  uint32_t next_hb_ms;
+  struct ha_sink_stats_s stats;
+};
+
+typedef uint32_t (*ha_clock_t)(void);
+
+struct ha_fanout_s
+{
+  struct ha_sink_s    *sinks[HA_SINK_MAX];
+  uint8_t              count;
+  ha_clock_t           clock;
+  bool                 have_last;
+  struct mmwave_data_s last;       /* Latest sample read */
+  uint32_t             samples;
+  uint32_t             changes;
+};
+
+static inline void ha_fanout_init(struct ha_fanout_s *f, ha_clock_t clock)
+{
+  memset(f, 0, sizeof(*f));
+  f->clock = clock;
+}
+
+/* Register a sink; returns its index or -ENOSPC */
+
+static inline int ha_fanout_add(struct ha_fanout_s *f, struct ha_sink_s *s)
+{
+  if (f->count == HA_SINK_MAX)
+    {
+      return -ENOSPC;
+    }
+
+  s->state = HA_SINK_IDLE;
+  memset(&s->stats, 0, sizeof(s->stats));
+  f->sinks[f->count] = s;
+  return f->count++;
+}
+
+/* Initialise every sink; returns how many are running */
+
+static inline int ha_fanout_start(struct ha_fanout_s *f)
+{
+  uint32_t now = f->clock();
+  int running = 0;
+
+  for (int i = 0; i < f->count; i++)
+    {
+      struct ha_sink_s *s = f->sinks[i];
+
+      s->pending       = false;
+      s->failures      = 0;
+      s->next_flush_ms = now;
+      s->next_hb_ms    = now + s->heartbeat_ms;
+
+      if (s->ops->init != NULL && s->ops->init(s->priv) < 0)
+        {
+          s->state = HA_SINK_FAILED;
+          s->stats.errors++;
+          continue;
+        }
+
+      s->state = HA_SINK_ON;
+      running++;
+    }
+
+  return running;
+}
+
+static inline void ha_fanout_change(struct ha_fanout_s *f,
+                                    const struct mmwave_data_s *data,
+                                    uint32_t now)
+{
+  for (int i = 0; i < f->count; i++)
+    {
+      struct ha_sink_s *s = f->sinks[i];
+
+      if (s->state != HA_SINK_ON)
+        {
+          continue;
+        }
+
+      s->stats.changes++;
+      if (s->ops->on_change(s->priv, data, now) < 0)
+        {
+          s->stats.errors++;
+        }
+      else
+        {
+          s->pending = true;
+        }
+    }
+}
+
+/*
+ * One sensor sample. A change of target state (or the first sample) is
+ * passed to every running sink. Returns true if it was a change.
+ */
+static inline bool ha_fanout_input(struct ha_fanout_s *f,
+                                   const struct mmwave_data_s *data)
+{
+  bool changed = !f->have_last ||
+                 data->target_state != f->last.target_state;
+
+  f->samples++;
+  f->last      = *data;
+  f->have_last = true;
+
+  if (changed)
+    {
+      f->changes++;
+      ha_fanout_change(f, data, f->clock());
+    }
+
+  return changed;
+}
+
+/* Send the latest sample to every sink as if it were a change */
+
+static inline bool ha_fanout_push(struct ha_fanout_s *f)
+{
+  if (!f->have_last)
+    {
+      return false;
+    }
+
+  ha_fanout_change(f, &f->last, f->clock());
+  return true;
+}
+
+/* Delay before retry number `failures`: base * 2^(failures-1), capped */
+
+static inline uint32_t ha_sink_backoff(uint32_t base_ms, uint32_t failures)
+{
+  uint32_t delay = base_ms;
+
+  while (--failures > 0 && delay < HA_SINK_BACKOFF_MAX_MS)
+    {
+      delay <<= 1;
+    }
+
+  return delay < HA_SINK_BACKOFF_MAX_MS ? delay : HA_SINK_BACKOFF_MAX_MS;
+}
+
+static inline void ha_fanout_flush(struct ha_sink_s *s, ha_clock_t clock)
+{
+  uint32_t t0 = clock();
+  int ret = s->ops->flush(s->priv, t0);
+  uint32_t t1 = clock();
+  uint32_t took = t1 - t0;
+  uint32_t wait = s->min_interval_ms;
+
+  s->stats.flushes++;
+  if (took > s->stats.flush_max_ms)
+    {
+      s->stats.flush_max_ms = took;
+    }
+
+  if (ret == OK)
+    {
+      s->pending  = false;
+      s->failures = 0;
+    }
+  else if (ret != -EAGAIN)
+    {
+      s->failures++;
+      s->stats.errors++;
+      if (s->backoff_ms > 0)
+        {
+          wait = ha_sink_backoff(s->backoff_ms, s->failures);
+        }
+    }
+
+  /* Over budget: sit out as long as the flush took */
+
+  if (s->budget_ms > 0 && took > s->budget_ms)
+    {
+      s->stats.overruns++;
+      if (took > wait)
+        {
+          wait = took;
+        }
+    }
+
+  s->next_flush_ms = t1 + wait;
+}
+
+/*
+ * Run heartbeats and flushes that are due. Sinks are visited in
+ * registration order and each is skipped until its own schedule says
+ * otherwise, so one slow or failing sink only delays itself.
+ */
+static inline void ha_fanout_run(struct ha_fanout_s *f)
+{
+  for (int i = 0; i < f->count; i++)
+    {
+      struct ha_sink_s *s = f->sinks[i];
+      uint32_t now = f->clock();
+
+      if (s->state != HA_SINK_ON)
+        {
+          continue;
+        }
+
+      if (s->heartbeat_ms > 0 && f->have_last &&
+          (int32_t)(now - s->next_hb_ms) >= 0)
+        {
+          s->next_hb_ms = now + s->heartbeat_ms;
+          if (s->ops->on_heartbeat != NULL)
+            {
+              s->stats.heartbeats++;
+              if (s->ops->on_heartbeat(s->priv, &f->last, now) < 0)
+                {
+                  s->stats.errors++;
+                }
+              else
+                {
+                  s->pending = true;
+                }
+            }
+        }
+
+      if (!s->pending)
+        {
+          continue;
+        }
+
+      if ((int32_t)(now - s->next_flush_ms) < 0)
+        {
+          s->stats.limited++;
+          continue;
+        }
+
+      ha_fanout_flush(s, f->clock);
+    }
+}
+
+/* Last flush for every running sink, ignoring schedules, then close */
+
+static inline void ha_fanout_stop(struct ha_fanout_s *f)
+{
+  for (int i = 0; i < f->count; i++)
+    {
+      struct ha_sink_s *s = f->sinks[i];
+
+      if (s->state == HA_SINK_ON && s->pending)
+        {
+          ha_fanout_flush(s, f->clock);
+        }
+
+      if (s->state == HA_SINK_ON && s->ops->close != NULL)
+        {
+          s->ops->close(s->priv);
+        }
+
+      s->state = HA_SINK_IDLE;
+    }
+}
+
+static inline const char *ha_sink_state_str(uint8_t state)
+{
+  switch (state)
+    {
+      case HA_SINK_ON:     return "on";
+      case HA_SINK_FAILED: return "FAILED";
+      default:             return "idle";
+    }
+}
+
+#endif /* __APPS_HACTL_HA_SINK_H */
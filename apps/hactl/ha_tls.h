@@ -0,0 +1,148 @@
+/*
+ * apps/hactl/ha_tls.h
+ *
+ * TLS bookkeeping for hactl, kept apart from mbedTLS so it runs on the
+ * host:
+ *
+ *   - the resumption cache: whether the session saved after the last
+ *     full handshake may be offered on the next connect. It is offered
+ *     until lifetime_ms after that full handshake (servers cap a
+ *     session's total age, not the time since it was last used) and
+ *     dropped when a handshake that offered it fails, so a stale ticket
+ *     costs at most one extra connect.
+ *   - handshake statistics: full and resumed handshakes with their
+ *     times, offers the server turned down, failures.
+ *   - gathering a message's iovecs into one buffer, so it goes out as
+ *     one TLS record instead of one per piece; each record carries its
+ *     own header, nonce and tag, and a small one often its own segment.
+ */
+
+#ifndef __APPS_HACTL_HA_TLS_H
+#define __APPS_HACTL_HA_TLS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+struct ha_tls_cache_s
+{
+  bool     valid;        /* A session is saved */
+  uint32_t born_ms;      /* Its full handshake */
+  uint32_t lifetime_ms;
+};
+
+struct ha_tls_stats_s
+{
+  uint32_t full;           /* Full handshakes */
+  uint32_t resumed;        /* Abbreviated handshakes */
+  uint32_t rejected;       /* Offered a session, got a full handshake */
+  uint32_t failed;
+  uint32_t last_ms;
+  uint32_t full_max_ms;
+  uint32_t full_sum_ms;
+  uint32_t resumed_max_ms;
+  uint32_t resumed_sum_ms;
+};
+
+static inline void ha_tls_cache_init(struct ha_tls_cache_s *c,
+                                     uint32_t lifetime_ms)
+{
+  memset(c, 0, sizeof(*c));
+  c->lifetime_ms = lifetime_ms;
+}
+
+/* Should the saved session be offered to the server now? */
+
+static inline bool ha_tls_offer(struct ha_tls_cache_s *c, uint32_t now)
+{
+  if (c->valid && now - c->born_ms >= c->lifetime_ms)
+    {
+      c->valid = false;
+    }
+
+  return c->valid;
+}
+
+/*
+ * A handshake finished in `ms`. After a full one the caller saves the
+ * new session and it may be offered for lifetime_ms from now; a resumed
+ * one leaves the session's age alone.
+ */
+
+static inline void ha_tls_done(struct ha_tls_cache_s *c,
+                               struct ha_tls_stats_s *st, bool offered,
+                               bool resumed, uint32_t ms, uint32_t now)
+{
+  st->last_ms = ms;
+
+  if (resumed)
+    {
+      st->resumed++;
+      st->resumed_sum_ms += ms;
+      if (ms > st->resumed_max_ms)
+        {
+          st->resumed_max_ms = ms;
+        }
+
+      return;
+    }
+
+  st->full++;
+  st->full_sum_ms += ms;
+  if (ms > st->full_max_ms)
+    {
+      st->full_max_ms = ms;
+    }
+
+  if (offered)
+    {
+      st->rejected++;
+    }
+
+  c->valid   = true;
+  c->born_ms = now;
+}
+
+/* A failed handshake: never offer the same session twice in a row */
+
+static inline void ha_tls_failed(struct ha_tls_cache_s *c,
+                                 struct ha_tls_stats_s *st, bool offered)
+{
+  st->failed++;
+  if (offered)
+    {
+      c->valid = false;
+    }
+}
+
+static inline uint32_t ha_tls_avg_ms(uint32_t sum, uint32_t n)
+{
+  return n > 0 ? sum / n : 0;
+}
+
+/* Copy iov into buf; returns the length, or -E2BIG if it does not fit */
+
+static inline ssize_t ha_tls_gather(const struct iovec *iov, int iovcnt,
+                                    uint8_t *buf, size_t size)
+{
+  size_t len = 0;
+
+  for (int i = 0; i < iovcnt; i++)
+    {
+      if (iov[i].iov_len > size - len)
+        {
+          return -E2BIG;
+        }
+
+      memcpy(buf + len, iov[i].iov_base, iov[i].iov_len);
+      len += iov[i].iov_len;
+    }
+
+  return (ssize_t)len;
+}
+
+#endif /* __APPS_HACTL_HA_TLS_H */
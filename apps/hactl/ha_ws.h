@@ -0,0 +1,602 @@
+/*
+ * apps/hactl/ha_ws.h
+ *
+ * WebSocket (RFC 6455) client pieces for the hactl Home Assistant
+ * WebSocket API backend: opening handshake, masked frame encoding
+ * straight into a fixed buffer, an incremental frame reader, and the
+ * HA auth / fire_event messages. Pure functions over caller-owned
+ * state, so everything short of the socket is unit-testable.
+ */
+
+#ifndef __APPS_HACTL_HA_WS_H
+#define __APPS_HACTL_HA_WS_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/json_writer.h"
+#include "apps/common/mmwave_json.h"
+#include "apps/common/mmwave_sha1.h"
+
+#define HA_WS_PATH              "/api/websocket"
+#define HA_WS_GUID              "258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+/* HA event carrying each state update (see docs/QUICKSTART.md) */
+
+#define HA_WS_EVENT_TYPE        "mmwave_state"
+
+/* base64 of the 16-byte nonce, and of the 20-byte SHA-1 */
+
+#define HA_WS_KEY_LEN           24
+#define HA_WS_ACCEPT_LEN        28
+
+/* Opcodes */
+
+#define HA_WS_OP_CONT           0x0
+#define HA_WS_OP_TEXT           0x1
+#define HA_WS_OP_BINARY         0x2
+#define HA_WS_OP_CLOSE          0x8
+#define HA_WS_OP_PING           0x9
+#define HA_WS_OP_PONG           0xA
+
+#define HA_WS_FIN               0x80
+#define HA_WS_MASKED            0x80
+
+/* Client frame header: 2 bytes + 16-bit extended length + mask key */
+
+#define HA_WS_HDR_MAX           8
+
+/* Leading bytes of each incoming message kept for inspection */
+
+#define HA_WS_RX_KEEP           127
+
+/* Results */
+
+#define HA_WS_MORE              0
+#define HA_WS_DONE              1
+#define HA_WS_INVALID           (-1)
+
+/* Message type needle for ha_ws_msg_has() */
+
+#define HA_WS_TYPE(t)           "\"type\":\"" t "\""
+
+/* ---- base64, for the key and Sec-WebSocket-Accept ---- */
+
+/* Standard base64 with padding; out needs 4 * ceil(n / 3) + 1 bytes */
+
+static inline void ha_base64(char *out, const uint8_t *in, size_t n)
+{
+  static const char tbl[] =
+    "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+  for (; n >= 3; n -= 3, in += 3)
+    {
+      *out++ = tbl[in[0] >> 2];
+      *out++ = tbl[((in[0] & 3) << 4) | (in[1] >> 4)];
+      *out++ = tbl[((in[1] & 15) << 2) | (in[2] >> 6)];
+      *out++ = tbl[in[2] & 63];
+    }
+
+  if (n > 0)
+    {
+      *out++ = tbl[in[0] >> 2];
+      if (n == 1)
+        {
+          *out++ = tbl[(in[0] & 3) << 4];
+          *out++ = '=';
+        }
+      else
+        {
+          *out++ = tbl[((in[0] & 3) << 4) | (in[1] >> 4)];
+          *out++ = tbl[(in[1] & 15) << 2];
+        }
+
+      *out++ = '=';
+    }
+
+  *out = '\0';
+}
+
+/* Sec-WebSocket-Key from 16 nonce bytes */
+
+static inline void ha_ws_key(char out[HA_WS_KEY_LEN + 1],
+                             const uint8_t nonce[16])
+{
+  ha_base64(out, nonce, 16);
+}
+
+/* The Sec-WebSocket-Accept value a server must answer `key` with */
+
+static inline void ha_ws_accept(char out[HA_WS_ACCEPT_LEN + 1],
+                                const char *key)
+{
+  struct mmwave_sha1_s c;
+  uint8_t digest[MMWAVE_SHA1_LEN];
+
+  mmwave_sha1_init(&c);
+  mmwave_sha1_update(&c, key, strlen(key));
+  mmwave_sha1_update(&c, HA_WS_GUID, sizeof(HA_WS_GUID) - 1);
+  mmwave_sha1_final(&c, digest);
+  ha_base64(out, digest, sizeof(digest));
+}
+
+/* ---- Opening handshake ---- */
+
+/*
+ * Render the upgrade request. Returns its length, or -1 if it does not
+ * fit.
+ */
+static inline int ha_ws_handshake(char *buf, size_t bufsize,
+                                  const char *host, uint16_t port,
+                                  const char *key)
+{
+  int n = snprintf(buf, bufsize,
+    "GET " HA_WS_PATH " HTTP/1.1\r\n"
+    "Host: %s:%u\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: %s\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n",
+    host, port, key);
+
+  return n < 0 || (size_t)n >= bufsize ? -1 : n;
+}
+
+/*
+ * Handshake response reader. Header lines are examined one at a time
+ * from a small line buffer (longer lines are truncated, which is fine:
+ * the lines that matter are short), so no response-sized buffer is
+ * needed.
+ */
+struct ha_ws_hs_s
+{
+  uint16_t status;
+  uint8_t  len;          /* Bytes of the current line in line[] */
+  bool     first;        /* Next line is the status line */
+  bool     upgraded;     /* "Upgrade: websocket" seen */
+  bool     accepted;     /* Sec-WebSocket-Accept matched */
+  char     expect[HA_WS_ACCEPT_LEN + 1];
+  char     line[64];
+};
+
+static inline void ha_ws_hs_init(struct ha_ws_hs_s *hs, const char *key)
+{
+  memset(hs, 0, sizeof(*hs));
+  hs->first = true;
+  ha_ws_accept(hs->expect, key);
+}
+
+static inline bool ha_ws_hs_header(const char *line, const char *name,
+                                   const char **value)
+{
+  size_t n = strlen(name);
+
+  for (size_t i = 0; i < n; i++)
+    {
+      char c = line[i];
+
+      if (c >= 'A' && c <= 'Z')
+        {
+          c = (char)(c + ('a' - 'A'));
+        }
+
+      if (c != name[i])
+        {
+          return false;
+        }
+    }
+
+  if (line[n] != ':')
+    {
+      return false;
+    }
+
+  line += n + 1;
+  while (*line == ' ' || *line == '\t')
+    {
+      line++;
+    }
+
+  *value = line;
+  return true;
+}
+
+/* Evaluate a completed line. Returns HA_WS_MORE, _DONE or _INVALID. */
+
+static inline int ha_ws_hs_line(struct ha_ws_hs_s *hs)
+{
+  const char *v;
+  char *l = hs->line;
+
+  /* Strip CR and trailing whitespace */
+
+  while (hs->len > 0 && (l[hs->len - 1] == '\r' || l[hs->len - 1] == ' '))
+    {
+      hs->len--;
+    }
+
+  l[hs->len] = '\0';
+
+  if (hs->first)
+    {
+      hs->first = false;
+      if (hs->len < 12 || strncmp(l, "HTTP/1.", 7) != 0 || l[8] != ' ')
+        {
+          return HA_WS_INVALID;
+        }
+
+      hs->status = (uint16_t)((l[9] - '0') * 100 + (l[10] - '0') * 10 +
+                              (l[11] - '0'));
+      return HA_WS_MORE;
+    }
+
+  if (hs->len == 0)
+    {
+      return hs->status == 101 && hs->upgraded && hs->accepted ?
+             HA_WS_DONE : HA_WS_INVALID;
+    }
+
+  if (ha_ws_hs_header(l, "upgrade", &v))
+    {
+      hs->upgraded = strncmp(v, "websocket", 9) == 0 ||
+                     strncmp(v, "WebSocket", 9) == 0;
+    }
+  else if (ha_ws_hs_header(l, "sec-websocket-accept", &v))
+    {
+      hs->accepted = strcmp(v, hs->expect) == 0;
+    }
+
+  return HA_WS_MORE;
+}
+
+/*
+ * Feed response bytes. Stops right after the blank line ending the
+ * headers; *used tells the caller where the first frame starts.
+ */
+static inline int ha_ws_hs_feed(struct ha_ws_hs_s *hs, const char *buf,
+                                size_t len, size_t *used)
+{
+  for (size_t i = 0; i < len; i++)
+    {
+      if (buf[i] != '\n')
+        {
+          if (hs->len < sizeof(hs->line) - 1)
+            {
+              hs->line[hs->len++] = buf[i];
+            }
+
+          continue;
+        }
+
+      int ret = ha_ws_hs_line(hs);
+      hs->len = 0;
+      if (ret != HA_WS_MORE)
+        {
+          *used = i + 1;
+          return ret;
+        }
+    }
+
+  *used = len;
+  return HA_WS_MORE;
+}
+
+/* ---- Frame encoding ---- */
+
+/*
+ * A client frame being built in place. The payload is written masked,
+ * starting HA_WS_HDR_MAX bytes into buf, as the JSON writer produces
+ * it; the header is filled in right in front of it at the end, so the
+ * message is never copied or buffered unmasked.
+ */
+struct ha_ws_frame_s
+{
+  uint8_t *buf;
+  size_t   size;
+  size_t   len;        /* Payload bytes so far */
+  int      error;
+  uint8_t  mask[4];
+};
+
+static inline void ha_ws_frame_init(struct ha_ws_frame_s *f, uint8_t *buf,
+                                    size_t size, uint32_t mask)
+{
+  f->buf     = buf;
+  f->size    = size;
+  f->len     = 0;
+  f->error   = 0;
+  f->mask[0] = (uint8_t)(mask >> 24);
+  f->mask[1] = (uint8_t)(mask >> 16);
+  f->mask[2] = (uint8_t)(mask >> 8);
+  f->mask[3] = (uint8_t)mask;
+}
+
+/* json_sink_t: append and mask */
+
+static inline int ha_ws_sink(void *arg, const char *buf, size_t len)
+{
+  struct ha_ws_frame_s *f = (struct ha_ws_frame_s *)arg;
+  uint8_t *p;
+
+  if (f->size - HA_WS_HDR_MAX - f->len < len)
+    {
+      f->error = -E2BIG;
+      return -E2BIG;
+    }
+
+  p = f->buf + HA_WS_HDR_MAX + f->len;
+  for (size_t i = 0; i < len; i++, f->len++)
+    {
+      p[i] = (uint8_t)buf[i] ^ f->mask[f->len & 3];
+    }
+
+  return 0;
+}
+
+/*
+ * Write the header in front of the payload. Returns the total frame
+ * length with *start set to its first byte, or -1 on overflow.
+ */
+static inline int ha_ws_frame_finish(struct ha_ws_frame_s *f,
+                                     uint8_t opcode, uint8_t **start)
+{
+  uint8_t *p;
+  size_t hlen;
+
+  if (f->error != 0 || f->len > 0xffff)
+    {
+      return -1;
+    }
+
+  hlen = f->len < 126 ? 6 : 8;
+  p = f->buf + HA_WS_HDR_MAX - hlen;
+  *start = p;
+
+  *p++ = HA_WS_FIN | opcode;
+  if (f->len < 126)
+    {
+      *p++ = HA_WS_MASKED | (uint8_t)f->len;
+    }
+  else
+    {
+      *p++ = HA_WS_MASKED | 126;
+      *p++ = (uint8_t)(f->len >> 8);
+      *p++ = (uint8_t)f->len;
+    }
+
+  memcpy(p, f->mask, 4);
+  return (int)(hlen + f->len);
+}
+
+/* {"type":"auth","access_token":"..."} — sent once per connection */
+
+static inline void ha_ws_auth_json(struct json_writer_s *w,
+                                   const char *token)
+{
+  json_begin_object(w, NULL);
+  json_str(w, "type", "auth");
+  json_str(w, "access_token", token);
+  json_end_object(w);
+}
+
+/* One state update: fire_event with the reading as event data */
+
+static inline void ha_ws_event_json(struct json_writer_s *w, uint32_t id,
+                                    const struct mmwave_data_s *data)
+{
+  json_begin_object(w, NULL);
+  json_uint(w, "id", id);
+  json_str(w, "type", "fire_event");
+  json_str(w, "event_type", HA_WS_EVENT_TYPE);
+  json_begin_object(w, "event_data");
+  json_str(w, "presence", mmwave_json_presence(data) ? "on" : "off");
+  json_str(w, "target", mmwave_target_str(data->target_state));
+  mmwave_json_fields(w, data);
+  json_end_object(w);
+  json_end_object(w);
+}
+
+/*
+ * Finish the document `w` streamed into the frame (via ha_ws_sink) and
+ * wrap it as one masked text frame. Returns the frame length with
+ * *start set, or -1.
+ */
+static inline int ha_ws_frame_text(struct ha_ws_frame_s *f,
+                                   struct json_writer_s *w, uint8_t **start)
+{
+  if (json_finish(w) < 0)
+    {
+      return -1;
+    }
+
+  return ha_ws_frame_finish(f, HA_WS_OP_TEXT, start);
+}
+
+/* ---- Frame decoding ---- */
+
+enum ha_ws_rx_state_e
+{
+  HA_WS_RX_HDR0 = 0,
+  HA_WS_RX_HDR1,
+  HA_WS_RX_EXTLEN,
+  HA_WS_RX_PAYLOAD
+};
+
+/*
+ * Incremental reader for server frames. The first HA_WS_RX_KEEP bytes
+ * of each payload are kept NUL-terminated in data[] (enough for HA's
+ * auth and result headers); the rest is skipped.
+ */
+struct ha_ws_rx_s
+{
+  uint8_t  state;
+  uint8_t  opcode;
+  uint8_t  need;       /* Extended length bytes still to read */
+  bool     fin;
+  uint32_t remaining;  /* Payload bytes still to come */
+  uint16_t pos;        /* Payload bytes kept in data[] */
+  char     data[HA_WS_RX_KEEP + 1];
+};
+
+static inline void ha_ws_rx_init(struct ha_ws_rx_s *rx)
+{
+  memset(rx, 0, sizeof(*rx));
+}
+
+static inline int ha_ws_rx_payload_done(struct ha_ws_rx_s *rx)
+{
+  rx->data[rx->pos] = '\0';
+  rx->state = HA_WS_RX_HDR0;
+  return HA_WS_DONE;
+}
+
+/*
+ * Consume bytes until one frame is complete (HA_WS_DONE); *used is the
+ * count consumed. Masked server frames and payloads over 4 GiB are
+ * protocol errors.
+ */
+static inline int ha_ws_rx_feed(struct ha_ws_rx_s *rx, const uint8_t *buf,
+                                size_t len, size_t *used)
+{
+  size_t i = 0;
+
+  while (i < len)
+    {
+      uint8_t c = buf[i];
+
+      switch (rx->state)
+        {
+          case HA_WS_RX_HDR0:
+            rx->fin       = (c & HA_WS_FIN) != 0;
+            rx->opcode    = c & 0x0f;
+            rx->remaining = 0;
+            rx->pos       = 0;
+            rx->state     = HA_WS_RX_HDR1;
+            i++;
+            break;
+
+          case HA_WS_RX_HDR1:
+            i++;
+            if (c & HA_WS_MASKED)
+              {
+                *used = i;
+                return HA_WS_INVALID;
+              }
+
+            c &= 0x7f;
+            if (c < 126)
+              {
+                rx->remaining = c;
+                rx->state = HA_WS_RX_PAYLOAD;
+                if (c == 0)
+                  {
+                    *used = i;
+                    return ha_ws_rx_payload_done(rx);
+                  }
+              }
+            else
+              {
+                rx->need  = c == 126 ? 2 : 8;
+                rx->state = HA_WS_RX_EXTLEN;
+              }
+            break;
+
+          case HA_WS_RX_EXTLEN:
+            i++;
+            if (rx->need > 4 && c != 0)
+              {
+                *used = i;
+                return HA_WS_INVALID;
+              }
+
+            rx->remaining = (rx->remaining << 8) | c;
+            if (--rx->need == 0)
+              {
+                rx->state = HA_WS_RX_PAYLOAD;
+                if (rx->remaining == 0)
+                  {
+                    *used = i;
+                    return ha_ws_rx_payload_done(rx);
+                  }
+              }
+            break;
+
+          case HA_WS_RX_PAYLOAD:
+            {
+              size_t take = len - i;
+
+              if (take > rx->remaining)
+                {
+                  take = rx->remaining;
+                }
+
+              for (size_t k = 0; k < take && rx->pos < HA_WS_RX_KEEP; k++)
+                {
+                  rx->data[rx->pos++] = (char)buf[i + k];
+                }
+
+              i             += take;
+              rx->remaining -= take;
+
+              if (rx->remaining == 0)
+                {
+                  *used = i;
+                  return ha_ws_rx_payload_done(rx);
+                }
+            }
+            break;
+        }
+    }
+
+  *used = i;
+  return HA_WS_MORE;
+}
+
+/* ---- HA message inspection (on the kept prefix) ---- */
+
+static inline bool ha_ws_msg_has(const struct ha_ws_rx_s *rx,
+                                 const char *needle)
+{
+  return strstr(rx->data, needle) != NULL;
+}
+
+/* "id" of a result message, or -1 */
+
+static inline int32_t ha_ws_result_id(const struct ha_ws_rx_s *rx)
+{
+  const char *p;
+  int32_t id = 0;
+
+  if (!ha_ws_msg_has(rx, HA_WS_TYPE("result")) ||
+      (p = strstr(rx->data, "\"id\":")) == NULL)
+    {
+      return -1;
+    }
+
+  for (p += 5; *p == ' '; p++)
+    {
+    }
+
+  if (*p < '0' || *p > '9')
+    {
+      return -1;
+    }
+
+  for (; *p >= '0' && *p <= '9' && id < 100000000; p++)
+    {
+      id = id * 10 + (*p - '0');
+    }
+
+  return id;
+}
+
+static inline bool ha_ws_result_ok(const struct ha_ws_rx_s *rx)
+{
+  return ha_ws_msg_has(rx, "\"success\":true");
+}
+
+#endif /* __APPS_HACTL_HA_WS_H */
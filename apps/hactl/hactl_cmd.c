@@ -9,7 +9,12 @@
  *   hactl status              — Show connection status
  *   hactl push                — Manually push current sensor state
  *   hactl config <url> <token> — Set HA URL and long-lived access token
- *   hactl start               — Start auto-reporting background task
+ *   hactl mqtt <broker> [user] [pass] — Report over MQTT with discovery
+ *   hactl backend <rest|mqtt|ws> — Select the reporting backend
+ *   hactl node <id>           — Set the MQTT node id
+ *   hactl tls <on|off> [noverify] — TLS to HA or the broker
+ *   hactl start               — Start auto-reporting (in mmwaved if it
+ *                               is running, else in its own task)
  *   hactl stop                — Stop auto-reporting
  *   hactl test                — Test connectivity to HA
  *
@@ -27,30 +32,141 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
+#include <time.h>
 
+#include <sys/ioctl.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/time.h>
 #include <netinet/in.h>
+#include <netinet/tcp.h>
 #include <arpa/inet.h>
 #include <netdb.h>
+#include <syslog.h>
+#include <poll.h>
+#include <semaphore.h>
+
+#ifdef CONFIG_PM
+#include <nuttx/power/pm.h>
+#endif
+
+#ifdef CONFIG_HACTL_TLS
+#  include <mbedtls/ssl.h>
+#  include <mbedtls/net_sockets.h>
+#  include <mbedtls/entropy.h>
+#  include <mbedtls/ctr_drbg.h>
+#  include <mbedtls/x509_crt.h>
+#endif
 
 #include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_service.h"
+#include "apps/config/config_svc.h"
+#include "ha_format.h"
+#include "ha_http.h"
+#include "ha_journal.h"
+#include "ha_mqtt.h"
+#include "ha_queue.h"
+#include "ha_sink.h"
+#include "ha_tls.h"
+#include "ha_ws.h"
 
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
 
-#define HA_CONFIG_FILE          "/config/ha.conf"
+#define HA_CONFIG_FILE          "/config/ha.conf"  /* Before the config service */
 #define HA_ENTITY_ID            "binary_sensor.mmwave_presence"
 #define HA_DEFAULT_PORT         8123
 #define HA_MAX_URL_LEN          128
 #define HA_MAX_TOKEN_LEN        256
-#define HA_HTTP_BUF_SIZE        512
+#define HA_BODY_BUF_SIZE        256
+#define HA_RX_CHUNK_SIZE        128
+#define HA_MAX_CRED_LEN         64
+#define HA_MQTT_DEFAULT_PORT    1883
+#define HA_MQTTS_DEFAULT_PORT   8883
+#define HA_MQTT_DEFAULT_NODE    "mmwave"
+#define HA_MQTT_KEEPALIVE_S     60
+#define HA_MQTT_CONNECT_MAX     256
+#define HA_WS_FRAME_MAX         384   /* Auth frame with a 256-byte token */
 #define MMWAVE_DEV_PATH         "/dev/mmwave0"
+#define HA_TLS_CA_FILE          "/config/ha_ca.pem"
+#define HA_JOURNAL_FILE         "/config/ha_journal.bin"
+
+/* Largest message sent as one TLS record: REST headers plus body */
+
+#define HA_TLS_TX_MAX           (HA_REQUEST_HDR_MAX + HA_BODY_BUF_SIZE)
+
+#ifndef CONFIG_HACTL_TLS_SESSION_S
+#  define CONFIG_HACTL_TLS_SESSION_S 3600
+#endif
+
+#ifndef CONFIG_HACTL_JOURNAL_KB
+#  define CONFIG_HACTL_JOURNAL_KB 16
+#endif
+
+#ifndef CONFIG_HACTL_JOURNAL_SPILL_S
+#  define CONFIG_HACTL_JOURNAL_SPILL_S 60
+#endif
+
+/* Journal records per replay request. A WebSocket batch has to fit in
+ * g_ws_frame with a 31-character node.
+ */
+
+#define HA_JOURNAL_REPLAY_MAX   32
+#define HA_JOURNAL_WS_MAX       8
+
+#ifndef CONFIG_HACTL_LOG_INTERVAL_MS
+#  define CONFIG_HACTL_LOG_INTERVAL_MS 1000
+#endif
+
+/* An exchange with HA (connect, TLS, login, request and reply) is given
+ * up after HA_EXCHANGE_TIMEOUT_MS, its connect() after the sink's flush
+ * budget. Neither is waited out: the socket is polled with the rest.
+ */
+
+#define HA_EXCHANGE_TIMEOUT_MS  5000
+#define HA_SINK_BUDGET_MS       (HA_EXCHANGE_TIMEOUT_MS / 2)
+#define HA_CONNECT_TIMEOUT_MS   HA_SINK_BUDGET_MS
+
+/* gethostbyname() waits on DNS, so it runs in a task of its own */
+
+#define HA_RESOLVE_STACK        2048
+
+/* How often the sinks' schedules are checked */
+
+#define HA_REPORT_TICK_MS       100
+
+/* An ECDHE handshake needs about 4 KB of stack on top of reporting */
+
+#ifdef CONFIG_HACTL_TLS
+#  define HA_REPORT_STACK       6144
+#else
+#  define HA_REPORT_STACK       2048
+#endif
 
 /****************************************************************************
  * Private Types
  ****************************************************************************/
 
+enum ha_backend_e
+{
+  HA_BACKEND_REST = 0,
+  HA_BACKEND_MQTT,
+  HA_BACKEND_WS,
+  HA_BACKEND_COUNT
+};
+
+struct ha_stats_s
+{
+  uint32_t connects;   /* TCP connections opened */
+  uint32_t reused;     /* Posts sent on an existing keep-alive connection */
+  uint32_t tx_bytes;   /* Request/packet bytes sent */
+  uint32_t rx_bytes;   /* Response bytes received */
+  uint32_t posts;      /* Successful state updates */
+  uint32_t lat_max_us; /* Slowest update, send to acknowledgement */
+  uint64_t lat_sum_us;
+};
+
 struct ha_config_s
 {
   char     url[HA_MAX_URL_LEN];      /* e.g., "192.168.1.100" */
@@ -58,285 +174,3102 @@ struct ha_config_s
   char     token[HA_MAX_TOKEN_LEN];  /* Long-lived access token */
   bool     auto_report;              /* Auto-reporting enabled */
   uint16_t report_interval_ms;       /* Min interval between reports */
+  uint8_t  backend;                  /* enum ha_backend_e */
+  uint16_t mqtt_port;
+  char     mqtt_host[HA_MAX_URL_LEN]; /* Broker; "": the HA host */
+  bool     mqtt_qos1;                /* Wait for PUBACK on state updates */
+  char     mqtt_user[HA_MAX_CRED_LEN];
+  char     mqtt_pass[HA_MAX_CRED_LEN];
+  char     node[HA_MQTT_NODE_MAX];   /* MQTT topic level and unique_id */
+  bool     tls;                      /* Connections go over TLS */
+  bool     tls_verify;               /* Require a certificate chain */
+};
+
+/* WebSocket receive side, kept across calls on the open session */
+
+struct ha_ws_conn_s
+{
+  struct ha_ws_rx_s rx;
+  uint32_t id;           /* Last command id; restarts per connection */
+  uint32_t rng;          /* Mask key / nonce generator */
+};
+
+/* Where the session's connection is */
+
+enum ha_conn_e
+{
+  HA_CONN_CLOSED = 0,
+  HA_CONN_RESOLVING,     /* Waiting for the ha_resolve task */
+  HA_CONN_CONNECTING,    /* connect() in progress */
+  HA_CONN_HANDSHAKE,     /* TLS handshake in progress */
+  HA_CONN_OPEN
+};
+
+/* What an exchange is for */
+
+enum ha_op_e
+{
+  HA_OP_NONE = 0,
+  HA_OP_CONNECT,         /* Connected (and TLS up): `hactl test` */
+  HA_OP_OPEN,            /* Connected and logged in: MQTT/WS reconnect */
+  HA_OP_STATE,           /* Deliver s->data */
+  HA_OP_JOURNAL,         /* Deliver the batch in g_replay */
+  HA_OP_PING             /* MQTT/WS keep-alive */
+};
+
+#define HA_STEP_READY   0xff   /* Login done */
+
+/*
+ * One persistent connection, owned by whichever task reports, and the
+ * one exchange running on it. No call waits on the server: each sends
+ * what it can and returns, and poll() on sockfd says when to go on.
+ */
+
+struct ha_session_s
+{
+  int      sockfd;       /* -1 when not connected */
+  uint8_t  conn;         /* enum ha_conn_e */
+  uint8_t  op;           /* enum ha_op_e; NONE once collected */
+  uint8_t  step;         /* Backend login step, HA_STEP_READY when done */
+  uint8_t  await_type;   /* MQTT packet or WebSocket opcode awaited */
+  bool     waiting;      /* A reply is awaited */
+  bool     reused;       /* The exchange began on an open connection */
+  uint16_t pid;          /* Last MQTT packet identifier */
+  uint32_t await;        /* PUBACK pid or WebSocket command id awaited */
+  int      result;       /* -EINPROGRESS while the exchange runs */
+  uint32_t started_ms;
+  uint32_t deadline_ms;
+  uint32_t conn_ms;      /* connect() issued */
+  uint32_t t0_us;        /* For the send-to-ack latency */
+  uint32_t rxlen;        /* Bytes received during the exchange */
+  uint32_t last_tx_ms;   /* MQTT keep-alive / reconnect pacing */
+  struct mmwave_data_s data;  /* HA_OP_STATE: what is delivered */
+  union
+  {
+    struct ha_http_resp_s http;
+    struct ha_mqtt_rx_s mqtt;  /* Kept for the whole connection */
+    struct ha_ws_hs_s ws_hs;
+  } rx;
+};
+
+/*
+ * A reporting backend. The session engine, the retry queue and `hactl
+ * push` only go through these, so REST, MQTT and WebSocket share
+ * everything but the wire protocol.
+ */
+
+struct ha_backend_s
+{
+  FAR const char *name;
+
+  /* Send what the exchange needs next on the open connection: the
+   * login's next message, then its request. OK when no reply is
+   * needed, -EINPROGRESS when one is awaited, or a negative errno.
+   */
+
+  CODE int  (*send)(FAR struct ha_session_s *s);
+
+  /* Bytes from the server (len 0: it closed). OK once the exchange is
+   * acknowledged, -EINPROGRESS, or a negative errno.
+   */
+
+  CODE int  (*recv)(FAR struct ha_session_s *s, FAR const uint8_t *buf,
+                    size_t len);
+
+  /* Between exchanges: the keep-alive or reconnect due, if any (may be
+   * NULL)
+   */
+
+  CODE uint8_t (*idle)(FAR struct ha_session_s *s, uint32_t now);
+
+  /* Drop the connection; offline: reporting is ending for good */
+
+  CODE void (*close)(FAR struct ha_session_s *s, bool offline);
+
+#ifdef CONFIG_HACTL_JOURNAL
+  uint8_t   journal_max;                 /* Records per batch */
+#endif
+};
+
+/* The HA host's address, looked up once by the ha_resolve task */
+
+struct ha_resolve_s
+{
+  char           host[HA_MAX_URL_LEN];  /* Name looked up */
+  struct in_addr addr;
+  int            ret;    /* The lookup's result, set before done */
+  bool           valid;  /* addr belongs to host */
+  bool           busy;   /* The task runs */
+  bool           init;   /* done is initialised */
+  sem_t          done;
+};
+
+#ifdef CONFIG_HACTL_JOURNAL
+/* The journal batch being replayed, rendered twice (size, then send) */
+
+struct ha_replay_s
+{
+  struct ha_journal_rec_s recs[HA_JOURNAL_REPLAY_MAX];
+  int      n;
+  uint32_t seq;          /* First record's sequence number */
+  uint32_t now;          /* time() when the batch was taken */
 };
+#endif
+
+#ifdef CONFIG_HACTL_TLS
+/*
+ * The one TLS connection: the reporting session's, or the one `hactl
+ * push` or `test` opens while reporting is off. Configuration and the
+ * random generator are set up once per boot; the session is kept
+ * across connections for resumption.
+ */
+
+struct ha_tls_s
+{
+  mbedtls_ssl_context      ssl;
+  mbedtls_ssl_config       conf;
+  mbedtls_entropy_context  entropy;
+  mbedtls_ctr_drbg_context drbg;
+  mbedtls_x509_crt         ca;
+  mbedtls_ssl_session      session;  /* Saved for resumption */
+  bool                     ready;    /* conf and drbg set up */
+  bool                     verify;   /* Server chain checked */
+  bool                     active;   /* ssl runs on fd */
+  bool                     handshaking;
+  bool                     want_write; /* Handshake waits to send */
+  bool                     offered;  /* Resumption offered */
+  uint8_t                  idlen;
+  unsigned char            id[32];   /* Session ID offered */
+  uint32_t                 t0_us;    /* Handshake start */
+  int                      fd;
+  size_t                   txlen;    /* Bytes staged in g_tls_tx */
+};
+#endif
+
+/* Syslog sink: one line per change, flapping folded into a count */
+
+struct ha_log_sink_s
+{
+  struct mmwave_data_s last;
+  uint32_t folded;       /* Changes since the last line */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int      ha_report_start(void);
+static void     ha_report_frame(FAR const struct mmwave_eng_data_s *eng,
+                                bool gates, uint32_t now);
+static void     ha_report_pollset(FAR struct pollfd *pfds);
+static int      ha_report_events(FAR const struct pollfd *pfds,
+                                 uint32_t now);
+static uint32_t ha_report_tick(uint32_t now);
+static void     ha_report_stop(void);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct ha_config_s g_ha_config;
+static volatile bool g_reporting = false;
+static volatile bool g_push_requested = false;
+static volatile bool g_config_changed = false;
+static bool g_config_migrated = false;
+static struct ha_fanout_s g_fanout;    /* Single sensor reader, all sinks */
+static struct ha_session_s g_session;  /* HA sink's connection */
+static struct ha_resolve_s g_resolve;
+static bool g_ha_closing;              /* Stopping: start no exchange */
+static struct ha_sink_s g_ha_sink;
+#ifdef CONFIG_HACTL_SINK_LOG
+static struct ha_log_sink_s g_log;
+static struct ha_sink_s g_log_sink;
+#endif
+static pid_t g_report_pid = -1;
+static struct ha_queue_s g_ha_queue;   /* Transitions awaiting a post */
+static uint32_t g_ha_unsent;           /* As last told to the driver */
+static struct ha_request_s g_ha_request; /* State POST header block */
+#ifdef CONFIG_HACTL_JOURNAL
+static struct ha_request_s g_ha_journal_request;  /* Journal event POST */
+static struct ha_journal_s g_journal;  /* Transitions HA has not seen */
+static struct ha_replay_s g_replay;
+#endif
+static struct ha_stats_s g_ha_stats;
+static char g_mqtt_state_topic[HA_MQTT_TOPIC_MAX];
+static char g_mqtt_status_topic[HA_MQTT_TOPIC_MAX];
+static uint8_t g_mqtt_buf[HA_MQTT_CONNECT_MAX];  /* CONNECT, headers */
+static uint8_t g_ws_frame[HA_WS_FRAME_MAX];      /* Handshake, frames */
+static struct ha_ws_conn_s g_ws;
+#ifdef CONFIG_HACTL_TLS
+static struct ha_tls_s g_tls;
+static struct ha_tls_cache_s g_tls_cache;
+static struct ha_tls_stats_s g_tls_stats;
+static uint8_t g_tls_tx[HA_TLS_TX_MAX];          /* One record's plaintext */
+#endif
+
+static FAR const char * const g_backend_names[HA_BACKEND_COUNT] =
+{
+  "rest", "mqtt", "ws"
+};
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* Auto-reporting, run by the ha_report task or hosted by mmwaved. No
+ * callback waits on HA: the session's socket is polled with the rest.
+ */
+
+const struct mmwave_service_s g_hactl_service =
+{
+  "hactl", &g_reporting, 1, HA_REPORT_STACK,
+  ha_report_start, ha_report_pollset, ha_report_events, ha_report_frame,
+  ha_report_tick, ha_report_stop
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/**
+ * Backend id for a name in the ha.backend key or on the command line, or -1.
+ */
+
+static int ha_backend_parse(FAR const char *name)
+{
+  for (int i = 0; i < HA_BACKEND_COUNT; i++)
+    {
+      if (strcmp(name, g_backend_names[i]) == 0)
+        {
+          return i;
+        }
+    }
+
+  return -1;
+}
+
+/**
+ * Render the static request headers and MQTT topics for the current
+ * config.
+ */
+
+static void ha_build_request(void)
+{
+  if (ha_request_init(&g_ha_request, HA_ENTITY_ID, g_ha_config.url,
+                      g_ha_config.port, g_ha_config.token) < 0)
+    {
+      fprintf(stderr, "hactl: request headers exceed %d bytes\n",
+              HA_REQUEST_HDR_MAX);
+    }
+
+#ifdef CONFIG_HACTL_JOURNAL
+  ha_request_init_path(&g_ha_journal_request,
+                       "/api/events/" HA_JOURNAL_EVENT_TYPE,
+                       g_ha_config.url, g_ha_config.port, g_ha_config.token);
+#endif
+
+  if (!ha_mqtt_node_valid(g_ha_config.node))
+    {
+      strcpy(g_ha_config.node, HA_MQTT_DEFAULT_NODE);
+    }
+
+  ha_mqtt_node_topic(g_mqtt_state_topic, HA_MQTT_TOPIC_MAX,
+                     g_ha_config.node, "state");
+  ha_mqtt_node_topic(g_mqtt_status_topic, HA_MQTT_TOPIC_MAX,
+                     g_ha_config.node, "status");
+}
+
+/**
+ * Save HA config as ha.* keys of the config service: the ones that
+ * changed, in one transaction.
+ */
+
+static int ha_save_config(void)
+{
+  char port[8];
+  char interval[8];
+  char mqtt_port[8];
+  char cur[CFG_VAL_MAX + 1];
+  FAR const char *kv[] =
+  {
+    "ha.url",        g_ha_config.url,
+    "ha.port",       port,
+    "ha.token",      g_ha_config.token,
+    "ha.interval",   interval,
+    "ha.backend",    g_backend_names[g_ha_config.backend],
+    "ha.mqtt_host",  g_ha_config.mqtt_host,
+    "ha.mqtt_port",  mqtt_port,
+    "ha.mqtt_qos",   g_ha_config.mqtt_qos1 ? "1" : "0",
+    "ha.mqtt_user",  g_ha_config.mqtt_user,
+    "ha.mqtt_pass",  g_ha_config.mqtt_pass,
+    "ha.node",       g_ha_config.node,
+    "ha.tls",        g_ha_config.tls ? "1" : "0",
+    "ha.tls_verify", g_ha_config.tls_verify ? "1" : "0",
+  };
+
+  int npairs = 0;
+
+  snprintf(port, sizeof(port), "%u", g_ha_config.port);
+  snprintf(interval, sizeof(interval), "%u",
+           g_ha_config.report_interval_ms);
+  snprintf(mqtt_port, sizeof(mqtt_port), "%u", g_ha_config.mqtt_port);
+
+  for (size_t i = 0; i < sizeof(kv) / sizeof(kv[0]); i += 2)
+    {
+      if (config_svc_get(kv[i], cur, sizeof(cur)) < 0 ||
+          strcmp(cur, kv[i + 1]) != 0)
+        {
+          kv[2 * npairs]     = kv[i];
+          kv[2 * npairs + 1] = kv[i + 1];
+          npairs++;
+        }
+    }
+
+  return npairs > 0 ? config_svc_set_many(kv, npairs) : OK;
+}
+
+/**
+ * Settings kept in /config/ha.conf by earlier versions: parsed over the
+ * defaults once, saved to the config service, and the file removed.
+ */
+
+static void ha_migrate_config(void)
+{
+  FILE *f = fopen(HA_CONFIG_FILE, "r");
+  if (f == NULL)
+    {
+      return;
+    }
+
+  char line[384];
+  while (fgets(line, sizeof(line), f) != NULL)
+    {
+      char *eq = strchr(line, '=');
+      if (eq == NULL) continue;
+      *eq = '\0';
+      char *val = eq + 1;
+
+      /* Trim trailing newline */
+
+      size_t vlen = strlen(val);
+      if (vlen > 0 && val[vlen - 1] == '\n') val[vlen - 1] = '\0';
+
+      if (strcmp(line, "url") == 0)
+        {
+          strncpy(g_ha_config.url, val, HA_MAX_URL_LEN - 1);
+        }
+      else if (strcmp(line, "port") == 0)
+        {
+          g_ha_config.port = (uint16_t)atoi(val);
+        }
+      else if (strcmp(line, "token") == 0)
+        {
+          strncpy(g_ha_config.token, val, HA_MAX_TOKEN_LEN - 1);
+        }
+      else if (strcmp(line, "interval") == 0)
+        {
+          g_ha_config.report_interval_ms = (uint16_t)atoi(val);
+        }
+      else if (strcmp(line, "backend") == 0)
+        {
+          int id = ha_backend_parse(val);
+          g_ha_config.backend = id < 0 ? HA_BACKEND_REST : id;
+        }
+      else if (strcmp(line, "mqtt_host") == 0)
+        {
+          strncpy(g_ha_config.mqtt_host, val, HA_MAX_URL_LEN - 1);
+        }
+      else if (strcmp(line, "mqtt_port") == 0)
+        {
+          g_ha_config.mqtt_port = (uint16_t)atoi(val);
+        }
+      else if (strcmp(line, "mqtt_qos") == 0)
+        {
+          g_ha_config.mqtt_qos1 = atoi(val) != 0;
+        }
+      else if (strcmp(line, "mqtt_user") == 0)
+        {
+          strncpy(g_ha_config.mqtt_user, val, HA_MAX_CRED_LEN - 1);
+        }
+      else if (strcmp(line, "mqtt_pass") == 0)
+        {
+          strncpy(g_ha_config.mqtt_pass, val, HA_MAX_CRED_LEN - 1);
+        }
+      else if (strcmp(line, "node") == 0)
+        {
+          strncpy(g_ha_config.node, val, HA_MQTT_NODE_MAX - 1);
+        }
+      else if (strcmp(line, "tls") == 0)
+        {
+          g_ha_config.tls = atoi(val) != 0;
+        }
+      else if (strcmp(line, "tls_verify") == 0)
+        {
+          g_ha_config.tls_verify = atoi(val) != 0;
+        }
+    }
+
+  fclose(f);
+
+  if (ha_save_config() == OK)
+    {
+      unlink(HA_CONFIG_FILE);
+      printf("hactl: moved %s into %s\n", HA_CONFIG_FILE, CFG_STORE_PATH);
+    }
+}
+
+/**
+ * Load HA config from the config service: RAM only, no file is read.
+ */
+
+static int ha_load_config(void)
+{
+  char backend[16];
+  int id;
+
+  config_svc_get_str("ha.url", g_ha_config.url, HA_MAX_URL_LEN, "");
+  g_ha_config.port = (uint16_t)config_svc_get_int("ha.port",
+                                                  HA_DEFAULT_PORT);
+  config_svc_get_str("ha.token", g_ha_config.token, HA_MAX_TOKEN_LEN, "");
+  g_ha_config.report_interval_ms =
+    (uint16_t)config_svc_get_int("ha.interval", 500);
+
+  id = ha_backend_parse(config_svc_get_str("ha.backend", backend,
+                                           sizeof(backend), "rest"));
+  g_ha_config.backend = id < 0 ? HA_BACKEND_REST : id;
+
+  config_svc_get_str("ha.mqtt_host", g_ha_config.mqtt_host,
+                     HA_MAX_URL_LEN, "");
+  g_ha_config.mqtt_port = (uint16_t)config_svc_get_int("ha.mqtt_port",
+                                                       HA_MQTT_DEFAULT_PORT);
+  g_ha_config.mqtt_qos1 = config_svc_get_bool("ha.mqtt_qos", true);
+  config_svc_get_str("ha.mqtt_user", g_ha_config.mqtt_user,
+                     HA_MAX_CRED_LEN, "");
+  config_svc_get_str("ha.mqtt_pass", g_ha_config.mqtt_pass,
+                     HA_MAX_CRED_LEN, "");
+  config_svc_get_str("ha.node", g_ha_config.node, HA_MQTT_NODE_MAX,
+                     HA_MQTT_DEFAULT_NODE);
+  g_ha_config.tls        = config_svc_get_bool("ha.tls", false);
+  g_ha_config.tls_verify = config_svc_get_bool("ha.tls_verify", true);
+
+  if (!g_config_migrated)
+    {
+      g_config_migrated = true;
+      ha_migrate_config();
+    }
+
+  ha_build_request();
+  return g_ha_config.url[0] != '\0' || g_ha_config.mqtt_host[0] != '\0' ?
+         OK : -ENOENT;
+}
+
+/* Any ha.* write, from hactl or `config set`: reload between reports */
+
+static void ha_config_changed(FAR const char *key, FAR const char *val,
+                              FAR void *arg)
+{
+  g_config_changed = true;
+}
+
+/* ---- TLS ---- */
+
+#ifdef CONFIG_HACTL_TLS
+static int ha_tls_bio_send(FAR void *ctx, FAR const unsigned char *buf,
+                           size_t len)
+{
+  ssize_t n = send(*(FAR int *)ctx, buf, len, 0);
+
+  if (n < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK ?
+             MBEDTLS_ERR_SSL_WANT_WRITE : MBEDTLS_ERR_NET_SEND_FAILED;
+    }
+
+  return n;
+}
+
+static int ha_tls_bio_recv(FAR void *ctx, FAR unsigned char *buf,
+                           size_t len)
+{
+  ssize_t n = recv(*(FAR int *)ctx, buf, len, 0);
+
+  if (n < 0)
+    {
+      /* Nothing in yet: the socket never blocks, poll() says when */
+
+      return errno == EAGAIN || errno == EWOULDBLOCK ?
+             MBEDTLS_ERR_SSL_WANT_READ : MBEDTLS_ERR_NET_RECV_FAILED;
+    }
+
+  return n;
+}
+
+/**
+ * Once per boot: seed the generator and build the client configuration.
+ * The server certificate is checked against HA_TLS_CA_FILE; without
+ * that file only `hactl tls on noverify` connects.
+ */
+
+static int ha_tls_setup(void)
+{
+  FAR struct ha_tls_s *t = &g_tls;
+  int ret;
+
+  if (t->ready)
+    {
+      return OK;
+    }
+
+  mbedtls_ssl_config_init(&t->conf);
+  mbedtls_entropy_init(&t->entropy);
+  mbedtls_ctr_drbg_init(&t->drbg);
+  mbedtls_x509_crt_init(&t->ca);
+  mbedtls_ssl_session_init(&t->session);
+  ha_tls_cache_init(&g_tls_cache, CONFIG_HACTL_TLS_SESSION_S * 1000u);
+
+  ret = mbedtls_ctr_drbg_seed(&t->drbg, mbedtls_entropy_func, &t->entropy,
+                              (FAR const unsigned char *)"hactl", 5);
+  if (ret == 0)
+    {
+      ret = mbedtls_ssl_config_defaults(&t->conf, MBEDTLS_SSL_IS_CLIENT,
+                                        MBEDTLS_SSL_TRANSPORT_STREAM,
+                                        MBEDTLS_SSL_PRESET_DEFAULT);
+    }
+
+  if (ret != 0)
+    {
+      syslog(LOG_ERR, "hactl: TLS setup failed: -0x%04x\n", -ret);
+      ret = -ENOMEM;
+    }
+  else if (mbedtls_x509_crt_parse_file(&t->ca, HA_TLS_CA_FILE) == 0)
+    {
+      mbedtls_ssl_conf_ca_chain(&t->conf, &t->ca, NULL);
+      mbedtls_ssl_conf_authmode(&t->conf, MBEDTLS_SSL_VERIFY_REQUIRED);
+      t->verify = true;
+    }
+  else if (!g_ha_config.tls_verify)
+    {
+      mbedtls_ssl_conf_authmode(&t->conf, MBEDTLS_SSL_VERIFY_NONE);
+    }
+  else
+    {
+      fprintf(stderr, "hactl: no CA certificate in %s\n", HA_TLS_CA_FILE);
+      ret = -ENOENT;
+    }
+
+  if (ret < 0)
+    {
+      mbedtls_x509_crt_free(&t->ca);
+      mbedtls_ctr_drbg_free(&t->drbg);
+      mbedtls_entropy_free(&t->entropy);
+      mbedtls_ssl_config_free(&t->conf);
+      return ret;
+    }
+
+  mbedtls_ssl_conf_rng(&t->conf, mbedtls_ctr_drbg_random, &t->drbg);
+
+  /* TLS 1.2: the ticket or session ID comes within the handshake, so
+   * the session can be saved as soon as it completes, and resuming it
+   * skips the key exchange and the certificate chain altogether.
+   */
+
+  mbedtls_ssl_conf_max_tls_version(&t->conf, MBEDTLS_SSL_VERSION_TLS1_2);
+  mbedtls_ssl_conf_session_tickets(&t->conf,
+                                   MBEDTLS_SSL_SESSION_TICKETS_ENABLED);
+  t->ready = true;
+  return OK;
+}
+
+/**
+ * Start a handshake on a connected socket, offering the saved session
+ * while it is young enough; ha_tls_handshake() carries it on.
+ */
+
+static int ha_tls_start(int sockfd, FAR const char *host)
+{
+  FAR struct ha_tls_s *t = &g_tls;
+  int ret;
+
+  if (t->active || t->handshaking)
+    {
+      return -EBUSY;
+    }
+
+  ret = ha_tls_setup();
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  t->fd    = sockfd;
+  t->txlen = 0;
+  mbedtls_ssl_init(&t->ssl);
+  ret = mbedtls_ssl_setup(&t->ssl, &t->conf);
+  if (ret == 0)
+    {
+      ret = mbedtls_ssl_set_hostname(&t->ssl, host);
+    }
+
+  if (ret != 0)
+    {
+      mbedtls_ssl_free(&t->ssl);
+      return -ENOMEM;
+    }
+
+  mbedtls_ssl_set_bio(&t->ssl, &t->fd, ha_tls_bio_send, ha_tls_bio_recv,
+                      NULL);
+
+  t->idlen   = 0;
+  t->offered = ha_tls_offer(&g_tls_cache, mmwave_service_now_ms()) &&
+               mbedtls_ssl_set_session(&t->ssl, &t->session) == 0;
+  if (t->offered)
+    {
+      size_t idlen = mbedtls_ssl_session_get_id_len(&t->session);
+
+      t->idlen = idlen < sizeof(t->id) ? idlen : sizeof(t->id);
+      memcpy(t->id, mbedtls_ssl_session_get_id(&t->session), t->idlen);
+    }
+
+  t->handshaking = true;
+  t->want_write  = false;
+  t->t0_us       = (uint32_t)mmwave_service_now_us();
+  return OK;
+}
+
+/**
+ * Take the handshake as far as the bytes already in allow. Returns
+ * -EINPROGRESS until it is done (want_write: until the socket takes
+ * more), then OK or a negative errno. A session ID echoed back
+ * unchanged means the server resumed it; either way the session it
+ * ends with is kept for next time.
+ */
+
+static int ha_tls_handshake(void)
+{
+  FAR struct ha_tls_s *t = &g_tls;
+  uint32_t ms;
+  bool saved;
+  bool resumed;
+  int ret;
+
+  ret = mbedtls_ssl_handshake(&t->ssl);
+  if (ret == MBEDTLS_ERR_SSL_WANT_READ ||
+      ret == MBEDTLS_ERR_SSL_WANT_WRITE)
+    {
+      t->want_write = ret == MBEDTLS_ERR_SSL_WANT_WRITE;
+      return -EINPROGRESS;
+    }
+
+  ms = ((uint32_t)mmwave_service_now_us() - t->t0_us) / 1000;
+  t->handshaking = false;
+
+  if (ret != 0)
+    {
+      ha_tls_failed(&g_tls_cache, &g_tls_stats, t->offered);
+      syslog(LOG_WARNING, "hactl: TLS handshake failed: -0x%04x\n", -ret);
+      mbedtls_ssl_free(&t->ssl);
+      return -ECONNABORTED;
+    }
+
+  mbedtls_ssl_session_free(&t->session);
+  mbedtls_ssl_session_init(&t->session);
+  saved = mbedtls_ssl_get_session(&t->ssl, &t->session) == 0;
+
+  resumed = t->offered && saved && t->idlen > 0 &&
+            mbedtls_ssl_session_get_id_len(&t->session) == t->idlen &&
+            memcmp(mbedtls_ssl_session_get_id(&t->session), t->id,
+                   t->idlen) == 0;
+
+  ha_tls_done(&g_tls_cache, &g_tls_stats, t->offered, resumed, ms,
+              mmwave_service_now_ms());
+  if (!saved)
+    {
+      g_tls_cache.valid = false;
+    }
+
+  t->active = true;
+  return OK;
+}
+
+/* All of buf as records. Like a plain send, a socket that cannot take
+ * it now fails the write (EAGAIN) rather than being waited for.
+ */
+
+static ssize_t ha_tls_write(FAR const uint8_t *buf, size_t len)
+{
+  size_t done = 0;
+
+  while (done < len)
+    {
+      int ret = mbedtls_ssl_write(&g_tls.ssl, buf + done, len - done);
+
+      if (ret < 0)
+        {
+          errno = ret == MBEDTLS_ERR_SSL_WANT_READ ||
+                  ret == MBEDTLS_ERR_SSL_WANT_WRITE ? EAGAIN : EIO;
+          return done > 0 ? (ssize_t)done : -1;
+        }
+
+      done += ret;
+    }
+
+  return done;
+}
+#endif
+
+/* recv() on a reporting connection, through TLS when it has it */
+
+static ssize_t ha_io_recv(int fd, FAR void *buf, size_t len)
+{
+#ifdef CONFIG_HACTL_TLS
+  if (g_tls.active && fd == g_tls.fd)
+    {
+      int ret = mbedtls_ssl_read(&g_tls.ssl, buf, len);
+
+      if (ret >= 0)
+        {
+          return ret;
+        }
+
+      if (ret == MBEDTLS_ERR_SSL_PEER_CLOSE_NOTIFY)
+        {
+          return 0;
+        }
+
+      /* No whole record yet: as a plain socket with nothing to read */
+
+      errno = ret == MBEDTLS_ERR_SSL_WANT_READ ||
+              ret == MBEDTLS_ERR_SSL_WANT_WRITE ? EAGAIN : ECONNRESET;
+      return -1;
+    }
+#endif
+
+  return recv(fd, buf, len, 0);
+}
+
+/**
+ * writev() on a reporting connection. Over TLS the pieces are joined
+ * into one record when they fit, which saves a record header, nonce and
+ * tag per piece and usually a TCP segment.
+ */
+
+static ssize_t ha_io_writev(int fd, FAR const struct iovec *iov,
+                            int iovcnt)
+{
+#ifdef CONFIG_HACTL_TLS
+  if (g_tls.active && fd == g_tls.fd)
+    {
+      ssize_t len = ha_tls_gather(iov, iovcnt, g_tls_tx, sizeof(g_tls_tx));
+      ssize_t total = 0;
+
+      if (len >= 0)
+        {
+          return ha_tls_write(g_tls_tx, len);
+        }
+
+      for (int i = 0; i < iovcnt; i++)
+        {
+          ssize_t n = ha_tls_write(iov[i].iov_base, iov[i].iov_len);
+
+          if (n < 0)
+            {
+              return total > 0 ? total : n;
+            }
+
+          total += n;
+        }
+
+      return total;
+    }
+#endif
+
+  return writev(fd, iov, iovcnt);
+}
+
+/**
+ * json_sink_t for documents streamed to a reporting connection. Over
+ * TLS the writer's small chunks are staged and go out in full records;
+ * ha_io_flush() sends the rest.
+ */
+
+static int ha_io_json_sink(FAR void *arg, FAR const char *buf, size_t len)
+{
+#ifdef CONFIG_HACTL_TLS
+  if (g_tls.active && (int)(intptr_t)arg == g_tls.fd)
+    {
+      while (len > 0)
+        {
+          size_t room = sizeof(g_tls_tx) - g_tls.txlen;
+          size_t n = len < room ? len : room;
+
+          memcpy(g_tls_tx + g_tls.txlen, buf, n);
+          g_tls.txlen += n;
+          buf += n;
+          len -= n;
+
+          if (g_tls.txlen == sizeof(g_tls_tx))
+            {
+              if (ha_tls_write(g_tls_tx, g_tls.txlen) !=
+                  (ssize_t)g_tls.txlen)
+                {
+                  g_tls.txlen = 0;
+                  return -EIO;
+                }
+
+              g_tls.txlen = 0;
+            }
+        }
+
+      return OK;
+    }
+#endif
+
+  return json_sink_fd(arg, buf, len);
+}
+
+static int ha_io_flush(int fd)
+{
+#ifdef CONFIG_HACTL_TLS
+  if (g_tls.active && fd == g_tls.fd && g_tls.txlen > 0)
+    {
+      size_t len = g_tls.txlen;
+
+      g_tls.txlen = 0;
+      return ha_tls_write(g_tls_tx, len) == (ssize_t)len ? OK : -EIO;
+    }
+#endif
+
+  return OK;
+}
+
+/* Close a reporting connection, saying goodbye to TLS first */
+
+static void ha_disconnect(int fd)
+{
+#ifdef CONFIG_HACTL_TLS
+  if (g_tls.handshaking && fd == g_tls.fd)
+    {
+      ha_tls_failed(&g_tls_cache, &g_tls_stats, g_tls.offered);
+      mbedtls_ssl_free(&g_tls.ssl);
+      g_tls.handshaking = false;
+    }
+  else if (g_tls.active && fd == g_tls.fd)
+    {
+      mbedtls_ssl_close_notify(&g_tls.ssl);
+      mbedtls_ssl_free(&g_tls.ssl);
+      g_tls.active = false;
+    }
+#endif
+
+  close(fd);
+}
+
+/* The MQTT broker: ha.mqtt_host, or the HA host when it is not set */
+
+static FAR const char *ha_mqtt_host(void)
+{
+  return g_ha_config.mqtt_host[0] != '\0' ? g_ha_config.mqtt_host :
+                                            g_ha_config.url;
+}
+
+/**
+ * writev() a complete packet/frame on the session, counting the bytes
+ * and stamping the time for the keep-alive logic. The socket never
+ * blocks: a message is far smaller than its send buffer, so one that
+ * does not go out whole means the connection is dead.
+ */
+
+static int ha_send(FAR struct ha_session_s *s,
+                   FAR const struct iovec *iov, int iovcnt)
+{
+  size_t total = 0;
+
+  for (int i = 0; i < iovcnt; i++)
+    {
+      total += iov[i].iov_len;
+    }
+
+  ssize_t sent = ha_io_writev(s->sockfd, iov, iovcnt);
+  if (sent > 0)
+    {
+      g_ha_stats.tx_bytes += sent;
+    }
+
+  if (sent != (ssize_t)total)
+    {
+      return sent < 0 ? -errno : -EIO;
+    }
+
+  s->last_tx_ms = mmwave_service_now_ms();
+  return OK;
+}
+
+#ifdef CONFIG_HACTL_JOURNAL
+/* The replay batch as a JSON object: REST body and MQTT payload */
+
+static void ha_replay_json(FAR struct json_writer_s *w)
+{
+  json_begin_object(w, NULL);
+  ha_journal_json(w, g_ha_config.node, g_replay.seq, g_replay.now,
+                  g_replay.recs, g_replay.n);
+  json_end_object(w);
+}
+
+static int ha_replay_len(void)
+{
+  struct json_writer_s w;
+
+  json_init(&w, json_sink_count, NULL);
+  ha_replay_json(&w);
+  return json_finish(&w);
+}
+
+/* Stream the replay batch to the session after its header was sent */
+
+static int ha_replay_send(FAR struct ha_session_s *s)
+{
+  struct json_writer_s w;
+  int ret;
+
+  json_init(&w, ha_io_json_sink, (FAR void *)(intptr_t)s->sockfd);
+  ha_replay_json(&w);
+  ret = json_finish(&w);
+  if (ret >= 0 && ha_io_flush(s->sockfd) < 0)
+    {
+      ret = -EIO;
+    }
+
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  g_ha_stats.tx_bytes += ret;
+  s->last_tx_ms = mmwave_service_now_ms();
+  return OK;
+}
+#endif
+
+/* ---- Name resolution ---- */
+
+/* The ha_resolve task: one gethostbyname(), which may wait on DNS */
+
+static int ha_resolve_task(int argc, FAR char *argv[])
+{
+  FAR struct ha_resolve_s *r = &g_resolve;
+  FAR struct hostent *he = gethostbyname(r->host);
+
+  if (he != NULL && he->h_length == sizeof(r->addr))
+    {
+      memcpy(&r->addr, he->h_addr_list[0], sizeof(r->addr));
+      r->ret = OK;
+    }
+  else
+    {
+      r->ret = -ENOENT;
+    }
+
+  sem_post(&r->done);
+  return OK;
+}
+
+/**
+ * The address of `host`: at once for a literal or a name looked up
+ * before, else -EINPROGRESS while the ha_resolve task looks it up (ask
+ * again), or the lookup's error. A name is looked up again only when
+ * it changes or connecting to its address failed.
+ */
+
+static int ha_resolve(FAR const char *host, FAR struct in_addr *addr)
+{
+  FAR struct ha_resolve_s *r = &g_resolve;
+
+  if (inet_pton(AF_INET, host, addr) > 0)
+    {
+      return OK;
+    }
+
+  if (r->busy)
+    {
+      if (sem_trywait(&r->done) < 0)
+        {
+          return -EINPROGRESS;
+        }
+
+      r->busy  = false;
+      r->valid = r->ret == OK;
+      if (!r->valid && strcmp(r->host, host) == 0)
+        {
+          return r->ret;
+        }
+    }
+
+  if (r->valid && strcmp(r->host, host) == 0)
+    {
+      *addr = r->addr;
+      return OK;
+    }
+
+  if (!r->init)
+    {
+      sem_init(&r->done, 0, 0);
+      r->init = true;
+    }
+
+  strlcpy(r->host, host, sizeof(r->host));
+  r->valid = false;
+  r->busy  = true;
+  if (task_create("ha_resolve", 100, HA_RESOLVE_STACK, ha_resolve_task,
+                  NULL) < 0)
+    {
+      r->busy = false;
+      return -errno;
+    }
+
+  return -EINPROGRESS;
+}
+
+/* The address did not answer: look the name up again next time */
+
+static void ha_resolve_forget(void)
+{
+  if (!g_resolve.busy)
+    {
+      g_resolve.valid = false;
+    }
+}
+
+/* ---- Session helpers for the backends ---- */
+
+/* Close the connection, in whatever state it is */
+
+static void ha_session_drop(FAR struct ha_session_s *s)
+{
+  if (s->sockfd >= 0)
+    {
+      ha_disconnect(s->sockfd);
+      s->sockfd = -1;
+    }
+
+  s->conn    = HA_CONN_CLOSED;
+  s->step    = 0;
+  s->waiting = false;
+}
+
+/* The exchange goes on until a reply of `type` carrying `id` is in */
+
+static int ha_session_await(FAR struct ha_session_s *s, uint8_t type,
+                            uint32_t id)
+{
+  s->waiting    = true;
+  s->await_type = type;
+  s->await      = id;
+  return -EINPROGRESS;
+}
+
+/* ---- REST backend ---- */
+
+/**
+ * POST /api/states/<entity_id> with the state in s->data. Headers come
+ * from the prebuilt template; only the body is rendered per post, and
+ * both go out in one writev() without being joined.
+ */
+
+static int ha_rest_post_state(FAR struct ha_session_s *s)
+{
+  char body[HA_BODY_BUF_SIZE];
+  struct iovec iov[2];
+  int bodylen;
+
+  bodylen = ha_format_state_json(body, sizeof(body), &s->data);
+  if (bodylen < 0 || ha_request_set_length(&g_ha_request, bodylen) < 0)
+    {
+      return -E2BIG;
+    }
+
+  iov[0].iov_base = g_ha_request.buf;
+  iov[0].iov_len  = g_ha_request.len;
+  iov[1].iov_base = body;
+  iov[1].iov_len  = bodylen;
+  return ha_send(s, iov, 2);
+}
+
+#ifdef CONFIG_HACTL_JOURNAL
+/* The whole batch as one event: POST /api/events/mmwave_journal */
+
+static int ha_rest_post_journal(FAR struct ha_session_s *s)
+{
+  struct iovec iov;
+  int len = ha_replay_len();
+  int ret;
+
+  if (len < 0 || ha_request_set_length(&g_ha_journal_request, len) < 0)
+    {
+      return -E2BIG;
+    }
+
+  iov.iov_base = g_ha_journal_request.buf;
+  iov.iov_len  = g_ha_journal_request.len;
+
+  ret = ha_send(s, &iov, 1);
+  return ret == OK ? ha_replay_send(s) : ret;
+}
+#endif
+
+/* Send the exchange's request; REST has no login and no keep-alive */
+
+static int ha_rest_send(FAR struct ha_session_s *s)
+{
+  int ret;
+
+  switch (s->op)
+    {
+      case HA_OP_STATE:
+        ret = ha_rest_post_state(s);
+        break;
+
+#ifdef CONFIG_HACTL_JOURNAL
+      case HA_OP_JOURNAL:
+        ret = ha_rest_post_journal(s);
+        break;
+#endif
+
+      default:
+        return OK;
+    }
+
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  ha_http_init(&s->rx.http);
+  return ha_session_await(s, 0, 0);
+}
+
+/**
+ * The response, through the incremental parser. Only the status line
+ * and framing headers are examined; the body is drained and discarded
+ * so the connection can carry the next request. If the server
+ * announced it will close, the headers are enough.
+ */
+
+static int ha_rest_recv(FAR struct ha_session_s *s,
+                        FAR const uint8_t *buf, size_t len)
+{
+  FAR struct ha_http_resp_s *resp = &s->rx.http;
+  int ret;
+
+  if (!s->waiting)
+    {
+      return len > 0 ? -EINPROGRESS : -ECONNRESET;
+    }
+
+  if (len == 0)
+    {
+      /* Peer closed before sending anything: stale keep-alive */
+
+      if (s->rxlen == 0)
+        {
+          return -ECONNRESET;
+        }
+
+      ret = ha_http_eof(resp);
+    }
+  else
+    {
+      ret = ha_http_feed(resp, (FAR const char *)buf, len);
+    }
+
+  if (ret == HA_HTTP_INVALID)
+    {
+      return -EPROTO;
+    }
+
+  if (ret != HA_HTTP_COMPLETE && (!resp->headers_done || resp->keep_alive))
+    {
+      return -EINPROGRESS;
+    }
+
+  s->waiting = false;
+  if (!resp->keep_alive)
+    {
+      ha_session_drop(s);
+    }
+
+  return ha_http_ok(resp) ? OK : -EIO;
+}
+
+static void ha_rest_close(FAR struct ha_session_s *s, bool offline)
+{
+  ha_session_drop(s);
+}
+
+/* ---- MQTT backend ---- */
+
+/* Login steps: CONNECT, each entity's discovery config, then "online" */
+
+#define HA_MQTT_STEP_DISCOVER   1
+#define HA_MQTT_STEP_ONLINE     (HA_MQTT_STEP_DISCOVER + HA_MQTT_ENTITY_COUNT)
+
+/**
+ * PUBLISH `len` bytes of payload from `payload`, header and payload in
+ * one writev(). With qos1 the exchange goes on until the broker has
+ * acknowledged the message.
+ */
+
+static int ha_mqtt_publish_buf(FAR struct ha_session_s *s,
+                               FAR const char *topic,
+                               FAR const char *payload, size_t len,
+                               bool qos1, bool retain)
+{
+  uint16_t pid = qos1 ? ha_mqtt_next_pid(&s->pid) : 0;
+  int hlen = ha_mqtt_publish_header(g_mqtt_buf, sizeof(g_mqtt_buf), topic,
+                                    len, qos1, retain, pid);
+  if (hlen < 0)
+    {
+      return -E2BIG;
+    }
+
+  struct iovec iov[2];
+  iov[0].iov_base = g_mqtt_buf;
+  iov[0].iov_len  = hlen;
+  iov[1].iov_base = (FAR void *)payload;
+  iov[1].iov_len  = len;
+
+  int ret = ha_send(s, iov, 2);
+  if (ret == OK && qos1)
+    {
+      ret = ha_session_await(s, MQTT_PKT_PUBACK, pid);
+    }
+
+  return ret;
+}
+
+/**
+ * Publish the retained discovery config of one entity. The payload is
+ * sized with a counting pass and then streamed straight to the socket,
+ * so no document-sized buffer is needed on the reporting stack.
+ */
+
+static int ha_mqtt_discover(FAR struct ha_session_s *s,
+                            FAR const struct ha_mqtt_entity_s *e)
+{
+  char topic[HA_MQTT_TOPIC_MAX];
+  struct json_writer_s w;
+  uint16_t pid = ha_mqtt_next_pid(&s->pid);
+  int len;
+  int ret;
+
+  if (ha_mqtt_config_topic(topic, sizeof(topic), g_ha_config.node, e) < 0)
+    {
+      return -E2BIG;
+    }
+
+  json_init(&w, json_sink_count, NULL);
+  ha_mqtt_discovery_json(&w, g_ha_config.node, e);
+  len = json_finish(&w);
+
+  int hlen = ha_mqtt_publish_header(g_mqtt_buf, sizeof(g_mqtt_buf), topic,
+                                    len, true, true, pid);
+  if (hlen < 0)
+    {
+      return -E2BIG;
+    }
+
+  struct iovec iov;
+  iov.iov_base = g_mqtt_buf;
+  iov.iov_len  = hlen;
+
+  ret = ha_send(s, &iov, 1);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  json_init(&w, ha_io_json_sink, (FAR void *)(intptr_t)s->sockfd);
+  ha_mqtt_discovery_json(&w, g_ha_config.node, e);
+  ret = json_finish(&w);
+  if (ret >= 0 && ha_io_flush(s->sockfd) < 0)
+    {
+      ret = -EIO;
+    }
+
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  g_ha_stats.tx_bytes += ret;
+  return ha_session_await(s, MQTT_PKT_PUBACK, pid);
+}
+
+/* CONNECT with a retained "offline" last will */
+
+static int ha_mqtt_connect_send(FAR struct ha_session_s *s)
+{
+  struct ha_mqtt_connect_s c;
+  struct iovec iov;
+  int ret;
+
+  memset(&c, 0, sizeof(c));
+  c.client_id   = g_ha_config.node;
+  c.username    = g_ha_config.mqtt_user;
+  c.password    = g_ha_config.mqtt_pass;
+  c.will_topic  = g_mqtt_status_topic;
+  c.will_msg    = HA_MQTT_OFFLINE;
+  c.will_qos1   = true;
+  c.will_retain = true;
+  c.keepalive_s = HA_MQTT_KEEPALIVE_S;
+
+  ret = ha_mqtt_connect(g_mqtt_buf, sizeof(g_mqtt_buf), &c);
+  if (ret < 0)
+    {
+      return -E2BIG;
+    }
+
+  iov.iov_base = g_mqtt_buf;
+  iov.iov_len  = ret;
+
+  ha_mqtt_rx_init(&s->rx.mqtt);
+  ret = ha_send(s, &iov, 1);
+  return ret == OK ? ha_session_await(s, MQTT_PKT_CONNACK, 0) : ret;
+}
+
+/* The state payload, retained so HA has the current value as soon as it
+ * (re)subscribes
+ */
+
+static int ha_mqtt_publish_state(FAR struct ha_session_s *s)
+{
+  char body[HA_BODY_BUF_SIZE];
+  int bodylen;
+
+  bodylen = ha_mqtt_state_json(body, sizeof(body), &s->data);
+  if (bodylen < 0)
+    {
+      return -E2BIG;
+    }
+
+  return ha_mqtt_publish_buf(s, g_mqtt_state_topic, body, bodylen,
+                             g_ha_config.mqtt_qos1, true);
+}
+
+#ifdef CONFIG_HACTL_JOURNAL
+/* The batch as one QoS 1 message on mmwave/<node>/journal, not retained */
+
+static int ha_mqtt_journal(FAR struct ha_session_s *s)
+{
+  char topic[HA_MQTT_TOPIC_MAX];
+  struct iovec iov;
+  uint16_t pid;
+  int len = ha_replay_len();
+  int ret;
+
+  if (ha_mqtt_node_topic(topic, sizeof(topic), g_ha_config.node,
+                         "journal") < 0 || len < 0)
+    {
+      return -E2BIG;
+    }
+
+  pid = ha_mqtt_next_pid(&s->pid);
+  ret = ha_mqtt_publish_header(g_mqtt_buf, sizeof(g_mqtt_buf), topic, len,
+                               true, false, pid);
+  if (ret < 0)
+    {
+      return -E2BIG;
+    }
+
+  iov.iov_base = g_mqtt_buf;
+  iov.iov_len  = ret;
+
+  ret = ha_send(s, &iov, 1);
+  if (ret == OK)
+    {
+      ret = ha_replay_send(s);
+    }
+
+  return ret == OK ? ha_session_await(s, MQTT_PKT_PUBACK, pid) : ret;
+}
+#endif
+
+/**
+ * Send what the exchange needs next. A new connection logs in first:
+ * CONNECT, then (re)announce every entity and mark the node online, one
+ * acknowledged message per step. Discovery is re-sent on every connect
+ * so a broker restarted without persistence still ends up with the
+ * configs.
+ */
+
+static int ha_mqtt_send(FAR struct ha_session_s *s)
+{
+  struct iovec iov;
+  size_t i;
+  int ret;
+
+  if (s->step < HA_MQTT_STEP_DISCOVER)
+    {
+      return ha_mqtt_connect_send(s);
+    }
+
+  if (s->step < HA_MQTT_STEP_ONLINE)
+    {
+      i = s->step - HA_MQTT_STEP_DISCOVER;
+      return ha_mqtt_discover(s, &g_ha_mqtt_entities[i]);
+    }
+
+  if (s->step == HA_MQTT_STEP_ONLINE)
+    {
+      return ha_mqtt_publish_buf(s, g_mqtt_status_topic, HA_MQTT_ONLINE,
+                                 strlen(HA_MQTT_ONLINE), true, true);
+    }
+
+  switch (s->op)
+    {
+      case HA_OP_STATE:
+        return ha_mqtt_publish_state(s);
+
+#ifdef CONFIG_HACTL_JOURNAL
+      case HA_OP_JOURNAL:
+        return ha_mqtt_journal(s);
+#endif
+
+      case HA_OP_PING:
+        iov.iov_base = g_mqtt_buf;
+        iov.iov_len  = ha_mqtt_simple(g_mqtt_buf, MQTT_PKT_PINGREQ);
+        ret = ha_send(s, &iov, 1);
+        return ret == OK ? ha_session_await(s, MQTT_PKT_PINGRESP, 0) : ret;
+
+      default:
+        return OK;
+    }
+}
+
+/**
+ * Packets from the broker. The awaited ack moves the login on a step or
+ * completes the exchange; anything else the broker sends is skipped.
+ */
+
+static int ha_mqtt_recv(FAR struct ha_session_s *s,
+                        FAR const uint8_t *buf, size_t len)
+{
+  FAR struct ha_mqtt_rx_s *rx = &s->rx.mqtt;
+  int result = -EINPROGRESS;
+  int ret;
+
+  if (len == 0)
+    {
+      return -ECONNRESET;
+    }
+
+  for (size_t off = 0; off < len; )
+    {
+      size_t used;
+
+      ret = ha_mqtt_rx_feed(rx, &buf[off], len - off, &used);
+      off += used;
+      if (ret == HA_MQTT_RX_INVALID)
+        {
+          return -EPROTO;
+        }
+
+      if (ret != HA_MQTT_RX_PACKET || !s->waiting ||
+          ha_mqtt_rx_type(rx) != s->await_type)
+        {
+          continue;
+        }
+
+      if (s->await_type == MQTT_PKT_CONNACK && ha_mqtt_connack_rc(rx) != 0)
+        {
+          return -ECONNREFUSED;
+        }
+
+      if (s->await_type == MQTT_PKT_PUBACK &&
+          ha_mqtt_puback_pid(rx) != (int)s->await)
+        {
+          continue;
+        }
+
+      s->waiting = false;
+      if (s->step == HA_STEP_READY)
+        {
+          result = OK;
+          continue;
+        }
+
+      s->step = s->step == HA_MQTT_STEP_ONLINE ? HA_STEP_READY :
+                                                 s->step + 1;
+      ret = ha_mqtt_send(s);
+      if (ret != -EINPROGRESS)
+        {
+          if (ret < 0)
+            {
+              return ret;
+            }
+
+          result = OK;
+        }
+    }
+
+  return result;
+}
+
+/**
+ * Between state changes: PINGREQ once half the keep-alive has passed
+ * without traffic, and reconnect at the same pace after a drop so
+ * availability goes back to "online" without waiting for the next
+ * presence change. The WebSocket backend keeps the same pace.
+ */
+
+static uint8_t ha_mqtt_idle(FAR struct ha_session_s *s, uint32_t now)
+{
+  if (now - s->last_tx_ms < HA_MQTT_KEEPALIVE_S * 1000 / 2)
+    {
+      return HA_OP_NONE;
+    }
+
+  if (s->conn != HA_CONN_OPEN)
+    {
+      s->last_tx_ms = now;
+      return HA_OP_OPEN;
+    }
+
+  return HA_OP_PING;
+}
+
+/**
+ * A graceful DISCONNECT suppresses the last will, so when reporting
+ * stops for good "offline" is published explicitly first. Neither is
+ * waited for.
+ */
+
+static void ha_mqtt_close(FAR struct ha_session_s *s, bool offline)
+{
+  struct iovec iov;
+
+  if (s->conn == HA_CONN_OPEN && s->step == HA_STEP_READY)
+    {
+      if (offline)
+        {
+          ha_mqtt_publish_buf(s, g_mqtt_status_topic, HA_MQTT_OFFLINE,
+                              strlen(HA_MQTT_OFFLINE), false, true);
+        }
+
+      iov.iov_base = g_mqtt_buf;
+      iov.iov_len  = ha_mqtt_simple(g_mqtt_buf, MQTT_PKT_DISCONNECT);
+      ha_send(s, &iov, 1);
+    }
+
+  ha_session_drop(s);
+}
+
+/* ---- WebSocket backend ---- */
+
+/* Login steps before HA_STEP_READY */
+
+#define HA_WS_STEP_UPGRADE      0   /* Upgrade response awaited */
+#define HA_WS_STEP_REQUIRED     1   /* auth_required awaited */
+#define HA_WS_STEP_AUTH         2   /* auth sent, auth_ok awaited */
+
+static uint32_t ha_ws_random(void)
+{
+  /* xorshift32; masks and nonces need to vary, not to be secret */
+
+  uint32_t x = g_ws.rng != 0 ? g_ws.rng :
+                                (uint32_t)mmwave_service_now_us() | 1;
+
+  x ^= x << 13;
+  x ^= x >> 17;
+  x ^= x << 5;
+  g_ws.rng = x;
+  return x;
+}
+
+/* Send the document `w` has streamed into g_ws_frame as one frame */
+
+static int ha_ws_send_frame(FAR struct ha_session_s *s,
+                            FAR struct ha_ws_frame_s *f,
+                            FAR struct json_writer_s *w)
+{
+  FAR uint8_t *start;
+  struct iovec iov;
+  int len;
+
+  len = ha_ws_frame_text(f, w, &start);
+  if (len < 0)
+    {
+      return -E2BIG;
+    }
+
+  iov.iov_base = start;
+  iov.iov_len  = len;
+  return ha_send(s, &iov, 1);
+}
+
+/* Control frame (ping, pong, close) with a short raw payload */
+
+static int ha_ws_send_control(FAR struct ha_session_s *s, uint8_t opcode,
+                              FAR const void *payload, size_t len)
+{
+  struct ha_ws_frame_s f;
+  FAR uint8_t *start;
+  struct iovec iov;
+
+  ha_ws_frame_init(&f, g_ws_frame, sizeof(g_ws_frame), ha_ws_random());
+  ha_ws_sink(&f, payload, len);
+
+  int n = ha_ws_frame_finish(&f, opcode, &start);
+  if (n < 0)
+    {
+      return -E2BIG;
+    }
+
+  iov.iov_base = start;
+  iov.iov_len  = n;
+  return ha_send(s, &iov, 1);
+}
+
+/* Upgrade the new connection to WebSocket */
+
+static int ha_ws_upgrade(FAR struct ha_session_s *s)
+{
+  struct iovec iov;
+  char key[HA_WS_KEY_LEN + 1];
+  uint32_t nonce[4];
+  int ret;
+
+  ha_ws_rx_init(&g_ws.rx);
+  g_ws.id = 0;
+
+  for (int i = 0; i < 4; i++)
+    {
+      nonce[i] = ha_ws_random();
+    }
+
+  ha_ws_key(key, (FAR const uint8_t *)nonce);
+  ret = ha_ws_handshake((FAR char *)g_ws_frame, sizeof(g_ws_frame),
+                        g_ha_config.url, g_ha_config.port, key);
+  if (ret < 0)
+    {
+      return -E2BIG;
+    }
+
+  iov.iov_base = g_ws_frame;
+  iov.iov_len  = ret;
+  ret = ha_send(s, &iov, 1);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  ha_ws_hs_init(&s->rx.ws_hs, key);
+  return ha_session_await(s, HA_WS_OP_TEXT, 0);
+}
+
+/* auth_required is in: authenticate with the configured token. This is
+ * the whole cost of a (re)connect: afterwards updates carry no
+ * credentials at all.
+ */
+
+static int ha_ws_auth(FAR struct ha_session_s *s)
+{
+  struct ha_ws_frame_s f;
+  struct json_writer_s w;
+  int ret;
+
+  ha_ws_frame_init(&f, g_ws_frame, sizeof(g_ws_frame), ha_ws_random());
+  json_init(&w, ha_ws_sink, &f);
+  ha_ws_auth_json(&w, g_ha_config.token);
+
+  ret = ha_ws_send_frame(s, &f, &w);
+  return ret == OK ? ha_session_await(s, HA_WS_OP_TEXT, 0) : ret;
+}
+
+/* One update as a fire_event command; its result carries the id */
+
+static int ha_ws_publish(FAR struct ha_session_s *s)
+{
+  struct ha_ws_frame_s f;
+  struct json_writer_s w;
+  uint32_t id = ++g_ws.id;
+  int ret;
+
+  ha_ws_frame_init(&f, g_ws_frame, sizeof(g_ws_frame), ha_ws_random());
+  json_init(&w, ha_ws_sink, &f);
+  ha_ws_event_json(&w, id, &s->data);
+
+  ret = ha_ws_send_frame(s, &f, &w);
+  return ret == OK ? ha_session_await(s, HA_WS_OP_TEXT, id) : ret;
+}
+
+#ifdef CONFIG_HACTL_JOURNAL
+/* The batch as a mmwave_journal fire_event */
+
+static int ha_ws_journal(FAR struct ha_session_s *s)
+{
+  struct ha_ws_frame_s f;
+  struct json_writer_s w;
+  uint32_t id = ++g_ws.id;
+  int ret;
+
+  ha_ws_frame_init(&f, g_ws_frame, sizeof(g_ws_frame), ha_ws_random());
+  json_init(&w, ha_ws_sink, &f);
+  json_begin_object(&w, NULL);
+  json_uint(&w, "id", id);
+  json_str(&w, "type", "fire_event");
+  json_str(&w, "event_type", HA_JOURNAL_EVENT_TYPE);
+  json_begin_object(&w, "event_data");
+  ha_journal_json(&w, g_ha_config.node, g_replay.seq, g_replay.now,
+                  g_replay.recs, g_replay.n);
+  json_end_object(&w);
+  json_end_object(&w);
+
+  ret = ha_ws_send_frame(s, &f, &w);
+  return ret == OK ? ha_session_await(s, HA_WS_OP_TEXT, id) : ret;
+}
+#endif
+
+/* Send what the exchange needs next: the upgrade on a new connection,
+ * or its own command once logged in.
+ */
+
+static int ha_ws_send(FAR struct ha_session_s *s)
+{
+  int ret;
+
+  if (s->step == HA_WS_STEP_UPGRADE)
+    {
+      return ha_ws_upgrade(s);
+    }
+
+  switch (s->op)
+    {
+      case HA_OP_STATE:
+        return ha_ws_publish(s);
+
+#ifdef CONFIG_HACTL_JOURNAL
+      case HA_OP_JOURNAL:
+        return ha_ws_journal(s);
+#endif
+
+      case HA_OP_PING:
+        ret = ha_ws_send_control(s, HA_WS_OP_PING, NULL, 0);
+        return ret == OK ? ha_session_await(s, HA_WS_OP_PONG, 0) : ret;
+
+      default:
+        return OK;
+    }
+}
+
+/* A text message: the login's next step, or the result awaited */
+
+static int ha_ws_text(FAR struct ha_session_s *s)
+{
+  switch (s->step)
+    {
+      case HA_WS_STEP_REQUIRED:
+        s->step = HA_WS_STEP_AUTH;
+        return ha_ws_auth(s);
+
+      case HA_WS_STEP_AUTH:
+        if (!ha_ws_msg_has(&g_ws.rx, HA_WS_TYPE("auth_ok")))
+          {
+            fprintf(stderr, "hactl: websocket auth rejected\n");
+            return -EACCES;
+          }
+
+        s->step    = HA_STEP_READY;
+        s->waiting = false;
+        return ha_ws_send(s);
+
+      default:
+        if (!s->waiting || s->await_type != HA_WS_OP_TEXT ||
+            ha_ws_result_id(&g_ws.rx) != (int32_t)s->await)
+          {
+            return -EINPROGRESS;
+          }
+
+        s->waiting = false;
+        return ha_ws_result_ok(&g_ws.rx) ? OK : -EIO;
+    }
+}
+
+/**
+ * Bytes from HA: the upgrade response, then frames. Pings are answered
+ * on the spot and a close frame ends the session.
+ */
+
+static int ha_ws_recv(FAR struct ha_session_s *s,
+                      FAR const uint8_t *buf, size_t len)
+{
+  int result = -EINPROGRESS;
+  size_t off = 0;
+  int ret;
+
+  if (len == 0)
+    {
+      return -ECONNRESET;
+    }
+
+  if (s->step == HA_WS_STEP_UPGRADE)
+    {
+      /* Anything after the response is already frame data */
+
+      ret = ha_ws_hs_feed(&s->rx.ws_hs, (FAR const char *)buf, len, &off);
+      if (ret == HA_WS_MORE)
+        {
+          return -EINPROGRESS;
+        }
+
+      if (ret != HA_WS_DONE)
+        {
+          return -EPROTO;
+        }
+
+      s->step = HA_WS_STEP_REQUIRED;
+    }
+
+  while (off < len)
+    {
+      size_t used;
+
+      ret = ha_ws_rx_feed(&g_ws.rx, &buf[off], len - off, &used);
+      off += used;
+      if (ret == HA_WS_INVALID)
+        {
+          return -EPROTO;
+        }
+
+      if (ret != HA_WS_DONE)
+        {
+          continue;
+        }
+
+      switch (g_ws.rx.opcode)
+        {
+          case HA_WS_OP_TEXT:
+            ret = ha_ws_text(s);
+            if (ret != -EINPROGRESS)
+              {
+                if (ret < 0)
+                  {
+                    return ret;
+                  }
+
+                result = OK;
+              }
+            break;
+
+          case HA_WS_OP_PONG:
+            if (s->waiting && s->await_type == HA_WS_OP_PONG)
+              {
+                s->waiting = false;
+                result = OK;
+              }
+            break;
+
+          case HA_WS_OP_PING:
+            ha_ws_send_control(s, HA_WS_OP_PONG, g_ws.rx.data,
+                               g_ws.rx.pos);
+            break;
+
+          case HA_WS_OP_CLOSE:
+            return -ECONNRESET;
+
+          default:
+            break;
+        }
+    }
+
+  return result;
+}
+
+static void ha_ws_close(FAR struct ha_session_s *s, bool offline)
+{
+  static const uint8_t normal[2] =
+  {
+    0x03, 0xe8  /* 1000: normal closure */
+  };
+
+  if (s->conn == HA_CONN_OPEN && s->step != HA_WS_STEP_UPGRADE)
+    {
+      ha_ws_send_control(s, HA_WS_OP_CLOSE, normal, sizeof(normal));
+    }
+
+  ha_session_drop(s);
+}
+
+static const struct ha_backend_s g_rest_backend =
+{
+  "rest", ha_rest_send, ha_rest_recv, NULL, ha_rest_close,
+#ifdef CONFIG_HACTL_JOURNAL
+  HA_JOURNAL_REPLAY_MAX
+#endif
+};
+
+static const struct ha_backend_s g_mqtt_backend =
+{
+  "mqtt", ha_mqtt_send, ha_mqtt_recv, ha_mqtt_idle, ha_mqtt_close,
+#ifdef CONFIG_HACTL_JOURNAL
+  HA_JOURNAL_REPLAY_MAX
+#endif
+};
+
+static const struct ha_backend_s g_ws_backend =
+{
+  "ws", ha_ws_send, ha_ws_recv, ha_mqtt_idle, ha_ws_close,
+#ifdef CONFIG_HACTL_JOURNAL
+  HA_JOURNAL_WS_MAX
+#endif
+};
+
+static FAR const struct ha_backend_s *ha_backend(void)
+{
+  switch (g_ha_config.backend)
+    {
+      case HA_BACKEND_MQTT:
+        return &g_mqtt_backend;
+
+      case HA_BACKEND_WS:
+        return &g_ws_backend;
+
+      default:
+        return &g_rest_backend;
+    }
+}
+
+static FAR const char *ha_backend_host(void)
+{
+  return g_ha_config.backend == HA_BACKEND_MQTT ? ha_mqtt_host() :
+                                                  g_ha_config.url;
+}
+
+static uint16_t ha_backend_port(void)
+{
+  return g_ha_config.backend == HA_BACKEND_MQTT ?
+         g_ha_config.mqtt_port : g_ha_config.port;
+}
+
+/* The boot's first report reached HA: the end of the boot-to-report
+ * metric in `sysinfo -b`.
+ */
+
+static void ha_first_report(void)
+{
+  int fd = open("/dev/mmwave0", O_RDONLY);
+
+  if (fd >= 0)
+    {
+      ioctl(fd, MMWAVE_IOC_MILESTONE, MMWAVE_MILESTONE_REPORT);
+      close(fd);
+    }
+}
+
+/* Transitions a deep sleep would lose: in RAM only, neither delivered
+ * nor journaled. Once a post has failed the whole queue is journaled,
+ * and the journal's RAM ring goes to flash within JOURNAL_SPILL_S.
+ */
+
+static uint32_t ha_unsent(void)
+{
+#ifdef CONFIG_HACTL_JOURNAL
+  if (g_ha_queue.failures > 0)
+    {
+      return g_journal.ram_count;
+    }
+
+  return g_ha_queue.count + g_journal.ram_count;
+#else
+  return g_ha_queue.count;
+#endif
+}
+
+/* Tell the driver when that changes: the board does not deep sleep
+ * while any are unsent (mmwave_sleep_due()).
+ */
+
+static void ha_report_unsent(void)
+{
+  uint32_t n = ha_unsent();
+  int fd;
+
+  if (n == g_ha_unsent)
+    {
+      return;
+    }
+
+  fd = open("/dev/mmwave0", O_RDONLY);
+  if (fd >= 0)
+    {
+      if (ioctl(fd, MMWAVE_IOC_UNSENT, (unsigned long)n) >= 0)
+        {
+          g_ha_unsent = n;
+        }
+
+      close(fd);
+    }
+}
+
+/* ---- Session engine: one exchange at a time, nothing waits ---- */
+
+static void ha_session_init(FAR struct ha_session_s *s)
+{
+  memset(s, 0, sizeof(*s));
+  s->sockfd     = -1;
+  s->result     = OK;
+  s->last_tx_ms = mmwave_service_now_ms();
+}
+
+/* The connection is up, and TLS with it: on to the backend's login */
+
+static int ha_session_opened(FAR struct ha_session_s *s)
+{
+  s->conn = HA_CONN_OPEN;
+  s->step = 0;
+  return s->op == HA_OP_CONNECT ? OK : ha_backend()->send(s);
+}
+
+#ifdef CONFIG_HACTL_TLS
+static int ha_session_handshake(FAR struct ha_session_s *s)
+{
+  int ret = ha_tls_handshake();
+
+  return ret == OK ? ha_session_opened(s) : ret;
+}
+#endif
+
+/* connect() has finished, one way or the other */
+
+static int ha_session_connected(FAR struct ha_session_s *s)
+{
+  socklen_t len = sizeof(int);
+  int err = 0;
+
+  if (getsockopt(s->sockfd, SOL_SOCKET, SO_ERROR, &err, &len) < 0)
+    {
+      err = errno;
+    }
+
+  if (err != 0)
+    {
+      ha_resolve_forget();
+      return -err;
+    }
+
+  g_ha_stats.connects++;
+
+#ifdef CONFIG_HACTL_TLS
+  if (g_ha_config.tls)
+    {
+      int one = 1;
+      int ret;
+
+      /* A resumed handshake ends with our Finished; without this the
+       * first request waits for the server's delayed ACK of it. Every
+       * message is one record, so nothing is sent in small pieces.
+       */
+
+      setsockopt(s->sockfd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+      ret = ha_tls_start(s->sockfd, ha_backend_host());
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      s->conn = HA_CONN_HANDSHAKE;
+      return ha_session_handshake(s);
+    }
+#endif
+
+  return ha_session_opened(s);
+}
+
+/**
+ * Open the exchange's connection: the address, which may still be
+ * being looked up, then a connect() that does not wait for the peer.
+ */
+
+static int ha_session_connect(FAR struct ha_session_s *s, uint32_t now)
+{
+  struct sockaddr_in server;
+  int ret;
+
+  memset(&server, 0, sizeof(server));
+  server.sin_family = AF_INET;
+  server.sin_port   = htons(ha_backend_port());
+
+  ret = ha_resolve(ha_backend_host(), &server.sin_addr);
+  if (ret < 0)
+    {
+      s->conn = ret == -EINPROGRESS ? HA_CONN_RESOLVING : HA_CONN_CLOSED;
+      return ret;
+    }
+
+  s->sockfd = socket(AF_INET, SOCK_STREAM, 0);
+  if (s->sockfd < 0)
+    {
+      s->conn = HA_CONN_CLOSED;
+      return -errno;
+    }
+
+  fcntl(s->sockfd, F_SETFL, fcntl(s->sockfd, F_GETFL) | O_NONBLOCK);
+
+  s->conn    = HA_CONN_CONNECTING;
+  s->conn_ms = now;
+  if (connect(s->sockfd, (FAR struct sockaddr *)&server,
+              sizeof(server)) < 0)
+    {
+      if (errno == EINPROGRESS)
+        {
+          return -EINPROGRESS;
+        }
+
+      ret = -errno;
+      ha_resolve_forget();
+      return ret;
+    }
+
+  return ha_session_connected(s);
+}
+
+/**
+ * The exchange is over. A failure closes the connection, and a state
+ * update that failed on a reused connection before a byte came back is
+ * sent once more on a fresh one: the server may just have dropped it.
+ */
+
+static void ha_session_finish(FAR struct ha_session_s *s, int ret,
+                              uint32_t now)
+{
+  if (ret < 0)
+    {
+      ha_session_drop(s);
+      if (s->reused && s->rxlen == 0 && s->op == HA_OP_STATE &&
+          ret != -ETIMEDOUT && ret != -ECANCELED)
+        {
+          s->reused = false;
+          ret = ha_session_connect(s, now);
+          if (ret == -EINPROGRESS)
+            {
+              return;
+            }
+
+          if (ret < 0)
+            {
+              ha_session_drop(s);
+            }
+        }
+    }
+
+  s->waiting = false;
+  s->result  = ret;
+
+#ifdef CONFIG_PM
+  pm_relax(PM_IDLE_DOMAIN, PM_NORMAL);
+#endif
+
+  if (ret == OK && s->op == HA_OP_STATE)
+    {
+      uint32_t us = (uint32_t)mmwave_service_now_us() - s->t0_us;
+
+      if (s->reused)
+        {
+          g_ha_stats.reused++;
+        }
+
+      g_ha_stats.posts++;
+      g_ha_stats.lat_sum_us += us;
+      if (us > g_ha_stats.lat_max_us)
+        {
+          g_ha_stats.lat_max_us = us;
+        }
+
+      if (g_ha_stats.posts == 1)
+        {
+          ha_first_report();
+        }
+    }
+}
+
+static void ha_session_next(FAR struct ha_session_s *s, int ret,
+                            uint32_t now)
+{
+  if (ret != -EINPROGRESS)
+    {
+      ha_session_finish(s, ret, now);
+    }
+}
+
+/**
+ * Start exchange `op` (HA_OP_STATE: delivering s->data) on the open
+ * connection or a new one, and return at once: s->result stays
+ * -EINPROGRESS until it is over. The CPU stays at full performance
+ * until then, as the ack time is what HA sees of it.
+ */
+
+static void ha_session_start(FAR struct ha_session_s *s, uint8_t op,
+                             uint32_t now)
+{
+  int ret;
+
+  s->op          = op;
+  s->result      = -EINPROGRESS;
+  s->rxlen       = 0;
+  s->reused      = s->conn == HA_CONN_OPEN;
+  s->started_ms  = now;
+  s->deadline_ms = now + HA_EXCHANGE_TIMEOUT_MS;
+  s->t0_us       = (uint32_t)mmwave_service_now_us();
+
+#ifdef CONFIG_PM
+  pm_stay(PM_IDLE_DOMAIN, PM_NORMAL);
+#endif
+
+  if (ha_backend_host()[0] == '\0' ||
+      (op != HA_OP_CONNECT && g_ha_config.backend != HA_BACKEND_MQTT &&
+       g_ha_config.token[0] == '\0'))
+    {
+      ret = -EINVAL;
+    }
+  else if (s->conn == HA_CONN_OPEN)
+    {
+      ret = op == HA_OP_CONNECT ? OK : ha_backend()->send(s);
+    }
+  else
+    {
+      ret = ha_session_connect(s, now);
+    }
+
+  ha_session_next(s, ret, now);
+}
+
+/**
+ * Everything the server has sent, to the backend. Returns the
+ * exchange's result once it has one; a connection that fails after
+ * that only closes.
+ */
+
+static int ha_session_input(FAR struct ha_session_s *s)
+{
+  FAR const struct ha_backend_s *be = ha_backend();
+  uint8_t buf[HA_RX_CHUNK_SIZE];
+  int result = -EINPROGRESS;
+
+  while (s->conn == HA_CONN_OPEN)
+    {
+      ssize_t n = ha_io_recv(s->sockfd, buf, sizeof(buf));
+      int ret;
+
+      if (n < 0)
+        {
+          if (errno == EAGAIN || errno == EWOULDBLOCK)
+            {
+              break;
+            }
+
+          ret = -errno;
+        }
+      else
+        {
+          g_ha_stats.rx_bytes += n;
+          s->rxlen += n;
+          ret = be->recv(s, buf, n);
+        }
+
+      if (ret == OK)
+        {
+          result = OK;
+        }
+      else if (ret != -EINPROGRESS)
+        {
+          if (result == OK)
+            {
+              ha_session_drop(s);
+              break;
+            }
+
+          return ret;
+        }
+
+      if (n == 0)
+        {
+          break;
+        }
+    }
+
+  return result;
+}
+
+/* The session's socket is ready; revents as poll() returned them */
+
+static void ha_session_events(FAR struct ha_session_s *s, short revents,
+                              uint32_t now)
+{
+  int ret;
+
+  if (revents == 0)
+    {
+      return;
+    }
+
+  switch (s->conn)
+    {
+      case HA_CONN_CONNECTING:
+        ret = ha_session_connected(s);
+        break;
+
+#ifdef CONFIG_HACTL_TLS
+      case HA_CONN_HANDSHAKE:
+        ret = ha_session_handshake(s);
+        break;
+#endif
+
+      case HA_CONN_OPEN:
+        ret = ha_session_input(s);
+        break;
+
+      default:
+        return;
+    }
+
+  if (s->result == -EINPROGRESS)
+    {
+      ha_session_next(s, ret, now);
+    }
+  else if (ret < 0 && ret != -EINPROGRESS)
+    {
+      ha_session_drop(s);  /* Between exchanges: the server went away */
+    }
+}
+
+/**
+ * Deadlines: an exchange gets HA_EXCHANGE_TIMEOUT_MS, and its connect()
+ * HA_CONNECT_TIMEOUT_MS of that. Also picks up the address an exchange
+ * is waiting for.
+ */
+
+static void ha_session_tick(FAR struct ha_session_s *s, uint32_t now)
+{
+  int ret;
+
+  if (s->result != -EINPROGRESS)
+    {
+      return;
+    }
+
+  if ((int32_t)(now - s->deadline_ms) >= 0 ||
+      (s->conn == HA_CONN_CONNECTING &&
+       now - s->conn_ms >= HA_CONNECT_TIMEOUT_MS))
+    {
+      if (s->conn == HA_CONN_CONNECTING)
+        {
+          ha_resolve_forget();
+        }
+
+      ret = -ETIMEDOUT;
+    }
+  else if (s->conn == HA_CONN_RESOLVING)
+    {
+      ret = ha_session_connect(s, now);
+    }
+  else
+    {
+      return;
+    }
+
+  ha_session_next(s, ret, now);
+}
+
+/* What to poll the session's socket for */
+
+static void ha_session_pollset(FAR const struct ha_session_s *s,
+                               FAR struct pollfd *pfd)
+{
+  pfd->fd     = s->conn >= HA_CONN_CONNECTING ? s->sockfd : -1;
+  pfd->events = s->conn == HA_CONN_CONNECTING ? POLLOUT : POLLIN;
+
+#ifdef CONFIG_HACTL_TLS
+  if (s->conn == HA_CONN_HANDSHAKE && g_tls.want_write)
+    {
+      pfd->events = POLLOUT;
+    }
+#endif
+}
+
+/* Stop: an exchange still running ends -ECANCELED, then the backend
+ * closes the connection
+ */
+
+static void ha_session_close(FAR struct ha_session_s *s, bool offline)
+{
+  if (s->result == -EINPROGRESS)
+    {
+      ha_session_finish(s, -ECANCELED, mmwave_service_now_ms());
+    }
+
+  ha_backend()->close(s, offline);
+}
+
+/**
+ * One exchange from start to end in the calling task, for `hactl push`
+ * and `hactl test` while nothing reports. Returns its result.
+ */
+
+static int ha_session_run(FAR struct ha_session_s *s, uint8_t op)
+{
+  struct pollfd pfd;
+  uint32_t now = mmwave_service_now_ms();
+
+  ha_session_start(s, op, now);
+  while (s->result == -EINPROGRESS)
+    {
+      ha_session_pollset(s, &pfd);
+      pfd.revents = 0;
+      poll(&pfd, 1, HA_REPORT_TICK_MS);
+
+      now = mmwave_service_now_ms();
+      ha_session_events(s, pfd.revents, now);
+      ha_session_tick(s, now);
+    }
+
+  s->op = HA_OP_NONE;
+  return s->result;
+}
+
+#ifdef CONFIG_HACTL_JOURNAL
+/* ---- Offline journal: the transitions HA missed ---- */
+
+static int ha_journal_append(FAR void *priv, FAR const uint8_t *buf,
+                             size_t len)
+{
+  int fd = open(HA_JOURNAL_FILE, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  int ret = OK;
+
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  if (write(fd, buf, len) != (ssize_t)len || fsync(fd) < 0)
+    {
+      ret = -EIO;
+    }
+
+  close(fd);
+  return ret;
+}
+
+static ssize_t ha_journal_read(FAR void *priv, uint32_t off,
+                               FAR uint8_t *buf, size_t len)
+{
+  int fd = open(HA_JOURNAL_FILE, O_RDONLY);
+  ssize_t ret;
+
+  if (fd < 0)
+    {
+      return errno == ENOENT ? 0 : -errno;
+    }
+
+  ret = lseek(fd, off, SEEK_SET) < 0 ? -errno : read(fd, buf, len);
+  close(fd);
+  return ret;
+}
+
+static int ha_journal_truncate(FAR void *priv, uint32_t len)
+{
+  int fd = open(HA_JOURNAL_FILE, O_WRONLY);
+  int ret;
+
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  ret = ftruncate(fd, len) < 0 ? -errno : OK;
+  close(fd);
+  return ret;
+}
+
+static int ha_journal_erase(FAR void *priv)
+{
+  return unlink(HA_JOURNAL_FILE) < 0 && errno != ENOENT ? -errno : OK;
+}
+
+static const struct ha_journal_io_s g_journal_io =
+{
+  ha_journal_append, ha_journal_read, ha_journal_truncate,
+  ha_journal_erase, NULL
+};
+
+/* Wall-clock seconds of a sample stamped on the ms tick */
+
+static void ha_journal_record(FAR const struct mmwave_data_s *data,
+                              uint32_t now)
+{
+  uint32_t ts = (uint32_t)time(NULL) - (now - data->timestamp_ms) / 1000;
+
+  ha_journal_log(&g_journal, data, ts, now);
+}
+
+#endif
+
+/* ---- Home Assistant sink: the selected backend behind the queue ---- */
+
+static int ha_sink_init(FAR void *priv)
+{
+  ha_session_init(&g_session);
+  g_ha_closing = false;
+
+  ha_queue_init(&g_ha_queue, mmwave_service_now_ms() ^ (uint32_t)getpid());
+
+#ifdef CONFIG_HACTL_JOURNAL
+  ha_journal_init(&g_journal, &g_journal_io,
+                  CONFIG_HACTL_JOURNAL_KB * 1024,
+                  CONFIG_HACTL_JOURNAL_SPILL_S * 1000);
+
+  uint32_t left = ha_journal_load(&g_journal);
+  if (left > 0)
+    {
+      printf("hactl: %lu journaled transition(s) still to replay\n",
+             (unsigned long)left);
+    }
+#endif
+
+  return OK;
+}
+
+static int ha_sink_change(FAR void *priv,
+                          FAR const struct mmwave_data_s *data,
+                          uint32_t now)
+{
+  ha_queue_push(&g_ha_queue, data);
+
+#ifdef CONFIG_HACTL_JOURNAL
+  if (g_ha_queue.failures > 0)
+    {
+      ha_journal_record(data, now);
+    }
+#endif
+
+  ha_report_unsent();
+  return OK;
+}
+
+/* Heartbeat: MQTT/WS keep-alive and reconnect, between exchanges */
+
+static int ha_sink_heartbeat(FAR void *priv,
+                             FAR const struct mmwave_data_s *data,
+                             uint32_t now)
+{
+  FAR const struct ha_backend_s *be = ha_backend();
+  uint8_t op;
+
+  if (be->idle == NULL || g_session.op != HA_OP_NONE || g_ha_closing)
+    {
+      return OK;
+    }
+
+  op = be->idle(&g_session, now);
+  if (op != HA_OP_NONE)
+    {
+      ha_session_start(&g_session, op, now);
+    }
+
+  return OK;
+}
+
+/* HA took the state in g_session.data */
+
+static void ha_sink_acked(uint32_t now)
+{
+  bool replaying = g_ha_queue.failures > 0;
+
+  /* The head may have been replaced or dropped while it was on its way;
+   * then it is still to be sent, but HA is reachable again.
+   */
+
+  if (g_ha_queue.count > 0 &&
+      memcmp(ha_queue_peek(&g_ha_queue), &g_session.data,
+             sizeof(g_session.data)) == 0)
+    {
+      ha_queue_ack(&g_ha_queue, now);
+    }
+  else
+    {
+      g_ha_queue.acked       = ha_presence(&g_session.data);
+      g_ha_queue.failures    = 0;
+      g_ha_queue.next_try_ms = now;
+    }
+
+  if (replaying)
+    {
+      printf("hactl: HA reachable again, replaying %u "
+             "queued transition(s)\n", g_ha_queue.count);
+    }
+}
+
+/* The head did not get through: back off, and journal what HA missed */
+
+static void ha_sink_failed(int ret, uint32_t now)
+{
+  uint32_t delay = ha_queue_fail(&g_ha_queue, now,
+                                 g_ha_config.report_interval_ms);
 
-/****************************************************************************
- * Private Data
- ****************************************************************************/
+  fprintf(stderr, "hactl: push failed (%d), retry %lu in %lu ms\n", ret,
+          (unsigned long)g_ha_queue.failures, (unsigned long)delay);
 
-static struct ha_config_s g_ha_config;
-static volatile bool g_reporting = false;
-static pid_t g_report_pid = -1;
+#ifdef CONFIG_HACTL_JOURNAL
+  /* HA just went away: what it has not seen starts the journal */
 
-/****************************************************************************
- * Private Functions
- ****************************************************************************/
+  for (int i = 0; g_ha_queue.failures == 1 && i < g_ha_queue.count; i++)
+    {
+      ha_journal_record(ha_queue_at(&g_ha_queue, i), now);
+    }
+#endif
+}
 
 /**
- * Load HA config from persistent storage.
+ * Collect the exchange that has just ended: acknowledge or back off
+ * what it carried. Returns its result; a cancelled one (new settings)
+ * is simply started again.
  */
 
-static int ha_load_config(void)
+static int ha_sink_done(uint32_t now)
 {
-  FILE *f = fopen(HA_CONFIG_FILE, "r");
-  if (f == NULL)
+  uint8_t op = g_session.op;
+  int ret    = g_session.result;
+
+  g_session.op = HA_OP_NONE;
+  if (ret == -ECANCELED)
     {
-      /* Defaults */
+      return OK;
+    }
 
-      memset(&g_ha_config, 0, sizeof(g_ha_config));
-      g_ha_config.port = HA_DEFAULT_PORT;
-      g_ha_config.report_interval_ms = 500;
-      return -ENOENT;
+  switch (op)
+    {
+      case HA_OP_STATE:
+        if (ret == OK)
+          {
+            ha_sink_acked(now);
+          }
+        else
+          {
+            ha_sink_failed(ret, now);
+          }
+
+        return ret;
+
+#ifdef CONFIG_HACTL_JOURNAL
+      case HA_OP_JOURNAL:
+        if (ret != OK)
+          {
+            uint32_t delay = ha_queue_fail(&g_ha_queue, now,
+                                           g_ha_config.report_interval_ms);
+            fprintf(stderr, "hactl: journal replay failed (%d), retry "
+                    "in %lu ms\n", ret, (unsigned long)delay);
+            return ret;
+          }
+
+        ha_journal_ack(&g_journal, g_replay.seq, g_replay.n,
+                       now - g_session.started_ms);
+        g_ha_queue.failures    = 0;
+        g_ha_queue.next_try_ms = now;
+
+        if (ha_journal_pending(&g_journal) == 0)
+          {
+            printf("hactl: journal replayed, %lu transition(s) in %lu "
+                   "request(s)\n", (unsigned long)g_journal.stats.replayed,
+                   (unsigned long)g_journal.stats.batches);
+          }
+
+        return OK;
+#endif
+
+      default:
+        return OK;  /* Ping or reconnect; a failure closed the connection */
     }
+}
 
-  char line[384];
-  while (fgets(line, sizeof(line), f) != NULL)
+/**
+ * Deliver queued transitions oldest first, then, once the queue has
+ * drained, the journal in batches. One exchange runs at a time: it is
+ * started here and collected here when it has ended, and nothing in
+ * between waits on HA. On failure the queue's own jittered backoff
+ * decides when to try again (so the sink is registered with backoff_ms
+ * 0), and the transitions that happen meanwhile are replayed once HA is
+ * back, without waiting a report interval each.
+ */
+
+static int ha_sink_post(uint32_t now)
+{
+  int ret;
+
+  for (; ; )
     {
-      char *eq = strchr(line, '=');
-      if (eq == NULL) continue;
-      *eq = '\0';
-      char *val = eq + 1;
+      if (g_session.op != HA_OP_NONE)
+        {
+          if (g_session.result == -EINPROGRESS)
+            {
+              return -EAGAIN;
+            }
 
-      /* Trim trailing newline */
+          ret = ha_sink_done(now);
+          if (ret < 0)
+            {
+              return ret;
+            }
+        }
 
-      size_t vlen = strlen(val);
-      if (vlen > 0 && val[vlen - 1] == '\n') val[vlen - 1] = '\0';
+      if (g_ha_closing)
+        {
+          return g_ha_queue.count > 0 ? -EAGAIN : OK;
+        }
 
-      if (strcmp(line, "url") == 0)
+#ifdef CONFIG_HACTL_JOURNAL
+      if (g_ha_queue.failures > 0)
         {
-          strncpy(g_ha_config.url, val, HA_MAX_URL_LEN - 1);
+          ha_journal_tick(&g_journal, now);
         }
-      else if (strcmp(line, "port") == 0)
+#endif
+
+      if (ha_queue_due(&g_ha_queue, now))
         {
-          g_ha_config.port = (uint16_t)atoi(val);
+          ha_queue_collapse(&g_ha_queue);
+          g_session.data = *ha_queue_peek(&g_ha_queue);
+          ha_session_start(&g_session, HA_OP_STATE, now);
+          continue;
         }
-      else if (strcmp(line, "token") == 0)
+
+      if (g_ha_queue.count > 0)
         {
-          strncpy(g_ha_config.token, val, HA_MAX_TOKEN_LEN - 1);
+          return -EAGAIN;
         }
-      else if (strcmp(line, "interval") == 0)
+
+#ifdef CONFIG_HACTL_JOURNAL
+      if (ha_journal_pending(&g_journal) > 0)
         {
-          g_ha_config.report_interval_ms = (uint16_t)atoi(val);
+          if ((int32_t)(now - g_ha_queue.next_try_ms) < 0)
+            {
+              return -EAGAIN;
+            }
+
+          ret = ha_journal_peek(&g_journal, g_replay.recs,
+                                ha_backend()->journal_max, &g_replay.seq);
+          if (ret < 0)
+            {
+              fprintf(stderr, "hactl: journal unreadable, %lu "
+                      "transition(s) lost\n",
+                      (unsigned long)g_journal.flash_count);
+              ha_journal_drop_flash(&g_journal);
+              continue;
+            }
+
+          if (ret > 0)
+            {
+              g_replay.n   = ret;
+              g_replay.now = (uint32_t)time(NULL);
+              ha_session_start(&g_session, HA_OP_JOURNAL, now);
+              continue;
+            }
         }
-    }
+#endif
 
-  fclose(f);
-  return OK;
+      return OK;
+    }
 }
 
-/**
- * Save HA config to persistent storage.
- */
+/* Post, then tell the driver what a deep sleep would lose now */
 
-static int ha_save_config(void)
+static int ha_sink_flush(FAR void *priv, uint32_t now)
 {
-  FILE *f = fopen(HA_CONFIG_FILE, "w");
-  if (f == NULL)
-    {
-      return -errno;
-    }
+  int ret = ha_sink_post(now);
 
-  fprintf(f, "url=%s\n", g_ha_config.url);
-  fprintf(f, "port=%u\n", g_ha_config.port);
-  fprintf(f, "token=%s\n", g_ha_config.token);
-  fprintf(f, "interval=%u\n", g_ha_config.report_interval_ms);
-  fclose(f);
-  return OK;
+  ha_report_unsent();
+  return ret;
 }
 
 /**
- * Send an HTTP POST to Home Assistant REST API to update entity state.
- *
- * Endpoint: POST /api/states/<entity_id>
- * Headers:  Authorization: Bearer <token>
- *           Content-Type: application/json
- * Body:     {"state": "on|off", "attributes": {...}}
+ * Reporting stops: an exchange still running is abandoned, and what the
+ * queue holds goes to the journal (it already has it once a post has
+ * failed) for the next start to replay.
  */
 
-static int ha_post_state(FAR const struct mmwave_data_s *data)
+static void ha_sink_close(FAR void *priv)
 {
-  struct sockaddr_in server;
-  char http_buf[HA_HTTP_BUF_SIZE];
-  int sockfd;
-  int ret;
+  ha_session_close(&g_session, true);
+  g_session.op = HA_OP_NONE;
 
-  if (g_ha_config.url[0] == '\0' || g_ha_config.token[0] == '\0')
+#ifdef CONFIG_HACTL_JOURNAL
+  for (int i = 0; g_ha_queue.failures == 0 && i < g_ha_queue.count; i++)
     {
-      return -EINVAL;
+      ha_journal_record(ha_queue_at(&g_ha_queue, i),
+                        mmwave_service_now_ms());
     }
 
-  /* Create socket */
+  ha_journal_sync(&g_journal);
+#endif
 
-  sockfd = socket(AF_INET, SOCK_STREAM, 0);
-  if (sockfd < 0)
-    {
-      return -errno;
-    }
+  ha_report_unsent();
+}
 
-  /* Connect to HA */
+static const struct ha_sink_ops_s g_ha_sink_ops =
+{
+  "ha", ha_sink_init, ha_sink_change, ha_sink_heartbeat, ha_sink_flush,
+  ha_sink_close
+};
 
-  memset(&server, 0, sizeof(server));
-  server.sin_family = AF_INET;
-  server.sin_port = htons(g_ha_config.port);
+#ifdef CONFIG_HACTL_SINK_LOG
+/* ---- Syslog sink ---- */
 
-  ret = inet_pton(AF_INET, g_ha_config.url, &server.sin_addr);
-  if (ret <= 0)
-    {
-      /* Try DNS resolution */
+static int ha_log_change(FAR void *priv,
+                         FAR const struct mmwave_data_s *data,
+                         uint32_t now)
+{
+  FAR struct ha_log_sink_s *lg = priv;
 
-      FAR struct hostent *he = gethostbyname(g_ha_config.url);
-      if (he == NULL)
-        {
-          close(sockfd);
-          return -ENOENT;
-        }
+  lg->last = *data;
+  lg->folded++;
+  return OK;
+}
 
-      memcpy(&server.sin_addr, he->h_addr_list[0], he->h_length);
-    }
+static int ha_log_flush(FAR void *priv, uint32_t now)
+{
+  FAR struct ha_log_sink_s *lg = priv;
 
-  ret = connect(sockfd, (FAR struct sockaddr *)&server, sizeof(server));
-  if (ret < 0)
+  if (lg->folded > 0)
     {
-      close(sockfd);
-      return -errno;
+      syslog(LOG_INFO, "presence: %s (%s, %u cm)%s\n",
+             ha_presence(&lg->last) ? "on" : "off",
+             mmwave_target_str(lg->last.target_state),
+             lg->last.detection_distance,
+             lg->folded > 1 ? " after brief changes" : "");
+      lg->folded = 0;
     }
 
-  /* Build JSON body */
+  return OK;
+}
 
-  const char *state = (data->target_state != LD2410_TARGET_NONE)
-                      ? "on" : "off";
+static const struct ha_sink_ops_s g_log_sink_ops =
+{
+  "log", NULL, ha_log_change, NULL, ha_log_flush, NULL
+};
+#endif
 
-  char body[256];
-  int bodylen = snprintf(body, sizeof(body),
-    "{\"state\":\"%s\","
-    "\"attributes\":{"
-    "\"friendly_name\":\"mmWave Presence\","
-    "\"device_class\":\"occupancy\","
-    "\"motion_energy\":%u,"
-    "\"static_energy\":%u,"
-    "\"motion_distance\":%u,"
-    "\"static_distance\":%u,"
-    "\"detection_distance\":%u"
-    "}}",
-    state,
-    data->motion_energy,
-    data->static_energy,
-    data->motion_distance,
-    data->static_distance,
-    data->detection_distance);
+/* Register the sinks: Home Assistant first, then the others */
 
-  /* Build HTTP request */
+static void ha_sinks_setup(void)
+{
+  ha_fanout_init(&g_fanout, mmwave_service_now_ms);
+
+  memset(&g_ha_sink, 0, sizeof(g_ha_sink));
+  g_ha_sink.ops          = &g_ha_sink_ops;
+  g_ha_sink.heartbeat_ms = g_ha_config.report_interval_ms;
+  g_ha_sink.budget_ms    = HA_SINK_BUDGET_MS;
+  ha_fanout_add(&g_fanout, &g_ha_sink);
+
+#ifdef CONFIG_HACTL_SINK_LOG
+  memset(&g_log, 0, sizeof(g_log));
+  memset(&g_log_sink, 0, sizeof(g_log_sink));
+  g_log_sink.ops             = &g_log_sink_ops;
+  g_log_sink.priv            = &g_log;
+  g_log_sink.min_interval_ms = CONFIG_HACTL_LOG_INTERVAL_MS;
+  ha_fanout_add(&g_fanout, &g_log_sink);
+#endif
+}
 
-  int httplen = snprintf(http_buf, sizeof(http_buf),
-    "POST /api/states/%s HTTP/1.1\r\n"
-    "Host: %s:%u\r\n"
-    "Authorization: Bearer %s\r\n"
-    "Content-Type: application/json\r\n"
-    "Content-Length: %d\r\n"
-    "Connection: close\r\n"
-    "\r\n"
-    "%s",
-    HA_ENTITY_ID,
-    g_ha_config.url, g_ha_config.port,
-    g_ha_config.token,
-    bodylen,
-    body);
+/* ---- Reporting service: one sensor reader, every sink ---- */
 
-  /* Send */
+static int ha_report_start(void)
+{
+  printf("hactl: auto-reporting started → %s %s:%u\n",
+         ha_backend()->name, ha_backend_host(), ha_backend_port());
 
-  ssize_t sent = send(sockfd, http_buf, httplen, 0);
-  if (sent != httplen)
-    {
-      close(sockfd);
-      return -EIO;
-    }
+  ha_sinks_setup();
+  ha_fanout_start(&g_fanout);
+  config_svc_watch("ha.", ha_config_changed, NULL);
+  return OK;
+}
 
-  /* Read response (just check status line) */
+static void ha_report_pollset(FAR struct pollfd *pfds)
+{
+  ha_session_pollset(&g_session, &pfds[0]);
+}
 
-  ssize_t nread = recv(sockfd, http_buf, sizeof(http_buf) - 1, 0);
-  close(sockfd);
+/* The session's socket; an exchange that has ended is collected (and
+ * the next one started) right away rather than on the next tick
+ */
 
-  if (nread > 0)
+static int ha_report_events(FAR const struct pollfd *pfds, uint32_t now)
+{
+  ha_session_events(&g_session, pfds[0].revents, now);
+  if (g_session.op != HA_OP_NONE && g_session.result != -EINPROGRESS)
     {
-      http_buf[nread] = '\0';
-
-      /* Check for 200 or 201 status */
-
-      if (strstr(http_buf, "200") != NULL ||
-          strstr(http_buf, "201") != NULL)
-        {
-          return OK;
-        }
+      ha_fanout_run(&g_fanout);
     }
 
-  return -EIO;
+  return OK;
 }
 
-/**
- * Background auto-reporting task.
- * Reads mmWave data and pushes to HA whenever state changes.
- */
+/* Target state changes go to every sink; the rest only update `last` */
 
-static int ha_report_task(int argc, FAR char *argv[])
+static void ha_report_frame(FAR const struct mmwave_eng_data_s *eng,
+                            bool gates, uint32_t now)
 {
-  int fd;
-  struct mmwave_data_s data;
-  uint8_t prev_state = 0xFF;  /* Force initial report */
+  ha_fanout_input(&g_fanout, &eng->basic);
+}
 
-  fd = open(MMWAVE_DEV_PATH, O_RDONLY);
-  if (fd < 0)
+/* Each sink's flushes and heartbeats run on its own schedule */
+
+static uint32_t ha_report_tick(uint32_t now)
+{
+  if (g_push_requested)
     {
-      fprintf(stderr, "hactl: cannot open sensor\n");
-      return EXIT_FAILURE;
+      g_push_requested = false;
+      ha_fanout_push(&g_fanout);
     }
 
-  printf("hactl: auto-reporting started → %s:%u\n",
-         g_ha_config.url, g_ha_config.port);
+  /* New settings: reconnect with them on the next report */
 
-  g_reporting = true;
-
-  while (g_reporting)
+  if (g_config_changed)
     {
-      ssize_t nread = read(fd, &data, sizeof(data));
-      if (nread == sizeof(data))
-        {
-          /* Report on state change OR every 30 seconds */
-
-          if (data.target_state != prev_state)
-            {
-              int ret = ha_post_state(&data);
-              if (ret == OK)
-                {
-                  prev_state = data.target_state;
-                }
-              else
-                {
-                  fprintf(stderr, "hactl: push failed (%d), retrying...\n",
-                          ret);
-                }
-            }
-        }
-
-      usleep(g_ha_config.report_interval_ms * 1000);
+      g_config_changed = false;
+      ha_session_close(&g_session, false);
+      ha_load_config();
+      g_ha_sink.heartbeat_ms = g_ha_config.report_interval_ms;
     }
 
-  close(fd);
+  ha_session_tick(&g_session, now);
+  ha_fanout_run(&g_fanout);
+  return HA_REPORT_TICK_MS;
+}
+
+static void ha_report_stop(void)
+{
+  g_ha_closing = true;
+  ha_fanout_stop(&g_fanout);
   printf("hactl: auto-reporting stopped\n");
-  return OK;
+}
+
+static int ha_report_task(int argc, FAR char *argv[])
+{
+  return mmwave_service_run(&g_hactl_service);
 }
 
 static void print_status(void)
 {
   printf("Home Assistant Connection\n");
   printf("─────────────────────────\n");
+  printf("  Backend  : %s\n", ha_backend()->name);
   printf("  URL      : %s\n",
-         g_ha_config.url[0] ? g_ha_config.url : "(not set)");
-  printf("  Port     : %u\n", g_ha_config.port);
-  printf("  Token    : %s\n",
-         g_ha_config.token[0] ? "***configured***" : "(not set)");
-  printf("  Entity   : %s\n", HA_ENTITY_ID);
+         ha_backend_host()[0] ? ha_backend_host() : "(not set)");
+  printf("  Port     : %u\n", ha_backend_port());
+
+  if (g_ha_config.backend == HA_BACKEND_MQTT)
+    {
+      printf("  User     : %s\n",
+             g_ha_config.mqtt_user[0] ? g_ha_config.mqtt_user : "(none)");
+      printf("  Topic    : %s (QoS %d, retained)\n", g_mqtt_state_topic,
+             g_ha_config.mqtt_qos1 ? 1 : 0);
+    }
+  else
+    {
+      printf("  Token    : %s\n",
+             g_ha_config.token[0] ? "***configured***" : "(not set)");
+      if (g_ha_config.backend == HA_BACKEND_WS)
+        {
+          printf("  Event    : %s\n", HA_WS_EVENT_TYPE);
+        }
+      else
+        {
+          printf("  Entity   : %s\n", HA_ENTITY_ID);
+        }
+    }
+
   printf("  Reporting: %s\n", g_reporting ? "ACTIVE" : "stopped");
   printf("  Interval : %u ms\n", g_ha_config.report_interval_ms);
+  printf("  Queue    : %u/%u pending, %lu dropped, %lu collapsed\n",
+         g_ha_queue.count, HA_QUEUE_DEPTH,
+         (unsigned long)g_ha_queue.dropped,
+         (unsigned long)g_ha_queue.collapsed);
+
+  printf("  Conns    : %lu opened, %lu posts reused\n",
+         (unsigned long)g_ha_stats.connects,
+         (unsigned long)g_ha_stats.reused);
+  printf("  Traffic  : %lu bytes tx, %lu bytes rx\n",
+         (unsigned long)g_ha_stats.tx_bytes,
+         (unsigned long)g_ha_stats.rx_bytes);
+
+  if (g_ha_stats.posts > 0)
+    {
+      printf("  Latency  : avg %lu us, max %lu us over %lu update(s)\n",
+             (unsigned long)(g_ha_stats.lat_sum_us / g_ha_stats.posts),
+             (unsigned long)g_ha_stats.lat_max_us,
+             (unsigned long)g_ha_stats.posts);
+    }
+
+  if (g_ha_queue.failures > 0)
+    {
+      printf("  Retrying : %lu consecutive failure(s)\n",
+             (unsigned long)g_ha_queue.failures);
+    }
+
+#ifdef CONFIG_HACTL_JOURNAL
+  if (g_journal.stats.logged > 0 || ha_journal_pending(&g_journal) > 0)
+    {
+      uint32_t wa = ha_journal_wa_x100(&g_journal.stats);
+
+      printf("  Journal  : %lu pending (%lu in flash), %lu logged, "
+             "%lu spilled in %lu write(s) (WA %lu.%02lu), %lu dropped\n",
+             (unsigned long)ha_journal_pending(&g_journal),
+             (unsigned long)g_journal.flash_count,
+             (unsigned long)g_journal.stats.logged,
+             (unsigned long)g_journal.stats.spilled,
+             (unsigned long)g_journal.stats.writes,
+             (unsigned long)(wa / 100), (unsigned long)(wa % 100),
+             (unsigned long)g_journal.stats.dropped);
+      printf("  Replay   : %lu transition(s) in %lu request(s), %lu/s\n",
+             (unsigned long)g_journal.stats.replayed,
+             (unsigned long)g_journal.stats.batches,
+             (unsigned long)ha_journal_rate(&g_journal.stats));
+    }
+#endif
+
+#ifdef CONFIG_HACTL_TLS
+  if (g_ha_config.tls)
+    {
+      printf("  TLS      : %s, %lu full (avg %lu ms, max %lu ms), "
+             "%lu resumed (avg %lu ms, max %lu ms)\n",
+             g_tls.ready && !g_tls.verify ? "unverified" : "verified",
+             (unsigned long)g_tls_stats.full,
+             (unsigned long)ha_tls_avg_ms(g_tls_stats.full_sum_ms,
+                                          g_tls_stats.full),
+             (unsigned long)g_tls_stats.full_max_ms,
+             (unsigned long)g_tls_stats.resumed,
+             (unsigned long)ha_tls_avg_ms(g_tls_stats.resumed_sum_ms,
+                                          g_tls_stats.resumed),
+             (unsigned long)g_tls_stats.resumed_max_ms);
+      printf("  Handshake: last %lu ms, %lu resumption(s) refused, "
+             "%lu failed\n",
+             (unsigned long)g_tls_stats.last_ms,
+             (unsigned long)g_tls_stats.rejected,
+             (unsigned long)g_tls_stats.failed);
+    }
+#endif
+
+  for (int i = 0; g_reporting && i < g_fanout.count; i++)
+    {
+      FAR const struct ha_sink_s *sk = g_fanout.sinks[i];
+
+      printf("  Sink %-4s: %s, %lu changes, %lu flushes (%lu held), "
+             "%lu errors, %lu over budget, max %lu ms\n",
+             sk->ops->name, ha_sink_state_str(sk->state),
+             (unsigned long)sk->stats.changes,
+             (unsigned long)sk->stats.flushes,
+             (unsigned long)sk->stats.limited,
+             (unsigned long)sk->stats.errors,
+             (unsigned long)sk->stats.overruns,
+             (unsigned long)sk->stats.flush_max_ms);
+    }
 }
 
 static void print_usage(void)
@@ -345,6 +3278,15 @@ static void print_usage(void)
   printf("Commands:\n");
   printf("  status                Show connection status\n");
   printf("  config <url> <token>  Set HA URL/IP and access token\n");
+  printf("  mqtt <broker> [user] [pass]\n");
+  printf("                        Report via MQTT with HA discovery\n");
+  printf("  backend <rest|mqtt|ws>\n");
+  printf("                        Select the reporting backend\n");
+  printf("  node <id>             Set the MQTT node id (topics)\n");
+#ifdef CONFIG_HACTL_TLS
+  printf("  tls <on|off> [noverify]\n");
+  printf("                        TLS to HA or the broker\n");
+#endif
   printf("  push                  Manually push current state to HA\n");
   printf("  start                 Start auto-reporting task\n");
   printf("  stop                  Stop auto-reporting task\n");
@@ -381,11 +3323,12 @@ int main(int argc, FAR char *argv[])
 
       strncpy(g_ha_config.url, argv[2], HA_MAX_URL_LEN - 1);
       strncpy(g_ha_config.token, argv[3], HA_MAX_TOKEN_LEN - 1);
+      ha_build_request();
 
       int ret = ha_save_config();
       if (ret == OK)
         {
-          printf("hactl: config saved to %s\n", HA_CONFIG_FILE);
+          printf("hactl: config saved to %s\n", CFG_STORE_PATH);
         }
       else
         {
@@ -393,8 +3336,128 @@ int main(int argc, FAR char *argv[])
           return EXIT_FAILURE;
         }
     }
+  else if (strcmp(cmd, "mqtt") == 0)
+    {
+      if (argc < 3)
+        {
+          fprintf(stderr,
+                  "hactl: usage: hactl mqtt <broker> [user] [pass]\n");
+          return EXIT_FAILURE;
+        }
+
+      /* ha.url stays: it is HA itself, for the other backends */
+
+      strncpy(g_ha_config.mqtt_host, argv[2], HA_MAX_URL_LEN - 1);
+      strncpy(g_ha_config.mqtt_user, argc > 3 ? argv[3] : "",
+              HA_MAX_CRED_LEN - 1);
+      strncpy(g_ha_config.mqtt_pass, argc > 4 ? argv[4] : "",
+              HA_MAX_CRED_LEN - 1);
+      g_ha_config.backend = HA_BACKEND_MQTT;
+      ha_build_request();
+
+      int ret = ha_save_config();
+      if (ret != OK)
+        {
+          fprintf(stderr, "hactl: save failed: %d\n", ret);
+          return EXIT_FAILURE;
+        }
+
+      printf("hactl: reporting via MQTT broker %s:%u as '%s'\n",
+             ha_mqtt_host(), g_ha_config.mqtt_port, g_ha_config.node);
+    }
+  else if (strcmp(cmd, "backend") == 0)
+    {
+      if (argc < 3 || ha_backend_parse(argv[2]) < 0)
+        {
+          fprintf(stderr, "hactl: usage: hactl backend <rest|mqtt|ws>\n");
+          return EXIT_FAILURE;
+        }
+
+      g_ha_config.backend = ha_backend_parse(argv[2]);
+
+      int ret = ha_save_config();
+      if (ret != OK)
+        {
+          fprintf(stderr, "hactl: save failed: %d\n", ret);
+          return EXIT_FAILURE;
+        }
+
+      printf("hactl: backend %s (restart reporting to apply)\n",
+             ha_backend()->name);
+    }
+  else if (strcmp(cmd, "node") == 0)
+    {
+      if (argc < 3 || !ha_mqtt_node_valid(argv[2]))
+        {
+          fprintf(stderr, "hactl: usage: hactl node <id>  "
+                  "([A-Za-z0-9_-], max %d chars)\n", HA_MQTT_NODE_MAX - 1);
+          return EXIT_FAILURE;
+        }
+
+      strcpy(g_ha_config.node, argv[2]);
+      ha_build_request();
+
+      int ret = ha_save_config();
+      if (ret != OK)
+        {
+          fprintf(stderr, "hactl: save failed: %d\n", ret);
+          return EXIT_FAILURE;
+        }
+
+      printf("hactl: node id '%s'\n", g_ha_config.node);
+    }
+#ifdef CONFIG_HACTL_TLS
+  else if (strcmp(cmd, "tls") == 0)
+    {
+      if (argc < 3 || (strcmp(argv[2], "on") != 0 &&
+                       strcmp(argv[2], "off") != 0))
+        {
+          fprintf(stderr, "hactl: usage: hactl tls <on|off> [noverify]\n");
+          return EXIT_FAILURE;
+        }
+
+      g_ha_config.tls = strcmp(argv[2], "on") == 0;
+      g_ha_config.tls_verify = argc < 4 || strcmp(argv[3], "noverify") != 0;
+
+      /* Follow the broker to its TLS listener unless moved elsewhere */
+
+      if (g_ha_config.tls && g_ha_config.mqtt_port == HA_MQTT_DEFAULT_PORT)
+        {
+          g_ha_config.mqtt_port = HA_MQTTS_DEFAULT_PORT;
+        }
+      else if (!g_ha_config.tls &&
+               g_ha_config.mqtt_port == HA_MQTTS_DEFAULT_PORT)
+        {
+          g_ha_config.mqtt_port = HA_MQTT_DEFAULT_PORT;
+        }
+
+      int ret = ha_save_config();
+      if (ret != OK)
+        {
+          fprintf(stderr, "hactl: save failed: %d\n", ret);
+          return EXIT_FAILURE;
+        }
+
+      printf("hactl: TLS %s%s (restart reporting to apply)\n",
+             g_ha_config.tls ? "on" : "off",
+             g_ha_config.tls && !g_ha_config.tls_verify ?
+             ", certificate not checked" : "");
+    }
+#endif
   else if (strcmp(cmd, "push") == 0)
     {
+      /* The backends' static buffers belong to the report task while it
+       * runs, and it already holds the latest sample: have it resend
+       * that to every sink rather than reading the sensor again.
+       */
+
+      if (g_reporting)
+        {
+          g_push_requested = true;
+          printf("hactl: push handed to the reporting task\n");
+          return OK;
+        }
+
       int fd = open(MMWAVE_DEV_PATH, O_RDONLY);
       if (fd < 0)
         {
@@ -412,10 +3475,16 @@ int main(int argc, FAR char *argv[])
           return EXIT_FAILURE;
         }
 
-      printf("hactl: pushing state '%s' to HA... ",
-             data.target_state != LD2410_TARGET_NONE ? "on" : "off");
+      printf("hactl: pushing state '%s' to HA (%s)... ",
+             data.target_state != LD2410_TARGET_NONE ? "on" : "off",
+             ha_backend()->name);
+
+      ha_session_init(&g_session);
+      g_session.data = data;
+
+      int ret = ha_session_run(&g_session, HA_OP_STATE);
+      ha_session_close(&g_session, false);
 
-      int ret = ha_post_state(&data);
       printf("%s\n", ret == OK ? "ok" : "FAILED");
       return ret == OK ? EXIT_SUCCESS : EXIT_FAILURE;
     }
@@ -427,54 +3496,82 @@ int main(int argc, FAR char *argv[])
           return OK;
         }
 
-      if (g_ha_config.url[0] == '\0' || g_ha_config.token[0] == '\0')
+      if (g_ha_config.backend == HA_BACKEND_MQTT &&
+          ha_mqtt_host()[0] == '\0')
+        {
+          fprintf(stderr, "hactl: run 'hactl mqtt <broker>' first\n");
+          return EXIT_FAILURE;
+        }
+
+      if (g_ha_config.backend != HA_BACKEND_MQTT &&
+          (g_ha_config.url[0] == '\0' || g_ha_config.token[0] == '\0'))
         {
           fprintf(stderr, "hactl: run 'hactl config <url> <token>' first\n");
           return EXIT_FAILURE;
         }
 
-      /* Start background reporting task via task_create */
+      /* Hand reporting to mmwaved, or else run it in a task of its own */
 
+      int ret = mmwave_service_delegate(&g_hactl_service);
+      if (ret != -ESRCH)
+        {
+          return ret == OK ? OK : EXIT_FAILURE;
+        }
+
+      g_reporting  = true;
       g_report_pid = task_create("ha_report",
                                  100,    /* priority */
-                                 2048,   /* stack */
+                                 HA_REPORT_STACK,
                                  ha_report_task,
                                  NULL);
       if (g_report_pid < 0)
         {
+          g_reporting = false;
           fprintf(stderr, "hactl: failed to start task\n");
           return EXIT_FAILURE;
         }
     }
   else if (strcmp(cmd, "stop") == 0)
     {
-      g_reporting = false;
       printf("hactl: stopping...\n");
+      mmwave_service_stop(&g_hactl_service);
     }
   else if (strcmp(cmd, "test") == 0)
     {
       printf("hactl: testing connection to %s:%u... ",
-             g_ha_config.url, g_ha_config.port);
+             ha_backend_host(), ha_backend_port());
+
+      /* The report task owns the session, the lookup and TLS while it
+       * runs
+       */
 
-      struct sockaddr_in server;
-      int sockfd = socket(AF_INET, SOCK_STREAM, 0);
-      if (sockfd < 0)
+      if (g_reporting)
         {
-          printf("FAILED (socket)\n");
-          return EXIT_FAILURE;
+          printf("skipped, reporting holds the connection (see status)\n");
+          return EXIT_SUCCESS;
         }
 
-      memset(&server, 0, sizeof(server));
-      server.sin_family = AF_INET;
-      server.sin_port = htons(g_ha_config.port);
-      inet_pton(AF_INET, g_ha_config.url, &server.sin_addr);
+      ha_session_init(&g_session);
+
+      int ret = ha_session_run(&g_session, HA_OP_CONNECT);
+      ha_session_drop(&g_session);
+      if (ret < 0)
+        {
+          printf("FAILED (%d)\n", ret);
+          return EXIT_FAILURE;
+        }
 
-      int ret = connect(sockfd, (FAR struct sockaddr *)&server,
-                        sizeof(server));
-      close(sockfd);
+#ifdef CONFIG_HACTL_TLS
+      if (g_ha_config.tls)
+        {
+          printf("OK, TLS handshake %lu ms\n",
+                 (unsigned long)g_tls_stats.last_ms);
+          return EXIT_SUCCESS;
+        }
+#endif
 
-      printf("%s\n", ret == 0 ? "OK" : "FAILED");
-      return ret == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+      printf("OK\n");
+      return EXIT_SUCCESS;
     }
   else
     {
@@ -0,0 +1,526 @@
+/*
+ * apps/httpd/httpd.h
+ *
+ * Minimal HTTP/1.1 server for watching the sensor live from a browser
+ * or dashboard:
+ *
+ *   GET /state    JSON snapshot of the latest reading
+ *   GET /gates    JSON per-gate energies (engineering mode only)
+ *   GET /events   Server-Sent Events: the snapshot, then one event per
+ *                 change, fanned out to every subscriber
+ *
+ * Single-threaded and non-blocking. Connections live in a fixed slot
+ * table with fixed rx/tx buffers, so RAM is bounded by
+ * CONFIG_HTTPD_SLOTS no matter how many clients try. Each event is
+ * formatted once and copied to every subscriber; a subscriber whose tx
+ * buffer is still full when the next event comes is marked stale and
+ * gets only the newest state once it drains, so a slow client never
+ * holds up the others or grows a queue.
+ *
+ * Sockets are behind a send callback that may write less than asked
+ * (or nothing) and time is passed in, so the server runs on the host.
+ */
+
+#ifndef __APPS_HTTPD_HTTPD_H
+#define __APPS_HTTPD_HTTPD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/json_writer.h"
+#include "apps/common/mmwave_json.h"
+
+#ifndef CONFIG_HTTPD_SLOTS
+#  define CONFIG_HTTPD_SLOTS    4
+#endif
+
+#ifndef CONFIG_HTTPD_EVENT_MS
+#  define CONFIG_HTTPD_EVENT_MS 500
+#endif
+
+#define HTTPD_RX_MAX            384    /* Request head, headers included */
+#define HTTPD_TX_MAX            640    /* Response, or queued events */
+#define HTTPD_BODY_MAX          256
+#define HTTPD_HEAD_TIMEOUT_MS   5000   /* Whole request head within this */
+#define HTTPD_HEARTBEAT_MS      15000  /* SSE comment when otherwise idle */
+#define HTTPD_RETRY_MS          2000   /* EventSource reconnect delay */
+
+/* Returned by httpd_input()/httpd_flush() when the slot should close */
+
+#define HTTPD_CLOSE             1
+
+enum httpd_state_e
+{
+  HTTPD_FREE = 0,
+  HTTPD_READING,         /* Collecting the request head */
+  HTTPD_RESPONDING,      /* Sending one response, then close */
+  HTTPD_STREAMING        /* SSE subscriber */
+};
+
+/*
+ * Write up to len bytes on slot's connection. Returns the number taken
+ * (0 if the socket would block) or a negative errno.
+ */
+typedef ssize_t (*httpd_send_t)(void *arg, int slot, const void *buf,
+                                size_t len);
+
+struct httpd_conn_s
+{
+  uint8_t  state;               /* enum httpd_state_e */
+  bool     stale;               /* Missed an event while full */
+  uint32_t opened_ms;
+  uint32_t last_tx_ms;
+  uint16_t rx_len;
+  uint16_t tx_off;              /* Sent so far ... */
+  uint16_t tx_len;              /* ... of this many queued */
+  char     rx[HTTPD_RX_MAX];
+  char     tx[HTTPD_TX_MAX];
+};
+
+struct httpd_stats_s
+{
+  uint32_t requests;
+  uint32_t refused;             /* No free slot */
+  uint32_t events;              /* Events published (not per client) */
+  uint32_t coalesced;           /* Per-client events skipped while full */
+  uint32_t timeouts;
+};
+
+struct httpd_s
+{
+  struct httpd_conn_s       conns[CONFIG_HTTPD_SLOTS];
+  struct httpd_stats_s      stats;
+  httpd_send_t              send;
+  void                     *arg;
+
+  struct mmwave_eng_data_s  cur;
+  bool                      valid;
+  bool                      gates;
+
+  struct mmwave_data_s      last;         /* As of the last event */
+  uint32_t                  last_ev_ms;
+  uint32_t                  event_id;
+  char                      ev[HTTPD_BODY_MAX + 48];
+  uint16_t                  ev_len;
+};
+
+static inline void httpd_init(struct httpd_s *h, httpd_send_t send,
+                              void *arg)
+{
+  memset(h, 0, sizeof(*h));
+  h->send = send;
+  h->arg  = arg;
+}
+
+/* Claim a slot for a new connection; -EBUSY when all are taken */
+
+static inline int httpd_open(struct httpd_s *h, uint32_t now)
+{
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      struct httpd_conn_s *c = &h->conns[i];
+
+      if (c->state == HTTPD_FREE)
+        {
+          c->state      = HTTPD_READING;
+          c->stale      = false;
+          c->opened_ms  = now;
+          c->last_tx_ms = now;
+          c->rx_len     = 0;
+          c->tx_off     = 0;
+          c->tx_len     = 0;
+          return i;
+        }
+    }
+
+  h->stats.refused++;
+  return -EBUSY;
+}
+
+static inline void httpd_close(struct httpd_s *h, int slot)
+{
+  h->conns[slot].state = HTTPD_FREE;
+}
+
+static inline int httpd_streaming(const struct httpd_s *h)
+{
+  int n = 0;
+
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      n += h->conns[i].state == HTTPD_STREAMING;
+    }
+
+  return n;
+}
+
+static inline bool httpd_wants_write(const struct httpd_s *h, int slot)
+{
+  return h->conns[slot].tx_off < h->conns[slot].tx_len;
+}
+
+/* Queue bytes on a slot; false if they do not fit */
+
+static inline bool httpd_queue(struct httpd_conn_s *c, const char *buf,
+                               size_t len)
+{
+  if (c->tx_off > 0)
+    {
+      memmove(c->tx, c->tx + c->tx_off, c->tx_len - c->tx_off);
+      c->tx_len -= c->tx_off;
+      c->tx_off  = 0;
+    }
+
+  if (len > sizeof(c->tx) - c->tx_len)
+    {
+      return false;
+    }
+
+  memcpy(c->tx + c->tx_len, buf, len);
+  c->tx_len += (uint16_t)len;
+  return true;
+}
+
+/* ---- Bodies ---- */
+
+static inline int httpd_json_state(const struct httpd_s *h, char *buf,
+                                   size_t size)
+{
+  const struct mmwave_data_s *d = &h->cur.basic;
+  struct json_writer_s w;
+  struct json_buf_s jb = { buf, size, 0 };
+
+  json_init(&w, json_sink_buf, &jb);
+  json_begin_object(&w, NULL);
+  json_bool(&w, "presence", mmwave_json_presence(d));
+  json_str(&w, "target", mmwave_target_str(d->target_state));
+  mmwave_json_fields(&w, d);
+  json_uint(&w, "ts", d->timestamp_ms);
+  json_end_object(&w);
+  return json_finish(&w);
+}
+
+static inline int httpd_json_gates(const struct httpd_s *h, char *buf,
+                                   size_t size)
+{
+  struct json_writer_s w;
+  struct json_buf_s jb = { buf, size, 0 };
+
+  json_init(&w, json_sink_buf, &jb);
+  json_begin_object(&w, NULL);
+  json_begin_array(&w, "motion");
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      json_uint(&w, NULL, h->cur.motion_gate_energy[i]);
+    }
+
+  json_end_array(&w);
+  json_begin_array(&w, "static");
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      json_uint(&w, NULL, h->cur.static_gate_energy[i]);
+    }
+
+  json_end_array(&w);
+  json_uint(&w, "ts", h->cur.basic.timestamp_ms);
+  json_end_object(&w);
+  return json_finish(&w);
+}
+
+/* Format the current state as an SSE event into h->ev */
+
+static inline void httpd_format_event(struct httpd_s *h)
+{
+  char body[HTTPD_BODY_MAX];
+  int n = httpd_json_state(h, body, sizeof(body));
+
+  n = snprintf(h->ev, sizeof(h->ev),
+               "id: %lu\nevent: state\ndata: %.*s\n\n",
+               (unsigned long)h->event_id, n < 0 ? 0 : n, body);
+  h->ev_len = (uint16_t)(n < (int)sizeof(h->ev) ? n : 0);
+}
+
+/* ---- Responses ---- */
+
+static inline void httpd_respond(struct httpd_conn_s *c, const char *status,
+                                 const char *type, const char *body,
+                                 int len, const char *extra)
+{
+  char head[192];
+  int n;
+
+  n = snprintf(head, sizeof(head),
+               "HTTP/1.1 %s\r\n"
+               "Content-Type: %s\r\n"
+               "Content-Length: %d\r\n"
+               "Access-Control-Allow-Origin: *\r\n"
+               "Cache-Control: no-store\r\n"
+               "%s"
+               "Connection: close\r\n\r\n",
+               status, type, len, extra ? extra : "");
+
+  c->state = HTTPD_RESPONDING;
+  httpd_queue(c, head, n);
+  httpd_queue(c, body, len);
+}
+
+static inline void httpd_error(struct httpd_conn_s *c, const char *status,
+                               const char *extra)
+{
+  char body[48];
+  int n = snprintf(body, sizeof(body), "%s\n", status);
+
+  httpd_respond(c, status, "text/plain", body, n, extra);
+}
+
+static inline void httpd_subscribe(struct httpd_s *h,
+                                   struct httpd_conn_s *c)
+{
+  char head[192];
+  int n;
+
+  n = snprintf(head, sizeof(head),
+               "HTTP/1.1 200 OK\r\n"
+               "Content-Type: text/event-stream\r\n"
+               "Access-Control-Allow-Origin: *\r\n"
+               "Cache-Control: no-store\r\n"
+               "Connection: keep-alive\r\n\r\n"
+               "retry: %d\n\n", HTTPD_RETRY_MS);
+
+  c->state = HTTPD_STREAMING;
+  httpd_queue(c, head, n);
+
+  /* Start from the current state; ids then follow the shared stream */
+
+  if (h->valid)
+    {
+      httpd_format_event(h);
+      httpd_queue(c, h->ev, h->ev_len);
+    }
+}
+
+static inline void httpd_request(struct httpd_s *h, struct httpd_conn_s *c)
+{
+  char body[HTTPD_BODY_MAX];
+  char *path;
+  char *end;
+  int n;
+
+  h->stats.requests++;
+
+  path = strchr(c->rx, ' ');
+  end  = path ? strpbrk(path + 1, " ?\r") : NULL;
+  if (path == NULL || end == NULL || strncmp(c->rx, "GET ", 4) != 0)
+    {
+      if (path != NULL && end != NULL)
+        {
+          httpd_error(c, "405 Method Not Allowed", "Allow: GET\r\n");
+        }
+      else
+        {
+          httpd_error(c, "400 Bad Request", NULL);
+        }
+
+      return;
+    }
+
+  path++;
+  *end = '\0';
+
+  if (strcmp(path, "/events") == 0)
+    {
+      httpd_subscribe(h, c);
+    }
+  else if (strcmp(path, "/state") != 0 && strcmp(path, "/gates") != 0)
+    {
+      httpd_error(c, "404 Not Found", NULL);
+    }
+  else if (!h->valid || (path[1] == 'g' && !h->gates))
+    {
+      httpd_error(c, "503 Service Unavailable", "Retry-After: 1\r\n");
+    }
+  else
+    {
+      n = path[1] == 'g' ? httpd_json_gates(h, body, sizeof(body))
+                         : httpd_json_state(h, body, sizeof(body));
+      if (n < 0)
+        {
+          httpd_error(c, "500 Internal Server Error", NULL);
+          return;
+        }
+
+      httpd_respond(c, "200 OK", "application/json", body, n, NULL);
+    }
+}
+
+/* ---- Driving the server ---- */
+
+/*
+ * Send what is queued on a slot. Returns 0, HTTPD_CLOSE once a one-shot
+ * response is fully sent, or a negative errno from the send callback.
+ */
+static inline int httpd_flush(struct httpd_s *h, int slot, uint32_t now)
+{
+  struct httpd_conn_s *c = &h->conns[slot];
+
+  while (c->tx_off < c->tx_len)
+    {
+      ssize_t n = h->send(h->arg, slot, c->tx + c->tx_off,
+                          c->tx_len - c->tx_off);
+      if (n < 0)
+        {
+          return (int)n;
+        }
+
+      if (n == 0)
+        {
+          return OK;
+        }
+
+      c->tx_off    += (uint16_t)n;
+      c->last_tx_ms = now;
+    }
+
+  if (c->state == HTTPD_RESPONDING)
+    {
+      return HTTPD_CLOSE;
+    }
+
+  /* Drained: a subscriber that missed events catches up on the latest */
+
+  if (c->state == HTTPD_STREAMING && c->stale)
+    {
+      c->stale = false;
+      httpd_queue(c, h->ev, h->ev_len);
+      return httpd_flush(h, slot, now);
+    }
+
+  return OK;
+}
+
+/*
+ * Bytes received on a slot. Once the request head is complete it is
+ * answered and the response flushed as far as the socket allows.
+ * Anything a subscriber sends afterwards is ignored. Returns as
+ * httpd_flush().
+ */
+static inline int httpd_input(struct httpd_s *h, int slot, const char *buf,
+                              size_t len, uint32_t now)
+{
+  struct httpd_conn_s *c = &h->conns[slot];
+  size_t room;
+
+  if (c->state != HTTPD_READING)
+    {
+      return OK;
+    }
+
+  room = sizeof(c->rx) - 1 - c->rx_len;
+  if (len > room)
+    {
+      httpd_error(c, "431 Request Header Fields Too Large", NULL);
+      return httpd_flush(h, slot, now);
+    }
+
+  memcpy(c->rx + c->rx_len, buf, len);
+  c->rx_len += (uint16_t)len;
+  c->rx[c->rx_len] = '\0';
+
+  if (strstr(c->rx, "\r\n\r\n") == NULL)
+    {
+      return OK;
+    }
+
+  httpd_request(h, c);
+  return httpd_flush(h, slot, now);
+}
+
+/* True if d differs from the last published state enough to publish */
+
+static inline bool httpd_moved(const struct mmwave_data_s *a,
+                               const struct mmwave_data_s *b)
+{
+  return a->motion_energy != b->motion_energy ||
+         a->static_energy != b->static_energy ||
+         a->motion_distance != b->motion_distance ||
+         a->static_distance != b->static_distance ||
+         a->detection_distance != b->detection_distance;
+}
+
+/*
+ * New sensor reading (one reader for all clients). Publishes an event
+ * at once when the target state changes, and for other field changes
+ * at most every CONFIG_HTTPD_EVENT_MS. Returns true if an event went
+ * out to the subscribers' buffers; the caller then flushes them.
+ */
+static inline bool httpd_update(struct httpd_s *h,
+                                const struct mmwave_eng_data_s *eng,
+                                bool gates, uint32_t now)
+{
+  bool first = !h->valid;
+
+  h->cur   = *eng;
+  h->valid = true;
+  h->gates = gates;
+
+  if (!first && eng->basic.target_state == h->last.target_state &&
+      (!httpd_moved(&eng->basic, &h->last) ||
+       now - h->last_ev_ms < CONFIG_HTTPD_EVENT_MS))
+    {
+      return false;
+    }
+
+  h->last       = eng->basic;
+  h->last_ev_ms = now;
+  h->event_id++;
+  h->stats.events++;
+  httpd_format_event(h);
+
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      struct httpd_conn_s *c = &h->conns[i];
+
+      if (c->state == HTTPD_STREAMING && !c->stale &&
+          !httpd_queue(c, h->ev, h->ev_len))
+        {
+          c->stale = true;
+        }
+
+      h->stats.coalesced += c->state == HTTPD_STREAMING && c->stale;
+    }
+
+  return true;
+}
+
+/*
+ * Periodic work for one slot: drop requests that never complete, and
+ * send an SSE comment on a quiet stream so proxies keep it open and a
+ * vanished client is noticed. Returns HTTPD_CLOSE if the slot should
+ * close, else as httpd_flush().
+ */
+static inline int httpd_tick(struct httpd_s *h, int slot, uint32_t now)
+{
+  struct httpd_conn_s *c = &h->conns[slot];
+
+  if (c->state == HTTPD_READING &&
+      now - c->opened_ms >= HTTPD_HEAD_TIMEOUT_MS)
+    {
+      h->stats.timeouts++;
+      return HTTPD_CLOSE;
+    }
+
+  if (c->state == HTTPD_STREAMING && !httpd_wants_write(h, slot) &&
+      now - c->last_tx_ms >= HTTPD_HEARTBEAT_MS)
+    {
+      httpd_queue(c, ": ping\n\n", 8);
+    }
+
+  return httpd_wants_write(h, slot) ? httpd_flush(h, slot, now) : OK;
+}
+
+#endif /* __APPS_HTTPD_HTTPD_H */
@@ -0,0 +1,438 @@
+/****************************************************************************
+ * apps/httpd/httpd_cmd.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * NSH command: httpd — HTTP server with a live event stream
+ *
+ * Usage:
+ *   httpd start               — Start the HTTP server (in mmwaved if
+ *                               it is running, else in its own task)
+ *   httpd stop                — Stop it and close all connections
+ *   httpd status              — Show server state and connections
+ *
+ * Endpoints (GET only):
+ *   /state      JSON snapshot of the latest reading
+ *   /gates      per-gate energies (needs `mmwave -e on`)
+ *   /events     Server-Sent Events, one `state` event per change
+ *
+ * e.g. from a host:
+ *   curl -N http://<device>/events
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_service.h"
+#include "httpd.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_HTTPD_PORT
+#  define CONFIG_HTTPD_PORT     80
+#endif
+
+#define HTTPD_TICK_MS           100    /* Timeouts and keep-alives */
+#define HTTPD_BACKLOG           2
+#define HTTPD_TASK_STACK        2048
+
+/* Sent to a client that arrives while every slot is taken */
+
+#define HTTPD_BUSY_RESPONSE \
+  "HTTP/1.1 503 Service Unavailable\r\nRetry-After: 5\r\n" \
+  "Content-Length: 0\r\nConnection: close\r\n\r\n"
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int      httpd_start(void);
+static void     httpd_pollset(FAR struct pollfd *pfds);
+static int      httpd_events(FAR const struct pollfd *pfds, uint32_t now);
+static void     httpd_frame(FAR const struct mmwave_eng_data_s *eng,
+                            bool gates, uint32_t now);
+static uint32_t httpd_tick_slots(uint32_t now);
+static void     httpd_stop(void);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Slot table and buffers live here, not on the task stack */
+
+static struct httpd_s g_server;
+static int            g_fds[CONFIG_HTTPD_SLOTS];
+static int            g_listenfd = -1;
+static volatile bool  g_running = false;
+static pid_t          g_server_pid = -1;
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* Run by the httpd task, or hosted by mmwaved */
+
+const struct mmwave_service_s g_httpd_service =
+{
+  "httpd", &g_running, CONFIG_HTTPD_SLOTS + 1, HTTPD_TASK_STACK,
+  httpd_start, httpd_pollset, httpd_events, httpd_frame, httpd_tick_slots,
+  httpd_stop
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/* httpd_send_t over the slot's socket, never blocking */
+
+static ssize_t httpd_tcp_send(FAR void *arg, int slot, FAR const void *buf,
+                              size_t len)
+{
+  ssize_t n = send(g_fds[slot], buf, len, MSG_DONTWAIT);
+
+  if (n < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -errno;
+    }
+
+  return n;
+}
+
+static int httpd_listen(void)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(CONFIG_HTTPD_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(fd, (FAR struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, HTTPD_BACKLOG) < 0)
+    {
+      int ret = -errno;
+      close(fd);
+      return ret;
+    }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+static void httpd_drop(int slot)
+{
+  httpd_close(&g_server, slot);
+  close(g_fds[slot]);
+  g_fds[slot] = -1;
+}
+
+/* Take every pending connection; refuse politely when slots are full */
+
+static void httpd_accept(int listenfd)
+{
+  for (; ; )
+    {
+      int fd = accept(listenfd, NULL, NULL);
+      int slot;
+
+      if (fd < 0)
+        {
+          return;
+        }
+
+      slot = httpd_open(&g_server, mmwave_service_now_ms());
+      if (slot < 0)
+        {
+          send(fd, HTTPD_BUSY_RESPONSE, sizeof(HTTPD_BUSY_RESPONSE) - 1,
+               MSG_DONTWAIT);
+          close(fd);
+          continue;
+        }
+
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      g_fds[slot] = fd;
+    }
+}
+
+static void httpd_receive(int slot)
+{
+  char buf[128];
+  ssize_t n;
+  int ret = OK;
+
+  while (ret == OK &&
+         (n = recv(g_fds[slot], buf, sizeof(buf), MSG_DONTWAIT)) > 0)
+    {
+      ret = httpd_input(&g_server, slot, buf, n, mmwave_service_now_ms());
+    }
+
+  /* Orderly shutdown or a reset from the peer */
+
+  if (ret != OK || n == 0 || (n < 0 && errno != EAGAIN &&
+                              errno != EWOULDBLOCK))
+    {
+      httpd_drop(slot);
+    }
+}
+
+/* Listener failure is fatal; a slot only drops its own connection */
+
+static int httpd_events(FAR const struct pollfd *pfds, uint32_t now)
+{
+  if (pfds[0].revents & (POLLERR | POLLNVAL))
+    {
+      return -EIO;
+    }
+
+  if (pfds[0].revents & POLLIN)
+    {
+      httpd_accept(g_listenfd);
+    }
+
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      FAR const struct pollfd *pfd = &pfds[i + 1];
+
+      if (g_fds[i] < 0 || pfd->fd != g_fds[i])
+        {
+          continue;
+        }
+
+      if (pfd->revents & (POLLIN | POLLHUP | POLLERR))
+        {
+          httpd_receive(i);
+        }
+      else if ((pfd->revents & POLLOUT) &&
+               httpd_flush(&g_server, i, now) != OK)
+        {
+          httpd_drop(i);
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: httpd_frame
+ *
+ * Description:
+ *   One reader for all clients: each sensor frame goes to the server,
+ *   which fans any resulting event out to every subscriber's buffer, and
+ *   the slots are flushed at once as far as their sockets allow.
+ *
+ ****************************************************************************/
+
+static void httpd_frame(FAR const struct mmwave_eng_data_s *eng,
+                        bool gates, uint32_t now)
+{
+  if (!httpd_update(&g_server, eng, gates, now))
+    {
+      return;
+    }
+
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      if (g_fds[i] >= 0 && httpd_wants_write(&g_server, i) &&
+          httpd_flush(&g_server, i, now) != OK)
+        {
+          httpd_drop(i);
+        }
+    }
+}
+
+/* Request timeouts and keep-alive comments */
+
+static uint32_t httpd_tick_slots(uint32_t now)
+{
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      if (g_fds[i] >= 0 && httpd_tick(&g_server, i, now) != OK)
+        {
+          httpd_drop(i);
+        }
+    }
+
+  return HTTPD_TICK_MS;
+}
+
+static int httpd_start(void)
+{
+  g_listenfd = httpd_listen();
+  if (g_listenfd < 0)
+    {
+      fprintf(stderr, "httpd: cannot listen on port %u: %d\n",
+              CONFIG_HTTPD_PORT, g_listenfd);
+      return g_listenfd;
+    }
+
+  httpd_init(&g_server, httpd_tcp_send, NULL);
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      g_fds[i] = -1;
+    }
+
+  printf("httpd: listening on tcp port %u (%d slots)\n",
+         CONFIG_HTTPD_PORT, CONFIG_HTTPD_SLOTS);
+  return OK;
+}
+
+/* POLLOUT only on slots with unsent data */
+
+static void httpd_pollset(FAR struct pollfd *pfds)
+{
+  pfds[0].fd     = g_listenfd;
+  pfds[0].events = POLLIN;
+
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      pfds[i + 1].fd     = g_fds[i];
+      pfds[i + 1].events = POLLIN;
+      if (g_fds[i] >= 0 && httpd_wants_write(&g_server, i))
+        {
+          pfds[i + 1].events |= POLLOUT;
+        }
+    }
+}
+
+static void httpd_stop(void)
+{
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      if (g_fds[i] >= 0)
+        {
+          httpd_drop(i);
+        }
+    }
+
+  close(g_listenfd);
+  g_listenfd = -1;
+  printf("httpd: server stopped\n");
+}
+
+static int httpd_server_task(int argc, FAR char *argv[])
+{
+  return mmwave_service_run(&g_httpd_service);
+}
+
+static void print_status(void)
+{
+  FAR const struct httpd_stats_s *st = &g_server.stats;
+  int used = 0;
+
+  for (int i = 0; g_running && i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      used += g_server.conns[i].state != HTTPD_FREE;
+    }
+
+  printf("HTTP Server\n");
+  printf("───────────\n");
+  printf("  Server    : %s\n", g_running ? "RUNNING" : "stopped");
+  printf("  Port      : %u/tcp\n", CONFIG_HTTPD_PORT);
+  printf("  Gates     : %s\n", g_server.gates ?
+         "available" : "engineering mode off");
+  printf("  Slots     : %d of %d in use, %d streaming\n", used,
+         CONFIG_HTTPD_SLOTS, g_running ? httpd_streaming(&g_server) : 0);
+  printf("  Traffic   : %lu requests, %lu events\n",
+         (unsigned long)st->requests, (unsigned long)st->events);
+  printf("  Dropped   : %lu refused (slots full), %lu coalesced, "
+         "%lu timed out\n", (unsigned long)st->refused,
+         (unsigned long)st->coalesced, (unsigned long)st->timeouts);
+}
+
+static void print_usage(void)
+{
+  printf("Usage: httpd <command>\n\n");
+  printf("Commands:\n");
+  printf("  start    Start the HTTP server\n");
+  printf("  stop     Stop the server\n");
+  printf("  status   Show server state and counters\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  if (argc < 2)
+    {
+      print_usage();
+      return EXIT_FAILURE;
+    }
+
+  FAR const char *cmd = argv[1];
+
+  if (strcmp(cmd, "status") == 0)
+    {
+      print_status();
+    }
+  else if (strcmp(cmd, "start") == 0)
+    {
+      if (g_running)
+        {
+          printf("httpd: server already running\n");
+          return OK;
+        }
+
+      int ret = mmwave_service_delegate(&g_httpd_service);
+      if (ret != -ESRCH)
+        {
+          return ret == OK ? OK : EXIT_FAILURE;
+        }
+
+      g_running = true;
+
+      g_server_pid = task_create("httpd",
+                                 100,    /* priority */
+                                 HTTPD_TASK_STACK,
+                                 httpd_server_task,
+                                 NULL);
+      if (g_server_pid < 0)
+        {
+          g_running = false;
+          fprintf(stderr, "httpd: failed to start task\n");
+          return EXIT_FAILURE;
+        }
+    }
+  else if (strcmp(cmd, "stop") == 0)
+    {
+      printf("httpd: stopping...\n");
+      mmwave_service_stop(&g_httpd_service);
+    }
+  else
+    {
+      print_usage();
+    }
+
+  return OK;
+}
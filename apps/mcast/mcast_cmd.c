@@ -0,0 +1,403 @@
+/****************************************************************************
+ * apps/mcast/mcast_cmd.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * NSH command: mcast — UDP multicast presence stream
+ *
+ * Usage:
+ *   mcast start [-g group] [-r hz]  — Start streaming frames (in mmwaved
+ *                                     if it is running)
+ *   mcast stop                      — Stop streaming
+ *   mcast status                    — Show stream settings and counters
+ *
+ * Each tick the latest sensor sample is packed into one compact binary
+ * datagram (apps/mcast/mcast_frame.h) and sent to the multicast group,
+ * for a local fusion controller taking several devices at 10 Hz. Gate
+ * energies are included while engineering mode is on.
+ *
+ * Group and rate default to Kconfig, then the config keys mcast.group
+ * and mcast.rate, then the command line.
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <sched.h>
+#include <time.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#ifdef CONFIG_NETUTILS_NETLIB
+#  include "netutils/netlib.h"
+#endif
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_service.h"
+#include "apps/config/config_svc.h"
+#include "mcast_frame.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_MCAST_GROUP
+#  define CONFIG_MCAST_GROUP    "239.255.41.10"
+#endif
+
+#ifndef CONFIG_MCAST_PORT
+#  define CONFIG_MCAST_PORT     41234
+#endif
+
+#ifndef CONFIG_MCAST_RATE_HZ
+#  define CONFIG_MCAST_RATE_HZ  10
+#endif
+
+#define MCAST_IFNAME            "wlan0"
+#define MCAST_RATE_MAX          50     /* Sensor frames arrive at ~20 Hz */
+#define MCAST_TTL               1      /* Stay on the local segment */
+#define MCAST_TASK_STACK        2048
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+struct mcast_stats_s
+{
+  uint32_t sent;
+  uint32_t send_errors;
+  uint32_t no_sample;   /* Ticks skipped: sensor had no data yet */
+  uint32_t late;        /* Ticks that started after their deadline */
+};
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int      mcast_start(void);
+static void     mcast_frame(FAR const struct mmwave_eng_data_s *eng,
+                            bool gates, uint32_t now);
+static uint32_t mcast_tick(uint32_t now_ms);
+static void     mcast_stop(void);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* The send path touches only these: no allocation per frame */
+
+static struct mcast_enc_s   g_enc;
+static struct mcast_stats_s g_stats;
+static struct sockaddr_in   g_dest;
+static uint8_t              g_tx[MCAST_FRAME_MAX];
+static struct mmwave_eng_data_s g_sample;   /* Latest frame */
+static bool                 g_sample_gates;
+static bool                 g_have_sample;
+static uint64_t             g_next_us;      /* Next send deadline */
+static int                  g_sockfd = -1;
+
+static char                 g_group[INET_ADDRSTRLEN] = CONFIG_MCAST_GROUP;
+static int                  g_rate_hz = CONFIG_MCAST_RATE_HZ;
+static volatile bool        g_running = false;
+static pid_t                g_task_pid = -1;
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* Run by the mcast_tx task, or hosted by mmwaved */
+
+const struct mmwave_service_s g_mcast_service =
+{
+  "mcast", &g_running, 0, MCAST_TASK_STACK,
+  mcast_start, NULL, NULL, mcast_frame, mcast_tick, mcast_stop
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static bool mcast_group_valid(FAR const char *group)
+{
+  struct in_addr in;
+
+  return inet_pton(AF_INET, group, &in) == 1 &&
+         IN_MULTICAST(ntohl(in.s_addr));
+}
+
+/* Persistent defaults come from the config service, already in RAM */
+
+static void mcast_load_config(void)
+{
+#ifdef CONFIG_CONFIG_CMD
+  char group[INET_ADDRSTRLEN];
+  long hz;
+
+  config_svc_get_str("mcast.group", group, sizeof(group), "");
+  if (mcast_group_valid(group))
+    {
+      strlcpy(g_group, group, sizeof(g_group));
+    }
+
+  hz = config_svc_get_int("mcast.rate", 0);
+  if (hz >= 1 && hz <= MCAST_RATE_MAX)
+    {
+      g_rate_hz = (int)hz;
+    }
+#endif
+}
+
+/* Low 32 bits of the MAC, so frames from each device stay apart */
+
+static uint32_t mcast_device_id_local(void)
+{
+#ifdef CONFIG_NETUTILS_NETLIB
+  uint8_t mac[6];
+
+  if (netlib_getmacaddr(MCAST_IFNAME, mac) == OK)
+    {
+      return (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+             (uint32_t)mac[4] << 8 | mac[5];
+    }
+#endif
+
+  return 1;
+}
+
+static int mcast_socket(void)
+{
+  int ttl = MCAST_TTL;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+#ifdef IP_MULTICAST_TTL
+  setsockopt(fd, IPPROTO_IP, IP_MULTICAST_TTL, &ttl, sizeof(ttl));
+#endif
+
+  memset(&g_dest, 0, sizeof(g_dest));
+  g_dest.sin_family = AF_INET;
+  g_dest.sin_port   = htons(CONFIG_MCAST_PORT);
+  inet_pton(AF_INET, g_group, &g_dest.sin_addr);
+  return fd;
+}
+
+static int mcast_start(void)
+{
+  g_sockfd = mcast_socket();
+  if (g_sockfd < 0)
+    {
+      fprintf(stderr, "mcast: socket failed: %d\n", g_sockfd);
+      return g_sockfd;
+    }
+
+  mcast_enc_init(&g_enc, mcast_device_id_local(), 0);
+  g_have_sample = false;
+  g_next_us     = mmwave_service_now_us() + 1000000 / g_rate_hz;
+
+  printf("mcast: device %08lx streaming to %s:%u at %d Hz\n",
+         (unsigned long)g_enc.device_id, g_group, CONFIG_MCAST_PORT,
+         g_rate_hz);
+  return OK;
+}
+
+/* Keep the latest frame; ticks send at their own rate */
+
+static void mcast_frame(FAR const struct mmwave_eng_data_s *eng,
+                        bool gates, uint32_t now)
+{
+  g_sample       = *eng;
+  g_sample_gates = gates;
+  g_have_sample  = true;
+}
+
+/****************************************************************************
+ * Name: mcast_tick
+ *
+ * Description:
+ *   Fixed-rate sender. Deadlines are absolute so the rate does not drift
+ *   with the time spent sending; a tick that starts late is counted and
+ *   the schedule re-anchored rather than bursting to catch up.
+ *
+ ****************************************************************************/
+
+static uint32_t mcast_tick(uint32_t now_ms)
+{
+  uint64_t period_us = 1000000 / g_rate_hz;
+  uint64_t now = mmwave_service_now_us();
+  int len;
+
+  if (now < g_next_us)
+    {
+      return (uint32_t)((g_next_us - now + 999) / 1000);
+    }
+
+  if (now > g_next_us + period_us / 2)
+    {
+      g_stats.late++;
+      g_next_us = now;
+    }
+
+  g_next_us += period_us;
+
+  if (!g_have_sample)
+    {
+      g_stats.no_sample++;
+    }
+  else
+    {
+      len = mcast_encode(&g_enc, g_tx, sizeof(g_tx), &g_sample,
+                         g_sample_gates, now);
+      if (sendto(g_sockfd, g_tx, len, 0, (FAR struct sockaddr *)&g_dest,
+                 sizeof(g_dest)) == len)
+        {
+          g_stats.sent++;
+        }
+      else
+        {
+          g_stats.send_errors++;
+        }
+    }
+
+  now = mmwave_service_now_us();
+  return g_next_us > now ? (uint32_t)((g_next_us - now + 999) / 1000) : 0;
+}
+
+static void mcast_stop(void)
+{
+  close(g_sockfd);
+  g_sockfd = -1;
+  printf("mcast: stopped\n");
+}
+
+static int mcast_task(int argc, FAR char *argv[])
+{
+  return mmwave_service_run(&g_mcast_service);
+}
+
+static void print_status(void)
+{
+  printf("Multicast Stream\n");
+  printf("────────────────\n");
+  printf("  Stream   : %s\n", g_running ? "RUNNING" : "stopped");
+  printf("  Group    : %s:%u (ttl %d)\n", g_group, CONFIG_MCAST_PORT,
+         MCAST_TTL);
+  printf("  Rate     : %d Hz\n", g_rate_hz);
+  printf("  Device   : %08lx\n", (unsigned long)g_enc.device_id);
+  printf("  Frames   : %lu sent (%lu key, %lu delta gates), %lu errors\n",
+         (unsigned long)g_stats.sent, (unsigned long)g_enc.key_frames,
+         (unsigned long)g_enc.delta_frames,
+         (unsigned long)g_stats.send_errors);
+  printf("  Bytes    : %lu (%lu avg/frame)\n", (unsigned long)g_enc.bytes,
+         (unsigned long)(g_enc.frames ? g_enc.bytes / g_enc.frames : 0));
+  printf("  Skipped  : %lu no sample, %lu late ticks\n",
+         (unsigned long)g_stats.no_sample, (unsigned long)g_stats.late);
+}
+
+static void print_usage(void)
+{
+  printf("Usage: mcast <command> [options]\n\n");
+  printf("Commands:\n");
+  printf("  start [-g group] [-r hz]   Start streaming (rate 1-%d)\n",
+         MCAST_RATE_MAX);
+  printf("  stop                       Stop streaming\n");
+  printf("  status                     Show settings and counters\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  if (argc < 2)
+    {
+      print_usage();
+      return EXIT_FAILURE;
+    }
+
+  FAR const char *cmd = argv[1];
+
+  if (strcmp(cmd, "status") == 0)
+    {
+      print_status();
+    }
+  else if (strcmp(cmd, "start") == 0)
+    {
+      if (g_running)
+        {
+          printf("mcast: already running\n");
+          return OK;
+        }
+
+      mcast_load_config();
+
+      for (int i = 2; i + 1 < argc; i += 2)
+        {
+          if (strcmp(argv[i], "-g") == 0 && mcast_group_valid(argv[i + 1]))
+            {
+              strlcpy(g_group, argv[i + 1], sizeof(g_group));
+            }
+          else if (strcmp(argv[i], "-r") == 0 &&
+                   atoi(argv[i + 1]) >= 1 &&
+                   atoi(argv[i + 1]) <= MCAST_RATE_MAX)
+            {
+              g_rate_hz = atoi(argv[i + 1]);
+            }
+          else
+            {
+              print_usage();
+              return EXIT_FAILURE;
+            }
+        }
+
+      memset(&g_stats, 0, sizeof(g_stats));
+
+      int ret = mmwave_service_delegate(&g_mcast_service);
+      if (ret != -ESRCH)
+        {
+          return ret == OK ? OK : EXIT_FAILURE;
+        }
+
+      g_running = true;
+
+      g_task_pid = task_create("mcast_tx",
+                               100,    /* priority */
+                               MCAST_TASK_STACK,
+                               mcast_task,
+                               NULL);
+      if (g_task_pid < 0)
+        {
+          g_running = false;
+          fprintf(stderr, "mcast: failed to start task\n");
+          return EXIT_FAILURE;
+        }
+    }
+  else if (strcmp(cmd, "stop") == 0)
+    {
+      printf("mcast: stopping...\n");
+      mmwave_service_stop(&g_mcast_service);
+    }
+  else
+    {
+      print_usage();
+    }
+
+  return OK;
+}
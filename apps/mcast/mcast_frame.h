@@ -0,0 +1,388 @@
+/*
+ * apps/mcast/mcast_frame.h
+ *
+ * Compact binary presence datagram for UDP multicast to a local fusion
+ * controller. One frame per sample, fixed header, all fields big-endian:
+ *
+ *   0  'm' 'w'              magic
+ *   2  version              MCAST_VERSION
+ *   3  flags                MCAST_F_xxx
+ *   4  device id            u32
+ *   8  sequence             u32, +1 per frame
+ *   12 timestamp            u64, microseconds (sender's monotonic clock)
+ *   20 target state         u8
+ *   21 motion, static       u8 energies
+ *   23 motion, static,      u16 distances (cm)
+ *      detection distance
+ *   29 gates (optional)
+ *
+ * Gate energies are quantised to 4 bits (0-15 over 0-100) and sent as
+ * 18 nibbles, motion gates 0-8 then static gates 0-8. A key frame
+ * carries all 18 (9 bytes). Frames in between carry only the nibbles
+ * that differ from the last key frame: its age in frames (u8), a 24-bit
+ * mask of changed nibbles, then the changed nibbles packed high-first.
+ * Deltas are against the key, not the previous frame, so a lost
+ * datagram costs only itself. When a delta would be no smaller than a
+ * key frame the encoder sends a new key instead.
+ *
+ * Encoding writes into the caller's buffer; nothing is allocated.
+ */
+
+#ifndef __APPS_MCAST_MCAST_FRAME_H
+#define __APPS_MCAST_MCAST_FRAME_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+#define MCAST_VERSION         1
+#define MCAST_MAGIC0          'm'
+#define MCAST_MAGIC1          'w'
+
+#define MCAST_F_GATES         0x01    /* Gate energies follow */
+#define MCAST_F_KEY           0x02    /* ... as a full key frame */
+
+#define MCAST_NIBBLES         (2 * LD2410_MAX_GATES)
+#define MCAST_KEY_BYTES       (MCAST_NIBBLES / 2)
+#define MCAST_HDR_LEN         20
+#define MCAST_BASIC_LEN       29
+#define MCAST_FRAME_MAX       (MCAST_BASIC_LEN + MCAST_KEY_BYTES)
+
+/* Delta prefix: key age + 24-bit change mask */
+
+#define MCAST_DELTA_HDR       4
+
+#ifndef CONFIG_MCAST_KEY_EVERY
+#  define CONFIG_MCAST_KEY_EVERY 20
+#endif
+
+/* ---- Byte order helpers ---- */
+
+static inline void mcast_put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static inline void mcast_put32(uint8_t *p, uint32_t v)
+{
+  mcast_put16(p, (uint16_t)(v >> 16));
+  mcast_put16(p + 2, (uint16_t)v);
+}
+
+static inline uint16_t mcast_get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t mcast_get32(const uint8_t *p)
+{
+  return (uint32_t)mcast_get16(p) << 16 | mcast_get16(p + 2);
+}
+
+/* ---- Quantisation ---- */
+
+static inline uint8_t mcast_quant(uint8_t energy)
+{
+  return (uint8_t)(((energy > 100 ? 100 : energy) * 15 + 50) / 100);
+}
+
+static inline uint8_t mcast_dequant(uint8_t q)
+{
+  return (uint8_t)((q * 100 + 7) / 15);
+}
+
+static inline void mcast_quant_gates(const struct mmwave_eng_data_s *e,
+                                     uint8_t q[MCAST_NIBBLES])
+{
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      q[i]                    = mcast_quant(e->motion_gate_energy[i]);
+      q[LD2410_MAX_GATES + i] = mcast_quant(e->static_gate_energy[i]);
+    }
+}
+
+/* Pack n nibbles high-first; returns bytes written */
+
+static inline size_t mcast_pack(uint8_t *p, const uint8_t *nib, int n)
+{
+  for (int i = 0; i < n; i++)
+    {
+      if (i & 1)
+        {
+          p[i / 2] |= nib[i];
+        }
+      else
+        {
+          p[i / 2] = (uint8_t)(nib[i] << 4);
+        }
+    }
+
+  return (size_t)(n + 1) / 2;
+}
+
+static inline uint8_t mcast_nibble(const uint8_t *p, int i)
+{
+  return i & 1 ? p[i / 2] & 0x0f : p[i / 2] >> 4;
+}
+
+/* ---- Encoder ---- */
+
+struct mcast_enc_s
+{
+  uint32_t device_id;
+  uint32_t seq;                     /* Next frame's sequence number */
+  bool     have_key;
+  uint32_t key_seq;
+  uint16_t key_every;               /* Force a key frame this often */
+  uint8_t  key_q[MCAST_NIBBLES];
+
+  /* Totals, for status output */
+
+  uint32_t frames;
+  uint32_t key_frames;
+  uint32_t delta_frames;
+  uint32_t bytes;
+};
+
+static inline void mcast_enc_init(struct mcast_enc_s *enc,
+                                  uint32_t device_id, uint32_t seq)
+{
+  memset(enc, 0, sizeof(*enc));
+  enc->device_id = device_id;
+  enc->seq       = seq;
+  enc->key_every = CONFIG_MCAST_KEY_EVERY;
+}
+
+/* Write the gate section; returns its length and sets the flags */
+
+static inline size_t mcast_put_gates(struct mcast_enc_s *enc, uint8_t *p,
+                                     const struct mmwave_eng_data_s *e,
+                                     uint8_t *flags)
+{
+  uint8_t q[MCAST_NIBBLES];
+  uint8_t changed[MCAST_NIBBLES];
+  uint32_t age = enc->seq - enc->key_seq;
+  uint32_t mask = 0;
+  int n = 0;
+
+  mcast_quant_gates(e, q);
+
+  if (enc->have_key && age < enc->key_every && age <= UINT8_MAX)
+    {
+      for (int i = 0; i < MCAST_NIBBLES; i++)
+        {
+          if (q[i] != enc->key_q[i])
+            {
+              mask |= 1u << i;
+              changed[n++] = q[i];
+            }
+        }
+
+      if (MCAST_DELTA_HDR + (n + 1) / 2 < MCAST_KEY_BYTES)
+        {
+          p[0] = (uint8_t)age;
+          p[1] = (uint8_t)(mask >> 16);
+          mcast_put16(p + 2, (uint16_t)mask);
+          *flags |= MCAST_F_GATES;
+          enc->delta_frames++;
+          return MCAST_DELTA_HDR +
+                 mcast_pack(p + MCAST_DELTA_HDR, changed, n);
+        }
+    }
+
+  memcpy(enc->key_q, q, sizeof(q));
+  enc->have_key = true;
+  enc->key_seq  = enc->seq;
+  enc->key_frames++;
+  *flags |= MCAST_F_GATES | MCAST_F_KEY;
+  return mcast_pack(p, q, MCAST_NIBBLES);
+}
+
+/*
+ * Encode one frame into buf (at least MCAST_FRAME_MAX bytes). Gate
+ * energies are included when `gates` is set. Returns the datagram
+ * length, or -ENOBUFS if buf is too small.
+ */
+static inline int mcast_encode(struct mcast_enc_s *enc, uint8_t *buf,
+                               size_t size, const struct mmwave_eng_data_s *e,
+                               bool gates, uint64_t ts_us)
+{
+  const struct mmwave_data_s *d = &e->basic;
+  uint8_t flags = 0;
+  size_t len = MCAST_BASIC_LEN;
+
+  if (size < MCAST_FRAME_MAX)
+    {
+      return -ENOBUFS;
+    }
+
+  if (gates)
+    {
+      len += mcast_put_gates(enc, buf + MCAST_BASIC_LEN, e, &flags);
+    }
+
+  buf[0] = MCAST_MAGIC0;
+  buf[1] = MCAST_MAGIC1;
+  buf[2] = MCAST_VERSION;
+  buf[3] = flags;
+  mcast_put32(buf + 4, enc->device_id);
+  mcast_put32(buf + 8, enc->seq);
+  mcast_put32(buf + 12, (uint32_t)(ts_us >> 32));
+  mcast_put32(buf + 16, (uint32_t)ts_us);
+  buf[20] = d->target_state;
+  buf[21] = d->motion_energy;
+  buf[22] = d->static_energy;
+  mcast_put16(buf + 23, d->motion_distance);
+  mcast_put16(buf + 25, d->static_distance);
+  mcast_put16(buf + 27, d->detection_distance);
+
+  enc->seq++;
+  enc->frames++;
+  enc->bytes += (uint32_t)len;
+  return (int)len;
+}
+
+/* ---- Decoder (one per sending device) ---- */
+
+struct mcast_dec_s
+{
+  bool     have_key;
+  uint32_t key_seq;
+  uint8_t  key_q[MCAST_NIBBLES];
+};
+
+struct mcast_frame_s
+{
+  uint32_t device_id;
+  uint32_t seq;
+  uint64_t ts_us;
+  bool     gates;         /* eng gate arrays are valid */
+  bool     gates_lost;    /* Delta frame whose key frame was not seen */
+  struct mmwave_eng_data_s eng;
+};
+
+/* Peek at the device id, to pick the decoder; 0 if not a frame */
+
+static inline uint32_t mcast_device_id(const uint8_t *buf, size_t len)
+{
+  return len >= MCAST_BASIC_LEN && buf[0] == MCAST_MAGIC0 &&
+         buf[1] == MCAST_MAGIC1 ? mcast_get32(buf + 4) : 0;
+}
+
+/*
+ * Decode one datagram. Returns 0, -EBADMSG if it is not a well-formed
+ * frame, or -EPROTONOSUPPORT for another version. A delta frame whose
+ * key frame was lost still decodes; only its gates are marked lost.
+ */
+static inline int mcast_decode(struct mcast_dec_s *dec, const uint8_t *buf,
+                               size_t len, struct mcast_frame_s *f)
+{
+  struct mmwave_data_s *d = &f->eng.basic;
+  const uint8_t *g = buf + MCAST_BASIC_LEN;
+  size_t glen = len - MCAST_BASIC_LEN;
+  uint8_t q[MCAST_NIBBLES];
+
+  if (len < MCAST_BASIC_LEN || buf[0] != MCAST_MAGIC0 ||
+      buf[1] != MCAST_MAGIC1)
+    {
+      return -EBADMSG;
+    }
+
+  if (buf[2] != MCAST_VERSION)
+    {
+      return -EPROTONOSUPPORT;
+    }
+
+  memset(f, 0, sizeof(*f));
+  f->device_id = mcast_get32(buf + 4);
+  f->seq       = mcast_get32(buf + 8);
+  f->ts_us     = (uint64_t)mcast_get32(buf + 12) << 32 |
+                 mcast_get32(buf + 16);
+
+  d->target_state       = buf[20];
+  d->motion_energy      = buf[21];
+  d->static_energy      = buf[22];
+  d->motion_distance    = mcast_get16(buf + 23);
+  d->static_distance    = mcast_get16(buf + 25);
+  d->detection_distance = mcast_get16(buf + 27);
+  d->timestamp_ms       = (uint32_t)(f->ts_us / 1000);
+
+  if (!(buf[3] & MCAST_F_GATES))
+    {
+      return glen == 0 ? OK : -EBADMSG;
+    }
+
+  if (buf[3] & MCAST_F_KEY)
+    {
+      if (glen != MCAST_KEY_BYTES)
+        {
+          return -EBADMSG;
+        }
+
+      for (int i = 0; i < MCAST_NIBBLES; i++)
+        {
+          q[i] = mcast_nibble(g, i);
+        }
+
+      /* A late, reordered key must not replace a newer one */
+
+      if (!dec->have_key || (int32_t)(f->seq - dec->key_seq) > 0)
+        {
+          memcpy(dec->key_q, q, sizeof(q));
+          dec->key_seq  = f->seq;
+          dec->have_key = true;
+        }
+    }
+  else
+    {
+      uint32_t mask;
+      int n = 0;
+
+      if (glen < MCAST_DELTA_HDR)
+        {
+          return -EBADMSG;
+        }
+
+      mask = (uint32_t)g[1] << 16 | mcast_get16(g + 2);
+      for (int i = 0; i < MCAST_NIBBLES; i++)
+        {
+          n += (mask >> i) & 1;
+        }
+
+      if (mask >> MCAST_NIBBLES != 0 || g[0] == 0 ||
+          glen != MCAST_DELTA_HDR + (size_t)(n + 1) / 2)
+        {
+          return -EBADMSG;
+        }
+
+      if (!dec->have_key || f->seq - g[0] != dec->key_seq)
+        {
+          f->gates_lost = true;
+          return OK;
+        }
+
+      memcpy(q, dec->key_q, sizeof(q));
+      for (int i = 0, j = 0; i < MCAST_NIBBLES; i++)
+        {
+          if (mask & (1u << i))
+            {
+              q[i] = mcast_nibble(g + MCAST_DELTA_HDR, j++);
+            }
+        }
+    }
+
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      f->eng.motion_gate_energy[i] = mcast_dequant(q[i]);
+      f->eng.static_gate_energy[i] = mcast_dequant(q[LD2410_MAX_GATES + i]);
+    }
+
+  f->gates = true;
+  return OK;
+}
+
+#endif /* __APPS_MCAST_MCAST_FRAME_H */
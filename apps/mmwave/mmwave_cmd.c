@@ -11,10 +11,32 @@
  *   mmwave -e [on|off]  — Enable/disable engineering mode
  *   mmwave -s <gate> <motion> <static>  — Set gate sensitivity
  *   mmwave -g <motion_max> <static_max> <timeout>  — Set max gates
+ *   mmwave -c           — Print the sensor's gates and thresholds
  *   mmwave -r           — Restart sensor
  *   mmwave -f           — Factory reset sensor
  *   mmwave -j           — Output as JSON (for scripting)
  *   mmwave -h           — Help
+ *   mmwave profile save|load|delete <name>  — Named sensor profiles
+ *   mmwave profile [list]                   — Profiles and schedule
+ *   mmwave profile start|stop               — Switch them on schedule
+ *
+ * -e/-s/-g/-r/-f go through mmwaved when it runs, so its sensor watchdog
+ * knows the pause that follows is deliberate. What -s and -g set is also
+ * saved as mmwave.* config keys (apps/common/mmwave_tune.h), so the
+ * sensor is brought back to it after a power cycle.
+ *
+ * A profile (apps/common/mmwave_profile.h) is the whole configuration
+ * under a name. `profile load` applies it in one config session with
+ * only the commands that differ, saves it as the mmwave.* keys in the
+ * same config transaction, and reports how long the switch took and
+ * the longest gap in the sensor's frames around it. The scheduler is a
+ * service like mcast's: hosted by mmwaved when it runs, else a task. A
+ * switch waits on the sensor's acks, so it runs in a short-lived
+ * mmwave_switch task (through mmwaved, like `profile load`, when the
+ * daemon is up) and the scheduler collects the result on a later tick.
+ * Its switches are not written to flash - presence rules could fire
+ * many times a day - so a restart re-derives the profile from the
+ * clock.
  *
  ****************************************************************************/
 
@@ -30,10 +52,19 @@
 #include <fcntl.h>
 #include <unistd.h>
 #include <errno.h>
-#include <sys/ioctl.h>
+#include <poll.h>
+#include <sched.h>
+#include <semaphore.h>
 #include <signal.h>
+#include <syslog.h>
+#include <time.h>
+#include <sys/ioctl.h>
 
 #include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_json.h"
+#include "apps/common/mmwave_service.h"
+#include "apps/common/mmwave_tune.h"
+#include "apps/common/mmwave_profile.h"
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -41,46 +72,83 @@
 
 #define MMWAVE_DEV_PATH   "/dev/mmwave0"
 
+#define PROFILE_WAIT_MS      2000  /* For the first frame after a switch */
+#define PROFILE_TICK_MS      1000
+#define PROFILE_STACK        2048
+#define PROFILE_SWITCH_STACK 2048  /* A switch's mmwave_switch task */
+#define PROFILE_SWITCH_MS    100   /* Checking on it */
+#define PROFILE_CLOCK_SET    2024  /* An earlier year: the clock is not set */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+#ifdef CONFIG_MMWAVE_PROFILE
+/* The scheduler's switch in flight, at most one: the mmwave_switch task
+ * applies cfg, stores ret and posts done; the scheduler takes done
+ * without waiting and clears busy.
+ */
+
+struct profile_switch_s
+{
+  struct mmwave_config_s cfg;
+  char   name[MMWAVE_PROFILE_NAME_MAX + 1];
+  int    ret;
+  bool   busy;                  /* Started, not yet collected */
+  bool   init;                  /* done is initialised */
+  sem_t  done;                  /* Posted by the task once ret is set */
+};
+#endif
+
 /****************************************************************************
  * Private Data
  ****************************************************************************/
 
 static volatile bool g_watch_running = false;
 
+#ifdef CONFIG_MMWAVE_PROFILE
+static int      profile_sched_start(void);
+static void     profile_sched_frame(FAR const struct mmwave_eng_data_s *eng,
+                                    bool gates, uint32_t now);
+static uint32_t profile_sched_tick(uint32_t now);
+static void     profile_sched_stop(void);
+
+static volatile bool        g_sched_running = false;
+static struct mmwave_sched_s g_sched;
+static struct profile_switch_s g_switch;
+static bool                 g_sched_present;
+static uint32_t             g_sched_switches;
+static char                 g_sched_last[MMWAVE_PROFILE_NAME_MAX + 1];
+
+/* The scheduler, hosted by mmwaved as "profile" when it runs */
+
+const struct mmwave_service_s g_profile_service =
+{
+  "profile", &g_sched_running, 0, PROFILE_STACK,
+  profile_sched_start, NULL, NULL, profile_sched_frame,
+  profile_sched_tick, profile_sched_stop
+};
+#endif
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 
-static const char *target_state_str(uint8_t state)
-{
-  switch (state)
-    {
-      case LD2410_TARGET_NONE:   return "none";
-      case LD2410_TARGET_MOTION: return "motion";
-      case LD2410_TARGET_STATIC: return "static";
-      case LD2410_TARGET_BOTH:   return "motion+static";
-      default:                   return "unknown";
-    }
-}
-
 static void print_data(FAR const struct mmwave_data_s *data, bool json)
 {
   if (json)
     {
-      printf("{\"state\":\"%s\","
-             "\"motion_dist\":%u,"
-             "\"motion_energy\":%u,"
-             "\"static_dist\":%u,"
-             "\"static_energy\":%u,"
-             "\"detect_dist\":%u,"
-             "\"timestamp\":%lu}\n",
-             target_state_str(data->target_state),
-             data->motion_distance,
-             data->motion_energy,
-             data->static_distance,
-             data->static_energy,
-             data->detection_distance,
-             (unsigned long)data->timestamp_ms);
+      struct json_writer_s w;
+
+      json_init(&w, json_sink_stdout, NULL);
+      json_begin_object(&w, NULL);
+      json_bool(&w, "presence", mmwave_json_presence(data));
+      json_str(&w, "target", mmwave_target_str(data->target_state));
+      mmwave_json_fields(&w, data);
+      json_uint(&w, "timestamp_ms", data->timestamp_ms);
+      json_end_object(&w);
+      json_char(&w, '\n');
+      json_finish(&w);
     }
   else
     {
@@ -90,7 +158,7 @@ static void print_data(FAR const struct mmwave_data_s *data, bool json)
       printf("│ Presence : %-10s                │\n",
              data->target_state != LD2410_TARGET_NONE ? "YES" : "no");
       printf("│ State    : %-25s │\n",
-             target_state_str(data->target_state));
+             mmwave_target_str(data->target_state));
       printf("│ Motion   : %3u%% energy @ %4u cm     │\n",
              data->motion_energy, data->motion_distance);
       printf("│ Static   : %3u%% energy @ %4u cm     │\n",
@@ -142,6 +210,592 @@ static int read_sensor(int fd, FAR struct mmwave_data_s *data,
   return -1;
 }
 
+/* ioctl() on fd, or the same request through mmwaved when it runs */
+
+static int sensor_ioctl(int fd, int cmd, unsigned long arg,
+                        FAR const char *req)
+{
+  int ret = mmwaved_request(req, NULL, 0);
+
+  if (ret == -ESRCH)
+    {
+      return ioctl(fd, cmd, arg);
+    }
+
+  if (ret < 0)
+    {
+      errno = -ret;
+      return ERROR;
+    }
+
+  return OK;
+}
+
+static int print_config(int fd)
+{
+  struct mmwave_config_s cfg;
+
+  if (ioctl(fd, MMWAVE_IOC_GET_CONFIG, (unsigned long)&cfg) < 0)
+    {
+      fprintf(stderr, "mmwave: cannot read config: %s\n", strerror(errno));
+      return EXIT_FAILURE;
+    }
+
+  printf("Max gates: motion %u, static %u; timeout %u s\n\n",
+         cfg.max_motion_gate, cfg.max_static_gate, cfg.timeout_s);
+  printf(" Gate │ Motion │ Static\n");
+  printf("──────┼────────┼───────\n");
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      printf("  %d   │  %3u   │  %3u\n", i, cfg.motion_sensitivity[i],
+             cfg.static_sensitivity[i]);
+    }
+
+  return OK;
+}
+
+#ifdef CONFIG_CONFIG_CMD
+/* Keep what was just set in the mmwave.* keys */
+
+static void save_config(int fd, uint8_t mask)
+{
+  struct mmwave_config_s cfg;
+  int ret = ioctl(fd, MMWAVE_IOC_GET_CONFIG, (unsigned long)&cfg);
+
+  ret = ret < 0 ? -errno : mmwave_tune_save(&cfg, mask);
+  if (ret < 0)
+    {
+      fprintf(stderr, "mmwave: set, but not saved: %s\n", strerror(-ret));
+    }
+}
+#else
+#  define save_config(fd, mask)
+#endif
+
+#ifdef CONFIG_MMWAVE_PROFILE
+/* ---- Profiles ---- */
+
+static int profile_get(FAR const char *name,
+                       FAR struct mmwave_config_s *cfg)
+{
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+
+  if (!mmwave_profile_name_valid(name))
+    {
+      return -EINVAL;
+    }
+
+  snprintf(key, sizeof(key), MMWAVE_PROFILE_PREFIX "%s", name);
+  if (config_svc_get(key, val, sizeof(val)) < 0)
+    {
+      return -ENOENT;
+    }
+
+  return mmwave_profile_decode(val, cfg);
+}
+
+/**
+ * The whole of cfg to the sensor in one session, through mmwaved when
+ * it runs, else on fd (-1: a descriptor opened for it). Returns the
+ * number of set commands it took.
+ */
+
+static int profile_apply(int fd, FAR const struct mmwave_config_s *cfg)
+{
+  struct mmwave_apply_s req;
+  char hex[MMWAVE_PROFILE_HEX + 1];
+  char line[MMWAVED_LINE_MAX];
+  char reply[MMWAVED_LINE_MAX];
+  int own;
+  int ret;
+
+  mmwave_profile_encode(cfg, hex);
+  snprintf(line, sizeof(line), "sensor apply %s", hex);
+  ret = mmwaved_request(line, reply, sizeof(reply));
+  if (ret == OK)
+    {
+      return atoi(reply);
+    }
+
+  if (ret != -ESRCH)
+    {
+      return ret;
+    }
+
+  own = fd < 0 ? open(MMWAVE_DEV_PATH, O_RDONLY) : fd;
+  if (own < 0)
+    {
+      return -errno;
+    }
+
+  req.cfg  = *cfg;
+  req.mask = MMWAVE_APPLY_ALL;
+  ret = ioctl(own, MMWAVE_IOC_APPLY_CONFIG, (unsigned long)&req);
+  ret = ret < 0 ? -errno : ret;
+  if (own != fd)
+    {
+      close(own);
+    }
+
+  return ret;
+}
+
+static int profile_save(int fd, FAR const char *name)
+{
+  struct mmwave_config_s cfg;
+  char key[CFG_KEY_MAX + 1];
+  char hex[MMWAVE_PROFILE_HEX + 1];
+  int ret;
+
+  if (!mmwave_profile_name_valid(name))
+    {
+      fprintf(stderr, "mmwave: profile names are 1-%d of a-z 0-9 _ -\n",
+              MMWAVE_PROFILE_NAME_MAX);
+      return EXIT_FAILURE;
+    }
+
+  ret = ioctl(fd, MMWAVE_IOC_GET_CONFIG, (unsigned long)&cfg);
+  if (ret < 0)
+    {
+      fprintf(stderr, "mmwave: cannot read config: %s\n", strerror(errno));
+      return EXIT_FAILURE;
+    }
+
+  mmwave_profile_encode(&cfg, hex);
+  snprintf(key, sizeof(key), MMWAVE_PROFILE_PREFIX "%s", name);
+  ret = config_svc_set(key, hex);
+  if (ret < 0)
+    {
+      fprintf(stderr, "mmwave: cannot save: %s\n", strerror(-ret));
+      return EXIT_FAILURE;
+    }
+
+  printf("mmwave: profile '%s' saved (gates %u/%u, timeout %u s)\n", name,
+         cfg.max_motion_gate, cfg.max_static_gate, cfg.timeout_s);
+  return OK;
+}
+
+/* First frame read after the moment after (ms), or false */
+
+static bool profile_next_frame(int fd, uint32_t after,
+                               FAR struct mmwave_data_s *data)
+{
+  uint32_t deadline = mmwave_service_now_ms() + PROFILE_WAIT_MS;
+  struct pollfd pfd;
+
+  pfd.fd     = fd;
+  pfd.events = POLLIN;
+  while ((int32_t)(deadline - mmwave_service_now_ms()) > 0)
+    {
+      pfd.revents = 0;
+      if (poll(&pfd, 1, PROFILE_WAIT_MS) <= 0)
+        {
+          return false;
+        }
+
+      if (read(fd, data, sizeof(*data)) == sizeof(*data) &&
+          (int32_t)(data->timestamp_ms - after) >= 0)
+        {
+          return true;
+        }
+    }
+
+  return false;
+}
+
+static int profile_load(int fd, FAR const char *name)
+{
+  FAR const char *kv[2 * MMWAVE_TUNE_KEYS + 2];
+  struct mmwave_tune_kv_s t;
+  struct mmwave_config_s cfg;
+  struct mmwave_data_s before;
+  struct mmwave_data_s after;
+  uint32_t t0;
+  uint32_t t1;
+  bool frames;
+  int sent;
+  int ret;
+  int n;
+
+  ret = profile_get(name, &cfg);
+  if (ret < 0)
+    {
+      fprintf(stderr, "mmwave: profile '%s': %s\n", name,
+              ret == -ENOENT ? "not found" : "invalid");
+      return EXIT_FAILURE;
+    }
+
+  frames = read(fd, &before, sizeof(before)) == sizeof(before);
+  t0   = mmwave_service_now_ms();
+  sent = profile_apply(fd, &cfg);
+  t1   = mmwave_service_now_ms();
+  if (sent < 0)
+    {
+      fprintf(stderr, "mmwave: profile '%s' not applied: %s\n", name,
+              strerror(-sent));
+      return EXIT_FAILURE;
+    }
+
+  /* The same values as the boot-time keys, and which profile they are,
+   * in one transaction. The tuning watcher then finds nothing to send.
+   */
+
+  n = mmwave_tune_format(&cfg, MMWAVE_APPLY_ALL, &t);
+  memcpy(kv, t.kv, 2 * n * sizeof(kv[0]));
+  kv[2 * n]     = MMWAVE_PROFILE_ACTIVE;
+  kv[2 * n + 1] = name;
+  ret = config_svc_set_many(kv, n + 1);
+  if (ret < 0)
+    {
+      fprintf(stderr, "mmwave: applied, but not saved: %s\n",
+              strerror(-ret));
+    }
+
+  printf("mmwave: profile '%s': %d command(s) in %lu ms", name, sent,
+         (unsigned long)(t1 - t0));
+  if (frames && profile_next_frame(fd, t1, &after))
+    {
+      printf(", no frames for %lu ms",
+             (unsigned long)(after.timestamp_ms - before.timestamp_ms));
+    }
+
+  printf("\n");
+  return OK;
+}
+
+static int profile_list(void)
+{
+  struct mmwave_config_s cfg;
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  char active[MMWAVE_PROFILE_NAME_MAX + 1];
+  size_t plen = strlen(MMWAVE_PROFILE_PREFIX);
+  int pos = 0;
+  int count = 0;
+
+  config_svc_get_str(MMWAVE_PROFILE_ACTIVE, active, sizeof(active), "");
+
+  printf("Profiles:\n");
+  while (config_svc_next(&pos, key, val) > 0)
+    {
+      FAR const char *name = key + plen;
+
+      if (strncmp(key, MMWAVE_PROFILE_PREFIX, plen) != 0 ||
+          strcmp(key, MMWAVE_PROFILE_SCHEDULE) == 0)
+        {
+          continue;
+        }
+
+      count++;
+      if (mmwave_profile_decode(val, &cfg) < 0)
+        {
+          printf("    %-16s (invalid)\n", name);
+          continue;
+        }
+
+      printf("  %c %-16s gates %u/%u, timeout %u s\n",
+             strcmp(name, active) == 0 ? '*' : ' ', name,
+             cfg.max_motion_gate, cfg.max_static_gate, cfg.timeout_s);
+    }
+
+  if (count == 0)
+    {
+      printf("  (none: mmwave profile save <name>)\n");
+    }
+
+  if (config_svc_get(MMWAVE_PROFILE_SCHEDULE, val, sizeof(val)) > 0)
+    {
+      printf("\nSchedule : %s\n", val);
+    }
+
+  printf("Scheduler: %s", g_sched_running ? "RUNNING" : "stopped");
+  if (g_sched_switches > 0)
+    {
+      printf(", %lu switch(es), last '%s'",
+             (unsigned long)g_sched_switches, g_sched_last);
+    }
+
+  printf("\n");
+  return OK;
+}
+
+static int profile_delete(FAR const char *name)
+{
+  char key[CFG_KEY_MAX + 1];
+  int ret = -EINVAL;
+
+  if (mmwave_profile_name_valid(name))
+    {
+      snprintf(key, sizeof(key), MMWAVE_PROFILE_PREFIX "%s", name);
+      ret = config_svc_unset(key);
+    }
+
+  if (ret < 0)
+    {
+      fprintf(stderr, "mmwave: cannot delete '%s': %s\n", name,
+              strerror(-ret));
+      return EXIT_FAILURE;
+    }
+
+  printf("mmwave: profile '%s' deleted\n", name);
+  return OK;
+}
+
+/* ---- The scheduler ---- */
+
+/* Minute of the local day, or -1 while the clock has not been set */
+
+static int profile_sched_minute(void)
+{
+  struct timespec ts;
+  struct tm tm;
+
+  clock_gettime(CLOCK_REALTIME, &ts);
+  if (localtime_r(&ts.tv_sec, &tm) == NULL ||
+      tm.tm_year + 1900 < PROFILE_CLOCK_SET)
+    {
+      return -1;
+    }
+
+  return tm.tm_hour * 60 + tm.tm_min;
+}
+
+static int profile_sched_start(void)
+{
+  char val[CFG_VAL_MAX + 1];
+
+  if (config_svc_get(MMWAVE_PROFILE_SCHEDULE, val, sizeof(val)) <= 0)
+    {
+      return -ENOENT;
+    }
+
+  if (mmwave_sched_parse(&g_sched, val, mmwave_service_now_ms()) <= 0)
+    {
+      return -EINVAL;
+    }
+
+  /* A switch left running by the last stop must end first */
+
+  if (g_switch.busy)
+    {
+      if (sem_trywait(&g_switch.done) < 0)
+        {
+          return -EBUSY;
+        }
+
+      g_switch.busy = false;
+    }
+
+  if (!g_switch.init)
+    {
+      sem_init(&g_switch.done, 0, 0);
+      g_switch.init = true;
+    }
+
+  return OK;
+}
+
+/* The mmwave_switch task: one apply, through mmwaved if it runs */
+
+static int profile_switch_task(int argc, FAR char *argv[])
+{
+  g_switch.ret = profile_apply(-1, &g_switch.cfg);
+  sem_post(&g_switch.done);
+  return OK;
+}
+
+/* The switch in flight has ended: count it. False while it runs. */
+
+static bool profile_switch_collect(void)
+{
+  if (!g_switch.busy)
+    {
+      return true;
+    }
+
+  if (sem_trywait(&g_switch.done) < 0)
+    {
+      return false;
+    }
+
+  g_switch.busy = false;
+  if (g_switch.ret < 0)
+    {
+      syslog(LOG_WARNING, "mmwave: profile %s not applied: %d\n",
+             g_switch.name, g_switch.ret);
+      return true;
+    }
+
+  g_sched_switches++;
+  strlcpy(g_sched_last, g_switch.name, sizeof(g_sched_last));
+  syslog(LOG_INFO, "mmwave: profile %s, %d command(s)\n", g_switch.name,
+         g_switch.ret);
+  return true;
+}
+
+/* Act on whatever rule is due, once the last switch has ended. The
+ * apply is a no-op on the UART when the sensor already has the profile.
+ */
+
+static void profile_sched_step(uint32_t now)
+{
+  FAR const struct mmwave_sched_rule_s *r;
+  int i;
+  int ret;
+
+  if (!profile_switch_collect())
+    {
+      return;
+    }
+
+  i = mmwave_sched_step(&g_sched, now, profile_sched_minute(),
+                        g_sched_present);
+  if (i < 0)
+    {
+      return;
+    }
+
+  r = &g_sched.rules[i];
+  ret = profile_get(r->name, &g_switch.cfg);
+  if (ret == OK)
+    {
+      strlcpy(g_switch.name, r->name, sizeof(g_switch.name));
+      g_switch.busy = true;
+      if (task_create("mmwave_switch", 100, PROFILE_SWITCH_STACK,
+                      profile_switch_task, NULL) < 0)
+        {
+          g_switch.busy = false;
+          ret = -errno;
+        }
+    }
+
+  if (ret < 0)
+    {
+      syslog(LOG_WARNING, "mmwave: profile %s not applied: %d\n",
+             r->name, ret);
+    }
+}
+
+static void profile_sched_frame(FAR const struct mmwave_eng_data_s *eng,
+                                bool gates, uint32_t now)
+{
+  bool present = eng->basic.target_state != LD2410_TARGET_NONE;
+
+  if (present != g_sched_present)
+    {
+      g_sched_present = present;
+      profile_sched_step(now);
+    }
+}
+
+static uint32_t profile_sched_tick(uint32_t now)
+{
+  profile_sched_step(now);
+  return g_switch.busy ? PROFILE_SWITCH_MS : PROFILE_TICK_MS;
+}
+
+/* A switch still running is left to finish; the next start collects it */
+
+static void profile_sched_stop(void)
+{
+  printf("mmwave: profile scheduler stopped\n");
+}
+
+static int profile_sched_task(int argc, FAR char *argv[])
+{
+  return mmwave_service_run(&g_profile_service);
+}
+
+static int profile_sched_run(void)
+{
+  struct mmwave_sched_s check;
+  char val[CFG_VAL_MAX + 1];
+  int ret;
+
+  if (g_sched_running)
+    {
+      printf("mmwave: profile scheduler already running\n");
+      return OK;
+    }
+
+  if (config_svc_get(MMWAVE_PROFILE_SCHEDULE, val, sizeof(val)) <= 0 ||
+      mmwave_sched_parse(&check, val, 0) <= 0)
+    {
+      fprintf(stderr, "mmwave: set %s first, e.g. "
+              "07:00=day,22:30=night,idle:600=empty\n",
+              MMWAVE_PROFILE_SCHEDULE);
+      return EXIT_FAILURE;
+    }
+
+  for (int i = 0; i < check.nrules; i++)
+    {
+      struct mmwave_config_s cfg;
+
+      if (profile_get(check.rules[i].name, &cfg) < 0)
+        {
+          fprintf(stderr, "mmwave: warning: no profile '%s'\n",
+                  check.rules[i].name);
+        }
+    }
+
+  g_sched_present  = false;
+  g_sched_switches = 0;
+
+  ret = mmwave_service_delegate(&g_profile_service);
+  if (ret != -ESRCH)
+    {
+      return ret == OK ? OK : EXIT_FAILURE;
+    }
+
+  g_sched_running = true;
+  if (task_create("mmwave_sched", 100, PROFILE_STACK, profile_sched_task,
+                  NULL) < 0)
+    {
+      g_sched_running = false;
+      fprintf(stderr, "mmwave: failed to start the scheduler\n");
+      return EXIT_FAILURE;
+    }
+
+  return OK;
+}
+
+static int profile_main(int fd, int argc, FAR char *argv[])
+{
+  FAR const char *cmd = argc > 0 ? argv[0] : "list";
+
+  if (strcmp(cmd, "list") == 0)
+    {
+      return profile_list();
+    }
+  else if (strcmp(cmd, "start") == 0)
+    {
+      return profile_sched_run();
+    }
+  else if (strcmp(cmd, "stop") == 0)
+    {
+      mmwave_service_stop(&g_profile_service);
+      return OK;
+    }
+  else if (argc == 2 && strcmp(cmd, "save") == 0)
+    {
+      return profile_save(fd, argv[1]);
+    }
+  else if (argc == 2 && strcmp(cmd, "load") == 0)
+    {
+      return profile_load(fd, argv[1]);
+    }
+  else if (argc == 2 && strcmp(cmd, "delete") == 0)
+    {
+      return profile_delete(argv[1]);
+    }
+
+  fprintf(stderr, "mmwave: usage: mmwave profile "
+          "[list|save <name>|load <name>|delete <name>|start|stop]\n");
+  return EXIT_FAILURE;
+}
+#endif /* CONFIG_MMWAVE_PROFILE */
+
 static void print_usage(void)
 {
   printf("Usage: mmwave [options]\n\n");
@@ -151,10 +805,18 @@ static void print_usage(void)
   printf("  -e on|off   Enable/disable engineering mode\n");
   printf("  -s G M S    Set gate G sensitivity (motion M, static S)\n");
   printf("  -g M S T    Set max gates (motion M, static S, timeout T sec)\n");
+  printf("  -c          Show gates and thresholds\n");
   printf("  -r          Restart the sensor module\n");
   printf("  -f          Factory reset the sensor\n");
   printf("  -j          Output as JSON\n");
   printf("  -h          Show this help\n");
+#ifdef CONFIG_MMWAVE_PROFILE
+  printf("\n  profile [list]              Profiles and the schedule\n");
+  printf("  profile save|load <name>    Current tuning to/from a name\n");
+  printf("  profile delete <name>       Forget a profile\n");
+  printf("  profile start|stop          Switch on %s\n",
+         MMWAVE_PROFILE_SCHEDULE);
+#endif
 }
 
 static void watch_signal_handler(int signo)
@@ -198,12 +860,21 @@ int main(int argc, FAR char *argv[])
       return ret;
     }
 
+#ifdef CONFIG_MMWAVE_PROFILE
+  if (strcmp(argv[1], "profile") == 0)
+    {
+      ret = profile_main(fd, argc - 2, &argv[2]);
+      close(fd);
+      return ret;
+    }
+#endif
+
   /* Parse options */
 
   int opt;
   bool json_mode = false;
 
-  while ((opt = getopt(argc, argv, "we:s:g:rfjh")) != -1)
+  while ((opt = getopt(argc, argv, "we:s:g:crfjh")) != -1)
     {
       switch (opt)
         {
@@ -249,7 +920,9 @@ int main(int argc, FAR char *argv[])
               /* Engineering mode toggle */
 
               int enable = (strcmp(optarg, "on") == 0) ? 1 : 0;
-              ret = ioctl(fd, MMWAVE_IOC_ENG_MODE, (unsigned long)enable);
+              ret = sensor_ioctl(fd, MMWAVE_IOC_ENG_MODE,
+                                 (unsigned long)enable,
+                                 enable ? "sensor eng 1" : "sensor eng 0");
               if (ret < 0)
                 {
                   fprintf(stderr, "mmwave: engineering mode failed: %s\n",
@@ -276,12 +949,15 @@ int main(int argc, FAR char *argv[])
                 }
 
               struct mmwave_sensitivity_s sens;
+              char req[MMWAVED_LINE_MAX];
               sens.gate             = (uint8_t)atoi(optarg);
               sens.motion_threshold = (uint8_t)atoi(argv[optind++]);
               sens.static_threshold = (uint8_t)atoi(argv[optind++]);
 
-              ret = ioctl(fd, MMWAVE_IOC_SET_SENSITIVITY,
-                          (unsigned long)&sens);
+              snprintf(req, sizeof(req), "sensor sens %u %u %u", sens.gate,
+                       sens.motion_threshold, sens.static_threshold);
+              ret = sensor_ioctl(fd, MMWAVE_IOC_SET_SENSITIVITY,
+                                 (unsigned long)&sens, req);
               if (ret < 0)
                 {
                   fprintf(stderr, "mmwave: set sensitivity failed: %s\n",
@@ -293,6 +969,8 @@ int main(int argc, FAR char *argv[])
                          "(motion=%u, static=%u)\n",
                          sens.gate, sens.motion_threshold,
                          sens.static_threshold);
+                  save_config(fd, MMWAVE_APPLY_MOTION_SENS |
+                                  MMWAVE_APPLY_STATIC_SENS);
                 }
             }
             break;
@@ -310,12 +988,16 @@ int main(int argc, FAR char *argv[])
                 }
 
               struct mmwave_maxgate_s mg;
+              char req[MMWAVED_LINE_MAX];
               mg.max_motion_gate = (uint8_t)atoi(optarg);
               mg.max_static_gate = (uint8_t)atoi(argv[optind++]);
               mg.timeout_s       = (uint16_t)atoi(argv[optind++]);
 
-              ret = ioctl(fd, MMWAVE_IOC_SET_MAXGATE,
-                          (unsigned long)&mg);
+              snprintf(req, sizeof(req), "sensor maxgate %u %u %u",
+                       mg.max_motion_gate, mg.max_static_gate,
+                       mg.timeout_s);
+              ret = sensor_ioctl(fd, MMWAVE_IOC_SET_MAXGATE,
+                                 (unsigned long)&mg, req);
               if (ret < 0)
                 {
                   fprintf(stderr, "mmwave: set max gates failed: %s\n",
@@ -327,13 +1009,22 @@ int main(int argc, FAR char *argv[])
                          "timeout=%us)\n",
                          mg.max_motion_gate, mg.max_static_gate,
                          mg.timeout_s);
+                  save_config(fd, MMWAVE_APPLY_MAX_MOTION |
+                                  MMWAVE_APPLY_MAX_STATIC |
+                                  MMWAVE_APPLY_TIMEOUT);
                 }
             }
             break;
 
+          case 'c':
+            {
+              ret = print_config(fd);
+            }
+            break;
+
           case 'r':
             {
-              ret = ioctl(fd, MMWAVE_IOC_RESTART, 0);
+              ret = sensor_ioctl(fd, MMWAVE_IOC_RESTART, 0, "sensor restart");
               printf("mmwave: %s\n",
                      ret == 0 ? "sensor restarted" : "restart failed");
             }
@@ -342,7 +1033,8 @@ int main(int argc, FAR char *argv[])
           case 'f':
             {
               printf("mmwave: factory reset... ");
-              ret = ioctl(fd, MMWAVE_IOC_FACTORY_RESET, 0);
+              ret = sensor_ioctl(fd, MMWAVE_IOC_FACTORY_RESET, 0,
+                                 "sensor factory");
               printf("%s\n", ret == 0 ? "done" : "failed");
             }
             break;
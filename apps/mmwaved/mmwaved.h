@@ -0,0 +1,533 @@
+/*
+ * apps/mmwaved/mmwaved.h
+ *
+ * Core of mmwaved, the one task that hosts HA reporting and the network
+ * servers. No sockets or devices here, so it runs on the host:
+ *
+ *   - a table of hosted services (apps/common/mmwave_service.h) and
+ *     their supervisor: a service whose start() fails or whose events()
+ *     reports a fault is stopped and retried with exponential backoff,
+ *     which resets once it has stayed up for MWD_STABLE_MS
+ *   - the poll set: the daemon's own fds first, then one block per
+ *     running service, so revents go back to the service that asked
+ *   - the sensor watchdog: no frame for stale_ms restarts the sensor,
+ *     backing off while it stays silent
+ *   - the control protocol: "<verb> [args]" in, "OK [text]" or
+ *     "ERR <errno>" out
+ *
+ * A service's `running` flag stays the app's own: `<app> status` reads
+ * it as before, and `<app> stop` clearing it is noticed on the next pass.
+ */
+
+#ifndef __APPS_MMWAVED_MMWAVED_H
+#define __APPS_MMWAVED_MMWAVED_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+
+#include "apps/common/mmwave_service.h"
+
+#define MWD_MAX_SERVICES      8
+#define MWD_BACKOFF_MS        1000     /* First service retry */
+#define MWD_BACKOFF_MAX_MS    60000
+#define MWD_STABLE_MS         10000    /* Up this long: failures forgotten */
+#define MWD_CTL_ARGS          5
+
+enum mwd_state_e
+{
+  MWD_STOPPED = 0,
+  MWD_RUNNING,
+  MWD_RETRY              /* Failed; start() again at retry_ms */
+};
+
+struct mwd_slot_s
+{
+  const struct mmwave_service_s *svc;
+  uint8_t  state;          /* enum mwd_state_e */
+  bool     polled;         /* Has a block in the current poll set */
+  uint8_t  first;          /* Where that block starts */
+  uint32_t started_ms;
+  uint32_t next_tick_ms;
+  uint32_t retry_ms;
+  uint32_t failures;       /* Consecutive */
+  uint32_t restarts;       /* Retries after a failure, all time */
+  int      last_error;
+};
+
+struct mwd_watchdog_s
+{
+  uint32_t stale_ms;       /* 0: off */
+  uint32_t last_frame_ms;
+  uint32_t next_ms;        /* No restart before this */
+  uint32_t failures;       /* Restarts since the last frame */
+  uint32_t restarts;
+  uint32_t frames;
+};
+
+struct mwd_s
+{
+  struct mwd_slot_s     slots[MWD_MAX_SERVICES];
+  uint8_t               count;
+  uint8_t               nfds_max;  /* Poll set room for services */
+  struct mwd_watchdog_s wd;
+};
+
+struct mwd_req_s
+{
+  int   argc;
+  char *argv[MWD_CTL_ARGS];
+};
+
+static inline void mwd_init(struct mwd_s *d, uint8_t nfds_max,
+                            uint32_t stale_ms, uint32_t now)
+{
+  memset(d, 0, sizeof(*d));
+  d->nfds_max         = nfds_max;
+  d->wd.stale_ms      = stale_ms;
+  d->wd.last_frame_ms = now;     /* Boot grace: one stale period */
+  d->wd.next_ms       = now;
+}
+
+/* Register a service; returns its index or -ENOSPC */
+
+static inline int mwd_add(struct mwd_s *d, const struct mmwave_service_s *svc)
+{
+  if (d->count == MWD_MAX_SERVICES)
+    {
+      return -ENOSPC;
+    }
+
+  memset(&d->slots[d->count], 0, sizeof(d->slots[0]));
+  d->slots[d->count].svc = svc;
+  return d->count++;
+}
+
+static inline int mwd_find(const struct mwd_s *d, const char *name)
+{
+  for (int i = 0; i < d->count; i++)
+    {
+      if (strcmp(d->slots[i].svc->name, name) == 0)
+        {
+          return i;
+        }
+    }
+
+  return -ENOENT;
+}
+
+/* base * 2^(failures-1), capped */
+
+static inline uint32_t mwd_backoff(uint32_t base_ms, uint32_t failures)
+{
+  uint32_t delay = base_ms;
+
+  while (failures-- > 1 && delay < MWD_BACKOFF_MAX_MS)
+    {
+      delay <<= 1;
+    }
+
+  return delay < MWD_BACKOFF_MAX_MS ? delay : MWD_BACKOFF_MAX_MS;
+}
+
+/* Poll entries the running services take */
+
+static inline int mwd_fds_used(const struct mwd_s *d)
+{
+  int n = 0;
+
+  for (int i = 0; i < d->count; i++)
+    {
+      if (d->slots[i].state == MWD_RUNNING)
+        {
+          n += d->slots[i].svc->nfds;
+        }
+    }
+
+  return n;
+}
+
+static inline void mwd_schedule_retry(struct mwd_slot_s *s, int err,
+                                      uint32_t now)
+{
+  if (s->state == MWD_RUNNING && now - s->started_ms >= MWD_STABLE_MS)
+    {
+      s->failures = 0;
+    }
+
+  s->failures++;
+  s->last_error = err;
+  s->state      = MWD_RETRY;
+  s->polled     = false;
+  s->retry_ms   = now + mwd_backoff(MWD_BACKOFF_MS, s->failures);
+}
+
+/*
+ * Start service i. Returns OK, -EALREADY if it is already hosted, -EBUSY
+ * if its own task runs it, -ENFILE if the poll set has no room, or the
+ * service's start() error, in which case it is retried with backoff.
+ */
+
+static inline int mwd_start(struct mwd_s *d, int i, uint32_t now)
+{
+  struct mwd_slot_s *s = &d->slots[i];
+  int ret;
+
+  if (s->state == MWD_RUNNING && *s->svc->running)
+    {
+      return -EALREADY;
+    }
+
+  if (s->state == MWD_RUNNING)
+    {
+      /* `<app> stop` cleared the flag and we have not caught up yet */
+
+      s->svc->stop();
+      s->state = MWD_STOPPED;
+    }
+
+  if (*s->svc->running)
+    {
+      return -EBUSY;
+    }
+
+  if (mwd_fds_used(d) + s->svc->nfds > d->nfds_max)
+    {
+      return -ENFILE;
+    }
+
+  ret = s->svc->start();
+  if (ret < 0)
+    {
+      mwd_schedule_retry(s, ret, now);
+      return ret;
+    }
+
+  *s->svc->running = true;
+  s->state         = MWD_RUNNING;
+  s->polled        = false;
+  s->started_ms    = now;
+  s->next_tick_ms  = now;
+  return OK;
+}
+
+static inline void mwd_stop(struct mwd_s *d, int i)
+{
+  struct mwd_slot_s *s = &d->slots[i];
+
+  if (s->state == MWD_RUNNING)
+    {
+      s->svc->stop();
+    }
+
+  *s->svc->running = false;
+  s->state         = MWD_STOPPED;
+  s->polled        = false;
+  s->failures      = 0;
+}
+
+/* The service reported a fault: stop it now, start it again later */
+
+static inline void mwd_fault(struct mwd_s *d, int i, int err, uint32_t now)
+{
+  struct mwd_slot_s *s = &d->slots[i];
+
+  s->svc->stop();
+  *s->svc->running = false;
+  mwd_schedule_retry(s, err, now);
+}
+
+/*
+ * Lay the running services' fds out after the daemon's own `base`
+ * entries. Returns the total number of entries.
+ */
+
+static inline int mwd_pollset(struct mwd_s *d, struct pollfd *pfds,
+                              int base)
+{
+  int n = base;
+
+  for (int i = 0; i < d->count; i++)
+    {
+      struct mwd_slot_s *s = &d->slots[i];
+
+      s->polled = false;
+      if (s->state != MWD_RUNNING || s->svc->nfds == 0)
+        {
+          continue;
+        }
+
+      s->first  = n;
+      s->polled = true;
+      s->svc->pollset(&pfds[n]);
+      for (int j = 0; j < s->svc->nfds; j++)
+        {
+          pfds[n + j].revents = 0;
+        }
+
+      n += s->svc->nfds;
+    }
+
+  return n;
+}
+
+/* Hand each service its revents; a fault stops it for a retry */
+
+static inline void mwd_events(struct mwd_s *d, const struct pollfd *pfds,
+                              uint32_t now)
+{
+  for (int i = 0; i < d->count; i++)
+    {
+      struct mwd_slot_s *s = &d->slots[i];
+      int ret;
+
+      if (s->state != MWD_RUNNING || !s->polled)
+        {
+          continue;
+        }
+
+      ret = s->svc->events(&pfds[s->first], now);
+      if (ret < 0)
+        {
+          mwd_fault(d, i, ret, now);
+        }
+    }
+}
+
+/* One frame read for everyone */
+
+static inline void mwd_frame(struct mwd_s *d,
+                             const struct mmwave_eng_data_s *eng,
+                             bool gates, uint32_t now)
+{
+  d->wd.last_frame_ms = now;
+  d->wd.failures      = 0;
+  d->wd.frames++;
+
+  for (int i = 0; i < d->count; i++)
+    {
+      struct mwd_slot_s *s = &d->slots[i];
+
+      if (s->state == MWD_RUNNING && s->svc->frame != NULL)
+        {
+          s->svc->frame(eng, gates, now);
+        }
+    }
+}
+
+/* A deliberate sensor restart or config change: not a stall */
+
+static inline void mwd_watchdog_touch(struct mwd_s *d, uint32_t now)
+{
+  d->wd.last_frame_ms = now;
+}
+
+/*
+ * True when the sensor has been silent for stale_ms and the backoff
+ * since the last restart has run out; the caller restarts it.
+ */
+
+static inline bool mwd_watchdog_due(struct mwd_s *d, uint32_t now)
+{
+  struct mwd_watchdog_s *wd = &d->wd;
+
+  if (wd->stale_ms == 0 || now - wd->last_frame_ms < wd->stale_ms ||
+      (int32_t)(now - wd->next_ms) < 0)
+    {
+      return false;
+    }
+
+  wd->failures++;
+  wd->restarts++;
+  wd->next_ms = now + mwd_backoff(wd->stale_ms, wd->failures);
+  return true;
+}
+
+static inline uint32_t mwd_min_wait(uint32_t wait, uint32_t at,
+                                    uint32_t now)
+{
+  int32_t left = (int32_t)(at - now);
+
+  if (left <= 0)
+    {
+      return 0;
+    }
+
+  return (uint32_t)left < wait ? (uint32_t)left : wait;
+}
+
+/*
+ * Timers: wind down services stopped through their own flag, run due
+ * ticks and retries. Returns how long the caller may sleep in poll().
+ */
+
+static inline uint32_t mwd_run(struct mwd_s *d, uint32_t now)
+{
+  uint32_t wait = MMWAVE_SERVICE_IDLE_MS;
+
+  for (int i = 0; i < d->count; i++)
+    {
+      struct mwd_slot_s *s = &d->slots[i];
+
+      if (s->state == MWD_RUNNING && !*s->svc->running)
+        {
+          mwd_stop(d, i);
+        }
+      else if (s->state == MWD_RETRY && (int32_t)(now - s->retry_ms) >= 0)
+        {
+          int ret;
+
+          s->restarts++;
+          ret = mwd_start(d, i, now);
+          if (ret == -EBUSY)
+            {
+              s->state = MWD_STOPPED;   /* Its own task has it now */
+            }
+          else if (ret == -ENFILE)
+            {
+              mwd_schedule_retry(s, ret, now);
+            }
+        }
+
+      if (s->state == MWD_RUNNING && s->svc->tick != NULL)
+        {
+          if ((int32_t)(now - s->next_tick_ms) >= 0)
+            {
+              s->next_tick_ms = now + s->svc->tick(now);
+            }
+
+          wait = mwd_min_wait(wait, s->next_tick_ms, now);
+        }
+      else if (s->state == MWD_RETRY)
+        {
+          wait = mwd_min_wait(wait, s->retry_ms, now);
+        }
+    }
+
+  if (d->wd.stale_ms > 0)
+    {
+      uint32_t at = d->wd.last_frame_ms + d->wd.stale_ms;
+
+      if ((int32_t)(d->wd.next_ms - at) > 0)
+        {
+          at = d->wd.next_ms;
+        }
+
+      wait = mwd_min_wait(wait, at, now);
+    }
+
+  return wait;
+}
+
+static inline const char *mwd_state_str(uint8_t state)
+{
+  switch (state)
+    {
+      case MWD_RUNNING: return "running";
+      case MWD_RETRY:   return "retrying";
+      default:          return "stopped";
+    }
+}
+
+/* ---- Control protocol ---- */
+
+/* Split a request line in place; returns the word count or -EINVAL */
+
+static inline int mwd_ctl_parse(char *line, struct mwd_req_s *req)
+{
+  char *save = NULL;
+  char *word;
+
+  req->argc = 0;
+  for (word = strtok_r(line, " \t\r\n", &save); word != NULL;
+       word = strtok_r(NULL, " \t\r\n", &save))
+    {
+      if (req->argc == MWD_CTL_ARGS)
+        {
+          return -EINVAL;
+        }
+
+      req->argv[req->argc++] = word;
+    }
+
+  return req->argc > 0 ? req->argc : -EINVAL;
+}
+
+static inline int mwd_reply(char *buf, size_t size, int ret,
+                            const char *text)
+{
+  if (ret < 0)
+    {
+      return snprintf(buf, size, "ERR %d\n", -ret);
+    }
+
+  if (text == NULL || text[0] == '\0')
+    {
+      return snprintf(buf, size, "OK\n");
+    }
+
+  return snprintf(buf, size, "OK %s\n", text);
+}
+
+/*
+ * start|stop|restart <service>. Returns -ENOSYS for any other verb so
+ * the caller can try its own; otherwise the reply is in buf.
+ */
+
+static inline int mwd_ctl_service(struct mwd_s *d,
+                                  const struct mwd_req_s *req,
+                                  uint32_t now, char *buf, size_t size)
+{
+  const char *verb = req->argv[0];
+  int i;
+  int ret;
+
+  if (strcmp(verb, "start") != 0 && strcmp(verb, "stop") != 0 &&
+      strcmp(verb, "restart") != 0)
+    {
+      return -ENOSYS;
+    }
+
+  i = req->argc == 2 ? mwd_find(d, req->argv[1]) : -EINVAL;
+  if (i < 0)
+    {
+      return mwd_reply(buf, size, i, NULL);
+    }
+
+  if (strcmp(verb, "start") != 0)
+    {
+      if (d->slots[i].state == MWD_STOPPED)
+        {
+          return mwd_reply(buf, size, strcmp(verb, "stop") == 0 ?
+                           -EALREADY : -ESRCH, NULL);
+        }
+
+      mwd_stop(d, i);
+      if (strcmp(verb, "stop") == 0)
+        {
+          return mwd_reply(buf, size, OK, "stopped");
+        }
+    }
+
+  /* A failed start is retried: tell the caller, but it is not an error */
+
+  ret = mwd_start(d, i, now);
+  if (ret == -EALREADY)
+    {
+      ret = OK;
+    }
+
+  if (ret < 0 && d->slots[i].state == MWD_RETRY)
+    {
+      char text[32];
+
+      snprintf(text, sizeof(text), "retrying (%d)", ret);
+      return mwd_reply(buf, size, OK, text);
+    }
+
+  return mwd_reply(buf, size, ret, ret == OK ? "running" : NULL);
+}
+
+#endif /* __APPS_MMWAVED_MMWAVED_H */
@@ -0,0 +1,757 @@
+/****************************************************************************
+ * apps/mmwaved/mmwaved_cmd.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * NSH command: mmwaved — one task for HA reporting, the network servers
+ * and their supervision
+ *
+ * Usage:
+ *   mmwaved start             — Start the daemon
+ *   mmwaved stop              — Stop it and every service it hosts
+ *   mmwaved status            — Hosted services, watchdog, heap
+ *
+ * While it runs, `hactl start`, `httpd start`, `stream start`, `coap
+ * start`, `mcast start`, `esphome start` and `mmwave profile start` ask it
+ * over a local socket to host the service instead of spawning a task, and
+ * `mmwave -e/-s/-g/-r/-f` and profile switches send their sensor commands
+ * through it. Without it they behave as they always did.
+ *
+ * Nothing in the loop may wait on the network or the sensor. HA
+ * reporting polls its connection with the rest, a profile switch runs
+ * in the scheduler's short-lived mmwave_switch task, and a sensor
+ * command in a short-lived mmwaved_sensor task answered when it is done.
+ *
+ * Control protocol (one line each way on CONFIG_MMWAVED_CTL_PATH):
+ *   start|stop|restart <service>
+ *   sensor eng 0|1 | sens <gate> <motion> <static> |
+ *          maxgate <motion> <static> <timeout> | apply <profile hex> |
+ *          restart | factory        (apply answers "OK <commands sent>")
+ *   ping
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <malloc.h>
+#include <poll.h>
+#include <sched.h>
+#include <semaphore.h>
+#include <syslog.h>
+
+#include <sys/ioctl.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_service.h"
+#include "apps/common/mmwave_profile.h"
+#include "mmwaved.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_MMWAVED_STACKSIZE
+#  define CONFIG_MMWAVED_STACKSIZE  3072
+#endif
+
+#ifndef CONFIG_MMWAVED_STALE_MS
+#  define CONFIG_MMWAVED_STALE_MS   5000
+#endif
+
+#ifndef CONFIG_MMWAVED_MAX_FDS
+#  define CONFIG_MMWAVED_MAX_FDS    24
+#endif
+
+/* The daemon's own poll entries, ahead of the services' */
+
+#define MWD_FD_SENSOR           0
+#define MWD_FD_LISTEN           1
+#define MWD_FD_CLIENT           2
+#define MWD_BASE_FDS            3
+
+#define MWD_CTL_BACKLOG         2
+#define MWD_CTL_TIMEOUT_MS      1000   /* To send the request line */
+#define MWD_HEAP_MS             1000   /* Heap sampling period */
+#define MWD_SENSOR_STACK        2048   /* A sensor command's task */
+#define MWD_SENSOR_POLL_MS      50     /* Checking on it */
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* The sensor command in flight, at most one: the mmwaved_sensor task
+ * waits on the sensor's acks, stores ret and posts done; the loop takes
+ * done without waiting, answers the client, if one asked, and clears
+ * pending. The post orders the store to ret before the loop reads it.
+ */
+
+struct mwd_job_s
+{
+  int           cmd;
+  unsigned long arg;
+  union
+  {
+    struct mmwave_sensitivity_s sens;
+    struct mmwave_maxgate_s     mg;
+    struct mmwave_apply_s       apply;
+  } u;
+  int           ret;
+  bool          client;         /* The control client waits for ret */
+  bool          pending;        /* Started, not yet answered */
+  sem_t         done;           /* Posted by the task once ret is set */
+};
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Services this build can host, each from its own app */
+
+#ifdef CONFIG_HACTL_CMD
+extern const struct mmwave_service_s g_hactl_service;
+#endif
+#ifdef CONFIG_ESPHOME_API_CMD
+extern const struct mmwave_service_s g_esphome_service;
+#endif
+#ifdef CONFIG_COAP_SERVER_CMD
+extern const struct mmwave_service_s g_coap_service;
+#endif
+#ifdef CONFIG_MCAST_CMD
+extern const struct mmwave_service_s g_mcast_service;
+#endif
+#ifdef CONFIG_HTTPD_CMD
+extern const struct mmwave_service_s g_httpd_service;
+#endif
+#ifdef CONFIG_STREAM_CMD
+extern const struct mmwave_service_s g_stream_service;
+#endif
+#ifdef CONFIG_MMWAVE_PROFILE
+extern const struct mmwave_service_s g_profile_service;
+#endif
+
+static FAR const struct mmwave_service_s *const g_services[] =
+{
+#ifdef CONFIG_HACTL_CMD
+  &g_hactl_service,
+#endif
+#ifdef CONFIG_ESPHOME_API_CMD
+  &g_esphome_service,
+#endif
+#ifdef CONFIG_COAP_SERVER_CMD
+  &g_coap_service,
+#endif
+#ifdef CONFIG_MCAST_CMD
+  &g_mcast_service,
+#endif
+#ifdef CONFIG_HTTPD_CMD
+  &g_httpd_service,
+#endif
+#ifdef CONFIG_STREAM_CMD
+  &g_stream_service,
+#endif
+#ifdef CONFIG_MMWAVE_PROFILE
+  &g_profile_service,
+#endif
+  NULL
+};
+
+/* Daemon state lives here, not on the task stack */
+
+static struct mwd_s   g_mwd;
+static struct pollfd  g_pfds[MWD_BASE_FDS + CONFIG_MMWAVED_MAX_FDS];
+static int            g_sensorfd = -1;
+static int            g_listenfd = -1;
+static int            g_clientfd = -1;
+static char           g_line[MMWAVED_LINE_MAX];
+static size_t         g_linelen;
+static uint32_t       g_client_ms;
+static uint32_t       g_started_ms;
+static uint32_t       g_heap_ms;
+static int            g_heap_free;
+static int            g_heap_low;
+static uint32_t       g_requests;
+static struct mwd_job_s g_job;
+static volatile bool  g_running = false;
+static pid_t          g_daemon_pid = -1;
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static int mwd_listen(void)
+{
+  struct sockaddr_un addr;
+  int fd;
+
+  fd = socket(AF_LOCAL, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_LOCAL;
+  strlcpy(addr.sun_path, CONFIG_MMWAVED_CTL_PATH, sizeof(addr.sun_path));
+
+  /* A socket left behind by a daemon that died is only a file */
+
+  unlink(CONFIG_MMWAVED_CTL_PATH);
+
+  if (bind(fd, (FAR struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, MWD_CTL_BACKLOG) < 0)
+    {
+      int ret = -errno;
+      close(fd);
+      return ret;
+    }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+static void mwd_client_close(void)
+{
+  close(g_clientfd);
+  g_clientfd = -1;
+  g_linelen  = 0;
+}
+
+/* The mmwaved_sensor task: one ioctl on a descriptor of its own */
+
+static int mwd_sensor_task(int argc, FAR char *argv[])
+{
+  int fd = open(MMWAVE_SERVICE_DEV, O_RDONLY);
+  int ret = -errno;
+
+  if (fd >= 0)
+    {
+      ret = ioctl(fd, g_job.cmd, g_job.arg);
+      ret = ret < 0 ? -errno : ret;
+      close(fd);
+    }
+
+  g_job.ret = ret;
+  sem_post(&g_job.done);
+  return OK;
+}
+
+/* Run g_job.cmd in its own task; the loop picks up the result */
+
+static int mwd_job_start(bool client)
+{
+  g_job.client  = client;
+  g_job.pending = true;
+  if (task_create("mmwaved_sensor", 100, MWD_SENSOR_STACK,
+                  mwd_sensor_task, NULL) < 0)
+    {
+      g_job.pending = false;
+      return -errno;
+    }
+
+  return OK;
+}
+
+/* The job is done: answer the client that asked for it */
+
+static void mwd_job_finish(void)
+{
+  char reply[MMWAVED_LINE_MAX];
+  char text[12];
+
+  g_job.pending = false;
+  if (!g_job.client || g_clientfd < 0)
+    {
+      return;
+    }
+
+  snprintf(text, sizeof(text), "%d", g_job.ret);
+  mwd_reply(reply, sizeof(reply), g_job.ret, g_job.ret > 0 ? text : NULL);
+  send(g_clientfd, reply, strlen(reply), 0);
+  mwd_client_close();
+}
+
+/**
+ * sensor <what> [args]: the mmwave command's ioctls, started as a job.
+ * Returns OK once it runs (the reply comes when it is done) or a
+ * negative errno to answer now.
+ */
+
+static int mwd_ctl_sensor(FAR const struct mwd_req_s *req)
+{
+  FAR const char *what = req->argc > 1 ? req->argv[1] : "";
+
+  if (g_job.pending)
+    {
+      return -EBUSY;
+    }
+
+  if (strcmp(what, "eng") == 0 && req->argc == 3)
+    {
+      g_job.cmd = MMWAVE_IOC_ENG_MODE;
+      g_job.arg = atoi(req->argv[2]) != 0;
+    }
+  else if (strcmp(what, "sens") == 0 && req->argc == 5)
+    {
+      g_job.u.sens.gate             = (uint8_t)atoi(req->argv[2]);
+      g_job.u.sens.motion_threshold = (uint8_t)atoi(req->argv[3]);
+      g_job.u.sens.static_threshold = (uint8_t)atoi(req->argv[4]);
+      g_job.cmd = MMWAVE_IOC_SET_SENSITIVITY;
+      g_job.arg = (unsigned long)&g_job.u.sens;
+    }
+  else if (strcmp(what, "maxgate") == 0 && req->argc == 5)
+    {
+      g_job.u.mg.max_motion_gate = (uint8_t)atoi(req->argv[2]);
+      g_job.u.mg.max_static_gate = (uint8_t)atoi(req->argv[3]);
+      g_job.u.mg.timeout_s       = (uint16_t)atoi(req->argv[4]);
+      g_job.cmd = MMWAVE_IOC_SET_MAXGATE;
+      g_job.arg = (unsigned long)&g_job.u.mg;
+    }
+  else if (strcmp(what, "apply") == 0 && req->argc == 3)
+    {
+      if (mmwave_profile_decode(req->argv[2], &g_job.u.apply.cfg) < 0)
+        {
+          return -EINVAL;
+        }
+
+      g_job.u.apply.mask = MMWAVE_APPLY_ALL;
+      g_job.cmd = MMWAVE_IOC_APPLY_CONFIG;
+      g_job.arg = (unsigned long)&g_job.u.apply;
+    }
+  else if (strcmp(what, "restart") == 0 && req->argc == 2)
+    {
+      g_job.cmd = MMWAVE_IOC_RESTART;
+      g_job.arg = 0;
+    }
+  else if (strcmp(what, "factory") == 0 && req->argc == 2)
+    {
+      g_job.cmd = MMWAVE_IOC_FACTORY_RESET;
+      g_job.arg = 0;
+    }
+  else
+    {
+      return -EINVAL;
+    }
+
+  return mwd_job_start(true);
+}
+
+/* Answer one request line into buf; false if the answer comes later */
+
+static bool mwd_ctl_handle(FAR char *line, uint32_t now, FAR char *buf,
+                           size_t size)
+{
+  struct mwd_req_s req;
+  int ret;
+
+  g_requests++;
+  ret = mwd_ctl_parse(line, &req);
+  if (ret < 0)
+    {
+      mwd_reply(buf, size, ret, NULL);
+      return true;
+    }
+
+  if (mwd_ctl_service(&g_mwd, &req, now, buf, size) != -ENOSYS)
+    {
+      return true;
+    }
+
+  if (strcmp(req.argv[0], "sensor") == 0)
+    {
+      ret = mwd_ctl_sensor(&req);
+      if (ret == OK)
+        {
+          return false;
+        }
+
+      mwd_reply(buf, size, ret, NULL);
+    }
+  else if (strcmp(req.argv[0], "ping") == 0)
+    {
+      char text[24];
+
+      snprintf(text, sizeof(text), "up %lus",
+               (unsigned long)((now - g_started_ms) / 1000));
+      mwd_reply(buf, size, OK, text);
+    }
+  else
+    {
+      mwd_reply(buf, size, -ENOSYS, NULL);
+    }
+
+  return true;
+}
+
+/* Collect the client's line; answer and hang up once it is complete */
+
+static void mwd_client_input(uint32_t now)
+{
+  char reply[MMWAVED_LINE_MAX];
+  ssize_t n;
+
+  n = recv(g_clientfd, g_line + g_linelen, sizeof(g_line) - 1 - g_linelen,
+           MSG_DONTWAIT);
+  if (n <= 0)
+    {
+      if (n == 0 || (errno != EAGAIN && errno != EWOULDBLOCK))
+        {
+          mwd_client_close();
+        }
+
+      return;
+    }
+
+  g_linelen += n;
+  g_line[g_linelen] = '\0';
+  if (strchr(g_line, '\n') == NULL && g_linelen < sizeof(g_line) - 1)
+    {
+      return;
+    }
+
+  g_line[strcspn(g_line, "\r\n")] = '\0';
+  if (mwd_ctl_handle(g_line, now, reply, sizeof(reply)))
+    {
+      send(g_clientfd, reply, strlen(reply), 0);
+      mwd_client_close();
+    }
+}
+
+static void mwd_client_accept(uint32_t now)
+{
+  g_clientfd = accept(g_listenfd, NULL, NULL);
+  if (g_clientfd >= 0)
+    {
+      fcntl(g_clientfd, F_SETFL, fcntl(g_clientfd, F_GETFL) | O_NONBLOCK);
+      g_linelen   = 0;
+      g_client_ms = now;
+    }
+}
+
+static void mwd_heap_sample(uint32_t now)
+{
+  struct mallinfo info;
+
+  if ((int32_t)(now - g_heap_ms) < 0)
+    {
+      return;
+    }
+
+  info        = mallinfo();
+  g_heap_ms   = now + MWD_HEAP_MS;
+  g_heap_free = info.fordblks;
+  if (g_heap_low == 0 || g_heap_free < g_heap_low)
+    {
+      g_heap_low = g_heap_free;
+    }
+}
+
+/****************************************************************************
+ * Name: mwd_daemon_task
+ *
+ * Description:
+ *   The event loop: timers first (service ticks and retries, the sensor
+ *   command in flight, the sensor watchdog), then one poll() over the
+ *   sensor, the control socket and every hosted service's sockets,
+ *   sleeping until whichever comes first. A sensor frame is read once
+ *   and handed to every service.
+ *
+ ****************************************************************************/
+
+static int mwd_daemon_task(int argc, FAR char *argv[])
+{
+  struct mmwave_eng_data_s eng;
+  uint32_t now = mmwave_service_now_ms();
+  bool gates;
+
+  g_sensorfd = open(MMWAVE_SERVICE_DEV, O_RDONLY);
+  if (g_sensorfd < 0)
+    {
+      fprintf(stderr, "mmwaved: cannot open %s: %d\n", MMWAVE_SERVICE_DEV,
+              errno);
+      g_running = false;
+      return EXIT_FAILURE;
+    }
+
+  g_listenfd = mwd_listen();
+  if (g_listenfd < 0)
+    {
+      fprintf(stderr, "mmwaved: cannot listen on %s: %d\n",
+              CONFIG_MMWAVED_CTL_PATH, g_listenfd);
+      close(g_sensorfd);
+      g_running = false;
+      return EXIT_FAILURE;
+    }
+
+  sem_init(&g_job.done, 0, 0);
+  mwd_init(&g_mwd, CONFIG_MMWAVED_MAX_FDS, CONFIG_MMWAVED_STALE_MS, now);
+  for (int i = 0; g_services[i] != NULL; i++)
+    {
+      mwd_add(&g_mwd, g_services[i]);
+    }
+
+  g_started_ms = now;
+  g_heap_ms    = now;
+  g_heap_low   = 0;
+  g_requests   = 0;
+
+  printf("mmwaved: %d services available, control at %s\n", g_mwd.count,
+         CONFIG_MMWAVED_CTL_PATH);
+
+  while (g_running)
+    {
+      uint32_t wait = mwd_run(&g_mwd, now);
+      bool waiting = g_job.pending && g_job.client;
+      int n;
+
+      /* The frames that stop while the sensor reconfigures are expected */
+
+      if (waiting)
+        {
+          mwd_watchdog_touch(&g_mwd, now);
+        }
+
+      if (g_job.pending && sem_trywait(&g_job.done) == OK)
+        {
+          mwd_job_finish();
+          waiting = false;
+        }
+      else if (g_job.pending && wait > MWD_SENSOR_POLL_MS)
+        {
+          wait = MWD_SENSOR_POLL_MS;
+        }
+
+      if (!g_job.pending && mwd_watchdog_due(&g_mwd, now))
+        {
+          syslog(LOG_WARNING, "mmwaved: no sensor frame for %lu ms, "
+                 "restarting sensor\n",
+                 (unsigned long)(now - g_mwd.wd.last_frame_ms));
+          g_job.cmd = MMWAVE_IOC_RESTART;
+          g_job.arg = 0;
+          mwd_job_start(false);
+        }
+
+      if (g_clientfd >= 0 && !waiting &&
+          now - g_client_ms >= MWD_CTL_TIMEOUT_MS)
+        {
+          mwd_client_close();
+        }
+
+      mwd_heap_sample(now);
+
+      /* One control client at a time; others wait in the backlog */
+
+      g_pfds[MWD_FD_SENSOR].fd     = g_sensorfd;
+      g_pfds[MWD_FD_SENSOR].events = POLLIN;
+      g_pfds[MWD_FD_LISTEN].fd     = g_clientfd < 0 ? g_listenfd : -1;
+      g_pfds[MWD_FD_LISTEN].events = POLLIN;
+      g_pfds[MWD_FD_CLIENT].fd     = waiting ? -1 : g_clientfd;
+      g_pfds[MWD_FD_CLIENT].events = POLLIN;
+      for (int i = 0; i < MWD_BASE_FDS; i++)
+        {
+          g_pfds[i].revents = 0;
+        }
+
+      if (g_clientfd >= 0 && wait > MWD_CTL_TIMEOUT_MS)
+        {
+          wait = MWD_CTL_TIMEOUT_MS;
+        }
+
+      n = mwd_pollset(&g_mwd, g_pfds, MWD_BASE_FDS);
+      if (poll(g_pfds, n, wait) < 0 && errno != EINTR)
+        {
+          fprintf(stderr, "mmwaved: poll failed: %d\n", errno);
+          break;
+        }
+
+      now = mmwave_service_now_ms();
+
+      if ((g_pfds[MWD_FD_SENSOR].revents & POLLIN) &&
+          mmwave_service_read(g_sensorfd, &eng, &gates))
+        {
+          mwd_frame(&g_mwd, &eng, gates, now);
+        }
+
+      if (g_pfds[MWD_FD_CLIENT].revents & (POLLIN | POLLHUP | POLLERR))
+        {
+          mwd_client_input(now);
+        }
+      else if (g_pfds[MWD_FD_LISTEN].revents & POLLIN)
+        {
+          mwd_client_accept(now);
+        }
+
+      mwd_events(&g_mwd, g_pfds, now);
+    }
+
+  for (int i = 0; i < g_mwd.count; i++)
+    {
+      if (g_mwd.slots[i].state != MWD_STOPPED)
+        {
+          mwd_stop(&g_mwd, i);
+        }
+    }
+
+  /* A sensor command still running posts to done: let it finish */
+
+  if (g_job.pending)
+    {
+      while (sem_wait(&g_job.done) < 0 && errno == EINTR);
+      g_job.pending = false;
+    }
+
+  sem_destroy(&g_job.done);
+
+  if (g_clientfd >= 0)
+    {
+      mwd_client_close();
+    }
+
+  close(g_listenfd);
+  unlink(CONFIG_MMWAVED_CTL_PATH);
+  close(g_sensorfd);
+  g_listenfd = -1;
+  g_sensorfd = -1;
+  g_running  = false;
+  printf("mmwaved: stopped\n");
+  return OK;
+}
+
+static void print_status(void)
+{
+  FAR const struct mwd_watchdog_s *wd = &g_mwd.wd;
+  uint32_t now = mmwave_service_now_ms();
+  unsigned int hosted = 0;
+  unsigned int own = 0;
+
+  printf("Service Daemon\n");
+  printf("──────────────\n");
+  printf("  Daemon    : %s", g_running ? "RUNNING" : "stopped");
+  if (g_running)
+    {
+      printf(" (up %lu s, %lu requests)",
+             (unsigned long)((now - g_started_ms) / 1000),
+             (unsigned long)g_requests);
+    }
+
+  printf("\n  Control   : %s\n", CONFIG_MMWAVED_CTL_PATH);
+
+  if (!g_running)
+    {
+      return;
+    }
+
+  printf("  Services  :\n");
+  for (int i = 0; i < g_mwd.count; i++)
+    {
+      FAR const struct mwd_slot_s *s = &g_mwd.slots[i];
+
+      printf("    %-8s  %-8s  %lu restarts", s->svc->name,
+             mwd_state_str(s->state), (unsigned long)s->restarts);
+      if (s->last_error != 0)
+        {
+          printf(", last error %d", s->last_error);
+        }
+
+      printf("\n");
+
+      if (s->state != MWD_STOPPED)
+        {
+          hosted++;
+          own += s->svc->stack;
+        }
+    }
+
+  printf("  Poll set  : %d of %d service entries\n", mwd_fds_used(&g_mwd),
+         CONFIG_MMWAVED_MAX_FDS);
+  printf("  Sensor    : %lu frames, last %lu ms ago, %lu watchdog "
+         "restarts\n", (unsigned long)wd->frames,
+         (unsigned long)(now - wd->last_frame_ms),
+         (unsigned long)wd->restarts);
+  printf("  Heap      : %d bytes free, %d lowest\n", g_heap_free,
+         g_heap_low);
+  printf("  Stack     : %u bytes hosting %u services (%u as tasks)\n",
+         CONFIG_MMWAVED_STACKSIZE, hosted, own);
+  printf("  Sensor fds: 1 (%u as tasks)\n", hosted);
+
+  /* Not in the totals above: it exists only while a command runs */
+
+  if (g_job.pending)
+    {
+      printf("  Command   : running in mmwaved_sensor (%d B stack, one "
+             "more fd)\n", MWD_SENSOR_STACK);
+    }
+}
+
+static void print_usage(void)
+{
+  printf("Usage: mmwaved <command>\n\n");
+  printf("Commands:\n");
+  printf("  start    Start the service daemon\n");
+  printf("  stop     Stop it and the services it hosts\n");
+  printf("  status   Show hosted services, watchdog and heap\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  if (argc < 2)
+    {
+      print_usage();
+      return EXIT_FAILURE;
+    }
+
+  FAR const char *cmd = argv[1];
+
+  if (strcmp(cmd, "status") == 0)
+    {
+      print_status();
+    }
+  else if (strcmp(cmd, "start") == 0)
+    {
+      if (g_running)
+        {
+          printf("mmwaved: already running\n");
+          return OK;
+        }
+
+      g_running = true;
+
+      g_daemon_pid = task_create("mmwaved",
+                                 100,    /* priority */
+                                 CONFIG_MMWAVED_STACKSIZE,
+                                 mwd_daemon_task,
+                                 NULL);
+      if (g_daemon_pid < 0)
+        {
+          g_running = false;
+          fprintf(stderr, "mmwaved: failed to start task\n");
+          return EXIT_FAILURE;
+        }
+    }
+  else if (strcmp(cmd, "stop") == 0)
+    {
+      printf("mmwaved: stopping...\n");
+      g_running = false;
+    }
+  else
+    {
+      print_usage();
+    }
+
+  return OK;
+}
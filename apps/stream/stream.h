@@ -0,0 +1,442 @@
+/*
+ * apps/stream/stream.h
+ *
+ * Raw TCP stream of every sensor frame, for capturing engineering data
+ * at full rate. The connection carries length-prefixed binary records,
+ * all fields big-endian:
+ *
+ *   record  u16 length of what follows, then u8 type and the body
+ *
+ *   HELLO   (first record on every connection)
+ *     0  type = STREAM_REC_HELLO
+ *     1  version              STREAM_VERSION
+ *     2  gates per array      LD2410_MAX_GATES
+ *     3  reserved
+ *     4  device id            u32
+ *
+ *   FRAME   (one per sensor frame)
+ *     0  type = STREAM_REC_FRAME
+ *     1  flags                STREAM_F_xxx
+ *     2  sequence             u32, +1 per frame published
+ *     6  timestamp            u32, driver tick in ms
+ *     10 target state         u8
+ *     11 motion, static       u8 energies
+ *     13 motion, static,      u16 distances (cm)
+ *        detection distance
+ *     19 motion gates 0-8,    u8 energies, when STREAM_F_GATES
+ *        static gates 0-8
+ *
+ *   GAP     (this client missed records while its buffer was full)
+ *     0  type = STREAM_REC_GAP
+ *     1  frames dropped       u32
+ *
+ * Energies are sent as read, not quantised, since the point is offline
+ * tuning. Unknown record types can be skipped by length, so new ones
+ * may be added without breaking old readers.
+ *
+ * Each client has a fixed ring of CONFIG_STREAM_CLIENT_BUF bytes. A
+ * frame is encoded once and copied into every ring that has room for
+ * it whole; a full ring drops the frame for that client only, counts
+ * it, and tells the client with a GAP record once there is room again.
+ * Nothing on the publish path waits for a socket.
+ */
+
+#ifndef __APPS_STREAM_STREAM_H
+#define __APPS_STREAM_STREAM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include <errno.h>
+#include <sys/types.h>
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+
+#ifndef CONFIG_STREAM_MAX_CLIENTS
+#  define CONFIG_STREAM_MAX_CLIENTS  2
+#endif
+
+#ifndef CONFIG_STREAM_CLIENT_BUF
+#  define CONFIG_STREAM_CLIENT_BUF   1024
+#endif
+
+#define STREAM_VERSION        1
+
+#define STREAM_REC_HELLO      0x01
+#define STREAM_REC_FRAME      0x02
+#define STREAM_REC_GAP        0x03
+
+#define STREAM_F_GATES        0x01    /* Gate energies follow */
+
+#define STREAM_LEN_BYTES      2
+#define STREAM_HELLO_LEN      8
+#define STREAM_FRAME_LEN      19
+#define STREAM_GATES_LEN      (2 * LD2410_MAX_GATES)
+#define STREAM_GAP_LEN        5
+
+/* Largest record, length prefix included */
+
+#define STREAM_REC_MAX        (STREAM_LEN_BYTES + STREAM_FRAME_LEN + \
+                               STREAM_GATES_LEN)
+
+/*
+ * Write up to len bytes to a client. Returns the number taken (0 if the
+ * socket would block) or a negative errno.
+ */
+typedef ssize_t (*stream_send_t)(void *arg, int slot, const void *buf,
+                                 size_t len);
+
+struct stream_client_s
+{
+  bool     used;
+  uint16_t head;                /* Oldest unsent byte in ring */
+  uint16_t len;                 /* Bytes queued */
+  uint32_t gap;                 /* Frames dropped, not yet reported */
+  uint32_t frames;              /* Frames queued */
+  uint32_t dropped;             /* Frames dropped, ever */
+  uint32_t bytes;               /* Bytes sent */
+  uint8_t  ring[CONFIG_STREAM_CLIENT_BUF];
+};
+
+struct stream_s
+{
+  struct stream_client_s clients[CONFIG_STREAM_MAX_CLIENTS];
+  stream_send_t          send;
+  void                  *arg;
+  uint32_t               device_id;
+  uint32_t               seq;          /* Next frame's sequence number */
+  uint32_t               published;
+  uint32_t               refused;      /* No free slot */
+};
+
+/* Decoded record, for readers */
+
+struct stream_rec_s
+{
+  uint8_t  type;
+  uint8_t  version;             /* HELLO */
+  uint32_t device_id;           /* HELLO */
+  uint32_t dropped;             /* GAP */
+  uint32_t seq;                 /* FRAME ... */
+  bool     gates;
+  struct mmwave_eng_data_s eng;
+};
+
+/* ---- Byte order helpers ---- */
+
+static inline void stream_put16(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)(v >> 8);
+  p[1] = (uint8_t)v;
+}
+
+static inline void stream_put32(uint8_t *p, uint32_t v)
+{
+  stream_put16(p, (uint16_t)(v >> 16));
+  stream_put16(p + 2, (uint16_t)v);
+}
+
+static inline uint16_t stream_get16(const uint8_t *p)
+{
+  return (uint16_t)(p[0] << 8 | p[1]);
+}
+
+static inline uint32_t stream_get32(const uint8_t *p)
+{
+  return (uint32_t)stream_get16(p) << 16 | stream_get16(p + 2);
+}
+
+/* ---- Encoding ---- */
+
+/* Each returns the record length, prefix included */
+
+static inline size_t stream_enc_hello(uint8_t *p, uint32_t device_id)
+{
+  stream_put16(p, STREAM_HELLO_LEN);
+  p += STREAM_LEN_BYTES;
+  p[0] = STREAM_REC_HELLO;
+  p[1] = STREAM_VERSION;
+  p[2] = LD2410_MAX_GATES;
+  p[3] = 0;
+  stream_put32(p + 4, device_id);
+  return STREAM_LEN_BYTES + STREAM_HELLO_LEN;
+}
+
+static inline size_t stream_enc_gap(uint8_t *p, uint32_t dropped)
+{
+  stream_put16(p, STREAM_GAP_LEN);
+  p[2] = STREAM_REC_GAP;
+  stream_put32(p + 3, dropped);
+  return STREAM_LEN_BYTES + STREAM_GAP_LEN;
+}
+
+static inline size_t stream_enc_frame(uint8_t *p, uint32_t seq,
+                                      const struct mmwave_eng_data_s *e,
+                                      bool gates)
+{
+  const struct mmwave_data_s *d = &e->basic;
+  uint16_t len = STREAM_FRAME_LEN + (gates ? STREAM_GATES_LEN : 0);
+
+  stream_put16(p, len);
+  p += STREAM_LEN_BYTES;
+  p[0] = STREAM_REC_FRAME;
+  p[1] = gates ? STREAM_F_GATES : 0;
+  stream_put32(p + 2, seq);
+  stream_put32(p + 6, d->timestamp_ms);
+  p[10] = d->target_state;
+  p[11] = d->motion_energy;
+  p[12] = d->static_energy;
+  stream_put16(p + 13, d->motion_distance);
+  stream_put16(p + 15, d->static_distance);
+  stream_put16(p + 17, d->detection_distance);
+
+  if (gates)
+    {
+      memcpy(p + 19, e->motion_gate_energy, LD2410_MAX_GATES);
+      memcpy(p + 19 + LD2410_MAX_GATES, e->static_gate_energy,
+             LD2410_MAX_GATES);
+    }
+
+  return STREAM_LEN_BYTES + len;
+}
+
+/* ---- Decoding ---- */
+
+/*
+ * Decode one record body (after the length prefix). Returns OK,
+ * -EBADMSG if it is too short for its type, or -ENOMSG for a type this
+ * reader does not know (skip it by length).
+ */
+static inline int stream_decode(const uint8_t *p, size_t len,
+                                struct stream_rec_s *r)
+{
+  memset(r, 0, sizeof(*r));
+  if (len < 1)
+    {
+      return -EBADMSG;
+    }
+
+  r->type = p[0];
+  switch (r->type)
+    {
+      case STREAM_REC_HELLO:
+        if (len < STREAM_HELLO_LEN)
+          {
+            return -EBADMSG;
+          }
+
+        r->version   = p[1];
+        r->device_id = stream_get32(p + 4);
+        return OK;
+
+      case STREAM_REC_GAP:
+        if (len < STREAM_GAP_LEN)
+          {
+            return -EBADMSG;
+          }
+
+        r->dropped = stream_get32(p + 1);
+        return OK;
+
+      case STREAM_REC_FRAME:
+        r->gates = (p[1] & STREAM_F_GATES) != 0;
+        if (len < STREAM_FRAME_LEN + (r->gates ? STREAM_GATES_LEN : 0))
+          {
+            return -EBADMSG;
+          }
+
+        r->seq                         = stream_get32(p + 2);
+        r->eng.basic.timestamp_ms      = stream_get32(p + 6);
+        r->eng.basic.target_state      = p[10];
+        r->eng.basic.motion_energy     = p[11];
+        r->eng.basic.static_energy     = p[12];
+        r->eng.basic.motion_distance   = stream_get16(p + 13);
+        r->eng.basic.static_distance   = stream_get16(p + 15);
+        r->eng.basic.detection_distance = stream_get16(p + 17);
+
+        if (r->gates)
+          {
+            memcpy(r->eng.motion_gate_energy, p + 19, LD2410_MAX_GATES);
+            memcpy(r->eng.static_gate_energy, p + 19 + LD2410_MAX_GATES,
+                   LD2410_MAX_GATES);
+          }
+
+        return OK;
+
+      default:
+        return -ENOMSG;
+    }
+}
+
+/* ---- Per-client ring ---- */
+
+static inline size_t stream_room(const struct stream_client_s *c)
+{
+  return CONFIG_STREAM_CLIENT_BUF - c->len;
+}
+
+/* Append bytes the caller has checked fit */
+
+static inline void stream_put(struct stream_client_s *c, const uint8_t *buf,
+                              size_t len)
+{
+  size_t tail = (c->head + c->len) % CONFIG_STREAM_CLIENT_BUF;
+  size_t first = CONFIG_STREAM_CLIENT_BUF - tail;
+
+  if (first > len)
+    {
+      first = len;
+    }
+
+  memcpy(c->ring + tail, buf, first);
+  memcpy(c->ring, buf + first, len - first);
+  c->len += (uint16_t)len;
+}
+
+/* ---- Server ---- */
+
+static inline void stream_init(struct stream_s *s, stream_send_t send,
+                               void *arg, uint32_t device_id)
+{
+  memset(s, 0, sizeof(*s));
+  s->send      = send;
+  s->arg       = arg;
+  s->device_id = device_id;
+}
+
+/* Claim a slot for a new client and queue its HELLO; -EBUSY if full */
+
+static inline int stream_open(struct stream_s *s)
+{
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      struct stream_client_s *c = &s->clients[i];
+      uint8_t hello[STREAM_LEN_BYTES + STREAM_HELLO_LEN];
+
+      if (!c->used)
+        {
+          memset(c, 0, sizeof(*c) - sizeof(c->ring));
+          c->used = true;
+          stream_put(c, hello, stream_enc_hello(hello, s->device_id));
+          return i;
+        }
+    }
+
+  s->refused++;
+  return -EBUSY;
+}
+
+static inline void stream_close(struct stream_s *s, int slot)
+{
+  s->clients[slot].used = false;
+}
+
+static inline int stream_clients(const struct stream_s *s)
+{
+  int n = 0;
+
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      n += s->clients[i].used;
+    }
+
+  return n;
+}
+
+static inline bool stream_wants_write(const struct stream_s *s, int slot)
+{
+  return s->clients[slot].used && s->clients[slot].len > 0;
+}
+
+/*
+ * Queue one sensor frame for every client. A client without room for
+ * the frame (and the GAP record it owes) drops it. Returns the number
+ * of clients that dropped it.
+ */
+static inline int stream_publish(struct stream_s *s,
+                                 const struct mmwave_eng_data_s *e,
+                                 bool gates)
+{
+  uint8_t rec[STREAM_REC_MAX];
+  size_t len = stream_enc_frame(rec, s->seq++, e, gates);
+  int drops = 0;
+
+  s->published++;
+
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      struct stream_client_s *c = &s->clients[i];
+      size_t need = len + (c->gap ? STREAM_LEN_BYTES + STREAM_GAP_LEN : 0);
+
+      if (!c->used)
+        {
+          continue;
+        }
+
+      if (stream_room(c) < need)
+        {
+          c->gap++;
+          c->dropped++;
+          drops++;
+          continue;
+        }
+
+      if (c->gap)
+        {
+          uint8_t gap[STREAM_LEN_BYTES + STREAM_GAP_LEN];
+
+          stream_put(c, gap, stream_enc_gap(gap, c->gap));
+          c->gap = 0;
+        }
+
+      stream_put(c, rec, len);
+      c->frames++;
+    }
+
+  return drops;
+}
+
+/*
+ * Send as much of a client's ring as the socket takes. Returns OK
+ * (including when it would block) or a negative errno from the send
+ * callback, after which the caller should close the slot.
+ */
+static inline int stream_flush(struct stream_s *s, int slot)
+{
+  struct stream_client_s *c = &s->clients[slot];
+
+  while (c->len > 0)
+    {
+      size_t chunk = CONFIG_STREAM_CLIENT_BUF - c->head;
+      ssize_t n;
+
+      if (chunk > c->len)
+        {
+          chunk = c->len;
+        }
+
+      n = s->send(s->arg, slot, c->ring + c->head, chunk);
+      if (n < 0)
+        {
+          return (int)n;
+        }
+
+      if (n == 0)
+        {
+          break;
+        }
+
+      c->head   = (uint16_t)((c->head + n) % CONFIG_STREAM_CLIENT_BUF);
+      c->len   -= (uint16_t)n;
+      c->bytes += (uint32_t)n;
+    }
+
+  if (c->len == 0)
+    {
+      c->head = 0;
+    }
+
+  return OK;
+}
+
+#endif /* __APPS_STREAM_STREAM_H */
@@ -0,0 +1,441 @@
+/****************************************************************************
+ * apps/stream/stream_cmd.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * NSH command: stream — raw TCP stream of every sensor frame
+ *
+ * Usage:
+ *   stream start              — Start the stream server (in mmwaved
+ *                               if it is running, else in its own task)
+ *   stream stop               — Stop it and disconnect all clients
+ *   stream status             — Show clients, frame and drop counters
+ *
+ * Every frame the driver parses is sent to each connected client as a
+ * length-prefixed binary record (apps/stream/stream.h), with per-gate
+ * energies while engineering mode is on. This replaces `mmwave -w` over
+ * the console for capturing tuning data. On a host:
+ *
+ *   stream_cap -o capture.bin <device>
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#ifdef CONFIG_NETUTILS_NETLIB
+#  include "netutils/netlib.h"
+#endif
+
+#include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_service.h"
+#include "stream.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_STREAM_PORT
+#  define CONFIG_STREAM_PORT    5410
+#endif
+
+#define STREAM_BACKLOG          1
+#define STREAM_IFNAME           "wlan0"
+#define STREAM_TASK_STACK       2048
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static int  stream_start(void);
+static void stream_pollset(FAR struct pollfd *pfds);
+static int  stream_events(FAR const struct pollfd *pfds, uint32_t now);
+static void stream_frame(FAR const struct mmwave_eng_data_s *eng,
+                         bool gates, uint32_t now);
+static void stream_stop(void);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+/* Client rings live here, not on the task stack */
+
+static struct stream_s g_stream;
+static int             g_fds[CONFIG_STREAM_MAX_CLIENTS];
+static int             g_listenfd = -1;
+static uint32_t        g_send_errors;
+static volatile bool   g_running = false;
+static pid_t           g_server_pid = -1;
+
+/****************************************************************************
+ * Public Data
+ ****************************************************************************/
+
+/* Run by the stream task, or hosted by mmwaved */
+
+const struct mmwave_service_s g_stream_service =
+{
+  "stream", &g_running, CONFIG_STREAM_MAX_CLIENTS + 1, STREAM_TASK_STACK,
+  stream_start, stream_pollset, stream_events, stream_frame, NULL, stream_stop
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+/* stream_send_t over the client's socket, never blocking */
+
+static ssize_t stream_tcp_send(FAR void *arg, int slot,
+                               FAR const void *buf, size_t len)
+{
+  ssize_t n = send(g_fds[slot], buf, len, MSG_DONTWAIT);
+
+  if (n < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -errno;
+    }
+
+  return n;
+}
+
+/* Low 32 bits of the MAC, so captures from each device stay apart */
+
+static uint32_t stream_device_id(void)
+{
+#ifdef CONFIG_NETUTILS_NETLIB
+  uint8_t mac[6];
+
+  if (netlib_getmacaddr(STREAM_IFNAME, mac) == OK)
+    {
+      return (uint32_t)mac[2] << 24 | (uint32_t)mac[3] << 16 |
+             (uint32_t)mac[4] << 8 | mac[5];
+    }
+#endif
+
+  return 1;
+}
+
+static int stream_listen(void)
+{
+  struct sockaddr_in addr;
+  int one = 1;
+  int fd;
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0)
+    {
+      return -errno;
+    }
+
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons(CONFIG_STREAM_PORT);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+
+  if (bind(fd, (FAR struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(fd, STREAM_BACKLOG) < 0)
+    {
+      int ret = -errno;
+      close(fd);
+      return ret;
+    }
+
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  return fd;
+}
+
+static void stream_drop(int slot)
+{
+  stream_close(&g_stream, slot);
+  close(g_fds[slot]);
+  g_fds[slot] = -1;
+}
+
+static void stream_accept(int listenfd)
+{
+  for (; ; )
+    {
+      int fd = accept(listenfd, NULL, NULL);
+      int one = 1;
+      int slot;
+
+      if (fd < 0)
+        {
+          return;
+        }
+
+      slot = stream_open(&g_stream);
+      if (slot < 0)
+        {
+          close(fd);
+          continue;
+        }
+
+      /* Records are small and latency matters more than packing */
+
+      setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+      g_fds[slot] = fd;
+    }
+}
+
+/* Clients never send; readable means closed (or stray bytes to discard) */
+
+static void stream_receive(int slot)
+{
+  char buf[32];
+  ssize_t n = recv(g_fds[slot], buf, sizeof(buf), MSG_DONTWAIT);
+
+  if (n == 0 || (n < 0 && errno != EAGAIN && errno != EWOULDBLOCK))
+    {
+      stream_drop(slot);
+    }
+}
+
+static void stream_flush_slot(int slot)
+{
+  if (stream_flush(&g_stream, slot) < 0)
+    {
+      g_send_errors++;
+      stream_drop(slot);
+    }
+}
+
+static int stream_start(void)
+{
+  g_listenfd = stream_listen();
+  if (g_listenfd < 0)
+    {
+      fprintf(stderr, "stream: cannot listen on port %u: %d\n",
+              CONFIG_STREAM_PORT, g_listenfd);
+      return g_listenfd;
+    }
+
+  stream_init(&g_stream, stream_tcp_send, NULL, stream_device_id());
+  g_send_errors = 0;
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      g_fds[i] = -1;
+    }
+
+  printf("stream: listening on tcp port %u (%d clients)\n",
+         CONFIG_STREAM_PORT, CONFIG_STREAM_MAX_CLIENTS);
+  return OK;
+}
+
+static void stream_pollset(FAR struct pollfd *pfds)
+{
+  pfds[0].fd     = g_listenfd;
+  pfds[0].events = POLLIN;
+
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      pfds[i + 1].fd     = g_fds[i];
+      pfds[i + 1].events = POLLIN;
+      if (g_fds[i] >= 0 && stream_wants_write(&g_stream, i))
+        {
+          pfds[i + 1].events |= POLLOUT;
+        }
+    }
+}
+
+static int stream_events(FAR const struct pollfd *pfds, uint32_t now)
+{
+  if (pfds[0].revents & (POLLERR | POLLNVAL))
+    {
+      return -EIO;
+    }
+
+  if (pfds[0].revents & POLLIN)
+    {
+      stream_accept(g_listenfd);
+    }
+
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      FAR const struct pollfd *pfd = &pfds[i + 1];
+
+      if (g_fds[i] < 0 || pfd->fd != g_fds[i])
+        {
+          continue;
+        }
+
+      if (pfd->revents & (POLLIN | POLLHUP | POLLERR))
+        {
+          stream_receive(i);
+        }
+
+      if (g_fds[i] >= 0 && stream_wants_write(&g_stream, i))
+        {
+          stream_flush_slot(i);
+        }
+    }
+
+  return OK;
+}
+
+/****************************************************************************
+ * Name: stream_frame
+ *
+ * Description:
+ *   Called once per frame the driver parses: the frame is encoded once
+ *   and queued for every client, then each client is sent what its
+ *   socket will take. A client that falls behind loses frames from its
+ *   own ring only.
+ *
+ ****************************************************************************/
+
+static void stream_frame(FAR const struct mmwave_eng_data_s *eng,
+                         bool gates, uint32_t now)
+{
+  if (stream_clients(&g_stream) == 0)
+    {
+      return;
+    }
+
+  stream_publish(&g_stream, eng, gates);
+
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      if (stream_wants_write(&g_stream, i))
+        {
+          stream_flush_slot(i);
+        }
+    }
+}
+
+static void stream_stop(void)
+{
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      if (g_fds[i] >= 0)
+        {
+          stream_drop(i);
+        }
+    }
+
+  close(g_listenfd);
+  g_listenfd = -1;
+  printf("stream: server stopped\n");
+}
+
+static int stream_server_task(int argc, FAR char *argv[])
+{
+  return mmwave_service_run(&g_stream_service);
+}
+
+static void print_status(void)
+{
+  printf("Engineering Stream\n");
+  printf("──────────────────\n");
+  printf("  Server    : %s\n", g_running ? "RUNNING" : "stopped");
+  printf("  Port      : %u/tcp\n", CONFIG_STREAM_PORT);
+  printf("  Frames    : %lu published (seq %lu)\n",
+         (unsigned long)g_stream.published, (unsigned long)g_stream.seq);
+
+  for (int i = 0; g_running && i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      FAR const struct stream_client_s *c = &g_stream.clients[i];
+
+      if (!c->used)
+        {
+          continue;
+        }
+
+      printf("  Client %d  : %lu frames, %lu dropped, %lu bytes sent, "
+             "%u queued\n", i, (unsigned long)c->frames,
+             (unsigned long)c->dropped, (unsigned long)c->bytes,
+             (unsigned)c->len);
+    }
+
+  printf("  Clients   : %d of %d, %lu refused, %lu send errors\n",
+         g_running ? stream_clients(&g_stream) : 0,
+         CONFIG_STREAM_MAX_CLIENTS, (unsigned long)g_stream.refused,
+         (unsigned long)g_send_errors);
+}
+
+static void print_usage(void)
+{
+  printf("Usage: stream <command>\n\n");
+  printf("Commands:\n");
+  printf("  start    Start the stream server\n");
+  printf("  stop     Stop the server\n");
+  printf("  status   Show clients and counters\n");
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+int main(int argc, FAR char *argv[])
+{
+  if (argc < 2)
+    {
+      print_usage();
+      return EXIT_FAILURE;
+    }
+
+  FAR const char *cmd = argv[1];
+
+  if (strcmp(cmd, "status") == 0)
+    {
+      print_status();
+    }
+  else if (strcmp(cmd, "start") == 0)
+    {
+      if (g_running)
+        {
+          printf("stream: server already running\n");
+          return OK;
+        }
+
+      int ret = mmwave_service_delegate(&g_stream_service);
+      if (ret != -ESRCH)
+        {
+          return ret == OK ? OK : EXIT_FAILURE;
+        }
+
+      g_running = true;
+
+      g_server_pid = task_create("stream",
+                                 100,    /* priority */
+                                 STREAM_TASK_STACK,
+                                 stream_server_task,
+                                 NULL);
+      if (g_server_pid < 0)
+        {
+          g_running = false;
+          fprintf(stderr, "stream: failed to start task\n");
+          return EXIT_FAILURE;
+        }
+    }
+  else if (strcmp(cmd, "stop") == 0)
+    {
+      printf("stream: stopping...\n");
+      mmwave_service_stop(&g_stream_service);
+    }
+  else
+    {
+      print_usage();
+    }
+
+  return OK;
+}
@@ -8,6 +8,8 @@
  * Usage:
  *   sysinfo          — Print full system status
  *   sysinfo -m       — Memory only
+ *   sysinfo -b       — Boot milestones, ms since boot
+ *   sysinfo -p       — Time in each power state (CONFIG_MMWAVE_PM)
  *   sysinfo -j       — JSON output
  *
  ****************************************************************************/
@@ -20,9 +22,11 @@
 #include <unistd.h>
 #include <fcntl.h>
 
+#include <sys/ioctl.h>
 #include <nuttx/clock.h>
 
 #include "drivers/mmwave/mmwave_ld2410.h"
+#include "apps/common/mmwave_json.h"
 
 /****************************************************************************
  * Private Functions
@@ -111,30 +115,143 @@ static void print_mmwave_stats(void)
     }
 }
 
+static bool read_boottime(FAR struct mmwave_boottime_s *bt)
+{
+  int fd = open("/dev/mmwave0", O_RDONLY);
+  int ret;
+
+  if (fd < 0)
+    {
+      return false;
+    }
+
+  ret = ioctl(fd, MMWAVE_IOC_GET_BOOTTIME, (unsigned long)bt);
+  close(fd);
+  return ret >= 0;
+}
+
+static void print_boottime(void)
+{
+  static const char *const labels[MMWAVE_MILESTONES] =
+  {
+    "/config mounted", "Driver ready", "First frame", "Wi-Fi joined",
+    "DHCP bound", "First report"
+  };
+
+  struct mmwave_boottime_s bt;
+
+  if (!read_boottime(&bt))
+    {
+      printf("  Radar driver not available\n");
+      return;
+    }
+
+  for (int i = 0; i < MMWAVE_MILESTONES; i++)
+    {
+      if (bt.ms[i] != 0)
+        {
+          printf("  %-16s: %6lu ms\n", labels[i], (unsigned long)bt.ms[i]);
+        }
+      else
+        {
+          printf("  %-16s: -\n", labels[i]);
+        }
+    }
+}
+
+static bool read_pm(FAR struct mmwave_pm_stats_s *pm)
+{
+  int fd = open("/dev/mmwave0", O_RDONLY);
+  int ret;
+
+  if (fd < 0)
+    {
+      return false;
+    }
+
+  ret = ioctl(fd, MMWAVE_IOC_GET_PM, (unsigned long)pm);
+  close(fd);
+  return ret >= 0;
+}
+
+static void print_pm(void)
+{
+  static const char *const labels[MMWAVE_PM_NSTATES] =
+  {
+    "Normal", "Idle", "Standby"
+  };
+
+  struct mmwave_pm_stats_s pm;
+  uint64_t total = 0;
+
+  if (!read_pm(&pm))
+    {
+      printf("  PM governor not available\n");
+      return;
+    }
+
+  for (int i = 0; i < MMWAVE_PM_NSTATES; i++)
+    {
+      total += pm.ms[i];
+    }
+
+  for (int i = 0; i < MMWAVE_PM_NSTATES; i++)
+    {
+      unsigned pct = total > 0 ? (unsigned)(pm.ms[i] * 100ull / total) : 0;
+
+      printf("  %-8s: %9lu ms %3u%%  %6lu entries%s\n", labels[i],
+             (unsigned long)pm.ms[i], pct, (unsigned long)pm.entries[i],
+             pm.state == i ? "  <- now" : "");
+    }
+}
+
 static void print_json(void)
 {
   struct mallinfo info = mallinfo();
   uint32_t secs = clock_systime_ticks() / TICK_PER_SEC;
+  struct json_writer_s w;
 
-  printf("{\"uptime_s\":%lu,", (unsigned long)secs);
-  printf("\"heap_total\":%d,", info.arena);
-  printf("\"heap_used\":%d,", info.uordblks);
-  printf("\"heap_free\":%d", info.fordblks);
+  json_init(&w, json_sink_stdout, NULL);
+  json_begin_object(&w, NULL);
+  json_uint(&w, "uptime_s", secs);
+  json_int(&w, "heap_total", info.arena);
+  json_int(&w, "heap_used", info.uordblks);
+  json_int(&w, "heap_free", info.fordblks);
+
+  struct mmwave_data_s data;
+  bool active = false;
 
   int fd = open("/dev/mmwave0", O_RDONLY);
   if (fd >= 0)
     {
-      struct mmwave_data_s data;
-      if (read(fd, &data, sizeof(data)) == sizeof(data))
-        {
-          printf(",\"radar_active\":true");
-          printf(",\"presence\":%s",
-                 data.target_state != LD2410_TARGET_NONE ? "true" : "false");
-        }
+      active = read(fd, &data, sizeof(data)) == sizeof(data);
       close(fd);
     }
 
-  printf("}\n");
+  json_bool(&w, "radar_active", active);
+  if (active)
+    {
+      json_bool(&w, "presence", mmwave_json_presence(&data));
+      mmwave_json_fields(&w, &data);
+    }
+
+  struct mmwave_boottime_s bt;
+
+  if (read_boottime(&bt))
+    {
+      mmwave_json_boottime(&w, &bt);
+    }
+
+  struct mmwave_pm_stats_s pm;
+
+  if (read_pm(&pm))
+    {
+      mmwave_json_pm(&w, &pm);
+    }
+
+  json_end_object(&w);
+  json_char(&w, '\n');
+  json_finish(&w);
 }
 
 /****************************************************************************
@@ -149,6 +266,22 @@ int main(int argc, FAR char *argv[])
       return OK;
     }
 
+  if (argc > 1 && strcmp(argv[1], "-b") == 0)
+    {
+      printf("Boot milestones (since the OS started)\n");
+      printf("───────────────\n");
+      print_boottime();
+      return OK;
+    }
+
+  if (argc > 1 && strcmp(argv[1], "-p") == 0)
+    {
+      printf("Power states (since the governor started)\n");
+      printf("────────────\n");
+      print_pm();
+      return OK;
+    }
+
   if (argc > 1 && strcmp(argv[1], "-m") == 0)
     {
       printf("Memory\n");
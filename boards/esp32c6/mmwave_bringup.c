@@ -7,9 +7,30 @@
  * Called from NuttX board_late_initialize() or nsh_archinitialize().
  *
  * Boot sequence:
- *   1. Mount LittleFS at /config
- *   2. Register mmWave LD2410 driver at /dev/mmwave0
- *   3. (Wi-Fi and HA started later from init script)
+ *   1. Register mmWave LD2410 driver at /dev/mmwave0 on the Kconfig UART
+ *      and baud rate, before any storage is touched
+ *   2. Mount LittleFS at /config (formatting it if it will not mount)
+ *      and load the config service, on the LP work queue; readers of the
+ *      config service wait for it (config_svc_wait_ready())
+ *   3. Unless boot.native is 0, the boot sequencer: a task that brings
+ *      up the sensor, associates with Wi-Fi, runs DHCP and starts the
+ *      service daemon and the autostart services, each as soon as what
+ *      it depends on is there (apps/common/mmwave_boot.h). Wi-Fi goes
+ *      to the cached access point and reuses the cached lease first
+ *      (apps/common/mmwave_wifi.h). Bringing up the sensor here means
+ *      re-registering it if mmwave.uart or mmwave.baud override the
+ *      Kconfig defaults, and bringing it to the mmwave.* tuning keys on
+ *      the LP work queue, and again whenever they change. With
+ *      boot.native 0 the task does only that and rcS does the rest,
+ *      reading its settings with one `config export`.
+ *
+ * With CONFIG_MMWAVE_SLEEP the board deep sleeps once nothing has been
+ * seen for sleep.idle seconds, and a wake resumes from the state kept
+ * in RTC memory (apps/common/mmwave_resume.h).
+ *
+ * With CONFIG_MMWAVE_PM the idle domain's PM governor follows the sensor
+ * (drivers/mmwave/mmwave_pm.c); the boot sequence holds full
+ * performance until it is done.
  *
  ****************************************************************************/
 
@@ -33,12 +54,1221 @@
 #include "drivers/mmwave/mmwave_ld2410.h"
 #endif
 
+#ifdef CONFIG_PM
+#include <nuttx/power/pm.h>
+#endif
+
+#ifdef CONFIG_FS_LITTLEFS
+#include <nuttx/wqueue.h>
+#endif
+
+#ifdef CONFIG_CONFIG_CMD
+#include "apps/config/config_svc.h"
+#endif
+
+#if defined(CONFIG_MMWAVE_LD2410) && defined(CONFIG_CONFIG_CMD)
+#include <nuttx/wqueue.h>
+#include "apps/common/mmwave_tune.h"
+#define MMWAVE_TUNE 1
+#endif
+
+#ifdef CONFIG_CONFIG_CMD
+#include <sched.h>
+#include <semaphore.h>
+#include <unistd.h>
+#include <time.h>
+#include "apps/common/mmwave_boot.h"
+#define MMWAVE_BOOT 1
+#endif
+
+#ifdef CONFIG_MMWAVED_CMD
+#include "apps/common/mmwave_service.h"
+#endif
+
+#if defined(MMWAVE_BOOT) && defined(CONFIG_WIRELESS_WAPI) && \
+    defined(CONFIG_NETUTILS_DHCPC)
+#include <net/if.h>
+#include <net/ethernet.h>
+#include <nuttx/wqueue.h>
+#include "netutils/netlib.h"
+#include "netutils/dhcpc.h"
+#include "wireless/wapi.h"
+#include "apps/common/mmwave_wifi.h"
+#define MMWAVE_BOOT_NET 1
+#endif
+
+#if defined(CONFIG_MMWAVE_SLEEP) && defined(MMWAVE_TUNE)
+#include <nuttx/clock.h>
+#include <nuttx/compiler.h>
+#include "apps/common/mmwave_resume.h"
+#include "esp_sleep.h"                  /* The chip port's HAL */
+#define MMWAVE_SLEEP 1
+#endif
+
 /****************************************************************************
  * Pre-processor Definitions
  ****************************************************************************/
 
 #define CONFIG_MOUNT_POINT    "/config"
 
+#define BOOT_PRIORITY         110      /* Above NSH: ahead of rc.sysinit */
+#define BOOT_STACKSIZE        2048
+#define BOOT_STEP_STACKSIZE   2048     /* Wi-Fi association, DHCP */
+#define BOOT_WLAN             "wlan0"
+#define BOOT_DHCP_TIMEOUT_S   30
+#define BOOT_MMWAVED_WAIT_MS  1000     /* For its control socket */
+
+#define SLEEP_POLL_MS         1000     /* Checks whether it may sleep */
+
+#ifndef CONFIG_MMWAVE_LD2410_OUT_GPIO
+#  define CONFIG_MMWAVE_LD2410_OUT_GPIO -1
+#endif
+
+/* Memory the chip keeps powered in deep sleep; zero after a reset */
+
+#ifndef MMWAVE_RTC_DATA
+#  define MMWAVE_RTC_DATA     locate_data(".rtc.data")
+#endif
+
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+#ifdef MMWAVE_BOOT
+struct boot_run_s
+{
+  CODE int (*run)(void);
+  FAR const char *key;                 /* Autostart key, NULL: always */
+  bool def;
+};
+#endif
+
+/****************************************************************************
+ * External Function Prototypes
+ ****************************************************************************/
+
+/* Builtin entry points the sequencer calls as NSH would, without the
+ * shell: the flat build links every app into one image.
+ */
+
+#ifdef CONFIG_MMWAVED_CMD
+int mmwaved_main(int argc, FAR char *argv[]);
+#endif
+#ifdef CONFIG_HACTL_CMD
+int hactl_main(int argc, FAR char *argv[]);
+#endif
+#ifdef CONFIG_ESPHOME_API_CMD
+int esphome_main(int argc, FAR char *argv[]);
+#endif
+#ifdef CONFIG_COAP_SERVER_CMD
+int coap_main(int argc, FAR char *argv[]);
+#endif
+#ifdef CONFIG_MCAST_CMD
+int mcast_main(int argc, FAR char *argv[]);
+#endif
+#ifdef CONFIG_HTTPD_CMD
+int httpd_main(int argc, FAR char *argv[]);
+#endif
+#ifdef CONFIG_STREAM_CMD
+int stream_main(int argc, FAR char *argv[]);
+#endif
+#ifdef CONFIG_MMWAVE_PROFILE
+int mmwave_main(int argc, FAR char *argv[]);
+#endif
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+#ifdef CONFIG_MMWAVE_LD2410
+static char g_sensor_uart[32];         /* The driver keeps the pointer */
+static uint32_t g_sensor_baud;
+#endif
+
+#ifdef CONFIG_FS_LITTLEFS
+static struct work_s g_mount_work;
+#endif
+
+#ifdef MMWAVE_TUNE
+static struct work_s g_tune_work;
+#endif
+
+#ifdef MMWAVE_BOOT
+static struct mmwave_boot_s g_boot;
+static sem_t g_boot_sem = SEM_INITIALIZER(0);
+static volatile uint32_t g_boot_over;  /* Async steps finished, by bit */
+static int g_boot_ret[MMWAVE_BOOT_NSTEPS];
+static uint32_t g_boot_start_ms;
+
+/* Read once when the sequencer starts */
+
+static char g_boot_ssid[33];
+static char g_boot_psk[65];
+#endif
+
+#ifdef MMWAVE_BOOT_NET
+static FAR void *g_dhcpc;
+static sem_t g_dhcp_sem = SEM_INITIALIZER(0);
+
+/* The reconnect cache for wifi.ssid and wifi.psk, read at start */
+
+static uint32_t g_boot_tag;
+static struct mmwave_wifi_ap_s g_boot_ap;
+static bool g_boot_ap_cached;
+static struct mmwave_wifi_addr_s g_boot_lease;
+static bool g_boot_lease_cached;
+static struct mmwave_wifi_addr_s g_boot_static;
+static bool g_boot_static_set;
+static char g_boot_lease_val[MMWAVE_WIFI_ADDR_MAX];
+static struct work_s g_boot_cache_work;
+#endif
+
+#ifdef MMWAVE_SLEEP
+static struct mmwave_resume_s g_resume MMWAVE_RTC_DATA;
+static bool g_resumed;                 /* g_resume was taken this boot */
+static bool g_resume_timed;            /* Its first report is counted */
+static struct work_s g_sleep_work;
+static uint32_t g_sleep_seen_ms;       /* A target last seen */
+#endif
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+#ifdef MMWAVE_TUNE
+/* On the LP work queue: the sensor to the stored baud and tuning. The
+ * driver compares with its copy of the sensor's configuration and sends
+ * only what differs, usually nothing.
+ */
+
+static void mmwave_tune_worker(FAR void *arg)
+{
+  struct mmwave_apply_s req;
+  long baud = config_svc_get_int("mmwave.baud", 0);
+  int ret;
+
+  if (baud > 0 && (ret = mmwave_ld2410_set_baud((uint32_t)baud)) < 0)
+    {
+      syslog(LOG_WARNING, "mmWave OS: sensor baud %ld: %d\n", baud, ret);
+    }
+
+  if (mmwave_tune_load(&req) == 0)
+    {
+      return;
+    }
+
+  ret = mmwave_ld2410_apply(&req);
+  if (ret < 0)
+    {
+      syslog(LOG_WARNING, "mmWave OS: sensor tuning not applied: %d\n",
+             ret);
+    }
+  else if (ret > 0)
+    {
+      syslog(LOG_INFO, "mmWave OS: sensor tuning: %d command(s)\n", ret);
+    }
+}
+
+/* A write to mmwave.* or a reset: one pass picks up every change */
+
+static void mmwave_tune_changed(FAR const char *key, FAR const char *val,
+                                FAR void *arg)
+{
+  if (work_available(&g_tune_work))
+    {
+      work_queue(LPWORK, &g_tune_work, mmwave_tune_worker, NULL, 0);
+    }
+}
+#endif
+
+#ifdef CONFIG_MMWAVE_LD2410
+static int mmwave_sensor_register(void)
+{
+  int ret;
+
+  syslog(LOG_INFO, "mmWave OS: registering LD2410 driver\n");
+
+  ret = mmwave_ld2410_register(CONFIG_MMWAVE_LD2410_DEVPATH, g_sensor_uart,
+                               g_sensor_baud);
+  if (ret < 0)
+    {
+      syslog(LOG_ERR,
+             "mmWave OS: LD2410 registration failed: %d\n", ret);
+      return ret;
+    }
+
+  syslog(LOG_INFO,
+         "mmWave OS: LD2410 ready at %s (UART: %s @ %lu baud)\n",
+         CONFIG_MMWAVE_LD2410_DEVPATH, g_sensor_uart,
+         (unsigned long)g_sensor_baud);
+  return OK;
+}
+#endif
+
+/* Register the driver at /dev/mmwave0 with the Kconfig UART and baud,
+ * before /config is mounted: presence is up while the mount runs.
+ */
+
+static int mmwave_sensor_bringup(void)
+{
+#ifdef CONFIG_MMWAVE_LD2410
+#ifdef MMWAVE_SLEEP
+  if (g_resumed)
+    {
+      int ret;
+
+      /* The UART and the sensor's configuration it had before the
+       * sleep: nothing to look up, nothing to read back
+       */
+
+      strlcpy(g_sensor_uart, g_resume.uart, sizeof(g_sensor_uart));
+      g_sensor_baud = g_resume.baud;
+      ret = mmwave_sensor_register();
+      if (ret == OK)
+        {
+          mmwave_ld2410_restore(&g_resume.sensor);
+        }
+
+      return ret;
+    }
+#endif
+
+  strlcpy(g_sensor_uart, CONFIG_MMWAVE_LD2410_UART_PATH,
+          sizeof(g_sensor_uart));
+  g_sensor_baud = CONFIG_MMWAVE_LD2410_BAUD;
+  return mmwave_sensor_register();
+#else
+  return -ENODEV;
+#endif
+}
+
+#ifdef CONFIG_CONFIG_CMD
+/* Once the config is loaded: move the driver to mmwave.uart and
+ * mmwave.baud if they override the Kconfig defaults (before anything
+ * has it open), and keep the sensor at the mmwave.* tuning.
+ */
+
+static int mmwave_sensor_config(void)
+{
+#ifdef CONFIG_MMWAVE_LD2410
+  char uart[sizeof(g_sensor_uart)];
+  long baud;
+  int ret = OK;
+
+#ifdef MMWAVE_SLEEP
+  if (g_resumed)
+    {
+      /* The keys have not changed while it slept: only the watcher */
+
+      config_svc_watch(MMWAVE_TUNE_PREFIX, mmwave_tune_changed, NULL);
+      return OK;
+    }
+#endif
+
+  config_svc_get_str("mmwave.uart", uart, sizeof(uart), g_sensor_uart);
+  baud = config_svc_get_int("mmwave.baud", (long)g_sensor_baud);
+
+  if (strcmp(uart, g_sensor_uart) != 0 || baud != (long)g_sensor_baud)
+    {
+      mmwave_ld2410_unregister(CONFIG_MMWAVE_LD2410_DEVPATH);
+      strlcpy(g_sensor_uart, uart, sizeof(g_sensor_uart));
+      g_sensor_baud = (uint32_t)baud;
+      ret = mmwave_sensor_register();
+    }
+
+#ifdef MMWAVE_TUNE
+  if (ret == OK)
+    {
+      config_svc_watch(MMWAVE_TUNE_PREFIX, mmwave_tune_changed, NULL);
+      mmwave_tune_changed(NULL, NULL, NULL);
+    }
+#endif
+
+  return ret;
+#else
+  return -ENODEV;
+#endif
+}
+#endif
+
+/* Mount LittleFS at /config, formatting it if it will not mount */
+
+#ifdef CONFIG_FS_LITTLEFS
+static int mmwave_mount_config(void)
+{
+  FAR struct mtd_dev_s *mtd = NULL;
+  int ret;
+
+  syslog(LOG_INFO, "mmWave OS: mounting LittleFS at %s\n",
+         CONFIG_MOUNT_POINT);
+
+#ifdef CONFIG_ESP32C6_SPIFLASH
+  /* The ESP32-C6 flash MTD is initialized by the chip-level code.
+   * We access our storage partition via the registered MTD device.
+   * Typically: /dev/esp-storage or an MTD registered by the partition
+   * table. Here we use the platform-provided API.
+   */
+
+  extern FAR struct mtd_dev_s *esp32c6_get_storage_mtd(void);
+  mtd = esp32c6_get_storage_mtd();
+#endif
+
+  if (mtd == NULL)
+    {
+      syslog(LOG_WARNING,
+             "mmWave OS: no storage MTD available, /config disabled\n");
+      return -ENODEV;
+    }
+
+  ret = mount(NULL, CONFIG_MOUNT_POINT, "littlefs", 0, (FAR void *)mtd);
+  if (ret < 0)
+    {
+      syslog(LOG_WARNING,
+             "mmWave OS: LittleFS mount failed (%d), formatting...\n",
+             ret);
+
+      /* Format and retry */
+
+      ret = mount(NULL, CONFIG_MOUNT_POINT, "littlefs", 0, "forceformat");
+      if (ret < 0)
+        {
+          syslog(LOG_ERR,
+                 "mmWave OS: LittleFS format+mount failed: %d\n", ret);
+          return ret;
+        }
+    }
+
+  syslog(LOG_INFO, "mmWave OS: /config mounted OK\n");
+#ifdef CONFIG_MMWAVE_LD2410
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_MOUNT);
+#endif
+  return OK;
+}
+#endif
+
+/* The only read of config.log this boot: every app, the init script
+ * and the sequencer take their settings from RAM.
+ */
+
+static void mmwave_load_config(void)
+{
+#ifdef CONFIG_CONFIG_CMD
+  int ret = config_svc_load();
+
+  if (ret < 0)
+    {
+      syslog(LOG_WARNING, "mmWave OS: config not loaded: %d\n", ret);
+    }
+
+  config_svc_ready();
+#endif
+}
+
+#ifdef CONFIG_FS_LITTLEFS
+/* On the LP work queue: a format can take seconds on the 256 KB
+ * partition, and nothing on the sensor path needs /config.
+ */
+
+static void mmwave_mount_worker(FAR void *arg)
+{
+  mmwave_mount_config();
+  mmwave_load_config();
+}
+#endif
+
+#ifdef MMWAVE_BOOT
+static uint32_t boot_now_ms(void)
+{
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+}
+
+/* An app's "start", called directly instead of through the shell */
+
+static int boot_app(CODE int (*entry)(int, FAR char **),
+                    FAR const char *name, FAR const char *arg1,
+                    FAR const char *arg2)
+{
+  FAR char *argv[4];
+
+  argv[0] = (FAR char *)name;
+  argv[1] = (FAR char *)arg1;
+  argv[2] = (FAR char *)arg2;
+  argv[3] = NULL;
+  return entry(arg2 != NULL ? 3 : 2, argv) == OK ? OK : -EIO;
+}
+
+static int boot_sensor(void)
+{
+  return mmwave_sensor_config();
+}
+
+#ifdef MMWAVE_BOOT_NET
+/* Blocks until associated, or the driver gives up. With ap, BSSID and
+ * channel are fixed before the SSID starts the join, and the PMK stands
+ * in for the passphrase; without, both are back to "any".
+ */
+
+static int boot_wifi_join(FAR void *arg,
+                          FAR const struct mmwave_wifi_ap_s *ap)
+{
+  struct wpa_wconfig_s conf;
+  struct ether_addr bssid;
+  FAR const char *key = g_boot_psk;
+  int sock;
+
+  memset(&bssid, 0, sizeof(bssid));
+  if (ap != NULL)
+    {
+      memcpy(bssid.ether_addr_octet, ap->bssid, sizeof(ap->bssid));
+      if (ap->pmk[0] != '\0')
+        {
+          key = ap->pmk;
+        }
+    }
+
+  /* Hints: a driver without them still joins, only slower */
+
+  sock = wapi_make_socket();
+  if (sock >= 0)
+    {
+      wapi_set_ap(sock, BOOT_WLAN, &bssid);
+      wapi_set_freq(sock, BOOT_WLAN,
+                    ap != NULL ? mmwave_wifi_mhz(ap->channel) * 1e6 : 0,
+                    ap != NULL ? WAPI_FREQ_FIXED : WAPI_FREQ_AUTO);
+      close(sock);
+    }
+
+  memset(&conf, 0, sizeof(conf));
+  conf.ifname     = BOOT_WLAN;
+  conf.sta_mode   = WAPI_MODE_MANAGED;
+  conf.ssid       = g_boot_ssid;
+  conf.ssidlen    = strlen(g_boot_ssid);
+  conf.passphrase = key;
+  conf.phraselen  = strlen(key);
+
+  if (conf.phraselen > 0)
+    {
+      conf.auth_wpa    = IW_AUTH_WPA_VERSION_WPA2;
+      conf.cipher_mode = IW_AUTH_CIPHER_CCMP;
+      conf.alg         = WPA_ALG_CCMP;
+    }
+  else
+    {
+      conf.auth_wpa    = IW_AUTH_WPA_VERSION_DISABLED;
+      conf.cipher_mode = IW_AUTH_CIPHER_NONE;
+      conf.alg         = WPA_ALG_NONE;
+    }
+
+  return wpa_driver_wext_associate(&conf);
+}
+
+static int boot_wifi_joined(FAR void *arg, FAR struct mmwave_wifi_ap_s *ap)
+{
+  enum wapi_freq_flag_e flag;
+  struct ether_addr bssid;
+  double freq;
+  int sock;
+  int ret;
+
+  sock = wapi_make_socket();
+  if (sock < 0)
+    {
+      return -errno;
+    }
+
+  ret = wapi_get_ap(sock, BOOT_WLAN, &bssid);
+  if (ret >= 0)
+    {
+      ret = wapi_get_freq(sock, BOOT_WLAN, &freq, &flag);
+    }
+
+  close(sock);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  /* Drivers report either the channel or the frequency in Hz */
+
+  memcpy(ap->bssid, bssid.ether_addr_octet, sizeof(ap->bssid));
+  ap->channel = freq < 1000 ? (uint8_t)freq :
+                (uint8_t)mmwave_wifi_channel((uint32_t)(freq / 1e6));
+  return ap->channel != 0 ? OK : -EINVAL;
+}
+
+/* On the LP work queue after a full scan: the PMK is 4096 rounds of
+ * PBKDF2, which would hold up DHCP if the Wi-Fi step did it.
+ */
+
+static void boot_wifi_cache_worker(FAR void *arg)
+{
+  char val[MMWAVE_WIFI_CACHE_MAX];
+
+  if (g_boot_psk[0] != '\0')
+    {
+      wpa_pmk_hex(g_boot_ssid, g_boot_psk, g_boot_ap.pmk);
+    }
+
+  mmwave_wifi_format_ap(&g_boot_ap, g_boot_tag, val, sizeof(val));
+  if (config_svc_set(MMWAVE_WIFI_KEY_CACHE, val) < 0)
+    {
+      syslog(LOG_WARNING, "mmWave OS: Wi-Fi cache not saved\n");
+    }
+}
+
+static int boot_set_addr(FAR void *arg,
+                         FAR const struct mmwave_wifi_addr_s *addr)
+{
+  struct in_addr in;
+
+  in.s_addr = addr->ip;
+  if (netlib_set_ipv4addr(BOOT_WLAN, &in) < 0)
+    {
+      return -errno;
+    }
+
+  if (addr->netmask != 0)
+    {
+      in.s_addr = addr->netmask;
+      netlib_set_ipv4netmask(BOOT_WLAN, &in);
+    }
+
+  if (addr->router != 0)
+    {
+      in.s_addr = addr->router;
+      netlib_set_dripv4addr(BOOT_WLAN, &in);
+    }
+
+  if (addr->dns != 0)
+    {
+      in.s_addr = addr->dns;
+      netlib_set_ipv4dnsaddr(&in);
+    }
+
+  return OK;
+}
+
+/* Every lease, the first and each renewal. One that differs from the
+ * cached lease replaces it, on the interface and in wifi.lease.
+ */
+
+static void boot_dhcp_lease(FAR struct dhcpc_state *ds)
+{
+  struct mmwave_wifi_addr_s addr;
+  char val[MMWAVE_WIFI_ADDR_MAX];
+
+  if (ds == NULL)
+    {
+      return;
+    }
+
+  addr.ip      = ds->ipaddr.s_addr;
+  addr.netmask = ds->netmask.s_addr;
+  addr.router  = ds->default_router.s_addr;
+  addr.dns     = ds->dnsaddr.s_addr;
+  boot_set_addr(NULL, &addr);
+  g_boot_lease        = addr;
+  g_boot_lease_cached = true;
+
+  mmwave_wifi_format_addr(&addr, g_boot_tag, val, sizeof(val));
+  if (strcmp(val, g_boot_lease_val) != 0 &&
+      config_svc_set(MMWAVE_WIFI_KEY_LEASE, val) == OK)
+    {
+      strlcpy(g_boot_lease_val, val, sizeof(g_boot_lease_val));
+    }
+
+  sem_post(&g_dhcp_sem);
+}
+
+/* wait: until the first lease; dhcpc renews it from then on */
+
+static int boot_dhcp_start(FAR void *arg, bool wait)
+{
+  uint8_t mac[IFHWADDRLEN];
+  struct timespec abstime;
+  int ret;
+
+  if (netlib_getmacaddr(BOOT_WLAN, mac) < 0)
+    {
+      return -errno;
+    }
+
+  g_dhcpc = dhcpc_open(BOOT_WLAN, mac, IFHWADDRLEN);
+  if (g_dhcpc == NULL)
+    {
+      return -ENOMEM;
+    }
+
+  ret = dhcpc_request_async(g_dhcpc, boot_dhcp_lease);
+  if (ret < 0)
+    {
+      dhcpc_close(g_dhcpc);
+      g_dhcpc = NULL;
+      return ret;
+    }
+
+  if (!wait)
+    {
+      return OK;
+    }
+
+  clock_gettime(CLOCK_REALTIME, &abstime);
+  abstime.tv_sec += BOOT_DHCP_TIMEOUT_S;
+  while ((ret = sem_timedwait(&g_dhcp_sem, &abstime)) < 0 &&
+         errno == EINTR);
+
+  return ret < 0 ? -errno : OK;
+}
+
+static const struct mmwave_wifi_ops_s g_boot_wifi_ops =
+{
+  boot_wifi_join, boot_wifi_joined, boot_set_addr, boot_dhcp_start, NULL
+};
+
+static int boot_wifi(void)
+{
+  int how;
+  int ret;
+
+  if (g_boot_ssid[0] == '\0')
+    {
+      syslog(LOG_WARNING, "mmWave OS: Wi-Fi: no SSID configured "
+             "(config set wifi.ssid <name> wifi.psk <password>)\n");
+      return -ENOENT;
+    }
+
+  if (netlib_ifup(BOOT_WLAN) < 0)
+    {
+      return -errno;
+    }
+
+  ret = mmwave_wifi_connect(&g_boot_wifi_ops, &g_boot_ap,
+                            g_boot_ap_cached, &how);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  syslog(LOG_INFO, "mmWave OS: Wi-Fi associated with %s (%s)\n",
+         g_boot_ssid, mmwave_wifi_how_str(how));
+#ifdef CONFIG_MMWAVE_LD2410
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_WIFI);
+#endif
+
+  if (how == MMWAVE_WIFI_SCANNED && g_boot_ap.channel != 0)
+    {
+      work_queue(LPWORK, &g_boot_cache_work, boot_wifi_cache_worker, NULL,
+                 0);
+    }
+
+  return OK;
+}
+
+/* wifi.static, or the cached lease with DHCP behind it, or DHCP */
+
+static int boot_dhcp(void)
+{
+  int how;
+  int ret;
+
+  ret = mmwave_wifi_address(&g_boot_wifi_ops,
+                            g_boot_static_set ? &g_boot_static : NULL,
+                            g_boot_lease_cached ? &g_boot_lease : NULL,
+                            &how);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  syslog(LOG_INFO, "mmWave OS: IPv4 address from %s\n",
+         mmwave_wifi_how_str(how));
+#ifdef CONFIG_MMWAVE_LD2410
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_DHCP);
+#endif
+  return OK;
+}
+
+/* The reconnect cache, if it was written for these credentials */
+
+static void boot_wifi_load(void)
+{
+  char val[MMWAVE_WIFI_CACHE_MAX];
+
+  g_boot_tag = mmwave_wifi_tag(g_boot_ssid, g_boot_psk);
+
+#ifdef MMWAVE_SLEEP
+  if (g_resumed && g_resume.tag == g_boot_tag)
+    {
+      g_boot_ap           = g_resume.ap;
+      g_boot_ap_cached    = (g_resume.net & MMWAVE_RESUME_AP) != 0;
+      g_boot_lease        = g_resume.lease;
+      g_boot_lease_cached = (g_resume.net & MMWAVE_RESUME_LEASE) != 0;
+      if (g_boot_lease_cached)
+        {
+          mmwave_wifi_format_addr(&g_boot_lease, g_boot_tag,
+                                  g_boot_lease_val,
+                                  sizeof(g_boot_lease_val));
+        }
+    }
+  else
+#endif
+    {
+      g_boot_ap_cached =
+        config_svc_get(MMWAVE_WIFI_KEY_CACHE, val, sizeof(val)) > 0 &&
+        mmwave_wifi_parse_ap(val, g_boot_tag, &g_boot_ap) == OK;
+
+      g_boot_lease_cached =
+        config_svc_get(MMWAVE_WIFI_KEY_LEASE, g_boot_lease_val,
+                       sizeof(g_boot_lease_val)) > 0 &&
+        mmwave_wifi_parse_addr(g_boot_lease_val, g_boot_tag,
+                               &g_boot_lease) == OK;
+    }
+
+  if (config_svc_get(MMWAVE_WIFI_KEY_STATIC, val, sizeof(val)) > 0)
+    {
+      g_boot_static_set = mmwave_wifi_parse_addr(val, 0,
+                                                 &g_boot_static) == OK;
+      if (!g_boot_static_set)
+        {
+          syslog(LOG_WARNING, "mmWave OS: ignoring %s=%s\n",
+                 MMWAVE_WIFI_KEY_STATIC, val);
+        }
+    }
+}
+#endif /* MMWAVE_BOOT_NET */
+
+#ifdef CONFIG_MMWAVED_CMD
+/* Started, and answering: the services after it are hosted, not tasks */
+
+static int boot_mmwaved(void)
+{
+  int ret = boot_app(mmwaved_main, "mmwaved", "start", NULL);
+
+  for (int ms = 0; ret == OK && ms < BOOT_MMWAVED_WAIT_MS; ms += 20)
+    {
+      if (mmwaved_request("ping", NULL, 0) != -ESRCH)
+        {
+          return OK;
+        }
+
+      usleep(20 * 1000);
+    }
+
+  return ret < 0 ? ret : -ETIMEDOUT;
+}
+#endif
+
+#ifdef CONFIG_HACTL_CMD
+static int boot_hactl(void)
+{
+  return boot_app(hactl_main, "hactl", "start", NULL);
+}
+#endif
+
+#ifdef CONFIG_ESPHOME_API_CMD
+static int boot_esphome(void)
+{
+  return boot_app(esphome_main, "esphome", "start", NULL);
+}
+#endif
+
+#ifdef CONFIG_COAP_SERVER_CMD
+static int boot_coap(void)
+{
+  return boot_app(coap_main, "coap", "start", NULL);
+}
+#endif
+
+#ifdef CONFIG_MCAST_CMD
+static int boot_mcast(void)
+{
+  return boot_app(mcast_main, "mcast", "start", NULL);
+}
+#endif
+
+#ifdef CONFIG_HTTPD_CMD
+static int boot_httpd(void)
+{
+  return boot_app(httpd_main, "httpd", "start", NULL);
+}
+#endif
+
+#ifdef CONFIG_STREAM_CMD
+static int boot_stream(void)
+{
+  return boot_app(stream_main, "stream", "start", NULL);
+}
+#endif
+
+#ifdef CONFIG_MMWAVE_PROFILE
+static int boot_profile(void)
+{
+  return boot_app(mmwave_main, "mmwave", "profile", "start");
+}
+#endif
+
+/* Step bodies by id; a step this build has no body for is not run. The
+ * keys and defaults are those rcS tests.
+ */
+
+static const struct boot_run_s g_boot_run[MMWAVE_BOOT_NSTEPS] =
+{
+  [MMWAVE_BOOT_SENSOR]  = { boot_sensor, NULL, true },
+#ifdef MMWAVE_BOOT_NET
+  [MMWAVE_BOOT_WIFI]    = { boot_wifi, "boot.autostart_wifi", false },
+  [MMWAVE_BOOT_DHCP]    = { boot_dhcp, "boot.autostart_wifi", false },
+#endif
+#ifdef CONFIG_MMWAVED_CMD
+  [MMWAVE_BOOT_MMWAVED] = { boot_mmwaved, "boot.autostart_mmwaved", true },
+#endif
+#ifdef CONFIG_HACTL_CMD
+  [MMWAVE_BOOT_HA]      = { boot_hactl, "boot.autostart_ha", false },
+#endif
+#ifdef CONFIG_ESPHOME_API_CMD
+  [MMWAVE_BOOT_ESPHOME] = { boot_esphome, "boot.autostart_esphome", false },
+#endif
+#ifdef CONFIG_COAP_SERVER_CMD
+  [MMWAVE_BOOT_COAP]    = { boot_coap, "boot.autostart_coap", false },
+#endif
+#ifdef CONFIG_MCAST_CMD
+  [MMWAVE_BOOT_MCAST]   = { boot_mcast, "boot.autostart_mcast", false },
+#endif
+#ifdef CONFIG_HTTPD_CMD
+  [MMWAVE_BOOT_HTTPD]   = { boot_httpd, "boot.autostart_httpd", false },
+#endif
+#ifdef CONFIG_STREAM_CMD
+  [MMWAVE_BOOT_STREAM]  = { boot_stream, "boot.autostart_stream", false },
+#endif
+#ifdef CONFIG_MMWAVE_PROFILE
+  [MMWAVE_BOOT_PROFILE] = { boot_profile, "boot.autostart_profile", false },
+#endif
+};
+
+static void boot_finish(int id, int ret)
+{
+  mmwave_boot_finish(&g_boot, id, ret);
+  if (ret < 0)
+    {
+      syslog(LOG_WARNING, "mmWave OS: boot step %s failed: %d\n",
+             g_mmwave_boot_steps[id].name, ret);
+    }
+}
+
+/* A blocking step in a task of its own; argv[1] is its id */
+
+static int boot_step_task(int argc, FAR char *argv[])
+{
+  int id = atoi(argv[1]);
+
+  g_boot_ret[id] = g_boot_run[id].run();
+
+  sched_lock();
+  g_boot_over |= MMWAVE_BOOT_BIT(id);
+  sched_unlock();
+
+  sem_post(&g_boot_sem);
+  return OK;
+}
+
+#ifdef MMWAVE_SLEEP
+/* Why the board is running; a reset of any kind is a cold boot */
+
+static int mmwave_wake_cause(void)
+{
+  switch (esp_sleep_get_wakeup_cause())
+    {
+      case ESP_SLEEP_WAKEUP_EXT1:
+        return MMWAVE_WAKE_PIN;
+
+      case ESP_SLEEP_WAKEUP_TIMER:
+        return MMWAVE_WAKE_TIMER;
+
+      default:
+        return MMWAVE_WAKE_COLD;
+    }
+}
+
+/* Before anything else: whether this boot resumes from a sleep */
+
+static void mmwave_resume_begin(void)
+{
+  int wake = mmwave_wake_cause();
+  int ret = mmwave_resume_check(&g_resume, wake);
+
+  if (ret == OK)
+    {
+      g_resumed = true;
+      syslog(LOG_INFO, "mmWave OS: resuming from sleep %lu (%s)\n",
+             (unsigned long)g_resume.sleeps, mmwave_wake_str(wake));
+      return;
+    }
+
+  if (wake != MMWAVE_WAKE_COLD)
+    {
+      syslog(LOG_WARNING, "mmWave OS: woken by %s, no retained state "
+             "(%d)\n", mmwave_wake_str(wake), ret);
+    }
+
+  mmwave_resume_clear(&g_resume);
+}
+
+/* Seal what the next boot resumes from and sleep; returns only if the
+ * chip refused a wakeup source
+ */
+
+static void mmwave_sleep(FAR const struct mmwave_snapshot_s *snap,
+                         long wake_s)
+{
+  esp_err_t err = ESP_OK;
+
+  if (wake_s > 0)
+    {
+      err = esp_sleep_enable_timer_wakeup((uint64_t)wake_s * 1000000);
+    }
+
+#if CONFIG_MMWAVE_LD2410_OUT_GPIO >= 0
+  if (err == ESP_OK)
+    {
+      err = esp_sleep_enable_ext1_wakeup(
+              1ull << CONFIG_MMWAVE_LD2410_OUT_GPIO,
+              ESP_EXT1_WAKEUP_ANY_HIGH);
+    }
+#endif
+
+  if (err != ESP_OK)
+    {
+      syslog(LOG_ERR, "mmWave OS: no wakeup source, not sleeping "
+             "(%d)\n", (int)err);
+      esp_sleep_disable_wakeup_source(ESP_SLEEP_WAKEUP_ALL);
+      return;
+    }
+
+  g_resume.sensor = *snap;
+  strlcpy(g_resume.uart, g_sensor_uart, sizeof(g_resume.uart));
+  g_resume.baud = g_sensor_baud;
+  g_resume.net  = 0;
+  g_resume.tag  = 0;
+
+#ifdef MMWAVE_BOOT_NET
+  g_resume.tag = g_boot_tag;
+  if (g_boot.state[MMWAVE_BOOT_WIFI] == MMWAVE_BOOT_DONE &&
+      g_boot_ap.channel != 0)
+    {
+      g_resume.ap   = g_boot_ap;
+      g_resume.net |= MMWAVE_RESUME_AP;
+    }
+
+  if (g_boot_lease_cached && !g_boot_static_set)
+    {
+      g_resume.lease = g_boot_lease;
+      g_resume.net  |= MMWAVE_RESUME_LEASE;
+    }
+#endif
+
+  g_resume.sleeps++;
+  mmwave_resume_seal(&g_resume);
+
+  syslog(LOG_INFO, "mmWave OS: sleep %lu, until OUT or %ld s\n",
+         (unsigned long)g_resume.sleeps, wake_s);
+  esp_deep_sleep_start();
+}
+
+/* On the LP work queue once a second after the boot sequence: time the
+ * first report of a resume, and sleep once sleep.idle allows
+ */
+
+static void mmwave_sleep_worker(FAR void *arg)
+{
+  struct mmwave_snapshot_s snap;
+  uint32_t report = mmwave_ld2410_milestone_ms(MMWAVE_MILESTONE_REPORT);
+  uint32_t now = boot_now_ms();
+  long idle_s = config_svc_get_int(MMWAVE_SLEEP_KEY_IDLE, 0);
+  long wake_s = config_svc_get_int(MMWAVE_SLEEP_KEY_WAKE,
+                                   MMWAVE_SLEEP_WAKE_S);
+
+  if (g_resumed && report != 0 && !g_resume_timed)
+    {
+      g_resume_timed = true;
+      mmwave_resume_latency(&g_resume, report);
+      syslog(LOG_INFO, "mmWave OS: resume to report %lu ms "
+             "(mean %lu, worst %lu, %lu resumes)\n",
+             (unsigned long)report,
+             (unsigned long)mmwave_resume_latency_avg(&g_resume),
+             (unsigned long)g_resume.lat_max,
+             (unsigned long)g_resume.lat_n);
+    }
+
+  if (mmwave_ld2410_snapshot(&snap) == OK)
+    {
+      if (snap.data.target_state != LD2410_TARGET_NONE)
+        {
+          g_sleep_seen_ms = now;
+        }
+
+      /* Without OUT or the timer nothing would wake it */
+
+      if ((wake_s > 0 || CONFIG_MMWAVE_LD2410_OUT_GPIO >= 0) &&
+          idle_s > 0 &&
+          mmwave_sleep_due((uint32_t)idle_s * 1000, report != 0,
+                           mmwave_ld2410_unsent(), snap.data.target_state,
+                           now - g_sleep_seen_ms))
+        {
+          mmwave_sleep(&snap, wake_s);
+        }
+    }
+
+  work_queue(LPWORK, &g_sleep_work, mmwave_sleep_worker, NULL,
+             MSEC2TICK(SLEEP_POLL_MS));
+}
+
+static void mmwave_sleep_start(void)
+{
+  g_sleep_seen_ms = boot_now_ms();
+  work_queue(LPWORK, &g_sleep_work, mmwave_sleep_worker, NULL,
+             MSEC2TICK(SLEEP_POLL_MS));
+}
+#endif /* MMWAVE_SLEEP */
+
+/* Settings, read once /config is loaded; false with boot.native 0 */
+
+static bool boot_load(void)
+{
+  uint32_t wanted = 0;
+
+  config_svc_wait_ready(CONFIG_CONFIG_READY_MS);
+  if (!config_svc_get_bool(MMWAVE_BOOT_NATIVE, true))
+    {
+      return false;
+    }
+
+  config_svc_get_str("wifi.ssid", g_boot_ssid, sizeof(g_boot_ssid), "");
+  config_svc_get_str("wifi.psk", g_boot_psk, sizeof(g_boot_psk), "");
+#ifdef MMWAVE_BOOT_NET
+  boot_wifi_load();
+#endif
+
+  for (int i = 0; i < MMWAVE_BOOT_NSTEPS; i++)
+    {
+      FAR const struct boot_run_s *r = &g_boot_run[i];
+
+      if (r->run != NULL &&
+          (r->key == NULL || config_svc_get_bool(r->key, r->def)))
+        {
+          wanted |= MMWAVE_BOOT_BIT(i);
+        }
+    }
+
+  mmwave_boot_init(&g_boot, g_mmwave_boot_steps, MMWAVE_BOOT_NSTEPS,
+                   wanted);
+  return true;
+}
+
+static int boot_task(int argc, FAR char *argv[])
+{
+  FAR char *args[2];
+  uint32_t over;
+  char arg[4];
+  int id;
+
+  if (!boot_load())
+    {
+      /* rcS starts Wi-Fi and the services */
+
+      mmwave_sensor_config();
+#ifdef MMWAVE_SLEEP
+      mmwave_sleep_start();
+#endif
+      return OK;
+    }
+
+  args[0] = arg;
+  args[1] = NULL;
+
+#ifdef CONFIG_PM
+  /* Joining, DHCP and starting services: no lower-power states until
+   * they are done
+   */
+
+  pm_stay(PM_IDLE_DOMAIN, PM_NORMAL);
+#endif
+
+  for (; ; )
+    {
+      while ((id = mmwave_boot_next(&g_boot)) >= 0)
+        {
+          if (!g_mmwave_boot_steps[id].async)
+            {
+              boot_finish(id, g_boot_run[id].run());
+              continue;
+            }
+
+          snprintf(arg, sizeof(arg), "%d", id);
+          if (task_create(g_mmwave_boot_steps[id].name, 100,
+                          BOOT_STEP_STACKSIZE, boot_step_task, args) < 0)
+            {
+              boot_finish(id, -errno);
+            }
+        }
+
+      if (mmwave_boot_left(&g_boot) == 0)
+        {
+          break;
+        }
+
+      while (sem_wait(&g_boot_sem) < 0 && errno == EINTR);
+
+      sched_lock();
+      over = g_boot_over;
+      g_boot_over = 0;
+      sched_unlock();
+
+      for (id = 0; id < MMWAVE_BOOT_NSTEPS; id++)
+        {
+          if (over & MMWAVE_BOOT_BIT(id))
+            {
+              boot_finish(id, g_boot_ret[id]);
+            }
+        }
+    }
+
+  syslog(LOG_INFO, "mmWave OS: boot sequence done in %lu ms\n",
+         (unsigned long)(boot_now_ms() - g_boot_start_ms));
+#ifdef CONFIG_PM
+  pm_relax(PM_IDLE_DOMAIN, PM_NORMAL);
+#endif
+#ifdef MMWAVE_SLEEP
+  mmwave_sleep_start();
+#endif
+  return OK;
+}
+
+/* The steps in a task above NSH's priority, so the sensor settings are
+ * applied before rc.sysinit looks at the sensor. The task waits for
+ * /config; the bring-up does not.
+ */
+
+static int mmwave_boot_start(void)
+{
+  pid_t pid;
+
+  g_boot_start_ms = boot_now_ms();
+
+  pid = task_create("boot", BOOT_PRIORITY, BOOT_STACKSIZE, boot_task,
+                    NULL);
+  if (pid < 0)
+    {
+      syslog(LOG_ERR, "mmWave OS: boot sequencer not started: %d\n",
+             errno);
+      return -errno;
+    }
+
+  return OK;
+}
+#endif /* MMWAVE_BOOT */
+
 /****************************************************************************
  * Public Functions
  ****************************************************************************/
@@ -54,99 +1284,47 @@
 
 int mmwave_bringup(void)
 {
-  int ret;
-
   syslog(LOG_INFO, "mmWave OS: starting board bringup\n");
 
-  /* ─── Step 1: Mount LittleFS for persistent configuration ─── */
-
-#ifdef CONFIG_FS_LITTLEFS
-  {
-    syslog(LOG_INFO, "mmWave OS: mounting LittleFS at %s\n",
-           CONFIG_MOUNT_POINT);
-
-    /* Get the MTD partition for our storage area */
-
-    FAR struct mtd_dev_s *mtd = NULL;
+#ifdef MMWAVE_SLEEP
+  mmwave_resume_begin();
+#endif
 
-#ifdef CONFIG_ESP32C6_SPIFLASH
-    /* The ESP32-C6 flash MTD is initialized by the chip-level code.
-     * We access our storage partition via the registered MTD device.
-     * Typically: /dev/esp-storage or an MTD registered by the partition
-     * table. Here we use the platform-provided API.
-     */
+#ifdef CONFIG_MMWAVE_PM
+  /* The PM governor, before the sensor sends its first frame */
 
-    extern FAR struct mtd_dev_s *esp32c6_get_storage_mtd(void);
-    mtd = esp32c6_get_storage_mtd();
+  mmwave_pm_register();
 #endif
 
-    if (mtd != NULL)
-      {
-        ret = mount(NULL, CONFIG_MOUNT_POINT, "littlefs", 0,
-                    (FAR void *)mtd);
-        if (ret < 0)
-          {
-            syslog(LOG_WARNING,
-                   "mmWave OS: LittleFS mount failed (%d), formatting...\n",
-                   ret);
-
-            /* Format and retry */
-
-            ret = mount(NULL, CONFIG_MOUNT_POINT, "littlefs", 0,
-                        "forceformat");
-            if (ret < 0)
-              {
-                syslog(LOG_ERR,
-                       "mmWave OS: LittleFS format+mount failed: %d\n",
-                       ret);
-              }
-          }
-
-        if (ret == OK)
-          {
-            syslog(LOG_INFO, "mmWave OS: /config mounted OK\n");
-          }
-      }
-    else
-      {
-        syslog(LOG_WARNING,
-               "mmWave OS: no storage MTD available, /config disabled\n");
-      }
-  }
-#endif /* CONFIG_FS_LITTLEFS */
+  /* ─── Step 1: The sensor, before anything waits on flash ─── */
 
-  /* ─── Step 2: Register mmWave LD2410 driver ─── */
+  mmwave_sensor_bringup();
 
-#ifdef CONFIG_MMWAVE_LD2410
-  {
-    syslog(LOG_INFO, "mmWave OS: registering LD2410 driver\n");
+  /* ─── Step 2: /config on the LP work queue ─── */
 
-    ret = mmwave_ld2410_register(
-            CONFIG_MMWAVE_LD2410_DEVPATH,
-            CONFIG_MMWAVE_LD2410_UART_PATH,
-            CONFIG_MMWAVE_LD2410_BAUD);
+#ifdef CONFIG_FS_LITTLEFS
+#ifdef CONFIG_CONFIG_CMD
+  config_svc_defer();
+#endif
+  if (work_queue(LPWORK, &g_mount_work, mmwave_mount_worker, NULL, 0) < 0)
+    {
+      mmwave_mount_worker(NULL);
+    }
+#else
+  mmwave_load_config();
+#endif
 
-    if (ret < 0)
-      {
-        syslog(LOG_ERR,
-               "mmWave OS: LD2410 registration failed: %d\n", ret);
-      }
-    else
-      {
-        syslog(LOG_INFO,
-               "mmWave OS: LD2410 ready at %s (UART: %s @ %d baud)\n",
-               CONFIG_MMWAVE_LD2410_DEVPATH,
-               CONFIG_MMWAVE_LD2410_UART_PATH,
-               CONFIG_MMWAVE_LD2410_BAUD);
-      }
-  }
-#endif /* CONFIG_MMWAVE_LD2410 */
+  /* ─── Step 3: Wi-Fi and services, once the config is in ─── */
+
+#ifdef MMWAVE_BOOT
+  mmwave_boot_start();
+#endif
 
-  /* ─── Step 3: Mount procfs ─── */
+  /* ─── Step 4: Mount procfs ─── */
 
 #ifdef CONFIG_FS_PROCFS
   {
-    ret = mount(NULL, "/proc", "procfs", 0, NULL);
+    int ret = mount(NULL, "/proc", "procfs", 0, NULL);
     if (ret < 0)
       {
         syslog(LOG_WARNING, "mmWave OS: procfs mount failed: %d\n", ret);
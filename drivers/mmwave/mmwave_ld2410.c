@@ -6,8 +6,13 @@
  * NuttX character device driver for the HLK-LD2410 24GHz mmWave radar.
  *
  * Registers /dev/mmwave0. Reads binary frames from UART at 10Hz,
- * parses presence/motion/static data, and exposes it via read() and
- * ioctl(). A background polling task handles continuous UART reads.
+ * parses presence/motion/static data, and exposes it via read(),
+ * poll() and ioctl(). A background polling task handles continuous UART
+ * reads, and hands command acknowledgements to the waiting caller.
+ *
+ * The sensor's configuration is cached once read, so applying a
+ * configuration sends only the commands that change something, all in
+ * one config session, and none at all when nothing differs.
  *
  ****************************************************************************/
 
@@ -33,6 +38,10 @@
 #include <sys/ioctl.h>
 #include <termios.h>
 
+#ifdef CONFIG_MMWAVE_PM
+#  include <nuttx/power/pm.h>
+#endif
+
 #include "mmwave_ld2410.h"
 
 /****************************************************************************
@@ -44,6 +53,17 @@
 #define MMWAVE_CMD_TIMEOUT_MS    1000
 #define MMWAVE_READ_TIMEOUT_MS   200
 
+/****************************************************************************
+ * Private Types
+ ****************************************************************************/
+
+/* Per-open state: the frame this opener last read */
+
+struct mmwave_open_s
+{
+  uint32_t seq;
+};
+
 /****************************************************************************
  * Private Function Prototypes
  ****************************************************************************/
@@ -54,14 +74,19 @@ static ssize_t mmwave_read(FAR struct file *filep, FAR char *buffer,
                            size_t buflen);
 static int     mmwave_ioctl(FAR struct file *filep, int cmd,
                             unsigned long arg);
+static int     mmwave_poll(FAR struct file *filep, FAR struct pollfd *fds,
+                           bool setup);
 
 static int     mmwave_poll_task(int argc, FAR char *argv[]);
 static int     mmwave_parse_byte(FAR struct mmwave_dev_s *priv, uint8_t byte);
 static int     mmwave_process_data_frame(FAR struct mmwave_dev_s *priv);
+static int     mmwave_process_ack(FAR struct mmwave_dev_s *priv);
 static int     mmwave_send_command(FAR struct mmwave_dev_s *priv,
                                    uint16_t cmd,
                                    FAR const uint8_t *data,
                                    uint16_t datalen);
+static int     mmwave_command(FAR struct mmwave_dev_s *priv, uint16_t cmd,
+                              FAR const uint8_t *data, uint16_t datalen);
 static int     mmwave_enter_config(FAR struct mmwave_dev_s *priv);
 static int     mmwave_exit_config(FAR struct mmwave_dev_s *priv);
 
@@ -79,19 +104,58 @@ static const struct file_operations g_mmwave_fops =
   mmwave_ioctl,   /* ioctl */
   NULL,           /* mmap */
   NULL,           /* truncate */
-  NULL            /* poll */
+  mmwave_poll     /* poll */
 };
 
+/* UART speeds the LD2410 supports; its baud command takes index + 1 */
+
+static const struct
+{
+  uint32_t baud;
+  speed_t  speed;
+} g_mmwave_bauds[] =
+{
+  { 9600, B9600 },     { 19200, B19200 },   { 38400, B38400 },
+  { 57600, B57600 },   { 115200, B115200 }, { 230400, B230400 },
+  { 256000, B256000 }, { 460800, B460800 }
+};
+
+#define MMWAVE_NBAUDS \
+  (int)(sizeof(g_mmwave_bauds) / sizeof(g_mmwave_bauds[0]))
+
 /* Single device instance (we only support one mmWave sensor) */
 
 static FAR struct mmwave_dev_s *g_mmwave_dev = NULL;
 static pid_t g_poll_pid = -1;
 static volatile bool g_poll_running = false;
 
+/* Boot milestones: outside the device, since /config is mounted first */
+
+static struct mmwave_boottime_s g_boottime;
+
+/* hactl's undelivered transitions a deep sleep would lose */
+
+static volatile uint32_t g_unsent;
+
 /****************************************************************************
  * Private Functions
  ****************************************************************************/
 
+/* Index into g_mmwave_bauds, or -1 for a rate the sensor cannot use */
+
+static int mmwave_baud_index(uint32_t baud)
+{
+  for (int i = 0; i < MMWAVE_NBAUDS; i++)
+    {
+      if (g_mmwave_bauds[i].baud == baud)
+        {
+          return i;
+        }
+    }
+
+  return -1;
+}
+
 /****************************************************************************
  * Name: mmwave_uart_configure
  *
@@ -131,19 +195,8 @@ static int mmwave_uart_configure(FAR struct mmwave_dev_s *priv)
 
   /* Set baud rate */
 
-  speed_t speed;
-  switch (priv->baud)
-    {
-      case 9600:    speed = B9600;   break;
-      case 19200:   speed = B19200;  break;
-      case 38400:   speed = B38400;  break;
-      case 57600:   speed = B57600;  break;
-      case 115200:  speed = B115200; break;
-      case 230400:  speed = B230400; break;
-      case 256000:  speed = B256000; break;
-      case 460800:  speed = B460800; break;
-      default:      speed = B256000; break;
-    }
+  int i = mmwave_baud_index(priv->baud);
+  speed_t speed = i < 0 ? B256000 : g_mmwave_bauds[i].speed;
 
   cfsetispeed(&tio, speed);
   cfsetospeed(&tio, speed);
@@ -164,6 +217,23 @@ static int mmwave_uart_configure(FAR struct mmwave_dev_s *priv)
   return OK;
 }
 
+/* Change the speed of the open UART, after the sensor has changed its */
+
+static int mmwave_uart_speed(int fd, uint32_t baud)
+{
+  struct termios tio;
+  int i = mmwave_baud_index(baud);
+
+  if (i < 0 || tcgetattr(fd, &tio) < 0)
+    {
+      return i < 0 ? -EINVAL : -errno;
+    }
+
+  cfsetispeed(&tio, g_mmwave_bauds[i].speed);
+  cfsetospeed(&tio, g_mmwave_bauds[i].speed);
+  return tcsetattr(fd, TCSANOW, &tio) < 0 ? -errno : OK;
+}
+
 /****************************************************************************
  * Name: mmwave_parse_byte
  *
@@ -355,6 +425,12 @@ static int mmwave_process_data_frame(FAR struct mmwave_dev_s *priv)
   priv->data.timestamp_ms      = clock_systime_ticks() *
                                  (1000 / TICK_PER_SEC);
   priv->data_valid = true;
+  priv->frame_seq++;
+
+  if (g_boottime.ms[MMWAVE_MILESTONE_FRAME] == 0)
+    {
+      mmwave_ld2410_milestone(MMWAVE_MILESTONE_FRAME);
+    }
 
   /* Parse engineering mode per-gate data if present */
 
@@ -385,10 +461,56 @@ static int mmwave_process_data_frame(FAR struct mmwave_dev_s *priv)
         }
     }
 
+  poll_notify(priv->fds, CONFIG_MMWAVE_LD2410_NPOLLWAITERS, POLLIN);
   nxsem_post(&priv->data_sem);
   return OK;
 }
 
+/****************************************************************************
+ * Name: mmwave_process_ack
+ *
+ * Description:
+ *   Process a complete command frame: the sensor's answer to a command.
+ *   The one being waited for is copied to priv->ack and its caller woken;
+ *   anything else (a late answer after a timeout) is dropped.
+ *
+ *   Ack payload: command word | 0x0100 (2), status (2), data
+ *
+ ****************************************************************************/
+
+static int mmwave_process_ack(FAR struct mmwave_dev_s *priv)
+{
+  FAR const uint8_t *payload = &priv->rxbuf[6];
+  uint16_t word;
+  int ret;
+
+  if (priv->frame_len < 4 || priv->frame_len > LD2410_ACK_MAX)
+    {
+      return -EINVAL;
+    }
+
+  word = (uint16_t)payload[0] | ((uint16_t)payload[1] << 8);
+
+  ret = nxsem_wait(&priv->data_sem);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  if (priv->ack_expect == 0 || word != priv->ack_expect)
+    {
+      nxsem_post(&priv->data_sem);
+      return -EINVAL;
+    }
+
+  memcpy(priv->ack, payload, priv->frame_len);
+  priv->ack_len    = (uint8_t)priv->frame_len;
+  priv->ack_expect = 0;
+  nxsem_post(&priv->data_sem);
+  nxsem_post(&priv->wait_sem);
+  return OK;
+}
+
 /****************************************************************************
  * Name: mmwave_send_command
  *
@@ -406,19 +528,12 @@ static int mmwave_send_command(FAR struct mmwave_dev_s *priv,
   uint8_t frame[LD2410_MAX_FRAME_LEN];
   uint16_t payload_len = 2 + datalen;  /* CMD(2) + data */
   uint16_t frame_len = 4 + 2 + payload_len + 4;
-  int ret;
 
   if (frame_len > LD2410_MAX_FRAME_LEN)
     {
       return -EINVAL;
     }
 
-  ret = nxsem_wait(&priv->cmd_sem);
-  if (ret < 0)
-    {
-      return ret;
-    }
-
   /* Build frame */
 
   int pos = 0;
@@ -459,19 +574,66 @@ static int mmwave_send_command(FAR struct mmwave_dev_s *priv,
 
   ssize_t written = write(priv->uart_fd, frame, pos);
 
-  nxsem_post(&priv->cmd_sem);
-
   if (written != pos)
     {
       snerr("ERROR: UART write failed: wrote %zd of %d\n", written, pos);
       return -EIO;
     }
 
-  /* Brief delay for LD2410 to process */
+  return OK;
+}
+
+/****************************************************************************
+ * Name: mmwave_command
+ *
+ * Description:
+ *   Send a command and wait for its acknowledgement, instead of a fixed
+ *   delay: the sensor answers in a few ms. Callers hold cmd_sem. Returns
+ *   -ETIMEDOUT without an answer, -EIO when the sensor refuses it.
+ *
+ ****************************************************************************/
+
+static int mmwave_command(FAR struct mmwave_dev_s *priv, uint16_t cmd,
+                          FAR const uint8_t *data, uint16_t datalen)
+{
+  uint16_t want = cmd | LD2410_ACK_FLAG;
+  int ret;
+
+  nxsem_wait(&priv->data_sem);
+  priv->ack_expect = want;
+  priv->ack_len    = 0;
+  nxsem_post(&priv->data_sem);
+
+  ret = mmwave_send_command(priv, cmd, data, datalen);
+
+  /* A wake-up with no answer is one that arrived after an earlier
+   * command had given up: wait once more.
+   */
+
+  for (int tries = 0; ret == OK && priv->ack_len == 0; tries++)
+    {
+      ret = nxsem_tickwait(&priv->wait_sem,
+                           MSEC2TICK(MMWAVE_CMD_TIMEOUT_MS));
+      if (ret == OK && priv->ack_len == 0 && tries > 0)
+        {
+          ret = -ETIMEDOUT;
+        }
+    }
+
+  if (ret < 0)
+    {
+      nxsem_wait(&priv->data_sem);
+      priv->ack_expect = 0;
+      nxsem_post(&priv->data_sem);
+      if (ret == -ETIMEDOUT)
+        {
+          priv->cmd_timeouts++;
+        }
 
-  usleep(50000);  /* 50ms */
+      return ret;
+    }
 
-  return OK;
+  return priv->ack[2] == 0 && priv->ack[3] == 0 ? OK : -EIO;
 }
 
 /****************************************************************************
@@ -479,18 +641,383 @@ static int mmwave_send_command(FAR struct mmwave_dev_s *priv,
  *
  * Description:
  *   Enter/exit configuration mode. Required before sending config commands.
+ *   A session holds cmd_sem from entry to exit, so two callers' commands
+ *   never interleave.
  *
  ****************************************************************************/
 
 static int mmwave_enter_config(FAR struct mmwave_dev_s *priv)
 {
   uint8_t data[] = { 0x01, 0x00 };  /* Enable config mode value */
-  return mmwave_send_command(priv, LD2410_CMD_ENABLE_CONFIG, data, 2);
+  int ret;
+
+  ret = nxsem_wait(&priv->cmd_sem);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  ret = mmwave_command(priv, LD2410_CMD_ENABLE_CONFIG, data, 2);
+  if (ret < 0)
+    {
+      nxsem_post(&priv->cmd_sem);
+    }
+
+  return ret;
 }
 
 static int mmwave_exit_config(FAR struct mmwave_dev_s *priv)
 {
-  return mmwave_send_command(priv, LD2410_CMD_DISABLE_CONFIG, NULL, 0);
+  int ret = mmwave_command(priv, LD2410_CMD_DISABLE_CONFIG, NULL, 0);
+
+  nxsem_post(&priv->cmd_sem);
+  return ret;
+}
+
+/****************************************************************************
+ * Name: mmwave_parse_config
+ *
+ * Description:
+ *   Decode the answer to LD2410_CMD_READ_CONFIG:
+ *     word(2) status(2) 0xAA N max_motion max_static
+ *     motion_sens[N + 1] static_sens[N + 1] timeout(2)
+ *
+ ****************************************************************************/
+
+static int mmwave_parse_config(FAR const uint8_t *ack, size_t len,
+                               FAR struct mmwave_config_s *cfg)
+{
+  size_t n;
+
+  if (len < 8 || ack[4] != 0xAA)
+    {
+      return -EINVAL;
+    }
+
+  n = (size_t)ack[5] + 1;
+  if (n > LD2410_MAX_GATES || len < 8 + 2 * n + 2)
+    {
+      return -EINVAL;
+    }
+
+  memset(cfg, 0, sizeof(*cfg));
+  cfg->max_motion_gate = ack[6];
+  cfg->max_static_gate = ack[7];
+  memcpy(cfg->motion_sensitivity, &ack[8], n);
+  memcpy(cfg->static_sensitivity, &ack[8 + n], n);
+  cfg->timeout_s = (uint16_t)ack[8 + 2 * n] |
+                   ((uint16_t)ack[8 + 2 * n + 1] << 8);
+  return OK;
+}
+
+/* In a session: the sensor's configuration into priv->config */
+
+static int mmwave_read_config(FAR struct mmwave_dev_s *priv)
+{
+  int ret = mmwave_command(priv, LD2410_CMD_READ_CONFIG, NULL, 0);
+
+  if (ret == OK)
+    {
+      ret = mmwave_parse_config(priv->ack, priv->ack_len, &priv->config);
+    }
+
+  priv->config_valid = ret == OK;
+  return ret;
+}
+
+/****************************************************************************
+ * Name: mmwave_encode_words
+ *
+ * Description:
+ *   Both set commands take three (word id, 32-bit value) pairs.
+ *
+ ****************************************************************************/
+
+static void mmwave_encode_words(FAR uint8_t data[18], uint32_t v0,
+                                uint32_t v1, uint32_t v2)
+{
+  uint32_t v[3];
+
+  v[0] = v0;
+  v[1] = v1;
+  v[2] = v2;
+  for (int i = 0; i < 3; i++)
+    {
+      data[6 * i]     = (uint8_t)i;
+      data[6 * i + 1] = 0x00;
+      data[6 * i + 2] = (uint8_t)(v[i] & 0xFF);
+      data[6 * i + 3] = (uint8_t)((v[i] >> 8) & 0xFF);
+      data[6 * i + 4] = (uint8_t)((v[i] >> 16) & 0xFF);
+      data[6 * i + 5] = (uint8_t)((v[i] >> 24) & 0xFF);
+    }
+}
+
+/* In a session: one gate's thresholds, kept in the cache on success */
+
+static int mmwave_set_gate(FAR struct mmwave_dev_s *priv, uint8_t gate,
+                           uint8_t motion, uint8_t stat)
+{
+  uint8_t data[18];
+  int ret;
+
+  mmwave_encode_words(data, gate, motion, stat);
+  ret = mmwave_command(priv, LD2410_CMD_SET_SENSITIVITY, data,
+                       sizeof(data));
+  priv->cfg_writes++;
+  if (ret == OK)
+    {
+      priv->config.motion_sensitivity[gate] = motion;
+      priv->config.static_sensitivity[gate] = stat;
+    }
+  else
+    {
+      priv->config_valid = false;
+    }
+
+  return ret;
+}
+
+static int mmwave_set_maxgate(FAR struct mmwave_dev_s *priv,
+                              FAR const struct mmwave_maxgate_s *mg)
+{
+  uint8_t data[18];
+  int ret;
+
+  mmwave_encode_words(data, mg->max_motion_gate, mg->max_static_gate,
+                      mg->timeout_s);
+  ret = mmwave_command(priv, LD2410_CMD_SET_MAXGATE, data, sizeof(data));
+  priv->cfg_writes++;
+  if (ret == OK)
+    {
+      priv->config.max_motion_gate = mg->max_motion_gate;
+      priv->config.max_static_gate = mg->max_static_gate;
+      priv->config.timeout_s       = mg->timeout_s;
+    }
+  else
+    {
+      priv->config_valid = false;
+    }
+
+  return ret;
+}
+
+/****************************************************************************
+ * Name: mmwave_config_plan
+ *
+ * Description:
+ *   Merge the fields of req->mask over cur into next, and return which
+ *   commands bring the sensor from cur to next: bit g for gate g's
+ *   thresholds, MMWAVE_PLAN_MAXGATE for max gates and timeout. 0 when
+ *   the sensor already matches.
+ *
+ ****************************************************************************/
+
+static uint16_t mmwave_config_plan(FAR const struct mmwave_config_s *cur,
+                                   FAR const struct mmwave_apply_s *req,
+                                   FAR struct mmwave_config_s *next)
+{
+  uint16_t plan = 0;
+
+  *next = *cur;
+  if (req->mask & MMWAVE_APPLY_MAX_MOTION)
+    {
+      next->max_motion_gate = req->cfg.max_motion_gate;
+    }
+
+  if (req->mask & MMWAVE_APPLY_MAX_STATIC)
+    {
+      next->max_static_gate = req->cfg.max_static_gate;
+    }
+
+  if (req->mask & MMWAVE_APPLY_TIMEOUT)
+    {
+      next->timeout_s = req->cfg.timeout_s;
+    }
+
+  if (req->mask & MMWAVE_APPLY_MOTION_SENS)
+    {
+      memcpy(next->motion_sensitivity, req->cfg.motion_sensitivity,
+             LD2410_MAX_GATES);
+    }
+
+  if (req->mask & MMWAVE_APPLY_STATIC_SENS)
+    {
+      memcpy(next->static_sensitivity, req->cfg.static_sensitivity,
+             LD2410_MAX_GATES);
+    }
+
+  if (next->max_motion_gate != cur->max_motion_gate ||
+      next->max_static_gate != cur->max_static_gate ||
+      next->timeout_s != cur->timeout_s)
+    {
+      plan |= MMWAVE_PLAN_MAXGATE;
+    }
+
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      if (next->motion_sensitivity[g] != cur->motion_sensitivity[g] ||
+          next->static_sensitivity[g] != cur->static_sensitivity[g])
+        {
+          plan |= 1 << g;
+        }
+    }
+
+  return plan;
+}
+
+/* Values the sensor accepts: gates 2-8 as maxima, thresholds 0-100 */
+
+static bool mmwave_config_valid(FAR const struct mmwave_config_s *cfg)
+{
+  if (cfg->max_motion_gate < 2 || cfg->max_motion_gate >= LD2410_MAX_GATES ||
+      cfg->max_static_gate < 2 || cfg->max_static_gate >= LD2410_MAX_GATES)
+    {
+      return false;
+    }
+
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      if (cfg->motion_sensitivity[g] > 100 ||
+          cfg->static_sensitivity[g] > 100)
+        {
+          return false;
+        }
+    }
+
+  return true;
+}
+
+/****************************************************************************
+ * Name: mmwave_apply
+ *
+ * Description:
+ *   Bring the sensor to req with the commands that differ from its
+ *   configuration, in one session. With the configuration cached and
+ *   nothing to change, no session is opened at all. Returns the number
+ *   of set commands sent.
+ *
+ ****************************************************************************/
+
+static int mmwave_apply(FAR struct mmwave_dev_s *priv,
+                        FAR struct mmwave_apply_s *req)
+{
+  struct mmwave_config_s next;
+  struct mmwave_maxgate_s mg;
+  bool session = false;
+  uint16_t plan;
+  int ret = OK;
+
+  req->sent = 0;
+  if (!priv->config_valid)
+    {
+      ret = mmwave_enter_config(priv);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      session = true;
+      ret = mmwave_read_config(priv);
+      if (ret < 0)
+        {
+          goto out;
+        }
+    }
+
+  plan = mmwave_config_plan(&priv->config, req, &next);
+  if (plan == 0)
+    {
+      goto out;
+    }
+
+  if (!mmwave_config_valid(&next))
+    {
+      ret = -EINVAL;
+      goto out;
+    }
+
+  if (!session)
+    {
+      ret = mmwave_enter_config(priv);
+      if (ret < 0)
+        {
+          return ret;
+        }
+
+      session = true;
+    }
+
+  if (plan & MMWAVE_PLAN_MAXGATE)
+    {
+      mg.max_motion_gate = next.max_motion_gate;
+      mg.max_static_gate = next.max_static_gate;
+      mg.timeout_s       = next.timeout_s;
+      ret = mmwave_set_maxgate(priv, &mg);
+      req->sent++;
+    }
+
+  for (int g = 0; g < LD2410_MAX_GATES && ret == OK; g++)
+    {
+      if (plan & (1 << g))
+        {
+          ret = mmwave_set_gate(priv, (uint8_t)g,
+                                next.motion_sensitivity[g],
+                                next.static_sensitivity[g]);
+          req->sent++;
+        }
+    }
+
+out:
+  if (session)
+    {
+      mmwave_exit_config(priv);
+    }
+
+  return ret < 0 ? ret : req->sent;
+}
+
+/* The sensor to another baud rate: it takes effect when it restarts */
+
+static int mmwave_set_baud(FAR struct mmwave_dev_s *priv, uint32_t baud)
+{
+  int i = mmwave_baud_index(baud);
+  uint8_t data[2];
+  int ret;
+
+  if (i < 0)
+    {
+      return -EINVAL;
+    }
+
+  if (baud == priv->baud)
+    {
+      return OK;
+    }
+
+  ret = mmwave_enter_config(priv);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  data[0] = (uint8_t)(i + 1);
+  data[1] = 0x00;
+  ret = mmwave_command(priv, LD2410_CMD_SET_BAUDRATE, data, 2);
+  if (ret == OK)
+    {
+      ret = mmwave_command(priv, LD2410_CMD_RESTART, NULL, 0);
+    }
+
+  /* The restart has ended the session */
+
+  nxsem_post(&priv->cmd_sem);
+  if (ret == OK)
+    {
+      ret = mmwave_uart_speed(priv->uart_fd, baud);
+      priv->baud = baud;
+    }
+
+  return ret;
 }
 
 /****************************************************************************
@@ -500,12 +1027,17 @@ static int mmwave_exit_config(FAR struct mmwave_dev_s *priv)
  *   Background kernel thread that continuously reads from UART,
  *   feeds bytes into the frame parser, and updates sensor data.
  *
+ *   It sleeps in poll() until the sensor sends something, so the CPU is
+ *   free between frames; with CONFIG_MMWAVE_PM each burst of bytes is
+ *   reported to the PM governor as frame activity.
+ *
  ****************************************************************************/
 
 static int mmwave_poll_task(int argc, FAR char *argv[])
 {
   FAR struct mmwave_dev_s *priv = g_mmwave_dev;
-  uint8_t byte;
+  uint8_t buf[LD2410_MAX_FRAME_LEN];
+  struct pollfd pfd;
   ssize_t nread;
 
   if (priv == NULL || priv->uart_fd < 0)
@@ -521,14 +1053,35 @@ static int mmwave_poll_task(int argc, FAR char *argv[])
 
   while (g_poll_running)
     {
-      nread = read(priv->uart_fd, &byte, 1);
+      /* Bounded, so a stop is seen within MMWAVE_READ_TIMEOUT_MS */
 
-      if (nread == 1)
+      pfd.fd      = priv->uart_fd;
+      pfd.events  = POLLIN;
+      pfd.revents = 0;
+      if (poll(&pfd, 1, MMWAVE_READ_TIMEOUT_MS) <= 0)
         {
-          int complete = mmwave_parse_byte(priv, byte);
-          if (complete)
+          continue;
+        }
+
+      nread = read(priv->uart_fd, buf, sizeof(buf));
+
+      if (nread > 0)
+        {
+#ifdef CONFIG_MMWAVE_PM
+          pm_activity(PM_IDLE_DOMAIN, MMWAVE_PM_FRAME_ACTIVITY);
+#endif
+
+          for (ssize_t i = 0; i < nread; i++)
             {
-              mmwave_process_data_frame(priv);
+              int complete = mmwave_parse_byte(priv, buf[i]);
+              if (complete && priv->rxbuf[0] == 0xFA)
+                {
+                  mmwave_process_ack(priv);
+                }
+              else if (complete)
+                {
+                  mmwave_process_data_frame(priv);
+                }
             }
         }
       else if (nread < 0 && errno != EAGAIN && errno != EINTR)
@@ -536,12 +1089,6 @@ static int mmwave_poll_task(int argc, FAR char *argv[])
           snerr("ERROR: UART read error: %d\n", errno);
           usleep(100000);  /* Back off on persistent errors */
         }
-      else
-        {
-          /* No data available — yield briefly */
-
-          usleep(10000);  /* 10ms — allows ~100Hz parse rate */
-        }
     }
 
   sninfo("mmWave poll task stopped\n");
@@ -554,13 +1101,18 @@ static int mmwave_poll_task(int argc, FAR char *argv[])
 
 static int mmwave_open(FAR struct file *filep)
 {
-  /* Nothing special to do — polling task is always running */
+  /* The polling task is always running; just track what this opener
+   * has seen, for poll().
+   */
 
-  return OK;
+  filep->f_priv = kmm_zalloc(sizeof(struct mmwave_open_s));
+  return filep->f_priv != NULL ? OK : -ENOMEM;
 }
 
 static int mmwave_close(FAR struct file *filep)
 {
+  kmm_free(filep->f_priv);
+  filep->f_priv = NULL;
   return OK;
 }
 
@@ -598,6 +1150,11 @@ static ssize_t mmwave_read(FAR struct file *filep, FAR char *buffer,
 
   ssize_t copylen;
 
+  if (filep->f_priv != NULL)
+    {
+      ((FAR struct mmwave_open_s *)filep->f_priv)->seq = priv->frame_seq;
+    }
+
   if (priv->eng_mode &&
       buflen >= sizeof(struct mmwave_eng_data_s))
     {
@@ -619,6 +1176,71 @@ static ssize_t mmwave_read(FAR struct file *filep, FAR char *buffer,
   return copylen;
 }
 
+/****************************************************************************
+ * Name: mmwave_poll
+ *
+ * Description:
+ *   POLLIN when a frame has been parsed since this opener's last read(),
+ *   so a reader can sleep until there is something new instead of
+ *   sampling on a timer.
+ *
+ ****************************************************************************/
+
+static int mmwave_poll(FAR struct file *filep, FAR struct pollfd *fds,
+                       bool setup)
+{
+  FAR struct mmwave_dev_s *priv = g_mmwave_dev;
+  FAR struct mmwave_open_s *opriv = filep->f_priv;
+  int ret;
+  int i;
+
+  if (priv == NULL)
+    {
+      return -ENODEV;
+    }
+
+  ret = nxsem_wait(&priv->data_sem);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  if (setup)
+    {
+      for (i = 0; i < CONFIG_MMWAVE_LD2410_NPOLLWAITERS; i++)
+        {
+          if (priv->fds[i] == NULL)
+            {
+              priv->fds[i] = fds;
+              break;
+            }
+        }
+
+      if (i == CONFIG_MMWAVE_LD2410_NPOLLWAITERS)
+        {
+          ret = -EBUSY;
+        }
+      else if (priv->data_valid && opriv != NULL &&
+               opriv->seq != priv->frame_seq)
+        {
+          poll_notify(&priv->fds[i], 1, POLLIN);
+        }
+    }
+  else
+    {
+      for (i = 0; i < CONFIG_MMWAVE_LD2410_NPOLLWAITERS; i++)
+        {
+          if (priv->fds[i] == fds)
+            {
+              priv->fds[i] = NULL;
+            }
+        }
+    }
+
+  nxsem_post(&priv->data_sem);
+  return ret;
+}
+
 /****************************************************************************
  * Name: mmwave_ioctl
  *
@@ -652,83 +1274,51 @@ static int mmwave_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
           ret = mmwave_enter_config(priv);
           if (ret < 0) break;
 
-          /* Command data: gate(2) + motion_val(4) + static_val(4) */
-
-          uint8_t data[18];
-          memset(data, 0, sizeof(data));
-
-          /* Word 0: gate select */
-
-          data[0] = 0x00;
-          data[1] = 0x00;
-          data[2] = sens->gate;
-          data[3] = 0x00;
-          data[4] = 0x00;
-          data[5] = 0x00;
-
-          /* Word 1: motion sensitivity */
-
-          data[6]  = 0x01;
-          data[7]  = 0x00;
-          data[8]  = sens->motion_threshold;
-          data[9]  = 0x00;
-          data[10] = 0x00;
-          data[11] = 0x00;
-
-          /* Word 2: static sensitivity */
-
-          data[12] = 0x02;
-          data[13] = 0x00;
-          data[14] = sens->static_threshold;
-          data[15] = 0x00;
-          data[16] = 0x00;
-          data[17] = 0x00;
-
-          ret = mmwave_send_command(priv, LD2410_CMD_SET_SENSITIVITY,
-                                   data, sizeof(data));
-
+          ret = mmwave_set_gate(priv, sens->gate, sens->motion_threshold,
+                                sens->static_threshold);
           mmwave_exit_config(priv);
         }
         break;
 
       case MMWAVE_IOC_SET_MAXGATE:
         {
-          FAR struct mmwave_maxgate_s *mg =
-            (FAR struct mmwave_maxgate_s *)arg;
-
           ret = mmwave_enter_config(priv);
           if (ret < 0) break;
 
-          /* Command data: motion_gate(4) + static_gate(4) + timeout(4) */
-
-          uint8_t data[18];
-          memset(data, 0, sizeof(data));
+          ret = mmwave_set_maxgate(priv,
+                                   (FAR struct mmwave_maxgate_s *)arg);
+          mmwave_exit_config(priv);
+        }
+        break;
 
-          data[0]  = 0x00;
-          data[1]  = 0x00;
-          data[2]  = mg->max_motion_gate;
-          data[3]  = 0x00;
-          data[4]  = 0x00;
-          data[5]  = 0x00;
+      case MMWAVE_IOC_GET_CONFIG:
+        {
+          if (!priv->config_valid)
+            {
+              ret = mmwave_enter_config(priv);
+              if (ret < 0) break;
 
-          data[6]  = 0x01;
-          data[7]  = 0x00;
-          data[8]  = mg->max_static_gate;
-          data[9]  = 0x00;
-          data[10] = 0x00;
-          data[11] = 0x00;
+              ret = mmwave_read_config(priv);
+              mmwave_exit_config(priv);
+            }
 
-          data[12] = 0x02;
-          data[13] = 0x00;
-          data[14] = (uint8_t)(mg->timeout_s & 0xFF);
-          data[15] = (uint8_t)((mg->timeout_s >> 8) & 0xFF);
-          data[16] = 0x00;
-          data[17] = 0x00;
+          if (ret == OK)
+            {
+              memcpy((FAR struct mmwave_config_s *)arg, &priv->config,
+                     sizeof(struct mmwave_config_s));
+            }
+        }
+        break;
 
-          ret = mmwave_send_command(priv, LD2410_CMD_SET_MAXGATE,
-                                   data, sizeof(data));
+      case MMWAVE_IOC_APPLY_CONFIG:
+        {
+          ret = mmwave_apply(priv, (FAR struct mmwave_apply_s *)arg);
+        }
+        break;
 
-          mmwave_exit_config(priv);
+      case MMWAVE_IOC_SET_BAUD:
+        {
+          ret = mmwave_set_baud(priv, (uint32_t)arg);
         }
         break;
 
@@ -741,14 +1331,12 @@ static int mmwave_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
 
           if (enable)
             {
-              ret = mmwave_send_command(priv, LD2410_CMD_ENG_MODE_ON,
-                                       NULL, 0);
+              ret = mmwave_command(priv, LD2410_CMD_ENG_MODE_ON, NULL, 0);
               if (ret == OK) priv->eng_mode = true;
             }
           else
             {
-              ret = mmwave_send_command(priv, LD2410_CMD_ENG_MODE_OFF,
-                                       NULL, 0);
+              ret = mmwave_command(priv, LD2410_CMD_ENG_MODE_OFF, NULL, 0);
               if (ret == OK) priv->eng_mode = false;
             }
 
@@ -761,8 +1349,10 @@ static int mmwave_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
           ret = mmwave_enter_config(priv);
           if (ret < 0) break;
 
-          ret = mmwave_send_command(priv, LD2410_CMD_RESTART, NULL, 0);
-          mmwave_exit_config(priv);
+          /* Settings survive a restart: the cache stays valid */
+
+          ret = mmwave_command(priv, LD2410_CMD_RESTART, NULL, 0);
+          nxsem_post(&priv->cmd_sem);
         }
         break;
 
@@ -771,11 +1361,36 @@ static int mmwave_ioctl(FAR struct file *filep, int cmd, unsigned long arg)
           ret = mmwave_enter_config(priv);
           if (ret < 0) break;
 
-          ret = mmwave_send_command(priv, LD2410_CMD_FACTORY_RESET, NULL, 0);
+          ret = mmwave_command(priv, LD2410_CMD_FACTORY_RESET, NULL, 0);
+          priv->config_valid = false;
           mmwave_exit_config(priv);
         }
         break;
 
+      case MMWAVE_IOC_GET_BOOTTIME:
+        memcpy((FAR struct mmwave_boottime_s *)arg, &g_boottime,
+               sizeof(g_boottime));
+        break;
+
+      case MMWAVE_IOC_MILESTONE:
+        if ((int)arg < 0 || (int)arg >= MMWAVE_MILESTONES)
+          {
+            return -EINVAL;
+          }
+
+        mmwave_ld2410_milestone((int)arg);
+        break;
+
+      case MMWAVE_IOC_UNSENT:
+        g_unsent = (uint32_t)arg;
+        break;
+
+#ifdef CONFIG_MMWAVE_PM
+      case MMWAVE_IOC_GET_PM:
+        ret = mmwave_pm_get_stats((FAR struct mmwave_pm_stats_s *)arg);
+        break;
+#endif
+
       default:
         ret = -ENOTTY;
         break;
@@ -867,6 +1482,8 @@ int mmwave_ld2410_register(FAR const char *devpath,
   sninfo("mmWave LD2410 registered at %s (UART: %s @ %lu baud)\n",
          devpath, uartpath, (unsigned long)baud);
 
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_DRIVER);
+
   return OK;
 
 errout_with_driver:
@@ -892,6 +1509,106 @@ errout_with_alloc:
  *
  ****************************************************************************/
 
+int mmwave_ld2410_apply(FAR struct mmwave_apply_s *req)
+{
+  return g_mmwave_dev != NULL ? mmwave_apply(g_mmwave_dev, req) : -ENODEV;
+}
+
+int mmwave_ld2410_set_baud(uint32_t baud)
+{
+  return g_mmwave_dev != NULL ? mmwave_set_baud(g_mmwave_dev, baud) :
+                                -ENODEV;
+}
+
+void mmwave_ld2410_milestone(int id)
+{
+  uint32_t ms = clock_systime_ticks() * (1000 / TICK_PER_SEC);
+
+  if (id >= 0 && id < MMWAVE_MILESTONES && g_boottime.ms[id] == 0)
+    {
+      g_boottime.ms[id] = ms > 0 ? ms : 1;   /* 0 means not yet */
+    }
+}
+
+uint32_t mmwave_ld2410_milestone_ms(int id)
+{
+  return id >= 0 && id < MMWAVE_MILESTONES ? g_boottime.ms[id] : 0;
+}
+
+uint32_t mmwave_ld2410_unsent(void)
+{
+  return g_unsent;
+}
+
+int mmwave_ld2410_snapshot(FAR struct mmwave_snapshot_s *snap)
+{
+  FAR struct mmwave_dev_s *priv = g_mmwave_dev;
+  int ret;
+
+  if (priv == NULL)
+    {
+      return -ENODEV;
+    }
+
+  ret = nxsem_wait(&priv->data_sem);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  memset(snap, 0, sizeof(*snap));
+  snap->data         = priv->data;
+  snap->config       = priv->config;
+  snap->data_valid   = priv->data_valid;
+  snap->config_valid = priv->config_valid;
+  snap->frames_ok    = priv->frames_ok;
+  snap->frames_err   = priv->frames_err;
+  snap->cmd_timeouts = priv->cmd_timeouts;
+  snap->cfg_writes   = priv->cfg_writes;
+
+  nxsem_post(&priv->data_sem);
+  return OK;
+}
+
+/* The reading keeps its state but not its time, which was on the clock
+ * of the boot before; frame_seq stays 0, so poll() still waits for the
+ * first frame of this one.
+ */
+
+int mmwave_ld2410_restore(FAR const struct mmwave_snapshot_s *snap)
+{
+  FAR struct mmwave_dev_s *priv = g_mmwave_dev;
+  int ret;
+
+  if (priv == NULL)
+    {
+      return -ENODEV;
+    }
+
+  ret = nxsem_wait(&priv->data_sem);
+  if (ret < 0)
+    {
+      return ret;
+    }
+
+  if (!priv->data_valid)
+    {
+      priv->data              = snap->data;
+      priv->data.timestamp_ms = 0;
+      priv->data_valid        = snap->data_valid;
+    }
+
+  priv->config        = snap->config;
+  priv->config_valid  = snap->config_valid;
+  priv->frames_ok    += snap->frames_ok;
+  priv->frames_err   += snap->frames_err;
+  priv->cmd_timeouts += snap->cmd_timeouts;
+  priv->cfg_writes   += snap->cfg_writes;
+
+  nxsem_post(&priv->data_sem);
+  return OK;
+}
+
 int mmwave_ld2410_unregister(FAR const char *devpath)
 {
   FAR struct mmwave_dev_s *priv = g_mmwave_dev;
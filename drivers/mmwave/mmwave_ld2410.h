@@ -17,9 +17,11 @@
 #include <nuttx/config.h>
 #include <nuttx/fs/fs.h>
 #include <nuttx/serial/serial.h>
+#include <nuttx/semaphore.h>
 #include <sys/types.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <poll.h>
 
 /****************************************************************************
  * Pre-processor Definitions
@@ -35,6 +37,14 @@
 #define LD2410_MAX_FRAME_LEN       64
 #define LD2410_DEFAULT_BAUD        256000
 
+/* poll() waiters on /dev/mmwave0 at once: one per service task when
+ * mmwaved is not running
+ */
+
+#ifndef CONFIG_MMWAVE_LD2410_NPOLLWAITERS
+#  define CONFIG_MMWAVE_LD2410_NPOLLWAITERS 8
+#endif
+
 /* LD2410 Target States */
 
 #define LD2410_TARGET_NONE         0x00
@@ -56,6 +66,13 @@
 #define LD2410_CMD_ENG_MODE_OFF    0x0063
 #define LD2410_CMD_READ_CONFIG     0x0061
 
+/* The sensor answers every command with the command word | 0x0100 and
+ * a 16-bit status, 0 for success
+ */
+
+#define LD2410_ACK_FLAG            0x0100
+#define LD2410_ACK_MAX             32
+
 /* LD2410 Gate configuration (0-8, each ~0.75m) */
 
 #define LD2410_MAX_GATES           9
@@ -71,6 +88,27 @@
 #define MMWAVE_IOC_RESTART         _IO(MMWAVE_IOC_MAGIC, 5)
 #define MMWAVE_IOC_FACTORY_RESET   _IO(MMWAVE_IOC_MAGIC, 6)
 #define MMWAVE_IOC_GET_FIRMWARE    _IOR(MMWAVE_IOC_MAGIC, 7, struct mmwave_firmware_s)
+#define MMWAVE_IOC_APPLY_CONFIG    _IOW(MMWAVE_IOC_MAGIC, 8, struct mmwave_apply_s)
+#define MMWAVE_IOC_SET_BAUD        _IOW(MMWAVE_IOC_MAGIC, 9, uint32_t)
+#define MMWAVE_IOC_GET_BOOTTIME    _IOR(MMWAVE_IOC_MAGIC, 10, struct mmwave_boottime_s)
+#define MMWAVE_IOC_MILESTONE       _IOW(MMWAVE_IOC_MAGIC, 11, int)
+#define MMWAVE_IOC_GET_PM          _IOR(MMWAVE_IOC_MAGIC, 12, struct mmwave_pm_stats_s)
+#define MMWAVE_IOC_UNSENT          _IOW(MMWAVE_IOC_MAGIC, 13, uint32_t)
+
+/* Fields of struct mmwave_apply_s to enforce; the rest stay as they are */
+
+#define MMWAVE_APPLY_MAX_MOTION    0x01
+#define MMWAVE_APPLY_MAX_STATIC    0x02
+#define MMWAVE_APPLY_TIMEOUT       0x04
+#define MMWAVE_APPLY_MOTION_SENS   0x08
+#define MMWAVE_APPLY_STATIC_SENS   0x10
+#define MMWAVE_APPLY_ALL           0x1f
+
+/* Bits of a plan: one per gate sensitivity command, and the max gate
+ * command (max gates and timeout together)
+ */
+
+#define MMWAVE_PLAN_MAXGATE        (1 << LD2410_MAX_GATES)
 
 /****************************************************************************
  * Public Types
@@ -89,6 +127,50 @@ struct mmwave_data_s
   uint32_t timestamp_ms;       /* Tick count at data capture */
 };
 
+/* Boot milestones, recorded once each by the bring-up, the driver and
+ * hactl (MMWAVE_IOC_MILESTONE)
+ */
+
+enum mmwave_milestone_e
+{
+  MMWAVE_MILESTONE_MOUNT = 0,  /* LittleFS mounted at /config */
+  MMWAVE_MILESTONE_DRIVER,     /* /dev/mmwave0 registered */
+  MMWAVE_MILESTONE_FRAME,      /* First data frame parsed */
+  MMWAVE_MILESTONE_WIFI,       /* Associated */
+  MMWAVE_MILESTONE_DHCP,       /* Lease bound */
+  MMWAVE_MILESTONE_REPORT,     /* First successful HA post */
+  MMWAVE_MILESTONES
+};
+
+/* ms since boot of each milestone, 0 until it is reached */
+
+struct mmwave_boottime_s
+{
+  uint32_t ms[MMWAVE_MILESTONES];
+};
+
+/* Power states the PM governor (mmwave_pm.c) chooses between, as
+ * enum pm_state_e numbers them
+ */
+
+#define MMWAVE_PM_NORMAL           0
+#define MMWAVE_PM_IDLE             1
+#define MMWAVE_PM_STANDBY          2
+#define MMWAVE_PM_NSTATES          3
+
+/* pm_activity() priority of a parsed frame; any other counts as work */
+
+#define MMWAVE_PM_FRAME_ACTIVITY   9
+
+/* Residency since the governor started (MMWAVE_IOC_GET_PM) */
+
+struct mmwave_pm_stats_s
+{
+  uint32_t ms[MMWAVE_PM_NSTATES];       /* Time spent in each state */
+  uint32_t entries[MMWAVE_PM_NSTATES];  /* Times each was entered */
+  uint8_t  state;                       /* Now */
+};
+
 /* Engineering mode data — per-gate energy levels */
 
 struct mmwave_eng_data_s
@@ -127,6 +209,35 @@ struct mmwave_config_s
   uint8_t  static_sensitivity[LD2410_MAX_GATES];
 };
 
+/* Desired configuration: the fields in mask are brought to cfg with
+ * only the commands that differ, in one config session. sent is how
+ * many were needed.
+ */
+
+struct mmwave_apply_s
+{
+  struct mmwave_config_s cfg;
+  uint8_t  mask;               /* MMWAVE_APPLY_xxx */
+  uint8_t  sent;               /* Out: set commands sent */
+};
+
+/* What a deep sleep keeps of the driver (mmwave_ld2410_snapshot()):
+ * the last reading, the sensor's configuration as last read or written,
+ * and the statistics
+ */
+
+struct mmwave_snapshot_s
+{
+  struct mmwave_data_s   data;
+  struct mmwave_config_s config;
+  bool     data_valid;
+  bool     config_valid;
+  uint32_t frames_ok;
+  uint32_t frames_err;
+  uint32_t cmd_timeouts;
+  uint32_t cfg_writes;
+};
+
 /* Firmware version info */
 
 struct mmwave_firmware_s
@@ -174,11 +285,30 @@ struct mmwave_dev_s
   sem_t                  cmd_sem;         /* Serializes command access */
   sem_t                  wait_sem;        /* Wait for command response */
 
+  /* Command acknowledgement, filled by the polling task */
+
+  uint16_t               ack_expect;      /* Ack word awaited, 0 none */
+  uint8_t                ack[LD2410_ACK_MAX];
+  uint8_t                ack_len;
+
+  /* The sensor's configuration as last read or written: an apply that
+   * changes nothing against it sends no command at all
+   */
+
+  struct mmwave_config_s config;
+  bool                   config_valid;
+
+  /* poll(): POLLIN once a frame newer than the opener's last read() */
+
+  uint32_t               frame_seq;       /* Bumped per parsed frame */
+  FAR struct pollfd     *fds[CONFIG_MMWAVE_LD2410_NPOLLWAITERS];
+
   /* Statistics */
 
   uint32_t               frames_ok;       /* Successfully parsed frames */
   uint32_t               frames_err;      /* Parse errors / CRC failures */
   uint32_t               cmd_timeouts;    /* Command response timeouts */
+  uint32_t               cfg_writes;      /* Set commands sent */
 };
 
 /****************************************************************************
@@ -204,4 +334,61 @@ int mmwave_ld2410_register(FAR const char *devpath,
 
 int mmwave_ld2410_unregister(FAR const char *devpath);
 
+/**
+ * Bring the sensor to req (as MMWAVE_IOC_APPLY_CONFIG) from kernel code
+ * such as the board bring-up, without opening the device.
+ *
+ * @return the number of set commands sent, or negative errno
+ */
+
+int mmwave_ld2410_apply(FAR struct mmwave_apply_s *req);
+
+/**
+ * Move the sensor and our UART to another baud rate (as
+ * MMWAVE_IOC_SET_BAUD); nothing is sent when it is already in use.
+ */
+
+int mmwave_ld2410_set_baud(uint32_t baud);
+
+/**
+ * Record the time of a boot milestone (enum mmwave_milestone_e) from
+ * kernel code; only the first call for each counts. Works before the
+ * driver is registered.
+ */
+
+void mmwave_ld2410_milestone(int id);
+
+/**
+ * ms since boot of a boot milestone, 0 if it has not been reached.
+ */
+
+uint32_t mmwave_ld2410_milestone_ms(int id);
+
+/**
+ * Presence transitions hactl holds only in RAM, neither delivered to HA
+ * nor journaled to flash, as it last set them with MMWAVE_IOC_UNSENT; a
+ * deep sleep now would lose them.
+ */
+
+uint32_t mmwave_ld2410_unsent(void);
+
+/**
+ * Copy the driver's state out before a deep sleep, and back into the
+ * freshly registered driver on resume: the sensor's configuration is
+ * then not read back from it again, and the statistics carry on.
+ *
+ * @return 0 on success, -ENODEV if the driver is not registered
+ */
+
+int mmwave_ld2410_snapshot(FAR struct mmwave_snapshot_s *snap);
+int mmwave_ld2410_restore(FAR const struct mmwave_snapshot_s *snap);
+
+/**
+ * Install the sensor-driven PM governor on the idle domain
+ * (CONFIG_MMWAVE_PM), and read its residency statistics.
+ */
+
+int mmwave_pm_register(void);
+int mmwave_pm_get_stats(FAR struct mmwave_pm_stats_s *stats);
+
 #endif /* __DRIVERS_MMWAVE_LD2410_H */
@@ -0,0 +1,167 @@
+/****************************************************************************
+ * drivers/mmwave/mmwave_pm.c
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * A PM governor for the idle domain driven by the sensor. The poll task
+ * reports each burst of UART bytes with pm_activity() at
+ * MMWAVE_PM_FRAME_ACTIVITY; anything else reported to the idle domain
+ * counts as other work, and pm_stay(PM_NORMAL) holds full performance
+ * for as long as it is held. The policy is in mmwave_pm.h.
+ *
+ * The residency statistics are read with MMWAVE_IOC_GET_PM
+ * (sysinfo -p).
+ *
+ ****************************************************************************/
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <errno.h>
+#include <debug.h>
+
+#include <nuttx/clock.h>
+#include <nuttx/irq.h>
+#include <nuttx/power/pm.h>
+
+#include "mmwave_pm.h"
+
+/****************************************************************************
+ * Private Function Prototypes
+ ****************************************************************************/
+
+static void mmwave_pm_gov_init(void);
+static void mmwave_pm_statechanged(int domain, enum pm_state_e newstate);
+static enum pm_state_e mmwave_pm_checkstate(int domain);
+static void mmwave_pm_gov_activity(int domain, int count);
+
+/****************************************************************************
+ * Private Data
+ ****************************************************************************/
+
+static struct mmwave_pm_s g_mmwave_pm;
+
+static struct pm_governor_s g_mmwave_pm_governor =
+{
+  .initialize   = mmwave_pm_gov_init,
+  .statechanged = mmwave_pm_statechanged,
+  .checkstate   = mmwave_pm_checkstate,
+  .activity     = mmwave_pm_gov_activity,
+};
+
+/****************************************************************************
+ * Private Functions
+ ****************************************************************************/
+
+static uint32_t mmwave_pm_now(void)
+{
+  return clock_systime_ticks() * (1000 / TICK_PER_SEC);
+}
+
+static void mmwave_pm_gov_init(void)
+{
+  mmwave_pm_init(&g_mmwave_pm, mmwave_pm_now());
+}
+
+static void mmwave_pm_statechanged(int domain, enum pm_state_e newstate)
+{
+  irqstate_t flags;
+
+  if (domain != PM_IDLE_DOMAIN || newstate == PM_RESTORE)
+    {
+      return;
+    }
+
+  flags = enter_critical_section();
+  mmwave_pm_changed(&g_mmwave_pm, mmwave_pm_now(), (int)newstate);
+  leave_critical_section(flags);
+}
+
+/****************************************************************************
+ * Name: mmwave_pm_checkstate
+ *
+ * Description:
+ *   Called from the idle loop: NORMAL while a frame is being handled,
+ *   other work is recent or something holds PM_NORMAL; IDLE between
+ *   frames; STANDBY once the sensor has gone quiet.
+ *
+ ****************************************************************************/
+
+static enum pm_state_e mmwave_pm_checkstate(int domain)
+{
+  irqstate_t flags;
+  bool pending;
+  int state;
+
+  if (domain != PM_IDLE_DOMAIN)
+    {
+      return PM_NORMAL;
+    }
+
+  pending = pm_staycount(domain, PM_NORMAL) > 0;
+
+  flags = enter_critical_section();
+  state = mmwave_pm_recommend(&g_mmwave_pm, mmwave_pm_now(), pending);
+  leave_critical_section(flags);
+
+  return (enum pm_state_e)state;
+}
+
+static void mmwave_pm_gov_activity(int domain, int count)
+{
+  irqstate_t flags;
+
+  if (domain != PM_IDLE_DOMAIN)
+    {
+      return;
+    }
+
+  flags = enter_critical_section();
+  mmwave_pm_activity(&g_mmwave_pm, mmwave_pm_now(),
+                     count == MMWAVE_PM_FRAME_ACTIVITY);
+  leave_critical_section(flags);
+}
+
+/****************************************************************************
+ * Public Functions
+ ****************************************************************************/
+
+/****************************************************************************
+ * Name: mmwave_pm_register
+ *
+ * Description:
+ *   Make this the idle domain's governor. Call once, early in the
+ *   bring-up, before the sensor starts sending.
+ *
+ ****************************************************************************/
+
+int mmwave_pm_register(void)
+{
+  int ret;
+
+  ret = pm_set_governor(PM_IDLE_DOMAIN, &g_mmwave_pm_governor);
+  if (ret < 0)
+    {
+      snerr("ERROR: mmwave PM governor: %d\n", ret);
+    }
+
+  return ret;
+}
+
+int mmwave_pm_get_stats(FAR struct mmwave_pm_stats_s *stats)
+{
+  irqstate_t flags;
+
+  if (stats == NULL)
+    {
+      return -EINVAL;
+    }
+
+  flags = enter_critical_section();
+  mmwave_pm_stats(&g_mmwave_pm, mmwave_pm_now(), stats);
+  leave_critical_section(flags);
+  return OK;
+}
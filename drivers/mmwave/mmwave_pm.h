@@ -0,0 +1,163 @@
+/****************************************************************************
+ * drivers/mmwave/mmwave_pm.h
+ *
+ * SPDX-License-Identifier: MIT
+ *
+ * The policy of the sensor-driven PM governor (mmwave_pm.c), kept apart
+ * from NuttX's PM framework so it can be run against a trace on the
+ * host.
+ *
+ * The LD2410 sends a frame about every 100 ms, a millisecond or two on
+ * the wire at 256000 baud. The CPU is held at full performance while a
+ * frame is being parsed (each burst of UART bytes holds it for
+ * CONFIG_MMWAVE_PM_FRAME_HOLD_MS), after any other activity reported to
+ * the idle domain (CONFIG_MMWAVE_PM_ACTIVITY_HOLD_MS), and while
+ * anything holds PM_NORMAL with pm_stay(), as HA reporting does around
+ * a post. Between frames it is let down to IDLE. STANDBY, where UART
+ * bytes can be lost while the clock comes back, is left for when the
+ * sensor has been silent for CONFIG_MMWAVE_PM_STANDBY_MS. PM_SLEEP is
+ * never chosen: deep sleep belongs to the resume path
+ * (apps/common/mmwave_resume.h).
+ *
+ * Times are ms on a free-running 32-bit clock; they may wrap.
+ *
+ ****************************************************************************/
+
+#ifndef __DRIVERS_MMWAVE_PM_H
+#define __DRIVERS_MMWAVE_PM_H
+
+/****************************************************************************
+ * Included Files
+ ****************************************************************************/
+
+#include <nuttx/config.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mmwave_ld2410.h"
+
+/****************************************************************************
+ * Pre-processor Definitions
+ ****************************************************************************/
+
+#ifndef CONFIG_MMWAVE_PM_FRAME_HOLD_MS
+#  define CONFIG_MMWAVE_PM_FRAME_HOLD_MS     10
+#endif
+
+#ifndef CONFIG_MMWAVE_PM_ACTIVITY_HOLD_MS
+#  define CONFIG_MMWAVE_PM_ACTIVITY_HOLD_MS  100
+#endif
+
+#ifndef CONFIG_MMWAVE_PM_STANDBY_MS
+#  define CONFIG_MMWAVE_PM_STANDBY_MS        1000
+#endif
+
+/****************************************************************************
+ * Public Types
+ ****************************************************************************/
+
+struct mmwave_pm_s
+{
+  uint32_t hold_until;                  /* NORMAL until then */
+  uint32_t last_frame;
+  bool     frames;                      /* last_frame is set */
+  uint8_t  state;
+  uint32_t since;                       /* state entered */
+  uint32_t ms[MMWAVE_PM_NSTATES];       /* Closed intervals only */
+  uint32_t entries[MMWAVE_PM_NSTATES];
+};
+
+/****************************************************************************
+ * Inline Functions
+ ****************************************************************************/
+
+/* a is before b, across a wrap */
+
+static inline bool mmwave_pm_before(uint32_t a, uint32_t b)
+{
+  return (int32_t)(a - b) < 0;
+}
+
+static inline void mmwave_pm_init(FAR struct mmwave_pm_s *p, uint32_t now)
+{
+  memset(p, 0, sizeof(*p));
+  p->state      = MMWAVE_PM_NORMAL;
+  p->since      = now;
+  p->hold_until = now;
+  p->entries[MMWAVE_PM_NORMAL] = 1;
+}
+
+/* Something happened: a frame (UART bytes from the sensor) or other
+ * work; either keeps the CPU up for a while
+ */
+
+static inline void mmwave_pm_activity(FAR struct mmwave_pm_s *p,
+                                      uint32_t now, bool frame)
+{
+  uint32_t until = now + (frame ? CONFIG_MMWAVE_PM_FRAME_HOLD_MS :
+                                  CONFIG_MMWAVE_PM_ACTIVITY_HOLD_MS);
+
+  if (mmwave_pm_before(p->hold_until, until))
+    {
+      p->hold_until = until;
+    }
+
+  if (frame)
+    {
+      p->last_frame = now;
+      p->frames     = true;
+    }
+}
+
+/**
+ * The state to be in now. pending: something holds PM_NORMAL (network
+ * work in flight).
+ */
+
+static inline int mmwave_pm_recommend(FAR const struct mmwave_pm_s *p,
+                                      uint32_t now, bool pending)
+{
+  if (pending || mmwave_pm_before(now, p->hold_until))
+    {
+      return MMWAVE_PM_NORMAL;
+    }
+
+  if (p->frames && now - p->last_frame < CONFIG_MMWAVE_PM_STANDBY_MS)
+    {
+      return MMWAVE_PM_IDLE;
+    }
+
+  return MMWAVE_PM_STANDBY;
+}
+
+/* The framework moved to state: close the interval of the one before */
+
+static inline void mmwave_pm_changed(FAR struct mmwave_pm_s *p,
+                                     uint32_t now, int state)
+{
+  if (state < 0 || state >= MMWAVE_PM_NSTATES || state == p->state)
+    {
+      return;
+    }
+
+  p->ms[p->state] += now - p->since;
+  p->since = now;
+  p->state = (uint8_t)state;
+  p->entries[state]++;
+}
+
+/* Residency up to now, the current state's open interval included */
+
+static inline void mmwave_pm_stats(FAR const struct mmwave_pm_s *p,
+                                   uint32_t now,
+                                   FAR struct mmwave_pm_stats_s *st)
+{
+  memcpy(st->ms, p->ms, sizeof(st->ms));
+  memcpy(st->entries, p->entries, sizeof(st->entries));
+  st->ms[p->state] += now - p->since;
+  st->state = p->state;
+}
+
+#endif /* __DRIVERS_MMWAVE_PM_H */
@@ -93,7 +93,7 @@ if [ ! -L "$DRIVER_DEST" ] && [ ! -d "$DRIVER_DEST" ]; then
 fi
 
 # Link our apps into NuttX apps directory
-for app in mmwave hactl sysinfo config; do
+for app in mmwave hactl sysinfo config esphome coap mcast httpd stream mmwaved; do
   APP_DEST="$NUTTX_APPS_PATH/$app"
   if [ ! -L "$APP_DEST" ] && [ ! -d "$APP_DEST" ]; then
     ln -sf "$PROJECT_DIR/apps/$app" "$APP_DEST"
@@ -0,0 +1,404 @@
+/*
+ * tests/bench_config_store.c
+ *
+ * Benchmark: the log-structured config store against the file-per-key
+ * layout it replaced, one `config` invocation per operation.
+ *
+ *   per-key files — opendir + open/read/close per key for list, one
+ *                   file rewritten per set, reset unlinks everything
+ *                   and creates every default again
+ *   store         — open config.log, scan it into the index, serve the
+ *                   request, one append per set or reset
+ *   service       — the index the config service (config_svc.c) loads
+ *                   once a boot, which `config get` and every app read
+ *
+ * Latency is measured on the host's filesystem (no fsync), so it shows
+ * the system-call pattern rather than flash speed. Flash cost is a
+ * model: every LittleFS commit (file close/sync, unlink, rename)
+ * programs its data plus about 16 bytes of metadata, rounded up to the
+ * 16-byte program size, and every 4 KB programmed is eventually one
+ * erase. It is a benchmark, not a test: it always exits 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <dirent.h>
+
+#include "helpers/bench.h"
+#include "apps/config/config_store.h"
+
+#define ITERS        2000
+#define LFS_PROG     16
+#define LFS_BLOCK    4096
+#define LFS_META     16
+#define PATH_LEN     (64 + 256 + 2)
+
+struct flash_model_s
+{
+  uint32_t calls;        /* open/read/write/close/unlink/readdir ... */
+  uint32_t commits;
+  uint64_t prog;         /* Bytes programmed */
+};
+
+static char g_dir[64];
+static struct flash_model_s g_m;
+
+static const char *g_keys[] =
+{
+  "wifi.ssid", "wifi.psk", "ha.url", "ha.port", "ha.token",
+  "mmwave.uart", "mmwave.baud", "boot.autostart_ha", "boot.autostart_wifi"
+};
+
+static const char *g_vals[] =
+{
+  "home-network", "correct horse battery", "192.168.1.100", "8123",
+  "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJpc3MiOiJhYmNkZWYxMjM0NTY3ODkw"
+  "IiwiaWF0IjoxNzAwMDAwMDAwLCJleHAiOjIwMDAwMDAwMDB9.c2lnbmF0dXJlc2lnbmF0"
+  "dXJlc2lnbmF0dXJlc2lnbmF0dXJl", "/dev/ttyS1", "256000", "1", "1"
+};
+
+#define NKEYS (int)(sizeof(g_keys) / sizeof(g_keys[0]))
+
+static void commit(size_t bytes)
+{
+  g_m.commits++;
+  g_m.prog += (bytes + LFS_META + LFS_PROG - 1) / LFS_PROG * LFS_PROG;
+}
+
+/* ---- File per key, as config_cmd.c did it ---- */
+
+static void legacy_path(char *buf, size_t len, const char *key)
+{
+  snprintf(buf, len, "%s/%s", g_dir, key);
+}
+
+static int legacy_list(void)
+{
+  struct dirent *e;
+  char path[PATH_LEN];
+  char val[256];
+  int n = 0;
+  DIR *d = opendir(g_dir);
+
+  g_m.calls++;
+  while ((e = readdir(d)) != NULL)
+    {
+      g_m.calls++;
+      if (e->d_name[0] == '.' || strchr(e->d_name, '.') == NULL ||
+          strcmp(e->d_name, "config.log") == 0)
+        {
+          continue;
+        }
+
+      legacy_path(path, sizeof(path), e->d_name);
+      int fd = open(path, O_RDONLY);
+      ssize_t r = read(fd, val, sizeof(val) - 1);
+      close(fd);
+      g_m.calls += 3;
+      bench_sink(val);
+      n += r > 0;
+    }
+
+  closedir(d);
+  g_m.calls++;
+  return n;
+}
+
+static void legacy_get(const char *key, char *val)
+{
+  char path[PATH_LEN];
+
+  legacy_path(path, sizeof(path), key);
+  int fd = open(path, O_RDONLY);
+  ssize_t r = read(fd, val, 255);
+  close(fd);
+  val[r > 0 ? r : 0] = '\0';
+  g_m.calls += 3;
+}
+
+static void legacy_set(const char *key, const char *val)
+{
+  char path[PATH_LEN];
+  size_t len = strlen(val);
+
+  legacy_path(path, sizeof(path), key);
+  int fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  if (write(fd, val, len) != (ssize_t)len)
+    {
+      perror("write");
+    }
+
+  close(fd);
+  g_m.calls += 3;
+  commit(strlen(key) + len);
+}
+
+static void legacy_reset(void)
+{
+  char path[PATH_LEN];
+
+  for (int i = 0; i < NKEYS; i++)
+    {
+      legacy_path(path, sizeof(path), g_keys[i]);
+      unlink(path);
+      g_m.calls++;
+      commit(strlen(g_keys[i]));
+    }
+
+  for (int i = 0; i < NKEYS; i++)
+    {
+      legacy_set(g_keys[i], g_vals[i]);
+    }
+}
+
+/* ---- Store over a host file ---- */
+
+static struct cfg_store_s g_s;
+static int g_fd = -1;
+static int g_new_fd = -1;
+
+static ssize_t host_read(void *priv, uint32_t off, uint8_t *buf, size_t len)
+{
+  g_m.calls++;
+  return pread(g_fd, buf, len, off);
+}
+
+static int host_append(void *priv, const uint8_t *buf, size_t len)
+{
+  g_m.calls++;
+  commit(len);
+  return write(g_fd, buf, len) == (ssize_t)len ? 0 : -EIO;
+}
+
+static int host_truncate(void *priv, uint32_t len)
+{
+  g_m.calls++;
+  return ftruncate(g_fd, len);
+}
+
+static int host_rewrite_begin(void *priv)
+{
+  char path[PATH_LEN];
+
+  legacy_path(path, sizeof(path), "config.new");
+  g_new_fd = open(path, O_WRONLY | O_CREAT | O_TRUNC, 0666);
+  g_m.calls++;
+  return 0;
+}
+
+static uint32_t g_rewritten;
+
+static int host_rewrite_write(void *priv, const uint8_t *buf, size_t len)
+{
+  g_m.calls++;
+  g_rewritten += len;
+  return write(g_new_fd, buf, len) == (ssize_t)len ? 0 : -EIO;
+}
+
+static int host_rewrite_end(void *priv, bool ok)
+{
+  char from[PATH_LEN];
+  char to[PATH_LEN];
+
+  legacy_path(from, sizeof(from), "config.new");
+  legacy_path(to, sizeof(to), "config.log");
+  close(g_new_fd);
+  rename(from, to);
+  close(g_fd);
+  g_fd = open(to, O_RDWR | O_APPEND);
+  g_m.calls += 4;
+  commit(g_rewritten);                 /* The new file */
+  commit(0);                           /* The rename */
+  g_rewritten = 0;
+  return 0;
+}
+
+static const struct cfg_store_io_s g_io =
+{
+  host_read, host_append, host_truncate,
+  host_rewrite_begin, host_rewrite_write, host_rewrite_end, NULL
+};
+
+static void store_open(void)
+{
+  char path[PATH_LEN];
+
+  legacy_path(path, sizeof(path), "config.log");
+  g_fd = open(path, O_RDWR | O_CREAT | O_APPEND, 0666);
+  g_m.calls++;
+  cfg_store_init(&g_s, &g_io, 4096);
+  cfg_store_load(&g_s);
+}
+
+static void store_close(void)
+{
+  if (cfg_store_compact_due(&g_s))
+    {
+      cfg_store_compact(&g_s);
+    }
+
+  close(g_fd);
+  g_m.calls++;
+}
+
+static int store_list(void)
+{
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  int pos = 0;
+  int n = 0;
+
+  store_open();
+  while (cfg_store_next(&g_s, &pos, key, val) > 0)
+    {
+      bench_sink(val);
+      n++;
+    }
+
+  store_close();
+  return n;
+}
+
+static void store_get(const char *key, char *val)
+{
+  store_open();
+  cfg_store_get(&g_s, key, val, CFG_VAL_MAX + 1);
+  store_close();
+}
+
+static void store_set(const char *key, const char *val)
+{
+  store_open();
+  cfg_store_set(&g_s, key, val);
+  store_close();
+}
+
+static void store_reset(void)
+{
+  store_open();
+  cfg_store_begin(&g_s);
+  cfg_store_clear(&g_s);
+  for (int i = 0; i < NKEYS; i++)
+    {
+      cfg_store_put(&g_s, g_keys[i], g_vals[i]);
+    }
+
+  cfg_store_commit(&g_s);
+  store_close();
+}
+
+/* ---- Driver ---- */
+
+enum op_e
+{
+  OP_LIST,
+  OP_GET,
+  OP_GET_SVC,
+  OP_SET,
+  OP_RESET
+};
+
+static void run(const char *name, bool store, enum op_e op)
+{
+  char val[CFG_VAL_MAX + 1];
+  int iters = op == OP_RESET ? ITERS / 10 : ITERS;
+
+  memset(&g_m, 0, sizeof(g_m));
+  if (op == OP_GET_SVC)
+    {
+      store_open();
+      memset(&g_m, 0, sizeof(g_m));
+    }
+
+  uint64_t t0 = bench_ns();
+  uint64_t c0 = bench_cycles();
+  for (int i = 0; i < iters; i++)
+    {
+      const char *key = g_keys[i % NKEYS];
+
+      switch (op)
+        {
+          case OP_LIST:
+            store ? store_list() : legacy_list();
+            break;
+
+          case OP_GET:
+            store ? store_get(key, val) : legacy_get(key, val);
+            break;
+
+          case OP_GET_SVC:
+            cfg_store_get(&g_s, key, val, sizeof(val));
+            bench_sink(val);
+            break;
+
+          case OP_SET:
+            snprintf(val, sizeof(val), "%d", i);
+            store ? store_set(key, val) : legacy_set(key, val);
+            break;
+
+          case OP_RESET:
+            store ? store_reset() : legacy_reset();
+            break;
+        }
+    }
+
+  uint64_t c1 = bench_cycles();
+  uint64_t t1 = bench_ns();
+
+  if (op == OP_GET_SVC)
+    {
+      store_close();
+    }
+
+  printf("%-24s %10.0f %10.1f %10.2f %12.1f %10.2f\n", name,
+         (double)(t1 - t0) / iters, (double)g_m.calls / iters,
+         (double)g_m.commits / iters, (double)g_m.prog / iters,
+         (double)g_m.prog * 1000 / LFS_BLOCK / iters);
+  (void)c1;
+  (void)c0;
+}
+
+int main(void)
+{
+  strcpy(g_dir, "/tmp/bench_config_XXXXXX");
+  if (mkdtemp(g_dir) == NULL)
+    {
+      perror("mkdtemp");
+      return 0;
+    }
+
+  legacy_reset();
+  store_reset();
+
+  printf("\nconfig store vs file per key (%d keys, per invocation)\n",
+         NKEYS);
+  printf("%-24s %10s %10s %10s %12s %10s\n", "path", "ns/op", "calls/op",
+         "commits", "prog B/op", "erase/1k");
+
+  run("per-key files: list", false, OP_LIST);
+  run("store: list", true, OP_LIST);
+  run("per-key files: get", false, OP_GET);
+  run("store: get", true, OP_GET);
+  run("service: get", true, OP_GET_SVC);
+  run("per-key files: set", false, OP_SET);
+  run("store: set", true, OP_SET);
+  run("per-key files: reset", false, OP_RESET);
+  run("store: reset", true, OP_RESET);
+
+  printf("\nstore after the run: %lu bytes, %lu live, %lu compaction(s)"
+         "\n", (unsigned long)g_s.file_len, (unsigned long)g_s.live_bytes,
+         (unsigned long)g_s.stats.compactions);
+
+  char cmd[96];
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", g_dir);
+  if (system(cmd) != 0)
+    {
+      fprintf(stderr, "cannot remove %s\n", g_dir);
+    }
+
+  return 0;
+}
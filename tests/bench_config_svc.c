@@ -0,0 +1,312 @@
+/*
+ * tests/bench_config_svc.c
+ *
+ * Benchmark: the settings reads of one boot, before and after the
+ * config service.
+ *
+ *   per invocation — rcS runs `config get` once per key it needs (12),
+ *                    each a builtin that opens config.log, loads it and
+ *                    closes it again; hactl then parses ha.conf with
+ *                    fgets and mcast looks its keys up in the log
+ *   service        — bring-up loads config.log once; rcS reads
+ *                    boot.native with one `config get`, which the
+ *                    service answers from RAM; hactl and mcast use the
+ *                    typed getters
+ *   service, rcS   — the same with boot.native 0: rcS runs one `config
+ *                    export` into /tmp and sources it
+ *
+ * Reads are counted at the file interface: every read() reaches
+ * LittleFS and so the flash (its cache is one block). /tmp is a tmpfs
+ * on the board, so the export goes to a memory stream here. Latency is
+ * on the host's filesystem, so it shows the system-call pattern rather
+ * than flash speed, and leaves out the task spawned for each NSH
+ * builtin - the "invocations" column counts those. It is a benchmark,
+ * not a test: it always exits 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "helpers/bench.h"
+#include "apps/config/config_svc.h"
+
+#define ITERS        500
+#define PATH_LEN     96
+
+struct count_s
+{
+  uint32_t invocations;  /* NSH builtins started */
+  uint32_t opens;
+  uint32_t reads;
+  uint64_t read_bytes;
+};
+
+static char g_dir[64];
+static struct count_s g_c;
+static int g_fd = -1;
+static struct cfg_svc_s g_svc;
+
+/* A configured device: the standard keys plus hactl's and mcast's */
+
+static const char *g_kv[] =
+{
+  "wifi.ssid", "home-network",
+  "wifi.psk", "correct horse battery",
+  "ha.url", "192.168.1.100",
+  "ha.port", "8123",
+  "ha.token",
+  "eyJhbGciOiJIUzI1NiIsInR5cCI6IkpXVCJ9.eyJpc3MiOiJhYmNkZWYxMjM0NTY3ODkw"
+  "IiwiaWF0IjoxNzAwMDAwMDAwLCJleHAiOjIwMDAwMDAwMDB9.c2lnbmF0dXJlc2lnbmF0"
+  "dXJlc2lnbmF0dXJlc2lnbmF0dXJl",
+  "ha.interval", "500",
+  "ha.backend", "mqtt",
+  "ha.mqtt_port", "1883",
+  "ha.node", "mmwave_os",
+  "mmwave.uart", "/dev/ttyS1",
+  "mmwave.baud", "256000",
+  "mcast.rate", "10",
+  "boot.autostart_wifi", "1",
+  "boot.autostart_ha", "1",
+  "boot.autostart_mmwaved", "1",
+  "boot.autostart_mcast", "1",
+};
+
+#define NKV (int)(sizeof(g_kv) / sizeof(g_kv[0]) / 2)
+
+/* What rcS asks for, in order */
+
+static const char *g_boot_keys[] =
+{
+  "boot.autostart_wifi", "wifi.ssid", "wifi.psk", "boot.autostart_mmwaved",
+  "boot.autostart_ha", "ha.url", "ha.token", "boot.autostart_esphome",
+  "boot.autostart_coap", "boot.autostart_mcast", "boot.autostart_httpd",
+  "boot.autostart_stream"
+};
+
+#define NBOOT (int)(sizeof(g_boot_keys) / sizeof(g_boot_keys[0]))
+
+static void path(char *buf, const char *name)
+{
+  snprintf(buf, PATH_LEN, "%s/%s", g_dir, name);
+}
+
+static ssize_t host_read(void *priv, uint32_t off, uint8_t *buf, size_t len)
+{
+  ssize_t n = pread(g_fd, buf, len, off);
+
+  g_c.reads++;
+  g_c.read_bytes += n > 0 ? n : 0;
+  return n;
+}
+
+static int host_append(void *priv, const uint8_t *buf, size_t len)
+{
+  return write(g_fd, buf, len) == (ssize_t)len ? 0 : -EIO;
+}
+
+static int host_truncate(void *priv, uint32_t len)
+{
+  return ftruncate(g_fd, len);
+}
+
+static const struct cfg_store_io_s g_io =
+{
+  host_read, host_append, host_truncate, NULL, NULL, NULL, NULL
+};
+
+static void store_load(void)
+{
+  char p[PATH_LEN];
+
+  path(p, "config.log");
+  g_fd = open(p, O_RDWR | O_CREAT | O_APPEND, 0666);
+  g_c.opens++;
+  cfg_store_init(&g_svc.store, &g_io, 1u << 30);
+  cfg_store_load(&g_svc.store);
+}
+
+static void store_close(void)
+{
+  close(g_fd);
+  g_fd = -1;
+}
+
+/* ---- One `config get` per key, as rcS did ---- */
+
+static void before_boot(void)
+{
+  char val[CFG_VAL_MAX + 1];
+  char p[PATH_LEN];
+  char line[384];
+  FILE *f;
+
+  for (int i = 0; i < NBOOT; i++)
+    {
+      g_c.invocations++;
+      store_load();
+      cfg_store_get(&g_svc.store, g_boot_keys[i], val, sizeof(val));
+      bench_sink(val);
+      store_close();
+    }
+
+  /* hactl start: its own key=value file */
+
+  g_c.invocations++;
+  path(p, "ha.conf");
+  f = fopen(p, "r");
+  g_c.opens++;
+  while (fgets(line, sizeof(line), f) != NULL)
+    {
+      bench_sink(line);
+    }
+
+  g_c.reads += 2;                      /* The stdio buffer, then EOF */
+  g_c.read_bytes += ftell(f);
+  fclose(f);
+
+  /* mcast start: a scan of the log for two keys */
+
+  g_c.invocations++;
+  store_load();
+  cfg_store_get(&g_svc.store, "mcast.group", val, sizeof(val));
+  cfg_store_get(&g_svc.store, "mcast.rate", val, sizeof(val));
+  store_close();
+}
+
+/* ---- Load once ---- */
+
+/* The apps' reads after rcS, the same either way */
+
+static void after_apps(void)
+{
+  char val[CFG_VAL_MAX + 1];
+
+  g_c.invocations += 2;                /* hactl start, mcast start */
+  for (int i = 0; i < NKV; i++)
+    {
+      cfg_svc_get_str(&g_svc, g_kv[2 * i], val, sizeof(val), "");
+      bench_sink(val);
+    }
+
+  cfg_svc_get_int(&g_svc, "mcast.rate", 10);
+}
+
+static void after_boot(void)
+{
+  char val[CFG_VAL_MAX + 1];
+
+  store_load();                        /* Board bring-up */
+  store_close();
+
+  g_c.invocations++;                   /* config get boot.native */
+  cfg_svc_get_str(&g_svc, "boot.native", val, sizeof(val), "");
+  bench_sink(val);
+
+  after_apps();
+}
+
+static void after_boot_rcs(void)
+{
+  char line[CFG_SVC_EXPORT_MAX];
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  char *buf = NULL;
+  size_t size = 0;
+  int pos = 0;
+  FILE *out;
+
+  store_load();                        /* Board bring-up */
+  store_close();
+
+  g_c.invocations += 2;                /* config get, config export */
+  cfg_svc_get_str(&g_svc, "boot.native", val, sizeof(val), "");
+  out = open_memstream(&buf, &size);
+  while (cfg_store_next(&g_svc.store, &pos, key, val) > 0)
+    {
+      cfg_svc_export_line(key, val, line, sizeof(line));
+      fputs(line, out);
+    }
+
+  fclose(out);
+  bench_sink(buf);
+  free(buf);
+
+  after_apps();
+}
+
+static void run(const char *name, void (*boot)(void))
+{
+  memset(&g_c, 0, sizeof(g_c));
+
+  uint64_t t0 = bench_ns();
+  for (int i = 0; i < ITERS; i++)
+    {
+      boot();
+    }
+
+  uint64_t t1 = bench_ns();
+
+  printf("%-18s %12u %8u %8u %10lu %10.0f\n", name,
+         g_c.invocations / ITERS, g_c.opens / ITERS, g_c.reads / ITERS,
+         (unsigned long)(g_c.read_bytes / ITERS),
+         (double)(t1 - t0) / ITERS);
+}
+
+int main(void)
+{
+  char p[PATH_LEN];
+  FILE *f;
+
+  strcpy(g_dir, "/tmp/bench_configsvc_XXXXXX");
+  if (mkdtemp(g_dir) == NULL)
+    {
+      perror("mkdtemp");
+      return 0;
+    }
+
+  /* The same settings in config.log and, for hactl, in ha.conf */
+
+  store_load();
+  cfg_store_begin(&g_svc.store);
+  for (int i = 0; i < NKV; i++)
+    {
+      cfg_store_put(&g_svc.store, g_kv[2 * i], g_kv[2 * i + 1]);
+    }
+
+  cfg_store_commit(&g_svc.store);
+  store_close();
+
+  path(p, "ha.conf");
+  f = fopen(p, "w");
+  for (int i = 0; i < NKV; i++)
+    {
+      if (strncmp(g_kv[2 * i], "ha.", 3) == 0)
+        {
+          fprintf(f, "%s=%s\n", g_kv[2 * i] + 3, g_kv[2 * i + 1]);
+        }
+    }
+
+  fclose(f);
+
+  printf("\nsettings reads per boot (%d keys, %lu bytes in config.log)\n",
+         NKV, (unsigned long)g_svc.store.file_len);
+  printf("%-18s %12s %8s %8s %10s %10s\n", "path", "invocations",
+         "opens", "reads", "bytes", "ns/boot");
+
+  run("per invocation", before_boot);
+  run("config service", after_boot);
+  run("service, rcS", after_boot_rcs);
+
+  char cmd[96];
+
+  snprintf(cmd, sizeof(cmd), "rm -rf %s", g_dir);
+  if (system(cmd) != 0)
+    {
+      fprintf(stderr, "cannot remove %s\n", g_dir);
+    }
+
+  return 0;
+}
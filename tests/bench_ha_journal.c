@@ -0,0 +1,234 @@
+/*
+ * tests/bench_ha_journal.c
+ *
+ * Benchmark: flash traffic of journaling an HA outage, and the cost of
+ * replaying it.
+ *
+ *   per-transition — every transition written and synced on its own
+ *                    (a block of one record: what a naive append log
+ *                    costs)
+ *   batched        — ha_journal_log(): HA_JOURNAL_BATCH records per
+ *                    write, the rest at the spill deadline
+ *
+ * Both run the same outage against a RAM file that counts append()
+ * calls (each one a program and sync on the device) and bytes. Replay
+ * is then drained in batches of the REST/MQTT and WebSocket size, with
+ * the JSON each request carries. It is a benchmark, not a test: it
+ * always exits 0.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include <nuttx/semaphore.h>
+
+#include "helpers/bench.h"
+#include "apps/hactl/ha_journal.h"
+
+#define OUTAGE     1000       /* Transitions during the outage */
+#define ITERS      200000
+#define FILE_MAX   (64 * 1024)
+#define NODE       "living-room"
+
+struct ram_file_s
+{
+  uint8_t  data[FILE_MAX];
+  uint32_t len;
+};
+
+static struct ram_file_s g_file;
+
+static int ram_append(void *priv, const uint8_t *buf, size_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (f->len + len > FILE_MAX)
+    {
+      return -ENOSPC;
+    }
+
+  memcpy(f->data + f->len, buf, len);
+  f->len += len;
+  return 0;
+}
+
+static ssize_t ram_read(void *priv, uint32_t off, uint8_t *buf, size_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (off >= f->len)
+    {
+      return 0;
+    }
+
+  if (len > f->len - off)
+    {
+      len = f->len - off;
+    }
+
+  memcpy(buf, f->data + off, len);
+  return (ssize_t)len;
+}
+
+static int ram_truncate(void *priv, uint32_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (len < f->len)
+    {
+      f->len = len;
+    }
+
+  return 0;
+}
+
+static int ram_erase(void *priv)
+{
+  ((struct ram_file_s *)priv)->len = 0;
+  return 0;
+}
+
+static const struct ha_journal_io_s g_io =
+{
+  ram_append, ram_read, ram_truncate, ram_erase, &g_file
+};
+
+static struct mmwave_data_s sample(uint32_t i)
+{
+  struct mmwave_data_s d;
+
+  memset(&d, 0, sizeof(d));
+  d.target_state       = (i & 1) ? LD2410_TARGET_MOTION : LD2410_TARGET_NONE;
+  d.detection_distance = (uint16_t)(50 + i % 500);
+  return d;
+}
+
+/* One transition every gap_s seconds; the spill deadline is 60 s */
+
+static void outage(struct ha_journal_s *j, uint32_t gap_s,
+                   bool per_transition)
+{
+  for (uint32_t i = 0; i < OUTAGE; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      uint32_t now = i * gap_s * 1000;
+
+      ha_journal_log(j, &d, 1700000000 + i * gap_s, now);
+      if (per_transition)
+        {
+          ha_journal_spill(j, j->ram_count);
+        }
+      else
+        {
+          ha_journal_tick(j, now);
+        }
+    }
+}
+
+static void flash_row(const char *name, const struct ha_journal_s *j)
+{
+  uint32_t wa = ha_journal_wa_x100(&j->stats);
+
+  printf("%-28s %12lu %12lu %9lu.%02lu\n", name,
+         (unsigned long)j->stats.writes,
+         (unsigned long)j->stats.flash_bytes,
+         (unsigned long)(wa / 100), (unsigned long)(wa % 100));
+}
+
+/* Drain the journal max records per request; JSON bytes sent in total */
+
+static uint32_t replay(struct ha_journal_s *j, int max, uint32_t *reqs)
+{
+  struct ha_journal_rec_s recs[32];
+  struct json_writer_s w;
+  uint32_t bytes = 0;
+  uint32_t seq;
+  int n;
+
+  *reqs = 0;
+  while ((n = ha_journal_peek(j, recs, max, &seq)) > 0)
+    {
+      json_init(&w, json_sink_count, NULL);
+      json_begin_object(&w, NULL);
+      ha_journal_json(&w, NODE, seq, 1700020000, recs, n);
+      json_end_object(&w);
+      bytes += json_finish(&w);
+
+      ha_journal_ack(j, seq, n, 0);
+      (*reqs)++;
+    }
+
+  return bytes;
+}
+
+int main(void)
+{
+  static struct ha_journal_s j;
+  uint32_t reqs;
+  uint32_t bytes;
+
+  printf("\nHA outage journal: %d transitions\n", OUTAGE);
+  printf("%-28s %12s %12s %12s\n", "path", "writes", "flash bytes",
+         "WA");
+
+  g_file.len = 0;
+  ha_journal_init(&j, &g_io, FILE_MAX, 60000);
+  outage(&j, 2, true);
+  flash_row("per-transition", &j);
+
+  g_file.len = 0;
+  ha_journal_init(&j, &g_io, FILE_MAX, 60000);
+  outage(&j, 20, false);
+  ha_journal_sync(&j);
+  flash_row("batched, 20 s apart", &j);
+
+  g_file.len = 0;
+  ha_journal_init(&j, &g_io, FILE_MAX, 60000);
+  outage(&j, 2, false);
+  ha_journal_sync(&j);
+  flash_row("batched, 2 s apart", &j);
+
+  /* ---- Replay: requests and bytes on the wire ---- */
+
+  printf("\n%-28s %12s %12s %12s\n", "replay", "requests", "json bytes",
+         "bytes/rec");
+
+  bytes = replay(&j, 32, &reqs);
+  printf("%-28s %12lu %12lu %12.1f\n", "rest/mqtt (32 per request)",
+         (unsigned long)reqs, (unsigned long)bytes, (double)bytes / OUTAGE);
+
+  g_file.len = 0;
+  ha_journal_init(&j, &g_io, FILE_MAX, 60000);
+  outage(&j, 2, false);
+  ha_journal_sync(&j);
+
+  bytes = replay(&j, 8, &reqs);
+  printf("%-28s %12lu %12lu %12.1f\n", "ws (8 per request)",
+         (unsigned long)reqs, (unsigned long)bytes, (double)bytes / OUTAGE);
+
+  /* ---- Host cost of logging one transition ---- */
+
+  bench_header("HA journal log (per transition, RAM file)");
+
+  g_file.len = 0;
+  ha_journal_init(&j, &g_io, FILE_MAX, 60000);
+
+  uint64_t t0 = bench_ns();
+  uint64_t c0 = bench_cycles();
+  for (uint32_t i = 0; i < ITERS; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+
+      ha_journal_log(&j, &d, i, i);
+      if (g_file.len > FILE_MAX - HA_JOURNAL_BLOCK_MAX)
+        {
+          g_file.len    = 0;
+          j.file_len    = 0;
+          j.flash_count = 0;
+        }
+    }
+
+  bench_row("ha_journal_log", bench_cycles() - c0, bench_ns() - t0,
+            (uint64_t)j.stats.flash_bytes, ITERS);
+  return 0;
+}
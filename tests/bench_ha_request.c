@@ -0,0 +1,118 @@
+/*
+ * tests/bench_ha_request.c
+ *
+ * Microbenchmark: per-post cost of building the HA state request.
+ *
+ *   legacy    — snprintf the body, then snprintf headers + "%s" body into
+ *               one buffer (what ha_post_state() did before the template)
+ *   template  — headers rendered once, snprintf-free body, Content-Length
+ *               patched in place; body handed to writev() uncopied
+ *
+ * "bytes/op" counts bytes written into memory per request. It is a
+ * benchmark, not a test: it always exits 0.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "helpers/bench.h"
+#include "apps/hactl/ha_format.h"
+
+#define ITERS    200000
+#define ENTITY   "binary_sensor.mmwave_presence"
+#define HOST     "192.168.1.100"
+#define PORT     8123
+
+static char g_token[200];
+
+static struct mmwave_data_s sample(uint32_t i)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state       = (uint8_t)(i & 3);
+  d.motion_distance    = (uint16_t)(i % 600);
+  d.motion_energy      = (uint8_t)(i % 101);
+  d.static_distance    = (uint16_t)(i % 450);
+  d.static_energy      = (uint8_t)(i % 97);
+  d.detection_distance = (uint16_t)(i % 500);
+  return d;
+}
+
+/* The pre-template body builder, verbatim */
+
+static int legacy_body(char *buf, size_t len, const struct mmwave_data_s *d)
+{
+  return snprintf(buf, len,
+    "{\"state\":\"%s\","
+    "\"attributes\":{"
+    "\"friendly_name\":\"mmWave Presence\","
+    "\"device_class\":\"occupancy\","
+    "\"motion_energy\":%u,"
+    "\"static_energy\":%u,"
+    "\"motion_distance\":%u,"
+    "\"static_distance\":%u,"
+    "\"detection_distance\":%u"
+    "}}",
+    d->target_state != LD2410_TARGET_NONE ? "on" : "off",
+    d->motion_energy, d->static_energy, d->motion_distance,
+    d->static_distance, d->detection_distance);
+}
+
+int main(void)
+{
+  /* Realistic HA long-lived tokens are ~180 chars */
+
+  memset(g_token, 'a', sizeof(g_token) - 1);
+  g_token[sizeof(g_token) - 1] = '\0';
+
+  char body[256];
+  char http[1024];
+  uint64_t bytes;
+  uint64_t c0;
+  uint64_t t0;
+
+  bench_header("HA request build (per post)");
+
+  /* ---- legacy: two snprintf passes, body copied into request ---- */
+
+  bytes = 0;
+  t0 = bench_ns();
+  c0 = bench_cycles();
+  for (uint32_t i = 0; i < ITERS; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      int blen = legacy_body(body, sizeof(body), &d);
+      int hlen = ha_format_http_request(http, sizeof(http), ENTITY, HOST,
+                                        PORT, g_token, body, blen);
+      bytes += blen + hlen;
+      bench_sink(http);
+    }
+
+  bench_row("legacy (snprintf x2)", bench_cycles() - c0, bench_ns() - t0,
+            bytes, ITERS);
+
+  /* ---- template: headers once, body once, length patched ---- */
+
+  static struct ha_request_s req;
+  ha_request_init(&req, ENTITY, HOST, PORT, g_token);
+
+  bytes = 0;
+  t0 = bench_ns();
+  c0 = bench_cycles();
+  for (uint32_t i = 0; i < ITERS; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      int blen = ha_format_state_json(body, sizeof(body), &d);
+      ha_request_set_length(&req, blen);
+      bytes += blen + HA_CONTENT_LENGTH_DIGITS;
+      bench_sink(body);
+      bench_sink(req.buf);
+    }
+
+  bench_row("template + writev", bench_cycles() - c0, bench_ns() - t0,
+            bytes, ITERS);
+
+  printf("\nheader block: %u bytes rendered once at config load\n",
+         req.len);
+  return 0;
+}
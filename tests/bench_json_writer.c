@@ -0,0 +1,127 @@
+/*
+ * tests/bench_json_writer.c
+ *
+ * Microbenchmark: streaming JSON writer vs the snprintf format strings
+ * it replaced in mmwave -j and hactl.
+ *
+ *   snprintf      — one format string into a full-size stack buffer
+ *   writer/buf    — json_writer_s into the same buffer (hactl body)
+ *   writer/count  — json_writer_s into a discarding sink, i.e. the cost
+ *                   of streaming to stdout/socket without a buffer
+ *
+ * Also prints the stack each path needs for its output staging.
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "helpers/bench.h"
+#include "apps/common/json_writer.h"
+#include "apps/common/mmwave_json.h"
+
+#define ITERS  200000
+
+static struct mmwave_data_s sample(uint32_t i)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state       = (uint8_t)(i & 3);
+  d.motion_distance    = (uint16_t)(i % 600);
+  d.motion_energy      = (uint8_t)(i % 101);
+  d.static_distance    = (uint16_t)(i % 450);
+  d.static_energy      = (uint8_t)(i % 97);
+  d.detection_distance = (uint16_t)(i % 500);
+  d.timestamp_ms       = i * 100;
+  return d;
+}
+
+static int legacy_json(char *buf, size_t len, const struct mmwave_data_s *d)
+{
+  return snprintf(buf, len,
+                  "{\"state\":\"%s\","
+                  "\"motion_dist\":%u,"
+                  "\"motion_energy\":%u,"
+                  "\"static_dist\":%u,"
+                  "\"static_energy\":%u,"
+                  "\"detect_dist\":%u,"
+                  "\"timestamp\":%lu}\n",
+                  mmwave_target_str(d->target_state),
+                  d->motion_distance, d->motion_energy,
+                  d->static_distance, d->static_energy,
+                  d->detection_distance,
+                  (unsigned long)d->timestamp_ms);
+}
+
+static void writer_json(struct json_writer_s *w,
+                        const struct mmwave_data_s *d)
+{
+  json_begin_object(w, NULL);
+  json_bool(w, "presence", mmwave_json_presence(d));
+  json_str(w, "target", mmwave_target_str(d->target_state));
+  mmwave_json_fields(w, d);
+  json_uint(w, "timestamp_ms", d->timestamp_ms);
+  json_end_object(w);
+  json_char(w, '\n');
+}
+
+int main(void)
+{
+  char buf[256];
+  uint64_t bytes;
+  uint64_t c0;
+  uint64_t t0;
+
+  bench_header("mmwave reading -> JSON");
+
+  bytes = 0;
+  t0 = bench_ns();
+  c0 = bench_cycles();
+  for (uint32_t i = 0; i < ITERS; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      bytes += legacy_json(buf, sizeof(buf), &d);
+      bench_sink(buf);
+    }
+
+  bench_row("snprintf", bench_cycles() - c0, bench_ns() - t0, bytes, ITERS);
+
+  bytes = 0;
+  t0 = bench_ns();
+  c0 = bench_cycles();
+  for (uint32_t i = 0; i < ITERS; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      struct json_buf_s out = { buf, sizeof(buf), 0 };
+      struct json_writer_s w;
+
+      json_init(&w, json_sink_buf, &out);
+      writer_json(&w, &d);
+      bytes += json_finish(&w);
+      bench_sink(buf);
+    }
+
+  bench_row("writer/buf", bench_cycles() - c0, bench_ns() - t0, bytes,
+            ITERS);
+
+  bytes = 0;
+  t0 = bench_ns();
+  c0 = bench_cycles();
+  for (uint32_t i = 0; i < ITERS; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      struct json_writer_s w;
+
+      json_init(&w, json_sink_count, NULL);
+      writer_json(&w, &d);
+      bytes += json_finish(&w);
+      bench_sink(&w);
+    }
+
+  bench_row("writer/count (streamed)", bench_cycles() - c0,
+            bench_ns() - t0, bytes, ITERS);
+
+  printf("\noutput staging: snprintf buffer %zu bytes (+ vsnprintf frame), "
+         "json_writer_s %zu bytes\n", sizeof(buf),
+         sizeof(struct json_writer_s));
+  return 0;
+}
@@ -0,0 +1,125 @@
+/*
+ * tests/bench_profile_switch.c
+ *
+ * Benchmark: switching the sensor from day to night tuning, against the
+ * simulated LD2410 of tests/helpers/fake_ld2410.h.
+ *
+ *   per setting   — `mmwave -s` for each of the nine gates, then `-g`:
+ *                   a config session (enter, set, exit) per command
+ *   profile load  — one MMWAVE_IOC_APPLY_CONFIG: one session with only
+ *                   the commands that differ
+ *
+ * The sensor sends no data frames while it is in a config session, so
+ * each session is a gap in the data stream. Wire time is the UART bytes
+ * both ways at 256000 baud; "fixed waits" is what the driver slept
+ * before it waited for acks (50 ms after every command). The sensor's
+ * own turnaround is not modelled: measure it on the device with
+ * `mmwave profile load`, which prints switch time and the frame gap.
+ * It is a benchmark, not a test: it always exits 0.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "drivers/mmwave/mmwave_ld2410.c"
+#include "helpers/fake_ld2410.h"
+
+#define BAUD           256000
+#define OLD_WAIT_MS    50              /* usleep() per command, before acks */
+
+static struct mmwave_dev_s g_dev;
+
+static const struct mmwave_config_s g_day =
+{
+  8, 8, 5,
+  { 50, 50, 40, 30, 20, 15, 15, 15, 15 },
+  {  0,  0, 40, 40, 30, 30, 20, 20, 20 }
+};
+
+static const struct mmwave_config_s g_night =
+{
+  6, 6, 30,
+  { 50, 50, 40, 30, 20, 15, 15, 15, 15 },
+  {  0,  0, 20, 20, 15, 15, 10, 20, 20 }
+};
+
+static void dev_reset(void)
+{
+  memset(&g_dev, 0, sizeof(g_dev));
+  g_dev.parse_state = PARSE_HEADER;
+  nxsem_init(&g_dev.data_sem, 0, 1);
+  nxsem_init(&g_dev.cmd_sem, 0, 1);
+  nxsem_init(&g_dev.wait_sem, 0, 0);
+  g_mmwave_dev = &g_dev;
+  fake_ld2410_attach(&g_dev, &g_day);
+}
+
+static void per_setting(const struct mmwave_config_s *cfg)
+{
+  struct mmwave_sensitivity_s sens;
+  struct mmwave_maxgate_s mg;
+
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      sens.gate             = (uint8_t)g;
+      sens.motion_threshold = cfg->motion_sensitivity[g];
+      sens.static_threshold = cfg->static_sensitivity[g];
+      mmwave_ioctl(NULL, MMWAVE_IOC_SET_SENSITIVITY, (unsigned long)&sens);
+    }
+
+  mg.max_motion_gate = cfg->max_motion_gate;
+  mg.max_static_gate = cfg->max_static_gate;
+  mg.timeout_s       = cfg->timeout_s;
+  mmwave_ioctl(NULL, MMWAVE_IOC_SET_MAXGATE, (unsigned long)&mg);
+}
+
+static void profile_load(const struct mmwave_config_s *cfg)
+{
+  struct mmwave_apply_s req;
+
+  req.cfg  = *cfg;
+  req.mask = MMWAVE_APPLY_ALL;
+  mmwave_ioctl(NULL, MMWAVE_IOC_APPLY_CONFIG, (unsigned long)&req);
+}
+
+static void row(const char *name, uint32_t waits_per_cmd)
+{
+  printf("%-26s %8u %8u %6u %6u %8.2f %8u\n", name, g_fake.sessions,
+         g_fake.commands, g_fake.sets, g_fake.bytes,
+         g_fake.bytes * 10.0 * 1000.0 / BAUD,
+         g_fake.commands * waits_per_cmd);
+
+  g_fake.sessions = 0;
+  g_fake.commands = 0;
+  g_fake.sets     = 0;
+  g_fake.bytes    = 0;
+}
+
+int main(void)
+{
+  printf("\nday -> night (max gates, timeout and 5 gates differ)\n");
+  printf("%-26s %8s %8s %6s %6s %8s %8s\n", "path", "sessions",
+         "commands", "sets", "bytes", "wire ms", "waits ms");
+
+  dev_reset();
+  per_setting(&g_night);
+  row("per setting, before acks", OLD_WAIT_MS);
+  fake_ld2410_detach();
+
+  dev_reset();
+  per_setting(&g_night);
+  row("per setting", 0);
+  fake_ld2410_detach();
+
+  dev_reset();
+  profile_load(&g_night);
+  row("profile load, first", 0);
+  profile_load(&g_day);
+  row("profile load", 0);
+  profile_load(&g_day);
+  row("profile load, same again", 0);
+  fake_ld2410_detach();
+
+  return 0;
+}
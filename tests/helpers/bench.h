@@ -0,0 +1,69 @@
+/*
+ * tests/helpers/bench.h
+ *
+ * Minimal timing helpers for host-side microbenchmarks.
+ *
+ * bench_cycles() reads the CPU cycle/timer counter where one is exposed
+ * to user space and falls back to nanoseconds elsewhere, so numbers are
+ * only comparable between runs on the same machine.
+ */
+
+#ifndef __TESTS_HELPERS_BENCH_H
+#define __TESTS_HELPERS_BENCH_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#if defined(__x86_64__) || defined(__i386__)
+#  include <x86intrin.h>
+#  define BENCH_UNIT "cycles"
+#elif defined(__aarch64__)
+#  define BENCH_UNIT "ticks"
+#else
+#  define BENCH_UNIT "ns"
+#endif
+
+static inline uint64_t bench_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static inline uint64_t bench_cycles(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  uint64_t v;
+  __asm__ volatile("mrs %0, cntvct_el0" : "=r"(v));
+  return v;
+#else
+  return bench_ns();
+#endif
+}
+
+/* Keep the optimizer from discarding a benchmarked result */
+
+static inline void bench_sink(const void *p)
+{
+  __asm__ volatile("" : : "r"(p) : "memory");
+}
+
+static inline void bench_header(const char *title)
+{
+  printf("\n%s\n", title);
+  printf("%-28s %12s %12s %12s\n",
+         "path", BENCH_UNIT "/op", "ns/op", "bytes/op");
+}
+
+static inline void bench_row(const char *name, uint64_t cycles,
+                             uint64_t ns, uint64_t bytes, uint32_t iters)
+{
+  printf("%-28s %12.1f %12.1f %12.1f\n", name,
+         (double)cycles / iters, (double)ns / iters,
+         (double)bytes / iters);
+}
+
+#endif /* __TESTS_HELPERS_BENCH_H */
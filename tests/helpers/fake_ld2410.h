@@ -0,0 +1,192 @@
+/*
+ * tests/helpers/fake_ld2410.h
+ *
+ * An LD2410 at the other end of a socketpair: it answers each command
+ * the driver writes with the acknowledgement a real sensor sends, fed
+ * back through mmwave_parse_byte() and mmwave_process_ack() as the poll
+ * task would. It runs from the semaphore stub's block hook, i.e. when
+ * mmwave_command() would sleep waiting for the answer.
+ *
+ * Include it after the driver source.
+ */
+
+#ifndef __TESTS_HELPERS_FAKE_LD2410_H
+#define __TESTS_HELPERS_FAKE_LD2410_H
+
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include "helpers/frame_builder.h"
+
+struct fake_ld2410_s
+{
+  struct mmwave_dev_s *dev;
+  int      fd;                 /* Sensor end */
+  bool     config_mode;
+  struct mmwave_config_s cfg;  /* What the sensor holds */
+
+  /* Counters */
+
+  uint32_t sessions;           /* ENABLE_CONFIG */
+  uint32_t commands;           /* Every command, session ones included */
+  uint32_t sets;               /* SET_MAXGATE and SET_SENSITIVITY */
+  uint32_t bytes;              /* On the UART, both directions */
+};
+
+static struct fake_ld2410_s g_fake;
+
+static uint32_t fake_ld2410_word(const uint8_t *data, int i)
+{
+  const uint8_t *v = &data[6 * i + 2];
+
+  return (uint32_t)v[0] | (uint32_t)v[1] << 8 | (uint32_t)v[2] << 16 |
+         (uint32_t)v[3] << 24;
+}
+
+/* Body of the answer to cmd after the command word; returns its length */
+
+static int fake_ld2410_body(uint16_t cmd, const uint8_t *data,
+                            uint8_t *body)
+{
+  struct mmwave_config_s *c = &g_fake.cfg;
+  int n = 2;
+
+  body[0] = 0x00;                       /* Status: success */
+  body[1] = 0x00;
+
+  switch (cmd)
+    {
+      case LD2410_CMD_ENABLE_CONFIG:
+        g_fake.config_mode = true;
+        g_fake.sessions++;
+        body[n++] = 0x01;               /* Protocol version */
+        body[n++] = 0x00;
+        body[n++] = 0x40;               /* Buffer size */
+        body[n++] = 0x00;
+        return n;
+
+      case LD2410_CMD_DISABLE_CONFIG:
+        g_fake.config_mode = false;
+        return n;
+
+      case LD2410_CMD_READ_CONFIG:
+        body[n++] = 0xAA;
+        body[n++] = LD2410_MAX_GATES - 1;
+        body[n++] = c->max_motion_gate;
+        body[n++] = c->max_static_gate;
+        memcpy(&body[n], c->motion_sensitivity, LD2410_MAX_GATES);
+        n += LD2410_MAX_GATES;
+        memcpy(&body[n], c->static_sensitivity, LD2410_MAX_GATES);
+        n += LD2410_MAX_GATES;
+        body[n++] = (uint8_t)(c->timeout_s & 0xff);
+        body[n++] = (uint8_t)(c->timeout_s >> 8);
+        return n;
+
+      case LD2410_CMD_SET_MAXGATE:
+        g_fake.sets++;
+        c->max_motion_gate = (uint8_t)fake_ld2410_word(data, 0);
+        c->max_static_gate = (uint8_t)fake_ld2410_word(data, 1);
+        c->timeout_s       = (uint16_t)fake_ld2410_word(data, 2);
+        return n;
+
+      case LD2410_CMD_SET_SENSITIVITY:
+        {
+          uint32_t gate = fake_ld2410_word(data, 0);
+
+          g_fake.sets++;
+          if (gate < LD2410_MAX_GATES)
+            {
+              c->motion_sensitivity[gate] =
+                (uint8_t)fake_ld2410_word(data, 1);
+              c->static_sensitivity[gate] =
+                (uint8_t)fake_ld2410_word(data, 2);
+            }
+        }
+        return n;
+
+      default:
+        return n;
+    }
+}
+
+static void fake_ld2410_answer(sem_t *sem)
+{
+  uint8_t cmdbuf[FRAME_BUF_SIZE];
+  uint8_t frame[FRAME_BUF_SIZE];
+  uint8_t body[LD2410_ACK_MAX];
+  uint16_t cmd;
+  ssize_t n;
+  int blen;
+  int flen;
+
+  if (sem != &g_fake.dev->wait_sem)
+    {
+      return;
+    }
+
+  n = recv(g_fake.fd, cmdbuf, sizeof(cmdbuf), MSG_DONTWAIT);
+  if (n < 12)
+    {
+      return;
+    }
+
+  g_fake.commands++;
+  cmd = (uint16_t)(cmdbuf[6] | cmdbuf[7] << 8);
+
+  /* Outside a session the sensor ignores everything but the entry */
+
+  if (!g_fake.config_mode && cmd != LD2410_CMD_ENABLE_CONFIG)
+    {
+      g_fake.bytes += (uint32_t)n;
+      return;
+    }
+
+  blen = fake_ld2410_body(cmd, &cmdbuf[8], body);
+  flen = build_cmd_frame(frame, cmd | LD2410_ACK_FLAG, body,
+                         (uint16_t)blen);
+  g_fake.bytes += (uint32_t)(n + flen);
+
+  for (int i = 0; i < flen; i++)
+    {
+      if (mmwave_parse_byte(g_fake.dev, frame[i]))
+        {
+          mmwave_process_ack(g_fake.dev);
+        }
+    }
+}
+
+/* dev talks to the fake from now on; cfg is what the sensor holds */
+
+static int fake_ld2410_attach(struct mmwave_dev_s *dev,
+                              const struct mmwave_config_s *cfg)
+{
+  int sv[2];
+
+  if (socketpair(AF_UNIX, SOCK_SEQPACKET, 0, sv) < 0)
+    {
+      return -1;
+    }
+
+  memset(&g_fake, 0, sizeof(g_fake));
+  g_fake.dev = dev;
+  g_fake.fd  = sv[1];
+  g_fake.cfg = *cfg;
+  dev->uart_fd = sv[0];
+  g_nxsem_block_hook = fake_ld2410_answer;
+  return 0;
+}
+
+static void fake_ld2410_detach(void)
+{
+  g_nxsem_block_hook = NULL;
+  if (g_fake.dev != NULL)
+    {
+      close(g_fake.dev->uart_fd);
+      g_fake.dev->uart_fd = -1;
+    }
+
+  close(g_fake.fd);
+  memset(&g_fake, 0, sizeof(g_fake));
+}
+
+#endif /* __TESTS_HELPERS_FAKE_LD2410_H */
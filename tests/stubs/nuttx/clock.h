@@ -11,10 +11,19 @@
 #define TICK_PER_SEC 1000
 #endif
 
+#ifndef MSEC2TICK
+#define MSEC2TICK(ms) ((ms) * TICK_PER_SEC / 1000)
+#endif
+
+/* A fixed value for deterministic tests; tests that need time to pass
+ * move it themselves.
+ */
+
+static uint32_t g_stub_ticks = 12345;
+
 static inline uint32_t clock_systime_ticks(void)
 {
-  /* Return a fixed value for deterministic tests */
-  return 12345;
+  return g_stub_ticks;
 }
 
 #endif /* __NUTTX_CLOCK_H */
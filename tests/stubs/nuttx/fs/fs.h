@@ -8,6 +8,7 @@
 #include <sys/types.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <poll.h>
 
 /* Minimal file struct (never actually used in tests) */
 
@@ -33,9 +34,23 @@ struct file_operations
   int     (*ioctl)(struct file *filep, int cmd, unsigned long arg);
   int     (*mmap)(struct file *filep, void *map);
   int     (*truncate)(struct file *filep, off_t length);
-  int     (*poll)(struct file *filep, void *setup, bool teardown);
+  int     (*poll)(struct file *filep, struct pollfd *fds, bool setup);
 };
 
+/* Wake pollers: record the events on every registered pollfd */
+
+static inline void poll_notify(struct pollfd **afds, int nfds,
+                               short eventset)
+{
+  for (int i = 0; i < nfds; i++)
+    {
+      if (afds[i] != NULL && (afds[i]->events & eventset) != 0)
+        {
+          afds[i]->revents |= afds[i]->events & eventset;
+        }
+    }
+}
+
 /* Stubs for driver registration */
 
 static inline int register_driver(const char *path, const void *fops,
@@ -0,0 +1,271 @@
+/*
+ * tests/test_boot_seq.c
+ *
+ * Unit tests for the boot sequencer's dependency bookkeeping
+ * (apps/common/mmwave_boot.h): what runs first, needs against after,
+ * failures and unwanted steps, the cycle guard, and a simulated boot
+ * with typical step times against running the same steps one after
+ * another as rcS does.
+ */
+
+#include <errno.h>
+
+#include "unity/unity.h"
+
+#include "apps/common/mmwave_boot.h"
+
+/* ---- Test helpers ---- */
+
+#define ALL  ((1u << MMWAVE_BOOT_NSTEPS) - 1)
+
+static struct mmwave_boot_s g_b;
+
+/* Every step that may start now, as a bitmask */
+
+static uint32_t runnable(void)
+{
+  uint32_t bits = 0;
+  int id;
+
+  while ((id = mmwave_boot_next(&g_b)) >= 0)
+    {
+      bits |= MMWAVE_BOOT_BIT(id);
+    }
+
+  return bits;
+}
+
+void setUp(void)
+{
+  mmwave_boot_init(&g_b, g_mmwave_boot_steps, MMWAVE_BOOT_NSTEPS, ALL);
+}
+
+void tearDown(void)
+{
+}
+
+/* ---- The graph ---- */
+
+static void test_graph_covers_every_step(void)
+{
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_NSTEPS,
+                    sizeof(g_mmwave_boot_steps) /
+                    sizeof(g_mmwave_boot_steps[0]));
+  TEST_ASSERT_EQUAL_STRING("hactl",
+                           g_mmwave_boot_steps[MMWAVE_BOOT_HA].name);
+  TEST_ASSERT_TRUE(g_mmwave_boot_steps[MMWAVE_BOOT_WIFI].async);
+  TEST_ASSERT_TRUE(g_mmwave_boot_steps[MMWAVE_BOOT_DHCP].async);
+  TEST_ASSERT_FALSE(g_mmwave_boot_steps[MMWAVE_BOOT_SENSOR].async);
+}
+
+static void test_sensor_and_wifi_start_together(void)
+{
+  TEST_ASSERT_EQUAL_HEX32(MMWAVE_BOOT_BIT(MMWAVE_BOOT_SENSOR) |
+                          MMWAVE_BOOT_BIT(MMWAVE_BOOT_WIFI), runnable());
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_NSTEPS, mmwave_boot_left(&g_b));
+}
+
+static void test_listeners_do_not_wait_for_the_network(void)
+{
+  runnable();
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_SENSOR, OK);
+  TEST_ASSERT_EQUAL_HEX32(MMWAVE_BOOT_BIT(MMWAVE_BOOT_MMWAVED), runnable());
+
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_MMWAVED, OK);
+  TEST_ASSERT_EQUAL_HEX32(MMWAVE_BOOT_BIT(MMWAVE_BOOT_ESPHOME) |
+                          MMWAVE_BOOT_BIT(MMWAVE_BOOT_COAP) |
+                          MMWAVE_BOOT_BIT(MMWAVE_BOOT_HTTPD) |
+                          MMWAVE_BOOT_BIT(MMWAVE_BOOT_STREAM) |
+                          MMWAVE_BOOT_BIT(MMWAVE_BOOT_PROFILE), runnable());
+
+  /* HA and multicast wait for an address */
+
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_RUNNING, g_b.state[MMWAVE_BOOT_WIFI]);
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_PENDING, g_b.state[MMWAVE_BOOT_HA]);
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_PENDING, g_b.state[MMWAVE_BOOT_MCAST]);
+}
+
+static void test_ha_waits_for_dhcp_and_daemon(void)
+{
+  runnable();
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_WIFI, OK);
+  TEST_ASSERT_EQUAL_HEX32(MMWAVE_BOOT_BIT(MMWAVE_BOOT_DHCP), runnable());
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_DHCP, OK);
+  TEST_ASSERT_EQUAL_HEX32(0, runnable());         /* mmwaved not yet */
+
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_SENSOR, OK);
+  runnable();
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_MMWAVED, OK);
+  TEST_ASSERT_BITS(MMWAVE_BOOT_BIT(MMWAVE_BOOT_HA) |
+                   MMWAVE_BOOT_BIT(MMWAVE_BOOT_MCAST),
+                   MMWAVE_BOOT_BIT(MMWAVE_BOOT_HA) |
+                   MMWAVE_BOOT_BIT(MMWAVE_BOOT_MCAST), runnable());
+}
+
+/* ---- Failures and unwanted steps ---- */
+
+static void test_failed_need_skips_dependents_only(void)
+{
+  runnable();
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_WIFI, -ETIMEDOUT);
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_SENSOR, OK);
+
+  /* DHCP needs Wi-Fi; HA only runs after it, so it still starts */
+
+  runnable();
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_SKIPPED, g_b.state[MMWAVE_BOOT_DHCP]);
+  TEST_ASSERT_EQUAL(-ETIMEDOUT, g_b.result[MMWAVE_BOOT_WIFI]);
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_MMWAVED, -EIO);
+  TEST_ASSERT_BITS(MMWAVE_BOOT_BIT(MMWAVE_BOOT_HA),
+                   MMWAVE_BOOT_BIT(MMWAVE_BOOT_HA), runnable());
+}
+
+static void test_unwanted_steps_are_skipped(void)
+{
+  mmwave_boot_init(&g_b, g_mmwave_boot_steps, MMWAVE_BOOT_NSTEPS,
+                   MMWAVE_BOOT_BIT(MMWAVE_BOOT_SENSOR) |
+                   MMWAVE_BOOT_BIT(MMWAVE_BOOT_HA));
+
+  TEST_ASSERT_EQUAL(2, mmwave_boot_left(&g_b));
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_SENSOR, mmwave_boot_next(&g_b));
+  TEST_ASSERT_EQUAL(-1, mmwave_boot_next(&g_b));
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_SENSOR, OK);
+
+  /* No Wi-Fi, no daemon: HA starts straight after the sensor */
+
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_HA, mmwave_boot_next(&g_b));
+  mmwave_boot_finish(&g_b, MMWAVE_BOOT_HA, OK);
+  TEST_ASSERT_EQUAL(0, mmwave_boot_left(&g_b));
+}
+
+static void test_cycle_is_skipped_not_hung(void)
+{
+  static const struct mmwave_boot_step_s loop[] =
+  {
+    { "a", 0, MMWAVE_BOOT_BIT(1), false },
+    { "b", MMWAVE_BOOT_BIT(0), 0, false },
+    { "c", 0, 0, false }
+  };
+
+  mmwave_boot_init(&g_b, loop, 3, 0x7);
+  TEST_ASSERT_EQUAL(2, mmwave_boot_next(&g_b));
+  TEST_ASSERT_EQUAL(-1, mmwave_boot_next(&g_b));   /* c still running */
+  TEST_ASSERT_EQUAL(3, mmwave_boot_left(&g_b));
+
+  mmwave_boot_finish(&g_b, 2, OK);
+  TEST_ASSERT_EQUAL(-1, mmwave_boot_next(&g_b));
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_SKIPPED, g_b.state[0]);
+  TEST_ASSERT_EQUAL(MMWAVE_BOOT_SKIPPED, g_b.state[1]);
+  TEST_ASSERT_EQUAL(0, mmwave_boot_left(&g_b));
+}
+
+/* ---- A simulated boot ---- */
+
+/* Typical times in ms: inline steps run one at a time on the boot task,
+ * async ones alongside it. rcS adds a shell spawn per command.
+ */
+
+static const uint32_t g_cost[MMWAVE_BOOT_NSTEPS] =
+{
+  40, 2500, 1200, 30, 20, 15, 15, 15, 15, 15, 15
+};
+
+#define SPAWN_MS  25
+
+static uint32_t simulate(uint32_t *ha_ms)
+{
+  uint32_t end[MMWAVE_BOOT_NSTEPS];
+  uint32_t running = 0;
+  uint32_t now = 0;
+  int id;
+
+  while (mmwave_boot_left(&g_b) > 0)
+    {
+      while ((id = mmwave_boot_next(&g_b)) >= 0)
+        {
+          if (g_mmwave_boot_steps[id].async)
+            {
+              end[id] = now + g_cost[id];
+              running |= MMWAVE_BOOT_BIT(id);
+            }
+          else
+            {
+              now += g_cost[id];
+              mmwave_boot_finish(&g_b, id, OK);
+              if (id == MMWAVE_BOOT_HA)
+                {
+                  *ha_ms = now;
+                }
+            }
+        }
+
+      /* The first async step to end: its task posts the semaphore */
+
+      int first = -1;
+
+      for (id = 0; id < MMWAVE_BOOT_NSTEPS; id++)
+        {
+          if ((running & MMWAVE_BOOT_BIT(id)) &&
+              (first < 0 || end[id] < end[first]))
+            {
+              first = id;
+            }
+        }
+
+      if (first >= 0)
+        {
+          now = end[first] > now ? end[first] : now;
+          running &= ~MMWAVE_BOOT_BIT(first);
+          mmwave_boot_finish(&g_b, first, OK);
+        }
+    }
+
+  return now;
+}
+
+static void test_native_boot_reaches_ha_sooner(void)
+{
+  uint32_t serial = 0;
+  uint32_t ha_ms = 0;
+  uint32_t total;
+
+  /* rcS: every step in turn, each a builtin spawned by the shell */
+
+  for (int i = 0; i < MMWAVE_BOOT_NSTEPS; i++)
+    {
+      serial += g_cost[i] + (i == MMWAVE_BOOT_SENSOR ? 0 : SPAWN_MS);
+    }
+
+  total = simulate(&ha_ms);
+
+  /* Association and DHCP are the critical path; everything but HA and
+   * multicast is up while they run.
+   */
+
+  TEST_ASSERT_EQUAL(2500 + 1200 + 20, ha_ms);
+  TEST_ASSERT_EQUAL(2500 + 1200 + 20 + 15, total);
+  TEST_ASSERT_TRUE(total < serial);
+  TEST_ASSERT_EQUAL(0, mmwave_boot_left(&g_b));
+  for (int i = 0; i < MMWAVE_BOOT_NSTEPS; i++)
+    {
+      TEST_ASSERT_EQUAL(MMWAVE_BOOT_DONE, g_b.state[i]);
+    }
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_graph_covers_every_step);
+  RUN_TEST(test_sensor_and_wifi_start_together);
+  RUN_TEST(test_listeners_do_not_wait_for_the_network);
+  RUN_TEST(test_ha_waits_for_dhcp_and_daemon);
+
+  RUN_TEST(test_failed_need_skips_dependents_only);
+  RUN_TEST(test_unwanted_steps_are_skipped);
+  RUN_TEST(test_cycle_is_skipped_not_hung);
+
+  RUN_TEST(test_native_boot_reaches_ha_sooner);
+
+  return UNITY_END();
+}
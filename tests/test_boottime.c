@@ -0,0 +1,158 @@
+/*
+ * tests/test_boottime.c
+ *
+ * Unit tests for the boot milestone table (mmwave_ld2410.c) and its
+ * JSON (apps/common/mmwave_json.h): each milestone recorded once, the
+ * first parsed frame marking its own, the ioctls sysinfo and hactl use,
+ * and the boot_ms object of `sysinfo -j`.
+ *
+ * We #include the driver .c directly to reach the static table.
+ */
+
+#include "unity/unity.h"
+#include "helpers/frame_builder.h"
+
+#include "drivers/mmwave/mmwave_ld2410.c"
+#include "apps/common/mmwave_json.h"
+
+/* ---- Test helpers ---- */
+
+static struct mmwave_dev_s g_dev;
+
+static void feed_frame(void)
+{
+  uint8_t frame[FRAME_BUF_SIZE];
+  int len = build_data_frame(frame, LD2410_TARGET_MOTION, 150, 80, 0, 0,
+                             150);
+
+  for (int i = 0; i < len; i++)
+    {
+      if (mmwave_parse_byte(&g_dev, frame[i]))
+        {
+          memcpy(g_dev.rxbuf, frame, len);
+          g_dev.frame_len = (uint16_t)(frame[4] | frame[5] << 8);
+          mmwave_process_data_frame(&g_dev);
+        }
+    }
+}
+
+void setUp(void)
+{
+  memset(&g_dev, 0, sizeof(g_dev));
+  memset(&g_boottime, 0, sizeof(g_boottime));
+  g_dev.parse_state = PARSE_HEADER;
+  g_dev.uart_fd = -1;
+  nxsem_init(&g_dev.data_sem, 0, 1);
+  nxsem_init(&g_dev.cmd_sem, 0, 1);
+  nxsem_init(&g_dev.wait_sem, 0, 0);
+  g_mmwave_dev = &g_dev;
+  g_stub_ticks = 400;
+}
+
+void tearDown(void)
+{
+  g_mmwave_dev = NULL;
+  g_stub_ticks = 12345;
+}
+
+/* ---- The table ---- */
+
+static void test_milestone_recorded_once(void)
+{
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_MOUNT);
+  g_stub_ticks = 900;
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_MOUNT);
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_DRIVER);
+
+  TEST_ASSERT_EQUAL_UINT32(400, g_boottime.ms[MMWAVE_MILESTONE_MOUNT]);
+  TEST_ASSERT_EQUAL_UINT32(900, g_boottime.ms[MMWAVE_MILESTONE_DRIVER]);
+  TEST_ASSERT_EQUAL_UINT32(0, g_boottime.ms[MMWAVE_MILESTONE_REPORT]);
+}
+
+static void test_milestone_at_tick_zero_still_counts(void)
+{
+  g_stub_ticks = 0;
+  mmwave_ld2410_milestone(MMWAVE_MILESTONE_MOUNT);
+  TEST_ASSERT_EQUAL_UINT32(1, g_boottime.ms[MMWAVE_MILESTONE_MOUNT]);
+}
+
+static void test_bad_milestone_ignored(void)
+{
+  struct mmwave_boottime_s zero;
+
+  memset(&zero, 0, sizeof(zero));
+  mmwave_ld2410_milestone(-1);
+  mmwave_ld2410_milestone(MMWAVE_MILESTONES);
+  TEST_ASSERT_EQUAL_MEMORY(&zero, &g_boottime, sizeof(zero));
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_ioctl(NULL, MMWAVE_IOC_MILESTONE,
+                                          MMWAVE_MILESTONES));
+}
+
+static void test_first_frame_marks_milestone(void)
+{
+  feed_frame();
+  TEST_ASSERT_EQUAL_UINT32(1, g_dev.frame_seq);
+  TEST_ASSERT_EQUAL_UINT32(400, g_boottime.ms[MMWAVE_MILESTONE_FRAME]);
+
+  g_stub_ticks = 500;
+  feed_frame();
+  TEST_ASSERT_EQUAL_UINT32(2, g_dev.frame_seq);
+  TEST_ASSERT_EQUAL_UINT32(400, g_boottime.ms[MMWAVE_MILESTONE_FRAME]);
+}
+
+/* ---- Through the device, as sysinfo and hactl see it ---- */
+
+static void test_ioctl_mark_and_read(void)
+{
+  struct mmwave_boottime_s bt;
+
+  g_stub_ticks = 3790;
+  TEST_ASSERT_EQUAL(OK, mmwave_ioctl(NULL, MMWAVE_IOC_MILESTONE,
+                                     MMWAVE_MILESTONE_REPORT));
+
+  memset(&bt, 0xff, sizeof(bt));
+  TEST_ASSERT_EQUAL(OK, mmwave_ioctl(NULL, MMWAVE_IOC_GET_BOOTTIME,
+                                     (unsigned long)&bt));
+  TEST_ASSERT_EQUAL_UINT32(3790, bt.ms[MMWAVE_MILESTONE_REPORT]);
+  TEST_ASSERT_EQUAL_UINT32(0, bt.ms[MMWAVE_MILESTONE_WIFI]);
+}
+
+static void test_json_lists_reached_milestones(void)
+{
+  struct mmwave_boottime_s bt;
+  struct json_writer_s w;
+  struct json_buf_s out;
+  char buf[160];
+
+  memset(&bt, 0, sizeof(bt));
+  bt.ms[MMWAVE_MILESTONE_MOUNT]  = 412;
+  bt.ms[MMWAVE_MILESTONE_FRAME]  = 530;
+  bt.ms[MMWAVE_MILESTONE_REPORT] = 3790;
+
+  out.buf  = buf;
+  out.size = sizeof(buf);
+  out.len  = 0;
+  json_init(&w, json_sink_buf, &out);
+  json_begin_object(&w, NULL);
+  mmwave_json_boottime(&w, &bt);
+  json_end_object(&w);
+  TEST_ASSERT_GREATER_OR_EQUAL_INT(0, json_finish_buf(&w, &out));
+
+  TEST_ASSERT_EQUAL_STRING("{\"boot_ms\":{\"mount\":412,\"first_frame\":530,"
+                           "\"first_report\":3790}}", buf);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_milestone_recorded_once);
+  RUN_TEST(test_milestone_at_tick_zero_still_counts);
+  RUN_TEST(test_bad_milestone_ignored);
+  RUN_TEST(test_first_frame_marks_milestone);
+
+  RUN_TEST(test_ioctl_mark_and_read);
+  RUN_TEST(test_json_lists_reached_milestones);
+
+  return UNITY_END();
+}
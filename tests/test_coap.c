@@ -0,0 +1,618 @@
+/*
+ * tests/test_coap.c
+ *
+ * Unit tests for the CoAP server (apps/coap/coap.h): message parsing and
+ * building, request handling, and Observe registration, filtering,
+ * CON/NON notification and observer eviction. The socket is replaced by
+ * a capture callback and time is driven by the tests.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/coap/coap.h"
+
+/* ---- Test helpers ---- */
+
+#define CLIENT_A   0x0100007f    /* 127.0.0.1, network order on LE */
+#define CLIENT_B   0x0200007f
+#define PORT_A     0x3930
+
+static struct coap_server_s srv;
+static uint8_t req_buf[COAP_MSG_MAX];
+
+static uint8_t last[COAP_MSG_MAX];
+static size_t last_len;
+static uint32_t last_addr;
+static int nsent;
+
+static int capture(void *arg, uint32_t addr, uint16_t port,
+                   const uint8_t *buf, size_t len)
+{
+  memcpy(last, buf, len);
+  last_len  = len;
+  last_addr = addr;
+  nsent++;
+  return (int)len;
+}
+
+/* Parse the last datagram the server sent */
+
+static struct coap_msg_s reply(void)
+{
+  struct coap_msg_s m;
+
+  TEST_ASSERT_EQUAL_INT(0, coap_parse(last, last_len, &m));
+  return m;
+}
+
+static const char *reply_payload(void)
+{
+  static char s[COAP_MSG_MAX];
+  struct coap_msg_s m = reply();
+
+  memcpy(s, m.payload, m.payload_len);
+  s[m.payload_len] = '\0';
+  return s;
+}
+
+/* Content-Format of the last datagram, or -1 */
+
+static int reply_format(void)
+{
+  const uint8_t *p = last + 4 + (last[0] & 0x0f);
+  int opt = 0;
+
+  while (p < last + last_len && *p != 0xff)
+    {
+      opt += *p >> 4;
+      if (opt == COAP_OPT_CONTENT_FORMAT)
+        {
+          return (int)coap_uint(p + 1, *p & 0x0f);
+        }
+
+      p += 1 + (*p & 0x0f);
+    }
+
+  return -1;
+}
+
+/* Build a request: path segments split on '/', observe/accept < 0 omit */
+
+static size_t request(uint8_t type, uint8_t code, uint16_t mid,
+                      const char *path, int32_t observe, int32_t accept)
+{
+  static const uint8_t tok[] = { 0xca, 0xfe };
+  struct coap_out_s o;
+
+  coap_out_init(&o, req_buf, sizeof(req_buf), type, code, mid, tok,
+                sizeof(tok));
+  if (observe >= 0)
+    {
+      coap_put_uint_option(&o, COAP_OPT_OBSERVE, (uint32_t)observe);
+    }
+
+  while (path != NULL && *path != '\0')
+    {
+      const char *slash = strchr(path, '/');
+      size_t n = slash ? (size_t)(slash - path) : strlen(path);
+
+      coap_put_option(&o, COAP_OPT_URI_PATH, (const uint8_t *)path, n);
+      path = slash ? slash + 1 : NULL;
+    }
+
+  if (accept >= 0)
+    {
+      coap_put_uint_option(&o, COAP_OPT_ACCEPT, (uint32_t)accept);
+    }
+
+  TEST_ASSERT_EQUAL_INT(0, o.error);
+  return o.len;
+}
+
+static void get(uint32_t addr, uint8_t type, uint16_t mid, const char *path,
+                int32_t observe)
+{
+  size_t n = request(type, COAP_GET, mid, path, observe, -1);
+
+  TEST_ASSERT_EQUAL_INT(0, coap_server_input(&srv, addr, PORT_A, req_buf,
+                                             n, 0));
+}
+
+static struct mmwave_eng_data_s reading(uint8_t state, uint16_t dist)
+{
+  struct mmwave_eng_data_s e;
+
+  memset(&e, 0, sizeof(e));
+  e.basic.target_state       = state;
+  e.basic.motion_energy      = 60;
+  e.basic.static_energy      = 30;
+  e.basic.motion_distance    = dist;
+  e.basic.static_distance    = dist;
+  e.basic.detection_distance = dist;
+  e.basic.timestamp_ms       = 1000;
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      e.motion_gate_energy[i] = (uint8_t)(10 * i);
+      e.static_gate_energy[i] = (uint8_t)(5 * i);
+    }
+
+  return e;
+}
+
+static void update(uint8_t state, uint16_t dist)
+{
+  struct mmwave_eng_data_s e = reading(state, dist);
+
+  coap_server_update(&srv, &e, true);
+}
+
+static void send_empty(uint8_t type, uint16_t mid)
+{
+  uint8_t b[4] = { COAP_VERSION << 6 | type << 4, 0, mid >> 8, mid & 0xff };
+
+  TEST_ASSERT_EQUAL_INT(0, coap_server_input(&srv, CLIENT_A, PORT_A, b,
+                                             4, 0));
+}
+
+void setUp(void)
+{
+  coap_server_init(&srv, capture, NULL, 0x100);
+  update(LD2410_TARGET_MOTION, 150);
+  nsent    = 0;
+  last_len = 0;
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Codec
+ * ================================================================ */
+
+void test_parse_observe_get(void)
+{
+  const uint8_t b[] =
+  {
+    0x42, 0x01, 0x12, 0x34, 0xab, 0xcd,       /* CON GET, TKL 2 */
+    0x60,                                     /* Observe: 0 (empty) */
+    0x58, 'p', 'r', 'e', 's', 'e', 'n', 'c', 'e'
+  };
+  struct coap_msg_s m;
+
+  TEST_ASSERT_EQUAL_INT(0, coap_parse(b, sizeof(b), &m));
+  TEST_ASSERT_EQUAL_UINT8(COAP_CON, m.type);
+  TEST_ASSERT_EQUAL_UINT8(COAP_GET, m.code);
+  TEST_ASSERT_EQUAL_HEX16(0x1234, m.mid);
+  TEST_ASSERT_EQUAL_UINT8(2, m.tkl);
+  TEST_ASSERT_EQUAL_HEX8(0xcd, m.token[1]);
+  TEST_ASSERT_EQUAL_INT32(0, m.observe);
+  TEST_ASSERT_EQUAL_STRING("presence", m.path);
+  TEST_ASSERT_EQUAL_INT32(-1, m.accept);
+  TEST_ASSERT_FALSE(m.bad_option);
+}
+
+void test_parse_extended_delta_and_payload(void)
+{
+  const uint8_t b[] =
+  {
+    0x50, 0x01, 0x00, 0x01,                   /* NON GET, no token */
+    0xd1, 0x04, 0x32,                         /* Accept (17): 50 */
+    0xff, 'x'
+  };
+  struct coap_msg_s m;
+
+  TEST_ASSERT_EQUAL_INT(0, coap_parse(b, sizeof(b), &m));
+  TEST_ASSERT_EQUAL_INT32(COAP_CF_JSON, m.accept);
+  TEST_ASSERT_EQUAL_size_t(1, m.payload_len);
+  TEST_ASSERT_EQUAL_UINT8('x', m.payload[0]);
+}
+
+void test_parse_rejects_malformed(void)
+{
+  const uint8_t v2[]     = { 0x80, 0x01, 0x00, 0x01 };
+  const uint8_t tkl9[]   = { 0x49, 0x01, 0x00, 0x01, 1, 2, 3, 4, 5, 6, 7, 8,
+                             9 };
+  const uint8_t marker[] = { 0x40, 0x01, 0x00, 0x01, 0xff };
+  const uint8_t optlen[] = { 0x40, 0x01, 0x00, 0x01, 0xb4, 'a' };
+  const uint8_t ping[]   = { 0x40, 0x00, 0x00, 0x01, 0x60 };
+  struct coap_msg_s m;
+
+  TEST_ASSERT_EQUAL_INT(-1, coap_parse(v2, 3, &m));
+  TEST_ASSERT_EQUAL_INT(-1, coap_parse(v2, sizeof(v2), &m));
+  TEST_ASSERT_EQUAL_INT(-1, coap_parse(tkl9, sizeof(tkl9), &m));
+  TEST_ASSERT_EQUAL_INT(-1, coap_parse(marker, sizeof(marker), &m));
+  TEST_ASSERT_EQUAL_INT(-1, coap_parse(optlen, sizeof(optlen), &m));
+  TEST_ASSERT_EQUAL_INT(-1, coap_parse(ping, sizeof(ping), &m));
+}
+
+void test_parse_flags_unknown_critical_option(void)
+{
+  const uint8_t critical[] = { 0x40, 0x01, 0x00, 0x01, 0x90 };  /* 9 */
+  const uint8_t elective[] = { 0x40, 0x01, 0x00, 0x01, 0xd0, 0x0f };  /* 28 */
+  struct coap_msg_s m;
+
+  TEST_ASSERT_EQUAL_INT(0, coap_parse(critical, sizeof(critical), &m));
+  TEST_ASSERT_TRUE(m.bad_option);
+  TEST_ASSERT_EQUAL_INT(0, coap_parse(elective, sizeof(elective), &m));
+  TEST_ASSERT_FALSE(m.bad_option);
+}
+
+void test_uint_option_minimal_length(void)
+{
+  const uint8_t want[] =
+  {
+    0x50, 0x45, 0x00, 0x07,
+    0x60,                                     /* Observe: 0 */
+    0x61, 0x32,                               /* Content-Format: 50 */
+    0x52, 0x01, 0x2c                          /* Accept: 300 */
+  };
+  uint8_t b[16];
+  struct coap_out_s o;
+
+  coap_out_init(&o, b, sizeof(b), COAP_NON, COAP_CONTENT, 7, NULL, 0);
+  coap_put_uint_option(&o, COAP_OPT_OBSERVE, 0);
+  coap_put_uint_option(&o, COAP_OPT_CONTENT_FORMAT, COAP_CF_JSON);
+  coap_put_uint_option(&o, COAP_OPT_ACCEPT, 300);
+  TEST_ASSERT_EQUAL_INT(0, o.error);
+  TEST_ASSERT_EQUAL_size_t(sizeof(want), o.len);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(want, b, sizeof(want));
+}
+
+/* ================================================================
+ * Requests
+ * ================================================================ */
+
+void test_get_presence_piggybacked(void)
+{
+  struct coap_msg_s m;
+
+  get(CLIENT_A, COAP_CON, 0x4242, "presence", -1);
+  m = reply();
+  TEST_ASSERT_EQUAL_INT(1, nsent);
+  TEST_ASSERT_EQUAL_UINT8(COAP_ACK, m.type);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, m.code);
+  TEST_ASSERT_EQUAL_HEX16(0x4242, m.mid);
+  TEST_ASSERT_EQUAL_UINT8(2, m.tkl);
+  TEST_ASSERT_EQUAL_HEX8(0xfe, m.token[1]);
+  TEST_ASSERT_EQUAL_INT32(-1, m.observe);
+  TEST_ASSERT_EQUAL_INT(COAP_CF_JSON, reply_format());
+  TEST_ASSERT_EQUAL_STRING("{\"presence\":true,\"target\":\"motion\","
+                           "\"ts\":1000}", reply_payload());
+}
+
+void test_non_request_gets_non_response(void)
+{
+  struct coap_msg_s m;
+
+  get(CLIENT_A, COAP_NON, 0x4242, "distance", -1);
+  m = reply();
+  TEST_ASSERT_EQUAL_UINT8(COAP_NON, m.type);
+  TEST_ASSERT_EQUAL_HEX16(0x100, m.mid);
+  TEST_ASSERT_EQUAL_STRING("{\"motion_energy\":60,\"static_energy\":30,"
+                           "\"motion_distance\":150,"
+                           "\"static_distance\":150,"
+                           "\"detection_distance\":150,\"ts\":1000}",
+                           reply_payload());
+}
+
+void test_error_codes(void)
+{
+  size_t n;
+
+  get(CLIENT_A, COAP_CON, 1, "nope", -1);
+  TEST_ASSERT_EQUAL_UINT8(COAP_NOT_FOUND, reply().code);
+  TEST_ASSERT_EQUAL_size_t(6, last_len);
+
+  n = request(COAP_CON, COAP_CODE(0, 2), 2, "presence", -1, -1);
+  coap_server_input(&srv, CLIENT_A, PORT_A, req_buf, n, 0);
+  TEST_ASSERT_EQUAL_UINT8(COAP_NOT_ALLOWED, reply().code);
+
+  n = request(COAP_CON, COAP_GET, 3, "presence", -1, COAP_CF_TEXT);
+  coap_server_input(&srv, CLIENT_A, PORT_A, req_buf, n, 0);
+  TEST_ASSERT_EQUAL_UINT8(COAP_NOT_ACCEPTABLE, reply().code);
+
+  n = request(COAP_CON, COAP_GET, 4, "presence", -1, COAP_CF_JSON);
+  coap_server_input(&srv, CLIENT_A, PORT_A, req_buf, n, 0);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, reply().code);
+
+  n = request(COAP_CON, COAP_GET, 5, "presence", -1, -1);
+  req_buf[n++] = 0xa0;       /* Option 11 + 10 = 21: critical, unknown */
+  coap_server_input(&srv, CLIENT_A, PORT_A, req_buf, n, 0);
+  TEST_ASSERT_EQUAL_UINT8(COAP_BAD_OPTION, reply().code);
+  TEST_ASSERT_EQUAL_UINT32(5, srv.stats.requests);
+}
+
+void test_well_known_core(void)
+{
+  get(CLIENT_A, COAP_CON, 1, ".well-known/core", -1);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, reply().code);
+  TEST_ASSERT_EQUAL_INT(COAP_CF_LINK, reply_format());
+  TEST_ASSERT_EQUAL_STRING(COAP_CORE_LINKS, reply_payload());
+}
+
+void test_ping_answered_with_rst(void)
+{
+  struct coap_msg_s m;
+
+  send_empty(COAP_CON, 0x7777);
+  m = reply();
+  TEST_ASSERT_EQUAL_UINT8(COAP_RST, m.type);
+  TEST_ASSERT_EQUAL_UINT8(COAP_EMPTY, m.code);
+  TEST_ASSERT_EQUAL_HEX16(0x7777, m.mid);
+  TEST_ASSERT_EQUAL_UINT32(0, srv.stats.requests);
+}
+
+void test_gates_need_engineering_mode(void)
+{
+  struct mmwave_eng_data_s e = reading(LD2410_TARGET_STATIC, 100);
+
+  coap_server_update(&srv, &e, false);
+  get(CLIENT_A, COAP_CON, 1, "gates", COAP_OBSERVE_REGISTER);
+  TEST_ASSERT_EQUAL_UINT8(COAP_UNAVAILABLE, reply().code);
+  TEST_ASSERT_EQUAL_INT32(-1, reply().observe);
+  TEST_ASSERT_EQUAL_STRING("engineering mode off", reply_payload());
+  TEST_ASSERT_EQUAL_INT(0, coap_observer_count(&srv));
+
+  coap_server_update(&srv, &e, true);
+  get(CLIENT_A, COAP_CON, 2, "gates", -1);
+  TEST_ASSERT_EQUAL_STRING("{\"motion\":[0,10,20,30,40,50,60,70,80],"
+                           "\"static\":[0,5,10,15,20,25,30,35,40],"
+                           "\"ts\":1000}", reply_payload());
+}
+
+void test_no_data_yet_unavailable(void)
+{
+  coap_server_init(&srv, capture, NULL, 1);
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+  TEST_ASSERT_EQUAL_UINT8(COAP_UNAVAILABLE, reply().code);
+  TEST_ASSERT_EQUAL_INT(0, coap_observer_count(&srv));
+}
+
+/* ================================================================
+ * Observe
+ * ================================================================ */
+
+void test_register_returns_observe_option(void)
+{
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, reply().code);
+  TEST_ASSERT_EQUAL_INT32(0, reply().observe);
+  TEST_ASSERT_EQUAL_INT(1, coap_observer_count(&srv));
+
+  /* Re-registering from the same endpoint reuses the slot */
+
+  get(CLIENT_A, COAP_CON, 2, "presence", COAP_OBSERVE_REGISTER);
+  TEST_ASSERT_EQUAL_INT(1, coap_observer_count(&srv));
+}
+
+void test_presence_notifies_on_state_change_only(void)
+{
+  struct coap_msg_s m;
+
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+  nsent = 0;
+
+  update(LD2410_TARGET_MOTION, 400);
+  TEST_ASSERT_EQUAL_INT(0, coap_server_tick(&srv, 100));
+  TEST_ASSERT_EQUAL_INT(0, nsent);
+
+  update(LD2410_TARGET_NONE, 0);
+  TEST_ASSERT_EQUAL_INT(1, coap_server_tick(&srv, 200));
+  m = reply();
+  TEST_ASSERT_EQUAL_UINT8(COAP_NON, m.type);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, m.code);
+  TEST_ASSERT_EQUAL_HEX8(0xca, m.token[0]);
+  TEST_ASSERT_EQUAL_INT32(1, m.observe);
+  TEST_ASSERT_EQUAL_STRING("{\"presence\":false,\"target\":\"none\","
+                           "\"ts\":1000}", reply_payload());
+
+  /* Nothing new: nothing sent */
+
+  TEST_ASSERT_EQUAL_INT(0, coap_server_tick(&srv, 300));
+  TEST_ASSERT_EQUAL_INT(1, nsent);
+}
+
+void test_distance_deadband(void)
+{
+  get(CLIENT_A, COAP_CON, 1, "distance", COAP_OBSERVE_REGISTER);
+  nsent = 0;
+
+  update(LD2410_TARGET_MOTION, 150 + COAP_DISTANCE_STEP_CM - 1);
+  TEST_ASSERT_EQUAL_INT(0, coap_server_tick(&srv, 100));
+
+  /* The deadband is against what was last sent, so drift accumulates */
+
+  update(LD2410_TARGET_MOTION, 150 + COAP_DISTANCE_STEP_CM);
+  TEST_ASSERT_EQUAL_INT(1, coap_server_tick(&srv, 200));
+  update(LD2410_TARGET_MOTION, 150 + COAP_DISTANCE_STEP_CM + 5);
+  TEST_ASSERT_EQUAL_INT(0, coap_server_tick(&srv, 300));
+}
+
+void test_gates_deadband(void)
+{
+  struct mmwave_eng_data_s e = reading(LD2410_TARGET_MOTION, 150);
+
+  get(CLIENT_A, COAP_CON, 1, "gates", COAP_OBSERVE_REGISTER);
+
+  e.static_gate_energy[8] += COAP_GATE_STEP - 1;
+  coap_server_update(&srv, &e, true);
+  TEST_ASSERT_EQUAL_INT(0, coap_server_tick(&srv, 100));
+
+  e.static_gate_energy[8] += 1;
+  coap_server_update(&srv, &e, true);
+  TEST_ASSERT_EQUAL_INT(1, coap_server_tick(&srv, 200));
+}
+
+void test_observers_get_own_tokens_and_rising_seq(void)
+{
+  struct coap_msg_s m;
+  int32_t seq;
+
+  get(CLIENT_A, COAP_NON, 1, "presence", COAP_OBSERVE_REGISTER);
+  get(CLIENT_B, COAP_NON, 1, "distance", COAP_OBSERVE_REGISTER);
+  TEST_ASSERT_EQUAL_INT(2, coap_observer_count(&srv));
+
+  update(LD2410_TARGET_STATIC, 300);
+  TEST_ASSERT_EQUAL_INT(2, coap_server_tick(&srv, 100));
+  TEST_ASSERT_EQUAL_HEX32(CLIENT_B, last_addr);
+  seq = reply().observe;
+
+  update(LD2410_TARGET_NONE, 0);
+  coap_server_tick(&srv, 200);
+  m = reply();
+  TEST_ASSERT_TRUE(m.observe > seq);
+}
+
+void test_cancel_with_observe_one(void)
+{
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+  get(CLIENT_A, COAP_CON, 2, "presence", COAP_OBSERVE_CANCEL);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, reply().code);
+  TEST_ASSERT_EQUAL_INT32(-1, reply().observe);
+  TEST_ASSERT_EQUAL_INT(0, coap_observer_count(&srv));
+}
+
+void test_rst_to_notification_evicts(void)
+{
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+  update(LD2410_TARGET_NONE, 0);
+  coap_server_tick(&srv, 100);
+
+  send_empty(COAP_RST, 0x1234);             /* Not ours */
+  TEST_ASSERT_EQUAL_INT(1, coap_observer_count(&srv));
+  send_empty(COAP_RST, reply().mid);
+  TEST_ASSERT_EQUAL_INT(0, coap_observer_count(&srv));
+  TEST_ASSERT_EQUAL_UINT32(1, srv.stats.evicted);
+}
+
+void test_full_table_serves_without_observe(void)
+{
+  for (int i = 0; i < CONFIG_COAP_MAX_OBSERVERS; i++)
+    {
+      get(CLIENT_A + ((uint32_t)i << 24), COAP_CON, 1, "presence",
+          COAP_OBSERVE_REGISTER);
+    }
+
+  get(CLIENT_B + 0x40000000, COAP_CON, 1, "presence",
+      COAP_OBSERVE_REGISTER);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CONTENT, reply().code);
+  TEST_ASSERT_EQUAL_INT32(-1, reply().observe);
+  TEST_ASSERT_EQUAL_UINT32(1, srv.stats.table_full);
+  TEST_ASSERT_EQUAL_INT(CONFIG_COAP_MAX_OBSERVERS, coap_observer_count(&srv));
+}
+
+void test_periodic_con_and_ack(void)
+{
+  int con = 0;
+
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+
+  for (int i = 1; i <= COAP_CON_EVERY; i++)
+    {
+      update(i & 1 ? LD2410_TARGET_NONE : LD2410_TARGET_MOTION, 100);
+      TEST_ASSERT_EQUAL_INT(1, coap_server_tick(&srv, (uint32_t)i * 10));
+      if (reply().type == COAP_CON)
+        {
+          con = i;
+          send_empty(COAP_ACK, reply().mid);
+        }
+    }
+
+  TEST_ASSERT_EQUAL_INT(COAP_CON_EVERY, con);
+  TEST_ASSERT_FALSE(srv.obs[0].pending);
+
+  /* A quiet minute forces the next notification to CON as well */
+
+  update(LD2410_TARGET_STATIC, 100);
+  coap_server_tick(&srv, COAP_CON_EVERY * 10 + COAP_CON_INTERVAL_MS);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CON, reply().type);
+}
+
+void test_unacked_con_retransmitted_then_evicted(void)
+{
+  uint32_t now = COAP_CON_INTERVAL_MS;
+  uint16_t mid;
+
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+  update(LD2410_TARGET_NONE, 0);
+  coap_server_tick(&srv, now);
+  TEST_ASSERT_EQUAL_UINT8(COAP_CON, reply().type);
+  mid   = reply().mid;
+  nsent = 0;
+
+  /* Backoff doubles: 2 s, 4 s, 8 s, 16 s; each resend has a new MID
+   * and the current state.
+   */
+
+  for (uint32_t t = COAP_ACK_TIMEOUT_MS, i = 0; i < COAP_MAX_RETRANSMIT;
+       i++, t *= 2)
+    {
+      TEST_ASSERT_EQUAL_INT(0, coap_server_tick(&srv, now + t - 1));
+      now += t;
+      TEST_ASSERT_EQUAL_INT(1, coap_server_tick(&srv, now));
+      TEST_ASSERT_EQUAL_UINT8(COAP_CON, reply().type);
+      TEST_ASSERT_NOT_EQUAL(mid, reply().mid);
+      mid = reply().mid;
+    }
+
+  TEST_ASSERT_EQUAL_INT(COAP_MAX_RETRANSMIT, nsent);
+  TEST_ASSERT_EQUAL_UINT32(COAP_MAX_RETRANSMIT, srv.stats.retransmits);
+
+  coap_server_tick(&srv, now + COAP_ACK_TIMEOUT_MS * 16);
+  TEST_ASSERT_EQUAL_INT(0, coap_observer_count(&srv));
+  TEST_ASSERT_EQUAL_UINT32(1, srv.stats.evicted);
+}
+
+void test_late_ack_for_resend_clears_pending(void)
+{
+  get(CLIENT_A, COAP_CON, 1, "presence", COAP_OBSERVE_REGISTER);
+  update(LD2410_TARGET_NONE, 0);
+  coap_server_tick(&srv, COAP_CON_INTERVAL_MS);
+  coap_server_tick(&srv, COAP_CON_INTERVAL_MS + COAP_ACK_TIMEOUT_MS);
+  TEST_ASSERT_TRUE(srv.obs[0].pending);
+
+  send_empty(COAP_ACK, reply().mid);
+  TEST_ASSERT_FALSE(srv.obs[0].pending);
+  TEST_ASSERT_EQUAL_INT(1, coap_observer_count(&srv));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Codec */
+  RUN_TEST(test_parse_observe_get);
+  RUN_TEST(test_parse_extended_delta_and_payload);
+  RUN_TEST(test_parse_rejects_malformed);
+  RUN_TEST(test_parse_flags_unknown_critical_option);
+  RUN_TEST(test_uint_option_minimal_length);
+
+  /* Requests */
+  RUN_TEST(test_get_presence_piggybacked);
+  RUN_TEST(test_non_request_gets_non_response);
+  RUN_TEST(test_error_codes);
+  RUN_TEST(test_well_known_core);
+  RUN_TEST(test_ping_answered_with_rst);
+  RUN_TEST(test_gates_need_engineering_mode);
+  RUN_TEST(test_no_data_yet_unavailable);
+
+  /* Observe */
+  RUN_TEST(test_register_returns_observe_option);
+  RUN_TEST(test_presence_notifies_on_state_change_only);
+  RUN_TEST(test_distance_deadband);
+  RUN_TEST(test_gates_deadband);
+  RUN_TEST(test_observers_get_own_tokens_and_rising_seq);
+  RUN_TEST(test_cancel_with_observe_one);
+  RUN_TEST(test_rst_to_notification_evicts);
+  RUN_TEST(test_full_table_serves_without_observe);
+  RUN_TEST(test_periodic_con_and_ack);
+  RUN_TEST(test_unacked_con_retransmitted_then_evicted);
+  RUN_TEST(test_late_ack_for_resend_clears_pending);
+
+  return UNITY_END();
+}
@@ -0,0 +1,559 @@
+/*
+ * tests/test_config_store.c
+ *
+ * Unit tests for the log-structured config store
+ * (apps/config/config_store.h): gets and sets through the RAM index,
+ * transactions as one append, picking the file up again (torn and
+ * corrupt blocks, read errors), keys named by number, the key limit
+ * and RAM arena reuse, compaction and its failure, and walking the
+ * keys. The file is a RAM buffer that counts writes and can be made to
+ * fail.
+ */
+
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "apps/config/config_store.h"
+
+/* ---- Test helpers ---- */
+
+#define FILE_MAX     4096
+#define COMPACT_MIN  256
+
+struct ram_file_s
+{
+  uint8_t  data[FILE_MAX];
+  uint32_t len;
+  uint8_t  next[FILE_MAX];     /* File being written by a compaction */
+  uint32_t next_len;
+  int      fail_append;        /* Next append fails after this many bytes */
+  bool     fail_read;
+  bool     fail_rewrite;
+};
+
+static struct ram_file_s g_file;
+static struct cfg_store_s g_s;
+static char g_val[CFG_VAL_MAX + 1];
+
+static ssize_t ram_read(void *priv, uint32_t off, uint8_t *buf, size_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (f->fail_read)
+    {
+      return -EIO;
+    }
+
+  if (off >= f->len)
+    {
+      return 0;
+    }
+
+  if (len > f->len - off)
+    {
+      len = f->len - off;
+    }
+
+  memcpy(buf, f->data + off, len);
+  return (ssize_t)len;
+}
+
+static int ram_append(void *priv, const uint8_t *buf, size_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (f->fail_append >= 0)
+    {
+      size_t n = (size_t)f->fail_append < len ? (size_t)f->fail_append : len;
+
+      memcpy(f->data + f->len, buf, n);
+      f->len += n;
+      f->fail_append = -1;
+      return -EIO;
+    }
+
+  if (f->len + len > FILE_MAX)
+    {
+      return -ENOSPC;
+    }
+
+  memcpy(f->data + f->len, buf, len);
+  f->len += len;
+  return 0;
+}
+
+static int ram_truncate(void *priv, uint32_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (len < f->len)
+    {
+      f->len = len;
+    }
+
+  return 0;
+}
+
+static int ram_rewrite_begin(void *priv)
+{
+  ((struct ram_file_s *)priv)->next_len = 0;
+  return 0;
+}
+
+static int ram_rewrite_write(void *priv, const uint8_t *buf, size_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (f->fail_rewrite)
+    {
+      return -ENOSPC;
+    }
+
+  memcpy(f->next + f->next_len, buf, len);
+  f->next_len += len;
+  return 0;
+}
+
+static int ram_rewrite_end(void *priv, bool commit)
+{
+  struct ram_file_s *f = priv;
+
+  if (commit)
+    {
+      memcpy(f->data, f->next, f->next_len);
+      f->len = f->next_len;
+    }
+
+  return 0;
+}
+
+static const struct cfg_store_io_s g_io =
+{
+  ram_read, ram_append, ram_truncate,
+  ram_rewrite_begin, ram_rewrite_write, ram_rewrite_end, &g_file
+};
+
+/* Simulate a reboot: fresh index over the same file */
+
+static int reboot(void)
+{
+  cfg_store_init(&g_s, &g_io, COMPACT_MIN);
+  return cfg_store_load(&g_s);
+}
+
+static const char *get(const char *key)
+{
+  return cfg_store_get(&g_s, key, g_val, sizeof(g_val)) >= 0 ?
+         g_val : NULL;
+}
+
+void setUp(void)
+{
+  memset(&g_file, 0, sizeof(g_file));
+  g_file.fail_append = -1;
+  cfg_store_init(&g_s, &g_io, COMPACT_MIN);
+  cfg_store_load(&g_s);
+}
+
+void tearDown(void) {}
+
+/* ---- Gets and sets ---- */
+
+static void test_set_then_get(void)
+{
+  TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, "wifi.ssid", "home"));
+  TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, "ha.port", ""));
+
+  TEST_ASSERT_EQUAL_STRING("home", get("wifi.ssid"));
+  TEST_ASSERT_EQUAL_STRING("", get("ha.port"));
+  TEST_ASSERT_NULL(get("wifi.psk"));
+  TEST_ASSERT_EQUAL(2, g_s.keys);
+}
+
+static void test_overwrite_and_delete(void)
+{
+  cfg_store_set(&g_s, "ha.url", "10.0.0.1");
+  cfg_store_set(&g_s, "ha.url", "homeassistant.local");
+
+  TEST_ASSERT_EQUAL_STRING("homeassistant.local", get("ha.url"));
+  TEST_ASSERT_EQUAL(1, g_s.keys);
+
+  TEST_ASSERT_EQUAL(OK, cfg_store_unset(&g_s, "ha.url"));
+  TEST_ASSERT_NULL(get("ha.url"));
+  TEST_ASSERT_EQUAL(-ENOENT, cfg_store_unset(&g_s, "ha.url"));
+  TEST_ASSERT_EQUAL(0, g_s.keys);
+  TEST_ASSERT_EQUAL_UINT32(0, g_s.live_bytes);
+}
+
+static void test_get_into_small_buffer(void)
+{
+  char small[4];
+
+  cfg_store_set(&g_s, "mmwave.baud", "256000");
+
+  TEST_ASSERT_EQUAL(-E2BIG, cfg_store_get(&g_s, "mmwave.baud", small,
+                                          sizeof(small)));
+}
+
+static void test_rejects_bad_lengths(void)
+{
+  char key[CFG_KEY_MAX + 2];
+  char val[CFG_VAL_MAX + 2];
+
+  memset(key, 'k', sizeof(key) - 1);
+  key[sizeof(key) - 1] = '\0';
+  memset(val, 'v', sizeof(val) - 1);
+  val[sizeof(val) - 1] = '\0';
+
+  TEST_ASSERT_EQUAL(-EINVAL, cfg_store_set(&g_s, "", "x"));
+  TEST_ASSERT_EQUAL(-EINVAL, cfg_store_set(&g_s, key, "x"));
+  TEST_ASSERT_EQUAL(-EINVAL, cfg_store_set(&g_s, "k", val));
+
+  key[CFG_KEY_MAX] = '\0';
+  val[CFG_VAL_MAX] = '\0';
+  TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, key, val));
+  TEST_ASSERT_EQUAL(CFG_VAL_MAX, cfg_store_get(&g_s, key, g_val,
+                                               sizeof(g_val)));
+}
+
+/* ---- Transactions ---- */
+
+static void test_transaction_is_one_append(void)
+{
+  cfg_store_begin(&g_s);
+  cfg_store_put(&g_s, "wifi.ssid", "home");
+  cfg_store_put(&g_s, "wifi.psk", "secret");
+  cfg_store_put(&g_s, "boot.autostart_wifi", "1");
+  TEST_ASSERT_EQUAL(OK, cfg_store_commit(&g_s));
+
+  TEST_ASSERT_EQUAL_UINT32(1, g_s.stats.appends);
+  TEST_ASSERT_EQUAL_UINT32(g_file.len, g_s.file_len);
+  TEST_ASSERT_EQUAL_STRING("secret", get("wifi.psk"));
+  TEST_ASSERT_EQUAL(3, g_s.keys);
+}
+
+static void test_torn_transaction_is_dropped_at_load(void)
+{
+  cfg_store_set(&g_s, "wifi.ssid", "old");
+  uint32_t good = g_file.len;
+
+  cfg_store_begin(&g_s);
+  cfg_store_put(&g_s, "wifi.ssid", "new");
+  cfg_store_put(&g_s, "wifi.psk", "secret");
+  cfg_store_commit(&g_s);
+
+  g_file.len -= 3;                     /* Power lost mid-write */
+
+  TEST_ASSERT_EQUAL(1, reboot());
+  TEST_ASSERT_EQUAL_STRING("old", get("wifi.ssid"));
+  TEST_ASSERT_NULL(get("wifi.psk"));
+  TEST_ASSERT_EQUAL_UINT32(good, g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(1, g_s.stats.torn);
+
+  /* Later writes follow the last good block */
+
+  cfg_store_set(&g_s, "wifi.psk", "again");
+  TEST_ASSERT_EQUAL(2, reboot());
+  TEST_ASSERT_EQUAL_STRING("again", get("wifi.psk"));
+}
+
+static void test_failed_append_changes_nothing(void)
+{
+  cfg_store_set(&g_s, "ha.port", "8123");
+  uint32_t len = g_file.len;
+
+  g_file.fail_append = 5;
+  TEST_ASSERT_EQUAL(-EIO, cfg_store_set(&g_s, "ha.port", "443"));
+
+  TEST_ASSERT_EQUAL_STRING("8123", get("ha.port"));
+  TEST_ASSERT_EQUAL_UINT32(len, g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(len, g_s.file_len);
+}
+
+static void test_clear_then_defaults_in_one_transaction(void)
+{
+  cfg_store_set(&g_s, "wifi.ssid", "home");
+  cfg_store_set(&g_s, "custom.key", "x");
+
+  cfg_store_begin(&g_s);
+  cfg_store_clear(&g_s);
+  cfg_store_put(&g_s, "wifi.ssid", "");
+  cfg_store_put(&g_s, "ha.port", "8123");
+  TEST_ASSERT_EQUAL(OK, cfg_store_commit(&g_s));
+
+  TEST_ASSERT_NULL(get("custom.key"));
+  TEST_ASSERT_EQUAL_STRING("", get("wifi.ssid"));
+  TEST_ASSERT_EQUAL(2, g_s.keys);
+
+  TEST_ASSERT_EQUAL(2, reboot());
+  TEST_ASSERT_NULL(get("custom.key"));
+  TEST_ASSERT_EQUAL_STRING("8123", get("ha.port"));
+}
+
+static void test_key_limit_and_oversized_transaction(void)
+{
+  char key[16];
+
+  for (int i = 0; i < CFG_STORE_KEYS_MAX; i++)
+    {
+      snprintf(key, sizeof(key), "k%d", i);
+      TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, key, "v"));
+    }
+
+  TEST_ASSERT_EQUAL(-ENOSPC, cfg_store_set(&g_s, "one.more", "v"));
+  TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, "k0", "replaced"));
+
+  char val[CFG_VAL_MAX + 1];
+
+  memset(val, 'v', CFG_VAL_MAX);
+  val[CFG_VAL_MAX] = '\0';
+
+  cfg_store_begin(&g_s);
+  TEST_ASSERT_EQUAL(OK, cfg_store_put(&g_s, "k1", val));
+  TEST_ASSERT_EQUAL(OK, cfg_store_put(&g_s, "k2", val));
+  TEST_ASSERT_EQUAL(-E2BIG, cfg_store_put(&g_s, "k3", val));
+}
+
+/* ---- Loading ---- */
+
+static void test_reload_rebuilds_index(void)
+{
+  cfg_store_set(&g_s, "a", "1");
+  cfg_store_set(&g_s, "b", "2");
+  cfg_store_set(&g_s, "a", "3");
+  cfg_store_unset(&g_s, "b");
+
+  TEST_ASSERT_EQUAL(1, reboot());
+  TEST_ASSERT_EQUAL_STRING("3", get("a"));
+  TEST_ASSERT_NULL(get("b"));
+  TEST_ASSERT_EQUAL_UINT32(g_file.len, g_s.file_len);
+  TEST_ASSERT_EQUAL_UINT32(0, g_s.stats.torn);
+}
+
+static void test_known_key_goes_by_number(void)
+{
+  cfg_store_set(&g_s, "mmwave.baud", "256000");
+  cfg_store_set(&g_s, "x", "1");
+  uint32_t len = g_file.len;
+
+  /* Set again: its number and the value, the key is not written */
+
+  cfg_store_set(&g_s, "mmwave.baud", "115200");
+  TEST_ASSERT_EQUAL_UINT32(CFG_STORE_HDR_SIZE + CFG_STORE_ENT_SIZE + 6,
+                           g_file.len - len);
+
+  /* Deleted and set again it is spelled out, and numbered anew */
+
+  cfg_store_unset(&g_s, "mmwave.baud");
+  len = g_file.len;
+  cfg_store_set(&g_s, "mmwave.baud", "9600");
+  TEST_ASSERT_EQUAL_UINT32(CFG_STORE_HDR_SIZE + CFG_STORE_ENT_SIZE +
+                           11 + 4, g_file.len - len);
+  cfg_store_set(&g_s, "mmwave.baud", "57600");
+
+  /* In a transaction of several entries every key is spelled out */
+
+  len = g_file.len;
+  cfg_store_begin(&g_s);
+  cfg_store_put(&g_s, "x", "2");
+  cfg_store_del(&g_s, "x");
+  cfg_store_put(&g_s, "x", "3");
+  TEST_ASSERT_EQUAL(OK, cfg_store_commit(&g_s));
+  TEST_ASSERT_EQUAL_UINT32(CFG_STORE_HDR_SIZE + 3 * CFG_STORE_ENT_SIZE +
+                           3 + 2, g_file.len - len);
+
+  TEST_ASSERT_EQUAL(2, reboot());
+  TEST_ASSERT_EQUAL_STRING("57600", get("mmwave.baud"));
+  TEST_ASSERT_EQUAL_STRING("3", get("x"));
+  TEST_ASSERT_EQUAL_UINT32(0, g_s.stats.torn);
+
+  /* Compaction numbers the keys again, as loading the new file does */
+
+  TEST_ASSERT_EQUAL(OK, cfg_store_compact(&g_s));
+  cfg_store_set(&g_s, "x", "4");
+  cfg_store_set(&g_s, "mmwave.baud", "256000");
+  TEST_ASSERT_EQUAL(2, reboot());
+  TEST_ASSERT_EQUAL_STRING("256000", get("mmwave.baud"));
+  TEST_ASSERT_EQUAL_STRING("4", get("x"));
+  TEST_ASSERT_EQUAL_UINT32(0, g_s.stats.torn);
+}
+
+static void test_key_churn_reuses_arena_space(void)
+{
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  char kept[16];
+
+  /* Long values come and go and "kept" changes length every time:
+   * together more records than the arena holds at once.
+   */
+
+  memset(val, 'v', 200);
+  val[200] = '\0';
+
+  for (int i = 0; i < 12; i++)
+    {
+      snprintf(key, sizeof(key), "churn.%02d", i);
+      snprintf(kept, sizeof(kept), "%0*d", i + 1, i);
+      TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, key, val));
+      TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, "kept", kept));
+      TEST_ASSERT_EQUAL(OK, cfg_store_unset(&g_s, key));
+    }
+
+  TEST_ASSERT_LESS_OR_EQUAL(CFG_STORE_ARENA, g_s.arena_len);
+  TEST_ASSERT_EQUAL(OK, cfg_store_set(&g_s, key, "last"));
+  TEST_ASSERT_EQUAL_STRING(kept, get("kept"));
+  TEST_ASSERT_EQUAL_STRING("last", get(key));
+
+  /* The file is now several read chunks long */
+
+  TEST_ASSERT_GREATER_THAN(2 * CFG_STORE_BLOCK_MAX, g_file.len);
+  TEST_ASSERT_EQUAL(2, reboot());
+  TEST_ASSERT_EQUAL_STRING(kept, get("kept"));
+  TEST_ASSERT_EQUAL_STRING("last", get(key));
+  TEST_ASSERT_EQUAL_UINT32(g_file.len, g_s.file_len);
+  TEST_ASSERT_EQUAL_UINT32(0, g_s.stats.torn);
+}
+
+static void test_corrupt_block_ends_the_file(void)
+{
+  cfg_store_set(&g_s, "a", "1");
+  uint32_t good = g_file.len;
+
+  cfg_store_set(&g_s, "a", "2");
+  cfg_store_set(&g_s, "b", "3");
+
+  g_file.data[good + CFG_STORE_HDR_SIZE + 3] ^= 0x01;   /* "2" */
+
+  TEST_ASSERT_EQUAL(1, reboot());
+  TEST_ASSERT_EQUAL_STRING("1", get("a"));
+  TEST_ASSERT_NULL(get("b"));
+  TEST_ASSERT_EQUAL_UINT32(good, g_file.len);
+}
+
+static void test_read_error_leaves_file_alone(void)
+{
+  cfg_store_set(&g_s, "a", "1");
+  uint32_t len = g_file.len;
+
+  g_file.fail_read = true;
+  cfg_store_init(&g_s, &g_io, COMPACT_MIN);
+
+  TEST_ASSERT_EQUAL(-EIO, cfg_store_load(&g_s));
+  TEST_ASSERT_EQUAL_UINT32(len, g_file.len);
+}
+
+/* ---- Compaction ---- */
+
+static void test_compaction_keeps_only_live_entries(void)
+{
+  char val[8];
+
+  cfg_store_set(&g_s, "keep", "k");
+  for (int i = 0; i < 40; i++)
+    {
+      snprintf(val, sizeof(val), "%d", i);
+      cfg_store_set(&g_s, "counter", val);
+    }
+
+  cfg_store_set(&g_s, "gone", "g");
+  cfg_store_unset(&g_s, "gone");
+
+  TEST_ASSERT_TRUE(cfg_store_compact_due(&g_s));
+  TEST_ASSERT_EQUAL(OK, cfg_store_compact(&g_s));
+
+  /* One block: header plus the two live entries */
+
+  TEST_ASSERT_EQUAL_UINT32(CFG_STORE_HDR_SIZE + g_s.live_bytes,
+                           g_file.len);
+  TEST_ASSERT_FALSE(cfg_store_compact_due(&g_s));
+  TEST_ASSERT_EQUAL_STRING("39", get("counter"));
+  TEST_ASSERT_EQUAL_STRING("k", get("keep"));
+
+  TEST_ASSERT_EQUAL(2, reboot());
+  TEST_ASSERT_EQUAL_STRING("39", get("counter"));
+  TEST_ASSERT_NULL(get("gone"));
+}
+
+static void test_failed_compaction_keeps_old_file(void)
+{
+  for (int i = 0; i < 40; i++)
+    {
+      cfg_store_set(&g_s, "counter", i & 1 ? "odd" : "even");
+    }
+
+  uint32_t len = g_file.len;
+
+  g_file.fail_rewrite = true;
+  TEST_ASSERT_EQUAL(-ENOSPC, cfg_store_compact(&g_s));
+
+  TEST_ASSERT_EQUAL_UINT32(len, g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(len, g_s.file_len);
+  TEST_ASSERT_EQUAL_STRING("odd", get("counter"));
+}
+
+static void test_small_file_is_not_compacted(void)
+{
+  cfg_store_set(&g_s, "a", "1");
+  cfg_store_set(&g_s, "a", "2");
+  cfg_store_set(&g_s, "a", "3");
+
+  TEST_ASSERT_TRUE(g_s.live_bytes * 2 < g_s.file_len);
+  TEST_ASSERT_FALSE(cfg_store_compact_due(&g_s));
+}
+
+/* ---- Listing ---- */
+
+static void test_next_walks_every_key(void)
+{
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+  int pos = 0;
+  int seen = 0;
+
+  cfg_store_set(&g_s, "x", "1");
+  cfg_store_set(&g_s, "y", "2");
+  cfg_store_set(&g_s, "z", "3");
+  cfg_store_unset(&g_s, "y");
+
+  while (cfg_store_next(&g_s, &pos, key, val) == 1)
+    {
+      TEST_ASSERT_TRUE(strcmp(key, "x") == 0 || strcmp(key, "z") == 0);
+      TEST_ASSERT_EQUAL_STRING(key[0] == 'x' ? "1" : "3", val);
+      seen++;
+    }
+
+  TEST_ASSERT_EQUAL(2, seen);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_set_then_get);
+  RUN_TEST(test_overwrite_and_delete);
+  RUN_TEST(test_get_into_small_buffer);
+  RUN_TEST(test_rejects_bad_lengths);
+
+  RUN_TEST(test_transaction_is_one_append);
+  RUN_TEST(test_torn_transaction_is_dropped_at_load);
+  RUN_TEST(test_failed_append_changes_nothing);
+  RUN_TEST(test_clear_then_defaults_in_one_transaction);
+  RUN_TEST(test_key_limit_and_oversized_transaction);
+
+  RUN_TEST(test_reload_rebuilds_index);
+  RUN_TEST(test_known_key_goes_by_number);
+  RUN_TEST(test_key_churn_reuses_arena_space);
+  RUN_TEST(test_corrupt_block_ends_the_file);
+  RUN_TEST(test_read_error_leaves_file_alone);
+
+  RUN_TEST(test_compaction_keeps_only_live_entries);
+  RUN_TEST(test_failed_compaction_keeps_old_file);
+  RUN_TEST(test_small_file_is_not_compacted);
+
+  RUN_TEST(test_next_walks_every_key);
+
+  return UNITY_END();
+}
@@ -0,0 +1,341 @@
+/*
+ * tests/test_config_svc.c
+ *
+ * Unit tests for the config service core (apps/config/config_svc.h):
+ * typed getters and their defaults, change notification by key prefix
+ * (deletes and resets included), the watch table, the NSH export line,
+ * and that gets after the load read nothing. The store sits on a RAM
+ * file as in test_config_store.c.
+ */
+
+#include "unity/unity.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include "apps/config/config_svc.h"
+
+/* ---- Test helpers ---- */
+
+#define FILE_MAX     4096
+
+static uint8_t  g_data[FILE_MAX];
+static uint32_t g_len;
+static struct cfg_svc_s g_svc;
+static char g_buf[CFG_VAL_MAX + 1];
+
+struct seen_s
+{
+  int  calls;
+  bool reset;
+  bool deleted;
+  char key[CFG_KEY_MAX + 1];
+  char val[CFG_VAL_MAX + 1];
+};
+
+static struct seen_s g_seen;
+
+static ssize_t ram_read(void *priv, uint32_t off, uint8_t *buf, size_t len)
+{
+  if (off >= g_len)
+    {
+      return 0;
+    }
+
+  if (len > g_len - off)
+    {
+      len = g_len - off;
+    }
+
+  memcpy(buf, g_data + off, len);
+  return (ssize_t)len;
+}
+
+static int ram_append(void *priv, const uint8_t *buf, size_t len)
+{
+  if (g_len + len > FILE_MAX)
+    {
+      return -ENOSPC;
+    }
+
+  memcpy(g_data + g_len, buf, len);
+  g_len += len;
+  return 0;
+}
+
+static int ram_truncate(void *priv, uint32_t len)
+{
+  g_len = len < g_len ? len : g_len;
+  return 0;
+}
+
+static const struct cfg_store_io_s g_io =
+{
+  ram_read, ram_append, ram_truncate, NULL, NULL, NULL, NULL
+};
+
+static void load(void)
+{
+  memset(&g_svc.store, 0, sizeof(g_svc.store));
+  cfg_store_init(&g_svc.store, &g_io, FILE_MAX);
+  cfg_store_load(&g_svc.store);
+}
+
+/* One write through the service: commit, then tell the watchers */
+
+static int write_kv(const char *key, const char *val)
+{
+  int ret;
+
+  cfg_store_begin(&g_svc.store);
+  ret = val != NULL ? cfg_store_put(&g_svc.store, key, val) :
+                      cfg_store_del(&g_svc.store, key);
+  if (ret == OK)
+    {
+      ret = cfg_svc_commit(&g_svc);
+      cfg_svc_notify(&g_svc);
+    }
+
+  return ret;
+}
+
+static void record(const char *key, const char *val, void *arg)
+{
+  g_seen.calls++;
+  g_seen.reset   = key == NULL;
+  g_seen.deleted = key != NULL && val == NULL;
+  strcpy(g_seen.key, key != NULL ? key : "");
+  strcpy(g_seen.val, val != NULL ? val : "");
+}
+
+static void other(const char *key, const char *val, void *arg)
+{
+  (*(int *)arg)++;
+}
+
+void setUp(void)
+{
+  memset(&g_svc, 0, sizeof(g_svc));
+  memset(&g_seen, 0, sizeof(g_seen));
+  g_len = 0;
+  load();
+}
+
+void tearDown(void) {}
+
+/* ---- Typed reads ---- */
+
+static void test_get_int_parses_or_defaults(void)
+{
+  write_kv("ha.port", "8123");
+  write_kv("mmwave.mask", "0x1f");
+  write_kv("ha.interval", "500ms");
+  write_kv("ha.empty", "");
+
+  TEST_ASSERT_EQUAL(8123, cfg_svc_get_int(&g_svc, "ha.port", 1));
+  TEST_ASSERT_EQUAL(31, cfg_svc_get_int(&g_svc, "mmwave.mask", 1));
+  TEST_ASSERT_EQUAL(250, cfg_svc_get_int(&g_svc, "ha.interval", 250));
+  TEST_ASSERT_EQUAL(7, cfg_svc_get_int(&g_svc, "ha.empty", 7));
+  TEST_ASSERT_EQUAL(-1, cfg_svc_get_int(&g_svc, "ha.none", -1));
+}
+
+static void test_get_int_rejects_overflow(void)
+{
+  write_kv("x.big", "99999999999999999999999");
+
+  TEST_ASSERT_EQUAL(5, cfg_svc_get_int(&g_svc, "x.big", 5));
+}
+
+static void test_get_bool_spellings(void)
+{
+  static const char *const on[]  = { "1", "on", "yes", "true" };
+  static const char *const off[] = { "0", "off", "no", "false" };
+
+  for (int i = 0; i < 4; i++)
+    {
+      write_kv("b.on", on[i]);
+      write_kv("b.off", off[i]);
+      TEST_ASSERT_TRUE(cfg_svc_get_bool(&g_svc, "b.on", false));
+      TEST_ASSERT_FALSE(cfg_svc_get_bool(&g_svc, "b.off", true));
+    }
+
+  write_kv("b.odd", "maybe");
+  TEST_ASSERT_TRUE(cfg_svc_get_bool(&g_svc, "b.odd", true));
+  TEST_ASSERT_FALSE(cfg_svc_get_bool(&g_svc, "b.none", false));
+}
+
+static void test_get_str_default_and_too_long(void)
+{
+  char small[6];
+
+  write_kv("wifi.ssid", "home-network");
+
+  TEST_ASSERT_EQUAL_STRING("home-network",
+                           cfg_svc_get_str(&g_svc, "wifi.ssid", g_buf,
+                                           sizeof(g_buf), "x"));
+  TEST_ASSERT_EQUAL_STRING("dflt", cfg_svc_get_str(&g_svc, "wifi.ssid",
+                                                   small, sizeof(small),
+                                                   "dflt"));
+  TEST_ASSERT_EQUAL_STRING("", cfg_svc_get_str(&g_svc, "wifi.psk", g_buf,
+                                               sizeof(g_buf), NULL));
+}
+
+static void test_gets_after_load_read_nothing(void)
+{
+  write_kv("ha.url", "192.168.1.100");
+  write_kv("ha.port", "8123");
+  load();
+
+  uint32_t reads = g_svc.store.stats.reads;
+
+  for (int i = 0; i < 100; i++)
+    {
+      TEST_ASSERT_EQUAL(8123, cfg_svc_get_int(&g_svc, "ha.port", 0));
+      cfg_svc_get_str(&g_svc, "ha.url", g_buf, sizeof(g_buf), "");
+    }
+
+  TEST_ASSERT_EQUAL_STRING("192.168.1.100", g_buf);
+  TEST_ASSERT_EQUAL(reads, g_svc.store.stats.reads);
+}
+
+/* ---- Change notification ---- */
+
+static void test_watch_matches_prefix(void)
+{
+  TEST_ASSERT_EQUAL(OK, cfg_svc_watch(&g_svc, "ha.", record, NULL));
+
+  write_kv("wifi.ssid", "home");
+  TEST_ASSERT_EQUAL(0, g_seen.calls);
+
+  write_kv("ha.url", "10.0.0.2");
+  TEST_ASSERT_EQUAL(1, g_seen.calls);
+  TEST_ASSERT_EQUAL_STRING("ha.url", g_seen.key);
+  TEST_ASSERT_EQUAL_STRING("10.0.0.2", g_seen.val);
+
+  /* Written by its number this time */
+
+  write_kv("ha.url", "10.0.0.3");
+  TEST_ASSERT_EQUAL(2, g_seen.calls);
+  TEST_ASSERT_EQUAL_STRING("ha.url", g_seen.key);
+  TEST_ASSERT_EQUAL_STRING("10.0.0.3", g_seen.val);
+}
+
+static void test_watch_sees_each_key_of_a_transaction(void)
+{
+  cfg_svc_watch(&g_svc, "ha.", record, NULL);
+
+  cfg_store_begin(&g_svc.store);
+  cfg_store_put(&g_svc.store, "ha.url", "a");
+  cfg_store_put(&g_svc.store, "wifi.ssid", "b");
+  cfg_store_put(&g_svc.store, "ha.token", "c");
+  TEST_ASSERT_EQUAL(OK, cfg_svc_commit(&g_svc));
+  cfg_svc_notify(&g_svc);
+
+  TEST_ASSERT_EQUAL(2, g_seen.calls);
+  TEST_ASSERT_EQUAL_STRING("ha.token", g_seen.key);
+
+  /* Already delivered: nothing twice */
+
+  cfg_svc_notify(&g_svc);
+  TEST_ASSERT_EQUAL(2, g_seen.calls);
+}
+
+static void test_watch_delete_and_reset(void)
+{
+  write_kv("ha.url", "x");
+  cfg_svc_watch(&g_svc, "ha.", record, NULL);
+
+  write_kv("ha.url", NULL);
+  TEST_ASSERT_EQUAL(1, g_seen.calls);
+  TEST_ASSERT_TRUE(g_seen.deleted);
+  TEST_ASSERT_EQUAL_STRING("ha.url", g_seen.key);
+
+  cfg_store_begin(&g_svc.store);
+  cfg_store_clear(&g_svc.store);
+  cfg_svc_commit(&g_svc);
+  cfg_svc_notify(&g_svc);
+  TEST_ASSERT_EQUAL(2, g_seen.calls);
+  TEST_ASSERT_TRUE(g_seen.reset);
+}
+
+static void test_failed_commit_notifies_nobody(void)
+{
+  cfg_svc_watch(&g_svc, "", record, NULL);
+  g_len = FILE_MAX;                     /* The next append has no room */
+
+  TEST_ASSERT_EQUAL(-ENOSPC, write_kv("ha.url", "x"));
+  TEST_ASSERT_EQUAL(0, g_seen.calls);
+}
+
+static void test_watch_table_dedupes_and_fills(void)
+{
+  int hits = 0;
+  char prefix[CFG_SVC_WATCH_MAX][4];
+
+  TEST_ASSERT_EQUAL(OK, cfg_svc_watch(&g_svc, "ha.", record, NULL));
+  TEST_ASSERT_EQUAL(OK, cfg_svc_watch(&g_svc, "ha.", record, NULL));
+  TEST_ASSERT_EQUAL(1, g_svc.nwatch);
+
+  for (int i = 1; i < CFG_SVC_WATCH_MAX; i++)
+    {
+      snprintf(prefix[i], sizeof(prefix[i]), "%c.", 'a' + i);
+      TEST_ASSERT_EQUAL(OK, cfg_svc_watch(&g_svc, prefix[i], other,
+                                          &hits));
+    }
+
+  TEST_ASSERT_EQUAL(-ENOSPC, cfg_svc_watch(&g_svc, "z.", other, &hits));
+
+  write_kv("b.x", "1");
+  TEST_ASSERT_EQUAL(1, hits);
+  TEST_ASSERT_EQUAL(0, g_seen.calls);
+}
+
+/* ---- Export ---- */
+
+static void test_export_line_names_and_quotes(void)
+{
+  char line[CFG_SVC_EXPORT_MAX];
+
+  TEST_ASSERT_EQUAL(25, cfg_svc_export_line("wifi.ssid", "home net",
+                                            line, sizeof(line)));
+  TEST_ASSERT_EQUAL_STRING("set WIFI_SSID \"home net\"\n", line);
+
+  cfg_svc_export_line("boot.autostart-ha", "", line, sizeof(line));
+  TEST_ASSERT_EQUAL_STRING("set BOOT_AUTOSTART_HA \"\"\n", line);
+}
+
+static void test_export_skips_unquotable_values(void)
+{
+  static const char *const bad[] = { "a\"b", "$HOME", "c:\\x", "t\tab" };
+  char line[CFG_SVC_EXPORT_MAX];
+
+  for (int i = 0; i < 4; i++)
+    {
+      TEST_ASSERT_EQUAL(-EINVAL, cfg_svc_export_line("wifi.psk", bad[i],
+                                                     line, sizeof(line)));
+      TEST_ASSERT_EQUAL_STRING("# WIFI_PSK not exported: "
+                               "config get wifi.psk\n", line);
+    }
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_get_int_parses_or_defaults);
+  RUN_TEST(test_get_int_rejects_overflow);
+  RUN_TEST(test_get_bool_spellings);
+  RUN_TEST(test_get_str_default_and_too_long);
+  RUN_TEST(test_gets_after_load_read_nothing);
+
+  RUN_TEST(test_watch_matches_prefix);
+  RUN_TEST(test_watch_sees_each_key_of_a_transaction);
+  RUN_TEST(test_watch_delete_and_reset);
+  RUN_TEST(test_failed_commit_notifies_nobody);
+  RUN_TEST(test_watch_table_dedupes_and_fills);
+
+  RUN_TEST(test_export_line_names_and_quotes);
+  RUN_TEST(test_export_skips_unquotable_values);
+
+  return UNITY_END();
+}
@@ -0,0 +1,659 @@
+/*
+ * tests/test_esphome_api.c
+ *
+ * Unit tests for the ESPHome native API server (apps/esphome/esphome_api.h):
+ * varint framing, protobuf payloads, the incremental frame reader, and a
+ * full Home Assistant style session driven over a loopback TCP socket.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "apps/esphome/esphome_api.h"
+
+/* ---- Test helpers ---- */
+
+static uint8_t buf[ESPH_TX_MAX];
+static struct esph_rx_s rx;
+
+static const struct esph_device_s dev =
+{
+  "hallway", "AA:BB:CC:DD:EE:FF", "NuttX 12.8.0", "Jan  1 2026, 00:00:00",
+  "ESP32-C6 + LD2410"
+};
+
+static struct mmwave_data_s make_data(uint8_t state)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state       = state;
+  d.motion_energy      = 80;
+  d.static_energy      = 40;
+  d.motion_distance    = 150;
+  d.static_distance    = 200;
+  d.detection_distance = 120;
+  return d;
+}
+
+/* Build a request frame from raw payload bytes */
+
+static size_t request(uint8_t *out, uint16_t type, const uint8_t *payload,
+                      size_t len)
+{
+  struct esph_pb_s pb;
+  uint8_t *start;
+  int n;
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  if (len > 0)
+    {
+      memcpy(esph_pb_room(&pb, len), payload, len);
+      pb.len = len;
+    }
+  n = esph_frame_finish(&pb, type, &start);
+  memcpy(out, start, n);
+  return (size_t)n;
+}
+
+/* Find string field `field` in a payload; NULL terminated copy */
+
+static const char *field_str(const uint8_t *p, size_t len, uint32_t field)
+{
+  static char s[64];
+
+  return esph_pb_get_string(p, len, field, s, sizeof(s)) >= 0 ? s : NULL;
+}
+
+/* Scan for a varint or fixed32 field; returns the raw value or -1 */
+
+static int64_t field_num(const uint8_t *p, size_t len, uint32_t field)
+{
+  size_t i = 0;
+
+  while (i < len)
+    {
+      uint8_t tag = p[i++];
+      uint32_t v = 0;
+
+      if ((tag & 7) == ESPH_WT_FIXED32)
+        {
+          v = p[i] | p[i + 1] << 8 | p[i + 2] << 16 |
+              (uint32_t)p[i + 3] << 24;
+          i += 4;
+        }
+      else
+        {
+          for (unsigned s = 0; ; s += 7)
+            {
+              v |= (uint32_t)(p[i] & 0x7f) << s;
+              if ((p[i++] & 0x80) == 0)
+                {
+                  break;
+                }
+            }
+
+          if ((tag & 7) == ESPH_WT_LEN)
+            {
+              i += v;
+              continue;
+            }
+        }
+
+      if ((uint32_t)(tag >> 3) == field)
+        {
+          return v;
+        }
+    }
+
+  return -1;
+}
+
+static uint32_t float_bits(float f)
+{
+  uint32_t b;
+  memcpy(&b, &f, sizeof(b));
+  return b;
+}
+
+/* ---- Loopback session plumbing ---- */
+
+static int srv_fd;
+static int cli_fd;
+static uint8_t cli_buf[1024];
+static size_t cli_off;
+static size_t cli_len;
+static struct esph_rx_s cli_rx;
+
+static int sock_send(void *arg, const uint8_t *p, size_t len)
+{
+  return send(*(int *)arg, p, len, 0) == (ssize_t)len ? 0 : -EIO;
+}
+
+static int fail_send(void *arg, const uint8_t *p, size_t len)
+{
+  return -ECONNRESET;
+}
+
+static void loopback_open(void)
+{
+  struct sockaddr_in addr;
+  socklen_t alen = sizeof(addr);
+  int lfd = socket(AF_INET, SOCK_STREAM, 0);
+
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  TEST_ASSERT_EQUAL_INT(0, bind(lfd, (struct sockaddr *)&addr,
+                                sizeof(addr)));
+  TEST_ASSERT_EQUAL_INT(0, listen(lfd, 1));
+  getsockname(lfd, (struct sockaddr *)&addr, &alen);
+
+  cli_fd = socket(AF_INET, SOCK_STREAM, 0);
+  TEST_ASSERT_EQUAL_INT(0, connect(cli_fd, (struct sockaddr *)&addr,
+                                   sizeof(addr)));
+  srv_fd = accept(lfd, NULL, NULL);
+  TEST_ASSERT_TRUE(srv_fd >= 0);
+  close(lfd);
+
+  cli_off = cli_len = 0;
+  esph_rx_init(&cli_rx);
+}
+
+static void loopback_close(void)
+{
+  close(cli_fd);
+  close(srv_fd);
+}
+
+/* Client: send a request, then let the server read and answer it */
+
+static int exchange(struct esph_conn_s *c, uint16_t type,
+                    const uint8_t *payload, size_t len,
+                    const struct mmwave_data_s *d)
+{
+  uint8_t req[64];
+  uint8_t in[64];
+  size_t n = request(req, type, payload, len);
+  ssize_t got;
+
+  TEST_ASSERT_EQUAL_INT((int)n, send(cli_fd, req, n, 0));
+  got = recv(srv_fd, in, sizeof(in), 0);
+  TEST_ASSERT_EQUAL_INT((int)n, (int)got);
+  return esph_conn_input(c, &dev, d, in, got);
+}
+
+/* Client: next message from the server, as type; payload in cli_rx */
+
+static int next_msg(void)
+{
+  for (; ; )
+    {
+      while (cli_off < cli_len)
+        {
+          size_t used;
+          int ret = esph_rx_feed(&cli_rx, cli_buf + cli_off,
+                                 cli_len - cli_off, &used);
+
+          cli_off += used;
+          TEST_ASSERT_NOT_EQUAL(ESPH_RX_INVALID, ret);
+          if (ret == ESPH_RX_MSG)
+            {
+              return cli_rx.type;
+            }
+        }
+
+      ssize_t n = recv(cli_fd, cli_buf, sizeof(cli_buf), 0);
+      TEST_ASSERT_TRUE(n > 0);
+      cli_off = 0;
+      cli_len = (size_t)n;
+    }
+}
+
+static bool client_idle(void)
+{
+  uint8_t b;
+
+  return cli_off == cli_len &&
+         recv(cli_fd, &b, 1, MSG_DONTWAIT) < 0 && errno == EAGAIN;
+}
+
+void setUp(void)
+{
+  memset(buf, 0, sizeof(buf));
+  esph_rx_init(&rx);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Encoding
+ * ================================================================ */
+
+void test_varint_sizes(void)
+{
+  uint8_t v[5];
+
+  TEST_ASSERT_EQUAL_size_t(1, esph_put_varint(v, 0));
+  TEST_ASSERT_EQUAL_size_t(1, esph_put_varint(v, 127));
+  TEST_ASSERT_EQUAL_size_t(2, esph_put_varint(v, 300));
+  TEST_ASSERT_EQUAL_HEX8(0xac, v[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x02, v[1]);
+  TEST_ASSERT_EQUAL_size_t(3, esph_varint_size(16384));
+}
+
+void test_empty_frame(void)
+{
+  struct esph_pb_s pb;
+  uint8_t *start;
+  const uint8_t want[] = { 0x00, 0x00, ESPH_MSG_PING_RESP };
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_INT(3, esph_frame_finish(&pb, ESPH_MSG_PING_RESP,
+                                             &start));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(want, start, 3);
+}
+
+void test_hello_response_bytes(void)
+{
+  struct esph_pb_s pb;
+  uint8_t *start;
+  const uint8_t want[] =
+  {
+    0x00, 0x18, ESPH_MSG_HELLO_RESP,
+    0x08, 0x01, 0x10, 0x0a,
+    0x1a, 0x09, 'm', 'm', 'W', 'a', 'v', 'e', ' ', 'O', 'S',
+    0x22, 0x07, 'h', 'a', 'l', 'l', 'w', 'a', 'y'
+  };
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  esph_hello_resp(&pb, &dev);
+  TEST_ASSERT_EQUAL_INT(sizeof(want),
+                        esph_frame_finish(&pb, ESPH_MSG_HELLO_RESP, &start));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(want, start, sizeof(want));
+}
+
+void test_entity_key_is_fnv1(void)
+{
+  TEST_ASSERT_EQUAL_HEX32(0x3a50bd3a, esph_key("presence"));
+  TEST_ASSERT_NOT_EQUAL(esph_key("motion_distance"),
+                        esph_key("static_distance"));
+}
+
+void test_binary_state_on_and_off(void)
+{
+  struct esph_pb_s pb;
+  uint8_t *start;
+  const uint8_t on[] =
+  {
+    0x00, 0x07, ESPH_MSG_BINARY_SENSOR_STATE,
+    0x0d, 0x3a, 0xbd, 0x50, 0x3a, 0x10, 0x01
+  };
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_UINT16(ESPH_MSG_BINARY_SENSOR_STATE,
+                           esph_state(&pb, ESPH_ENTITY_PRESENCE, 1.0f));
+  TEST_ASSERT_EQUAL_INT(sizeof(on),
+                        esph_frame_finish(&pb, ESPH_MSG_BINARY_SENSOR_STATE,
+                                          &start));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(on, start, sizeof(on));
+
+  /* proto3: false is the default and is left out */
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  esph_state(&pb, ESPH_ENTITY_PRESENCE, 0.0f);
+  TEST_ASSERT_EQUAL_size_t(5, pb.len);
+}
+
+void test_sensor_state_float(void)
+{
+  struct mmwave_data_s d = make_data(LD2410_TARGET_MOTION);
+  struct esph_pb_s pb;
+  uint8_t *p;
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_UINT16(ESPH_MSG_SENSOR_STATE,
+                           esph_state(&pb, 3, esph_entity_value(3, &d)));
+  p = buf + ESPH_HDR_MAX;
+  TEST_ASSERT_EQUAL_size_t(10, pb.len);
+  TEST_ASSERT_EQUAL_HEX32(esph_key("motion_distance"),
+                          (uint32_t)field_num(p, pb.len, 1));
+  TEST_ASSERT_EQUAL_HEX32(float_bits(150.0f),
+                          (uint32_t)field_num(p, pb.len, 2));
+}
+
+void test_list_sensor_fields(void)
+{
+  struct esph_pb_s pb;
+  uint8_t *p = buf + ESPH_HDR_MAX;
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_UINT16(ESPH_MSG_LIST_SENSOR,
+                           esph_list_entity(&pb, 5, &dev));
+  TEST_ASSERT_EQUAL_INT(0, pb.error);
+  TEST_ASSERT_EQUAL_STRING("detection_distance", field_str(p, pb.len, 1));
+  TEST_ASSERT_EQUAL_HEX32(esph_key("detection_distance"),
+                          (uint32_t)field_num(p, pb.len, 2));
+  TEST_ASSERT_EQUAL_STRING("Detection distance", field_str(p, pb.len, 3));
+  TEST_ASSERT_EQUAL_STRING("hallway_detection_distance",
+                           field_str(p, pb.len, 4));
+  TEST_ASSERT_EQUAL_STRING("cm", field_str(p, pb.len, 6));
+  TEST_ASSERT_EQUAL_STRING("distance", field_str(p, pb.len, 9));
+  TEST_ASSERT_EQUAL_INT(ESPH_STATE_CLASS_MEASUREMENT,
+                        (int)field_num(p, pb.len, 10));
+}
+
+void test_list_binary_sensor_fields(void)
+{
+  struct esph_pb_s pb;
+  uint8_t *p = buf + ESPH_HDR_MAX;
+
+  esph_pb_init(&pb, buf, sizeof(buf));
+  TEST_ASSERT_EQUAL_UINT16(ESPH_MSG_LIST_BINARY_SENSOR,
+                           esph_list_entity(&pb, ESPH_ENTITY_PRESENCE, &dev));
+  TEST_ASSERT_EQUAL_STRING("presence", field_str(p, pb.len, 1));
+  TEST_ASSERT_EQUAL_STRING("hallway_presence", field_str(p, pb.len, 4));
+  TEST_ASSERT_EQUAL_STRING("occupancy", field_str(p, pb.len, 5));
+}
+
+void test_frame_overflow_reported(void)
+{
+  uint8_t small[24];
+  struct esph_pb_s pb;
+  uint8_t *start;
+
+  esph_pb_init(&pb, small, sizeof(small));
+  esph_device_info_resp(&pb, &dev);
+  TEST_ASSERT_EQUAL_INT(-E2BIG,
+                        esph_frame_finish(&pb, ESPH_MSG_DEVICE_INFO_RESP,
+                                          &start));
+}
+
+/* ================================================================
+ * Decoding
+ * ================================================================ */
+
+void test_rx_two_messages_one_read(void)
+{
+  const uint8_t in[] =
+  {
+    0x00, 0x00, ESPH_MSG_PING_REQ,
+    0x00, 0x00, ESPH_MSG_DEVICE_INFO_REQ
+  };
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_MSG, esph_rx_feed(&rx, in, sizeof(in),
+                                                  &used));
+  TEST_ASSERT_EQUAL_size_t(3, used);
+  TEST_ASSERT_EQUAL_UINT16(ESPH_MSG_PING_REQ, rx.type);
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_MSG, esph_rx_feed(&rx, in + 3, 3, &used));
+  TEST_ASSERT_EQUAL_UINT16(ESPH_MSG_DEVICE_INFO_REQ, rx.type);
+}
+
+void test_rx_byte_at_a_time(void)
+{
+  const uint8_t hello[] =
+  {
+    0x00, 0x0b, ESPH_MSG_HELLO_REQ,
+    0x0a, 0x09, 'a', 'i', 'o', 'e', 's', 'p', 'h', 'o', 'm'
+  };
+  char client[16];
+  size_t used;
+
+  for (size_t i = 0; i < sizeof(hello) - 1; i++)
+    {
+      TEST_ASSERT_EQUAL_INT(ESPH_RX_MORE,
+                            esph_rx_feed(&rx, &hello[i], 1, &used));
+      TEST_ASSERT_EQUAL_size_t(1, used);
+    }
+
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_MSG,
+                        esph_rx_feed(&rx, &hello[sizeof(hello) - 1], 1,
+                                     &used));
+  TEST_ASSERT_EQUAL_UINT32(11, rx.len);
+  TEST_ASSERT_EQUAL_INT(9, esph_pb_get_string(rx.data, rx.pos, 1, client,
+                                              sizeof(client)));
+  TEST_ASSERT_EQUAL_STRING("aioesphom", client);
+}
+
+void test_rx_two_byte_type(void)
+{
+  const uint8_t in[] = { 0x00, 0x00, 0x90, 0x01 };   /* type 144 */
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_MSG, esph_rx_feed(&rx, in, sizeof(in),
+                                                  &used));
+  TEST_ASSERT_EQUAL_UINT16(144, rx.type);
+}
+
+void test_rx_long_payload_truncated(void)
+{
+  uint8_t in[4 + 200];
+  size_t used;
+
+  memset(in, 'x', sizeof(in));
+  in[0] = 0x00;
+  in[1] = 0xc8;
+  in[2] = 0x01;        /* 200 bytes, type 0x78 ('x') */
+
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_MORE, esph_rx_feed(&rx, in, 100, &used));
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_MORE, esph_rx_feed(&rx, in + 100, 100,
+                                                   &used));
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_MSG, esph_rx_feed(&rx, in + 200, 4, &used));
+  TEST_ASSERT_EQUAL_UINT32(200, rx.len);
+  TEST_ASSERT_EQUAL_UINT8(ESPH_RX_KEEP, rx.pos);
+}
+
+void test_rx_noise_preamble_invalid(void)
+{
+  const uint8_t in[] = { 0x01, 0x00, 0x05 };
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_INVALID, esph_rx_feed(&rx, in, sizeof(in),
+                                                      &used));
+}
+
+void test_rx_oversized_length_invalid(void)
+{
+  const uint8_t in[] = { 0x00, 0xff, 0xff, 0x7f, 0x01 };
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(ESPH_RX_INVALID, esph_rx_feed(&rx, in, sizeof(in),
+                                                      &used));
+}
+
+void test_pb_get_string_skips_other_fields(void)
+{
+  const uint8_t p[] =
+  {
+    0x10, 0x01,                         /* api_version_major = 1 */
+    0x18, 0x0a,                         /* api_version_minor = 10 */
+    0x0a, 0x02, 'H', 'A'                /* client_info */
+  };
+  const uint8_t bad[] = { 0x0a, 0x09, 'H', 'A' };
+  char s[8];
+
+  TEST_ASSERT_EQUAL_INT(2, esph_pb_get_string(p, sizeof(p), 1, s,
+                                              sizeof(s)));
+  TEST_ASSERT_EQUAL_STRING("HA", s);
+  TEST_ASSERT_EQUAL_INT(-1, esph_pb_get_string(p, sizeof(p), 4, s,
+                                               sizeof(s)));
+  TEST_ASSERT_EQUAL_INT(-1, esph_pb_get_string(bad, sizeof(bad), 1, s,
+                                               sizeof(s)));
+}
+
+/* ================================================================
+ * Session over loopback
+ * ================================================================ */
+
+void test_session_over_loopback(void)
+{
+  static struct esph_conn_s c;
+  struct mmwave_data_s d = make_data(LD2410_TARGET_NONE);
+  const uint8_t hello[] = { 0x0a, 0x02, 'H', 'A', 0x10, 0x01, 0x18, 0x0a };
+  int sensors = 0;
+  int binary = 0;
+
+  loopback_open();
+  esph_conn_init(&c, sock_send, &srv_fd);
+
+  TEST_ASSERT_EQUAL_INT(0, exchange(&c, ESPH_MSG_HELLO_REQ, hello,
+                                    sizeof(hello), &d));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_HELLO_RESP, next_msg());
+  TEST_ASSERT_EQUAL_INT(ESPH_API_MAJOR,
+                        (int)field_num(cli_rx.data, cli_rx.pos, 1));
+  TEST_ASSERT_EQUAL_STRING("hallway",
+                           field_str(cli_rx.data, cli_rx.pos, 4));
+  TEST_ASSERT_EQUAL_STRING("HA", c.client);
+
+  TEST_ASSERT_EQUAL_INT(0, exchange(&c, ESPH_MSG_CONNECT_REQ, NULL, 0, &d));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_CONNECT_RESP, next_msg());
+  TEST_ASSERT_EQUAL_UINT32(0, cli_rx.len);
+
+  TEST_ASSERT_EQUAL_INT(0, exchange(&c, ESPH_MSG_DEVICE_INFO_REQ, NULL, 0,
+                                    &d));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_DEVICE_INFO_RESP, next_msg());
+  TEST_ASSERT_EQUAL_STRING("AA:BB:CC:DD:EE:FF",
+                           field_str(cli_rx.data, cli_rx.pos, 3));
+
+  /* ListEntities: one binary sensor, five sensors, then done */
+
+  TEST_ASSERT_EQUAL_INT(0, exchange(&c, ESPH_MSG_LIST_ENTITIES_REQ, NULL, 0,
+                                    &d));
+  for (int type; (type = next_msg()) != ESPH_MSG_LIST_ENTITIES_DONE; )
+    {
+      binary  += type == ESPH_MSG_LIST_BINARY_SENSOR;
+      sensors += type == ESPH_MSG_LIST_SENSOR;
+    }
+
+  TEST_ASSERT_EQUAL_INT(1, binary);
+  TEST_ASSERT_EQUAL_INT(5, sensors);
+
+  /* Subscribe: full snapshot, then quiet until something changes */
+
+  TEST_ASSERT_EQUAL_INT(0, exchange(&c, ESPH_MSG_SUBSCRIBE_STATES_REQ, NULL,
+                                    0, &d));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_BINARY_SENSOR_STATE, next_msg());
+  for (int i = 1; i < (int)ESPH_ENTITY_COUNT; i++)
+    {
+      TEST_ASSERT_EQUAL_INT(ESPH_MSG_SENSOR_STATE, next_msg());
+    }
+
+  TEST_ASSERT_EQUAL_INT(0, esph_conn_push(&c, &d, true));
+  TEST_ASSERT_TRUE(client_idle());
+
+  /* Presence goes out even when sensors are not due */
+
+  d = make_data(LD2410_TARGET_STATIC);
+  d.static_distance = 210;
+  TEST_ASSERT_EQUAL_INT(1, esph_conn_push(&c, &d, false));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_BINARY_SENSOR_STATE, next_msg());
+  TEST_ASSERT_EQUAL_INT(1, (int)field_num(cli_rx.data, cli_rx.pos, 2));
+  TEST_ASSERT_TRUE(client_idle());
+
+  /* The held-back distance change follows when sensors are due */
+
+  TEST_ASSERT_EQUAL_INT(1, esph_conn_push(&c, &d, true));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_SENSOR_STATE, next_msg());
+  TEST_ASSERT_EQUAL_HEX32(esph_key("static_distance"),
+                          (uint32_t)field_num(cli_rx.data, cli_rx.pos, 1));
+
+  TEST_ASSERT_EQUAL_INT(0, exchange(&c, ESPH_MSG_PING_REQ, NULL, 0, &d));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_PING_RESP, next_msg());
+
+  TEST_ASSERT_EQUAL_INT(ESPH_CLOSE, exchange(&c, ESPH_MSG_DISCONNECT_REQ,
+                                             NULL, 0, &d));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_DISCONNECT_RESP, next_msg());
+
+  TEST_ASSERT_EQUAL_UINT32(7, c.rx_msgs);
+  loopback_close();
+}
+
+void test_request_before_hello_rejected(void)
+{
+  static struct esph_conn_s c;
+  const uint8_t in[] = { 0x00, 0x00, ESPH_MSG_LIST_ENTITIES_REQ };
+
+  esph_conn_init(&c, fail_send, NULL);
+  TEST_ASSERT_EQUAL_INT(-EPROTO, esph_conn_input(&c, &dev, NULL, in,
+                                                 sizeof(in)));
+}
+
+void test_unknown_request_ignored(void)
+{
+  static struct esph_conn_s c;
+  uint8_t in[16];
+  size_t n;
+
+  loopback_open();
+  esph_conn_init(&c, sock_send, &srv_fd);
+  n  = request(in, ESPH_MSG_HELLO_REQ, NULL, 0);
+  n += request(in + n, 36, NULL, 0);              /* GetTimeRequest */
+  n += request(in + n, ESPH_MSG_PING_REQ, NULL, 0);
+
+  TEST_ASSERT_EQUAL_INT(0, esph_conn_input(&c, &dev, NULL, in, n));
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_HELLO_RESP, next_msg());
+  TEST_ASSERT_EQUAL_INT(ESPH_MSG_PING_RESP, next_msg());
+  loopback_close();
+}
+
+void test_push_needs_subscription(void)
+{
+  static struct esph_conn_s c;
+  struct mmwave_data_s d = make_data(LD2410_TARGET_BOTH);
+  uint8_t in[8];
+
+  esph_conn_init(&c, fail_send, NULL);
+  TEST_ASSERT_EQUAL_INT(0, esph_conn_push(&c, &d, true));
+
+  /* Subscribed, but the socket is gone: the error surfaces */
+
+  c.state = ESPH_CONN_READY;
+  TEST_ASSERT_EQUAL_INT(-ECONNRESET,
+                        esph_conn_input(&c, &dev, &d, in,
+                                        request(in,
+                                                ESPH_MSG_SUBSCRIBE_STATES_REQ,
+                                                NULL, 0)));
+  TEST_ASSERT_EQUAL_INT(-ECONNRESET, esph_conn_push(&c, &d, true));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Encoding */
+  RUN_TEST(test_varint_sizes);
+  RUN_TEST(test_empty_frame);
+  RUN_TEST(test_hello_response_bytes);
+  RUN_TEST(test_entity_key_is_fnv1);
+  RUN_TEST(test_binary_state_on_and_off);
+  RUN_TEST(test_sensor_state_float);
+  RUN_TEST(test_list_sensor_fields);
+  RUN_TEST(test_list_binary_sensor_fields);
+  RUN_TEST(test_frame_overflow_reported);
+
+  /* Decoding */
+  RUN_TEST(test_rx_two_messages_one_read);
+  RUN_TEST(test_rx_byte_at_a_time);
+  RUN_TEST(test_rx_two_byte_type);
+  RUN_TEST(test_rx_long_payload_truncated);
+  RUN_TEST(test_rx_noise_preamble_invalid);
+  RUN_TEST(test_rx_oversized_length_invalid);
+  RUN_TEST(test_pb_get_string_skips_other_fields);
+
+  /* Session */
+  RUN_TEST(test_session_over_loopback);
+  RUN_TEST(test_request_before_hello_rejected);
+  RUN_TEST(test_unknown_request_ignored);
+  RUN_TEST(test_push_needs_subscription);
+
+  return UNITY_END();
+}
@@ -1,7 +1,8 @@
 /*
  * tests/test_ha_format.c
  *
- * Unit tests for ha_format_state_json() and ha_format_http_request().
+ * Unit tests for ha_format_state_json(), ha_format_http_request() and
+ * the prebuilt ha_request_s header template.
  * Verifies that sensor data is correctly serialized to JSON for HA.
  */
 
@@ -285,6 +286,98 @@ void test_http_request_body_appended(void)
   TEST_ASSERT_NOT_NULL(strstr(http_buf, json_buf));
 }
 
+/* ================================================================
+ * Tests: prebuilt request template
+ * ================================================================ */
+
+static struct ha_request_s req;
+
+static void init_request(const char *token)
+{
+  int ret = ha_request_init(&req, "binary_sensor.mmwave_presence",
+                            "192.168.1.100", 8123, token);
+  TEST_ASSERT_EQUAL_INT(0, ret);
+}
+
+void test_template_ends_with_blank_line(void)
+{
+  init_request("tok");
+
+  TEST_ASSERT_GREATER_THAN(4, req.len);
+  TEST_ASSERT_EQUAL_MEMORY("\r\n\r\n", &req.buf[req.len - 4], 4);
+}
+
+void test_template_has_static_headers(void)
+{
+  init_request("my_secret_token");
+
+  TEST_ASSERT_NOT_NULL(strstr(req.buf,
+    "POST /api/states/binary_sensor.mmwave_presence HTTP/1.1\r\n"));
+  TEST_ASSERT_NOT_NULL(strstr(req.buf, "Host: 192.168.1.100:8123\r\n"));
+  TEST_ASSERT_NOT_NULL(strstr(req.buf,
+    "Authorization: Bearer my_secret_token\r\n"));
+}
+
+void test_template_length_patched_in_place(void)
+{
+  init_request("tok");
+  uint16_t len_before = req.len;
+
+  TEST_ASSERT_EQUAL_INT(0, ha_request_set_length(&req, 187));
+
+  TEST_ASSERT_EQUAL_UINT16(len_before, req.len);
+  TEST_ASSERT_NOT_NULL(strstr(req.buf, "Content-Length: 187 \r\n\r\n"));
+}
+
+void test_template_length_repatch_shorter(void)
+{
+  init_request("tok");
+  ha_request_set_length(&req, 1234);
+  ha_request_set_length(&req, 7);
+
+  TEST_ASSERT_NOT_NULL(strstr(req.buf, "Content-Length: 7   \r\n"));
+}
+
+void test_template_length_too_wide_rejected(void)
+{
+  init_request("tok");
+
+  TEST_ASSERT_EQUAL_INT(-1, ha_request_set_length(&req, 10000));
+}
+
+void test_template_oversized_token_rejected(void)
+{
+  char token[HA_REQUEST_HDR_MAX];
+  memset(token, 'x', sizeof(token) - 1);
+  token[sizeof(token) - 1] = '\0';
+
+  int ret = ha_request_init(&req, "binary_sensor.mmwave_presence",
+                            "192.168.1.100", 8123, token);
+
+  TEST_ASSERT_EQUAL_INT(-1, ret);
+  TEST_ASSERT_EQUAL_INT(-1, ha_request_set_length(&req, 10));
+}
+
+void test_template_matches_reference_request(void)
+{
+  struct mmwave_data_s d = make_data(0x01, 100, 50, 200, 30, 100);
+  int jlen = ha_format_state_json(json_buf, sizeof(json_buf), &d);
+
+  init_request("tok");
+  ha_request_set_length(&req, jlen);
+
+  /* Same bytes on the wire as the single-buffer format, apart from
+   * header order and Content-Length padding */
+
+  char joined[1024];
+  memcpy(joined, req.buf, req.len);
+  memcpy(joined + req.len, json_buf, jlen);
+  joined[req.len + jlen] = '\0';
+
+  TEST_ASSERT_NOT_NULL(strstr(joined, "\r\n\r\n{\"state\":\"on\""));
+  TEST_ASSERT_EQUAL_INT(req.len + jlen, (int)strlen(joined));
+}
+
 /* ================================================================
  * Main
  * ================================================================ */
@@ -327,5 +420,14 @@ int main(void)
   RUN_TEST(test_http_request_has_content_length);
   RUN_TEST(test_http_request_body_appended);
 
+  /* Prebuilt request template */
+  RUN_TEST(test_template_ends_with_blank_line);
+  RUN_TEST(test_template_has_static_headers);
+  RUN_TEST(test_template_length_patched_in_place);
+  RUN_TEST(test_template_length_repatch_shorter);
+  RUN_TEST(test_template_length_too_wide_rejected);
+  RUN_TEST(test_template_oversized_token_rejected);
+  RUN_TEST(test_template_matches_reference_request);
+
   return UNITY_END();
 }
@@ -0,0 +1,249 @@
+/*
+ * tests/test_ha_http.c
+ *
+ * Unit tests for the incremental HTTP response parser
+ * (apps/hactl/ha_http.h).
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/hactl/ha_http.h"
+
+/* ---- Test helpers ---- */
+
+static struct ha_http_resp_s resp;
+
+void setUp(void)
+{
+  ha_http_init(&resp);
+}
+
+void tearDown(void) {}
+
+static int feed_all(const char *s)
+{
+  return ha_http_feed(&resp, s, strlen(s));
+}
+
+/* Feed one byte at a time, as a worst-case recv() split */
+
+static int feed_bytewise(const char *s)
+{
+  int ret = HA_HTTP_MORE;
+
+  for (size_t i = 0; s[i] != '\0' && ret == HA_HTTP_MORE; i++)
+    {
+      ret = ha_http_feed(&resp, &s[i], 1);
+    }
+
+  return ret;
+}
+
+#define RESP_200_LEN \
+  "HTTP/1.1 200 OK\r\n" \
+  "Content-Type: application/json\r\n" \
+  "Content-Length: 14\r\n" \
+  "\r\n" \
+  "{\"state\":\"on\"}"
+
+/* ================================================================
+ * Tests: status line
+ * ================================================================ */
+
+void test_status_200_with_length(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, feed_all(RESP_200_LEN));
+  TEST_ASSERT_EQUAL_UINT16(200, resp.status);
+  TEST_ASSERT_TRUE(ha_http_ok(&resp));
+  TEST_ASSERT_TRUE(resp.keep_alive);
+}
+
+void test_status_201_is_ok(void)
+{
+  feed_all("HTTP/1.1 201 Created\r\nContent-Length: 0\r\n\r\n");
+
+  TEST_ASSERT_EQUAL_UINT16(201, resp.status);
+  TEST_ASSERT_TRUE(ha_http_ok(&resp));
+}
+
+void test_200_in_body_does_not_count(void)
+{
+  int ret = feed_all("HTTP/1.1 401 Unauthorized\r\n"
+                     "X-Request: 200\r\n"
+                     "Content-Length: 12\r\n\r\n"
+                     "error: 200 ?");
+
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, ret);
+  TEST_ASSERT_EQUAL_UINT16(401, resp.status);
+  TEST_ASSERT_FALSE(ha_http_ok(&resp));
+}
+
+void test_garbage_rejected(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_INVALID, feed_all("SSH-2.0-OpenSSH\r\n"));
+  TEST_ASSERT_FALSE(resp.keep_alive);
+}
+
+void test_short_status_code_rejected(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_INVALID, feed_all("HTTP/1.1 20 OK\r\n"));
+}
+
+/* ================================================================
+ * Tests: framing
+ * ================================================================ */
+
+void test_bytewise_feed_matches_bulk(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, feed_bytewise(RESP_200_LEN));
+  TEST_ASSERT_EQUAL_UINT16(200, resp.status);
+  TEST_ASSERT_TRUE(resp.keep_alive);
+}
+
+void test_incomplete_body_needs_more(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_MORE,
+    feed_all("HTTP/1.1 200 OK\r\nContent-Length: 10\r\n\r\n12345"));
+  TEST_ASSERT_TRUE(resp.headers_done);
+  TEST_ASSERT_EQUAL_UINT32(5, resp.remaining);
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, feed_all("67890"));
+}
+
+void test_header_names_case_insensitive(void)
+{
+  int ret = feed_all("HTTP/1.1 200 OK\r\n"
+                     "CONTENT-length: 2\r\n"
+                     "connection: Close\r\n\r\nok");
+
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, ret);
+  TEST_ASSERT_FALSE(resp.keep_alive);
+}
+
+void test_similar_header_name_ignored(void)
+{
+  int ret = feed_all("HTTP/1.1 200 OK\r\n"
+                     "Content-Length-Extra: 999\r\n"
+                     "Content-Length: 0\r\n\r\n");
+
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, ret);
+}
+
+void test_chunked_body_skipped(void)
+{
+  int ret = feed_bytewise("HTTP/1.1 200 OK\r\n"
+                          "Transfer-Encoding: chunked\r\n\r\n"
+                          "5\r\nhello\r\n"
+                          "1A;ext=1\r\nabcdefghijklmnopqrstuvwxyz\r\n"
+                          "0\r\n"
+                          "X-Trailer: yes\r\n"
+                          "\r\n");
+
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, ret);
+  TEST_ASSERT_TRUE(resp.chunked);
+  TEST_ASSERT_TRUE(resp.keep_alive);
+}
+
+void test_bad_chunk_size_rejected(void)
+{
+  int ret = feed_all("HTTP/1.1 200 OK\r\n"
+                     "Transfer-Encoding: chunked\r\n\r\n"
+                     "zz\r\n");
+
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_INVALID, ret);
+}
+
+void test_no_body_for_204(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE,
+                        feed_all("HTTP/1.1 204 No Content\r\n\r\n"));
+}
+
+void test_unframed_body_ends_at_eof(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_MORE,
+    feed_all("HTTP/1.1 200 OK\r\n\r\nsome body"));
+  TEST_ASSERT_FALSE(resp.keep_alive);
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE, ha_http_eof(&resp));
+}
+
+void test_eof_mid_body_is_truncation(void)
+{
+  feed_all("HTTP/1.1 200 OK\r\nContent-Length: 50\r\n\r\npartial");
+
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_INVALID, ha_http_eof(&resp));
+}
+
+/* ================================================================
+ * Tests: connection persistence
+ * ================================================================ */
+
+void test_http10_closes_by_default(void)
+{
+  feed_all("HTTP/1.0 200 OK\r\nContent-Length: 0\r\n\r\n");
+
+  TEST_ASSERT_FALSE(resp.keep_alive);
+}
+
+void test_http10_keep_alive_opt_in(void)
+{
+  feed_all("HTTP/1.0 200 OK\r\nConnection: Keep-Alive\r\n"
+           "Content-Length: 0\r\n\r\n");
+
+  TEST_ASSERT_TRUE(resp.keep_alive);
+}
+
+void test_trailing_bytes_prevent_reuse(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_COMPLETE,
+    feed_all("HTTP/1.1 200 OK\r\nContent-Length: 2\r\n\r\nokEXTRA"));
+  TEST_ASSERT_FALSE(resp.keep_alive);
+}
+
+void test_huge_content_length_rejected(void)
+{
+  TEST_ASSERT_EQUAL_INT(HA_HTTP_INVALID,
+    feed_all("HTTP/1.1 200 OK\r\nContent-Length: 99999999999\r\n\r\n"));
+}
+
+void test_parser_state_is_small(void)
+{
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(24, sizeof(struct ha_http_resp_s));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Status line */
+  RUN_TEST(test_status_200_with_length);
+  RUN_TEST(test_status_201_is_ok);
+  RUN_TEST(test_200_in_body_does_not_count);
+  RUN_TEST(test_garbage_rejected);
+  RUN_TEST(test_short_status_code_rejected);
+
+  /* Framing */
+  RUN_TEST(test_bytewise_feed_matches_bulk);
+  RUN_TEST(test_incomplete_body_needs_more);
+  RUN_TEST(test_header_names_case_insensitive);
+  RUN_TEST(test_similar_header_name_ignored);
+  RUN_TEST(test_chunked_body_skipped);
+  RUN_TEST(test_bad_chunk_size_rejected);
+  RUN_TEST(test_no_body_for_204);
+  RUN_TEST(test_unframed_body_ends_at_eof);
+  RUN_TEST(test_eof_mid_body_is_truncation);
+
+  /* Persistence */
+  RUN_TEST(test_http10_closes_by_default);
+  RUN_TEST(test_http10_keep_alive_opt_in);
+  RUN_TEST(test_trailing_bytes_prevent_reuse);
+  RUN_TEST(test_huge_content_length_rejected);
+  RUN_TEST(test_parser_state_is_small);
+
+  return UNITY_END();
+}
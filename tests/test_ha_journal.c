@@ -0,0 +1,402 @@
+/*
+ * tests/test_ha_journal.c
+ *
+ * Unit tests for the offline presence journal (apps/hactl/ha_journal.h):
+ * batching into flash, spilling a quiet outage, replay order and acks,
+ * picking the file up after a reboot (ack markers, torn and corrupt
+ * blocks), a full file, and the replay JSON. The file is a RAM buffer
+ * that counts writes and can be made to fail.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/hactl/ha_journal.h"
+
+/* ---- Test helpers ---- */
+
+#define FILE_MAX   2048
+#define SPILL_MS   60000
+
+struct ram_file_s
+{
+  uint8_t  data[FILE_MAX];
+  uint32_t len;
+  int      fail_append;        /* Next append fails after this many bytes */
+  uint32_t erases;
+};
+
+static struct ram_file_s g_file;
+static struct ha_journal_s g_j;
+
+static int ram_append(void *priv, const uint8_t *buf, size_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (f->fail_append >= 0)
+    {
+      size_t n = (size_t)f->fail_append < len ? (size_t)f->fail_append : len;
+
+      memcpy(f->data + f->len, buf, n);
+      f->len += n;
+      f->fail_append = -1;
+      return -EIO;
+    }
+
+  if (f->len + len > FILE_MAX)
+    {
+      return -ENOSPC;
+    }
+
+  memcpy(f->data + f->len, buf, len);
+  f->len += len;
+  return 0;
+}
+
+static ssize_t ram_read(void *priv, uint32_t off, uint8_t *buf, size_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (off >= f->len)
+    {
+      return 0;
+    }
+
+  if (len > f->len - off)
+    {
+      len = f->len - off;
+    }
+
+  memcpy(buf, f->data + off, len);
+  return (ssize_t)len;
+}
+
+static int ram_truncate(void *priv, uint32_t len)
+{
+  struct ram_file_s *f = priv;
+
+  if (len < f->len)
+    {
+      f->len = len;
+    }
+
+  return 0;
+}
+
+static int ram_erase(void *priv)
+{
+  struct ram_file_s *f = priv;
+
+  f->len = 0;
+  f->erases++;
+  return 0;
+}
+
+static const struct ha_journal_io_s g_io =
+{
+  ram_append, ram_read, ram_truncate, ram_erase, &g_file
+};
+
+static void log_n(int n, uint32_t ts)
+{
+  for (int i = 0; i < n; i++)
+    {
+      struct mmwave_data_s d;
+
+      memset(&d, 0, sizeof(d));
+      d.target_state       = (uint8_t)((ts + i) & 1 ? LD2410_TARGET_MOTION :
+                                                      LD2410_TARGET_NONE);
+      d.detection_distance = (uint16_t)(ts + i);
+      ha_journal_log(&g_j, &d, ts + i, 0);
+    }
+}
+
+/* Simulate a reboot: fresh state over the same file */
+
+static uint32_t reboot(void)
+{
+  ha_journal_init(&g_j, &g_io, FILE_MAX, SPILL_MS);
+  return ha_journal_load(&g_j);
+}
+
+void setUp(void)
+{
+  memset(&g_file, 0, sizeof(g_file));
+  g_file.fail_append = -1;
+  ha_journal_init(&g_j, &g_io, FILE_MAX, SPILL_MS);
+}
+
+void tearDown(void) {}
+
+/* ---- Recording ---- */
+
+static void test_below_batch_stays_in_ram(void)
+{
+  log_n(HA_JOURNAL_BATCH - 1, 100);
+
+  TEST_ASSERT_EQUAL_UINT32(0, g_j.stats.writes);
+  TEST_ASSERT_EQUAL_UINT32(0, g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_BATCH - 1, ha_journal_pending(&g_j));
+}
+
+static void test_full_batch_is_one_write(void)
+{
+  log_n(3 * HA_JOURNAL_BATCH, 100);
+
+  TEST_ASSERT_EQUAL_UINT32(3, g_j.stats.writes);
+  TEST_ASSERT_EQUAL_UINT32(3 * (HA_JOURNAL_HDR_SIZE + HA_JOURNAL_BATCH *
+                                HA_JOURNAL_REC_SIZE), g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(3 * HA_JOURNAL_BATCH, g_j.flash_count);
+  TEST_ASSERT_EQUAL_UINT32(0, g_j.ram_count);
+
+  /* 8 header bytes per 128 bytes of records */
+
+  TEST_ASSERT_EQUAL_UINT32(106, ha_journal_wa_x100(&g_j.stats));
+}
+
+static void test_quiet_outage_spills_after_spill_ms(void)
+{
+  struct mmwave_data_s d;
+
+  memset(&d, 0, sizeof(d));
+  ha_journal_log(&g_j, &d, 1, 1000);
+  ha_journal_log(&g_j, &d, 2, 5000);
+
+  ha_journal_tick(&g_j, 1000 + SPILL_MS - 1);
+  TEST_ASSERT_EQUAL_UINT32(0, g_j.stats.writes);
+
+  ha_journal_tick(&g_j, 1000 + SPILL_MS);
+  TEST_ASSERT_EQUAL_UINT32(1, g_j.stats.writes);
+  TEST_ASSERT_EQUAL_UINT32(2, g_j.flash_count);
+  TEST_ASSERT_EQUAL_UINT32(0, g_j.ram_count);
+}
+
+static void test_failed_write_keeps_records_and_cuts_partial(void)
+{
+  log_n(HA_JOURNAL_BATCH - 1, 100);
+  g_file.fail_append = 20;
+  log_n(1, 200);
+
+  TEST_ASSERT_EQUAL_UINT32(0, g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_BATCH, g_j.ram_count);
+
+  log_n(1, 300);                       /* Retried with the next record */
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_BATCH, g_j.flash_count);
+  TEST_ASSERT_EQUAL_UINT32(1, g_j.ram_count);
+}
+
+/* ---- Replay ---- */
+
+static void test_replay_oldest_first_flash_then_ram(void)
+{
+  struct ha_journal_rec_s recs[64];
+  uint32_t seq;
+
+  log_n(HA_JOURNAL_BATCH + 3, 100);
+
+  int n = ha_journal_peek(&g_j, recs, 64, &seq);
+
+  TEST_ASSERT_EQUAL(HA_JOURNAL_BATCH + 3, n);
+  TEST_ASSERT_EQUAL_UINT32(0, seq);
+  for (int i = 0; i < n; i++)
+    {
+      TEST_ASSERT_EQUAL_UINT32(100 + i, recs[i].ts);
+      TEST_ASSERT_EQUAL_UINT16(100 + i, recs[i].distance);
+    }
+}
+
+static void test_partial_ack_writes_marker_full_ack_erases(void)
+{
+  struct ha_journal_rec_s recs[8];
+  uint32_t seq;
+  uint32_t len;
+
+  log_n(2 * HA_JOURNAL_BATCH, 100);
+  len = g_file.len;
+
+  int n = ha_journal_peek(&g_j, recs, 8, &seq);
+  ha_journal_ack(&g_j, seq, n, 20);
+
+  TEST_ASSERT_EQUAL_UINT32(len + HA_JOURNAL_HDR_SIZE, g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(2 * HA_JOURNAL_BATCH - 8,
+                           ha_journal_pending(&g_j));
+
+  n = ha_journal_peek(&g_j, recs, 8, &seq);
+  TEST_ASSERT_EQUAL_UINT32(8, seq);
+  TEST_ASSERT_EQUAL_UINT32(108, recs[0].ts);
+
+  while ((n = ha_journal_peek(&g_j, recs, 8, &seq)) > 0)
+    {
+      ha_journal_ack(&g_j, seq, n, 20);
+    }
+
+  TEST_ASSERT_EQUAL_UINT32(0, ha_journal_pending(&g_j));
+  TEST_ASSERT_EQUAL_UINT32(0, g_file.len);
+  TEST_ASSERT_EQUAL_UINT32(1, g_file.erases);
+  TEST_ASSERT_EQUAL_UINT32(2 * HA_JOURNAL_BATCH, g_j.stats.replayed);
+  TEST_ASSERT_EQUAL_UINT32(4, g_j.stats.batches);
+  TEST_ASSERT_EQUAL_UINT32(400, ha_journal_rate(&g_j.stats));
+}
+
+static void test_ack_spanning_flash_and_ram(void)
+{
+  struct ha_journal_rec_s recs[64];
+  uint32_t seq;
+
+  log_n(HA_JOURNAL_BATCH + 5, 100);
+
+  int n = ha_journal_peek(&g_j, recs, 64, &seq);
+  ha_journal_ack(&g_j, seq, n, 10);
+
+  TEST_ASSERT_EQUAL_UINT32(0, ha_journal_pending(&g_j));
+  TEST_ASSERT_EQUAL_UINT32(0, g_file.len);
+}
+
+/* ---- After a reboot ---- */
+
+static void test_reboot_resumes_after_last_marker(void)
+{
+  struct ha_journal_rec_s recs[8];
+  uint32_t seq;
+
+  log_n(2 * HA_JOURNAL_BATCH + 2, 100);  /* 2 still in RAM: lost */
+
+  int n = ha_journal_peek(&g_j, recs, 8, &seq);
+  ha_journal_ack(&g_j, seq, n, 20);
+
+  TEST_ASSERT_EQUAL_UINT32(2 * HA_JOURNAL_BATCH - 8, reboot());
+
+  n = ha_journal_peek(&g_j, recs, 8, &seq);
+  TEST_ASSERT_EQUAL(8, n);
+  TEST_ASSERT_EQUAL_UINT32(8, seq);
+  TEST_ASSERT_EQUAL_UINT32(108, recs[0].ts);
+
+  /* Numbering carries on after what is in the file */
+
+  log_n(1, 900);
+  TEST_ASSERT_EQUAL_UINT32(2 * HA_JOURNAL_BATCH + 1, g_j.next_seq);
+}
+
+static void test_reboot_cuts_torn_block(void)
+{
+  log_n(HA_JOURNAL_BATCH, 100);
+
+  uint32_t good = g_file.len;
+
+  memcpy(g_file.data + good, g_file.data, 30);   /* Half a block */
+  g_file.len += 30;
+
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_BATCH, reboot());
+  TEST_ASSERT_EQUAL_UINT32(good, g_file.len);
+}
+
+static void test_reboot_stops_at_corrupt_block(void)
+{
+  log_n(2 * HA_JOURNAL_BATCH, 100);
+
+  g_file.data[HA_JOURNAL_HDR_SIZE + HA_JOURNAL_BATCH *
+              HA_JOURNAL_REC_SIZE + 12] ^= 0x40;
+
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_BATCH, reboot());
+}
+
+static void test_reboot_with_everything_acked_erases(void)
+{
+  struct ha_journal_rec_s recs[64];
+  uint32_t seq;
+
+  log_n(HA_JOURNAL_BATCH, 100);
+
+  /* Ack marker reached flash but the erase did not */
+
+  uint8_t hdr[HA_JOURNAL_HDR_SIZE];
+  ha_journal_seal(hdr, 0, HA_JOURNAL_BATCH);
+  ram_append(&g_file, hdr, sizeof(hdr));
+
+  TEST_ASSERT_EQUAL_UINT32(0, reboot());
+  TEST_ASSERT_EQUAL_UINT32(0, g_file.len);
+  TEST_ASSERT_EQUAL(0, ha_journal_peek(&g_j, recs, 64, &seq));
+}
+
+/* ---- Full file ---- */
+
+static void test_full_file_drops_oldest_in_ram_and_splits_batch(void)
+{
+  struct ha_journal_rec_s recs[64];
+  uint32_t seq;
+  size_t block = HA_JOURNAL_HDR_SIZE + HA_JOURNAL_BATCH *
+                 HA_JOURNAL_REC_SIZE;
+
+  g_j.cap = block;                      /* Room for one batch */
+  log_n(HA_JOURNAL_BATCH + HA_JOURNAL_RAM + 4, 100);
+
+  TEST_ASSERT_EQUAL_UINT32(4, g_j.stats.dropped);
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_BATCH, g_j.flash_count);
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_RAM, g_j.ram_count);
+
+  /* Flash holds 0..15, RAM 20..51: two batches, never one across */
+
+  int n = ha_journal_peek(&g_j, recs, 64, &seq);
+  TEST_ASSERT_EQUAL(HA_JOURNAL_BATCH, n);
+  TEST_ASSERT_EQUAL_UINT32(0, seq);
+  ha_journal_ack(&g_j, seq, n, 10);
+
+  n = ha_journal_peek(&g_j, recs, 64, &seq);
+  TEST_ASSERT_EQUAL(HA_JOURNAL_RAM, n);
+  TEST_ASSERT_EQUAL_UINT32(HA_JOURNAL_BATCH + 4, seq);
+  TEST_ASSERT_EQUAL_UINT32(100 + HA_JOURNAL_BATCH + 4, recs[0].ts);
+}
+
+/* ---- Replay document ---- */
+
+static void test_replay_json(void)
+{
+  char buf[160];
+  struct json_buf_s out =
+  {
+    buf, sizeof(buf), 0
+  };
+
+  struct json_writer_s w;
+  struct ha_journal_rec_s recs[2] =
+  {
+    { 1700000000, 150, LD2410_TARGET_MOTION },
+    { 1700000042, 0, LD2410_TARGET_NONE }
+  };
+
+  json_init(&w, json_sink_buf, &out);
+  json_begin_object(&w, NULL);
+  ha_journal_json(&w, "hall", 7, 1700000100, recs, 2);
+  json_end_object(&w);
+  json_finish_buf(&w, &out);
+
+  TEST_ASSERT_EQUAL_STRING("{\"node\":\"hall\",\"seq\":7,\"now\":1700000100,"
+                           "\"transitions\":[[1700000000,1,150],"
+                           "[1700000042,0,0]]}", buf);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_below_batch_stays_in_ram);
+  RUN_TEST(test_full_batch_is_one_write);
+  RUN_TEST(test_quiet_outage_spills_after_spill_ms);
+  RUN_TEST(test_failed_write_keeps_records_and_cuts_partial);
+
+  RUN_TEST(test_replay_oldest_first_flash_then_ram);
+  RUN_TEST(test_partial_ack_writes_marker_full_ack_erases);
+  RUN_TEST(test_ack_spanning_flash_and_ram);
+
+  RUN_TEST(test_reboot_resumes_after_last_marker);
+  RUN_TEST(test_reboot_cuts_torn_block);
+  RUN_TEST(test_reboot_stops_at_corrupt_block);
+  RUN_TEST(test_reboot_with_everything_acked_erases);
+
+  RUN_TEST(test_full_file_drops_oldest_in_ram_and_splits_batch);
+
+  RUN_TEST(test_replay_json);
+
+  return UNITY_END();
+}
@@ -0,0 +1,484 @@
+/*
+ * tests/test_ha_mqtt.c
+ *
+ * Unit tests for the hactl MQTT 3.1.1 codec and Home Assistant
+ * discovery payloads (apps/hactl/ha_mqtt.h).
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/hactl/ha_mqtt.h"
+
+/* ---- Test helpers ---- */
+
+static uint8_t pkt[512];
+static char    out[1024];
+static struct ha_mqtt_rx_s rx;
+
+static struct mmwave_data_s make_data(uint8_t state, uint8_t me, uint8_t se,
+                                      uint16_t md, uint16_t sd, uint16_t dd)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state       = state;
+  d.motion_energy      = me;
+  d.static_energy      = se;
+  d.motion_distance    = md;
+  d.static_distance    = sd;
+  d.detection_distance = dd;
+  return d;
+}
+
+/* Feed a whole buffer, expecting exactly one packet at its end */
+
+static int feed_all(const uint8_t *buf, size_t len)
+{
+  size_t used = 0;
+  int ret = ha_mqtt_rx_feed(&rx, buf, len, &used);
+
+  TEST_ASSERT_EQUAL_UINT(len, used);
+  return ret;
+}
+
+void setUp(void)
+{
+  memset(pkt, 0xaa, sizeof(pkt));
+  memset(out, 0, sizeof(out));
+  ha_mqtt_rx_init(&rx);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Tests: Remaining Length varint
+ * ================================================================ */
+
+void test_length_boundaries(void)
+{
+  TEST_ASSERT_EQUAL_INT(1, ha_mqtt_put_length(pkt, 0));
+  TEST_ASSERT_EQUAL_HEX8(0x00, pkt[0]);
+
+  TEST_ASSERT_EQUAL_INT(1, ha_mqtt_put_length(pkt, 127));
+  TEST_ASSERT_EQUAL_HEX8(0x7f, pkt[0]);
+
+  TEST_ASSERT_EQUAL_INT(2, ha_mqtt_put_length(pkt, 128));
+  TEST_ASSERT_EQUAL_HEX8(0x80, pkt[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x01, pkt[1]);
+
+  TEST_ASSERT_EQUAL_INT(2, ha_mqtt_put_length(pkt, 16383));
+  TEST_ASSERT_EQUAL_INT(3, ha_mqtt_put_length(pkt, 16384));
+  TEST_ASSERT_EQUAL_INT(4, ha_mqtt_put_length(pkt, MQTT_MAX_REMAINING));
+  TEST_ASSERT_EQUAL_INT(-1, ha_mqtt_put_length(pkt, MQTT_MAX_REMAINING + 1));
+}
+
+void test_length_size_matches_encoder(void)
+{
+  static const uint32_t v[] = { 0, 127, 128, 16383, 16384, 2097151,
+                                2097152, MQTT_MAX_REMAINING };
+
+  for (size_t i = 0; i < sizeof(v) / sizeof(v[0]); i++)
+    {
+      TEST_ASSERT_EQUAL_INT(ha_mqtt_put_length(pkt, v[i]),
+                            ha_mqtt_length_size(v[i]));
+    }
+}
+
+/* ================================================================
+ * Tests: CONNECT
+ * ================================================================ */
+
+void test_connect_minimal(void)
+{
+  static const uint8_t expect[] =
+  {
+    0x10, 16,
+    0, 4, 'M', 'Q', 'T', 'T', 4, 0x02, 0, 60,
+    0, 4, 'n', 'o', 'd', 'e'
+  };
+
+  struct ha_mqtt_connect_s c;
+  memset(&c, 0, sizeof(c));
+  c.client_id   = "node";
+  c.keepalive_s = 60;
+
+  int n = ha_mqtt_connect(pkt, sizeof(pkt), &c);
+
+  TEST_ASSERT_EQUAL_INT(sizeof(expect), n);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, pkt, sizeof(expect));
+}
+
+void test_connect_will_and_credentials(void)
+{
+  static const uint8_t expect[] =
+  {
+    0x10, 34,
+    0, 4, 'M', 'Q', 'T', 'T', 4, 0xEE, 0, 30,
+    0, 1, 'n',
+    0, 3, 'a', '/', 's',
+    0, 7, 'o', 'f', 'f', 'l', 'i', 'n', 'e',
+    0, 1, 'u',
+    0, 2, 'p', 'w'
+  };
+
+  struct ha_mqtt_connect_s c;
+  memset(&c, 0, sizeof(c));
+  c.client_id   = "n";
+  c.username    = "u";
+  c.password    = "pw";
+  c.will_topic  = "a/s";
+  c.will_msg    = HA_MQTT_OFFLINE;
+  c.will_qos1   = true;
+  c.will_retain = true;
+  c.keepalive_s = 30;
+
+  int n = ha_mqtt_connect(pkt, sizeof(pkt), &c);
+
+  /* flags: user|pass|will retain|will qos1|will|clean = 0xEE */
+
+  TEST_ASSERT_EQUAL_INT(sizeof(expect), n);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, pkt, sizeof(expect));
+}
+
+void test_connect_empty_username_omitted(void)
+{
+  struct ha_mqtt_connect_s c;
+  memset(&c, 0, sizeof(c));
+  c.client_id = "n";
+  c.username  = "";
+  c.password  = "ignored";
+
+  int n = ha_mqtt_connect(pkt, sizeof(pkt), &c);
+
+  TEST_ASSERT_EQUAL_INT(15, n);
+  TEST_ASSERT_EQUAL_HEX8(MQTT_CONNECT_CLEAN, pkt[9]);
+}
+
+void test_connect_too_small(void)
+{
+  struct ha_mqtt_connect_s c;
+  memset(&c, 0, sizeof(c));
+  c.client_id = "node";
+
+  TEST_ASSERT_EQUAL_INT(-1, ha_mqtt_connect(pkt, 17, &c));
+  TEST_ASSERT_EQUAL_INT(18, ha_mqtt_connect(pkt, 18, &c));
+}
+
+/* ================================================================
+ * Tests: PUBLISH header
+ * ================================================================ */
+
+void test_publish_qos0_header(void)
+{
+  static const uint8_t expect[] =
+  {
+    0x30, 2 + 3 + 5,
+    0, 3, 'a', '/', 'b'
+  };
+
+  int n = ha_mqtt_publish_header(pkt, sizeof(pkt), "a/b", 5, false,
+                                 false, 0);
+
+  TEST_ASSERT_EQUAL_INT(sizeof(expect), n);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, pkt, sizeof(expect));
+}
+
+void test_publish_qos1_retained_has_pid(void)
+{
+  static const uint8_t expect[] =
+  {
+    0x33, 2 + 3 + 2 + 5,
+    0, 3, 'a', '/', 'b',
+    0x12, 0x34
+  };
+
+  int n = ha_mqtt_publish_header(pkt, sizeof(pkt), "a/b", 5, true, true,
+                                 0x1234);
+
+  TEST_ASSERT_EQUAL_INT(sizeof(expect), n);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, pkt, sizeof(expect));
+}
+
+void test_publish_long_payload_two_byte_length(void)
+{
+  int n = ha_mqtt_publish_header(pkt, sizeof(pkt), "a/b", 400, false,
+                                 false, 0);
+
+  /* 2 + 3 + 400 = 405 = 0x95 0x03 */
+
+  TEST_ASSERT_EQUAL_INT(8, n);
+  TEST_ASSERT_EQUAL_HEX8(0x95, pkt[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x03, pkt[2]);
+  TEST_ASSERT_EQUAL_HEX8('a', pkt[5]);
+}
+
+void test_publish_header_too_small(void)
+{
+  TEST_ASSERT_EQUAL_INT(-1, ha_mqtt_publish_header(pkt, 8, "a/b", 5, true,
+                                                   false, 1));
+  TEST_ASSERT_EQUAL_INT(9, ha_mqtt_publish_header(pkt, 9, "a/b", 5, true,
+                                                  false, 1));
+}
+
+void test_pid_skips_zero(void)
+{
+  uint16_t pid = 65534;
+
+  TEST_ASSERT_EQUAL_UINT16(65535, ha_mqtt_next_pid(&pid));
+  TEST_ASSERT_EQUAL_UINT16(1, ha_mqtt_next_pid(&pid));
+  TEST_ASSERT_EQUAL_UINT16(2, ha_mqtt_next_pid(&pid));
+}
+
+void test_ping_and_disconnect(void)
+{
+  TEST_ASSERT_EQUAL_INT(2, ha_mqtt_simple(pkt, MQTT_PKT_PINGREQ));
+  TEST_ASSERT_EQUAL_HEX8(0xC0, pkt[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x00, pkt[1]);
+
+  ha_mqtt_simple(pkt, MQTT_PKT_DISCONNECT);
+  TEST_ASSERT_EQUAL_HEX8(0xE0, pkt[0]);
+}
+
+/* ================================================================
+ * Tests: incoming packets
+ * ================================================================ */
+
+void test_rx_connack_accepted(void)
+{
+  static const uint8_t in[] = { 0x20, 0x02, 0x00, 0x00 };
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_PACKET, feed_all(in, sizeof(in)));
+  TEST_ASSERT_EQUAL_INT(0, ha_mqtt_connack_rc(&rx));
+}
+
+void test_rx_connack_refused(void)
+{
+  static const uint8_t in[] = { 0x20, 0x02, 0x00, 0x05 };
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_PACKET, feed_all(in, sizeof(in)));
+  TEST_ASSERT_EQUAL_INT(5, ha_mqtt_connack_rc(&rx));
+  TEST_ASSERT_EQUAL_INT(-1, ha_mqtt_puback_pid(&rx));
+}
+
+void test_rx_puback_byte_at_a_time(void)
+{
+  static const uint8_t in[] = { 0x40, 0x02, 0xbe, 0xef };
+  size_t used;
+
+  for (size_t i = 0; i < sizeof(in) - 1; i++)
+    {
+      TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_MORE,
+                            ha_mqtt_rx_feed(&rx, &in[i], 1, &used));
+      TEST_ASSERT_EQUAL_UINT(1, used);
+    }
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_PACKET,
+                        ha_mqtt_rx_feed(&rx, &in[3], 1, &used));
+  TEST_ASSERT_EQUAL_INT(0xbeef, ha_mqtt_puback_pid(&rx));
+}
+
+void test_rx_two_packets_in_one_read(void)
+{
+  static const uint8_t in[] = { 0x40, 0x02, 0x00, 0x07, 0xd0, 0x00 };
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_PACKET,
+                        ha_mqtt_rx_feed(&rx, in, sizeof(in), &used));
+  TEST_ASSERT_EQUAL_UINT(4, used);
+  TEST_ASSERT_EQUAL_INT(7, ha_mqtt_puback_pid(&rx));
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_PACKET,
+                        ha_mqtt_rx_feed(&rx, in + used, sizeof(in) - used,
+                                        &used));
+  TEST_ASSERT_EQUAL_UINT(2, used);
+  TEST_ASSERT_EQUAL_HEX8(MQTT_PKT_PINGRESP, ha_mqtt_rx_type(&rx));
+}
+
+void test_rx_skips_long_packet(void)
+{
+  uint8_t in[3 + 300 + 2];
+  size_t used;
+
+  /* PUBLISH with a 300-byte body, then PINGRESP */
+
+  in[0] = 0x30;
+  in[1] = 0xac;
+  in[2] = 0x02;
+  memset(&in[3], 'x', 300);
+  in[303] = 0xd0;
+  in[304] = 0x00;
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_PACKET,
+                        ha_mqtt_rx_feed(&rx, in, sizeof(in), &used));
+  TEST_ASSERT_EQUAL_UINT(303, used);
+  TEST_ASSERT_EQUAL_HEX8(MQTT_PKT_PUBLISH, ha_mqtt_rx_type(&rx));
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_PACKET,
+                        ha_mqtt_rx_feed(&rx, in + used, 2, &used));
+  TEST_ASSERT_EQUAL_HEX8(MQTT_PKT_PINGRESP, ha_mqtt_rx_type(&rx));
+}
+
+void test_rx_five_byte_length_invalid(void)
+{
+  static const uint8_t in[] = { 0x30, 0xff, 0xff, 0xff, 0xff, 0x01 };
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(HA_MQTT_RX_INVALID,
+                        ha_mqtt_rx_feed(&rx, in, sizeof(in), &used));
+}
+
+/* ================================================================
+ * Tests: Home Assistant topics and payloads
+ * ================================================================ */
+
+void test_node_id_validation(void)
+{
+  TEST_ASSERT_TRUE(ha_mqtt_node_valid("mmwave"));
+  TEST_ASSERT_TRUE(ha_mqtt_node_valid("Living_room-2"));
+  TEST_ASSERT_FALSE(ha_mqtt_node_valid(""));
+  TEST_ASSERT_FALSE(ha_mqtt_node_valid("a/b"));
+  TEST_ASSERT_FALSE(ha_mqtt_node_valid("a+b"));
+  TEST_ASSERT_FALSE(ha_mqtt_node_valid("a#"));
+  TEST_ASSERT_FALSE(ha_mqtt_node_valid("quote\""));
+  TEST_ASSERT_FALSE(ha_mqtt_node_valid(
+    "abcdefghijklmnopqrstuvwxyz0123456"));
+}
+
+void test_topics(void)
+{
+  TEST_ASSERT_GREATER_THAN(0, ha_mqtt_node_topic(out, HA_MQTT_TOPIC_MAX,
+                                                 "hall", "status"));
+  TEST_ASSERT_EQUAL_STRING("mmwave/hall/status", out);
+
+  TEST_ASSERT_GREATER_THAN(0, ha_mqtt_config_topic(out, HA_MQTT_TOPIC_MAX,
+                                                   "hall",
+                                                   &g_ha_mqtt_entities[0]));
+  TEST_ASSERT_EQUAL_STRING(
+    "homeassistant/binary_sensor/hall/presence/config", out);
+
+  TEST_ASSERT_EQUAL_INT(-1, ha_mqtt_node_topic(out, 8, "hall", "status"));
+}
+
+void test_discovery_binary_sensor(void)
+{
+  struct json_buf_s b = { out, sizeof(out), 0 };
+  struct json_writer_s w;
+
+  json_init(&w, json_sink_buf, &b);
+  ha_mqtt_discovery_json(&w, "hall", &g_ha_mqtt_entities[0]);
+  TEST_ASSERT_GREATER_THAN(0, json_finish_buf(&w, &b));
+
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"name\":\"Presence\","
+    "\"unique_id\":\"hall_presence\","
+    "\"object_id\":\"hall_presence\","
+    "\"state_topic\":\"mmwave/hall/state\","
+    "\"value_template\":\"{{ value_json.presence }}\","
+    "\"payload_on\":\"on\",\"payload_off\":\"off\","
+    "\"device_class\":\"occupancy\","
+    "\"availability_topic\":\"mmwave/hall/status\","
+    "\"device\":{\"identifiers\":[\"hall\"],\"name\":\"mmWave Presence\","
+    "\"model\":\"LD2410\",\"manufacturer\":\"mmWave OS\"}}", out);
+}
+
+void test_discovery_sensors_have_units(void)
+{
+  for (size_t i = 1; i < HA_MQTT_ENTITY_COUNT; i++)
+    {
+      struct json_buf_s b = { out, sizeof(out), 0 };
+      struct json_writer_s w;
+
+      json_init(&w, json_sink_buf, &b);
+      ha_mqtt_discovery_json(&w, "hall", &g_ha_mqtt_entities[i]);
+      TEST_ASSERT_GREATER_THAN(0, json_finish_buf(&w, &b));
+
+      TEST_ASSERT_NOT_NULL(strstr(out, "\"unit_of_measurement\":"));
+      TEST_ASSERT_NOT_NULL(strstr(out, "\"state_class\":\"measurement\""));
+      TEST_ASSERT_NULL(strstr(out, "payload_on"));
+    }
+}
+
+void test_discovery_keys_match_state_payload(void)
+{
+  char state[256];
+  struct mmwave_data_s d = make_data(LD2410_TARGET_MOTION, 1, 2, 3, 4, 5);
+
+  TEST_ASSERT_GREATER_THAN(0, ha_mqtt_state_json(state, sizeof(state), &d));
+
+  for (size_t i = 0; i < HA_MQTT_ENTITY_COUNT; i++)
+    {
+      char key[40];
+      snprintf(key, sizeof(key), "\"%s\":", g_ha_mqtt_entities[i].object);
+      TEST_ASSERT_NOT_NULL_MESSAGE(strstr(state, key),
+                                   g_ha_mqtt_entities[i].object);
+    }
+}
+
+void test_state_payload(void)
+{
+  struct mmwave_data_s d = make_data(LD2410_TARGET_BOTH, 80, 40, 150, 200,
+                                     120);
+
+  int n = ha_mqtt_state_json(out, sizeof(out), &d);
+
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"presence\":\"on\",\"target\":\"motion+static\","
+    "\"motion_energy\":80,\"static_energy\":40,"
+    "\"motion_distance\":150,\"static_distance\":200,"
+    "\"detection_distance\":120}", out);
+  TEST_ASSERT_EQUAL_INT((int)strlen(out), n);
+}
+
+void test_state_payload_truncation(void)
+{
+  struct mmwave_data_s d = make_data(LD2410_TARGET_NONE, 0, 0, 0, 0, 0);
+
+  TEST_ASSERT_EQUAL_INT(-1, ha_mqtt_state_json(out, 20, &d));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Remaining Length */
+  RUN_TEST(test_length_boundaries);
+  RUN_TEST(test_length_size_matches_encoder);
+
+  /* CONNECT */
+  RUN_TEST(test_connect_minimal);
+  RUN_TEST(test_connect_will_and_credentials);
+  RUN_TEST(test_connect_empty_username_omitted);
+  RUN_TEST(test_connect_too_small);
+
+  /* PUBLISH */
+  RUN_TEST(test_publish_qos0_header);
+  RUN_TEST(test_publish_qos1_retained_has_pid);
+  RUN_TEST(test_publish_long_payload_two_byte_length);
+  RUN_TEST(test_publish_header_too_small);
+  RUN_TEST(test_pid_skips_zero);
+  RUN_TEST(test_ping_and_disconnect);
+
+  /* Incoming */
+  RUN_TEST(test_rx_connack_accepted);
+  RUN_TEST(test_rx_connack_refused);
+  RUN_TEST(test_rx_puback_byte_at_a_time);
+  RUN_TEST(test_rx_two_packets_in_one_read);
+  RUN_TEST(test_rx_skips_long_packet);
+  RUN_TEST(test_rx_five_byte_length_invalid);
+
+  /* Home Assistant */
+  RUN_TEST(test_node_id_validation);
+  RUN_TEST(test_topics);
+  RUN_TEST(test_discovery_binary_sensor);
+  RUN_TEST(test_discovery_sensors_have_units);
+  RUN_TEST(test_discovery_keys_match_state_payload);
+  RUN_TEST(test_state_payload);
+  RUN_TEST(test_state_payload_truncation);
+
+  return UNITY_END();
+}
@@ -0,0 +1,272 @@
+/*
+ * tests/test_ha_queue.c
+ *
+ * Unit tests for the hactl transition queue and retry backoff
+ * (apps/hactl/ha_queue.h).
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/hactl/ha_queue.h"
+
+/* ---- Test helpers ---- */
+
+static struct ha_queue_s q;
+
+static struct mmwave_data_s sample(uint8_t state, uint32_t ts)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state = state;
+  d.motion_energy = (uint8_t)ts;
+  d.timestamp_ms = ts;
+  return d;
+}
+
+static void push(uint8_t state, uint32_t ts)
+{
+  struct mmwave_data_s d = sample(state, ts);
+  ha_queue_push(&q, &d);
+}
+
+void setUp(void)
+{
+  ha_queue_init(&q, 1234);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Tests: queueing and in-place merge
+ * ================================================================ */
+
+void test_empty_queue_not_due(void)
+{
+  TEST_ASSERT_EQUAL_UINT8(0, q.count);
+  TEST_ASSERT_NULL(ha_queue_peek(&q));
+  TEST_ASSERT_FALSE(ha_queue_due(&q, 0));
+}
+
+void test_push_makes_queue_due(void)
+{
+  push(LD2410_TARGET_MOTION, 100);
+
+  TEST_ASSERT_EQUAL_UINT8(1, q.count);
+  TEST_ASSERT_TRUE(ha_queue_due(&q, 100));
+}
+
+void test_same_presence_merges_into_tail(void)
+{
+  push(LD2410_TARGET_MOTION, 100);
+  push(LD2410_TARGET_STATIC, 200);
+  push(LD2410_TARGET_BOTH, 300);
+
+  TEST_ASSERT_EQUAL_UINT8(1, q.count);
+  TEST_ASSERT_EQUAL_UINT32(2, q.collapsed);
+  TEST_ASSERT_EQUAL_UINT32(300, ha_queue_peek(&q)->timestamp_ms);
+  TEST_ASSERT_EQUAL_UINT8(LD2410_TARGET_BOTH,
+                          ha_queue_peek(&q)->target_state);
+}
+
+void test_transitions_keep_order(void)
+{
+  push(LD2410_TARGET_MOTION, 100);
+  push(LD2410_TARGET_NONE, 200);
+  push(LD2410_TARGET_STATIC, 300);
+
+  TEST_ASSERT_EQUAL_UINT8(3, q.count);
+  TEST_ASSERT_EQUAL_UINT32(100, ha_queue_at(&q, 0)->timestamp_ms);
+  TEST_ASSERT_EQUAL_UINT32(200, ha_queue_at(&q, 1)->timestamp_ms);
+  TEST_ASSERT_EQUAL_UINT32(300, ha_queue_at(&q, 2)->timestamp_ms);
+}
+
+/* ================================================================
+ * Tests: overflow
+ * ================================================================ */
+
+void test_overflow_drops_oldest_pair(void)
+{
+  q.acked = 0;
+
+  for (uint32_t i = 0; i < HA_QUEUE_DEPTH; i++)
+    {
+      push(i % 2 == 0 ? LD2410_TARGET_MOTION : LD2410_TARGET_NONE, i);
+    }
+
+  TEST_ASSERT_EQUAL_UINT8(HA_QUEUE_DEPTH, q.count);
+
+  push(LD2410_TARGET_MOTION, 99);
+
+  TEST_ASSERT_EQUAL_UINT32(2, q.dropped);
+  TEST_ASSERT_EQUAL_UINT8(HA_QUEUE_DEPTH - 1, q.count);
+
+  /* Head still differs from what HA has, so the history alternates */
+  TEST_ASSERT_EQUAL_UINT32(2, ha_queue_peek(&q)->timestamp_ms);
+  TEST_ASSERT_EQUAL_UINT32(99,
+    ha_queue_at(&q, q.count - 1)->timestamp_ms);
+}
+
+void test_overflow_drops_single_attribute_refresh(void)
+{
+  q.acked = 1;
+
+  for (uint32_t i = 0; i < HA_QUEUE_DEPTH; i++)
+    {
+      push(i % 2 == 0 ? LD2410_TARGET_MOTION : LD2410_TARGET_NONE, i);
+    }
+
+  push(LD2410_TARGET_MOTION, 99);
+
+  TEST_ASSERT_EQUAL_UINT32(1, q.dropped);
+  TEST_ASSERT_EQUAL_UINT8(HA_QUEUE_DEPTH, q.count);
+  TEST_ASSERT_EQUAL_UINT8(0, ha_presence(ha_queue_peek(&q)));
+}
+
+/* ================================================================
+ * Tests: collapse before replay
+ * ================================================================ */
+
+void test_collapse_drops_head_matching_acked(void)
+{
+  q.acked = 1;
+  push(LD2410_TARGET_STATIC, 100);
+  push(LD2410_TARGET_NONE, 200);
+  push(LD2410_TARGET_MOTION, 300);
+
+  ha_queue_collapse(&q);
+
+  TEST_ASSERT_EQUAL_UINT8(2, q.count);
+  TEST_ASSERT_EQUAL_UINT32(200, ha_queue_peek(&q)->timestamp_ms);
+}
+
+void test_collapse_keeps_lone_attribute_update(void)
+{
+  q.acked = 1;
+  push(LD2410_TARGET_STATIC, 100);
+
+  ha_queue_collapse(&q);
+
+  TEST_ASSERT_EQUAL_UINT8(1, q.count);
+}
+
+void test_collapse_noop_when_state_unknown(void)
+{
+  push(LD2410_TARGET_NONE, 100);
+  push(LD2410_TARGET_MOTION, 200);
+
+  ha_queue_collapse(&q);
+
+  TEST_ASSERT_EQUAL_UINT8(2, q.count);
+}
+
+/* ================================================================
+ * Tests: ack / fail / backoff
+ * ================================================================ */
+
+void test_ack_records_state_and_resets_failures(void)
+{
+  push(LD2410_TARGET_MOTION, 100);
+  ha_queue_fail(&q, 1000, 500);
+  ha_queue_fail(&q, 2000, 500);
+
+  ha_queue_ack(&q, 5000);
+
+  TEST_ASSERT_EQUAL_UINT8(0, q.count);
+  TEST_ASSERT_EQUAL_UINT8(1, q.acked);
+  TEST_ASSERT_EQUAL_UINT32(0, q.failures);
+}
+
+void test_fail_defers_retry(void)
+{
+  push(LD2410_TARGET_MOTION, 100);
+
+  uint32_t delay = ha_queue_fail(&q, 1000, 500);
+
+  TEST_ASSERT_GREATER_OR_EQUAL_UINT32(250, delay);
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(500, delay);
+  TEST_ASSERT_FALSE(ha_queue_due(&q, 1000));
+  TEST_ASSERT_TRUE(ha_queue_due(&q, 1000 + delay));
+}
+
+void test_backoff_grows_exponentially(void)
+{
+  q.failures = 4;  /* 500 * 2^3 = 4000 */
+
+  for (int i = 0; i < 50; i++)
+    {
+      uint32_t d = ha_backoff_ms(&q, 500);
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(2000, d);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(4000, d);
+    }
+}
+
+void test_backoff_capped(void)
+{
+  q.failures = 40;
+
+  for (int i = 0; i < 50; i++)
+    {
+      uint32_t d = ha_backoff_ms(&q, 500);
+      TEST_ASSERT_GREATER_OR_EQUAL_UINT32(HA_BACKOFF_MAX_MS / 2, d);
+      TEST_ASSERT_LESS_OR_EQUAL_UINT32(HA_BACKOFF_MAX_MS, d);
+    }
+}
+
+void test_backoff_jitter_varies(void)
+{
+  q.failures = 6;
+  uint32_t first = ha_backoff_ms(&q, 500);
+  bool differs = false;
+
+  for (int i = 0; i < 10 && !differs; i++)
+    {
+      differs = ha_backoff_ms(&q, 500) != first;
+    }
+
+  TEST_ASSERT_TRUE(differs);
+}
+
+void test_due_handles_tick_wraparound(void)
+{
+  push(LD2410_TARGET_MOTION, 100);
+  q.next_try_ms = 0xFFFFFF00u;
+
+  TEST_ASSERT_FALSE(ha_queue_due(&q, 0xFFFFFE00u));
+  TEST_ASSERT_TRUE(ha_queue_due(&q, 0x00000010u));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Queueing */
+  RUN_TEST(test_empty_queue_not_due);
+  RUN_TEST(test_push_makes_queue_due);
+  RUN_TEST(test_same_presence_merges_into_tail);
+  RUN_TEST(test_transitions_keep_order);
+
+  /* Overflow */
+  RUN_TEST(test_overflow_drops_oldest_pair);
+  RUN_TEST(test_overflow_drops_single_attribute_refresh);
+
+  /* Collapse */
+  RUN_TEST(test_collapse_drops_head_matching_acked);
+  RUN_TEST(test_collapse_keeps_lone_attribute_update);
+  RUN_TEST(test_collapse_noop_when_state_unknown);
+
+  /* Ack / fail / backoff */
+  RUN_TEST(test_ack_records_state_and_resets_failures);
+  RUN_TEST(test_fail_defers_retry);
+  RUN_TEST(test_backoff_grows_exponentially);
+  RUN_TEST(test_backoff_capped);
+  RUN_TEST(test_backoff_jitter_varies);
+  RUN_TEST(test_due_handles_tick_wraparound);
+
+  return UNITY_END();
+}
@@ -0,0 +1,431 @@
+/*
+ * tests/test_ha_sink.c
+ *
+ * Unit tests for the hactl reporting core (apps/hactl/ha_sink.h):
+ * change detection and fan-out order, per-sink rate limits, heartbeats,
+ * self-paced and core-paced failure backoff, time budgets, and a
+ * failing or slow sink leaving the others unaffected. Sinks are fakes
+ * that record calls; time is a variable the fakes can advance.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/hactl/ha_sink.h"
+
+/* ---- Test helpers ---- */
+
+static uint32_t g_now;
+static char g_log[256];        /* Call trace: "<sink><op>" per call */
+
+static uint32_t fake_clock(void)
+{
+  return g_now;
+}
+
+struct fake_s
+{
+  char     id;                 /* Letter in the trace */
+  int      init_ret;
+  int      change_ret;
+  int      flush_ret;
+  uint32_t flush_cost_ms;      /* Clock advance per flush */
+  int      queued;             /* Changes not yet flushed */
+  int      delivered;
+  int      closed;
+  uint8_t  last_state;
+};
+
+static void trace(const struct fake_s *fk, char op)
+{
+  size_t n = strlen(g_log);
+
+  if (n + 2 < sizeof(g_log))
+    {
+      g_log[n]     = fk->id;
+      g_log[n + 1] = op;
+      g_log[n + 2] = '\0';
+    }
+}
+
+static int fake_init(void *priv)
+{
+  struct fake_s *fk = priv;
+
+  trace(fk, 'i');
+  return fk->init_ret;
+}
+
+static int fake_change(void *priv, const struct mmwave_data_s *d,
+                       uint32_t now)
+{
+  struct fake_s *fk = priv;
+
+  trace(fk, 'c');
+  fk->last_state = d->target_state;
+  if (fk->change_ret == OK)
+    {
+      fk->queued++;
+    }
+
+  return fk->change_ret;
+}
+
+static int fake_heartbeat(void *priv, const struct mmwave_data_s *d,
+                          uint32_t now)
+{
+  trace(priv, 'h');
+  return OK;
+}
+
+static int fake_flush(void *priv, uint32_t now)
+{
+  struct fake_s *fk = priv;
+
+  trace(fk, 'f');
+  g_now += fk->flush_cost_ms;
+  if (fk->flush_ret == OK)
+    {
+      fk->delivered += fk->queued;
+      fk->queued = 0;
+    }
+
+  return fk->flush_ret;
+}
+
+static void fake_close(void *priv)
+{
+  struct fake_s *fk = priv;
+
+  trace(fk, 'x');
+  fk->closed++;
+}
+
+static const struct ha_sink_ops_s fake_ops =
+{
+  "fake", fake_init, fake_change, fake_heartbeat, fake_flush, fake_close
+};
+
+static struct ha_fanout_s fan;
+static struct fake_s fa;
+static struct fake_s fb;
+static struct ha_sink_s sa;
+static struct ha_sink_s sb;
+
+static struct mmwave_data_s sample(uint8_t state)
+{
+  struct mmwave_data_s d;
+
+  memset(&d, 0, sizeof(d));
+  d.target_state    = state;
+  d.motion_distance = 150;
+  return d;
+}
+
+static bool input(uint8_t state)
+{
+  struct mmwave_data_s d = sample(state);
+
+  return ha_fanout_input(&fan, &d);
+}
+
+void setUp(void)
+{
+  g_now = 1000;
+  g_log[0] = '\0';
+
+  memset(&fa, 0, sizeof(fa));
+  memset(&fb, 0, sizeof(fb));
+  memset(&sa, 0, sizeof(sa));
+  memset(&sb, 0, sizeof(sb));
+  fa.id = 'A';
+  fb.id = 'B';
+  sa.ops  = &fake_ops;
+  sa.priv = &fa;
+  sb.ops  = &fake_ops;
+  sb.priv = &fb;
+
+  ha_fanout_init(&fan, fake_clock);
+  ha_fanout_add(&fan, &sa);
+  ha_fanout_add(&fan, &sb);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Fan-out
+ * ================================================================ */
+
+void test_start_inits_in_order(void)
+{
+  TEST_ASSERT_EQUAL_INT(2, ha_fanout_start(&fan));
+  TEST_ASSERT_EQUAL_STRING("AiBi", g_log);
+  TEST_ASSERT_EQUAL_UINT8(HA_SINK_ON, sa.state);
+}
+
+void test_registration_is_bounded(void)
+{
+  static struct ha_sink_s extra[HA_SINK_MAX];
+
+  for (int i = 2; i < HA_SINK_MAX; i++)
+    {
+      extra[i].ops = &fake_ops;
+      TEST_ASSERT_EQUAL_INT(i, ha_fanout_add(&fan, &extra[i]));
+    }
+
+  TEST_ASSERT_EQUAL_INT(-ENOSPC, ha_fanout_add(&fan, &extra[0]));
+}
+
+void test_only_state_changes_fan_out(void)
+{
+  ha_fanout_start(&fan);
+  g_log[0] = '\0';
+
+  TEST_ASSERT_TRUE(input(LD2410_TARGET_MOTION));    /* First sample */
+  TEST_ASSERT_FALSE(input(LD2410_TARGET_MOTION));
+  TEST_ASSERT_TRUE(input(LD2410_TARGET_NONE));
+
+  TEST_ASSERT_EQUAL_STRING("AcBcAcBc", g_log);
+  TEST_ASSERT_EQUAL_UINT8(LD2410_TARGET_NONE, fb.last_state);
+  TEST_ASSERT_EQUAL_UINT32(3, fan.samples);
+  TEST_ASSERT_EQUAL_UINT32(2, fan.changes);
+}
+
+void test_flush_delivers_in_order(void)
+{
+  ha_fanout_start(&fan);
+  input(LD2410_TARGET_MOTION);
+  g_log[0] = '\0';
+
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_STRING("AfBf", g_log);
+  TEST_ASSERT_EQUAL_INT(1, fa.delivered);
+  TEST_ASSERT_EQUAL_INT(1, fb.delivered);
+
+  /* Nothing pending: no more flushes */
+
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_STRING("AfBf", g_log);
+}
+
+void test_push_resends_latest(void)
+{
+  ha_fanout_start(&fan);
+  TEST_ASSERT_FALSE(ha_fanout_push(&fan));
+
+  input(LD2410_TARGET_STATIC);
+  ha_fanout_run(&fan);
+  TEST_ASSERT_TRUE(ha_fanout_push(&fan));
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_INT(2, fa.delivered);
+  TEST_ASSERT_EQUAL_UINT8(LD2410_TARGET_STATIC, fa.last_state);
+}
+
+/* ================================================================
+ * Scheduling
+ * ================================================================ */
+
+void test_rate_limit_is_per_sink(void)
+{
+  sa.min_interval_ms = 1000;
+  ha_fanout_start(&fan);
+
+  input(LD2410_TARGET_MOTION);
+  ha_fanout_run(&fan);
+  input(LD2410_TARGET_NONE);
+  ha_fanout_run(&fan);
+
+  /* B flushed both changes at once, A is held back */
+
+  TEST_ASSERT_EQUAL_INT(2, fb.delivered);
+  TEST_ASSERT_EQUAL_INT(1, fa.delivered);
+  TEST_ASSERT_EQUAL_UINT32(1, sa.stats.limited);
+
+  g_now += 1000;
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_INT(2, fa.delivered);
+}
+
+void test_heartbeat_interval(void)
+{
+  sa.heartbeat_ms = 500;
+  ha_fanout_start(&fan);
+  input(LD2410_TARGET_MOTION);
+  ha_fanout_run(&fan);
+  g_log[0] = '\0';
+
+  g_now += 499;
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_STRING("", g_log);
+
+  g_now += 1;
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_STRING("AhAf", g_log);
+  TEST_ASSERT_EQUAL_UINT32(1, sa.stats.heartbeats);
+  TEST_ASSERT_EQUAL_UINT32(0, sb.stats.heartbeats);
+}
+
+void test_no_heartbeat_before_first_sample(void)
+{
+  sa.heartbeat_ms = 100;
+  ha_fanout_start(&fan);
+  g_now += 1000;
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_UINT32(0, sa.stats.heartbeats);
+}
+
+void test_core_backoff_doubles_and_caps(void)
+{
+  TEST_ASSERT_EQUAL_UINT32(1000, ha_sink_backoff(1000, 1));
+  TEST_ASSERT_EQUAL_UINT32(2000, ha_sink_backoff(1000, 2));
+  TEST_ASSERT_EQUAL_UINT32(8000, ha_sink_backoff(1000, 4));
+  TEST_ASSERT_EQUAL_UINT32(HA_SINK_BACKOFF_MAX_MS,
+                           ha_sink_backoff(1000, 30));
+}
+
+void test_failing_sink_backs_off_alone(void)
+{
+  sa.backoff_ms = 1000;
+  fa.flush_ret  = -ECONNREFUSED;
+  ha_fanout_start(&fan);
+
+  input(LD2410_TARGET_MOTION);
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_UINT32(1, sa.failures);
+  TEST_ASSERT_EQUAL_UINT32(g_now + 1000, sa.next_flush_ms);
+
+  /* B keeps receiving changes while A waits */
+
+  input(LD2410_TARGET_NONE);
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_INT(2, fb.delivered);
+  TEST_ASSERT_EQUAL_UINT32(1, sa.stats.flushes);
+
+  g_now += 1000;
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_UINT32(2, sa.failures);
+  TEST_ASSERT_EQUAL_UINT32(g_now + 2000, sa.next_flush_ms);
+
+  /* Recovery delivers both queued changes and clears the count */
+
+  fa.flush_ret = OK;
+  g_now += 2000;
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_INT(2, fa.delivered);
+  TEST_ASSERT_EQUAL_UINT32(0, sa.failures);
+  TEST_ASSERT_EQUAL_UINT32(2, sa.stats.errors);
+}
+
+void test_self_paced_sink_polled_each_cycle(void)
+{
+  fa.flush_ret = -EAGAIN;
+  ha_fanout_start(&fan);
+  input(LD2410_TARGET_MOTION);
+
+  for (int i = 0; i < 3; i++)
+    {
+      ha_fanout_run(&fan);
+    }
+
+  TEST_ASSERT_EQUAL_UINT32(3, sa.stats.flushes);
+  TEST_ASSERT_EQUAL_UINT32(0, sa.stats.errors);
+  TEST_ASSERT_TRUE(sa.pending);
+}
+
+void test_slow_sink_sits_out_its_overrun(void)
+{
+  sa.budget_ms     = 100;
+  fa.flush_cost_ms = 800;
+  ha_fanout_start(&fan);
+
+  input(LD2410_TARGET_MOTION);
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_UINT32(1, sa.stats.overruns);
+  TEST_ASSERT_EQUAL_UINT32(800, sa.stats.flush_max_ms);
+  TEST_ASSERT_EQUAL_UINT32(g_now + 800, sa.next_flush_ms);
+
+  /* Next change: B flushes at once, A waits out its 800 ms */
+
+  g_log[0] = '\0';
+  input(LD2410_TARGET_NONE);
+  ha_fanout_run(&fan);
+  TEST_ASSERT_EQUAL_STRING("AcBcBf", g_log);
+  TEST_ASSERT_EQUAL_INT(2, fb.delivered);
+}
+
+/* ================================================================
+ * Isolation
+ * ================================================================ */
+
+void test_failed_init_switches_sink_off(void)
+{
+  fa.init_ret = -ENETUNREACH;
+  TEST_ASSERT_EQUAL_INT(1, ha_fanout_start(&fan));
+  TEST_ASSERT_EQUAL_UINT8(HA_SINK_FAILED, sa.state);
+  g_log[0] = '\0';
+
+  input(LD2410_TARGET_MOTION);
+  ha_fanout_run(&fan);
+  ha_fanout_stop(&fan);
+  TEST_ASSERT_EQUAL_STRING("BcBfBx", g_log);
+  TEST_ASSERT_EQUAL_INT(0, fa.closed);
+}
+
+void test_on_change_error_counted_not_pending(void)
+{
+  fa.change_ret = -ENOMEM;
+  ha_fanout_start(&fan);
+  input(LD2410_TARGET_MOTION);
+
+  TEST_ASSERT_FALSE(sa.pending);
+  TEST_ASSERT_EQUAL_UINT32(1, sa.stats.errors);
+  TEST_ASSERT_TRUE(sb.pending);
+}
+
+void test_stop_flushes_pending_ignoring_schedule(void)
+{
+  sa.min_interval_ms = 60000;
+  ha_fanout_start(&fan);
+  input(LD2410_TARGET_MOTION);
+  ha_fanout_run(&fan);
+  input(LD2410_TARGET_NONE);
+  g_log[0] = '\0';
+
+  ha_fanout_stop(&fan);
+  TEST_ASSERT_EQUAL_STRING("AfAxBfBx", g_log);
+  TEST_ASSERT_EQUAL_INT(2, fa.delivered);
+  TEST_ASSERT_EQUAL_UINT8(HA_SINK_IDLE, sa.state);
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Fan-out */
+  RUN_TEST(test_start_inits_in_order);
+  RUN_TEST(test_registration_is_bounded);
+  RUN_TEST(test_only_state_changes_fan_out);
+  RUN_TEST(test_flush_delivers_in_order);
+  RUN_TEST(test_push_resends_latest);
+
+  /* Scheduling */
+  RUN_TEST(test_rate_limit_is_per_sink);
+  RUN_TEST(test_heartbeat_interval);
+  RUN_TEST(test_no_heartbeat_before_first_sample);
+  RUN_TEST(test_core_backoff_doubles_and_caps);
+  RUN_TEST(test_failing_sink_backs_off_alone);
+  RUN_TEST(test_self_paced_sink_polled_each_cycle);
+  RUN_TEST(test_slow_sink_sits_out_its_overrun);
+
+  /* Isolation */
+  RUN_TEST(test_failed_init_switches_sink_off);
+  RUN_TEST(test_on_change_error_counted_not_pending);
+  RUN_TEST(test_stop_flushes_pending_ignoring_schedule);
+
+  return UNITY_END();
+}
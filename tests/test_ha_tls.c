@@ -0,0 +1,179 @@
+/*
+ * tests/test_ha_tls.c
+ *
+ * Unit tests for hactl's TLS bookkeeping (apps/hactl/ha_tls.h): when the
+ * saved session is offered for resumption and when it is dropped,
+ * handshake statistics, and gathering a message into one TLS record.
+ * The mbedTLS glue itself runs only on the device.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/hactl/ha_tls.h"
+
+#define LIFETIME_MS  3600000u
+
+static struct ha_tls_cache_s g_cache;
+static struct ha_tls_stats_s g_st;
+
+void setUp(void)
+{
+  ha_tls_cache_init(&g_cache, LIFETIME_MS);
+  memset(&g_st, 0, sizeof(g_st));
+}
+
+void tearDown(void) {}
+
+/* ---- Resumption cache ---- */
+
+static void test_nothing_offered_before_full_handshake(void)
+{
+  TEST_ASSERT_FALSE(ha_tls_offer(&g_cache, 0));
+  TEST_ASSERT_FALSE(ha_tls_offer(&g_cache, 5000));
+}
+
+static void test_offered_until_lifetime_then_dropped(void)
+{
+  ha_tls_done(&g_cache, &g_st, false, false, 900, 1000);
+
+  TEST_ASSERT_TRUE(ha_tls_offer(&g_cache, 1001));
+  TEST_ASSERT_TRUE(ha_tls_offer(&g_cache, 1000 + LIFETIME_MS - 1));
+  TEST_ASSERT_FALSE(ha_tls_offer(&g_cache, 1000 + LIFETIME_MS));
+
+  /* Dropped for good, not just while the clock is past it */
+
+  TEST_ASSERT_FALSE(ha_tls_offer(&g_cache, 1002));
+}
+
+static void test_resumption_does_not_extend_lifetime(void)
+{
+  ha_tls_done(&g_cache, &g_st, false, false, 900, 0);
+  ha_tls_done(&g_cache, &g_st, true, true, 40, LIFETIME_MS - 10);
+
+  TEST_ASSERT_FALSE(ha_tls_offer(&g_cache, LIFETIME_MS));
+}
+
+static void test_refused_offer_restarts_lifetime(void)
+{
+  ha_tls_done(&g_cache, &g_st, false, false, 900, 0);
+
+  /* The server forgot the session and did a full handshake instead */
+
+  ha_tls_done(&g_cache, &g_st, true, false, 950, 60000);
+
+  TEST_ASSERT_EQUAL_UINT32(1, g_st.rejected);
+  TEST_ASSERT_EQUAL_UINT32(2, g_st.full);
+  TEST_ASSERT_TRUE(ha_tls_offer(&g_cache, 60000 + LIFETIME_MS - 1));
+}
+
+static void test_failure_with_offer_drops_session(void)
+{
+  ha_tls_done(&g_cache, &g_st, false, false, 900, 0);
+  ha_tls_failed(&g_cache, &g_st, true);
+
+  TEST_ASSERT_EQUAL_UINT32(1, g_st.failed);
+  TEST_ASSERT_FALSE(ha_tls_offer(&g_cache, 10));
+}
+
+static void test_failure_without_offer_keeps_session(void)
+{
+  ha_tls_done(&g_cache, &g_st, false, false, 900, 0);
+  ha_tls_failed(&g_cache, &g_st, false);
+
+  TEST_ASSERT_EQUAL_UINT32(1, g_st.failed);
+  TEST_ASSERT_TRUE(ha_tls_offer(&g_cache, 10));
+}
+
+static void test_lifetime_across_tick_wrap(void)
+{
+  ha_tls_done(&g_cache, &g_st, false, false, 900, 0xfffff000u);
+
+  TEST_ASSERT_TRUE(ha_tls_offer(&g_cache, 0x1000));
+  TEST_ASSERT_FALSE(ha_tls_offer(&g_cache, 0xfffff000u + LIFETIME_MS));
+}
+
+/* ---- Statistics ---- */
+
+static void test_stats_split_full_and_resumed(void)
+{
+  ha_tls_done(&g_cache, &g_st, false, false, 800, 0);
+  ha_tls_done(&g_cache, &g_st, true, true, 30, 10);
+  ha_tls_done(&g_cache, &g_st, true, true, 50, 20);
+  ha_tls_done(&g_cache, &g_st, true, false, 1000, 30);
+
+  TEST_ASSERT_EQUAL_UINT32(2, g_st.full);
+  TEST_ASSERT_EQUAL_UINT32(2, g_st.resumed);
+  TEST_ASSERT_EQUAL_UINT32(1000, g_st.full_max_ms);
+  TEST_ASSERT_EQUAL_UINT32(900, ha_tls_avg_ms(g_st.full_sum_ms,
+                                              g_st.full));
+  TEST_ASSERT_EQUAL_UINT32(50, g_st.resumed_max_ms);
+  TEST_ASSERT_EQUAL_UINT32(40, ha_tls_avg_ms(g_st.resumed_sum_ms,
+                                             g_st.resumed));
+  TEST_ASSERT_EQUAL_UINT32(1000, g_st.last_ms);
+}
+
+static void test_average_of_nothing_is_zero(void)
+{
+  TEST_ASSERT_EQUAL_UINT32(0, ha_tls_avg_ms(0, 0));
+}
+
+/* ---- One record per message ---- */
+
+static void test_gather_keeps_order(void)
+{
+  uint8_t buf[32];
+  struct iovec iov[3] =
+  {
+    { "POST ", 5 }, { "", 0 }, { "{}", 2 }
+  };
+
+  TEST_ASSERT_EQUAL(7, ha_tls_gather(iov, 3, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_MEMORY("POST {}", buf, 7);
+}
+
+static void test_gather_exact_fit(void)
+{
+  uint8_t buf[8];
+  struct iovec iov[2] =
+  {
+    { "abcd", 4 }, { "efgh", 4 }
+  };
+
+  TEST_ASSERT_EQUAL(8, ha_tls_gather(iov, 2, buf, sizeof(buf)));
+  TEST_ASSERT_EQUAL_MEMORY("abcdefgh", buf, 8);
+}
+
+static void test_gather_too_big(void)
+{
+  uint8_t buf[8];
+  struct iovec iov[2] =
+  {
+    { "abcd", 4 }, { "efghi", 5 }
+  };
+
+  TEST_ASSERT_EQUAL(-E2BIG, ha_tls_gather(iov, 2, buf, sizeof(buf)));
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_nothing_offered_before_full_handshake);
+  RUN_TEST(test_offered_until_lifetime_then_dropped);
+  RUN_TEST(test_resumption_does_not_extend_lifetime);
+  RUN_TEST(test_refused_offer_restarts_lifetime);
+  RUN_TEST(test_failure_with_offer_drops_session);
+  RUN_TEST(test_failure_without_offer_keeps_session);
+  RUN_TEST(test_lifetime_across_tick_wrap);
+
+  RUN_TEST(test_stats_split_full_and_resumed);
+  RUN_TEST(test_average_of_nothing_is_zero);
+
+  RUN_TEST(test_gather_keeps_order);
+  RUN_TEST(test_gather_exact_fit);
+  RUN_TEST(test_gather_too_big);
+
+  return UNITY_END();
+}
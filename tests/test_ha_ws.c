@@ -0,0 +1,447 @@
+/*
+ * tests/test_ha_ws.c
+ *
+ * Unit tests for the hactl WebSocket client codec (apps/hactl/ha_ws.h):
+ * handshake key/accept and the SHA-1 under it (apps/common/mmwave_sha1.h),
+ * response validation, masked frame encoding and the incremental frame
+ * reader.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/hactl/ha_ws.h"
+
+/* ---- Test helpers ---- */
+
+/* RFC 6455 section 1.3 sample */
+
+#define RFC_KEY     "dGhlIHNhbXBsZSBub25jZQ=="
+#define RFC_ACCEPT  "s3pPLMBiTxaQ9kYGzzhZRbK+xOo="
+
+static uint8_t frame[512];
+static struct ha_ws_rx_s rx;
+
+static const char resp_ok[] =
+  "HTTP/1.1 101 Switching Protocols\r\n"
+  "Upgrade: websocket\r\n"
+  "Connection: upgrade\r\n"
+  "Sec-WebSocket-Accept: " RFC_ACCEPT "\r\n"
+  "Date: Sat, 17 Oct 2026 10:00:00 GMT\r\n"
+  "Server: Python/3.13 aiohttp/3.11.11 with a rather long product token\r\n"
+  "\r\n";
+
+static struct mmwave_data_s make_data(uint8_t state)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state       = state;
+  d.motion_energy      = 80;
+  d.static_energy      = 40;
+  d.motion_distance    = 150;
+  d.static_distance    = 200;
+  d.detection_distance = 120;
+  return d;
+}
+
+/* Unmask a finished client frame; returns the payload length */
+
+static int unmask(const uint8_t *f, char *out)
+{
+  int len = f[1] & 0x7f;
+  int off = 2;
+
+  if (len == 126)
+    {
+      len = (f[2] << 8) | f[3];
+      off = 4;
+    }
+
+  for (int i = 0; i < len; i++)
+    {
+      out[i] = (char)(f[off + 4 + i] ^ f[off + (i & 3)]);
+    }
+
+  out[len] = '\0';
+  return len;
+}
+
+void setUp(void)
+{
+  memset(frame, 0, sizeof(frame));
+  ha_ws_rx_init(&rx);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Tests: handshake
+ * ================================================================ */
+
+void test_sha1_abc(void)
+{
+  static const uint8_t expect[20] =
+  {
+    0xa9, 0x99, 0x3e, 0x36, 0x47, 0x06, 0x81, 0x6a, 0xba, 0x3e,
+    0x25, 0x71, 0x78, 0x50, 0xc2, 0x6c, 0x9c, 0xd0, 0xd8, 0x9d
+  };
+
+  struct mmwave_sha1_s c;
+  uint8_t out[20];
+
+  mmwave_sha1_init(&c);
+  mmwave_sha1_update(&c, "abc", 3);
+  mmwave_sha1_final(&c, out);
+
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, out, 20);
+}
+
+void test_sha1_two_blocks(void)
+{
+  /* 56 bytes: the length no longer fits in the first block */
+
+  static const char msg[] =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+  static const uint8_t expect[20] =
+  {
+    0x84, 0x98, 0x3e, 0x44, 0x1c, 0x3b, 0xd2, 0x6e, 0xba, 0xae,
+    0x4a, 0xa1, 0xf9, 0x51, 0x29, 0xe5, 0xe5, 0x46, 0x70, 0xf1
+  };
+
+  struct mmwave_sha1_s c;
+  uint8_t out[20];
+
+  mmwave_sha1_init(&c);
+  mmwave_sha1_update(&c, msg, sizeof(msg) - 1);
+  mmwave_sha1_final(&c, out);
+
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, out, 20);
+}
+
+void test_base64_padding(void)
+{
+  char out[16];
+
+  ha_base64(out, (const uint8_t *)"f", 1);
+  TEST_ASSERT_EQUAL_STRING("Zg==", out);
+  ha_base64(out, (const uint8_t *)"fo", 2);
+  TEST_ASSERT_EQUAL_STRING("Zm8=", out);
+  ha_base64(out, (const uint8_t *)"foo", 3);
+  TEST_ASSERT_EQUAL_STRING("Zm9v", out);
+}
+
+void test_key_and_accept_rfc_sample(void)
+{
+  char key[HA_WS_KEY_LEN + 1];
+  char accept[HA_WS_ACCEPT_LEN + 1];
+
+  ha_ws_key(key, (const uint8_t *)"the sample nonce");
+  TEST_ASSERT_EQUAL_STRING(RFC_KEY, key);
+
+  ha_ws_accept(accept, key);
+  TEST_ASSERT_EQUAL_STRING(RFC_ACCEPT, accept);
+}
+
+void test_handshake_request(void)
+{
+  char buf[256];
+  int n = ha_ws_handshake(buf, sizeof(buf), "192.168.1.100", 8123,
+                          RFC_KEY);
+
+  TEST_ASSERT_EQUAL_INT((int)strlen(buf), n);
+  TEST_ASSERT_EQUAL_STRING(
+    "GET /api/websocket HTTP/1.1\r\n"
+    "Host: 192.168.1.100:8123\r\n"
+    "Upgrade: websocket\r\n"
+    "Connection: Upgrade\r\n"
+    "Sec-WebSocket-Key: " RFC_KEY "\r\n"
+    "Sec-WebSocket-Version: 13\r\n"
+    "\r\n", buf);
+
+  TEST_ASSERT_EQUAL_INT(-1, ha_ws_handshake(buf, 32, "h", 1, RFC_KEY));
+}
+
+void test_handshake_response_accepted(void)
+{
+  struct ha_ws_hs_s hs;
+  size_t used;
+
+  ha_ws_hs_init(&hs, RFC_KEY);
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE, ha_ws_hs_feed(&hs, resp_ok,
+                                                  sizeof(resp_ok) - 1,
+                                                  &used));
+  TEST_ASSERT_EQUAL_UINT(sizeof(resp_ok) - 1, used);
+  TEST_ASSERT_EQUAL_UINT16(101, hs.status);
+}
+
+void test_handshake_response_split_with_first_frame(void)
+{
+  char buf[sizeof(resp_ok) + 8];
+  struct ha_ws_hs_s hs;
+  size_t used = 0;
+  size_t off;
+  int ret = HA_WS_MORE;
+
+  /* Headers and the first frame arrive together, byte by byte */
+
+  memcpy(buf, resp_ok, sizeof(resp_ok) - 1);
+  memcpy(buf + sizeof(resp_ok) - 1, "\x81\x02{}", 4);
+
+  ha_ws_hs_init(&hs, RFC_KEY);
+  for (off = 0; ret == HA_WS_MORE; off++)
+    {
+      ret = ha_ws_hs_feed(&hs, &buf[off], 1, &used);
+    }
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE, ret);
+  TEST_ASSERT_EQUAL_UINT(sizeof(resp_ok) - 1, off);
+  TEST_ASSERT_EQUAL_HEX8(0x81, (uint8_t)buf[off]);
+}
+
+void test_handshake_wrong_accept_rejected(void)
+{
+  struct ha_ws_hs_s hs;
+  size_t used;
+
+  ha_ws_hs_init(&hs, "AAAAAAAAAAAAAAAAAAAAAA==");
+  TEST_ASSERT_EQUAL_INT(HA_WS_INVALID, ha_ws_hs_feed(&hs, resp_ok,
+                                                     sizeof(resp_ok) - 1,
+                                                     &used));
+}
+
+void test_handshake_http_error_rejected(void)
+{
+  static const char resp[] =
+    "HTTP/1.1 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+  struct ha_ws_hs_s hs;
+  size_t used;
+
+  ha_ws_hs_init(&hs, RFC_KEY);
+  TEST_ASSERT_EQUAL_INT(HA_WS_INVALID,
+                        ha_ws_hs_feed(&hs, resp, sizeof(resp) - 1, &used));
+  TEST_ASSERT_EQUAL_UINT16(404, hs.status);
+}
+
+/* ================================================================
+ * Tests: frame encoding
+ * ================================================================ */
+
+void test_small_frame_masked(void)
+{
+  struct ha_ws_frame_s f;
+  struct json_writer_s w;
+  uint8_t *start;
+  char out[256];
+
+  ha_ws_frame_init(&f, frame, sizeof(frame), 0x12345678);
+  json_init(&w, ha_ws_sink, &f);
+  ha_ws_auth_json(&w, "tok");
+
+  int n = ha_ws_frame_text(&f, &w, &start);
+  int len = unmask(start, out);
+
+  TEST_ASSERT_EQUAL_STRING("{\"type\":\"auth\",\"access_token\":\"tok\"}",
+                           out);
+  TEST_ASSERT_EQUAL_INT(6 + len, n);
+  TEST_ASSERT_EQUAL_HEX8(0x81, start[0]);
+  TEST_ASSERT_EQUAL_HEX8(0x80 | len, start[1]);
+  TEST_ASSERT_EQUAL_HEX8(0x12, start[2]);
+  TEST_ASSERT_EQUAL_HEX8(0x78, start[5]);
+
+  /* Payload on the wire really is masked */
+
+  TEST_ASSERT_NOT_EQUAL('{', start[6]);
+}
+
+void test_event_frame_extended_length(void)
+{
+  struct ha_ws_frame_s f;
+  struct json_writer_s w;
+  struct mmwave_data_s d = make_data(LD2410_TARGET_BOTH);
+  uint8_t *start;
+  char out[512];
+
+  ha_ws_frame_init(&f, frame, sizeof(frame), 0xdeadbeef);
+  json_init(&w, ha_ws_sink, &f);
+  ha_ws_event_json(&w, 42, &d);
+
+  int n = ha_ws_frame_text(&f, &w, &start);
+  int len = unmask(start, out);
+
+  TEST_ASSERT_EQUAL_STRING(
+    "{\"id\":42,\"type\":\"fire_event\",\"event_type\":\"mmwave_state\","
+    "\"event_data\":{\"presence\":\"on\",\"target\":\"motion+static\","
+    "\"motion_energy\":80,\"static_energy\":40,"
+    "\"motion_distance\":150,\"static_distance\":200,"
+    "\"detection_distance\":120}}", out);
+  TEST_ASSERT_GREATER_OR_EQUAL_INT(126, len);
+  TEST_ASSERT_EQUAL_INT(8 + len, n);
+  TEST_ASSERT_EQUAL_PTR(frame, start);
+  TEST_ASSERT_EQUAL_HEX8(0x80 | 126, start[1]);
+}
+
+void test_frame_overflow_reported(void)
+{
+  struct ha_ws_frame_s f;
+  struct json_writer_s w;
+  struct mmwave_data_s d = make_data(LD2410_TARGET_NONE);
+  uint8_t *start;
+
+  ha_ws_frame_init(&f, frame, 64, 1);
+  json_init(&w, ha_ws_sink, &f);
+  ha_ws_event_json(&w, 1, &d);
+
+  TEST_ASSERT_EQUAL_INT(-1, ha_ws_frame_text(&f, &w, &start));
+}
+
+/* ================================================================
+ * Tests: frame decoding
+ * ================================================================ */
+
+void test_rx_auth_required(void)
+{
+  static const char msg[] =
+    "\x81\x31{\"type\":\"auth_required\",\"ha_version\":\"2026.10.1\"}";
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE,
+                        ha_ws_rx_feed(&rx, (const uint8_t *)msg,
+                                      sizeof(msg) - 1, &used));
+  TEST_ASSERT_EQUAL_UINT(sizeof(msg) - 1, used);
+  TEST_ASSERT_EQUAL_UINT8(HA_WS_OP_TEXT, rx.opcode);
+  TEST_ASSERT_TRUE(ha_ws_msg_has(&rx, HA_WS_TYPE("auth_required")));
+  TEST_ASSERT_FALSE(ha_ws_msg_has(&rx, HA_WS_TYPE("auth_ok")));
+}
+
+void test_rx_result_long_payload_prefix_kept(void)
+{
+  uint8_t msg[4 + 300];
+  const char *head = "{\"id\":17,\"type\":\"result\",\"success\":true,"
+                     "\"result\":{\"context\":{\"id\":\"";
+  size_t hl = strlen(head);
+  size_t used;
+
+  msg[0] = 0x81;
+  msg[1] = 126;
+  msg[2] = 300 >> 8;
+  msg[3] = 300 & 0xff;
+  memset(&msg[4], 'x', 300);
+  memcpy(&msg[4], head, hl);
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE,
+                        ha_ws_rx_feed(&rx, msg, sizeof(msg), &used));
+  TEST_ASSERT_EQUAL_UINT(sizeof(msg), used);
+  TEST_ASSERT_EQUAL_UINT16(HA_WS_RX_KEEP, rx.pos);
+  TEST_ASSERT_EQUAL_INT32(17, ha_ws_result_id(&rx));
+  TEST_ASSERT_TRUE(ha_ws_result_ok(&rx));
+}
+
+void test_rx_failed_result(void)
+{
+  static const char msg[] =
+    "\x81\x3b{\"id\":3,\"type\":\"result\",\"success\":false,"
+    "\"error\":{\"code\":1}}";
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE,
+                        ha_ws_rx_feed(&rx, (const uint8_t *)msg,
+                                      sizeof(msg) - 1, &used));
+  TEST_ASSERT_EQUAL_INT32(3, ha_ws_result_id(&rx));
+  TEST_ASSERT_FALSE(ha_ws_result_ok(&rx));
+}
+
+void test_rx_ping_then_text_in_one_read(void)
+{
+  static const uint8_t msg[] =
+  {
+    0x89, 0x02, 'h', 'i',
+    0x81, 0x00
+  };
+
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE,
+                        ha_ws_rx_feed(&rx, msg, sizeof(msg), &used));
+  TEST_ASSERT_EQUAL_UINT(4, used);
+  TEST_ASSERT_EQUAL_UINT8(HA_WS_OP_PING, rx.opcode);
+  TEST_ASSERT_EQUAL_STRING("hi", rx.data);
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE,
+                        ha_ws_rx_feed(&rx, msg + 4, 2, &used));
+  TEST_ASSERT_EQUAL_UINT8(HA_WS_OP_TEXT, rx.opcode);
+  TEST_ASSERT_EQUAL_UINT16(0, rx.pos);
+}
+
+void test_rx_byte_at_a_time(void)
+{
+  static const char msg[] = "\x81\x05hello";
+  size_t used;
+
+  for (size_t i = 0; i < sizeof(msg) - 2; i++)
+    {
+      TEST_ASSERT_EQUAL_INT(HA_WS_MORE,
+                            ha_ws_rx_feed(&rx, (const uint8_t *)&msg[i], 1,
+                                          &used));
+    }
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_DONE,
+                        ha_ws_rx_feed(&rx,
+                                      (const uint8_t *)&msg[sizeof(msg) - 2],
+                                      1, &used));
+  TEST_ASSERT_EQUAL_STRING("hello", rx.data);
+}
+
+void test_rx_masked_server_frame_invalid(void)
+{
+  static const uint8_t msg[] = { 0x81, 0x85, 1, 2, 3, 4 };
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_INVALID,
+                        ha_ws_rx_feed(&rx, msg, sizeof(msg), &used));
+}
+
+void test_rx_huge_length_invalid(void)
+{
+  static const uint8_t msg[] = { 0x82, 127, 0, 0, 0, 1, 0, 0, 0, 0 };
+  size_t used;
+
+  TEST_ASSERT_EQUAL_INT(HA_WS_INVALID,
+                        ha_ws_rx_feed(&rx, msg, sizeof(msg), &used));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Handshake */
+  RUN_TEST(test_sha1_abc);
+  RUN_TEST(test_sha1_two_blocks);
+  RUN_TEST(test_base64_padding);
+  RUN_TEST(test_key_and_accept_rfc_sample);
+  RUN_TEST(test_handshake_request);
+  RUN_TEST(test_handshake_response_accepted);
+  RUN_TEST(test_handshake_response_split_with_first_frame);
+  RUN_TEST(test_handshake_wrong_accept_rejected);
+  RUN_TEST(test_handshake_http_error_rejected);
+
+  /* Encoding */
+  RUN_TEST(test_small_frame_masked);
+  RUN_TEST(test_event_frame_extended_length);
+  RUN_TEST(test_frame_overflow_reported);
+
+  /* Decoding */
+  RUN_TEST(test_rx_auth_required);
+  RUN_TEST(test_rx_result_long_payload_prefix_kept);
+  RUN_TEST(test_rx_failed_result);
+  RUN_TEST(test_rx_ping_then_text_in_one_read);
+  RUN_TEST(test_rx_byte_at_a_time);
+  RUN_TEST(test_rx_masked_server_frame_invalid);
+  RUN_TEST(test_rx_huge_length_invalid);
+
+  return UNITY_END();
+}
@@ -0,0 +1,436 @@
+/*
+ * tests/test_httpd.c
+ *
+ * Unit tests for the device HTTP server (apps/httpd/httpd.h): request
+ * parsing and responses, slot limits, SSE subscription and fan-out,
+ * change throttling, partial writes with slow-client coalescing, and
+ * timeouts/heartbeats. The sockets are replaced by per-slot capture
+ * buffers with an adjustable send window.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/httpd/httpd.h"
+
+/* ---- Test helpers ---- */
+
+#define OUT_MAX 4096
+
+static struct httpd_s srv;
+static char out[CONFIG_HTTPD_SLOTS][OUT_MAX];
+static size_t out_len[CONFIG_HTTPD_SLOTS];
+static int window[CONFIG_HTTPD_SLOTS];    /* Bytes left; -1 unlimited */
+static int fail[CONFIG_HTTPD_SLOTS];      /* Negative errno to return */
+
+static ssize_t capture(void *arg, int slot, const void *buf, size_t len)
+{
+  if (fail[slot] < 0)
+    {
+      return fail[slot];
+    }
+
+  if (window[slot] >= 0 && len > (size_t)window[slot])
+    {
+      len = (size_t)window[slot];
+    }
+
+  if (window[slot] >= 0)
+    {
+      window[slot] -= (int)len;
+    }
+
+  TEST_ASSERT_TRUE(out_len[slot] + len < OUT_MAX);
+  memcpy(out[slot] + out_len[slot], buf, len);
+  out_len[slot] += len;
+  out[slot][out_len[slot]] = '\0';
+  return (ssize_t)len;
+}
+
+static struct mmwave_eng_data_s reading(uint8_t state, uint16_t dist)
+{
+  struct mmwave_eng_data_s e;
+
+  memset(&e, 0, sizeof(e));
+  e.basic.target_state       = state;
+  e.basic.motion_energy      = 50;
+  e.basic.static_energy      = 20;
+  e.basic.motion_distance    = dist;
+  e.basic.static_distance    = dist;
+  e.basic.detection_distance = dist;
+  e.basic.timestamp_ms       = 42;
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      e.motion_gate_energy[i] = (uint8_t)i;
+      e.static_gate_energy[i] = (uint8_t)(i * 2);
+    }
+
+  return e;
+}
+
+static bool update(uint8_t state, uint16_t dist, uint32_t now)
+{
+  struct mmwave_eng_data_s e = reading(state, dist);
+
+  return httpd_update(&srv, &e, true, now);
+}
+
+/* Open a slot and send a request; returns the slot */
+
+static int request(const char *req, int expect)
+{
+  int slot = httpd_open(&srv, 0);
+
+  TEST_ASSERT_TRUE(slot >= 0);
+  TEST_ASSERT_EQUAL_INT(expect, httpd_input(&srv, slot, req, strlen(req),
+                                            0));
+  return slot;
+}
+
+static void reopen(int slot)
+{
+  httpd_close(&srv, slot);
+  out_len[slot] = 0;
+  out[slot][0]  = '\0';
+}
+
+static const char *body(int slot)
+{
+  const char *b = strstr(out[slot], "\r\n\r\n");
+
+  TEST_ASSERT_NOT_NULL(b);
+  return b + 4;
+}
+
+static int count(const char *hay, const char *needle)
+{
+  int n = 0;
+
+  for (const char *p = hay; (p = strstr(p, needle)) != NULL; p++)
+    {
+      n++;
+    }
+
+  return n;
+}
+
+static void flush_all(uint32_t now)
+{
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      if (srv.conns[i].state != HTTPD_FREE)
+        {
+          httpd_flush(&srv, i, now);
+        }
+    }
+}
+
+void setUp(void)
+{
+  httpd_init(&srv, capture, NULL);
+  memset(out, 0, sizeof(out));
+  memset(out_len, 0, sizeof(out_len));
+  memset(fail, 0, sizeof(fail));
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      window[i] = -1;
+    }
+
+  update(LD2410_TARGET_MOTION, 120, 0);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Requests
+ * ================================================================ */
+
+void test_get_state(void)
+{
+  int s = request("GET /state HTTP/1.1\r\nHost: x\r\n\r\n", HTTPD_CLOSE);
+  const char *want = "{\"presence\":true,\"target\":\"motion\","
+                     "\"motion_energy\":50,\"static_energy\":20,"
+                     "\"motion_distance\":120,\"static_distance\":120,"
+                     "\"detection_distance\":120,\"ts\":42}";
+  char len[48];
+
+  TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 200 OK\r\n", out[s], 17);
+  TEST_ASSERT_NOT_NULL(strstr(out[s], "Content-Type: application/json\r\n"));
+  TEST_ASSERT_NOT_NULL(strstr(out[s], "Connection: close\r\n"));
+  snprintf(len, sizeof(len), "Content-Length: %zu\r\n", strlen(want));
+  TEST_ASSERT_NOT_NULL(strstr(out[s], len));
+  TEST_ASSERT_EQUAL_STRING(want, body(s));
+}
+
+void test_get_gates(void)
+{
+  int s = request("GET /gates HTTP/1.1\r\n\r\n", HTTPD_CLOSE);
+
+  TEST_ASSERT_EQUAL_STRING("{\"motion\":[0,1,2,3,4,5,6,7,8],"
+                           "\"static\":[0,2,4,6,8,10,12,14,16],"
+                           "\"ts\":42}", body(s));
+}
+
+void test_gates_unavailable_without_eng(void)
+{
+  struct mmwave_eng_data_s e = reading(LD2410_TARGET_MOTION, 120);
+  int s;
+
+  httpd_update(&srv, &e, false, 10);
+  s = request("GET /gates HTTP/1.1\r\n\r\n", HTTPD_CLOSE);
+  TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 503", out[s], 12);
+  TEST_ASSERT_NOT_NULL(strstr(out[s], "Retry-After: 1\r\n"));
+}
+
+void test_query_string_ignored(void)
+{
+  int s = request("GET /state?x=1 HTTP/1.1\r\n\r\n", HTTPD_CLOSE);
+
+  TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 200 OK", out[s], 15);
+}
+
+void test_error_statuses(void)
+{
+  int s;
+
+  s = request("GET /nope HTTP/1.1\r\n\r\n", HTTPD_CLOSE);
+  TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 404", out[s], 12);
+  reopen(s);
+
+  s = request("POST /state HTTP/1.1\r\n\r\n", HTTPD_CLOSE);
+  TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 405", out[s], 12);
+  TEST_ASSERT_NOT_NULL(strstr(out[s], "Allow: GET\r\n"));
+  reopen(s);
+
+  s = request("garbage\r\n\r\n", HTTPD_CLOSE);
+  TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 400", out[s], 12);
+  TEST_ASSERT_EQUAL_UINT32(3, srv.stats.requests);
+}
+
+void test_request_split_across_reads(void)
+{
+  int s = httpd_open(&srv, 0);
+  const char *req = "GET /state HTTP/1.1\r\nHost: device\r\n\r\n";
+
+  for (size_t i = 0; i + 1 < strlen(req); i++)
+    {
+      TEST_ASSERT_EQUAL_INT(0, httpd_input(&srv, s, req + i, 1, 0));
+    }
+
+  TEST_ASSERT_EQUAL_size_t(0, out_len[s]);
+  TEST_ASSERT_EQUAL_INT(HTTPD_CLOSE,
+                        httpd_input(&srv, s, req + strlen(req) - 1, 1, 0));
+}
+
+void test_oversized_head_rejected(void)
+{
+  char big[HTTPD_RX_MAX + 16];
+  int s = httpd_open(&srv, 0);
+
+  memset(big, 'a', sizeof(big));
+  TEST_ASSERT_EQUAL_INT(HTTPD_CLOSE,
+                        httpd_input(&srv, s, big, sizeof(big), 0));
+  TEST_ASSERT_EQUAL_STRING_LEN("HTTP/1.1 431", out[s], 12);
+}
+
+void test_slots_are_bounded(void)
+{
+  for (int i = 0; i < CONFIG_HTTPD_SLOTS; i++)
+    {
+      TEST_ASSERT_EQUAL_INT(i, httpd_open(&srv, 0));
+    }
+
+  TEST_ASSERT_EQUAL_INT(-EBUSY, httpd_open(&srv, 0));
+  TEST_ASSERT_EQUAL_UINT32(1, srv.stats.refused);
+
+  httpd_close(&srv, 2);
+  TEST_ASSERT_EQUAL_INT(2, httpd_open(&srv, 0));
+}
+
+/* ================================================================
+ * Server-Sent Events
+ * ================================================================ */
+
+void test_subscribe_gets_headers_and_snapshot(void)
+{
+  int s = request("GET /events HTTP/1.1\r\nAccept: text/event-stream\r\n"
+                  "\r\n", 0);
+
+  TEST_ASSERT_EQUAL_UINT8(HTTPD_STREAMING, srv.conns[s].state);
+  TEST_ASSERT_NOT_NULL(strstr(out[s], "Content-Type: text/event-stream\r\n"));
+  TEST_ASSERT_NULL(strstr(out[s], "Content-Length"));
+  TEST_ASSERT_EQUAL_STRING_LEN("retry: 2000\n\nid: 1\nevent: state\n"
+                               "data: {\"presence\":true,", body(s), 55);
+  TEST_ASSERT_EQUAL_INT(1, httpd_streaming(&srv));
+}
+
+void test_events_fan_out_to_all_subscribers(void)
+{
+  int a = request("GET /events HTTP/1.1\r\n\r\n", 0);
+  int b = request("GET /events HTTP/1.1\r\n\r\n", 0);
+  int c = request("GET /state HTTP/1.1\r\n\r\n", HTTPD_CLOSE);
+
+  TEST_ASSERT_TRUE(update(LD2410_TARGET_NONE, 0, 100));
+  flush_all(100);
+
+  TEST_ASSERT_NOT_NULL(strstr(out[a], "id: 2\nevent: state\n"
+                              "data: {\"presence\":false"));
+  TEST_ASSERT_NOT_NULL(strstr(out[b], "id: 2\n"));
+  TEST_ASSERT_NULL(strstr(out[c], "id: 2\n"));
+  TEST_ASSERT_EQUAL_UINT32(2, srv.stats.events);
+}
+
+void test_state_change_immediate_other_changes_throttled(void)
+{
+  int s = request("GET /events HTTP/1.1\r\n\r\n", 0);
+
+  /* Same reading: nothing */
+
+  TEST_ASSERT_FALSE(update(LD2410_TARGET_MOTION, 120, 50));
+
+  /* Distance moved, but within the throttle window of the last event */
+
+  TEST_ASSERT_FALSE(update(LD2410_TARGET_MOTION, 130, 100));
+  TEST_ASSERT_TRUE(update(LD2410_TARGET_MOTION, 130,
+                          CONFIG_HTTPD_EVENT_MS));
+
+  /* Target state changes are never held back */
+
+  TEST_ASSERT_TRUE(update(LD2410_TARGET_STATIC, 130,
+                          CONFIG_HTTPD_EVENT_MS + 1));
+  flush_all(CONFIG_HTTPD_EVENT_MS + 1);
+  TEST_ASSERT_EQUAL_INT(3, count(out[s], "event: state\n"));
+}
+
+void test_partial_writes_resume(void)
+{
+  int s;
+
+  window[0] = 10;
+  s = request("GET /state HTTP/1.1\r\n\r\n", 0);
+  TEST_ASSERT_TRUE(httpd_wants_write(&srv, s));
+  TEST_ASSERT_EQUAL_size_t(10, out_len[s]);
+
+  TEST_ASSERT_EQUAL_INT(0, httpd_flush(&srv, s, 1));
+  TEST_ASSERT_EQUAL_size_t(10, out_len[s]);
+
+  window[s] = -1;
+  TEST_ASSERT_EQUAL_INT(HTTPD_CLOSE, httpd_flush(&srv, s, 2));
+  TEST_ASSERT_FALSE(httpd_wants_write(&srv, s));
+  TEST_ASSERT_EQUAL_STRING_LEN("{\"presence\":true", body(s), 16);
+}
+
+void test_slow_subscriber_coalesced(void)
+{
+  int fast = request("GET /events HTTP/1.1\r\n\r\n", 0);
+  int slow;
+  uint32_t now = 0;
+
+  window[1] = 0;
+  slow = request("GET /events HTTP/1.1\r\n\r\n", 0);
+
+  /* Flip state until the slow client's buffer is full */
+
+  for (int i = 0; i < 8; i++)
+    {
+      now += 10;
+      update(i & 1 ? LD2410_TARGET_MOTION : LD2410_TARGET_NONE, 120, now);
+      flush_all(now);
+    }
+
+  TEST_ASSERT_TRUE(srv.conns[slow].stale);
+  TEST_ASSERT_TRUE(srv.stats.coalesced > 0);
+  TEST_ASSERT_EQUAL_INT(8, count(out[fast], "event: state\n") - 1);
+
+  /* Once it drains it gets the newest state, id 9, exactly once */
+
+  window[slow] = -1;
+  TEST_ASSERT_EQUAL_INT(0, httpd_flush(&srv, slow, now));
+  TEST_ASSERT_FALSE(srv.conns[slow].stale);
+  TEST_ASSERT_EQUAL_INT(1, count(out[slow], "id: 9\n"));
+  TEST_ASSERT_TRUE(count(out[slow], "event: state\n") < 9);
+}
+
+void test_send_error_reported(void)
+{
+  int s = request("GET /events HTTP/1.1\r\n\r\n", 0);
+
+  fail[s] = -ECONNRESET;
+  update(LD2410_TARGET_NONE, 0, 10);
+  TEST_ASSERT_EQUAL_INT(-ECONNRESET, httpd_flush(&srv, s, 10));
+}
+
+void test_subscriber_input_ignored(void)
+{
+  int s = request("GET /events HTTP/1.1\r\n\r\n", 0);
+  size_t before = out_len[s];
+
+  TEST_ASSERT_EQUAL_INT(0, httpd_input(&srv, s, "GET /state HTTP/1.1\r\n\r\n",
+                                       23, 0));
+  TEST_ASSERT_EQUAL_size_t(before, out_len[s]);
+}
+
+/* ================================================================
+ * Timers
+ * ================================================================ */
+
+void test_incomplete_head_times_out(void)
+{
+  int s = httpd_open(&srv, 1000);
+
+  httpd_input(&srv, s, "GET /sta", 8, 1000);
+  TEST_ASSERT_EQUAL_INT(0, httpd_tick(&srv, s, 1000 + HTTPD_HEAD_TIMEOUT_MS
+                                                 - 1));
+  TEST_ASSERT_EQUAL_INT(HTTPD_CLOSE,
+                        httpd_tick(&srv, s, 1000 + HTTPD_HEAD_TIMEOUT_MS));
+  TEST_ASSERT_EQUAL_UINT32(1, srv.stats.timeouts);
+}
+
+void test_heartbeat_on_quiet_stream(void)
+{
+  int s = request("GET /events HTTP/1.1\r\n\r\n", 0);
+
+  TEST_ASSERT_EQUAL_INT(0, httpd_tick(&srv, s, HTTPD_HEARTBEAT_MS - 1));
+  TEST_ASSERT_NULL(strstr(out[s], ": ping\n\n"));
+  TEST_ASSERT_EQUAL_INT(0, httpd_tick(&srv, s, HTTPD_HEARTBEAT_MS));
+  TEST_ASSERT_NOT_NULL(strstr(out[s], ": ping\n\n"));
+
+  /* A subscriber is never timed out for not sending */
+
+  TEST_ASSERT_EQUAL_INT(0, httpd_tick(&srv, s, 10 * HTTPD_HEAD_TIMEOUT_MS));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Requests */
+  RUN_TEST(test_get_state);
+  RUN_TEST(test_get_gates);
+  RUN_TEST(test_gates_unavailable_without_eng);
+  RUN_TEST(test_query_string_ignored);
+  RUN_TEST(test_error_statuses);
+  RUN_TEST(test_request_split_across_reads);
+  RUN_TEST(test_oversized_head_rejected);
+  RUN_TEST(test_slots_are_bounded);
+
+  /* Server-Sent Events */
+  RUN_TEST(test_subscribe_gets_headers_and_snapshot);
+  RUN_TEST(test_events_fan_out_to_all_subscribers);
+  RUN_TEST(test_state_change_immediate_other_changes_throttled);
+  RUN_TEST(test_partial_writes_resume);
+  RUN_TEST(test_slow_subscriber_coalesced);
+  RUN_TEST(test_send_error_reported);
+  RUN_TEST(test_subscriber_input_ignored);
+
+  /* Timers */
+  RUN_TEST(test_incomplete_head_times_out);
+  RUN_TEST(test_heartbeat_on_quiet_stream);
+
+  return UNITY_END();
+}
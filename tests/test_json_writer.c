@@ -0,0 +1,266 @@
+/*
+ * tests/test_json_writer.c
+ *
+ * Unit tests for the shared streaming JSON writer
+ * (apps/common/json_writer.h) and the canonical sensor fields
+ * (apps/common/mmwave_json.h).
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/common/json_writer.h"
+#include "apps/common/mmwave_json.h"
+
+/* ---- Test helpers ---- */
+
+static char out[512];
+static struct json_buf_s sink;
+static struct json_writer_s w;
+
+/* Sink that records how many times it was called */
+
+static int g_calls;
+
+static int counting_buf_sink(void *arg, const char *buf, size_t len)
+{
+  g_calls++;
+  return json_sink_buf(arg, buf, len);
+}
+
+static int failing_sink(void *arg, const char *buf, size_t len)
+{
+  g_calls++;
+  return -EPIPE;
+}
+
+static const char *finish(void)
+{
+  TEST_ASSERT_GREATER_OR_EQUAL_INT(0, json_finish_buf(&w, &sink));
+  return out;
+}
+
+void setUp(void)
+{
+  memset(out, 0, sizeof(out));
+  sink.buf  = out;
+  sink.size = sizeof(out);
+  sink.len  = 0;
+  g_calls   = 0;
+  json_init(&w, json_sink_buf, &sink);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Tests: structure
+ * ================================================================ */
+
+void test_empty_object(void)
+{
+  json_begin_object(&w, NULL);
+  json_end_object(&w);
+
+  TEST_ASSERT_EQUAL_STRING("{}", finish());
+}
+
+void test_members_comma_separated(void)
+{
+  json_begin_object(&w, NULL);
+  json_uint(&w, "a", 1);
+  json_bool(&w, "b", true);
+  json_str(&w, "c", "x");
+  json_end_object(&w);
+
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1,\"b\":true,\"c\":\"x\"}", finish());
+}
+
+void test_nested_object_resets_commas(void)
+{
+  json_begin_object(&w, NULL);
+  json_uint(&w, "a", 1);
+  json_begin_object(&w, "inner");
+  json_uint(&w, "b", 2);
+  json_uint(&w, "c", 3);
+  json_end_object(&w);
+  json_uint(&w, "d", 4);
+  json_end_object(&w);
+
+  TEST_ASSERT_EQUAL_STRING("{\"a\":1,\"inner\":{\"b\":2,\"c\":3},\"d\":4}",
+                           finish());
+}
+
+void test_array_elements(void)
+{
+  json_begin_object(&w, NULL);
+  json_begin_array(&w, "gates");
+  for (uint32_t i = 0; i < 3; i++)
+    {
+      json_uint(&w, NULL, i * 10);
+    }
+
+  json_end_array(&w);
+  json_end_object(&w);
+
+  TEST_ASSERT_EQUAL_STRING("{\"gates\":[0,10,20]}", finish());
+}
+
+/* ================================================================
+ * Tests: values
+ * ================================================================ */
+
+void test_uint_extremes(void)
+{
+  json_begin_array(&w, NULL);
+  json_uint(&w, NULL, 0);
+  json_uint(&w, NULL, 4294967295u);
+  json_end_array(&w);
+
+  TEST_ASSERT_EQUAL_STRING("[0,4294967295]", finish());
+}
+
+void test_negative_int(void)
+{
+  json_begin_array(&w, NULL);
+  json_int(&w, NULL, -42);
+  json_int(&w, NULL, 7);
+  json_int(&w, NULL, INT32_MIN);
+  json_end_array(&w);
+
+  TEST_ASSERT_EQUAL_STRING("[-42,7,-2147483648]", finish());
+}
+
+void test_string_escaping(void)
+{
+  json_str(&w, NULL, "a\"b\\c\nd\x01");
+
+  TEST_ASSERT_EQUAL_STRING("\"a\\\"b\\\\c\\u000ad\\u0001\"", finish());
+}
+
+/* ================================================================
+ * Tests: chunked streaming
+ * ================================================================ */
+
+void test_long_output_spans_chunks(void)
+{
+  json_init(&w, counting_buf_sink, &sink);
+  json_begin_array(&w, NULL);
+  for (uint32_t i = 0; i < 100; i++)
+    {
+      json_uint(&w, NULL, 1000 + i);
+    }
+
+  json_end_array(&w);
+  int n = json_finish_buf(&w, &sink);
+
+  /* 100 x "1xxx" + 99 commas + brackets */
+  TEST_ASSERT_EQUAL_INT(100 * 4 + 99 + 2, n);
+  TEST_ASSERT_EQUAL_INT(n, (int)strlen(out));
+  TEST_ASSERT_GREATER_THAN(n / JSON_CHUNK_SIZE - 1, g_calls);
+  TEST_ASSERT_EQUAL_STRING_LEN("[1000,1001,", out, 11);
+  TEST_ASSERT_EQUAL_CHAR(']', out[n - 1]);
+}
+
+void test_writer_state_is_small(void)
+{
+  TEST_ASSERT_LESS_OR_EQUAL_UINT32(JSON_CHUNK_SIZE + 32,
+                                   sizeof(struct json_writer_s));
+}
+
+/* ================================================================
+ * Tests: sink errors
+ * ================================================================ */
+
+void test_buffer_overflow_reported(void)
+{
+  sink.size = 8;
+  json_begin_object(&w, NULL);
+  json_str(&w, "key", "value that does not fit");
+  json_end_object(&w);
+
+  TEST_ASSERT_EQUAL_INT(-1, json_finish_buf(&w, &sink));
+}
+
+void test_sink_error_latched(void)
+{
+  json_init(&w, failing_sink, NULL);
+  for (int i = 0; i < 40; i++)
+    {
+      json_str(&w, NULL, "0123456789");
+    }
+
+  TEST_ASSERT_EQUAL_INT(-EPIPE, json_finish(&w));
+  TEST_ASSERT_EQUAL_INT(1, g_calls);
+}
+
+void test_count_sink_measures_length(void)
+{
+  json_init(&w, json_sink_count, NULL);
+  json_begin_object(&w, NULL);
+  json_str(&w, "state", "on");
+  json_end_object(&w);
+
+  TEST_ASSERT_EQUAL_INT((int)strlen("{\"state\":\"on\"}"), json_finish(&w));
+}
+
+/* ================================================================
+ * Tests: canonical sensor fields
+ * ================================================================ */
+
+void test_mmwave_fields_names(void)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state       = LD2410_TARGET_BOTH;
+  d.motion_energy      = 80;
+  d.static_energy      = 40;
+  d.motion_distance    = 150;
+  d.static_distance    = 200;
+  d.detection_distance = 120;
+
+  json_begin_object(&w, NULL);
+  json_bool(&w, "presence", mmwave_json_presence(&d));
+  json_str(&w, "target", mmwave_target_str(d.target_state));
+  mmwave_json_fields(&w, &d);
+  json_end_object(&w);
+
+  TEST_ASSERT_EQUAL_STRING("{\"presence\":true,\"target\":\"motion+static\","
+                           "\"motion_energy\":80,\"static_energy\":40,"
+                           "\"motion_distance\":150,\"static_distance\":200,"
+                           "\"detection_distance\":120}", finish());
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Structure */
+  RUN_TEST(test_empty_object);
+  RUN_TEST(test_members_comma_separated);
+  RUN_TEST(test_nested_object_resets_commas);
+  RUN_TEST(test_array_elements);
+
+  /* Values */
+  RUN_TEST(test_uint_extremes);
+  RUN_TEST(test_negative_int);
+  RUN_TEST(test_string_escaping);
+
+  /* Streaming */
+  RUN_TEST(test_long_output_spans_chunks);
+  RUN_TEST(test_writer_state_is_small);
+
+  /* Sink errors */
+  RUN_TEST(test_buffer_overflow_reported);
+  RUN_TEST(test_sink_error_latched);
+  RUN_TEST(test_count_sink_measures_length);
+
+  /* Sensor fields */
+  RUN_TEST(test_mmwave_fields_names);
+
+  return UNITY_END();
+}
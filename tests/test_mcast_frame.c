@@ -0,0 +1,350 @@
+/*
+ * tests/test_mcast_frame.c
+ *
+ * Unit tests for the multicast presence datagram (apps/mcast/mcast_frame.h):
+ * header layout, gate quantisation, key and delta frames, the encoder's
+ * key/delta choice, and decoder behaviour on loss, reordering and bad
+ * input.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/mcast/mcast_frame.h"
+
+/* ---- Test helpers ---- */
+
+static struct mcast_enc_s enc;
+static struct mcast_dec_s dec;
+static uint8_t buf[MCAST_FRAME_MAX];
+
+static struct mmwave_eng_data_s reading(void)
+{
+  struct mmwave_eng_data_s e;
+
+  memset(&e, 0, sizeof(e));
+  e.basic.target_state       = LD2410_TARGET_BOTH;
+  e.basic.motion_energy      = 64;
+  e.basic.static_energy      = 33;
+  e.basic.motion_distance    = 150;
+  e.basic.static_distance    = 420;
+  e.basic.detection_distance = 160;
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      e.motion_gate_energy[i] = (uint8_t)(i * 12);
+      e.static_gate_energy[i] = (uint8_t)(100 - i * 10);
+    }
+
+  return e;
+}
+
+static int encode(const struct mmwave_eng_data_s *e, bool gates)
+{
+  return mcast_encode(&enc, buf, sizeof(buf), e, gates, 0);
+}
+
+static void assert_gates_close(const struct mmwave_eng_data_s *want,
+                               const struct mcast_frame_s *f)
+{
+  TEST_ASSERT_TRUE(f->gates);
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      TEST_ASSERT_UINT8_WITHIN(4, want->motion_gate_energy[i],
+                               f->eng.motion_gate_energy[i]);
+      TEST_ASSERT_UINT8_WITHIN(4, want->static_gate_energy[i],
+                               f->eng.static_gate_energy[i]);
+    }
+}
+
+void setUp(void)
+{
+  mcast_enc_init(&enc, 0xa1b2c3d4, 1);
+  memset(&dec, 0, sizeof(dec));
+  memset(buf, 0, sizeof(buf));
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Layout
+ * ================================================================ */
+
+void test_basic_frame_bytes(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  const uint8_t want[] =
+  {
+    'm', 'w', MCAST_VERSION, 0x00,
+    0xa1, 0xb2, 0xc3, 0xd4,                   /* device id */
+    0x00, 0x00, 0x00, 0x01,                   /* seq */
+    0x00, 0x00, 0x00, 0x01, 0x23, 0x45, 0x67, 0x89,
+    LD2410_TARGET_BOTH, 64, 33,
+    0x00, 150, 0x01, 0xa4, 0x00, 160
+  };
+
+  TEST_ASSERT_EQUAL_INT(MCAST_BASIC_LEN,
+                        mcast_encode(&enc, buf, sizeof(buf), &e, false,
+                                     0x123456789ull));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(want, buf, sizeof(want));
+  TEST_ASSERT_EQUAL_UINT32(2, enc.seq);
+}
+
+void test_basic_round_trip(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  struct mcast_frame_s f;
+  int n = mcast_encode(&enc, buf, sizeof(buf), &e, false, 987654321ull);
+
+  TEST_ASSERT_EQUAL_INT(0, mcast_decode(&dec, buf, n, &f));
+  TEST_ASSERT_EQUAL_HEX32(0xa1b2c3d4, f.device_id);
+  TEST_ASSERT_EQUAL_UINT32(1, f.seq);
+  TEST_ASSERT_TRUE(f.ts_us == 987654321ull);
+  TEST_ASSERT_EQUAL_UINT8(LD2410_TARGET_BOTH, f.eng.basic.target_state);
+  TEST_ASSERT_EQUAL_UINT16(420, f.eng.basic.static_distance);
+  TEST_ASSERT_EQUAL_UINT16(160, f.eng.basic.detection_distance);
+  TEST_ASSERT_FALSE(f.gates);
+}
+
+void test_quantise_range(void)
+{
+  TEST_ASSERT_EQUAL_UINT8(0, mcast_quant(0));
+  TEST_ASSERT_EQUAL_UINT8(15, mcast_quant(100));
+  TEST_ASSERT_EQUAL_UINT8(15, mcast_quant(255));
+  TEST_ASSERT_EQUAL_UINT8(100, mcast_dequant(15));
+
+  for (int v = 0; v <= 100; v++)
+    {
+      TEST_ASSERT_UINT8_WITHIN(4, v, mcast_dequant(mcast_quant((uint8_t)v)));
+    }
+}
+
+void test_key_frame_packs_nibbles(void)
+{
+  struct mmwave_eng_data_s e = reading();
+
+  TEST_ASSERT_EQUAL_INT(MCAST_FRAME_MAX, encode(&e, true));
+  TEST_ASSERT_EQUAL_HEX8(MCAST_F_GATES | MCAST_F_KEY, buf[3]);
+
+  /* First byte: motion gates 0, 1; last: static gates 7, 8 */
+
+  TEST_ASSERT_EQUAL_HEX8(0x02, buf[MCAST_BASIC_LEN]);
+  TEST_ASSERT_EQUAL_HEX8(mcast_quant(30) << 4 | mcast_quant(20),
+                         buf[MCAST_FRAME_MAX - 1]);
+}
+
+/* ================================================================
+ * Encoder
+ * ================================================================ */
+
+void test_unchanged_gates_send_empty_delta(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  const uint8_t want[] = { 1, 0, 0, 0 };
+
+  encode(&e, true);
+  TEST_ASSERT_EQUAL_INT(MCAST_BASIC_LEN + MCAST_DELTA_HDR, encode(&e, true));
+  TEST_ASSERT_EQUAL_HEX8(MCAST_F_GATES, buf[3]);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(want, buf + MCAST_BASIC_LEN, 4);
+}
+
+void test_delta_carries_changed_nibbles(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  const uint8_t want[] = { 1, 0x00, 0x00, 0x01, 0xf0 };
+
+  /* Mask bit 0 for motion gate 0; its nibble in the high half, padded */
+
+  encode(&e, true);
+  e.motion_gate_energy[0] = 100;
+  TEST_ASSERT_EQUAL_INT(MCAST_BASIC_LEN + 5, encode(&e, true));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(want, buf + MCAST_BASIC_LEN, sizeof(want));
+}
+
+void test_delta_is_against_key_not_previous(void)
+{
+  struct mmwave_eng_data_s e = reading();
+
+  encode(&e, true);
+  e.motion_gate_energy[3] = 0;
+  encode(&e, true);
+  encode(&e, true);
+  TEST_ASSERT_EQUAL_UINT8(2, buf[MCAST_BASIC_LEN]);    /* key age */
+  TEST_ASSERT_EQUAL_HEX8(0x08, buf[MCAST_BASIC_LEN + 3]);
+}
+
+void test_large_change_sends_key(void)
+{
+  struct mmwave_eng_data_s e = reading();
+
+  encode(&e, true);
+  for (int i = 0; i < 9; i++)
+    {
+      e.static_gate_energy[i] = 0;
+    }
+
+  TEST_ASSERT_EQUAL_INT(MCAST_FRAME_MAX, encode(&e, true));
+  TEST_ASSERT_EQUAL_HEX8(MCAST_F_GATES | MCAST_F_KEY, buf[3]);
+  TEST_ASSERT_EQUAL_UINT32(2, enc.key_frames);
+}
+
+void test_key_frame_every_n(void)
+{
+  struct mmwave_eng_data_s e = reading();
+
+  for (int i = 0; i < 3 * CONFIG_MCAST_KEY_EVERY; i++)
+    {
+      encode(&e, true);
+    }
+
+  TEST_ASSERT_EQUAL_UINT32(3, enc.key_frames);
+  TEST_ASSERT_EQUAL_UINT32(3 * (CONFIG_MCAST_KEY_EVERY - 1),
+                           enc.delta_frames);
+}
+
+void test_encode_small_buffer(void)
+{
+  struct mmwave_eng_data_s e = reading();
+
+  TEST_ASSERT_EQUAL_INT(-ENOBUFS,
+                        mcast_encode(&enc, buf, MCAST_FRAME_MAX - 1, &e,
+                                     false, 0));
+  TEST_ASSERT_EQUAL_UINT32(1, enc.seq);
+}
+
+/* ================================================================
+ * Decoder
+ * ================================================================ */
+
+void test_key_and_delta_round_trip(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  struct mcast_frame_s f;
+  int n;
+
+  n = encode(&e, true);
+  TEST_ASSERT_EQUAL_INT(0, mcast_decode(&dec, buf, n, &f));
+  assert_gates_close(&e, &f);
+
+  e.motion_gate_energy[4] = 95;
+  e.static_gate_energy[7] = 2;
+  n = encode(&e, true);
+  TEST_ASSERT_TRUE(n < MCAST_FRAME_MAX);
+  TEST_ASSERT_EQUAL_INT(0, mcast_decode(&dec, buf, n, &f));
+  assert_gates_close(&e, &f);
+}
+
+void test_lost_delta_costs_only_itself(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  struct mcast_frame_s f;
+  int n;
+
+  n = encode(&e, true);
+  mcast_decode(&dec, buf, n, &f);
+
+  e.motion_gate_energy[1] = 90;
+  encode(&e, true);                                   /* lost */
+  e.motion_gate_energy[2] = 90;
+  n = encode(&e, true);
+  TEST_ASSERT_EQUAL_INT(0, mcast_decode(&dec, buf, n, &f));
+  assert_gates_close(&e, &f);
+}
+
+void test_lost_key_marks_gates(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  struct mcast_frame_s f;
+  int n;
+
+  encode(&e, true);                                   /* lost */
+  n = encode(&e, true);
+  TEST_ASSERT_EQUAL_INT(0, mcast_decode(&dec, buf, n, &f));
+  TEST_ASSERT_FALSE(f.gates);
+  TEST_ASSERT_TRUE(f.gates_lost);
+  TEST_ASSERT_EQUAL_UINT16(150, f.eng.basic.motion_distance);
+}
+
+void test_stale_key_ignored(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  uint8_t old[MCAST_FRAME_MAX];
+  struct mcast_frame_s f;
+  int n;
+
+  n = encode(&e, true);
+  memcpy(old, buf, n);
+  enc.seq += CONFIG_MCAST_KEY_EVERY;
+  enc.have_key = false;
+  encode(&e, true);
+  mcast_decode(&dec, buf, MCAST_FRAME_MAX, &f);
+
+  TEST_ASSERT_EQUAL_INT(0, mcast_decode(&dec, old, n, &f));
+  TEST_ASSERT_EQUAL_UINT32(enc.key_seq, dec.key_seq);
+}
+
+void test_decode_rejects_bad_input(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  struct mcast_frame_s f;
+  int n = encode(&e, true);
+
+  TEST_ASSERT_EQUAL_INT(-EBADMSG, mcast_decode(&dec, buf, 10, &f));
+  TEST_ASSERT_EQUAL_INT(-EBADMSG, mcast_decode(&dec, buf, n - 1, &f));
+
+  buf[2] = MCAST_VERSION + 1;
+  TEST_ASSERT_EQUAL_INT(-EPROTONOSUPPORT, mcast_decode(&dec, buf, n, &f));
+
+  buf[2] = MCAST_VERSION;
+  buf[0] = 'x';
+  TEST_ASSERT_EQUAL_INT(-EBADMSG, mcast_decode(&dec, buf, n, &f));
+  TEST_ASSERT_EQUAL_HEX32(0, mcast_device_id(buf, n));
+}
+
+void test_decode_rejects_bad_delta_length(void)
+{
+  struct mmwave_eng_data_s e = reading();
+  struct mcast_frame_s f;
+  int n;
+
+  encode(&e, true);
+  e.motion_gate_energy[0] = 100;
+  n = encode(&e, true);
+
+  TEST_ASSERT_EQUAL_INT(-EBADMSG, mcast_decode(&dec, buf, n - 1, &f));
+  buf[MCAST_BASIC_LEN + 1] = 0x80;                    /* mask bit 23 */
+  TEST_ASSERT_EQUAL_INT(-EBADMSG, mcast_decode(&dec, buf, n, &f));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Layout */
+  RUN_TEST(test_basic_frame_bytes);
+  RUN_TEST(test_basic_round_trip);
+  RUN_TEST(test_quantise_range);
+  RUN_TEST(test_key_frame_packs_nibbles);
+
+  /* Encoder */
+  RUN_TEST(test_unchanged_gates_send_empty_delta);
+  RUN_TEST(test_delta_carries_changed_nibbles);
+  RUN_TEST(test_delta_is_against_key_not_previous);
+  RUN_TEST(test_large_change_sends_key);
+  RUN_TEST(test_key_frame_every_n);
+  RUN_TEST(test_encode_small_buffer);
+
+  /* Decoder */
+  RUN_TEST(test_key_and_delta_round_trip);
+  RUN_TEST(test_lost_delta_costs_only_itself);
+  RUN_TEST(test_lost_key_marks_gates);
+  RUN_TEST(test_stale_key_ignored);
+  RUN_TEST(test_decode_rejects_bad_input);
+  RUN_TEST(test_decode_rejects_bad_delta_length);
+
+  return UNITY_END();
+}
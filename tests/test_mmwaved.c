@@ -0,0 +1,521 @@
+/*
+ * tests/test_mmwaved.c
+ *
+ * Unit tests for the mmwaved core (apps/mmwaved/mmwaved.h): hosting and
+ * refusing services, retry backoff after a failed start or a fault,
+ * services stopped through their own flag, the shared poll set and
+ * revents routing, tick scheduling, the sensor watchdog and the control
+ * protocol, plus the client's reply parsing (apps/common/
+ * mmwave_service.h). Services are fakes that record calls.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/mmwaved/mmwaved.h"
+
+/* ---- Test helpers ---- */
+
+static char g_log[256];        /* Call trace: "<service><op>" per call */
+
+struct fake_s
+{
+  int      start_ret;
+  int      events_ret;
+  uint32_t tick_ms;            /* Returned by tick() */
+  int      fd;                 /* First fd handed out by pollset() */
+  short    revents;            /* What events() saw on its first entry */
+  int      frames;
+  int      ticks;
+};
+
+static struct fake_s fa;
+static struct fake_s fb;
+static volatile bool g_a_running;
+static volatile bool g_b_running;
+
+static void trace(char id, char op)
+{
+  size_t n = strlen(g_log);
+
+  if (n + 2 < sizeof(g_log))
+    {
+      g_log[n]     = id;
+      g_log[n + 1] = op;
+      g_log[n + 2] = '\0';
+    }
+}
+
+/* A: two poll entries and a tick */
+
+static int a_start(void)
+{
+  trace('A', 's');
+  return fa.start_ret;
+}
+
+static void a_pollset(struct pollfd *pfds)
+{
+  pfds[0].fd     = fa.fd;
+  pfds[0].events = POLLIN;
+  pfds[1].fd     = fa.fd + 1;
+  pfds[1].events = POLLIN;
+}
+
+static int a_events(const struct pollfd *pfds, uint32_t now)
+{
+  fa.revents = pfds[0].revents;
+  return fa.events_ret;
+}
+
+static void a_frame(const struct mmwave_eng_data_s *eng, bool gates,
+                    uint32_t now)
+{
+  fa.frames++;
+}
+
+static uint32_t a_tick(uint32_t now)
+{
+  fa.ticks++;
+  return fa.tick_ms;
+}
+
+static void a_stop(void)
+{
+  trace('A', 'x');
+}
+
+/* B: one poll entry, no tick */
+
+static int b_start(void)
+{
+  trace('B', 's');
+  return fb.start_ret;
+}
+
+static void b_pollset(struct pollfd *pfds)
+{
+  pfds[0].fd     = fb.fd;
+  pfds[0].events = POLLIN;
+}
+
+static int b_events(const struct pollfd *pfds, uint32_t now)
+{
+  fb.revents = pfds[0].revents;
+  return fb.events_ret;
+}
+
+static void b_frame(const struct mmwave_eng_data_s *eng, bool gates,
+                    uint32_t now)
+{
+  fb.frames++;
+}
+
+static void b_stop(void)
+{
+  trace('B', 'x');
+}
+
+static const struct mmwave_service_s svc_a =
+{
+  "alpha", &g_a_running, 2, 2048,
+  a_start, a_pollset, a_events, a_frame, a_tick, a_stop
+};
+
+static const struct mmwave_service_s svc_b =
+{
+  "beta", &g_b_running, 1, 2048,
+  b_start, b_pollset, b_events, b_frame, NULL, b_stop
+};
+
+static struct mwd_s d;
+
+#define BASE   2               /* Daemon's own entries in these tests */
+#define T0     1000
+
+/* Run a control line and return the reply */
+
+static const char *ctl(const char *text, uint32_t now)
+{
+  static char line[MMWAVED_LINE_MAX];
+  static char reply[MMWAVED_LINE_MAX];
+  struct mwd_req_s req;
+
+  snprintf(line, sizeof(line), "%s", text);
+  TEST_ASSERT_TRUE(mwd_ctl_parse(line, &req) > 0);
+  if (mwd_ctl_service(&d, &req, now, reply, sizeof(reply)) == -ENOSYS)
+    {
+      return "ENOSYS";
+    }
+
+  return reply;
+}
+
+void setUp(void)
+{
+  g_log[0] = '\0';
+  memset(&fa, 0, sizeof(fa));
+  memset(&fb, 0, sizeof(fb));
+  fa.fd        = 10;
+  fa.tick_ms   = 100;
+  fb.fd        = 20;
+  g_a_running  = false;
+  g_b_running  = false;
+
+  mwd_init(&d, 4, 5000, T0);
+  mwd_add(&d, &svc_a);
+  mwd_add(&d, &svc_b);
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Hosting
+ * ================================================================ */
+
+void test_start_hosts_service_and_sets_its_flag(void)
+{
+  TEST_ASSERT_EQUAL_INT(OK, mwd_start(&d, 0, T0));
+  TEST_ASSERT_TRUE(g_a_running);
+  TEST_ASSERT_EQUAL_UINT8(MWD_RUNNING, d.slots[0].state);
+  TEST_ASSERT_EQUAL_STRING("As", g_log);
+  TEST_ASSERT_EQUAL_INT(-EALREADY, mwd_start(&d, 0, T0));
+}
+
+void test_registration_is_bounded_and_found_by_name(void)
+{
+  for (int i = 2; i < MWD_MAX_SERVICES; i++)
+    {
+      TEST_ASSERT_EQUAL_INT(i, mwd_add(&d, &svc_b));
+    }
+
+  TEST_ASSERT_EQUAL_INT(-ENOSPC, mwd_add(&d, &svc_a));
+  TEST_ASSERT_EQUAL_INT(1, mwd_find(&d, "beta"));
+  TEST_ASSERT_EQUAL_INT(-ENOENT, mwd_find(&d, "gamma"));
+}
+
+void test_service_in_its_own_task_is_refused(void)
+{
+  g_b_running = true;      /* `beta start` ran before the daemon */
+
+  TEST_ASSERT_EQUAL_INT(-EBUSY, mwd_start(&d, 1, T0));
+  TEST_ASSERT_EQUAL_STRING("", g_log);
+}
+
+void test_full_poll_set_refuses_service(void)
+{
+  mwd_init(&d, 2, 0, T0);
+  mwd_add(&d, &svc_a);
+  mwd_add(&d, &svc_b);
+
+  TEST_ASSERT_EQUAL_INT(OK, mwd_start(&d, 0, T0));
+  TEST_ASSERT_EQUAL_INT(-ENFILE, mwd_start(&d, 1, T0));
+  TEST_ASSERT_EQUAL_INT(2, mwd_fds_used(&d));
+  TEST_ASSERT_FALSE(g_b_running);
+}
+
+/* ================================================================
+ * Supervision
+ * ================================================================ */
+
+void test_failed_start_retries_with_backoff(void)
+{
+  fa.start_ret = -EADDRINUSE;
+
+  TEST_ASSERT_EQUAL_INT(-EADDRINUSE, mwd_start(&d, 0, T0));
+  TEST_ASSERT_EQUAL_UINT8(MWD_RETRY, d.slots[0].state);
+  TEST_ASSERT_EQUAL_UINT32(T0 + MWD_BACKOFF_MS, d.slots[0].retry_ms);
+
+  /* Not yet, then the second failure waits twice as long */
+
+  mwd_run(&d, T0 + MWD_BACKOFF_MS - 1);
+  TEST_ASSERT_EQUAL_STRING("As", g_log);
+  mwd_run(&d, T0 + MWD_BACKOFF_MS);
+  TEST_ASSERT_EQUAL_STRING("AsAs", g_log);
+  TEST_ASSERT_EQUAL_UINT32(T0 + 3 * MWD_BACKOFF_MS, d.slots[0].retry_ms);
+
+  fa.start_ret = OK;
+  mwd_run(&d, T0 + 3 * MWD_BACKOFF_MS);
+  TEST_ASSERT_EQUAL_UINT8(MWD_RUNNING, d.slots[0].state);
+  TEST_ASSERT_EQUAL_UINT32(2, d.slots[0].restarts);
+  TEST_ASSERT_EQUAL_INT(-EADDRINUSE, d.slots[0].last_error);
+}
+
+void test_backoff_doubles_and_caps(void)
+{
+  TEST_ASSERT_EQUAL_UINT32(1000, mwd_backoff(1000, 1));
+  TEST_ASSERT_EQUAL_UINT32(2000, mwd_backoff(1000, 2));
+  TEST_ASSERT_EQUAL_UINT32(8000, mwd_backoff(1000, 4));
+  TEST_ASSERT_EQUAL_UINT32(MWD_BACKOFF_MAX_MS, mwd_backoff(1000, 40));
+}
+
+void test_fault_stops_service_for_retry(void)
+{
+  struct pollfd pfds[8];
+
+  mwd_start(&d, 0, T0);
+  mwd_start(&d, 1, T0);
+  fb.events_ret = -EIO;
+  g_log[0] = '\0';
+
+  mwd_pollset(&d, pfds, BASE);
+  mwd_events(&d, pfds, T0 + 10);
+
+  TEST_ASSERT_EQUAL_STRING("Bx", g_log);
+  TEST_ASSERT_FALSE(g_b_running);
+  TEST_ASSERT_EQUAL_UINT8(MWD_RETRY, d.slots[1].state);
+  TEST_ASSERT_EQUAL_UINT8(MWD_RUNNING, d.slots[0].state);
+  TEST_ASSERT_EQUAL_INT(-EIO, d.slots[1].last_error);
+}
+
+void test_stable_service_forgets_old_failures(void)
+{
+  fa.start_ret = -EIO;
+  mwd_start(&d, 0, T0);
+  mwd_run(&d, T0 + MWD_BACKOFF_MS);          /* Second failure */
+  fa.start_ret = OK;
+  mwd_run(&d, T0 + 3 * MWD_BACKOFF_MS);      /* Up */
+  TEST_ASSERT_EQUAL_UINT32(2, d.slots[0].failures);
+
+  /* Faults after a long run start over at the first backoff step */
+
+  mwd_fault(&d, 0, -EIO, T0 + 3 * MWD_BACKOFF_MS + MWD_STABLE_MS);
+  TEST_ASSERT_EQUAL_UINT32(1, d.slots[0].failures);
+  TEST_ASSERT_EQUAL_UINT32(T0 + 4 * MWD_BACKOFF_MS + MWD_STABLE_MS,
+                           d.slots[0].retry_ms);
+}
+
+void test_cleared_flag_stops_service(void)
+{
+  mwd_start(&d, 0, T0);
+  g_log[0] = '\0';
+
+  g_a_running = false;     /* `alpha stop` */
+  mwd_run(&d, T0 + 10);
+
+  TEST_ASSERT_EQUAL_STRING("Ax", g_log);
+  TEST_ASSERT_EQUAL_UINT8(MWD_STOPPED, d.slots[0].state);
+  TEST_ASSERT_EQUAL_INT(0, mwd_fds_used(&d));
+}
+
+/* ================================================================
+ * Event loop
+ * ================================================================ */
+
+void test_pollset_lays_out_blocks_after_base(void)
+{
+  struct pollfd pfds[8];
+
+  mwd_start(&d, 0, T0);
+  mwd_start(&d, 1, T0);
+
+  TEST_ASSERT_EQUAL_INT(BASE + 3, mwd_pollset(&d, pfds, BASE));
+  TEST_ASSERT_EQUAL_INT(10, pfds[BASE].fd);
+  TEST_ASSERT_EQUAL_INT(11, pfds[BASE + 1].fd);
+  TEST_ASSERT_EQUAL_INT(20, pfds[BASE + 2].fd);
+
+  /* Each service sees its own revents */
+
+  pfds[BASE + 2].revents = POLLIN;
+  mwd_events(&d, pfds, T0);
+  TEST_ASSERT_EQUAL_INT(0, fa.revents);
+  TEST_ASSERT_EQUAL_INT(POLLIN, fb.revents);
+}
+
+void test_service_started_mid_pass_gets_no_events(void)
+{
+  struct pollfd pfds[8];
+
+  mwd_start(&d, 0, T0);
+  mwd_pollset(&d, pfds, BASE);
+  mwd_start(&d, 1, T0);    /* From a control request after poll() */
+
+  pfds[BASE].revents = POLLIN;
+  mwd_events(&d, pfds, T0);
+  TEST_ASSERT_EQUAL_INT(POLLIN, fa.revents);
+  TEST_ASSERT_EQUAL_INT(0, fb.revents);
+}
+
+void test_frame_reaches_every_running_service(void)
+{
+  struct mmwave_eng_data_s eng;
+
+  memset(&eng, 0, sizeof(eng));
+  mwd_start(&d, 1, T0);
+
+  mwd_frame(&d, &eng, false, T0 + 100);
+  TEST_ASSERT_EQUAL_INT(0, fa.frames);
+  TEST_ASSERT_EQUAL_INT(1, fb.frames);
+  TEST_ASSERT_EQUAL_UINT32(1, d.wd.frames);
+}
+
+void test_ticks_follow_service_schedule(void)
+{
+  mwd_init(&d, 4, 0, T0);
+  mwd_add(&d, &svc_a);
+  mwd_start(&d, 0, T0);
+
+  TEST_ASSERT_EQUAL_UINT32(100, mwd_run(&d, T0));
+  TEST_ASSERT_EQUAL_INT(1, fa.ticks);
+  TEST_ASSERT_EQUAL_UINT32(40, mwd_run(&d, T0 + 60));
+  TEST_ASSERT_EQUAL_INT(1, fa.ticks);
+  mwd_run(&d, T0 + 100);
+  TEST_ASSERT_EQUAL_INT(2, fa.ticks);
+}
+
+void test_idle_wait_is_bounded(void)
+{
+  mwd_init(&d, 4, 0, T0);
+  mwd_add(&d, &svc_b);
+  mwd_start(&d, 0, T0);
+
+  TEST_ASSERT_EQUAL_UINT32(MMWAVE_SERVICE_IDLE_MS, mwd_run(&d, T0));
+}
+
+/* ================================================================
+ * Sensor watchdog
+ * ================================================================ */
+
+void test_watchdog_restarts_silent_sensor_with_backoff(void)
+{
+  TEST_ASSERT_FALSE(mwd_watchdog_due(&d, T0 + 4999));
+  TEST_ASSERT_TRUE(mwd_watchdog_due(&d, T0 + 5000));
+  TEST_ASSERT_FALSE(mwd_watchdog_due(&d, T0 + 9999));
+  TEST_ASSERT_TRUE(mwd_watchdog_due(&d, T0 + 10000));
+
+  /* Still silent: the next try waits twice as long */
+
+  TEST_ASSERT_FALSE(mwd_watchdog_due(&d, T0 + 19999));
+  TEST_ASSERT_TRUE(mwd_watchdog_due(&d, T0 + 20000));
+  TEST_ASSERT_EQUAL_UINT32(3, d.wd.restarts);
+}
+
+void test_watchdog_quiet_while_frames_arrive(void)
+{
+  struct mmwave_eng_data_s eng;
+
+  memset(&eng, 0, sizeof(eng));
+  for (uint32_t t = T0; t < T0 + 20000; t += 100)
+    {
+      mwd_frame(&d, &eng, false, t);
+      TEST_ASSERT_FALSE(mwd_watchdog_due(&d, t + 50));
+    }
+
+  /* A deliberate restart is not a stall either */
+
+  mwd_watchdog_touch(&d, T0 + 24000);
+  TEST_ASSERT_FALSE(mwd_watchdog_due(&d, T0 + 28000));
+  TEST_ASSERT_EQUAL_UINT32(0, d.wd.restarts);
+}
+
+/* ================================================================
+ * Control protocol
+ * ================================================================ */
+
+void test_ctl_parse_splits_words(void)
+{
+  char line[] = "sensor sens 3 40 50\r\n";
+  char many[] = "a b c d e f";
+  char blank[] = "  \n";
+  struct mwd_req_s req;
+
+  TEST_ASSERT_EQUAL_INT(5, mwd_ctl_parse(line, &req));
+  TEST_ASSERT_EQUAL_STRING("sensor", req.argv[0]);
+  TEST_ASSERT_EQUAL_STRING("50", req.argv[4]);
+  TEST_ASSERT_EQUAL_INT(-EINVAL, mwd_ctl_parse(many, &req));
+  TEST_ASSERT_EQUAL_INT(-EINVAL, mwd_ctl_parse(blank, &req));
+}
+
+void test_ctl_start_stop_restart(void)
+{
+  TEST_ASSERT_EQUAL_STRING("OK running\n", ctl("start alpha", T0));
+  TEST_ASSERT_EQUAL_STRING("OK running\n", ctl("start alpha", T0));
+  TEST_ASSERT_EQUAL_STRING("OK running\n", ctl("restart alpha", T0));
+  TEST_ASSERT_EQUAL_STRING("AsAxAs", g_log);
+  TEST_ASSERT_EQUAL_STRING("OK stopped\n", ctl("stop alpha", T0));
+  TEST_ASSERT_FALSE(g_a_running);
+}
+
+static const char *err(int e)
+{
+  static char line[16];
+
+  snprintf(line, sizeof(line), "ERR %d\n", e);
+  return line;
+}
+
+void test_ctl_errors(void)
+{
+  char buf[32];
+
+  TEST_ASSERT_EQUAL_STRING(err(ENOENT), ctl("start gamma", T0));
+  TEST_ASSERT_EQUAL_STRING(err(EINVAL), ctl("start", T0));
+  TEST_ASSERT_EQUAL_STRING(err(EALREADY), ctl("stop beta", T0));
+  TEST_ASSERT_EQUAL_STRING(err(ESRCH), ctl("restart beta", T0));
+  TEST_ASSERT_EQUAL_STRING("ENOSYS", ctl("ping", T0));
+
+  /* A failed start is reported but left to the retry */
+
+  fb.start_ret = -EADDRINUSE;
+  snprintf(buf, sizeof(buf), "OK retrying (%d)\n", -EADDRINUSE);
+  TEST_ASSERT_EQUAL_STRING(buf, ctl("start beta", T0));
+  TEST_ASSERT_EQUAL_UINT8(MWD_RETRY, d.slots[1].state);
+}
+
+void test_client_parses_replies(void)
+{
+  char out[16];
+
+  TEST_ASSERT_EQUAL_INT(OK, mmwaved_parse_reply("OK running", out,
+                                                sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("running", out);
+  TEST_ASSERT_EQUAL_INT(OK, mmwaved_parse_reply("OK", out, sizeof(out)));
+  TEST_ASSERT_EQUAL_STRING("", out);
+  TEST_ASSERT_EQUAL_INT(-EALREADY, mmwaved_parse_reply(err(EALREADY),
+                                                       NULL, 0));
+  TEST_ASSERT_EQUAL_INT(-EPROTO, mmwaved_parse_reply("OKAY", NULL, 0));
+  TEST_ASSERT_EQUAL_INT(-EPROTO, mmwaved_parse_reply("ERR x", NULL, 0));
+  TEST_ASSERT_EQUAL_INT(-EPROTO, mmwaved_parse_reply("", NULL, 0));
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Hosting */
+  RUN_TEST(test_start_hosts_service_and_sets_its_flag);
+  RUN_TEST(test_registration_is_bounded_and_found_by_name);
+  RUN_TEST(test_service_in_its_own_task_is_refused);
+  RUN_TEST(test_full_poll_set_refuses_service);
+
+  /* Supervision */
+  RUN_TEST(test_failed_start_retries_with_backoff);
+  RUN_TEST(test_backoff_doubles_and_caps);
+  RUN_TEST(test_fault_stops_service_for_retry);
+  RUN_TEST(test_stable_service_forgets_old_failures);
+  RUN_TEST(test_cleared_flag_stops_service);
+
+  /* Event loop */
+  RUN_TEST(test_pollset_lays_out_blocks_after_base);
+  RUN_TEST(test_service_started_mid_pass_gets_no_events);
+  RUN_TEST(test_frame_reaches_every_running_service);
+  RUN_TEST(test_ticks_follow_service_schedule);
+  RUN_TEST(test_idle_wait_is_bounded);
+
+  /* Sensor watchdog */
+  RUN_TEST(test_watchdog_restarts_silent_sensor_with_backoff);
+  RUN_TEST(test_watchdog_quiet_while_frames_arrive);
+
+  /* Control protocol */
+  RUN_TEST(test_ctl_parse_splits_words);
+  RUN_TEST(test_ctl_start_stop_restart);
+  RUN_TEST(test_ctl_errors);
+  RUN_TEST(test_client_parses_replies);
+
+  return UNITY_END();
+}
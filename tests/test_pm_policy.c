@@ -0,0 +1,249 @@
+/*
+ * tests/test_pm_policy.c
+ *
+ * Unit tests for the sensor-driven PM governor's policy
+ * (drivers/mmwave/mmwave_pm.h) and its JSON
+ * (apps/common/mmwave_json.h): full performance while a frame is
+ * handled, other work is recent or something holds PM_NORMAL, IDLE
+ * between frames, STANDBY only once the sensor is quiet, and the
+ * residency statistics, over single events and a simulated activity
+ * trace.
+ */
+
+#include "unity/unity.h"
+
+#include "drivers/mmwave/mmwave_pm.h"
+#include "apps/common/mmwave_json.h"
+
+#define FRAME_HOLD  CONFIG_MMWAVE_PM_FRAME_HOLD_MS
+#define WORK_HOLD   CONFIG_MMWAVE_PM_ACTIVITY_HOLD_MS
+#define STANDBY_MS  CONFIG_MMWAVE_PM_STANDBY_MS
+
+/* ---- Test helpers ---- */
+
+static struct mmwave_pm_s g_pm;
+
+/* What the idle loop does: ask, and move if the answer differs */
+
+static int step(uint32_t now, bool pending)
+{
+  int state = mmwave_pm_recommend(&g_pm, now, pending);
+
+  mmwave_pm_changed(&g_pm, now, state);
+  return state;
+}
+
+void setUp(void)
+{
+  mmwave_pm_init(&g_pm, 0);
+}
+
+void tearDown(void)
+{
+}
+
+/* ---- Single events ---- */
+
+static void test_init_starts_normal(void)
+{
+  struct mmwave_pm_stats_s st;
+
+  mmwave_pm_stats(&g_pm, 0, &st);
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, st.state);
+  TEST_ASSERT_EQUAL_UINT32(1, st.entries[MMWAVE_PM_NORMAL]);
+  TEST_ASSERT_EQUAL_UINT32(0, st.ms[MMWAVE_PM_NORMAL]);
+
+  /* Nothing seen yet: no frames to wait for */
+
+  TEST_ASSERT_EQUAL(MMWAVE_PM_STANDBY, step(1, false));
+}
+
+static void test_frame_holds_normal_then_idle(void)
+{
+  mmwave_pm_activity(&g_pm, 100, true);
+
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(100, false));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(100 + FRAME_HOLD - 1, false));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_IDLE, step(100 + FRAME_HOLD, false));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_IDLE, step(199, false));
+
+  /* The next frame */
+
+  mmwave_pm_activity(&g_pm, 200, true);
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(200, false));
+  TEST_ASSERT_EQUAL_UINT32(2, g_pm.entries[MMWAVE_PM_NORMAL]);
+  TEST_ASSERT_EQUAL_UINT32(1, g_pm.entries[MMWAVE_PM_IDLE]);
+}
+
+static void test_pending_work_holds_normal(void)
+{
+  mmwave_pm_activity(&g_pm, 100, true);
+
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(150, true));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(100 + STANDBY_MS * 2, true));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_STANDBY, step(100 + STANDBY_MS * 2, false));
+}
+
+static void test_other_activity_holds_longer(void)
+{
+  mmwave_pm_activity(&g_pm, 100, false);
+
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(100 + WORK_HOLD - 1, false));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_STANDBY, step(100 + WORK_HOLD, false));
+
+  /* A frame inside a longer hold does not cut it short */
+
+  mmwave_pm_activity(&g_pm, 300, false);
+  mmwave_pm_activity(&g_pm, 301, true);
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(301 + FRAME_HOLD, false));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_IDLE, step(300 + WORK_HOLD, false));
+}
+
+static void test_standby_only_after_silence(void)
+{
+  mmwave_pm_activity(&g_pm, 0, true);
+
+  TEST_ASSERT_EQUAL(MMWAVE_PM_IDLE, step(STANDBY_MS - 1, false));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_STANDBY, step(STANDBY_MS, false));
+
+  /* The sensor again: straight back to full performance */
+
+  mmwave_pm_activity(&g_pm, 5000, true);
+  TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, step(5000, false));
+  TEST_ASSERT_EQUAL(MMWAVE_PM_IDLE, step(5000 + FRAME_HOLD, false));
+}
+
+static void test_residency_counts_open_interval(void)
+{
+  struct mmwave_pm_stats_s st;
+  uint32_t t0 = 0xfffffff0u;
+
+  /* Across the clock wrapping */
+
+  mmwave_pm_init(&g_pm, t0);
+  mmwave_pm_activity(&g_pm, t0, true);
+  step(t0 + FRAME_HOLD, false);
+  TEST_ASSERT_EQUAL(MMWAVE_PM_IDLE, g_pm.state);
+
+  mmwave_pm_stats(&g_pm, t0 + 500, &st);
+  TEST_ASSERT_EQUAL_UINT32(FRAME_HOLD, st.ms[MMWAVE_PM_NORMAL]);
+  TEST_ASSERT_EQUAL_UINT32(500 - FRAME_HOLD, st.ms[MMWAVE_PM_IDLE]);
+  TEST_ASSERT_EQUAL(MMWAVE_PM_IDLE, st.state);
+
+  /* Reading does not close the interval; unknown states are ignored */
+
+  mmwave_pm_changed(&g_pm, t0 + 600, 3);
+  mmwave_pm_changed(&g_pm, t0 + 600, -1);
+  mmwave_pm_stats(&g_pm, t0 + 700, &st);
+  TEST_ASSERT_EQUAL_UINT32(700 - FRAME_HOLD, st.ms[MMWAVE_PM_IDLE]);
+  TEST_ASSERT_EQUAL_UINT32(0, st.entries[MMWAVE_PM_STANDBY]);
+}
+
+/* ---- A simulated trace ---- */
+
+/* Five seconds of frames at 10 Hz, each arriving as two bursts of UART
+ * bytes a ms apart, with a report every second that is in flight for
+ * 40 ms; then three seconds with nothing in front of the sensor, which
+ * has stopped sending. Every ms the idle loop asks the governor.
+ */
+
+static void test_trace_streaming_then_silence(void)
+{
+  struct mmwave_pm_stats_s st;
+  uint32_t idle = 0;
+  uint32_t t;
+
+  for (t = 0; t < 5000; t++)
+    {
+      bool frame   = t % 100 == 0 || t % 100 == 1;
+      bool pending = t % 1000 >= 50 && t % 1000 < 90;
+      int state;
+
+      if (frame)
+        {
+          mmwave_pm_activity(&g_pm, t, true);
+        }
+
+      state = step(t, pending);
+
+      if (t % 100 < FRAME_HOLD || pending)
+        {
+          TEST_ASSERT_EQUAL(MMWAVE_PM_NORMAL, state);
+        }
+
+      TEST_ASSERT_NOT_EQUAL(MMWAVE_PM_STANDBY, state);
+      idle += state == MMWAVE_PM_IDLE;
+    }
+
+  /* Mostly idle while streaming: 11 ms a frame and 40 ms a report */
+
+  TEST_ASSERT_EQUAL_UINT32(5000 - 50 * (FRAME_HOLD + 1) - 5 * 40, idle);
+
+  for (; t < 8000; t++)
+    {
+      int state = step(t, false);
+
+      TEST_ASSERT_EQUAL(t < 4901 + STANDBY_MS ? MMWAVE_PM_IDLE :
+                        MMWAVE_PM_STANDBY, state);
+    }
+
+  mmwave_pm_stats(&g_pm, t, &st);
+  TEST_ASSERT_EQUAL(MMWAVE_PM_STANDBY, st.state);
+  TEST_ASSERT_EQUAL_UINT32(1, st.entries[MMWAVE_PM_STANDBY]);
+  TEST_ASSERT_EQUAL_UINT32(8000 - 4901 - STANDBY_MS,
+                           st.ms[MMWAVE_PM_STANDBY]);
+  TEST_ASSERT_EQUAL_UINT32(8000, st.ms[MMWAVE_PM_NORMAL] +
+                                 st.ms[MMWAVE_PM_IDLE] +
+                                 st.ms[MMWAVE_PM_STANDBY]);
+
+  /* Booted in NORMAL, then back for 49 more frames and 5 reports */
+
+  TEST_ASSERT_EQUAL_UINT32(1 + 49 + 5, st.entries[MMWAVE_PM_NORMAL]);
+}
+
+/* ---- JSON ---- */
+
+static void test_json_pm(void)
+{
+  struct mmwave_pm_stats_s st;
+  struct json_writer_s w;
+  struct json_buf_s out;
+  char buf[200];
+
+  mmwave_pm_activity(&g_pm, 0, true);
+  step(FRAME_HOLD, false);
+  mmwave_pm_stats(&g_pm, 100, &st);
+
+  out.buf  = buf;
+  out.size = sizeof(buf);
+  out.len  = 0;
+  json_init(&w, json_sink_buf, &out);
+  json_begin_object(&w, NULL);
+  mmwave_json_pm(&w, &st);
+  json_end_object(&w);
+  TEST_ASSERT_GREATER_OR_EQUAL_INT(0, json_finish_buf(&w, &out));
+
+  TEST_ASSERT_EQUAL_STRING("{\"pm\":{\"state\":\"idle\","
+                           "\"ms\":{\"normal\":10,\"idle\":90,"
+                           "\"standby\":0},"
+                           "\"entries\":{\"normal\":1,\"idle\":1,"
+                           "\"standby\":0}}}", buf);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_init_starts_normal);
+  RUN_TEST(test_frame_holds_normal_then_idle);
+  RUN_TEST(test_pending_work_holds_normal);
+  RUN_TEST(test_other_activity_holds_longer);
+  RUN_TEST(test_standby_only_after_silence);
+  RUN_TEST(test_residency_counts_open_interval);
+
+  RUN_TEST(test_trace_streaming_then_silence);
+
+  RUN_TEST(test_json_pm);
+
+  return UNITY_END();
+}
@@ -0,0 +1,261 @@
+/*
+ * tests/test_profile.c
+ *
+ * Unit tests for named sensor profiles (apps/common/mmwave_profile.h):
+ * the compact encoding and its validation, profile names, parsing
+ * profile.schedule, the scheduler's time, presence and idle rules, and
+ * switching profiles against a simulated sensor - one session, only
+ * the commands that differ, none for the profile already in place.
+ */
+
+#include "unity/unity.h"
+
+#include "drivers/mmwave/mmwave_ld2410.c"
+#include "apps/common/mmwave_profile.h"
+#include "helpers/fake_ld2410.h"
+
+/* ---- Test helpers ---- */
+
+static struct mmwave_dev_s g_dev;
+static struct mmwave_sched_s g_s;
+
+static const struct mmwave_config_s g_day =
+{
+  8, 8, 5,
+  { 50, 50, 40, 30, 20, 15, 15, 15, 15 },
+  {  0,  0, 40, 40, 30, 30, 20, 20, 20 }
+};
+
+/* Night: nearer gates, a longer hold, static gates far more sensitive */
+
+static const struct mmwave_config_s g_night =
+{
+  6, 6, 30,
+  { 50, 50, 40, 30, 20, 15, 15, 15, 15 },
+  {  0,  0, 20, 20, 15, 15, 10, 20, 20 }
+};
+
+static int switch_to(const struct mmwave_config_s *cfg)
+{
+  struct mmwave_apply_s req;
+
+  req.cfg  = *cfg;
+  req.mask = MMWAVE_APPLY_ALL;
+  return mmwave_apply(&g_dev, &req);
+}
+
+void setUp(void)
+{
+  memset(&g_dev, 0, sizeof(g_dev));
+  g_dev.parse_state = PARSE_HEADER;
+  g_dev.uart_fd = -1;
+  nxsem_init(&g_dev.data_sem, 0, 1);
+  nxsem_init(&g_dev.cmd_sem, 0, 1);
+  nxsem_init(&g_dev.wait_sem, 0, 0);
+}
+
+void tearDown(void)
+{
+  fake_ld2410_detach();
+}
+
+/* ---- Encoding ---- */
+
+static void test_encode_decode_round_trip(void)
+{
+  struct mmwave_config_s cfg;
+  char hex[MMWAVE_PROFILE_HEX + 1];
+
+  mmwave_profile_encode(&g_night, hex);
+  TEST_ASSERT_EQUAL(44, strlen(hex));
+  TEST_ASSERT_EQUAL_STRING_LEN("06061e00", hex, 8);
+
+  memset(&cfg, 0xff, sizeof(cfg));
+  TEST_ASSERT_EQUAL(OK, mmwave_profile_decode(hex, &cfg));
+  TEST_ASSERT_EQUAL_MEMORY(&g_night, &cfg, sizeof(cfg));
+}
+
+static void test_decode_rejects_bad_profiles(void)
+{
+  struct mmwave_config_s cfg;
+  char hex[MMWAVE_PROFILE_HEX + 1];
+
+  mmwave_profile_encode(&g_day, hex);
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_profile_decode(hex + 2, &cfg));
+
+  hex[10] = 'g';
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_profile_decode(hex, &cfg));
+
+  mmwave_profile_encode(&g_day, hex);
+  hex[0] = '0';
+  hex[1] = '9';                                 /* Max gate 9 */
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_profile_decode(hex, &cfg));
+
+  mmwave_profile_encode(&g_day, hex);
+  hex[8] = '6';
+  hex[9] = '5';                                 /* Threshold 101 */
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_profile_decode(hex, &cfg));
+}
+
+static void test_profile_names(void)
+{
+  TEST_ASSERT_TRUE(mmwave_profile_name_valid("night"));
+  TEST_ASSERT_TRUE(mmwave_profile_name_valid("day-2_low"));
+  TEST_ASSERT_FALSE(mmwave_profile_name_valid(""));
+  TEST_ASSERT_FALSE(mmwave_profile_name_valid("Night"));
+  TEST_ASSERT_FALSE(mmwave_profile_name_valid("a.b"));
+  TEST_ASSERT_FALSE(mmwave_profile_name_valid("schedule"));
+  TEST_ASSERT_FALSE(mmwave_profile_name_valid("abcdefghijklmnop"));
+}
+
+/* ---- Schedule ---- */
+
+static void test_schedule_parse(void)
+{
+  TEST_ASSERT_EQUAL(4, mmwave_sched_parse(&g_s, "07:00=day,22:30=night,"
+                                          "idle:600=empty,presence=day",
+                                          0));
+  TEST_ASSERT_EQUAL(MMWAVE_SCHED_AT, g_s.rules[1].kind);
+  TEST_ASSERT_EQUAL(22 * 60 + 30, g_s.rules[1].arg);
+  TEST_ASSERT_EQUAL_STRING("night", g_s.rules[1].name);
+  TEST_ASSERT_EQUAL(MMWAVE_SCHED_IDLE, g_s.rules[2].kind);
+  TEST_ASSERT_EQUAL(600, g_s.rules[2].arg);
+  TEST_ASSERT_EQUAL(MMWAVE_SCHED_PRESENCE, g_s.rules[3].kind);
+}
+
+static void test_schedule_parse_rejects(void)
+{
+  static const char *const bad[] =
+  {
+    "24:00=x", "7:00=x", "07:60=x", "07:00", "07:00=", "idle:0=x",
+    "idle:=x", "idle:5s=x", "sometimes=x", "07:00=Day", "07:00=x,,"
+  };
+
+  for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++)
+    {
+      TEST_ASSERT_EQUAL_MESSAGE(-EINVAL, mmwave_sched_parse(&g_s, bad[i],
+                                                            0), bad[i]);
+      TEST_ASSERT_EQUAL(0, g_s.nrules);
+    }
+
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_sched_parse(&g_s, "00:00=a,00:01=a,"
+                                                "00:02=a,00:03=a,00:04=a,"
+                                                "00:05=a,00:06=a,00:07=a,"
+                                                "00:08=a", 0));
+}
+
+static void test_schedule_first_step_picks_rule_in_force(void)
+{
+  mmwave_sched_parse(&g_s, "07:00=day,22:30=night", 0);
+
+  /* No clock yet: nothing */
+
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 1000, -1, false));
+
+  /* 02:00 is still night, from yesterday's 22:30 */
+
+  TEST_ASSERT_EQUAL(1, mmwave_sched_step(&g_s, 2000, 120, false));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 3000, 120, false));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 4000, 419, false));
+  TEST_ASSERT_EQUAL(0, mmwave_sched_step(&g_s, 5000, 420, false));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 6000, 420, false));
+}
+
+static void test_schedule_presence_and_idle(void)
+{
+  mmwave_sched_parse(&g_s, "idle:60=empty,presence=busy", 0);
+
+  TEST_ASSERT_EQUAL(1, mmwave_sched_step(&g_s, 1000, -1, true));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 2000, -1, true));
+
+  /* Gone at 10 s: the idle rule a minute later, once */
+
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 10000, -1, false));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 69999, -1, false));
+  TEST_ASSERT_EQUAL(0, mmwave_sched_step(&g_s, 70000, -1, false));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 200000, -1, false));
+
+  /* Back, then gone again: the idle timer starts over */
+
+  TEST_ASSERT_EQUAL(1, mmwave_sched_step(&g_s, 210000, -1, true));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 220000, -1, false));
+  TEST_ASSERT_EQUAL(-1, mmwave_sched_step(&g_s, 250000, -1, false));
+  TEST_ASSERT_EQUAL(0, mmwave_sched_step(&g_s, 280000, -1, false));
+}
+
+/* ---- Switching against the simulated sensor ---- */
+
+static void test_switch_is_one_session_of_differences(void)
+{
+  TEST_ASSERT_EQUAL(0, fake_ld2410_attach(&g_dev, &g_day));
+
+  /* Max gates and timeout in one command, then gates 2-6 */
+
+  TEST_ASSERT_EQUAL(6, switch_to(&g_night));
+  TEST_ASSERT_EQUAL(1, g_fake.sessions);
+  TEST_ASSERT_EQUAL(6, g_fake.sets);
+  TEST_ASSERT_EQUAL(9, g_fake.commands);     /* Enter, read, exit too */
+  TEST_ASSERT_FALSE(g_fake.config_mode);
+  TEST_ASSERT_EQUAL_MEMORY(&g_night, &g_fake.cfg, sizeof(g_night));
+  TEST_ASSERT_EQUAL_MEMORY(&g_night, &g_dev.config, sizeof(g_night));
+}
+
+static void test_switch_to_current_profile_sends_nothing(void)
+{
+  fake_ld2410_attach(&g_dev, &g_day);
+
+  TEST_ASSERT_EQUAL(6, switch_to(&g_night));
+  g_fake.commands = 0;
+  g_fake.sessions = 0;
+
+  TEST_ASSERT_EQUAL(0, switch_to(&g_night));
+  TEST_ASSERT_EQUAL(0, g_fake.commands);
+  TEST_ASSERT_EQUAL(0, g_fake.sessions);
+
+  /* And back: the same six, with the configuration already known */
+
+  TEST_ASSERT_EQUAL(6, switch_to(&g_day));
+  TEST_ASSERT_EQUAL(8, g_fake.commands);
+  TEST_ASSERT_EQUAL_MEMORY(&g_day, &g_fake.cfg, sizeof(g_day));
+}
+
+static void test_refused_command_invalidates_cache(void)
+{
+  fake_ld2410_attach(&g_dev, &g_day);
+  switch_to(&g_day);
+  TEST_ASSERT_TRUE(g_dev.config_valid);
+
+  /* The sensor drops out of config mode halfway: nothing is assumed */
+
+  g_fake.config_mode = false;
+  g_dev.config.timeout_s = 99;
+  TEST_ASSERT_EQUAL(-ETIMEDOUT, mmwave_set_maxgate(&g_dev,
+                    &(struct mmwave_maxgate_s){ 8, 8, 5 }));
+  TEST_ASSERT_FALSE(g_dev.config_valid);
+
+  /* The next switch reads the sensor again before planning */
+
+  g_fake.commands = 0;
+  TEST_ASSERT_EQUAL(6, switch_to(&g_night));
+  TEST_ASSERT_EQUAL(9, g_fake.commands);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_encode_decode_round_trip);
+  RUN_TEST(test_decode_rejects_bad_profiles);
+  RUN_TEST(test_profile_names);
+
+  RUN_TEST(test_schedule_parse);
+  RUN_TEST(test_schedule_parse_rejects);
+  RUN_TEST(test_schedule_first_step_picks_rule_in_force);
+  RUN_TEST(test_schedule_presence_and_idle);
+
+  RUN_TEST(test_switch_is_one_session_of_differences);
+  RUN_TEST(test_switch_to_current_profile_sends_nothing);
+  RUN_TEST(test_refused_command_invalidates_cache);
+
+  return UNITY_END();
+}
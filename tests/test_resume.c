@@ -0,0 +1,251 @@
+/*
+ * tests/test_resume.c
+ *
+ * Unit tests for deep-sleep resume (apps/common/mmwave_resume.h and the
+ * driver's snapshot and restore in mmwave_ld2410.c): the retained block
+ * sealed and checked against the wake cause, damaged and foreign
+ * blocks, the driver's state carried over a sleep so the sensor is not
+ * probed again, the resume-to-report latency and when the board may
+ * sleep: never while a transition is neither delivered nor journaled.
+ *
+ * We #include the driver .c directly to reach the static functions.
+ */
+
+#include "unity/unity.h"
+#include "helpers/frame_builder.h"
+
+#include "drivers/mmwave/mmwave_ld2410.c"
+#include "apps/common/mmwave_resume.h"
+
+/* ---- Test helpers ---- */
+
+static struct mmwave_dev_s g_dev;
+static struct mmwave_resume_s g_rtc;
+
+static const struct mmwave_config_s g_tuned =
+{
+  6, 6, 10,
+  { 50, 50, 40, 30, 20, 15, 15, 15, 15 },
+  {  0,  0, 40, 40, 60, 30, 20, 20, 20 }
+};
+
+/* A driver as mmwave_ld2410_register() leaves it, without the UART */
+
+static void fresh_driver(void)
+{
+  memset(&g_dev, 0, sizeof(g_dev));
+  g_dev.parse_state = PARSE_HEADER;
+  g_dev.uart_fd = -1;
+  nxsem_init(&g_dev.data_sem, 0, 1);
+  nxsem_init(&g_dev.cmd_sem, 0, 1);
+  nxsem_init(&g_dev.wait_sem, 0, 0);
+  g_mmwave_dev = &g_dev;
+}
+
+/* What the board puts in the block before it sleeps */
+
+static void fill_block(struct mmwave_resume_s *r)
+{
+  struct mmwave_snapshot_s snap;
+
+  g_dev.data.target_state    = LD2410_TARGET_NONE;
+  g_dev.data.static_distance = 210;
+  g_dev.data.timestamp_ms    = 61000;
+  g_dev.data_valid   = true;
+  g_dev.config       = g_tuned;
+  g_dev.config_valid = true;
+  g_dev.frames_ok    = 600;
+  g_dev.frames_err   = 2;
+  g_dev.cfg_writes   = 3;
+  TEST_ASSERT_EQUAL(OK, mmwave_ld2410_snapshot(&snap));
+
+  r->sensor = snap;
+  snprintf(r->uart, sizeof(r->uart), "/dev/ttyS1");
+  r->baud = 256000;
+  r->tag  = mmwave_wifi_tag("home", "secret");
+  r->net  = MMWAVE_RESUME_AP | MMWAVE_RESUME_LEASE;
+  r->ap.channel = 6;
+  r->ap.bssid[0] = 0xa4;
+  r->lease.ip = htonl(0xc0a8010a);
+  r->sleeps++;
+  mmwave_resume_seal(r);
+}
+
+void setUp(void)
+{
+  fresh_driver();
+  mmwave_resume_clear(&g_rtc);
+}
+
+void tearDown(void)
+{
+  g_mmwave_dev = NULL;
+}
+
+/* ---- The retained block ---- */
+
+static void test_sealed_block_resumes_on_wake(void)
+{
+  fill_block(&g_rtc);
+
+  TEST_ASSERT_EQUAL(OK, mmwave_resume_check(&g_rtc, MMWAVE_WAKE_PIN));
+  TEST_ASSERT_EQUAL(OK, mmwave_resume_check(&g_rtc, MMWAVE_WAKE_TIMER));
+  TEST_ASSERT_EQUAL_UINT32(1, g_rtc.sleeps);
+}
+
+static void test_cold_boot_ignores_block(void)
+{
+  TEST_ASSERT_EQUAL(-ENOENT, mmwave_resume_check(&g_rtc,
+                                                 MMWAVE_WAKE_TIMER));
+
+  fill_block(&g_rtc);
+  TEST_ASSERT_EQUAL(-ENOENT, mmwave_resume_check(&g_rtc,
+                                                 MMWAVE_WAKE_COLD));
+}
+
+static void test_damaged_or_foreign_block_rejected(void)
+{
+  fill_block(&g_rtc);
+  g_rtc.sensor.config.timeout_s++;
+  TEST_ASSERT_EQUAL(-EBADMSG, mmwave_resume_check(&g_rtc,
+                                                  MMWAVE_WAKE_PIN));
+
+  fill_block(&g_rtc);
+  g_rtc.version++;
+  TEST_ASSERT_EQUAL(-ESTALE, mmwave_resume_check(&g_rtc,
+                                                 MMWAVE_WAKE_PIN));
+
+  fill_block(&g_rtc);
+  g_rtc.size--;
+  TEST_ASSERT_EQUAL(-ESTALE, mmwave_resume_check(&g_rtc,
+                                                 MMWAVE_WAKE_PIN));
+}
+
+/* ---- The driver over a sleep ---- */
+
+static void test_restore_skips_sensor_probe(void)
+{
+  struct mmwave_apply_s req;
+  struct mmwave_resume_s copy;
+
+  fill_block(&g_rtc);
+  memcpy(&copy, &g_rtc, sizeof(copy));
+
+  /* Deep sleep: the driver starts from nothing */
+
+  fresh_driver();
+  TEST_ASSERT_EQUAL(OK, mmwave_resume_check(&copy, MMWAVE_WAKE_PIN));
+  TEST_ASSERT_EQUAL(OK, mmwave_ld2410_restore(&copy.sensor));
+
+  /* The tuning is what the sensor has: nothing sent, nothing read back
+   * (any command would fail, there is no UART)
+   */
+
+  req.cfg  = g_tuned;
+  req.mask = MMWAVE_APPLY_ALL;
+  TEST_ASSERT_EQUAL(0, mmwave_apply(&g_dev, &req));
+  TEST_ASSERT_EQUAL(0, req.sent);
+
+  /* Without it the driver has to ask the sensor first */
+
+  fresh_driver();
+  TEST_ASSERT_EQUAL(-EIO, mmwave_apply(&g_dev, &req));
+}
+
+static void test_restore_carries_reading_and_stats(void)
+{
+  fill_block(&g_rtc);
+  fresh_driver();
+  g_dev.frames_ok = 5;
+
+  TEST_ASSERT_EQUAL(OK, mmwave_ld2410_restore(&g_rtc.sensor));
+  TEST_ASSERT_TRUE(g_dev.data_valid);
+  TEST_ASSERT_EQUAL(210, g_dev.data.static_distance);
+  TEST_ASSERT_EQUAL_UINT32(0, g_dev.data.timestamp_ms);
+  TEST_ASSERT_EQUAL_UINT32(0, g_dev.frame_seq);
+  TEST_ASSERT_EQUAL_UINT32(605, g_dev.frames_ok);
+  TEST_ASSERT_EQUAL_UINT32(2, g_dev.frames_err);
+  TEST_ASSERT_EQUAL_UINT32(3, g_dev.cfg_writes);
+}
+
+static void test_restore_keeps_newer_reading(void)
+{
+  fill_block(&g_rtc);
+  fresh_driver();
+  g_dev.data.target_state = LD2410_TARGET_MOTION;
+  g_dev.data_valid = true;
+
+  TEST_ASSERT_EQUAL(OK, mmwave_ld2410_restore(&g_rtc.sensor));
+  TEST_ASSERT_EQUAL(LD2410_TARGET_MOTION, g_dev.data.target_state);
+  TEST_ASSERT_TRUE(g_dev.config_valid);
+
+  g_mmwave_dev = NULL;
+  TEST_ASSERT_EQUAL(-ENODEV, mmwave_ld2410_restore(&g_rtc.sensor));
+}
+
+/* ---- Latency and the sleep policy ---- */
+
+static void test_latency_last_worst_mean(void)
+{
+  mmwave_resume_latency(&g_rtc, 700);
+  mmwave_resume_latency(&g_rtc, 1300);
+  mmwave_resume_latency(&g_rtc, 400);
+
+  TEST_ASSERT_EQUAL_UINT32(400, g_rtc.lat_last);
+  TEST_ASSERT_EQUAL_UINT32(1300, g_rtc.lat_max);
+  TEST_ASSERT_EQUAL_UINT32(800, mmwave_resume_latency_avg(&g_rtc));
+
+  /* Kept over the next sleep */
+
+  fill_block(&g_rtc);
+  TEST_ASSERT_EQUAL(OK, mmwave_resume_check(&g_rtc, MMWAVE_WAKE_TIMER));
+  TEST_ASSERT_EQUAL_UINT32(3, g_rtc.lat_n);
+}
+
+static void test_sleep_only_when_quiet_and_reported(void)
+{
+  TEST_ASSERT_TRUE(mmwave_sleep_due(30000, true, 0, LD2410_TARGET_NONE,
+                                    30000));
+  TEST_ASSERT_FALSE(mmwave_sleep_due(30000, true, 0, LD2410_TARGET_NONE,
+                                     29999));
+  TEST_ASSERT_FALSE(mmwave_sleep_due(30000, false, 0, LD2410_TARGET_NONE,
+                                     60000));
+  TEST_ASSERT_FALSE(mmwave_sleep_due(30000, true, 0,
+                                     LD2410_TARGET_STATIC, 60000));
+  TEST_ASSERT_FALSE(mmwave_sleep_due(0, true, 0, LD2410_TARGET_NONE,
+                                     60000));
+}
+
+/* HA unreachable as presence clears: the "off" is still queued */
+
+static void test_sleep_waits_for_unsent(void)
+{
+  TEST_ASSERT_FALSE(mmwave_sleep_due(30000, true, 1, LD2410_TARGET_NONE,
+                                     60000));
+  TEST_ASSERT_FALSE(mmwave_sleep_due(30000, true, 12,
+                                     LD2410_TARGET_NONE, 3600000));
+
+  /* Delivered, or journaled to flash for the next wake to replay */
+
+  TEST_ASSERT_TRUE(mmwave_sleep_due(30000, true, 0, LD2410_TARGET_NONE,
+                                    60000));
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_sealed_block_resumes_on_wake);
+  RUN_TEST(test_cold_boot_ignores_block);
+  RUN_TEST(test_damaged_or_foreign_block_rejected);
+
+  RUN_TEST(test_restore_skips_sensor_probe);
+  RUN_TEST(test_restore_carries_reading_and_stats);
+  RUN_TEST(test_restore_keeps_newer_reading);
+
+  RUN_TEST(test_latency_last_worst_mean);
+  RUN_TEST(test_sleep_only_when_quiet_and_reported);
+  RUN_TEST(test_sleep_waits_for_unsent);
+
+  return UNITY_END();
+}
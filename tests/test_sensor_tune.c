@@ -0,0 +1,312 @@
+/*
+ * tests/test_sensor_tune.c
+ *
+ * Unit tests for applying the sensor's tuning (mmwave_ld2410.c and
+ * apps/common/mmwave_tune.h): decoding the READ_CONFIG answer, the plan
+ * of set commands between two configurations, the command encoding, the
+ * hand-off of an answer to the waiting command, and the mmwave.* keys.
+ *
+ * We #include the driver .c directly to reach the static functions.
+ */
+
+#include "unity/unity.h"
+#include "helpers/frame_builder.h"
+
+#include "drivers/mmwave/mmwave_ld2410.c"
+#include "apps/common/mmwave_tune.h"
+
+/* ---- Test helpers ---- */
+
+static struct mmwave_dev_s g_dev;
+
+/* The sensor's factory tuning */
+
+static const struct mmwave_config_s g_factory =
+{
+  8, 8, 5,
+  { 50, 50, 40, 30, 20, 15, 15, 15, 15 },
+  {  0,  0, 40, 40, 30, 30, 20, 20, 20 }
+};
+
+/* A READ_CONFIG answer for cfg, as the parser leaves it in rxbuf */
+
+static int build_config_ack(uint8_t *ack,
+                            const struct mmwave_config_s *cfg)
+{
+  int pos = 0;
+
+  ack[pos++] = 0x61;
+  ack[pos++] = 0x01;
+  ack[pos++] = 0x00;
+  ack[pos++] = 0x00;
+  ack[pos++] = 0xAA;
+  ack[pos++] = LD2410_MAX_GATES - 1;
+  ack[pos++] = cfg->max_motion_gate;
+  ack[pos++] = cfg->max_static_gate;
+  memcpy(&ack[pos], cfg->motion_sensitivity, LD2410_MAX_GATES);
+  pos += LD2410_MAX_GATES;
+  memcpy(&ack[pos], cfg->static_sensitivity, LD2410_MAX_GATES);
+  pos += LD2410_MAX_GATES;
+  ack[pos++] = (uint8_t)(cfg->timeout_s & 0xFF);
+  ack[pos++] = (uint8_t)(cfg->timeout_s >> 8);
+  return pos;
+}
+
+static int feed(const uint8_t *buf, int len)
+{
+  int frames = 0;
+
+  for (int i = 0; i < len; i++)
+    {
+      frames += mmwave_parse_byte(&g_dev, buf[i]);
+    }
+
+  return frames;
+}
+
+void setUp(void)
+{
+  memset(&g_dev, 0, sizeof(g_dev));
+  g_dev.parse_state = PARSE_HEADER;
+  g_dev.uart_fd = -1;
+  nxsem_init(&g_dev.data_sem, 0, 1);
+  nxsem_init(&g_dev.cmd_sem, 0, 1);
+  nxsem_init(&g_dev.wait_sem, 0, 0);
+}
+
+void tearDown(void) {}
+
+/* ---- The sensor's configuration ---- */
+
+static void test_parse_config_ack(void)
+{
+  struct mmwave_config_s cfg;
+  uint8_t ack[LD2410_ACK_MAX];
+  int len = build_config_ack(ack, &g_factory);
+
+  TEST_ASSERT_EQUAL(28, len);
+  TEST_ASSERT_EQUAL(OK, mmwave_parse_config(ack, len, &cfg));
+  TEST_ASSERT_EQUAL_MEMORY(&g_factory, &cfg, sizeof(cfg));
+}
+
+static void test_parse_config_rejects_short_or_unmarked(void)
+{
+  struct mmwave_config_s cfg;
+  uint8_t ack[LD2410_ACK_MAX];
+  int len = build_config_ack(ack, &g_factory);
+
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_parse_config(ack, len - 1, &cfg));
+
+  ack[5] = LD2410_MAX_GATES;                  /* One gate too many */
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_parse_config(ack, len, &cfg));
+
+  ack[5] = LD2410_MAX_GATES - 1;
+  ack[4] = 0x55;
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_parse_config(ack, len, &cfg));
+}
+
+/* ---- Which commands an apply needs ---- */
+
+static void test_plan_same_config_is_empty(void)
+{
+  struct mmwave_apply_s req;
+  struct mmwave_config_s next;
+
+  req.cfg  = g_factory;
+  req.mask = MMWAVE_APPLY_ALL;
+  TEST_ASSERT_EQUAL(0, mmwave_config_plan(&g_factory, &req, &next));
+  TEST_ASSERT_EQUAL_MEMORY(&g_factory, &next, sizeof(next));
+}
+
+static void test_plan_only_the_gates_that_differ(void)
+{
+  struct mmwave_apply_s req;
+  struct mmwave_config_s next;
+
+  req.cfg  = g_factory;
+  req.mask = MMWAVE_APPLY_MOTION_SENS | MMWAVE_APPLY_STATIC_SENS;
+  req.cfg.motion_sensitivity[3] = 60;
+  req.cfg.static_sensitivity[7] = 10;
+
+  TEST_ASSERT_EQUAL_HEX16((1 << 3) | (1 << 7),
+                          mmwave_config_plan(&g_factory, &req, &next));
+  TEST_ASSERT_EQUAL(60, next.motion_sensitivity[3]);
+}
+
+static void test_plan_maxgate_and_masked_fields(void)
+{
+  struct mmwave_apply_s req;
+  struct mmwave_config_s next;
+
+  /* Fields outside the mask stay as the sensor has them */
+
+  memset(&req, 0, sizeof(req));
+  req.mask = MMWAVE_APPLY_TIMEOUT;
+  req.cfg.timeout_s = 30;
+
+  TEST_ASSERT_EQUAL_HEX16(MMWAVE_PLAN_MAXGATE,
+                          mmwave_config_plan(&g_factory, &req, &next));
+  TEST_ASSERT_EQUAL(30, next.timeout_s);
+  TEST_ASSERT_EQUAL(8, next.max_motion_gate);
+  TEST_ASSERT_EQUAL_MEMORY(g_factory.static_sensitivity,
+                           next.static_sensitivity, LD2410_MAX_GATES);
+  TEST_ASSERT_TRUE(mmwave_config_valid(&next));
+
+  next.max_static_gate = 1;
+  TEST_ASSERT_FALSE(mmwave_config_valid(&next));
+}
+
+static void test_encode_words(void)
+{
+  static const uint8_t want[18] =
+  {
+    0x00, 0x00, 0x03, 0x00, 0x00, 0x00,
+    0x01, 0x00, 0x3c, 0x00, 0x00, 0x00,
+    0x02, 0x00, 0x2c, 0x01, 0x00, 0x00
+  };
+
+  uint8_t data[18];
+
+  mmwave_encode_words(data, 3, 60, 300);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(want, data, sizeof(data));
+}
+
+static void test_apply_without_change_sends_nothing(void)
+{
+  struct mmwave_apply_s req;
+
+  /* Any command would fail: there is no UART */
+
+  g_dev.config = g_factory;
+  g_dev.config_valid = true;
+  req.cfg  = g_factory;
+  req.mask = MMWAVE_APPLY_ALL;
+
+  TEST_ASSERT_EQUAL(0, mmwave_apply(&g_dev, &req));
+  TEST_ASSERT_EQUAL(0, req.sent);
+  TEST_ASSERT_EQUAL(0, g_dev.cfg_writes);
+
+  req.cfg.timeout_s = 6;
+  TEST_ASSERT_EQUAL(-EIO, mmwave_apply(&g_dev, &req));
+}
+
+/* ---- Answers ---- */
+
+static void test_ack_reaches_only_its_command(void)
+{
+  uint8_t frame[FRAME_BUF_SIZE];
+  uint8_t ack[LD2410_ACK_MAX];
+  int len = build_config_ack(ack, &g_factory);
+  int flen = build_cmd_frame(frame, 0x0161, ack + 2, len - 2);
+
+  /* Nobody waiting: dropped */
+
+  TEST_ASSERT_EQUAL(1, feed(frame, flen));
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_process_ack(&g_dev));
+  TEST_ASSERT_EQUAL(0, g_dev.ack_len);
+  TEST_ASSERT_EQUAL(0, g_dev.wait_sem.count);
+
+  g_dev.ack_expect = LD2410_CMD_READ_CONFIG | LD2410_ACK_FLAG;
+  TEST_ASSERT_EQUAL(1, feed(frame, flen));
+  TEST_ASSERT_EQUAL(OK, mmwave_process_ack(&g_dev));
+  TEST_ASSERT_EQUAL(len, g_dev.ack_len);
+  TEST_ASSERT_EQUAL(0, g_dev.ack_expect);
+  TEST_ASSERT_EQUAL(1, g_dev.wait_sem.count);
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(ack, g_dev.ack, len);
+}
+
+/* ---- mmwave.* keys ---- */
+
+static void test_tune_parse_keys(void)
+{
+  struct mmwave_apply_s req;
+
+  memset(&req, 0, sizeof(req));
+  TEST_ASSERT_EQUAL(1, mmwave_tune_parse("mmwave.max_motion", "6", &req));
+  TEST_ASSERT_EQUAL(1, mmwave_tune_parse("mmwave.timeout", "120", &req));
+  TEST_ASSERT_EQUAL(1, mmwave_tune_parse("mmwave.static_sens",
+                                         "0,0,40,40,30,30,20,20,20", &req));
+  TEST_ASSERT_EQUAL(0, mmwave_tune_parse("mmwave.baud", "9600", &req));
+
+  TEST_ASSERT_EQUAL_HEX8(MMWAVE_APPLY_MAX_MOTION | MMWAVE_APPLY_TIMEOUT |
+                         MMWAVE_APPLY_STATIC_SENS, req.mask);
+  TEST_ASSERT_EQUAL(6, req.cfg.max_motion_gate);
+  TEST_ASSERT_EQUAL(120, req.cfg.timeout_s);
+  TEST_ASSERT_EQUAL_MEMORY(g_factory.static_sensitivity,
+                           req.cfg.static_sensitivity, LD2410_MAX_GATES);
+}
+
+static void test_tune_parse_rejects_bad_values(void)
+{
+  static const char *const bad[][2] =
+  {
+    { "mmwave.max_motion", "1" },
+    { "mmwave.max_static", "9" },
+    { "mmwave.timeout", "-5" },
+    { "mmwave.timeout", "70000" },
+    { "mmwave.motion_sens", "50,50,40" },
+    { "mmwave.motion_sens", "50,50,40,30,20,15,15,15,15,15" },
+    { "mmwave.motion_sens", "50,50,,30,20,15,15,15,15" },
+    { "mmwave.motion_sens", "50,50,40,30,20,15,15,15,101" },
+  };
+
+  struct mmwave_apply_s req;
+
+  memset(&req, 0, sizeof(req));
+  for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++)
+    {
+      TEST_ASSERT_EQUAL_MESSAGE(-EINVAL,
+                                mmwave_tune_parse(bad[i][0], bad[i][1],
+                                                  &req), bad[i][1]);
+    }
+
+  TEST_ASSERT_EQUAL(0, req.mask);
+}
+
+static void test_tune_format_round_trip(void)
+{
+  struct mmwave_tune_kv_s t;
+  struct mmwave_apply_s req;
+  int n = mmwave_tune_format(&g_factory, MMWAVE_APPLY_ALL, &t);
+
+  TEST_ASSERT_EQUAL(MMWAVE_TUNE_KEYS, n);
+  TEST_ASSERT_EQUAL_STRING("mmwave.motion_sens", t.kv[6]);
+  TEST_ASSERT_EQUAL_STRING("50,50,40,30,20,15,15,15,15", t.kv[7]);
+
+  memset(&req, 0, sizeof(req));
+  for (int i = 0; i < n; i++)
+    {
+      TEST_ASSERT_EQUAL(1, mmwave_tune_parse(t.kv[2 * i], t.kv[2 * i + 1],
+                                             &req));
+    }
+
+  TEST_ASSERT_EQUAL_HEX8(MMWAVE_APPLY_ALL, req.mask);
+  TEST_ASSERT_EQUAL_MEMORY(&g_factory, &req.cfg, sizeof(req.cfg));
+
+  TEST_ASSERT_EQUAL(1, mmwave_tune_format(&g_factory, MMWAVE_APPLY_TIMEOUT,
+                                          &t));
+  TEST_ASSERT_EQUAL_STRING("mmwave.timeout", t.kv[0]);
+  TEST_ASSERT_EQUAL_STRING("5", t.kv[1]);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_parse_config_ack);
+  RUN_TEST(test_parse_config_rejects_short_or_unmarked);
+
+  RUN_TEST(test_plan_same_config_is_empty);
+  RUN_TEST(test_plan_only_the_gates_that_differ);
+  RUN_TEST(test_plan_maxgate_and_masked_fields);
+  RUN_TEST(test_encode_words);
+  RUN_TEST(test_apply_without_change_sends_nothing);
+
+  RUN_TEST(test_ack_reaches_only_its_command);
+
+  RUN_TEST(test_tune_parse_keys);
+  RUN_TEST(test_tune_parse_rejects_bad_values);
+  RUN_TEST(test_tune_format_round_trip);
+
+  return UNITY_END();
+}
@@ -0,0 +1,423 @@
+/*
+ * tests/test_stream.c
+ *
+ * Unit tests for the raw TCP engineering stream (apps/stream/stream.h):
+ * record layout and decoding, per-client rings with wraparound, drop
+ * accounting and GAP records under backpressure, and isolation between
+ * a slow and a fast client. Sockets are replaced by per-slot capture
+ * buffers with an adjustable send budget.
+ */
+
+#include "unity/unity.h"
+
+#include <string.h>
+
+#include "apps/stream/stream.h"
+
+/* ---- Test helpers ---- */
+
+#define OUT_MAX 16384
+
+static struct stream_s srv;
+static uint8_t out[CONFIG_STREAM_MAX_CLIENTS][OUT_MAX];
+static size_t out_len[CONFIG_STREAM_MAX_CLIENTS];
+static int budget[CONFIG_STREAM_MAX_CLIENTS];   /* Bytes left; -1 any */
+static int fail[CONFIG_STREAM_MAX_CLIENTS];
+
+static ssize_t capture(void *arg, int slot, const void *buf, size_t len)
+{
+  if (fail[slot] < 0)
+    {
+      return fail[slot];
+    }
+
+  if (budget[slot] >= 0)
+    {
+      len = len > (size_t)budget[slot] ? (size_t)budget[slot] : len;
+      budget[slot] -= (int)len;
+    }
+
+  TEST_ASSERT_TRUE(out_len[slot] + len <= OUT_MAX);
+  memcpy(out[slot] + out_len[slot], buf, len);
+  out_len[slot] += len;
+  return (ssize_t)len;
+}
+
+static struct mmwave_eng_data_s sample(uint32_t ts)
+{
+  struct mmwave_eng_data_s e;
+
+  memset(&e, 0, sizeof(e));
+  e.basic.target_state       = LD2410_TARGET_BOTH;
+  e.basic.motion_energy      = 61;
+  e.basic.static_energy      = 33;
+  e.basic.motion_distance    = 0x0123;
+  e.basic.static_distance    = 0x0456;
+  e.basic.detection_distance = 0x0789;
+  e.basic.timestamp_ms       = ts;
+  for (int i = 0; i < LD2410_MAX_GATES; i++)
+    {
+      e.motion_gate_energy[i] = (uint8_t)(10 + i);
+      e.static_gate_energy[i] = (uint8_t)(90 - i);
+    }
+
+  return e;
+}
+
+static void publish(int n, bool gates)
+{
+  for (int i = 0; i < n; i++)
+    {
+      struct mmwave_eng_data_s e = sample((uint32_t)(1000 + 50 * i));
+
+      stream_publish(&srv, &e, gates);
+    }
+}
+
+/* Walk a captured byte stream record by record */
+
+struct walk_s
+{
+  int hellos;
+  int frames;
+  int gaps;
+  uint32_t dropped;       /* Sum of GAP counts */
+  uint32_t seq_missing;   /* Holes in the FRAME sequence */
+  uint32_t last_seq;
+  size_t leftover;        /* Bytes of a trailing partial record */
+};
+
+static struct walk_s walk(const uint8_t *p, size_t len)
+{
+  struct walk_s w;
+  size_t off = 0;
+
+  memset(&w, 0, sizeof(w));
+  while (off + STREAM_LEN_BYTES <= len)
+    {
+      size_t n = stream_get16(p + off);
+      struct stream_rec_s r;
+
+      if (off + STREAM_LEN_BYTES + n > len)
+        {
+          break;
+        }
+
+      TEST_ASSERT_EQUAL_INT(OK, stream_decode(p + off + STREAM_LEN_BYTES,
+                                              n, &r));
+      switch (r.type)
+        {
+          case STREAM_REC_HELLO:
+            w.hellos++;
+            break;
+
+          case STREAM_REC_GAP:
+            w.gaps++;
+            w.dropped += r.dropped;
+            break;
+
+          case STREAM_REC_FRAME:
+            if (w.frames > 0)
+              {
+                w.seq_missing += r.seq - w.last_seq - 1;
+              }
+
+            w.frames++;
+            w.last_seq = r.seq;
+            break;
+        }
+
+      off += STREAM_LEN_BYTES + n;
+    }
+
+  w.leftover = len - off;
+  return w;
+}
+
+void setUp(void)
+{
+  stream_init(&srv, capture, NULL, 0xa1b2c3d4);
+  memset(out_len, 0, sizeof(out_len));
+  memset(fail, 0, sizeof(fail));
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      budget[i] = -1;
+    }
+}
+
+void tearDown(void) {}
+
+/* ================================================================
+ * Records
+ * ================================================================ */
+
+void test_hello_layout(void)
+{
+  uint8_t buf[16];
+  const uint8_t want[] = { 0x00, 0x08, STREAM_REC_HELLO, STREAM_VERSION,
+                           LD2410_MAX_GATES, 0x00,
+                           0xa1, 0xb2, 0xc3, 0xd4 };
+
+  TEST_ASSERT_EQUAL_size_t(sizeof(want), stream_enc_hello(buf, 0xa1b2c3d4));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(want, buf, sizeof(want));
+}
+
+void test_frame_layout_basic(void)
+{
+  struct mmwave_eng_data_s e = sample(0x01020304);
+  uint8_t buf[STREAM_REC_MAX];
+  const uint8_t want[] = { 0x00, 19, STREAM_REC_FRAME, 0x00,
+                           0x00, 0x00, 0x00, 0x07,
+                           0x01, 0x02, 0x03, 0x04,
+                           LD2410_TARGET_BOTH, 61, 33,
+                           0x01, 0x23, 0x04, 0x56, 0x07, 0x89 };
+
+  TEST_ASSERT_EQUAL_size_t(sizeof(want), stream_enc_frame(buf, 7, &e,
+                                                          false));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(want, buf, sizeof(want));
+}
+
+void test_frame_with_gates_round_trip(void)
+{
+  struct mmwave_eng_data_s e = sample(123456);
+  uint8_t buf[STREAM_REC_MAX];
+  struct stream_rec_s r;
+  size_t len = stream_enc_frame(buf, 99, &e, true);
+
+  TEST_ASSERT_EQUAL_size_t(STREAM_REC_MAX, len);
+  TEST_ASSERT_EQUAL_INT(OK, stream_decode(buf + 2, len - 2, &r));
+  TEST_ASSERT_EQUAL_UINT8(STREAM_REC_FRAME, r.type);
+  TEST_ASSERT_TRUE(r.gates);
+  TEST_ASSERT_EQUAL_UINT32(99, r.seq);
+  TEST_ASSERT_EQUAL_MEMORY(&e.basic, &r.eng.basic, sizeof(e.basic));
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(e.motion_gate_energy,
+                                r.eng.motion_gate_energy, LD2410_MAX_GATES);
+  TEST_ASSERT_EQUAL_UINT8_ARRAY(e.static_gate_energy,
+                                r.eng.static_gate_energy, LD2410_MAX_GATES);
+}
+
+void test_gap_layout(void)
+{
+  uint8_t buf[8];
+  struct stream_rec_s r;
+
+  TEST_ASSERT_EQUAL_size_t(7, stream_enc_gap(buf, 300));
+  TEST_ASSERT_EQUAL_INT(OK, stream_decode(buf + 2, 5, &r));
+  TEST_ASSERT_EQUAL_UINT32(300, r.dropped);
+}
+
+void test_decode_rejects_short_and_unknown(void)
+{
+  struct mmwave_eng_data_s e = sample(1);
+  uint8_t buf[STREAM_REC_MAX];
+  struct stream_rec_s r;
+  const uint8_t future[] = { 0x7f, 1, 2, 3 };
+
+  stream_enc_frame(buf, 1, &e, true);
+  TEST_ASSERT_EQUAL_INT(-EBADMSG, stream_decode(buf + 2, 30, &r));
+  TEST_ASSERT_EQUAL_INT(-EBADMSG, stream_decode(buf + 2, 0, &r));
+  TEST_ASSERT_EQUAL_INT(-ENOMSG, stream_decode(future, sizeof(future), &r));
+}
+
+/* ================================================================
+ * Clients
+ * ================================================================ */
+
+void test_open_queues_hello(void)
+{
+  int s = stream_open(&srv);
+  struct walk_s w;
+
+  TEST_ASSERT_EQUAL_INT(0, s);
+  TEST_ASSERT_TRUE(stream_wants_write(&srv, s));
+  TEST_ASSERT_EQUAL_INT(OK, stream_flush(&srv, s));
+  TEST_ASSERT_FALSE(stream_wants_write(&srv, s));
+
+  w = walk(out[s], out_len[s]);
+  TEST_ASSERT_EQUAL_INT(1, w.hellos);
+  TEST_ASSERT_EQUAL_INT(0, w.frames);
+}
+
+void test_slots_are_bounded(void)
+{
+  for (int i = 0; i < CONFIG_STREAM_MAX_CLIENTS; i++)
+    {
+      TEST_ASSERT_EQUAL_INT(i, stream_open(&srv));
+    }
+
+  TEST_ASSERT_EQUAL_INT(-EBUSY, stream_open(&srv));
+  TEST_ASSERT_EQUAL_UINT32(1, srv.refused);
+  TEST_ASSERT_EQUAL_INT(CONFIG_STREAM_MAX_CLIENTS, stream_clients(&srv));
+
+  stream_close(&srv, 0);
+  TEST_ASSERT_EQUAL_INT(0, stream_open(&srv));
+}
+
+void test_every_frame_delivered_when_keeping_up(void)
+{
+  int s = stream_open(&srv);
+  struct walk_s w;
+
+  for (int i = 0; i < 200; i++)
+    {
+      publish(1, i & 1);
+      TEST_ASSERT_EQUAL_INT(OK, stream_flush(&srv, s));
+    }
+
+  w = walk(out[s], out_len[s]);
+  TEST_ASSERT_EQUAL_INT(200, w.frames);
+  TEST_ASSERT_EQUAL_UINT32(0, w.seq_missing);
+  TEST_ASSERT_EQUAL_INT(0, w.gaps);
+  TEST_ASSERT_EQUAL_size_t(0, w.leftover);
+  TEST_ASSERT_EQUAL_UINT32(out_len[s], srv.clients[s].bytes);
+}
+
+void test_partial_sends_wrap_the_ring(void)
+{
+  int s = stream_open(&srv);
+  struct walk_s w;
+
+  /* Sends that never line up with records walk the head round the ring */
+
+  for (int i = 0; i < 300; i++)
+    {
+      publish(1, true);
+      budget[s] = STREAM_REC_MAX + 4;
+      TEST_ASSERT_EQUAL_INT(OK, stream_flush(&srv, s));
+    }
+
+  budget[s] = -1;
+  stream_flush(&srv, s);
+
+  w = walk(out[s], out_len[s]);
+  TEST_ASSERT_EQUAL_INT(300, w.frames);
+  TEST_ASSERT_EQUAL_UINT32(0, w.seq_missing + w.dropped);
+  TEST_ASSERT_EQUAL_size_t(0, w.leftover);
+}
+
+void test_full_ring_drops_and_reports_gap(void)
+{
+  int s = stream_open(&srv);
+  int fit = (CONFIG_STREAM_CLIENT_BUF - (STREAM_LEN_BYTES +
+                                         STREAM_HELLO_LEN)) /
+            STREAM_REC_MAX;
+  struct walk_s w;
+
+  budget[s] = 0;
+  publish(fit + 10, true);
+  stream_flush(&srv, s);
+
+  TEST_ASSERT_EQUAL_UINT32(10, srv.clients[s].dropped);
+  TEST_ASSERT_EQUAL_UINT32(fit, srv.clients[s].frames);
+
+  /* Reader drains, then the next frame is preceded by the GAP */
+
+  budget[s] = -1;
+  stream_flush(&srv, s);
+  publish(1, true);
+  stream_flush(&srv, s);
+
+  w = walk(out[s], out_len[s]);
+  TEST_ASSERT_EQUAL_INT(fit + 1, w.frames);
+  TEST_ASSERT_EQUAL_INT(1, w.gaps);
+  TEST_ASSERT_EQUAL_UINT32(10, w.dropped);
+  TEST_ASSERT_EQUAL_UINT32(w.dropped, w.seq_missing);
+}
+
+void test_ring_holds_only_whole_records(void)
+{
+  int s = stream_open(&srv);
+  struct walk_s w;
+
+  budget[s] = 0;
+  publish(100, true);
+
+  /* Whatever was kept is a whole number of records */
+
+  budget[s] = -1;
+  stream_flush(&srv, s);
+  w = walk(out[s], out_len[s]);
+  TEST_ASSERT_EQUAL_size_t(0, w.leftover);
+  TEST_ASSERT_TRUE(out_len[s] <= CONFIG_STREAM_CLIENT_BUF);
+}
+
+void test_slow_client_does_not_affect_fast(void)
+{
+  int fast = stream_open(&srv);
+  int slow = stream_open(&srv);
+  struct walk_s wf;
+  struct walk_s ws;
+
+  budget[slow] = 0;
+  for (int i = 0; i < 100; i++)
+    {
+      TEST_ASSERT_TRUE(stream_publish(&srv, &(struct mmwave_eng_data_s){0},
+                                      true) <= 1);
+      stream_flush(&srv, fast);
+      stream_flush(&srv, slow);
+    }
+
+  wf = walk(out[fast], out_len[fast]);
+  TEST_ASSERT_EQUAL_INT(100, wf.frames);
+  TEST_ASSERT_EQUAL_UINT32(0, srv.clients[fast].dropped);
+  TEST_ASSERT_TRUE(srv.clients[slow].dropped > 0);
+
+  budget[slow] = -1;
+  stream_flush(&srv, slow);
+  publish(1, true);
+  stream_flush(&srv, slow);
+  ws = walk(out[slow], out_len[slow]);
+  TEST_ASSERT_EQUAL_UINT32(srv.clients[slow].dropped, ws.dropped);
+  TEST_ASSERT_EQUAL_UINT32(101, ws.frames + ws.dropped);
+}
+
+void test_send_error_reported(void)
+{
+  int s = stream_open(&srv);
+
+  fail[s] = -EPIPE;
+  TEST_ASSERT_EQUAL_INT(-EPIPE, stream_flush(&srv, s));
+}
+
+void test_reopened_slot_starts_clean(void)
+{
+  int s = stream_open(&srv);
+
+  budget[s] = 0;
+  publish(100, true);
+  stream_close(&srv, s);
+
+  TEST_ASSERT_EQUAL_INT(s, stream_open(&srv));
+  TEST_ASSERT_EQUAL_UINT32(0, srv.clients[s].dropped);
+  TEST_ASSERT_EQUAL_UINT16(STREAM_LEN_BYTES + STREAM_HELLO_LEN,
+                           srv.clients[s].len);
+}
+
+/* ================================================================
+ * Main
+ * ================================================================ */
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  /* Records */
+  RUN_TEST(test_hello_layout);
+  RUN_TEST(test_frame_layout_basic);
+  RUN_TEST(test_frame_with_gates_round_trip);
+  RUN_TEST(test_gap_layout);
+  RUN_TEST(test_decode_rejects_short_and_unknown);
+
+  /* Clients */
+  RUN_TEST(test_open_queues_hello);
+  RUN_TEST(test_slots_are_bounded);
+  RUN_TEST(test_every_frame_delivered_when_keeping_up);
+  RUN_TEST(test_partial_sends_wrap_the_ring);
+  RUN_TEST(test_full_ring_drops_and_reports_gap);
+  RUN_TEST(test_ring_holds_only_whole_records);
+  RUN_TEST(test_slow_client_does_not_affect_fast);
+  RUN_TEST(test_send_error_reported);
+  RUN_TEST(test_reopened_slot_starts_clean);
+
+  return UNITY_END();
+}
@@ -0,0 +1,336 @@
+/*
+ * tests/test_wifi_fast.c
+ *
+ * Unit tests for fast Wi-Fi reconnect (apps/common/mmwave_wifi.h and
+ * apps/common/wpa_pmk.h): the PMK against the published vectors, the
+ * wifi.cache, wifi.lease and wifi.static values and their tag, and the
+ * order the boot tries things in, against stubbed driver and DHCP calls.
+ */
+
+#include "unity/unity.h"
+
+#include "apps/common/mmwave_wifi.h"
+
+/* ---- Test helpers ---- */
+
+/* What the stubs were asked to do, in order */
+
+static char g_calls[128];
+static int g_join_direct_ret;
+static int g_join_scan_ret;
+static int g_joined_ret;
+static int g_set_addr_ret;
+static int g_dhcp_ret;
+static struct mmwave_wifi_addr_s g_addr_set;
+
+static void call(const char *what)
+{
+  size_t len = strlen(g_calls);
+
+  snprintf(g_calls + len, sizeof(g_calls) - len, "%s%s",
+           len > 0 ? " " : "", what);
+}
+
+static int stub_join(void *arg, const struct mmwave_wifi_ap_s *ap)
+{
+  call(ap != NULL ? "direct" : "scan");
+  return ap != NULL ? g_join_direct_ret : g_join_scan_ret;
+}
+
+static int stub_joined(void *arg, struct mmwave_wifi_ap_s *ap)
+{
+  static const uint8_t bssid[6] = { 0xa4, 0x2b, 0xb0, 0x11, 0x22, 0x33 };
+
+  call("joined");
+  memcpy(ap->bssid, bssid, sizeof(bssid));
+  ap->channel = 11;
+  return g_joined_ret;
+}
+
+static int stub_set_addr(void *arg, const struct mmwave_wifi_addr_s *addr)
+{
+  call("addr");
+  g_addr_set = *addr;
+  return g_set_addr_ret;
+}
+
+static int stub_dhcp(void *arg, bool wait)
+{
+  call(wait ? "dhcp-wait" : "dhcp");
+  return g_dhcp_ret;
+}
+
+static const struct mmwave_wifi_ops_s g_ops =
+{
+  stub_join, stub_joined, stub_set_addr, stub_dhcp, NULL
+};
+
+static const struct mmwave_wifi_ap_s g_ap =
+{
+  { 0xa4, 0x2b, 0xb0, 0x11, 0x22, 0x33 }, 6,
+  "f42c6fc52df0ebef9ebb4b90b38a5f902e83fe1b135a70e23aed762e9710a12e"
+};
+
+static struct mmwave_wifi_addr_s lease(void)
+{
+  struct mmwave_wifi_addr_s a;
+
+  a.ip      = inet_addr("192.168.1.50");
+  a.netmask = inet_addr("255.255.255.0");
+  a.router  = inet_addr("192.168.1.1");
+  a.dns     = inet_addr("192.168.1.1");
+  return a;
+}
+
+void setUp(void)
+{
+  g_calls[0]        = '\0';
+  g_join_direct_ret = OK;
+  g_join_scan_ret   = OK;
+  g_joined_ret      = OK;
+  g_set_addr_ret    = OK;
+  g_dhcp_ret        = OK;
+  memset(&g_addr_set, 0, sizeof(g_addr_set));
+}
+
+void tearDown(void)
+{
+}
+
+/* ---- PMK ---- */
+
+static void test_pbkdf2_sha1_rfc6070(void)
+{
+  static const uint8_t expect[20] =
+  {
+    0xea, 0x6c, 0x01, 0x4d, 0xc7, 0x2d, 0x6f, 0x8c, 0xcd, 0x1e,
+    0xd9, 0x2a, 0xce, 0x1d, 0x41, 0xf0, 0xd8, 0xde, 0x89, 0x57
+  };
+
+  uint8_t out[20];
+
+  wpa_pbkdf2_sha1("password", (const uint8_t *)"salt", 4, 2, out,
+                  sizeof(out));
+  TEST_ASSERT_EQUAL_HEX8_ARRAY(expect, out, sizeof(out));
+}
+
+static void test_pmk_ieee_vector(void)
+{
+  char hex[WPA_PMK_HEX + 1];
+
+  /* IEEE 802.11i-2004, H.4.1: passphrase "password", SSID "IEEE" */
+
+  wpa_pmk_hex("IEEE", "password", hex);
+  TEST_ASSERT_EQUAL_STRING(g_ap.pmk, hex);
+}
+
+/* ---- The cached values ---- */
+
+static void test_cache_round_trip_and_tag(void)
+{
+  struct mmwave_wifi_ap_s ap;
+  char val[MMWAVE_WIFI_CACHE_MAX];
+  uint32_t tag = mmwave_wifi_tag("MyNetwork", "secret");
+
+  TEST_ASSERT_LESS_THAN(sizeof(val),
+                        mmwave_wifi_format_ap(&g_ap, tag, val,
+                                              sizeof(val)));
+  TEST_ASSERT_EQUAL_STRING_LEN("a4:2b:b0:11:22:33,6,f42c", val, 24);
+
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_parse_ap(val, tag, &ap));
+  TEST_ASSERT_EQUAL_MEMORY(&g_ap, &ap, sizeof(ap));
+
+  /* Another password: the cache is not for this network */
+
+  TEST_ASSERT_EQUAL(-ESTALE, mmwave_wifi_parse_ap(val,
+                    mmwave_wifi_tag("MyNetwork", "secret2"), &ap));
+  TEST_ASSERT_NOT_EQUAL(mmwave_wifi_tag("ab", "c"),
+                        mmwave_wifi_tag("a", "bc"));
+}
+
+static void test_cache_open_network_and_malformed(void)
+{
+  static const char *const bad[] =
+  {
+    "", "00:11:22:33:44,1,,0000002a", "00:11:22:33:44:5g,1,,0000002a",
+    "00:11:22:33:44:55,0,,0000002a", "00:11:22:33:44:55,15,,0000002a",
+    "00:11:22:33:44:55,6x,,0000002a", "00:11:22:33:44:55,6,abc,0000002a",
+    "00:11:22:33:44:55,6,,2a", "00:11:22:33:44:55,6,"
+  };
+
+  struct mmwave_wifi_ap_s ap;
+
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_parse_ap("00:11:22:33:44:55,1,,"
+                                             "0000002a", 0x2a, &ap));
+  TEST_ASSERT_EQUAL_STRING("", ap.pmk);
+  TEST_ASSERT_EQUAL(1, ap.channel);
+
+  for (int i = 0; i < (int)(sizeof(bad) / sizeof(bad[0])); i++)
+    {
+      TEST_ASSERT_EQUAL_MESSAGE(-EINVAL,
+                                mmwave_wifi_parse_ap(bad[i], 0x2a, &ap),
+                                bad[i]);
+    }
+}
+
+static void test_lease_and_static_values(void)
+{
+  struct mmwave_wifi_addr_s a = lease();
+  struct mmwave_wifi_addr_s b;
+  char val[MMWAVE_WIFI_ADDR_MAX];
+
+  mmwave_wifi_format_addr(&a, 0x1c0ffee5, val, sizeof(val));
+  TEST_ASSERT_EQUAL_STRING("192.168.1.50,255.255.255.0,192.168.1.1,"
+                           "192.168.1.1,1c0ffee5", val);
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_parse_addr(val, 0x1c0ffee5, &b));
+  TEST_ASSERT_EQUAL_MEMORY(&a, &b, sizeof(a));
+  TEST_ASSERT_EQUAL(-ESTALE, mmwave_wifi_parse_addr(val, 1, &b));
+
+  /* wifi.static has no tag; only the address itself is required */
+
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_parse_addr("10.0.0.9,255.0.0.0,"
+                                               "0.0.0.0,0.0.0.0", 0, &b));
+  TEST_ASSERT_EQUAL_HEX32(inet_addr("10.0.0.9"), b.ip);
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_wifi_parse_addr(val, 0, &b));
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_wifi_parse_addr("0.0.0.0,0.0.0.0,"
+                                                    "0.0.0.0,0.0.0.0", 0,
+                                                    &b));
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_wifi_parse_addr("10.0.0.9,255.0.0.0",
+                                                    0, &b));
+  TEST_ASSERT_EQUAL(-EINVAL, mmwave_wifi_parse_addr("10.0.0.256,0.0.0.0,"
+                                                    "0.0.0.0,0.0.0.0", 0,
+                                                    &b));
+}
+
+static void test_channel_frequency(void)
+{
+  TEST_ASSERT_EQUAL(1, mmwave_wifi_channel(2412));
+  TEST_ASSERT_EQUAL(6, mmwave_wifi_channel(2437));
+  TEST_ASSERT_EQUAL(13, mmwave_wifi_channel(2472));
+  TEST_ASSERT_EQUAL(14, mmwave_wifi_channel(2484));
+  TEST_ASSERT_EQUAL(0, mmwave_wifi_channel(2413));
+  TEST_ASSERT_EQUAL(0, mmwave_wifi_channel(5180));
+
+  for (int ch = 1; ch <= 14; ch++)
+    {
+      TEST_ASSERT_EQUAL(ch, mmwave_wifi_channel(mmwave_wifi_mhz(ch)));
+    }
+}
+
+/* ---- Joining ---- */
+
+static void test_cached_ap_joined_directly(void)
+{
+  struct mmwave_wifi_ap_s ap = g_ap;
+  int how = -1;
+
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_connect(&g_ops, &ap, true, &how));
+  TEST_ASSERT_EQUAL(MMWAVE_WIFI_DIRECTED, how);
+  TEST_ASSERT_EQUAL_STRING("direct", g_calls);
+  TEST_ASSERT_EQUAL_MEMORY(&g_ap, &ap, sizeof(ap));
+}
+
+static void test_failed_direct_join_falls_back_to_scan(void)
+{
+  struct mmwave_wifi_ap_s ap = g_ap;
+  int how = -1;
+
+  g_join_direct_ret = -ETIMEDOUT;
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_connect(&g_ops, &ap, true, &how));
+  TEST_ASSERT_EQUAL(MMWAVE_WIFI_SCANNED, how);
+  TEST_ASSERT_EQUAL_STRING("direct scan joined", g_calls);
+
+  /* What to cache now: the AP answering, PMK still to derive */
+
+  TEST_ASSERT_EQUAL(11, ap.channel);
+  TEST_ASSERT_EQUAL_STRING("", ap.pmk);
+}
+
+static void test_no_cache_scans(void)
+{
+  struct mmwave_wifi_ap_s ap;
+  int how = -1;
+
+  memset(&ap, 0, sizeof(ap));
+  g_joined_ret = -ENOTTY;
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_connect(&g_ops, &ap, false, &how));
+  TEST_ASSERT_EQUAL_STRING("scan joined", g_calls);
+  TEST_ASSERT_EQUAL(0, ap.channel);              /* Nothing to cache */
+
+  g_calls[0] = '\0';
+  g_join_direct_ret = -ETIMEDOUT;
+  g_join_scan_ret = -EHOSTUNREACH;
+  TEST_ASSERT_EQUAL(-EHOSTUNREACH, mmwave_wifi_connect(&g_ops, &ap, true,
+                                                       &how));
+  TEST_ASSERT_EQUAL_STRING("direct scan", g_calls);
+}
+
+/* ---- Addressing ---- */
+
+static void test_static_address_skips_dhcp(void)
+{
+  struct mmwave_wifi_addr_s fixed = lease();
+  struct mmwave_wifi_addr_s cached = lease();
+  int how = -1;
+
+  cached.ip = inet_addr("192.168.1.77");
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_address(&g_ops, &fixed, &cached,
+                                            &how));
+  TEST_ASSERT_EQUAL(MMWAVE_WIFI_STATIC, how);
+  TEST_ASSERT_EQUAL_STRING("addr", g_calls);
+  TEST_ASSERT_EQUAL_HEX32(fixed.ip, g_addr_set.ip);
+}
+
+static void test_cached_lease_used_with_dhcp_behind_it(void)
+{
+  struct mmwave_wifi_addr_s cached = lease();
+  int how = -1;
+
+  g_dhcp_ret = -ENOMEM;                          /* Still has an address */
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_address(&g_ops, NULL, &cached, &how));
+  TEST_ASSERT_EQUAL(MMWAVE_WIFI_REUSED, how);
+  TEST_ASSERT_EQUAL_STRING("addr dhcp", g_calls);
+  TEST_ASSERT_EQUAL_HEX32(cached.ip, g_addr_set.ip);
+}
+
+static void test_no_lease_waits_for_dhcp(void)
+{
+  struct mmwave_wifi_addr_s cached = lease();
+  int how = -1;
+
+  TEST_ASSERT_EQUAL(OK, mmwave_wifi_address(&g_ops, NULL, NULL, &how));
+  TEST_ASSERT_EQUAL(MMWAVE_WIFI_LEASED, how);
+  TEST_ASSERT_EQUAL_STRING("dhcp-wait", g_calls);
+
+  /* A lease the interface refused: DHCP from scratch */
+
+  g_calls[0] = '\0';
+  g_set_addr_ret = -EINVAL;
+  g_dhcp_ret = -ETIMEDOUT;
+  TEST_ASSERT_EQUAL(-ETIMEDOUT, mmwave_wifi_address(&g_ops, NULL, &cached,
+                                                    &how));
+  TEST_ASSERT_EQUAL_STRING("addr dhcp-wait", g_calls);
+}
+
+int main(void)
+{
+  UNITY_BEGIN();
+
+  RUN_TEST(test_pbkdf2_sha1_rfc6070);
+  RUN_TEST(test_pmk_ieee_vector);
+
+  RUN_TEST(test_cache_round_trip_and_tag);
+  RUN_TEST(test_cache_open_network_and_malformed);
+  RUN_TEST(test_lease_and_static_values);
+  RUN_TEST(test_channel_frequency);
+
+  RUN_TEST(test_cached_ap_joined_directly);
+  RUN_TEST(test_failed_direct_join_falls_back_to_scan);
+  RUN_TEST(test_no_cache_scans);
+
+  RUN_TEST(test_static_address_skips_dhcp);
+  RUN_TEST(test_cached_lease_used_with_dhcp_behind_it);
+  RUN_TEST(test_no_lease_waits_for_dhcp);
+
+  return UNITY_END();
+}
@@ -0,0 +1,232 @@
+#!/usr/bin/env python3
+#
+# tests/tools/ha_mock.py
+#
+# Minimal stand-in for Home Assistant and an MQTT broker, so ha_wire (and
+# a device under test) can be exercised without either installed.
+#
+#   python3 tools/ha_mock.py [--tls cert.pem key.pem] [http_port] [mqtt_port]
+#
+# Ports default to 8123 and 1883, or 8123 and 8883 with --tls, which puts
+# both behind TLS and logs whether each handshake was full or resumed.
+#
+# The HTTP port answers POST /api/states/<id> with a response shaped like
+# a real HA 200 (same headers and body size class) and upgrades
+# GET /api/websocket to the WebSocket API: auth_required / auth / auth_ok,
+# then a result for every command and a pong for every ping. Any token
+# except "bad" is accepted. The MQTT port speaks enough 3.1.1 for hactl:
+# CONNACK, PUBACK, PINGRESP, DISCONNECT.
+#
+# Standard library only. Not part of `make test`.
+
+import base64
+import hashlib
+import json
+import socket
+import ssl
+import struct
+import sys
+import threading
+
+WS_GUID = b"258EAFA5-E914-47DA-95CA-C5AB0DC85B11"
+
+STATE_BODY = json.dumps({
+    "entity_id": "binary_sensor.mmwave_presence",
+    "state": "on",
+    "attributes": {
+        "friendly_name": "mmWave Presence",
+        "device_class": "occupancy",
+        "motion_energy": 1, "static_energy": 1, "motion_distance": 1,
+        "static_distance": 1, "detection_distance": 1,
+    },
+    "last_changed": "2026-01-01T00:00:00.000000+00:00",
+    "last_reported": "2026-01-01T00:00:00.000000+00:00",
+    "last_updated": "2026-01-01T00:00:00.000000+00:00",
+    "context": {"id": "01JABCDEFGHJKMNPQRSTVWXYZ0", "parent_id": None,
+                "user_id": "0123456789abcdef0123456789abcdef"},
+}, separators=(",", ":")).encode()
+
+
+def recvn(c, n):
+    b = b""
+    while len(b) < n:
+        x = c.recv(n - len(b))
+        if not x:
+            raise EOFError
+        b += x
+    return b
+
+
+# ---- MQTT ----
+
+def mqtt_client(c):
+    try:
+        while True:
+            h = recvn(c, 1)[0]
+            mult, length = 1, 0
+            while True:
+                b = recvn(c, 1)[0]
+                length += (b & 127) * mult
+                mult *= 128
+                if not b & 128:
+                    break
+            body = recvn(c, length)
+            kind = h & 0xf0
+            if kind == 0x10:
+                c.sendall(b"\x20\x02\x00\x00")
+            elif kind == 0x30 and h & 0x06:
+                tl = body[0] << 8 | body[1]
+                c.sendall(b"\x40\x02" + body[2 + tl:4 + tl])
+            elif kind == 0xc0:
+                c.sendall(b"\xd0\x00")
+            elif kind == 0xe0:
+                break
+    except (EOFError, OSError):
+        pass
+    c.close()
+
+
+# ---- WebSocket ----
+
+def ws_send(c, text):
+    data = text.encode()
+    n = len(data)
+    if n < 126:
+        hdr = struct.pack("!BB", 0x81, n)
+    else:
+        hdr = struct.pack("!BBH", 0x81, 126, n)
+    c.sendall(hdr + data)
+
+
+def ws_recv(c):
+    b0, b1 = recvn(c, 2)
+    n = b1 & 0x7f
+    if n == 126:
+        n = struct.unpack("!H", recvn(c, 2))[0]
+    elif n == 127:
+        n = struct.unpack("!Q", recvn(c, 8))[0]
+    mask = recvn(c, 4) if b1 & 0x80 else b"\0\0\0\0"
+    data = bytes(x ^ mask[i & 3] for i, x in enumerate(recvn(c, n)))
+    return b0 & 0x0f, data
+
+
+def ws_client(c, headers):
+    key = headers.get(b"sec-websocket-key", b"")
+    accept = base64.b64encode(hashlib.sha1(key + WS_GUID).digest())
+    c.sendall(b"HTTP/1.1 101 Switching Protocols\r\n"
+              b"Upgrade: websocket\r\nConnection: Upgrade\r\n"
+              b"Sec-WebSocket-Accept: " + accept + b"\r\n\r\n")
+    ws_send(c, '{"type":"auth_required","ha_version":"2026.1.0"}')
+
+    authed = False
+    while True:
+        op, data = ws_recv(c)
+        if op == 0x8:
+            c.sendall(b"\x88\x02" + data[:2])
+            return
+        if op == 0x9:
+            c.sendall(struct.pack("!BB", 0x8a, len(data)) + data)
+            continue
+        msg = json.loads(data)
+        if not authed:
+            if msg.get("type") != "auth" or msg.get("access_token") == "bad":
+                ws_send(c, '{"type":"auth_invalid","message":"Invalid'
+                           ' access token or password"}')
+                return
+            authed = True
+            ws_send(c, '{"type":"auth_ok","ha_version":"2026.1.0"}')
+        elif msg.get("type") == "ping":
+            ws_send(c, '{"id":%d,"type":"pong"}' % msg["id"])
+        else:
+            ws_send(c, '{"id":%d,"type":"result","success":true,'
+                       '"result":null}' % msg["id"])
+
+
+# ---- HTTP ----
+
+def http_client(c):
+    buf = b""
+    try:
+        while True:
+            while b"\r\n\r\n" not in buf:
+                x = c.recv(4096)
+                if not x:
+                    raise EOFError
+                buf += x
+            head, buf = buf.split(b"\r\n\r\n", 1)
+            lines = head.split(b"\r\n")
+            headers = {}
+            for line in lines[1:]:
+                k, _, v = line.partition(b":")
+                headers[k.strip().lower()] = v.strip()
+
+            if lines[0].startswith(b"GET /api/websocket"):
+                ws_client(c, headers)
+                break
+
+            length = int(headers.get(b"content-length", b"0"))
+            while len(buf) < length:
+                buf += recvn(c, length - len(buf))
+            buf = buf[length:]
+            c.sendall(b"HTTP/1.1 200 OK\r\n"
+                      b"Content-Type: application/json\r\n"
+                      b"Content-Length: %d\r\n"
+                      b"Date: Thu, 01 Jan 2026 00:00:00 GMT\r\n"
+                      b"Server: Python/3.13 aiohttp/3.11\r\n\r\n"
+                      % len(STATE_BODY) + STATE_BODY)
+    except (EOFError, OSError, ValueError):
+        pass
+    c.close()
+
+
+# ---- TLS ----
+
+def tls_client(ctx, handler, c, peer):
+    try:
+        c.settimeout(10)
+        c = ctx.wrap_socket(c, server_side=True)
+        c.settimeout(None)
+    except (ssl.SSLError, OSError) as e:
+        print("ha_mock: %s:%d TLS failed: %s" % (peer[0], peer[1], e))
+        c.close()
+        return
+    print("ha_mock: %s:%d %s %s handshake" %
+          (peer[0], peer[1], c.version(),
+           "resumed" if c.session_reused else "full"))
+    handler(c)
+
+
+def serve(port, handler, ctx):
+    s = socket.socket()
+    s.setsockopt(socket.SOL_SOCKET, socket.SO_REUSEADDR, 1)
+    s.bind(("0.0.0.0", port))
+    s.listen()
+    while True:
+        c, peer = s.accept()
+        if ctx:
+            args = (ctx, handler, c, peer)
+            target = tls_client
+        else:
+            args = (c,)
+            target = handler
+        threading.Thread(target=target, args=args, daemon=True).start()
+
+
+def main():
+    args = sys.argv[1:]
+    ctx = None
+    if args[:1] == ["--tls"]:
+        ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_SERVER)
+        ctx.load_cert_chain(args[1], args[2])
+        args = args[3:]
+    http_port = int(args[0]) if len(args) > 0 else 8123
+    mqtt_port = int(args[1]) if len(args) > 1 else (8883 if ctx else 1883)
+    print("ha_mock: HTTP/WS on %d, MQTT on %d%s" %
+          (http_port, mqtt_port, " (TLS)" if ctx else ""))
+    threading.Thread(target=serve, args=(mqtt_port, mqtt_client, ctx),
+                     daemon=True).start()
+    serve(http_port, http_client, ctx)
+
+
+if __name__ == "__main__":
+    main()
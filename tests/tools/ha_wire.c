@@ -0,0 +1,584 @@
+/*
+ * tests/tools/ha_wire.c
+ *
+ * Host tool: drive the hactl REST, MQTT and WebSocket wire formats
+ * against a real server and report bytes on the wire and per-update
+ * latency, so the backends can be compared on the same network.
+ *
+ *   ha_wire mqtt <host> [port] [count]           e.g. a local mosquitto
+ *   ha_wire rest <host> <port> <token> [count]   e.g. a dev HA instance
+ *   ha_wire ws   <host> <port> <token> [count]   HA WebSocket API
+ *
+ * tests/tools/ha_mock.py stands in for HA and a broker when neither is
+ * at hand.
+ *
+ * Every mode alternates presence on/off `count` times over one
+ * persistent connection, as the report task does, and times each update
+ * from send to acknowledgement (PUBACK / HTTP response / WS result).
+ * The MQTT run publishes under node "ha_wire" and clears its retained
+ * discovery configs on exit.
+ *
+ * Not part of `make test`; build with `make tools`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "apps/hactl/ha_format.h"
+#include "apps/hactl/ha_http.h"
+#include "apps/hactl/ha_mqtt.h"
+#include "apps/hactl/ha_ws.h"
+
+#define NODE     "ha_wire"
+#define ENTITY   "binary_sensor.ha_wire_presence"
+
+struct wire_s
+{
+  int      fd;
+  uint64_t tx;
+  uint64_t rx;
+};
+
+struct lat_s
+{
+  uint64_t sum;
+  uint64_t min;
+  uint64_t max;
+  uint32_t n;
+};
+
+static uint64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000u + ts.tv_nsec / 1000;
+}
+
+static void lat_add(struct lat_s *l, uint64_t us)
+{
+  l->min = l->n == 0 || us < l->min ? us : l->min;
+  l->max = us > l->max ? us : l->max;
+  l->sum += us;
+  l->n++;
+}
+
+static struct mmwave_data_s sample(uint32_t i)
+{
+  struct mmwave_data_s d;
+  memset(&d, 0, sizeof(d));
+  d.target_state       = (i & 1) ? LD2410_TARGET_BOTH : LD2410_TARGET_NONE;
+  d.motion_energy      = (uint8_t)(i % 101);
+  d.static_energy      = (uint8_t)(i % 97);
+  d.motion_distance    = (uint16_t)(i % 600);
+  d.static_distance    = (uint16_t)(i % 450);
+  d.detection_distance = (uint16_t)(i % 500);
+  return d;
+}
+
+static int wire_connect(struct wire_s *w, const char *host, uint16_t port)
+{
+  struct addrinfo hints;
+  struct addrinfo *ai;
+  char portstr[8];
+  int one = 1;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(portstr, sizeof(portstr), "%u", port);
+
+  if (getaddrinfo(host, portstr, &hints, &ai) != 0)
+    {
+      fprintf(stderr, "ha_wire: cannot resolve %s\n", host);
+      return -1;
+    }
+
+  w->fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (w->fd < 0 || connect(w->fd, ai->ai_addr, ai->ai_addrlen) < 0)
+    {
+      fprintf(stderr, "ha_wire: connect %s:%u: %s\n", host, port,
+              strerror(errno));
+      freeaddrinfo(ai);
+      return -1;
+    }
+
+  /* Match the device: lwIP/NuttX send small segments immediately */
+
+  setsockopt(w->fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  freeaddrinfo(ai);
+  return 0;
+}
+
+static int wire_send(struct wire_s *w, const struct iovec *iov, int n)
+{
+  size_t total = 0;
+
+  for (int i = 0; i < n; i++)
+    {
+      total += iov[i].iov_len;
+    }
+
+  ssize_t sent = writev(w->fd, iov, n);
+  if (sent != (ssize_t)total)
+    {
+      return -1;
+    }
+
+  w->tx += sent;
+  return 0;
+}
+
+static void print_row(const char *what, uint64_t tx, uint64_t rx,
+                      uint32_t n)
+{
+  printf("  %-22s %8.1f %8.1f\n", what, n ? (double)tx / n : 0.0,
+         n ? (double)rx / n : 0.0);
+}
+
+static void print_lat(const struct lat_s *l)
+{
+  if (l->n > 0)
+    {
+      printf("  latency (us)           avg %llu  min %llu  max %llu\n",
+             (unsigned long long)(l->sum / l->n),
+             (unsigned long long)l->min, (unsigned long long)l->max);
+    }
+}
+
+/* ---- MQTT ---- */
+
+static int mqtt_wait(struct wire_s *w, uint8_t type, uint16_t pid)
+{
+  struct ha_mqtt_rx_s rx;
+  uint8_t buf[64];
+
+  ha_mqtt_rx_init(&rx);
+  for (; ; )
+    {
+      ssize_t n = recv(w->fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        {
+          return -1;
+        }
+
+      w->rx += n;
+      for (size_t off = 0; off < (size_t)n; )
+        {
+          size_t used;
+          int ret = ha_mqtt_rx_feed(&rx, buf + off, n - off, &used);
+
+          off += used;
+          if (ret == HA_MQTT_RX_INVALID)
+            {
+              return -1;
+            }
+
+          if (ret == HA_MQTT_RX_PACKET && ha_mqtt_rx_type(&rx) == type)
+            {
+              if (type == MQTT_PKT_CONNACK)
+                {
+                  return ha_mqtt_connack_rc(&rx) == 0 ? 0 : -1;
+                }
+
+              if (type != MQTT_PKT_PUBACK || ha_mqtt_puback_pid(&rx) == pid)
+                {
+                  return 0;
+                }
+            }
+        }
+    }
+}
+
+static int mqtt_publish(struct wire_s *w, uint16_t *pid, const char *topic,
+                        const void *payload, size_t len, bool retain)
+{
+  uint8_t hdr[HA_MQTT_TOPIC_MAX + HA_MQTT_PUBLISH_OVERHEAD];
+  uint16_t id = ha_mqtt_next_pid(pid);
+  int hlen = ha_mqtt_publish_header(hdr, sizeof(hdr), topic, len, true,
+                                    retain, id);
+  struct iovec iov[2] =
+  {
+    { hdr, (size_t)hlen },
+    { (void *)payload, len }
+  };
+
+  if (hlen < 0 || wire_send(w, iov, 2) < 0)
+    {
+      return -1;
+    }
+
+  return mqtt_wait(w, MQTT_PKT_PUBACK, id);
+}
+
+static int run_mqtt(const char *host, uint16_t port, uint32_t count)
+{
+  struct wire_s w = { -1, 0, 0 };
+  struct lat_s lat = { 0, 0, 0, 0 };
+  uint8_t pkt[256];
+  char topic[HA_MQTT_TOPIC_MAX];
+  char status[HA_MQTT_TOPIC_MAX];
+  char state[HA_MQTT_TOPIC_MAX];
+  char doc[1024];
+  uint16_t pid = 0;
+  uint64_t t0 = now_us();
+
+  if (wire_connect(&w, host, port) < 0)
+    {
+      return 1;
+    }
+
+  ha_mqtt_node_topic(status, sizeof(status), NODE, "status");
+  ha_mqtt_node_topic(state, sizeof(state), NODE, "state");
+
+  struct ha_mqtt_connect_s c;
+  memset(&c, 0, sizeof(c));
+  c.client_id   = NODE;
+  c.will_topic  = status;
+  c.will_msg    = HA_MQTT_OFFLINE;
+  c.will_qos1   = true;
+  c.will_retain = true;
+  c.keepalive_s = 60;
+
+  struct iovec iov = { pkt, (size_t)ha_mqtt_connect(pkt, sizeof(pkt), &c) };
+  if (wire_send(&w, &iov, 1) < 0 || mqtt_wait(&w, MQTT_PKT_CONNACK, 0) < 0)
+    {
+      fprintf(stderr, "ha_wire: CONNECT refused\n");
+      return 1;
+    }
+
+  for (size_t i = 0; i < HA_MQTT_ENTITY_COUNT; i++)
+    {
+      struct json_buf_s b = { doc, sizeof(doc), 0 };
+      struct json_writer_s jw;
+
+      json_init(&jw, json_sink_buf, &b);
+      ha_mqtt_discovery_json(&jw, NODE, &g_ha_mqtt_entities[i]);
+      ha_mqtt_config_topic(topic, sizeof(topic), NODE,
+                           &g_ha_mqtt_entities[i]);
+      if (mqtt_publish(&w, &pid, topic, doc, json_finish(&jw), true) < 0)
+        {
+          fprintf(stderr, "ha_wire: discovery publish failed\n");
+          return 1;
+        }
+    }
+
+  mqtt_publish(&w, &pid, status, HA_MQTT_ONLINE, strlen(HA_MQTT_ONLINE),
+               true);
+
+  uint64_t setup_tx = w.tx;
+  uint64_t setup_rx = w.rx;
+  uint64_t setup_us = now_us() - t0;
+
+  for (uint32_t i = 0; i < count; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      int len = ha_mqtt_state_json(doc, sizeof(doc), &d);
+
+      t0 = now_us();
+      if (mqtt_publish(&w, &pid, state, doc, len, true) < 0)
+        {
+          fprintf(stderr, "ha_wire: update %u failed\n", i);
+          return 1;
+        }
+
+      lat_add(&lat, now_us() - t0);
+    }
+
+  printf("MQTT %s:%u, %u updates (QoS 1, retained)\n", host, port, count);
+  printf("  %-22s %8s %8s\n", "", "tx B", "rx B");
+  print_row("session setup", setup_tx, setup_rx, 1);
+  print_row("per update", w.tx - setup_tx, w.rx - setup_rx, count);
+  printf("  setup time (us)        %llu\n", (unsigned long long)setup_us);
+  print_lat(&lat);
+
+  /* Leave the broker as we found it: empty retained payloads delete */
+
+  for (size_t i = 0; i < HA_MQTT_ENTITY_COUNT; i++)
+    {
+      ha_mqtt_config_topic(topic, sizeof(topic), NODE,
+                           &g_ha_mqtt_entities[i]);
+      mqtt_publish(&w, &pid, topic, "", 0, true);
+    }
+
+  mqtt_publish(&w, &pid, state, "", 0, true);
+  mqtt_publish(&w, &pid, status, "", 0, true);
+
+  iov.iov_len = ha_mqtt_simple(pkt, MQTT_PKT_DISCONNECT);
+  wire_send(&w, &iov, 1);
+  close(w.fd);
+  return 0;
+}
+
+/* ---- REST ---- */
+
+static int rest_post(struct wire_s *w, struct ha_request_s *req,
+                     const char *body, int len)
+{
+  struct ha_http_resp_s resp;
+  char buf[256];
+
+  ha_request_set_length(req, len);
+
+  struct iovec iov[2] =
+  {
+    { req->buf, req->len },
+    { (void *)body, (size_t)len }
+  };
+
+  if (wire_send(w, iov, 2) < 0)
+    {
+      return -1;
+    }
+
+  ha_http_init(&resp);
+  for (; ; )
+    {
+      ssize_t n = recv(w->fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        {
+          return -1;
+        }
+
+      w->rx += n;
+      int ret = ha_http_feed(&resp, buf, n);
+      if (ret == HA_HTTP_COMPLETE)
+        {
+          return ha_http_ok(&resp) && resp.keep_alive ? 0 : -1;
+        }
+
+      if (ret == HA_HTTP_INVALID)
+        {
+          return -1;
+        }
+    }
+}
+
+static int run_rest(const char *host, uint16_t port, const char *token,
+                    uint32_t count)
+{
+  static struct ha_request_s req;
+  struct wire_s w = { -1, 0, 0 };
+  struct lat_s lat = { 0, 0, 0, 0 };
+  char body[256];
+
+  if (ha_request_init(&req, ENTITY, host, port, token) < 0 ||
+      wire_connect(&w, host, port) < 0)
+    {
+      return 1;
+    }
+
+  for (uint32_t i = 0; i < count; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+      int len = ha_format_state_json(body, sizeof(body), &d);
+      uint64_t t0 = now_us();
+
+      if (rest_post(&w, &req, body, len) < 0)
+        {
+          fprintf(stderr, "ha_wire: update %u failed\n", i);
+          return 1;
+        }
+
+      lat_add(&lat, now_us() - t0);
+    }
+
+  printf("REST %s:%u, %u updates (keep-alive)\n", host, port, count);
+  printf("  %-22s %8s %8s\n", "", "tx B", "rx B");
+  print_row("per update", w.tx, w.rx, count);
+  print_lat(&lat);
+
+  close(w.fd);
+  return 0;
+}
+
+/* ---- WebSocket ---- */
+
+struct ws_in_s
+{
+  struct ha_ws_rx_s rx;
+  uint8_t buf[256];
+  size_t  off;
+  size_t  len;
+};
+
+static int ws_next(struct wire_s *w, struct ws_in_s *in)
+{
+  for (; ; )
+    {
+      while (in->off < in->len)
+        {
+          size_t used;
+          int ret = ha_ws_rx_feed(&in->rx, in->buf + in->off,
+                                  in->len - in->off, &used);
+
+          in->off += used;
+          if (ret == HA_WS_INVALID)
+            {
+              return -1;
+            }
+
+          if (ret == HA_WS_DONE && in->rx.opcode == HA_WS_OP_TEXT)
+            {
+              return 0;
+            }
+        }
+
+      ssize_t n = recv(w->fd, in->buf, sizeof(in->buf), 0);
+      if (n <= 0)
+        {
+          return -1;
+        }
+
+      w->rx  += n;
+      in->off = 0;
+      in->len = n;
+    }
+}
+
+static int ws_send(struct wire_s *w, struct ha_ws_frame_s *f,
+                   struct json_writer_s *jw)
+{
+  uint8_t *start;
+  int n = ha_ws_frame_text(f, jw, &start);
+  struct iovec iov = { start, (size_t)n };
+
+  return n < 0 ? -1 : wire_send(w, &iov, 1);
+}
+
+static int run_ws(const char *host, uint16_t port, const char *token,
+                  uint32_t count)
+{
+  static struct ws_in_s in;
+  struct wire_s w = { -1, 0, 0 };
+  struct lat_s lat = { 0, 0, 0, 0 };
+  struct ha_ws_frame_s f;
+  struct json_writer_s jw;
+  struct ha_ws_hs_s hs;
+  uint8_t frame[384];
+  char key[HA_WS_KEY_LEN + 1];
+  uint64_t t0 = now_us();
+  int ret;
+
+  if (wire_connect(&w, host, port) < 0)
+    {
+      return 1;
+    }
+
+  ha_ws_key(key, (const uint8_t *)"ha_wire ws nonce");
+  ret = ha_ws_handshake((char *)frame, sizeof(frame), host, port, key);
+
+  struct iovec iov = { frame, (size_t)ret };
+  if (ret < 0 || wire_send(&w, &iov, 1) < 0)
+    {
+      return 1;
+    }
+
+  ha_ws_hs_init(&hs, key);
+  ha_ws_rx_init(&in.rx);
+  do
+    {
+      ssize_t n = recv(w.fd, in.buf, sizeof(in.buf), 0);
+      if (n <= 0)
+        {
+          fprintf(stderr, "ha_wire: no upgrade response\n");
+          return 1;
+        }
+
+      w.rx += n;
+      ret = ha_ws_hs_feed(&hs, (const char *)in.buf, n, &in.off);
+      in.len = n;
+    }
+  while (ret == HA_WS_MORE);
+
+  if (ret != HA_WS_DONE || ws_next(&w, &in) < 0)
+    {
+      fprintf(stderr, "ha_wire: upgrade failed (HTTP %u)\n", hs.status);
+      return 1;
+    }
+
+  ha_ws_frame_init(&f, frame, sizeof(frame), 0x5eed1234);
+  json_init(&jw, ha_ws_sink, &f);
+  ha_ws_auth_json(&jw, token);
+  if (ws_send(&w, &f, &jw) < 0 || ws_next(&w, &in) < 0 ||
+      !ha_ws_msg_has(&in.rx, HA_WS_TYPE("auth_ok")))
+    {
+      fprintf(stderr, "ha_wire: auth failed\n");
+      return 1;
+    }
+
+  uint64_t setup_tx = w.tx;
+  uint64_t setup_rx = w.rx;
+  uint64_t setup_us = now_us() - t0;
+
+  for (uint32_t i = 0; i < count; i++)
+    {
+      struct mmwave_data_s d = sample(i);
+
+      t0 = now_us();
+      ha_ws_frame_init(&f, frame, sizeof(frame), 0x9e3779b9u * (i + 1));
+      json_init(&jw, ha_ws_sink, &f);
+      ha_ws_event_json(&jw, i + 1, &d);
+
+      ret = ws_send(&w, &f, &jw);
+      while (ret == 0 && ha_ws_result_id(&in.rx) != (int32_t)(i + 1))
+        {
+          ret = ws_next(&w, &in);
+        }
+
+      if (ret < 0 || !ha_ws_result_ok(&in.rx))
+        {
+          fprintf(stderr, "ha_wire: update %u failed\n", i);
+          return 1;
+        }
+
+      lat_add(&lat, now_us() - t0);
+    }
+
+  printf("WS %s:%u, %u updates (fire_event %s)\n", host, port, count,
+         HA_WS_EVENT_TYPE);
+  printf("  %-22s %8s %8s\n", "", "tx B", "rx B");
+  print_row("session setup", setup_tx, setup_rx, 1);
+  print_row("per update", w.tx - setup_tx, w.rx - setup_rx, count);
+  printf("  setup time (us)        %llu\n", (unsigned long long)setup_us);
+  print_lat(&lat);
+
+  close(w.fd);
+  return 0;
+}
+
+int main(int argc, char *argv[])
+{
+  if (argc >= 3 && strcmp(argv[1], "mqtt") == 0)
+    {
+      return run_mqtt(argv[2], argc > 3 ? atoi(argv[3]) : 1883,
+                      argc > 4 ? atoi(argv[4]) : 20);
+    }
+
+  if (argc >= 5 && strcmp(argv[1], "rest") == 0)
+    {
+      return run_rest(argv[2], atoi(argv[3]), argv[4],
+                      argc > 5 ? atoi(argv[5]) : 20);
+    }
+
+  if (argc >= 5 && strcmp(argv[1], "ws") == 0)
+    {
+      return run_ws(argv[2], atoi(argv[3]), argv[4],
+                    argc > 5 ? atoi(argv[5]) : 20);
+    }
+
+  fprintf(stderr, "usage: ha_wire mqtt <host> [port] [count]\n"
+                  "       ha_wire rest <host> <port> <token> [count]\n"
+                  "       ha_wire ws   <host> <port> <token> [count]\n");
+  return 2;
+}
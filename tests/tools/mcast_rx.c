@@ -0,0 +1,369 @@
+/*
+ * tests/tools/mcast_rx.c
+ *
+ * Host tool: receive the multicast presence stream (apps/mcast) and
+ * report, per sending device, frames, bytes, loss, reordering and
+ * latency. With -s it sends a synthetic stream instead, using the
+ * device's encoder, so the receiver (or a fusion controller) can be
+ * tried without hardware.
+ *
+ *   mcast_rx [-g group] [-p port] [-i ifaddr] [-t seconds]
+ *   mcast_rx -s [-g group] [-p port] [-i ifaddr] [-r hz] [-n count]
+ *            [-l loss%] [-d id]
+ *
+ * Defaults: group 239.255.41.10, port 41234, any interface, run until
+ * killed; sender 10 Hz, 100 frames, no loss. `-i 127.0.0.1` on both
+ * ends keeps the test on loopback.
+ *
+ * Latency is receive time minus the frame's timestamp. Sender and
+ * receiver clocks are unrelated, so it is reported relative to the
+ * smallest value seen (queueing and jitter above the best case). When
+ * both ends run on this host they share CLOCK_MONOTONIC and the
+ * absolute one-way figure is printed too.
+ *
+ * Not part of `make test`; build with `make tools`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <poll.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+#include "apps/mcast/mcast_frame.h"
+
+#define MAX_DEVICES   16
+#define DEF_GROUP     "239.255.41.10"
+#define DEF_PORT      41234
+
+struct dev_s
+{
+  uint32_t id;
+  struct mcast_dec_s dec;
+  bool     started;
+  uint32_t next_seq;       /* Highest seen + 1 */
+  uint64_t frames;
+  uint64_t bytes;
+  uint64_t lost;           /* Sequence gaps (less late arrivals) */
+  uint64_t late;           /* Arrived after a higher sequence */
+  uint64_t gates_lost;
+  int64_t  off_min;        /* rx - ts, smallest seen */
+  int64_t  off_sum;
+  int64_t  off_max;
+};
+
+static volatile sig_atomic_t g_stop;
+static struct dev_s g_devs[MAX_DEVICES];
+static int g_ndevs;
+static uint64_t g_bad;
+
+static uint64_t now_us(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void on_signal(int sig)
+{
+  g_stop = 1;
+}
+
+static struct dev_s *find_dev(uint32_t id)
+{
+  for (int i = 0; i < g_ndevs; i++)
+    {
+      if (g_devs[i].id == id)
+        {
+          return &g_devs[i];
+        }
+    }
+
+  if (g_ndevs == MAX_DEVICES)
+    {
+      return NULL;
+    }
+
+  memset(&g_devs[g_ndevs], 0, sizeof(g_devs[0]));
+  g_devs[g_ndevs].id = id;
+  return &g_devs[g_ndevs++];
+}
+
+static void account(struct dev_s *d, const struct mcast_frame_s *f,
+                    size_t len, uint64_t rx_us)
+{
+  int64_t off = (int64_t)(rx_us - f->ts_us);
+  int32_t gap = (int32_t)(f->seq - d->next_seq);
+
+  if (!d->started)
+    {
+      d->started  = true;
+      d->off_min  = off;
+      d->off_max  = off;
+      d->next_seq = f->seq + 1;
+    }
+  else if (gap >= 0)
+    {
+      d->lost    += (uint64_t)gap;
+      d->next_seq = f->seq + 1;
+    }
+  else
+    {
+      /* Counted as lost when the gap opened; it was only late */
+
+      d->late++;
+      d->lost -= d->lost > 0;
+    }
+
+  d->frames++;
+  d->bytes      += len;
+  d->gates_lost += f->gates_lost;
+  d->off_sum    += off;
+  d->off_min     = off < d->off_min ? off : d->off_min;
+  d->off_max     = off > d->off_max ? off : d->off_max;
+}
+
+static void report(void)
+{
+  printf("\n%-8s %8s %8s %6s %7s %6s %6s %10s %10s %12s\n",
+         "device", "frames", "bytes", "B/fr", "lost", "late", "nogate",
+         "lat+avg", "lat+max", "one-way min");
+
+  for (int i = 0; i < g_ndevs; i++)
+    {
+      struct dev_s *d = &g_devs[i];
+      uint64_t total = d->frames + d->lost;
+      int64_t avg = d->frames ? d->off_sum / (int64_t)d->frames : 0;
+      char oneway[16] = "-";
+
+      /* Same host, same clock: a small positive offset is real latency */
+
+      if (d->off_min >= 0 && d->off_min < 1000000)
+        {
+          snprintf(oneway, sizeof(oneway), "%lld us",
+                   (long long)d->off_min);
+        }
+
+      printf("%08lx %8llu %8llu %6llu %6.2f%% %6llu %6llu %7lld us "
+             "%7lld us %12s\n",
+             (unsigned long)d->id, (unsigned long long)d->frames,
+             (unsigned long long)d->bytes,
+             (unsigned long long)(d->frames ? d->bytes / d->frames : 0),
+             total ? 100.0 * d->lost / total : 0.0,
+             (unsigned long long)d->late, (unsigned long long)d->gates_lost,
+             (long long)(avg - d->off_min),
+             (long long)(d->off_max - d->off_min), oneway);
+    }
+
+  if (g_bad > 0)
+    {
+      printf("%llu datagrams were not valid frames\n",
+             (unsigned long long)g_bad);
+    }
+}
+
+static int run_rx(int fd, const struct sockaddr_in *group,
+                  struct in_addr ifaddr, int seconds)
+{
+  struct sockaddr_in addr = *group;
+  struct ip_mreq mreq;
+  uint64_t start = now_us();
+  int one = 1;
+
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+      perror("mcast_rx: bind");
+      return EXIT_FAILURE;
+    }
+
+  mreq.imr_multiaddr = group->sin_addr;
+  mreq.imr_interface = ifaddr;
+  if (setsockopt(fd, IPPROTO_IP, IP_ADD_MEMBERSHIP, &mreq,
+                 sizeof(mreq)) < 0)
+    {
+      perror("mcast_rx: join");
+      return EXIT_FAILURE;
+    }
+
+  printf("mcast_rx: listening on %s:%u\n", inet_ntoa(group->sin_addr),
+         ntohs(group->sin_port));
+  fflush(stdout);
+
+  while (!g_stop &&
+         (seconds == 0 || now_us() - start < (uint64_t)seconds * 1000000))
+    {
+      struct pollfd pfd = { fd, POLLIN, 0 };
+      uint8_t buf[256];
+      struct mcast_frame_s f;
+      struct dev_s *d;
+      ssize_t n;
+
+      if (poll(&pfd, 1, 200) <= 0)
+        {
+          continue;
+        }
+
+      n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        {
+          continue;
+        }
+
+      d = find_dev(mcast_device_id(buf, (size_t)n));
+      if (d == NULL || mcast_decode(&d->dec, buf, (size_t)n, &f) < 0)
+        {
+          g_bad++;
+          continue;
+        }
+
+      account(d, &f, (size_t)n, now_us());
+    }
+
+  report();
+  return EXIT_SUCCESS;
+}
+
+/* Synthetic device: someone pacing between 1 m and 4 m */
+
+static void synth(uint32_t i, struct mmwave_eng_data_s *e)
+{
+  int phase = (int)(i % 60);
+  uint16_t dist = (uint16_t)(100 + 10 * (phase < 30 ? phase : 60 - phase));
+
+  memset(e, 0, sizeof(*e));
+  e->basic.target_state       = LD2410_TARGET_MOTION;
+  e->basic.motion_energy      = 70;
+  e->basic.motion_distance    = dist;
+  e->basic.detection_distance = dist;
+
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      int d = g - dist / 75;
+      int v = 80 - 25 * (d < 0 ? -d : d);
+
+      e->motion_gate_energy[g] = (uint8_t)(v < 5 ? 5 : v);
+      e->static_gate_energy[g] = 8;
+    }
+}
+
+static int run_tx(int fd, const struct sockaddr_in *group,
+                  struct in_addr ifaddr, int hz, int count, int loss,
+                  uint32_t id)
+{
+  struct mcast_enc_s enc;
+  uint8_t buf[MCAST_FRAME_MAX];
+  int sent = 0;
+  int dropped = 0;
+
+  if (ifaddr.s_addr != htonl(INADDR_ANY))
+    {
+      setsockopt(fd, IPPROTO_IP, IP_MULTICAST_IF, &ifaddr, sizeof(ifaddr));
+    }
+
+  mcast_enc_init(&enc, id, 0);
+  srand((unsigned)id);
+
+  for (int i = 0; i < count && !g_stop; i++)
+    {
+      struct mmwave_eng_data_s e;
+      int len;
+
+      synth((uint32_t)i, &e);
+      len = mcast_encode(&enc, buf, sizeof(buf), &e, true, now_us());
+
+      if (loss > 0 && rand() % 100 < loss)
+        {
+          dropped++;
+        }
+      else if (sendto(fd, buf, len, 0, (const struct sockaddr *)group,
+                      sizeof(*group)) == len)
+        {
+          sent++;
+        }
+      else
+        {
+          perror("mcast_rx: sendto");
+          return EXIT_FAILURE;
+        }
+
+      usleep(1000000 / hz);
+    }
+
+  printf("mcast_rx: sent %d frames (%d dropped on purpose), %u bytes, "
+         "%u key + %u delta gate frames\n", sent, dropped,
+         (unsigned)enc.bytes, (unsigned)enc.key_frames,
+         (unsigned)enc.delta_frames);
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  struct sockaddr_in group;
+  struct in_addr ifaddr = { htonl(INADDR_ANY) };
+  const char *gname = DEF_GROUP;
+  bool send = false;
+  int port = DEF_PORT;
+  int seconds = 0;
+  int hz = 10;
+  int count = 100;
+  int loss = 0;
+  uint32_t id = 0x00c0ffee;
+  int opt;
+  int fd;
+
+  while ((opt = getopt(argc, argv, "sg:p:i:t:r:n:l:d:")) != -1)
+    {
+      switch (opt)
+        {
+          case 's': send    = true; break;
+          case 'g': gname   = optarg; break;
+          case 'p': port    = atoi(optarg); break;
+          case 't': seconds = atoi(optarg); break;
+          case 'r': hz      = atoi(optarg); break;
+          case 'n': count   = atoi(optarg); break;
+          case 'l': loss    = atoi(optarg); break;
+          case 'd': id      = (uint32_t)strtoul(optarg, NULL, 16); break;
+          case 'i':
+            inet_pton(AF_INET, optarg, &ifaddr);
+            break;
+          default:
+            fprintf(stderr, "usage: mcast_rx [-s] [-g group] [-p port] "
+                    "[-i ifaddr] [-t s] [-r hz] [-n count] [-l loss%%] "
+                    "[-d id]\n");
+            return EXIT_FAILURE;
+        }
+    }
+
+  memset(&group, 0, sizeof(group));
+  group.sin_family = AF_INET;
+  group.sin_port   = htons((uint16_t)port);
+  if (inet_pton(AF_INET, gname, &group.sin_addr) != 1 || hz < 1)
+    {
+      fprintf(stderr, "mcast_rx: bad group or rate\n");
+      return EXIT_FAILURE;
+    }
+
+  fd = socket(AF_INET, SOCK_DGRAM, 0);
+  if (fd < 0)
+    {
+      perror("mcast_rx: socket");
+      return EXIT_FAILURE;
+    }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+
+  opt = send ? run_tx(fd, &group, ifaddr, hz, count, loss, id)
+             : run_rx(fd, &group, ifaddr, seconds);
+  close(fd);
+  return opt;
+}
@@ -0,0 +1,516 @@
+/*
+ * tests/tools/stream_cap.c
+ *
+ * Host tool: capture the raw engineering stream (apps/stream) to disk
+ * for offline tuning, and turn captures into CSV.
+ *
+ *   stream_cap [-p port] [-o file] [-t seconds] [-w ms] host
+ *   stream_cap -x file
+ *   stream_cap -s [-p port] [-r hz] [-n count]
+ *
+ * Capture connects to the device, writes the stream byte-for-byte to
+ * the output file (if given) and checks it as it goes: on exit it
+ * prints frames, frames with gate energies, rate, frames the device
+ * dropped for this client (from GAP records) and any sequence holes
+ * not accounted for by them. Defaults: port 5410, until killed.
+ *
+ * -x decodes a capture file to CSV on stdout, one row per frame:
+ *   seq,ts_ms,state,motion_energy,static_energy,motion_distance,
+ *   static_distance,detection_distance,m0..m8,s0..s8
+ * with empty gate columns for frames captured outside engineering mode.
+ *
+ * -s serves a synthetic stream with the device's own server core
+ * (default 20 Hz, 200 frames) so capture can be tried without
+ * hardware. Capturing with -w makes the client stall that many ms
+ * before it starts reading, which shows the device dropping frames for
+ * it and reporting them with a GAP record.
+ *
+ * Not part of `make test`; build with `make tools`.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include "apps/stream/stream.h"
+
+#define DEF_PORT      5410
+
+struct tally_s
+{
+  uint32_t device_id;
+  uint64_t bytes;
+  uint64_t frames;
+  uint64_t gate_frames;
+  uint64_t dropped;         /* Reported by GAP records */
+  uint64_t holes;           /* Sequence numbers skipped */
+  uint64_t unknown;         /* Records of a type we do not know */
+  uint64_t bad;
+  uint32_t last_seq;
+  uint32_t first_ts;
+  uint32_t last_ts;
+};
+
+static volatile sig_atomic_t g_stop;
+
+static uint64_t now_ms(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+static void on_signal(int sig)
+{
+  g_stop = 1;
+}
+
+/* Account for one record body; print it as CSV when csv is set */
+
+static void account(struct tally_s *t, const uint8_t *p, size_t len,
+                    bool csv)
+{
+  struct stream_rec_s r;
+  int ret = stream_decode(p, len, &r);
+
+  if (ret == -ENOMSG)
+    {
+      t->unknown++;
+      return;
+    }
+
+  if (ret < 0)
+    {
+      t->bad++;
+      return;
+    }
+
+  switch (r.type)
+    {
+      case STREAM_REC_HELLO:
+        t->device_id = r.device_id;
+        break;
+
+      case STREAM_REC_GAP:
+        t->dropped += r.dropped;
+        break;
+
+      case STREAM_REC_FRAME:
+        if (t->frames == 0)
+          {
+            t->first_ts = r.eng.basic.timestamp_ms;
+          }
+        else
+          {
+            t->holes += r.seq - t->last_seq - 1;
+          }
+
+        t->frames++;
+        t->gate_frames += r.gates;
+        t->last_seq     = r.seq;
+        t->last_ts      = r.eng.basic.timestamp_ms;
+
+        if (csv)
+          {
+            const struct mmwave_data_s *d = &r.eng.basic;
+
+            printf("%lu,%lu,%u,%u,%u,%u,%u,%u", (unsigned long)r.seq,
+                   (unsigned long)d->timestamp_ms, d->target_state,
+                   d->motion_energy, d->static_energy, d->motion_distance,
+                   d->static_distance, d->detection_distance);
+            for (int g = 0; g < 2 * LD2410_MAX_GATES; g++)
+              {
+                if (r.gates)
+                  {
+                    printf(",%u", g < LD2410_MAX_GATES ?
+                           r.eng.motion_gate_energy[g] :
+                           r.eng.static_gate_energy[g - LD2410_MAX_GATES]);
+                  }
+                else
+                  {
+                    printf(",");
+                  }
+              }
+
+            printf("\n");
+          }
+        break;
+    }
+}
+
+/* Feed stream bytes; whole records are accounted, the rest kept */
+
+struct reader_s
+{
+  uint8_t buf[4096];
+  size_t  len;
+};
+
+static void feed(struct reader_s *rd, struct tally_s *t, const uint8_t *p,
+                 size_t n, bool csv)
+{
+  size_t off = 0;
+
+  t->bytes += n;
+  memcpy(rd->buf + rd->len, p, n);
+  rd->len += n;
+
+  while (rd->len - off >= STREAM_LEN_BYTES)
+    {
+      size_t rec = stream_get16(rd->buf + off);
+
+      if (rd->len - off < STREAM_LEN_BYTES + rec)
+        {
+          break;
+        }
+
+      account(t, rd->buf + off + STREAM_LEN_BYTES, rec, csv);
+      off += STREAM_LEN_BYTES + rec;
+    }
+
+  memmove(rd->buf, rd->buf + off, rd->len - off);
+  rd->len -= off;
+}
+
+static void report(const struct tally_s *t, uint64_t wall_ms)
+{
+  uint32_t span = t->last_ts - t->first_ts;
+
+  fprintf(stderr, "device %08lx: %llu bytes, %llu frames (%llu with "
+          "gates)\n", (unsigned long)t->device_id,
+          (unsigned long long)t->bytes, (unsigned long long)t->frames,
+          (unsigned long long)t->gate_frames);
+  if (t->frames > 1 && span > 0)
+    {
+      fprintf(stderr, "  rate      : %.1f frames/s by device clock",
+              1000.0 * (double)(t->frames - 1 + t->holes) / span);
+      if (wall_ms > 0)
+        {
+          fprintf(stderr, ", %.1f received by wall clock",
+                  1000.0 * (double)t->frames / wall_ms);
+        }
+
+      fprintf(stderr, "\n");
+    }
+
+  fprintf(stderr, "  dropped   : %llu by the device (GAP), %llu "
+          "unexplained sequence holes\n", (unsigned long long)t->dropped,
+          (unsigned long long)(t->holes > t->dropped ?
+                               t->holes - t->dropped : 0));
+  if (t->unknown || t->bad)
+    {
+      fprintf(stderr, "  skipped   : %llu unknown, %llu malformed "
+              "records\n", (unsigned long long)t->unknown,
+              (unsigned long long)t->bad);
+    }
+}
+
+static int run_capture(const char *host, int port, const char *path,
+                       int seconds, int wait_ms)
+{
+  static struct reader_s rd;
+  struct tally_s t;
+  struct addrinfo hints;
+  struct addrinfo *ai;
+  char portstr[8];
+  uint64_t start;
+  FILE *out = NULL;
+  int fd;
+
+  memset(&hints, 0, sizeof(hints));
+  hints.ai_family   = AF_INET;
+  hints.ai_socktype = SOCK_STREAM;
+  snprintf(portstr, sizeof(portstr), "%d", port);
+  if (getaddrinfo(host, portstr, &hints, &ai) != 0)
+    {
+      fprintf(stderr, "stream_cap: cannot resolve %s\n", host);
+      return EXIT_FAILURE;
+    }
+
+  fd = socket(AF_INET, SOCK_STREAM, 0);
+
+  /* A stall should back up into the device, not into our socket */
+
+  if (fd >= 0 && wait_ms > 0)
+    {
+      setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &(int){ 4096 }, sizeof(int));
+    }
+
+  if (fd < 0 || connect(fd, ai->ai_addr, ai->ai_addrlen) < 0)
+    {
+      perror("stream_cap: connect");
+      freeaddrinfo(ai);
+      return EXIT_FAILURE;
+    }
+
+  freeaddrinfo(ai);
+
+  if (path != NULL && (out = fopen(path, "wb")) == NULL)
+    {
+      perror("stream_cap: open output");
+      close(fd);
+      return EXIT_FAILURE;
+    }
+
+  fprintf(stderr, "stream_cap: connected to %s:%d%s%s\n", host, port,
+          path ? ", writing " : "", path ? path : "");
+
+  if (wait_ms > 0)
+    {
+      usleep((useconds_t)wait_ms * 1000);
+    }
+
+  memset(&t, 0, sizeof(t));
+  start = now_ms();
+
+  while (!g_stop &&
+         (seconds == 0 || now_ms() - start < (uint64_t)seconds * 1000))
+    {
+      struct pollfd pfd = { fd, POLLIN, 0 };
+      uint8_t buf[2048];
+      ssize_t n;
+
+      if (poll(&pfd, 1, 200) <= 0)
+        {
+          continue;
+        }
+
+      n = recv(fd, buf, sizeof(buf), 0);
+      if (n <= 0)
+        {
+          break;
+        }
+
+      if (out != NULL && fwrite(buf, 1, (size_t)n, out) != (size_t)n)
+        {
+          perror("stream_cap: write");
+          break;
+        }
+
+      feed(&rd, &t, buf, (size_t)n, false);
+    }
+
+  if (out != NULL)
+    {
+      fclose(out);
+    }
+
+  close(fd);
+  report(&t, now_ms() - start);
+  return EXIT_SUCCESS;
+}
+
+static int run_export(const char *path)
+{
+  static struct reader_s rd;
+  struct tally_s t;
+  uint8_t buf[2048];
+  size_t n;
+  FILE *in = fopen(path, "rb");
+
+  if (in == NULL)
+    {
+      perror("stream_cap: open capture");
+      return EXIT_FAILURE;
+    }
+
+  memset(&t, 0, sizeof(t));
+  printf("seq,ts_ms,state,motion_energy,static_energy,motion_distance,"
+         "static_distance,detection_distance");
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      printf(",m%d", g);
+    }
+
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      printf(",s%d", g);
+    }
+
+  printf("\n");
+
+  while ((n = fread(buf, 1, sizeof(buf), in)) > 0)
+    {
+      feed(&rd, &t, buf, n, true);
+    }
+
+  fclose(in);
+  report(&t, 0);
+  return EXIT_SUCCESS;
+}
+
+/* ---- Synthetic device ---- */
+
+static int g_client = -1;
+
+static ssize_t sim_send(void *arg, int slot, const void *buf, size_t len)
+{
+  ssize_t n = send(g_client, buf, len, MSG_DONTWAIT | MSG_NOSIGNAL);
+
+  if (n < 0)
+    {
+      return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -errno;
+    }
+
+  return n;
+}
+
+/* Someone pacing between 1 m and 4 m */
+
+static void synth(uint32_t i, struct mmwave_eng_data_s *e)
+{
+  int phase = (int)(i % 60);
+  uint16_t dist = (uint16_t)(100 + 10 * (phase < 30 ? phase : 60 - phase));
+
+  memset(e, 0, sizeof(*e));
+  e->basic.target_state       = LD2410_TARGET_MOTION;
+  e->basic.motion_energy      = 70;
+  e->basic.motion_distance    = dist;
+  e->basic.detection_distance = dist;
+  e->basic.timestamp_ms       = (uint32_t)now_ms();
+
+  for (int g = 0; g < LD2410_MAX_GATES; g++)
+    {
+      int d = g - dist / 75;
+      int v = 80 - 25 * (d < 0 ? -d : d);
+
+      e->motion_gate_energy[g] = (uint8_t)(v < 5 ? 5 : v);
+      e->static_gate_energy[g] = 8;
+    }
+}
+
+static int run_sim(int port, int hz, int count)
+{
+  static struct stream_s srv;
+  struct sockaddr_in addr;
+  int one = 1;
+  int lfd;
+  int slot;
+
+  lfd = socket(AF_INET, SOCK_STREAM, 0);
+  setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+  memset(&addr, 0, sizeof(addr));
+  addr.sin_family      = AF_INET;
+  addr.sin_port        = htons((uint16_t)port);
+  addr.sin_addr.s_addr = htonl(INADDR_ANY);
+  if (bind(lfd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+      listen(lfd, 1) < 0)
+    {
+      perror("stream_cap: listen");
+      return EXIT_FAILURE;
+    }
+
+  fprintf(stderr, "stream_cap: synthetic device on tcp port %d, "
+          "waiting for a client\n", port);
+  g_client = accept(lfd, NULL, NULL);
+  close(lfd);
+  if (g_client < 0)
+    {
+      perror("stream_cap: accept");
+      return EXIT_FAILURE;
+    }
+
+  /* Small socket buffer so a stalled reader reaches the ring quickly */
+
+  setsockopt(g_client, SOL_SOCKET, SO_SNDBUF, &(int){ 4096 },
+             sizeof(int));
+
+  stream_init(&srv, sim_send, NULL, 0x00c0ffee);
+  slot = stream_open(&srv);
+
+  for (int i = 0; i < count && !g_stop; i++)
+    {
+      struct mmwave_eng_data_s e;
+
+      synth((uint32_t)i, &e);
+      stream_publish(&srv, &e, true);
+      if (stream_flush(&srv, slot) < 0)
+        {
+          fprintf(stderr, "stream_cap: client went away\n");
+          break;
+        }
+
+      usleep(1000000 / hz);
+    }
+
+  /* Let the client drain what is left */
+
+  for (int i = 0; i < 100 && stream_wants_write(&srv, slot); i++)
+    {
+      stream_flush(&srv, slot);
+      usleep(10000);
+    }
+
+  fprintf(stderr, "stream_cap: published %lu frames, %lu dropped for "
+          "the client, %lu bytes sent\n", (unsigned long)srv.published,
+          (unsigned long)srv.clients[slot].dropped,
+          (unsigned long)srv.clients[slot].bytes);
+  close(g_client);
+  return EXIT_SUCCESS;
+}
+
+int main(int argc, char *argv[])
+{
+  const char *out = NULL;
+  const char *export = NULL;
+  bool sim = false;
+  int port = DEF_PORT;
+  int seconds = 0;
+  int hz = 20;
+  int count = 200;
+  int wait_ms = 0;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "sp:o:t:x:r:n:w:")) != -1)
+    {
+      switch (opt)
+        {
+          case 's': sim     = true; break;
+          case 'p': port    = atoi(optarg); break;
+          case 'o': out     = optarg; break;
+          case 't': seconds = atoi(optarg); break;
+          case 'x': export  = optarg; break;
+          case 'r': hz      = atoi(optarg); break;
+          case 'n': count   = atoi(optarg); break;
+          case 'w': wait_ms = atoi(optarg); break;
+          default:
+            goto usage;
+        }
+    }
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  if (export != NULL)
+    {
+      return run_export(export);
+    }
+
+  if (sim)
+    {
+      return hz < 1 ? EXIT_FAILURE : run_sim(port, hz, count);
+    }
+
+  if (optind < argc)
+    {
+      return run_capture(argv[optind], port, out, seconds, wait_ms);
+    }
+
+usage:
+  fprintf(stderr, "usage: stream_cap [-p port] [-o file] [-t s] [-w ms] "
+          "host\n       stream_cap -x file\n"
+          "       stream_cap -s [-p port] [-r hz] [-n count]\n");
+  return EXIT_FAILURE;
+}
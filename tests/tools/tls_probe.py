@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+#
+# tests/tools/tls_probe.py
+#
+# Measures what session resumption saves on a TLS endpoint the device
+# reports to: connects N times, offering the previous connection's
+# session each time (as hactl does), and prints each handshake's time
+# and whether the server resumed it.
+#
+#   python3 tools/tls_probe.py [-n count] [--tls13] [--post] host port
+#
+# TLS 1.2 is used unless --tls13 is given, and TCP_NODELAY is set, like
+# the device. --post sends one hactl-sized REST request per connection
+# and times the response too.
+# The server certificate is not checked. Standard library only. Not part
+# of `make test`.
+
+import argparse
+import socket
+import ssl
+import time
+
+BODY = (b'{"state":"on","attributes":{"friendly_name":"mmWave Presence",'
+        b'"device_class":"occupancy","motion_energy":42,'
+        b'"static_energy":17,"motion_distance":150,"static_distance":90,'
+        b'"detection_distance":150}}')
+
+REQUEST = (b"POST /api/states/binary_sensor.mmwave_presence HTTP/1.1\r\n"
+           b"Host: %s\r\nAuthorization: Bearer x\r\n"
+           b"Content-Type: application/json\r\nContent-Length: %d\r\n\r\n")
+
+
+def post(c, host):
+    c.sendall(REQUEST % (host.encode(), len(BODY)) + BODY)
+    buf = b""
+    while b"\r\n\r\n" not in buf:
+        x = c.recv(4096)
+        if not x:
+            raise EOFError
+        buf += x
+    head, body = buf.split(b"\r\n\r\n", 1)
+    for line in head.split(b"\r\n"):
+        k, _, v = line.partition(b":")
+        if k.strip().lower() == b"content-length":
+            while len(body) < int(v):
+                body += c.recv(4096)
+
+
+def main():
+    ap = argparse.ArgumentParser()
+    ap.add_argument("-n", type=int, default=10)
+    ap.add_argument("--tls13", action="store_true")
+    ap.add_argument("--post", action="store_true")
+    ap.add_argument("host")
+    ap.add_argument("port", type=int)
+    a = ap.parse_args()
+
+    ctx = ssl.SSLContext(ssl.PROTOCOL_TLS_CLIENT)
+    ctx.check_hostname = False
+    ctx.verify_mode = ssl.CERT_NONE
+    if not a.tls13:
+        ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+
+    session = None
+    times = {"full": [], "resumed": []}
+    for i in range(a.n):
+        raw = socket.create_connection((a.host, a.port))
+        raw.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+        t0 = time.perf_counter()
+        c = ctx.wrap_socket(raw, server_hostname=a.host, session=session)
+        hs = (time.perf_counter() - t0) * 1000
+        kind = "resumed" if c.session_reused else "full"
+        line = "%3d  %-7s  %s  handshake %7.2f ms" % (i, kind, c.version(),
+                                                      hs)
+        if a.post:
+            t1 = time.perf_counter()
+            post(c, a.host)
+            line += "  post %6.2f ms" % ((time.perf_counter() - t1) * 1000)
+        print(line)
+        times[kind].append(hs)
+        session = c.session
+        c.close()
+
+    for kind, t in times.items():
+        if t:
+            print("%-7s  %d  avg %.2f ms  max %.2f ms" %
+                  (kind, len(t), sum(t) / len(t), max(t)))
+
+
+if __name__ == "__main__":
+    main()